@@ -0,0 +1,298 @@
+/** @file vtkCUDAConcurrentMappersBenchmark.cxx
+*
+*  @brief Throughput benchmark of several vtkCUDA1DVolumeMapper rendering on the same device at once
+*
+*  Builds as many off-screen pipelines as asked for (a mapper, volume, renderer and render window each, every mapper
+*  rendering a volume of its own), then renders them for a number of frames one after the other from a single thread,
+*  and again with each pipeline rendering from a thread of its own. Now that every mapper keeps its device state in a
+*  context of its own and renders on its own stream, the second pass should not be slower than the first.
+*  Writes the frames per second over all the mappers for both passes, and the speedup, as JSON.
+*  With a shared input every mapper renders the same image, as the views of a four-up layout do, and the volumes the
+*  device cache holds for them are reported, one being uploaded for all the mappers of a device.
+*  With the mock runtime no device is needed, the mappers rendering with the CPU backend, and the device calls made from
+*  all the threads are checked by vtkCUDAMockRuntime.
+*
+*  Usage: vtkCUDAConcurrentMappersBenchmark [--mappers 4] [--size 128] [--frames 24] [--width 256] [--height 256]
+*                                           [--shared-input 0|1] [--runtime cuda|mock] [--output file.json]
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDA1DVolumeMapper.h"
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAMockRuntime.h"
+#include "vtkCUDAVolumeCache.h"
+
+// VTK includes
+#include <vtkCamera.h>
+#include <vtkColorTransferFunction.h>
+#include <vtkImageData.h>
+#include <vtkMultiThreader.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+#include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+struct BenchmarkOptions
+{
+  int Mappers;
+  int Size;
+  int Frames;
+  int Width;
+  int Height;
+  bool SharedInput;
+  bool MockRuntime;
+  std::string Output;
+};
+
+//----------------------------------------------------------------------------
+struct Pipeline
+{
+  vtkSmartPointer<vtkImageData> Image;
+  vtkSmartPointer<vtkCUDA1DVolumeMapper> Mapper;
+  vtkSmartPointer<vtkVolume> Volume;
+  vtkSmartPointer<vtkRenderer> Renderer;
+  vtkSmartPointer<vtkRenderWindow> Window;
+};
+
+//----------------------------------------------------------------------------
+struct RenderArguments
+{
+  std::vector<Pipeline>* Pipelines;
+  int Frames;
+};
+
+//----------------------------------------------------------------------------
+// A soft edged sphere, off centre by a different amount in each volume so no two mappers render the same data
+vtkImageData* CreateVolume(int size, int index)
+{
+  vtkImageData* image = vtkImageData::New();
+  image->SetDimensions(size, size, size);
+  image->SetSpacing(1.0, 1.0, 1.0);
+  image->SetOrigin(0.0, 0.0, 0.0);
+  image->SetScalarTypeToUnsignedShort();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+
+  unsigned short* voxels = static_cast<unsigned short*>( image->GetScalarPointer() );
+  const double scale = 2.0 / (double) (size - 1);
+  const double shift = 0.05 * (double) index;
+  for( int k = 0; k < size; k++ )
+    {
+    double z = k * scale - 1.0;
+    for( int j = 0; j < size; j++ )
+      {
+      double y = j * scale - 1.0 - shift;
+      for( int i = 0; i < size; i++, voxels++ )
+        {
+        double x = i * scale - 1.0 + shift;
+        double r = std::sqrt(x*x + y*y + z*z);
+        *voxels = (unsigned short) ( 2000.0 / (1.0 + std::exp( (r - 0.7) * 40.0 )) );
+        }
+      }
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+void RenderFrames(Pipeline& pipeline, int frames)
+{
+  vtkCamera* camera = pipeline.Renderer->GetActiveCamera();
+  for( int f = 0; f < frames; f++ )
+    {
+    camera->Azimuth(360.0 / frames);
+    pipeline.Renderer->ResetCameraClippingRange();
+    pipeline.Window->Render();
+    }
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE RenderThread(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  RenderArguments& args = *static_cast<RenderArguments*>(info->UserData);
+  RenderFrames( (*args.Pipelines)[info->ThreadID], args.Frames );
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+bool ParseArguments(int argc, char* argv[], BenchmarkOptions& options)
+{
+  options.Mappers = 4;
+  options.Size = 128;
+  options.Frames = 24;
+  options.Width = 256;
+  options.Height = 256;
+  options.SharedInput = false;
+  options.MockRuntime = false;
+
+  for( int i = 1; i < argc; i++ )
+    {
+    std::string arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i+1] : 0;
+    if( !value )
+      {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return false;
+      }
+    if( arg == "--mappers" ) options.Mappers = atoi(value);
+    else if( arg == "--size" ) options.Size = atoi(value);
+    else if( arg == "--frames" ) options.Frames = atoi(value);
+    else if( arg == "--width" ) options.Width = atoi(value);
+    else if( arg == "--height" ) options.Height = atoi(value);
+    else if( arg == "--shared-input" ) options.SharedInput = (atoi(value) != 0);
+    else if( arg == "--runtime" ) options.MockRuntime = (std::string(value) == "mock");
+    else if( arg == "--output" ) options.Output = value;
+    else
+      {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      return false;
+      }
+    i++;
+    }
+
+  if( options.Mappers < 1 || options.Mappers > VTK_MAX_THREADS )
+    {
+    std::cerr << "Numbers of mappers must be between 1 and " << VTK_MAX_THREADS << std::endl;
+    return false;
+    }
+  return options.Size >= 2 && options.Frames > 0 && options.Width > 0 && options.Height > 0;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  BenchmarkOptions options;
+  if( !ParseArguments(argc, argv, options) )
+    {
+    std::cerr << "Usage: " << argv[0] << " [--mappers 4] [--size 128] [--frames 24] [--width 256] [--height 256]"
+              << " [--shared-input 0|1] [--runtime cuda|mock] [--output file.json]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //the mock runtime has to be in place before the first CUDA object takes a device, and runs no kernel
+  vtkSmartPointer<vtkCUDAMockRuntime> runtime;
+  if( options.MockRuntime )
+    {
+    runtime = vtkSmartPointer<vtkCUDAMockRuntime>::New();
+    vtkCUDADeviceManager::Singleton()->SetRuntime(runtime);
+    }
+
+  vtkSmartPointer<vtkColorTransferFunction> colour = vtkSmartPointer<vtkColorTransferFunction>::New();
+  colour->AddRGBPoint(0.0, 0.0, 0.0, 0.0);
+  colour->AddRGBPoint(1000.0, 0.88, 0.60, 0.29);
+  colour->AddRGBPoint(2000.0, 1.0, 1.0, 1.0);
+  vtkSmartPointer<vtkPiecewiseFunction> opacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  opacity->AddPoint(0.0, 0.0);
+  opacity->AddPoint(500.0, 0.0);
+  opacity->AddPoint(2000.0, 0.3);
+  vtkSmartPointer<vtkVolumeProperty> property = vtkSmartPointer<vtkVolumeProperty>::New();
+  property->SetColor(colour);
+  property->SetScalarOpacity(opacity);
+  property->SetInterpolationTypeToLinear();
+
+  std::vector<Pipeline> pipelines(options.Mappers);
+  for( int m = 0; m < options.Mappers; m++ )
+    {
+    Pipeline& pipeline = pipelines[m];
+    if( options.SharedInput && m > 0 ) pipeline.Image = pipelines[0].Image;
+    else pipeline.Image.TakeReference( CreateVolume(options.Size, m) );
+    pipeline.Mapper = vtkSmartPointer<vtkCUDA1DVolumeMapper>::New();
+    if( runtime ) pipeline.Mapper->SetRenderBackend(vtkCUDAVolumeMapper::CPU_BACKEND);
+    pipeline.Mapper->SetInput(pipeline.Image);
+    pipeline.Volume = vtkSmartPointer<vtkVolume>::New();
+    pipeline.Volume->SetMapper(pipeline.Mapper);
+    pipeline.Volume->SetProperty(property);
+    pipeline.Renderer = vtkSmartPointer<vtkRenderer>::New();
+    pipeline.Renderer->AddVolume(pipeline.Volume);
+    pipeline.Window = vtkSmartPointer<vtkRenderWindow>::New();
+    pipeline.Window->SetOffScreenRendering(1);
+    pipeline.Window->SetSize(options.Width, options.Height);
+    pipeline.Window->AddRenderer(pipeline.Renderer);
+    pipeline.Renderer->ResetCamera();
+
+    //warm up (texture uploads, lookup tables and the mapper's device context)
+    pipeline.Window->Render();
+    }
+  if( runtime ) runtime->ResetCounters();
+
+  std::cerr << "Rendering " << options.Mappers << " mappers one after the other..." << std::endl;
+  double start = vtkTimerLog::GetUniversalTime();
+  for( int m = 0; m < options.Mappers; m++ )
+    RenderFrames(pipelines[m], options.Frames);
+  const double sequential = vtkTimerLog::GetUniversalTime() - start;
+
+  std::cerr << "Rendering " << options.Mappers << " mappers at once..." << std::endl;
+  RenderArguments args;
+  args.Pipelines = &pipelines;
+  args.Frames = options.Frames;
+  vtkSmartPointer<vtkMultiThreader> threader = vtkSmartPointer<vtkMultiThreader>::New();
+  threader->SetNumberOfThreads(options.Mappers);
+  threader->SetSingleMethod(RenderThread, &args);
+  start = vtkTimerLog::GetUniversalTime();
+  threader->SingleMethodExecute();
+  const double concurrent = vtkTimerLog::GetUniversalTime() - start;
+
+  //a device call on memory, a stream or an event another mapper freed or never made shows up as an invalid call
+  const int errors = runtime ? runtime->GetNumberOfInvalidCalls() : 0;
+
+  const double frames = (double) options.Mappers * (double) options.Frames;
+  vtkCUDAVolumeCache* volumeCache = vtkCUDADeviceManager::Singleton()->GetVolumeCache();
+  std::ostringstream json;
+  json << "{\n  \"benchmark\": \"vtkCUDAConcurrentMappers\",\n"
+       << "  \"runtime\": \"" << (runtime ? "mock" : "cuda") << "\",\n"
+       << "  \"backend\": \"" << (pipelines[0].Mapper->GetRenderBackend() == vtkCUDAVolumeMapper::CPU_BACKEND ? "cpu" : "cuda") << "\",\n"
+       << "  \"mappers\": " << options.Mappers << ",\n"
+       << "  \"size\": [" << options.Size << ", " << options.Size << ", " << options.Size << "],\n"
+       << "  \"viewport\": [" << options.Width << ", " << options.Height << "],\n"
+       << "  \"frames_per_mapper\": " << options.Frames << ",\n"
+       << "  \"shared_input\": " << (options.SharedInput ? "true" : "false") << ",\n"
+       << "  \"volume_cache\": { \"volumes\": " << volumeCache->GetNumberOfVolumes()
+       << ", \"references\": " << volumeCache->GetNumberOfReferences()
+       << ", \"hits\": " << volumeCache->GetNumberOfHits()
+       << ", \"misses\": " << volumeCache->GetNumberOfMisses() << " },\n"
+       << "  \"sequential\": { \"elapsed_ms\": " << 1000.0 * sequential
+       << ", \"frames_per_second\": " << (sequential > 0.0 ? frames / sequential : 0.0) << " },\n"
+       << "  \"concurrent\": { \"elapsed_ms\": " << 1000.0 * concurrent
+       << ", \"frames_per_second\": " << (concurrent > 0.0 ? frames / concurrent : 0.0) << " },\n"
+       << "  \"speedup\": " << (concurrent > 0.0 ? sequential / concurrent : 0.0) << ",\n"
+       << "  \"errors\": " << errors << "\n"
+       << "}\n";
+
+  for( int m = 0; m < options.Mappers; m++ )
+    pipelines[m].Renderer->RemoveVolume(pipelines[m].Volume);
+
+  if( options.Output.empty() )
+    {
+    std::cout << json.str();
+    }
+  else
+    {
+    std::ofstream file( options.Output.c_str() );
+    if( !file )
+      {
+      std::cerr << "Cannot write " << options.Output << std::endl;
+      return EXIT_FAILURE;
+      }
+    file << json.str();
+    }
+  return (errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
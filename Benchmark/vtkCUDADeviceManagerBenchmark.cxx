@@ -0,0 +1,251 @@
+/** @file vtkCUDADeviceManagerBenchmark.cxx
+*
+*  @brief Stress test and benchmark of the device and stream registry of vtkCUDADeviceManager under many threads
+*
+*  Each thread stands for a mapper or information handler on a device of its own (the threads going round the devices):
+*  it gets its device and a stream, shares the stream as a replicated object would, reserves the device many times as a
+*  frame does, checks that the device made current and the one the stream is registered on are its own, and returns
+*  the stream and the device again, over and over. Writes the reservations per second over all the threads and the
+*  number of inconsistencies seen (which must be 0) as JSON, for each number of threads asked for.
+*  With the mock runtime no device is needed, the runtime pretending to have as many as asked for, and the streams it
+*  saw created and left alive are reported as well.
+*
+*  Usage: vtkCUDADeviceManagerBenchmark [--threads 1,2,4,8,16] [--rounds 2000] [--reservations 50]
+*                                       [--runtime cuda|mock] [--devices 2] [--output file.json]
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAMockRuntime.h"
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+struct BenchmarkOptions
+{
+  std::vector<int> Threads;
+  int Rounds;
+  int Reservations;
+  bool MockRuntime;
+  int MockDevices;
+  std::string Output;
+};
+
+//----------------------------------------------------------------------------
+struct StressArguments
+{
+  int NumberOfDevices;
+  int Rounds;
+  int Reservations;
+  int Errors[VTK_MAX_THREADS];
+};
+
+//----------------------------------------------------------------------------
+std::vector<int> SplitList(const char* list)
+{
+  std::vector<int> items;
+  std::stringstream stream(list);
+  std::string item;
+  while( std::getline(stream, item, ',') )
+    if( !item.empty() ) items.push_back(atoi(item.c_str()));
+  return items;
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE StressThread(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  StressArguments& args = *static_cast<StressArguments*>(info->UserData);
+  const int thread = info->ThreadID;
+  const int device = thread % args.NumberOfDevices;
+  vtkCUDADeviceManager* manager = vtkCUDADeviceManager::Singleton();
+  vtkCUDARuntime* runtime = manager->GetRuntime();
+
+  int errors = 0;
+  for( int r = 0; r < args.Rounds; r++ )
+    {
+    if( manager->GetDevice(0, device) )
+      {
+      errors++;
+      continue;
+      }
+    cudaStream_t* stream = 0;
+    if( manager->GetStream(0, &stream, device) )
+      {
+      errors++;
+      manager->ReturnDevice(0, device);
+      continue;
+      }
+    cudaStream_t* shared = stream;
+    if( manager->GetStream(0, &shared, device) || shared != stream ) errors++;
+
+    for( int i = 0; i < args.Reservations; i++ )
+      {
+      int current = -1;
+      if( manager->ReserveGPU(stream) || runtime->GetDevice(&current) != cudaSuccess || current != device ) errors++;
+      if( manager->QueryDeviceForStream(stream) != device ) errors++;
+      }
+
+    if( shared == stream && manager->ReturnStream(0, shared, device) ) errors++;
+    if( manager->ReturnStream(0, stream, device) ) errors++;
+    if( manager->ReturnDevice(0, device) ) errors++;
+    }
+  args.Errors[thread] = errors;
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+bool ParseArguments(int argc, char* argv[], BenchmarkOptions& options)
+{
+  options.Threads = SplitList("1,2,4,8,16");
+  options.Rounds = 2000;
+  options.Reservations = 50;
+  options.MockRuntime = false;
+  options.MockDevices = 2;
+
+  for( int i = 1; i < argc; i++ )
+    {
+    std::string arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i+1] : 0;
+    if( !value )
+      {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return false;
+      }
+    if( arg == "--threads" ) options.Threads = SplitList(value);
+    else if( arg == "--rounds" ) options.Rounds = atoi(value);
+    else if( arg == "--reservations" ) options.Reservations = atoi(value);
+    else if( arg == "--runtime" ) options.MockRuntime = (std::string(value) == "mock");
+    else if( arg == "--devices" ) options.MockDevices = atoi(value);
+    else if( arg == "--output" ) options.Output = value;
+    else
+      {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      return false;
+      }
+    i++;
+    }
+
+  for( size_t t = 0; t < options.Threads.size(); t++ )
+    {
+    if( options.Threads[t] < 1 || options.Threads[t] > VTK_MAX_THREADS )
+      {
+      std::cerr << "Numbers of threads must be between 1 and " << VTK_MAX_THREADS << std::endl;
+      return false;
+      }
+    }
+  return !options.Threads.empty() && options.Rounds > 0 && options.Reservations > 0 && options.MockDevices > 0;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  BenchmarkOptions options;
+  if( !ParseArguments(argc, argv, options) )
+    {
+    std::cerr << "Usage: " << argv[0] << " [--threads 1,2,4,8,16] [--rounds 2000] [--reservations 50]"
+              << " [--runtime cuda|mock] [--devices 2] [--output file.json]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkSmartPointer<vtkCUDAMockRuntime> runtime;
+  if( options.MockRuntime )
+    {
+    runtime = vtkSmartPointer<vtkCUDAMockRuntime>::New();
+    runtime->SetNumberOfDevices(options.MockDevices);
+    vtkCUDADeviceManager::Singleton()->SetRuntime(runtime);
+    }
+
+  const int numberOfDevices = vtkCUDADeviceManager::Singleton()->GetNumberOfDevices();
+  if( numberOfDevices < 1 )
+    {
+    std::cerr << "No CUDA device to register" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::ostringstream json;
+  json << "{\n  \"benchmark\": \"vtkCUDADeviceManager\",\n"
+       << "  \"runtime\": \"" << (runtime ? "mock" : "cuda") << "\",\n"
+       << "  \"devices\": " << numberOfDevices << ",\n"
+       << "  \"runs\": [\n";
+
+  int totalErrors = 0;
+  for( size_t t = 0; t < options.Threads.size(); t++ )
+    {
+    const int threads = options.Threads[t];
+    std::cerr << "Stressing the registry from " << threads << " threads..." << std::endl;
+
+    StressArguments args;
+    args.NumberOfDevices = numberOfDevices;
+    args.Rounds = options.Rounds;
+    args.Reservations = options.Reservations;
+    for( int i = 0; i < VTK_MAX_THREADS; i++ )
+      args.Errors[i] = 0;
+
+    vtkSmartPointer<vtkMultiThreader> threader = vtkSmartPointer<vtkMultiThreader>::New();
+    threader->SetNumberOfThreads(threads);
+    threader->SetSingleMethod(StressThread, &args);
+    double start = vtkTimerLog::GetUniversalTime();
+    threader->SingleMethodExecute();
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+
+    int errors = 0;
+    for( int i = 0; i < threads; i++ )
+      errors += args.Errors[i];
+
+    //every stream created has to have been destroyed again, and the mock never called on one that does not exist
+    std::ostringstream streams;
+    if( runtime )
+      {
+      errors += runtime->GetNumberOfInvalidCalls() + runtime->GetNumberOfLiveStreams();
+      streams << "      \"streams_created\": " << runtime->GetNumberOfStreamsCreated() << ",\n"
+              << "      \"streams_alive\": " << runtime->GetNumberOfLiveStreams() << ",\n";
+      runtime->ResetCounters();
+      }
+    totalErrors += errors;
+
+    const double reservations = (double) threads * (double) options.Rounds * (double) options.Reservations;
+    json << "    {\n"
+         << "      \"threads\": " << threads << ",\n"
+         << "      \"elapsed_ms\": " << 1000.0 * elapsed << ",\n"
+         << "      \"reservations_per_second\": " << (elapsed > 0.0 ? reservations / elapsed : 0.0) << ",\n"
+         << "      \"registrations_per_second\": " << (elapsed > 0.0 ? (double) threads * options.Rounds / elapsed : 0.0) << ",\n"
+         << streams.str()
+         << "      \"errors\": " << errors << "\n"
+         << "    }" << (t + 1 < options.Threads.size() ? ",\n" : "\n");
+    }
+  json << "  ]\n}\n";
+
+  if( options.Output.empty() )
+    {
+    std::cout << json.str();
+    }
+  else
+    {
+    std::ofstream file( options.Output.c_str() );
+    if( !file )
+      {
+      std::cerr << "Cannot write " << options.Output << std::endl;
+      return EXIT_FAILURE;
+      }
+    file << json.str();
+    }
+  return (totalErrors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,310 @@
+/** @file vtkCUDAKernelVariantsBenchmark.cxx
+*
+*  @brief Benchmark of the ray casting kernels of vtkCUDA1DVolumeMapper specialized for the features of a frame
+*
+*  Renders an off-screen pipeline in a number of scenes, each using a different set of features (unshaded, shaded, with a
+*  gradient opacity function, with a clipping plane, through a parallel projection, and everything at once), from the same
+*  orbit of views twice: once with the general kernels and once with the kernels specialized for the scene. Writes, per
+*  scene, the variant picked and the mean ray casting time (ray formation and compositing) of both kernels and the
+*  speedup as JSON. With the mock runtime no device is needed, the mapper rendering with the CPU backend, whose ray
+*  caster is instantiated for the same variants. vtkCUDAKernelVariantsTest checks that the variants cast the same images.
+*
+*  Usage: vtkCUDAKernelVariantsBenchmark [--frames 12] [--size 128] [--width 256] [--height 256]
+*                                        [--runtime cuda|mock] [--output file.json]
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDA1DVolumeMapper.h"
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAMockRuntime.h"
+
+// VTK includes
+#include <vtkCamera.h>
+#include <vtkColorTransferFunction.h>
+#include <vtkImageData.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkPlane.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkSmartPointer.h>
+#include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+struct BenchmarkOptions
+{
+  int Frames;
+  int Size;
+  int Width;
+  int Height;
+  bool MockRuntime;
+  std::string Output;
+};
+
+//----------------------------------------------------------------------------
+// A set of features to render with
+struct Scene
+{
+  const char* Name;
+  bool Shaded;
+  bool GradientOpacity;
+  bool Clipped;
+  bool Parallel;
+};
+
+//----------------------------------------------------------------------------
+// The timings of a scene rendered with the general and the specialized kernels
+struct SceneResult
+{
+  int Variant;
+  double GeneralTime;
+  double SpecializedTime;
+};
+
+//----------------------------------------------------------------------------
+vtkImageData* CreateVolume(int size)
+{
+  vtkImageData* image = vtkImageData::New();
+  image->SetDimensions(size, size, size);
+  image->SetSpacing(1.0, 1.0, 1.0);
+  image->SetOrigin(0.0, 0.0, 0.0);
+  image->SetScalarTypeToUnsignedShort();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+
+  //a soft edged ellipsoid with a denser core, so there are both flat regions and edges to shade
+  unsigned short* voxels = static_cast<unsigned short*>( image->GetScalarPointer() );
+  const double scale = 2.0 / (double) (size - 1);
+  for( int k = 0; k < size; k++ )
+    {
+    double z = k * scale - 1.0;
+    for( int j = 0; j < size; j++ )
+      {
+      double y = j * scale - 1.0;
+      for( int i = 0; i < size; i++, voxels++ )
+        {
+        double x = i * scale - 1.0;
+        double r = std::sqrt(x*x + 4.0*y*y + 2.0*z*z);
+        double core = std::sqrt(4.0*x*x + y*y + z*z);
+        *voxels = (unsigned short) ( 1200.0 / (1.0 + std::exp( (r - 0.7) * 40.0 )) +
+                                     800.0 / (1.0 + std::exp( (core - 0.4) * 20.0 )) );
+        }
+      }
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+// Renders the orbit of views, returning the mean ray casting time
+double RenderOrbit(vtkRenderer* renderer, vtkRenderWindow* window, vtkCUDA1DVolumeMapper* mapper, vtkCamera* start,
+                   int frames)
+{
+  renderer->GetActiveCamera()->DeepCopy(start);
+  double total = 0.0;
+  for( int f = 0; f < frames; f++ )
+    {
+    renderer->GetActiveCamera()->Azimuth( 360.0 / frames );
+    renderer->ResetCameraClippingRange();
+    window->Render();
+    const cudaRenderStatistics& stats = mapper->GetRenderStatistics();
+    total += stats.RayFormationTime + stats.CompositingTime;
+    }
+  return total / frames;
+}
+
+//----------------------------------------------------------------------------
+bool ParseArguments(int argc, char* argv[], BenchmarkOptions& options)
+{
+  options.Frames = 12;
+  options.Size = 128;
+  options.Width = 256;
+  options.Height = 256;
+  options.MockRuntime = false;
+
+  for( int i = 1; i < argc; i++ )
+    {
+    std::string arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i+1] : 0;
+    if( !value )
+      {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return false;
+      }
+    if( arg == "--frames" ) options.Frames = atoi(value);
+    else if( arg == "--size" ) options.Size = atoi(value);
+    else if( arg == "--width" ) options.Width = atoi(value);
+    else if( arg == "--height" ) options.Height = atoi(value);
+    else if( arg == "--runtime" ) options.MockRuntime = (std::string(value) == "mock");
+    else if( arg == "--output" ) options.Output = value;
+    else
+      {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      return false;
+      }
+    i++;
+    }
+  return options.Frames > 0 && options.Size >= 2 && options.Width > 0 && options.Height > 0;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  BenchmarkOptions options;
+  if( !ParseArguments(argc, argv, options) )
+    {
+    std::cerr << "Usage: " << argv[0] << " [--frames 12] [--size 128] [--width 256] [--height 256]"
+              << " [--runtime cuda|mock] [--output file.json]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //the mock runtime has to be in place before the first CUDA object takes a device, and runs no kernel
+  vtkSmartPointer<vtkCUDAMockRuntime> runtime;
+  if( options.MockRuntime )
+    {
+    runtime = vtkSmartPointer<vtkCUDAMockRuntime>::New();
+    vtkCUDADeviceManager::Singleton()->SetRuntime(runtime);
+    }
+
+  vtkSmartPointer<vtkColorTransferFunction> colour = vtkSmartPointer<vtkColorTransferFunction>::New();
+  colour->AddRGBPoint(0.0, 0.0, 0.0, 0.0);
+  colour->AddRGBPoint(1000.0, 0.88, 0.60, 0.29);
+  colour->AddRGBPoint(2000.0, 1.0, 1.0, 1.0);
+  vtkSmartPointer<vtkPiecewiseFunction> opacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  opacity->AddPoint(0.0, 0.0);
+  opacity->AddPoint(500.0, 0.0);
+  opacity->AddPoint(2000.0, 0.3);
+  vtkSmartPointer<vtkPiecewiseFunction> unitGradientOpacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  unitGradientOpacity->AddPoint(0.0, 1.0);
+  unitGradientOpacity->AddPoint(255.0, 1.0);
+  vtkSmartPointer<vtkPiecewiseFunction> gradientOpacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  gradientOpacity->AddPoint(0.0, 0.1);
+  gradientOpacity->AddPoint(100.0, 1.0);
+  vtkSmartPointer<vtkVolumeProperty> property = vtkSmartPointer<vtkVolumeProperty>::New();
+  property->SetColor(colour);
+  property->SetScalarOpacity(opacity);
+  property->SetInterpolationTypeToLinear();
+  property->SetAmbient(0.3);
+  property->SetDiffuse(0.6);
+  property->SetSpecular(0.2);
+  property->SetSpecularPower(10.0);
+
+  vtkSmartPointer<vtkImageData> image;
+  image.TakeReference( CreateVolume(options.Size) );
+  vtkSmartPointer<vtkCUDA1DVolumeMapper> mapper = vtkSmartPointer<vtkCUDA1DVolumeMapper>::New();
+  if( runtime ) mapper->SetRenderBackend(vtkCUDAVolumeMapper::CPU_BACKEND);
+  mapper->SetInput(image);
+  mapper->SetRenderOnDemand(false);
+  mapper->SetCollectStatistics(true);
+  vtkSmartPointer<vtkVolume> volume = vtkSmartPointer<vtkVolume>::New();
+  volume->SetMapper(mapper);
+  volume->SetProperty(property);
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  renderer->AddVolume(volume);
+  vtkSmartPointer<vtkRenderWindow> window = vtkSmartPointer<vtkRenderWindow>::New();
+  window->SetOffScreenRendering(1);
+  window->SetSize(options.Width, options.Height);
+  window->AddRenderer(renderer);
+  renderer->ResetCamera();
+  renderer->GetActiveCamera()->Elevation(20.0);
+
+  //a plane through the middle of the volume, tilted so it cuts the rays at every depth
+  vtkSmartPointer<vtkPlane> plane = vtkSmartPointer<vtkPlane>::New();
+  double centre = 0.5 * (options.Size - 1);
+  plane->SetOrigin(centre, centre, centre);
+  plane->SetNormal(1.0, 0.5, 0.25);
+
+  const Scene scenes[] = {
+    { "unshaded", false, false, false, false },
+    { "shaded", true, false, false, false },
+    { "gradient_opacity", false, true, false, false },
+    { "clipped", false, false, true, false },
+    { "parallel", false, false, false, true },
+    { "general", true, true, true, false } };
+  const int numberOfScenes = sizeof(scenes) / sizeof(scenes[0]);
+
+  //warm up (lookup tables and the mapper's device context) with the general kernels
+  mapper->SetUseSpecializedKernels(false);
+  renderer->ResetCameraClippingRange();
+  window->Render();
+  if( runtime ) runtime->ResetCounters();
+
+  std::vector<SceneResult> results(numberOfScenes);
+  for( int s = 0; s < numberOfScenes; s++ )
+    {
+    const Scene& scene = scenes[s];
+    std::cerr << "Rendering the " << scene.Name << " scene..." << std::endl;
+    property->SetShade(scene.Shaded ? 1 : 0);
+    property->SetGradientOpacity(scene.GradientOpacity ? gradientOpacity : unitGradientOpacity);
+    mapper->RemoveAllClippingPlanes();
+    if( scene.Clipped ) mapper->AddClippingPlane(plane);
+    vtkSmartPointer<vtkCamera> start = vtkSmartPointer<vtkCamera>::New();
+    start->DeepCopy( renderer->GetActiveCamera() );
+    start->SetParallelProjection(scene.Parallel ? 1 : 0);
+
+    SceneResult& result = results[s];
+    mapper->SetUseSpecializedKernels(false);
+    result.GeneralTime = RenderOrbit(renderer, window, mapper, start, options.Frames);
+    mapper->SetUseSpecializedKernels(true);
+    result.SpecializedTime = RenderOrbit(renderer, window, mapper, start, options.Frames);
+    result.Variant = mapper->GetKernelVariant();
+    }
+  mapper->RemoveAllClippingPlanes();
+
+  //a device call on memory, a stream or an event that does not exist shows up as an invalid call
+  const int errors = runtime ? runtime->GetNumberOfInvalidCalls() : 0;
+
+  std::ostringstream json;
+  json << "{\n  \"benchmark\": \"vtkCUDAKernelVariants\",\n"
+       << "  \"runtime\": \"" << (runtime ? "mock" : "cuda") << "\",\n"
+       << "  \"backend\": \"" << (mapper->GetRenderBackend() == vtkCUDAVolumeMapper::CPU_BACKEND ? "cpu" : "cuda") << "\",\n"
+       << "  \"size\": [" << options.Size << ", " << options.Size << ", " << options.Size << "],\n"
+       << "  \"viewport\": [" << options.Width << ", " << options.Height << "],\n"
+       << "  \"frames\": " << options.Frames << ",\n"
+       << "  \"scenes\": [\n";
+  for( int s = 0; s < numberOfScenes; s++ )
+    {
+    const SceneResult& result = results[s];
+    json << "    { \"name\": \"" << scenes[s].Name << "\""
+         << ", \"variant\": " << result.Variant
+         << ", \"general_ms\": " << 1000.0 * result.GeneralTime
+         << ", \"specialized_ms\": " << 1000.0 * result.SpecializedTime
+         << ", \"speedup\": " << (result.SpecializedTime > 0.0 ? result.GeneralTime / result.SpecializedTime : 0.0) << " }"
+         << (s + 1 < numberOfScenes ? ",\n" : "\n");
+    }
+  json << "  ],\n"
+       << "  \"errors\": " << errors << "\n"
+       << "}\n";
+
+  renderer->RemoveVolume(volume);
+
+  if( options.Output.empty() )
+    {
+    std::cout << json.str();
+    }
+  else
+    {
+    std::ofstream file( options.Output.c_str() );
+    if( !file )
+      {
+      std::cerr << "Cannot write " << options.Output << std::endl;
+      return EXIT_FAILURE;
+      }
+    file << json.str();
+    }
+  return (errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,497 @@
+/** @file vtkCUDAPreIntegrationBenchmark.cxx
+*
+*  @brief Check and benchmark of the pre-integrated transfer function table of vtkCUDA1DVolumeMapper
+*
+*  First builds the table (CPU_vtkCUDA1DVolumeMapper_preIntegrate) for a few synthetic transfer functions (a peak one
+*  entry wide, a step and a ramp), on the calling thread and on the host threads, timing both. Every entry read is
+*  compared against the segment integrated numerically in double precision in many small steps, its opacity and its
+*  premultiplied colour having to agree within the tolerance.
+*  Then renders an off-screen pipeline whose transfer function has a narrow opacity peak, first classifying points at
+*  the smallest spacing as the reference, then at longer steps both classifying points and pre-integrated segments.
+*  The segments have to stay closer to the reference than the points at every step. Writes the timings, the largest
+*  table errors, the mean and largest pixel differences to the reference and the number of errors found (which must
+*  be 0) as JSON. With the mock runtime no device is needed, the mapper rendering with the CPU backend.
+*
+*  Usage: vtkCUDAPreIntegrationBenchmark [--size 128] [--width 256] [--height 256] [--repeats 5] [--threads n]
+*                                        [--runtime cuda|mock] [--output file.json]
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "CPU_vtkCUDA1DVolumeMapper_preIntegration.h"
+#include "CUDA_containerKernelVariant.h"
+#include "vtkCUDA1DVolumeMapper.h"
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAHostThreadPool.h"
+#include "vtkCUDAMockRuntime.h"
+
+// VTK includes
+#include <vtkCamera.h>
+#include <vtkColorTransferFunction.h>
+#include <vtkImageData.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+#include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/** @brief Number of entries in the synthetic lookup tables */
+const int FunctionSize = 512;
+
+/** @brief Number of steps the reference integrates a segment in */
+const int ReferenceSteps = 4096;
+
+/** @brief Largest difference allowed between the table and the reference, in opacity and premultiplied colour */
+const double Tolerance = 2e-3;
+
+/** @brief Only every so many rows and columns of the table are checked, along with the whole diagonal */
+const int CheckStride = 5;
+
+//----------------------------------------------------------------------------
+struct BenchmarkOptions
+{
+  int Size;
+  int Width;
+  int Height;
+  int Repeats;
+  int Threads;
+  bool MockRuntime;
+  std::string Output;
+};
+
+//----------------------------------------------------------------------------
+// The 1D lookup tables of a synthetic transfer function
+struct LookupTables
+{
+  const char* Name;
+  std::vector<float> Alpha;
+  std::vector<float> Red;
+  std::vector<float> Green;
+  std::vector<float> Blue;
+};
+
+//----------------------------------------------------------------------------
+// The timings and comparison of the table of one transfer function
+struct TableResult
+{
+  double SerialTime;
+  double ParallelTime;
+  double MaximumAlphaError;
+  double MaximumColourError;
+  int Errors;
+};
+
+//----------------------------------------------------------------------------
+// The comparison of the images rendered at one sample distance factor to the reference
+struct RenderResult
+{
+  float Factor;
+  double PointTime;
+  double SegmentTime;
+  double PointMeanDifference;
+  double SegmentMeanDifference;
+  int PointMaximumDifference;
+  int SegmentMaximumDifference;
+  int Errors;
+};
+
+//----------------------------------------------------------------------------
+// A peak one entry wide, a hard step and a ramp, each in a colour varying with the intensity
+void CreateLookupTables(std::vector<LookupTables>& tables)
+{
+  const char* names[3] = { "peak", "step", "ramp" };
+  tables.resize(3);
+  for( int t = 0; t < 3; t++ )
+    {
+    LookupTables& table = tables[t];
+    table.Name = names[t];
+    table.Alpha.resize(FunctionSize);
+    table.Red.resize(FunctionSize);
+    table.Green.resize(FunctionSize);
+    table.Blue.resize(FunctionSize);
+    for( int i = 0; i < FunctionSize; i++ )
+      {
+      const double u = ((double) i + 0.5) / (double) FunctionSize;
+      if( t == 0 ) table.Alpha[i] = (i == FunctionSize / 3) ? 0.9f : 0.0f;
+      else if( t == 1 ) table.Alpha[i] = (i >= FunctionSize / 2) ? 0.6f : 0.02f;
+      else table.Alpha[i] = (float) (0.5 * u);
+      table.Red[i] = (float) u;
+      table.Green[i] = (float) (1.0 - u);
+      table.Blue[i] = (float) (0.5 + 0.5 * std::sin( 12.0 * u ));
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Reads a lookup table as a linearly filtered, clamped texture with normalized co-ordinates
+double LookUp(const std::vector<float>& table, double u)
+{
+  const int size = (int) table.size();
+  double x = u * (double) size - 0.5;
+  int i0 = (int) std::floor(x);
+  double a = x - (double) i0;
+  int i1 = i0 + 1;
+  i0 = i0 < 0 ? 0 : (i0 >= size ? size - 1 : i0);
+  i1 = i1 < 0 ? 0 : (i1 >= size ? size - 1 : i1);
+  return (1.0 - a) * table[i0] + a * table[i1];
+}
+
+//----------------------------------------------------------------------------
+// Composites the segment from intensity front to back in many small steps, each a point sample with its opacity
+// corrected to the length of the step, giving the opacity and premultiplied colour of the whole segment
+void IntegrateSegment(const LookupTables& tables, double front, double back, double* rgba)
+{
+  double remaining = 1.0;
+  rgba[0] = rgba[1] = rgba[2] = 0.0;
+  for( int k = 0; k < ReferenceSteps; k++ )
+    {
+    const double u = front + (back - front) * ((double) k + 0.5) / (double) ReferenceSteps;
+    const double alpha = 1.0 - std::pow( 1.0 - LookUp(tables.Alpha, u), 1.0 / (double) ReferenceSteps );
+    rgba[0] += remaining * alpha * LookUp(tables.Red, u);
+    rgba[1] += remaining * alpha * LookUp(tables.Green, u);
+    rgba[2] += remaining * alpha * LookUp(tables.Blue, u);
+    remaining *= 1.0 - alpha;
+    }
+  rgba[3] = 1.0 - remaining;
+}
+
+//----------------------------------------------------------------------------
+// Best of the repeats, in seconds
+double TimeTable(const LookupTables& tables, std::vector<float>& table, vtkCUDAHostThreadPool* pool, int repeats)
+{
+  double best = 0.0;
+  for( int r = 0; r < repeats; r++ )
+    {
+    double start = vtkTimerLog::GetUniversalTime();
+    CPU_vtkCUDA1DVolumeMapper_preIntegrate(&tables.Alpha[0], &tables.Red[0], &tables.Green[0], &tables.Blue[0],
+                                           FunctionSize, CPU_PREINTEGRATED_TABLE_SIZE, &table[0], pool);
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    if( r == 0 || elapsed < best ) best = elapsed;
+    }
+  return best;
+}
+
+//----------------------------------------------------------------------------
+// Builds the table serially and on the threads, which must agree exactly, and compares it against the reference
+TableResult CheckTable(const LookupTables& tables, vtkCUDAHostThreadPool* pool, int repeats)
+{
+  const int size = CPU_PREINTEGRATED_TABLE_SIZE;
+  std::vector<float> serial( 4 * size * size, -1.0f );
+  std::vector<float> parallel( 4 * size * size, -1.0f );
+  TableResult result;
+  result.SerialTime = TimeTable(tables, serial, 0, repeats);
+  result.ParallelTime = TimeTable(tables, parallel, pool, repeats);
+  result.MaximumAlphaError = 0.0;
+  result.MaximumColourError = 0.0;
+  result.Errors = 0;
+  for( size_t i = 0; i < serial.size(); i++ )
+    result.Errors += (serial[i] != parallel[i]) ? 1 : 0;
+
+  for( int j = 0; j < size; j++ )
+    {
+    for( int i = 0; i < size; i++ )
+      {
+      if( i != j && (i % CheckStride != 0 || j % CheckStride != 0) ) continue;
+      const float* entry = &parallel[ 4 * (j * size + i) ];
+      double reference[4];
+      IntegrateSegment(tables, ((double) i + 0.5) / (double) size, ((double) j + 0.5) / (double) size, reference);
+
+      //the table keeps the mean colour, which the opacity weighs as the rays composite it
+      double alphaError = std::fabs( (double) entry[3] - reference[3] );
+      double colourError = 0.0;
+      for( int c = 0; c < 3; c++ )
+        {
+        double error = std::fabs( (double) entry[c] * (double) entry[3] - reference[c] );
+        colourError = error > colourError ? error : colourError;
+        }
+      result.MaximumAlphaError = alphaError > result.MaximumAlphaError ? alphaError : result.MaximumAlphaError;
+      result.MaximumColourError = colourError > result.MaximumColourError ? colourError : result.MaximumColourError;
+      result.Errors += (alphaError > Tolerance || colourError > Tolerance) ? 1 : 0;
+      }
+    }
+  return result;
+}
+
+//----------------------------------------------------------------------------
+vtkImageData* CreateVolume(int size)
+{
+  vtkImageData* image = vtkImageData::New();
+  image->SetDimensions(size, size, size);
+  image->SetSpacing(1.0, 1.0, 1.0);
+  image->SetOrigin(0.0, 0.0, 0.0);
+  image->SetScalarTypeToUnsignedShort();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+
+  //a wavy field rising steeply towards the centre, so the narrow opacity peak of the transfer function is a thin,
+  //curved shell that point samples step over at long steps
+  unsigned short* voxels = static_cast<unsigned short*>( image->GetScalarPointer() );
+  const double scale = 2.0 / (double) (size - 1);
+  for( int k = 0; k < size; k++ )
+    {
+    double z = k * scale - 1.0;
+    for( int j = 0; j < size; j++ )
+      {
+      double y = j * scale - 1.0;
+      for( int i = 0; i < size; i++, voxels++ )
+        {
+        double x = i * scale - 1.0;
+        double r = std::sqrt(x*x + y*y + z*z) + 0.05 * std::sin(8.0 * x) * std::sin(8.0 * y);
+        double value = 2000.0 * (1.0 - r);
+        *voxels = (unsigned short) (value < 0.0 ? 0.0 : value);
+        }
+      }
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+// Renders the current view, returning the ray casting time and keeping the image
+double RenderView(vtkRenderWindow* window, vtkCUDA1DVolumeMapper* mapper, float factor, bool preIntegration,
+                  std::vector<unsigned char>& image, int& mismatches)
+{
+  mapper->SetSampleDistanceFactor(factor);
+  mapper->SetInteractiveSampleDistanceFactor(factor);
+  mapper->SetPreIntegration(preIntegration);
+  window->Render();
+  const cudaRenderStatistics& stats = mapper->GetRenderStatistics();
+  if( ((mapper->GetKernelVariant() & CUDA_VARIANT_PREINTEGRATED) != 0) != preIntegration ) mismatches++;
+
+  const int* size = window->GetSize();
+  unsigned char* pixels = window->GetPixelData(0, 0, size[0] - 1, size[1] - 1, 1);
+  image.assign(pixels, pixels + 3 * (size_t) size[0] * (size_t) size[1]);
+  delete[] pixels;
+  return stats.RayFormationTime + stats.CompositingTime;
+}
+
+//----------------------------------------------------------------------------
+// The mean and largest difference of any channel of the pixels of an image to the reference
+void CompareImages(const std::vector<unsigned char>& reference, const std::vector<unsigned char>& image,
+                   double& meanDifference, int& maximumDifference)
+{
+  double total = 0.0;
+  maximumDifference = 0;
+  for( size_t p = 0; p < reference.size(); p++ )
+    {
+    int difference = std::abs( (int) reference[p] - (int) image[p] );
+    total += difference;
+    maximumDifference = difference > maximumDifference ? difference : maximumDifference;
+    }
+  meanDifference = reference.empty() ? 0.0 : total / (double) reference.size();
+}
+
+//----------------------------------------------------------------------------
+bool ParseArguments(int argc, char* argv[], BenchmarkOptions& options)
+{
+  options.Size = 128;
+  options.Width = 256;
+  options.Height = 256;
+  options.Repeats = 5;
+  options.Threads = 0;
+  options.MockRuntime = false;
+
+  for( int i = 1; i < argc; i++ )
+    {
+    std::string arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i+1] : 0;
+    if( !value )
+      {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return false;
+      }
+    if( arg == "--size" ) options.Size = atoi(value);
+    else if( arg == "--width" ) options.Width = atoi(value);
+    else if( arg == "--height" ) options.Height = atoi(value);
+    else if( arg == "--repeats" ) options.Repeats = atoi(value);
+    else if( arg == "--threads" ) options.Threads = atoi(value);
+    else if( arg == "--runtime" ) options.MockRuntime = (std::string(value) == "mock");
+    else if( arg == "--output" ) options.Output = value;
+    else
+      {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      return false;
+      }
+    i++;
+    }
+  return options.Size >= 2 && options.Width > 0 && options.Height > 0 && options.Repeats > 0;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  BenchmarkOptions options;
+  if( !ParseArguments(argc, argv, options) )
+    {
+    std::cerr << "Usage: " << argv[0] << " [--size 128] [--width 256] [--height 256] [--repeats 5] [--threads n]"
+              << " [--runtime cuda|mock] [--output file.json]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //the mock runtime has to be in place before the first CUDA object takes a device, and runs no kernel
+  vtkSmartPointer<vtkCUDAMockRuntime> runtime;
+  if( options.MockRuntime )
+    {
+    runtime = vtkSmartPointer<vtkCUDAMockRuntime>::New();
+    vtkCUDADeviceManager::Singleton()->SetRuntime(runtime);
+    }
+
+  vtkSmartPointer<vtkCUDAHostThreadPool> pool = vtkSmartPointer<vtkCUDAHostThreadPool>::New();
+  if( options.Threads > 0 ) pool->SetNumberOfThreads(options.Threads);
+
+  //build and check the tables of the synthetic transfer functions
+  std::vector<LookupTables> tables;
+  CreateLookupTables(tables);
+  std::vector<TableResult> tableResults( tables.size() );
+  int errors = 0;
+  for( size_t t = 0; t < tables.size(); t++ )
+    {
+    std::cerr << "Integrating the " << tables[t].Name << " transfer function..." << std::endl;
+    tableResults[t] = CheckTable(tables[t], pool, options.Repeats);
+    errors += tableResults[t].Errors;
+    }
+
+  //a transfer function whose opacity is a narrow peak, on a ramp of colour
+  vtkSmartPointer<vtkColorTransferFunction> colour = vtkSmartPointer<vtkColorTransferFunction>::New();
+  colour->AddRGBPoint(0.0, 0.2, 0.2, 1.0);
+  colour->AddRGBPoint(1000.0, 1.0, 0.5, 0.2);
+  colour->AddRGBPoint(2000.0, 1.0, 1.0, 1.0);
+  vtkSmartPointer<vtkPiecewiseFunction> opacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  opacity->AddPoint(0.0, 0.0);
+  opacity->AddPoint(990.0, 0.0);
+  opacity->AddPoint(1000.0, 0.8);
+  opacity->AddPoint(1010.0, 0.0);
+  opacity->AddPoint(2000.0, 0.0);
+  vtkSmartPointer<vtkVolumeProperty> property = vtkSmartPointer<vtkVolumeProperty>::New();
+  property->SetColor(colour);
+  property->SetScalarOpacity(opacity);
+  property->SetInterpolationTypeToLinear();
+  property->SetShade(0);
+
+  vtkSmartPointer<vtkImageData> image;
+  image.TakeReference( CreateVolume(options.Size) );
+  vtkSmartPointer<vtkCUDA1DVolumeMapper> mapper = vtkSmartPointer<vtkCUDA1DVolumeMapper>::New();
+  if( runtime ) mapper->SetRenderBackend(vtkCUDAVolumeMapper::CPU_BACKEND);
+  mapper->SetInput(image);
+  mapper->SetRenderOnDemand(false);
+  mapper->SetCollectStatistics(true);
+  vtkSmartPointer<vtkVolume> volume = vtkSmartPointer<vtkVolume>::New();
+  volume->SetMapper(mapper);
+  volume->SetProperty(property);
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  renderer->AddVolume(volume);
+  vtkSmartPointer<vtkRenderWindow> window = vtkSmartPointer<vtkRenderWindow>::New();
+  window->SetOffScreenRendering(1);
+  window->SetSize(options.Width, options.Height);
+  window->AddRenderer(renderer);
+  renderer->ResetCamera();
+  renderer->GetActiveCamera()->Elevation(20.0);
+  renderer->GetActiveCamera()->Azimuth(30.0);
+  renderer->ResetCameraClippingRange();
+
+  //points at the smallest spacing are the reference, after a render warming up the lookup tables and device context
+  std::cerr << "Rendering the reference..." << std::endl;
+  int mismatches = 0;
+  std::vector<unsigned char> reference;
+  RenderView(window, mapper, 1.0f, false, reference, mismatches);
+  RenderView(window, mapper, 1.0f, false, reference, mismatches);
+  if( runtime ) runtime->ResetCounters();
+
+  const float factors[] = { 2.0f, 4.0f };
+  const int numberOfFactors = sizeof(factors) / sizeof(factors[0]);
+  std::vector<RenderResult> renderResults(numberOfFactors);
+  for( int f = 0; f < numberOfFactors; f++ )
+    {
+    std::cerr << "Rendering at " << factors[f] << " times the smallest spacing..." << std::endl;
+    RenderResult& result = renderResults[f];
+    result.Factor = factors[f];
+    result.Errors = 0;
+    std::vector<unsigned char> points;
+    std::vector<unsigned char> segments;
+    result.PointTime = RenderView(window, mapper, factors[f], false, points, result.Errors);
+    result.SegmentTime = RenderView(window, mapper, factors[f], true, segments, result.Errors);
+    CompareImages(reference, points, result.PointMeanDifference, result.PointMaximumDifference);
+    CompareImages(reference, segments, result.SegmentMeanDifference, result.SegmentMaximumDifference);
+
+    //the segments never step over the shell, so they have to stay closer to the reference than the points do
+    if( result.SegmentMeanDifference > result.PointMeanDifference ) result.Errors++;
+    errors += result.Errors;
+    }
+  errors += mismatches;
+
+  //a device call on memory, a stream or an event that does not exist shows up as an invalid call
+  errors += runtime ? runtime->GetNumberOfInvalidCalls() : 0;
+
+  std::ostringstream json;
+  json << "{\n  \"benchmark\": \"vtkCUDAPreIntegration\",\n"
+       << "  \"runtime\": \"" << (runtime ? "mock" : "cuda") << "\",\n"
+       << "  \"backend\": \"" << (mapper->GetRenderBackend() == vtkCUDAVolumeMapper::CPU_BACKEND ? "cpu" : "cuda") << "\",\n"
+       << "  \"threads\": " << pool->GetNumberOfThreads() << ",\n"
+       << "  \"table_size\": " << CPU_PREINTEGRATED_TABLE_SIZE << ",\n"
+       << "  \"tolerance\": " << Tolerance << ",\n"
+       << "  \"tables\": [\n";
+  for( size_t t = 0; t < tables.size(); t++ )
+    {
+    const TableResult& result = tableResults[t];
+    json << "    { \"name\": \"" << tables[t].Name << "\""
+         << ", \"serial_ms\": " << 1000.0 * result.SerialTime
+         << ", \"parallel_ms\": " << 1000.0 * result.ParallelTime
+         << ", \"max_alpha_error\": " << result.MaximumAlphaError
+         << ", \"max_colour_error\": " << result.MaximumColourError
+         << ", \"errors\": " << result.Errors << " }"
+         << (t + 1 < tables.size() ? ",\n" : "\n");
+    }
+  json << "  ],\n"
+       << "  \"size\": [" << options.Size << ", " << options.Size << ", " << options.Size << "],\n"
+       << "  \"viewport\": [" << options.Width << ", " << options.Height << "],\n"
+       << "  \"renders\": [\n";
+  for( int f = 0; f < numberOfFactors; f++ )
+    {
+    const RenderResult& result = renderResults[f];
+    json << "    { \"sample_distance_factor\": " << result.Factor
+         << ", \"point_ms\": " << 1000.0 * result.PointTime
+         << ", \"segment_ms\": " << 1000.0 * result.SegmentTime
+         << ", \"point_mean_difference\": " << result.PointMeanDifference
+         << ", \"segment_mean_difference\": " << result.SegmentMeanDifference
+         << ", \"point_max_difference\": " << result.PointMaximumDifference
+         << ", \"segment_max_difference\": " << result.SegmentMaximumDifference
+         << ", \"errors\": " << result.Errors << " }"
+         << (f + 1 < numberOfFactors ? ",\n" : "\n");
+    }
+  json << "  ],\n"
+       << "  \"errors\": " << errors << "\n"
+       << "}\n";
+
+  renderer->RemoveVolume(volume);
+
+  if( options.Output.empty() )
+    {
+    std::cout << json.str();
+    }
+  else
+    {
+    std::ofstream file( options.Output.c_str() );
+    if( !file )
+      {
+      std::cerr << "Cannot write " << options.Output << std::endl;
+      return EXIT_FAILURE;
+      }
+    file << json.str();
+    }
+  return (errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
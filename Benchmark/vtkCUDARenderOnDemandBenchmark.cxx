@@ -0,0 +1,291 @@
+/** @file vtkCUDARenderOnDemandBenchmark.cxx
+*
+*  @brief Check and benchmark of the render-on-demand of vtkCUDAVolumeMapper and of its cache of recent images
+*
+*  Renders an off-screen pipeline from a number of preset views, going round them for a number of cycles and
+*  redrawing each view once unchanged, as an overlay would. The first cycle has to render each view and the redraws have
+*  to display the image last rendered again; once the views are cached the later cycles (and their redraws) have to
+*  display them from the cache, and a transfer function edit has to render again.
+*  Writes the mean time of the frames rendered, redisplayed and taken from the cache, the statistics of the cache and the
+*  number of mismatches found (which must be 0) as JSON.
+*  With the mock runtime no device is needed, the mapper rendering with the CPU backend.
+*
+*  Usage: vtkCUDARenderOnDemandBenchmark [--views 4] [--cycles 3] [--capacity 4] [--size 128] [--width 256]
+*                                        [--height 256] [--runtime cuda|mock] [--output file.json]
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDA1DVolumeMapper.h"
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAImageCache.h"
+#include "vtkCUDAMockRuntime.h"
+
+// VTK includes
+#include <vtkCamera.h>
+#include <vtkColorTransferFunction.h>
+#include <vtkImageData.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkSmartPointer.h>
+#include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+struct BenchmarkOptions
+{
+  int Views;
+  int Cycles;
+  int Capacity;
+  int Size;
+  int Width;
+  int Height;
+  bool MockRuntime;
+  std::string Output;
+};
+
+//----------------------------------------------------------------------------
+// The mean time of the frames of each kind, by the ImageReused statistic
+struct FrameTimes
+{
+  double Total[3];
+  int Count[3];
+};
+
+//----------------------------------------------------------------------------
+vtkImageData* CreateVolume(int size)
+{
+  vtkImageData* image = vtkImageData::New();
+  image->SetDimensions(size, size, size);
+  image->SetSpacing(1.0, 1.0, 1.0);
+  image->SetOrigin(0.0, 0.0, 0.0);
+  image->SetScalarTypeToUnsignedShort();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+
+  //a soft edged ellipsoid, so the preset views all see something different
+  unsigned short* voxels = static_cast<unsigned short*>( image->GetScalarPointer() );
+  const double scale = 2.0 / (double) (size - 1);
+  for( int k = 0; k < size; k++ )
+    {
+    double z = k * scale - 1.0;
+    for( int j = 0; j < size; j++ )
+      {
+      double y = j * scale - 1.0;
+      for( int i = 0; i < size; i++, voxels++ )
+        {
+        double x = i * scale - 1.0;
+        double r = std::sqrt(x*x + 4.0*y*y + 2.0*z*z);
+        *voxels = (unsigned short) ( 2000.0 / (1.0 + std::exp( (r - 0.7) * 40.0 )) );
+        }
+      }
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+// Renders the window and checks how the mapper came by its image, returning whether it was as expected
+bool RenderAndCheck(vtkRenderer* renderer, vtkRenderWindow* window, vtkCUDAVolumeMapper* mapper,
+                    int expected, FrameTimes& times)
+{
+  renderer->ResetCameraClippingRange();
+  window->Render();
+  const cudaRenderStatistics& stats = mapper->GetRenderStatistics();
+  int reused = (int) stats.ImageReused;
+  if( reused >= 0 && reused < 3 )
+    {
+    times.Total[reused] += stats.FrameTime;
+    times.Count[reused]++;
+    }
+  return (expected < 0 || reused == expected);
+}
+
+//----------------------------------------------------------------------------
+bool ParseArguments(int argc, char* argv[], BenchmarkOptions& options)
+{
+  options.Views = 4;
+  options.Cycles = 3;
+  options.Capacity = 4;
+  options.Size = 128;
+  options.Width = 256;
+  options.Height = 256;
+  options.MockRuntime = false;
+
+  for( int i = 1; i < argc; i++ )
+    {
+    std::string arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i+1] : 0;
+    if( !value )
+      {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return false;
+      }
+    if( arg == "--views" ) options.Views = atoi(value);
+    else if( arg == "--cycles" ) options.Cycles = atoi(value);
+    else if( arg == "--capacity" ) options.Capacity = atoi(value);
+    else if( arg == "--size" ) options.Size = atoi(value);
+    else if( arg == "--width" ) options.Width = atoi(value);
+    else if( arg == "--height" ) options.Height = atoi(value);
+    else if( arg == "--runtime" ) options.MockRuntime = (std::string(value) == "mock");
+    else if( arg == "--output" ) options.Output = value;
+    else
+      {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      return false;
+      }
+    i++;
+    }
+  return options.Views > 1 && options.Cycles > 0 && options.Capacity >= 0 && options.Size >= 2 &&
+         options.Width > 0 && options.Height > 0;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  BenchmarkOptions options;
+  if( !ParseArguments(argc, argv, options) )
+    {
+    std::cerr << "Usage: " << argv[0] << " [--views 4] [--cycles 3] [--capacity 4] [--size 128] [--width 256]"
+              << " [--height 256] [--runtime cuda|mock] [--output file.json]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //the mock runtime has to be in place before the first CUDA object takes a device, and runs no kernel
+  vtkSmartPointer<vtkCUDAMockRuntime> runtime;
+  if( options.MockRuntime )
+    {
+    runtime = vtkSmartPointer<vtkCUDAMockRuntime>::New();
+    vtkCUDADeviceManager::Singleton()->SetRuntime(runtime);
+    }
+
+  vtkSmartPointer<vtkColorTransferFunction> colour = vtkSmartPointer<vtkColorTransferFunction>::New();
+  colour->AddRGBPoint(0.0, 0.0, 0.0, 0.0);
+  colour->AddRGBPoint(1000.0, 0.88, 0.60, 0.29);
+  colour->AddRGBPoint(2000.0, 1.0, 1.0, 1.0);
+  vtkSmartPointer<vtkPiecewiseFunction> opacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  opacity->AddPoint(0.0, 0.0);
+  opacity->AddPoint(500.0, 0.0);
+  opacity->AddPoint(2000.0, 0.3);
+  vtkSmartPointer<vtkVolumeProperty> property = vtkSmartPointer<vtkVolumeProperty>::New();
+  property->SetColor(colour);
+  property->SetScalarOpacity(opacity);
+  property->SetInterpolationTypeToLinear();
+
+  vtkSmartPointer<vtkImageData> image;
+  image.TakeReference( CreateVolume(options.Size) );
+  vtkSmartPointer<vtkCUDA1DVolumeMapper> mapper = vtkSmartPointer<vtkCUDA1DVolumeMapper>::New();
+  if( runtime ) mapper->SetRenderBackend(vtkCUDAVolumeMapper::CPU_BACKEND);
+  mapper->SetInput(image);
+  mapper->SetImageCacheCapacity(options.Capacity);
+  mapper->SetCollectStatistics(true);
+  vtkSmartPointer<vtkVolume> volume = vtkSmartPointer<vtkVolume>::New();
+  volume->SetMapper(mapper);
+  volume->SetProperty(property);
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  renderer->AddVolume(volume);
+  vtkSmartPointer<vtkRenderWindow> window = vtkSmartPointer<vtkRenderWindow>::New();
+  window->SetOffScreenRendering(1);
+  window->SetSize(options.Width, options.Height);
+  window->AddRenderer(renderer);
+  renderer->ResetCamera();
+
+  //the preset views, each a copy of the camera turned round the volume, so going back to one gives the same matrices
+  std::vector< vtkSmartPointer<vtkCamera> > presets(options.Views);
+  for( int v = 0; v < options.Views; v++ )
+    {
+    presets[v] = vtkSmartPointer<vtkCamera>::New();
+    presets[v]->DeepCopy( renderer->GetActiveCamera() );
+    presets[v]->Azimuth( 360.0 * v / options.Views );
+    }
+
+  //warm up (lookup tables and the mapper's device context) from a view that is not a preset
+  renderer->GetActiveCamera()->Elevation(30.0);
+  renderer->ResetCameraClippingRange();
+  window->Render();
+  mapper->GetImageCache()->ResetStatistics();
+  if( runtime ) runtime->ResetCounters();
+
+  std::cerr << "Going round " << options.Views << " preset views " << options.Cycles << " times..." << std::endl;
+  FrameTimes times;
+  for( int i = 0; i < 3; i++ )
+    {
+    times.Total[i] = 0.0;
+    times.Count[i] = 0;
+    }
+  int mismatches = 0;
+  const bool allCached = (options.Views <= options.Capacity);
+  for( int c = 0; c < options.Cycles; c++ )
+    {
+    for( int v = 0; v < options.Views; v++ )
+      {
+      renderer->GetActiveCamera()->DeepCopy( presets[v] );
+      int expected = (c == 0) ? 0 : (allCached ? 2 : -1);
+      if( !RenderAndCheck(renderer, window, mapper, expected, times) ) mismatches++;
+
+      //an unrelated redraw of an unchanged view, whose image is still the one rendered, or else the one cached
+      if( !RenderAndCheck(renderer, window, mapper, (c == 0) ? 1 : expected, times) ) mismatches++;
+      }
+    }
+
+  //editing the transfer function renders the view again, whatever the cache holds
+  opacity->AddPoint(1500.0, 0.1);
+  if( !RenderAndCheck(renderer, window, mapper, 0, times) ) mismatches++;
+  if( !RenderAndCheck(renderer, window, mapper, 1, times) ) mismatches++;
+
+  //a device call on memory, a stream or an event that does not exist shows up as an invalid call
+  const int errors = mismatches + (runtime ? runtime->GetNumberOfInvalidCalls() : 0);
+
+  vtkCUDAImageCache* cache = mapper->GetImageCache();
+  const char* kinds[3] = { "rendered", "redisplayed", "cached" };
+  std::ostringstream json;
+  json << "{\n  \"benchmark\": \"vtkCUDARenderOnDemand\",\n"
+       << "  \"runtime\": \"" << (runtime ? "mock" : "cuda") << "\",\n"
+       << "  \"backend\": \"" << (mapper->GetRenderBackend() == vtkCUDAVolumeMapper::CPU_BACKEND ? "cpu" : "cuda") << "\",\n"
+       << "  \"size\": [" << options.Size << ", " << options.Size << ", " << options.Size << "],\n"
+       << "  \"viewport\": [" << options.Width << ", " << options.Height << "],\n"
+       << "  \"views\": " << options.Views << ",\n"
+       << "  \"cycles\": " << options.Cycles << ",\n"
+       << "  \"image_cache\": { \"capacity\": " << cache->GetCapacity()
+       << ", \"images\": " << cache->GetNumberOfImages()
+       << ", \"hits\": " << cache->GetNumberOfHits()
+       << ", \"misses\": " << cache->GetNumberOfMisses() << " },\n";
+  for( int i = 0; i < 3; i++ )
+    json << "  \"" << kinds[i] << "\": { \"frames\": " << times.Count[i]
+         << ", \"mean_ms\": " << (times.Count[i] > 0 ? 1000.0 * times.Total[i] / times.Count[i] : 0.0) << " },\n";
+  json << "  \"mismatches\": " << mismatches << ",\n"
+       << "  \"errors\": " << errors << "\n"
+       << "}\n";
+
+  renderer->RemoveVolume(volume);
+
+  if( options.Output.empty() )
+    {
+    std::cout << json.str();
+    }
+  else
+    {
+    std::ofstream file( options.Output.c_str() );
+    if( !file )
+      {
+      std::cerr << "Cannot write " << options.Output << std::endl;
+      return EXIT_FAILURE;
+      }
+    file << json.str();
+    }
+  return (errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
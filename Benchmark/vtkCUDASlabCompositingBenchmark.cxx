@@ -0,0 +1,261 @@
+/** @file vtkCUDASlabCompositingBenchmark.cxx
+*
+*  @brief Benchmark of the host compositing of the partial images of the slabs a volume is split into when rendered sort-last
+*
+*  Makes one synthetic premultiplied RGBA partial image per slab, composites them with CPU_vtkCUDAVolumeMapper_compositeSlabs
+*  by direct send and by binary swap, and writes the time taken, the throughput in megapixels per second and the largest
+*  difference in any channel from an image composited in floating point from the partials before they were rounded (the
+*  image a single device casting through the whole volume would have given) as JSON. No CUDA device is needed.
+*
+*  Usage: vtkCUDASlabCompositingBenchmark [--slabs 2,3,4,8] [--width 1024] [--height 1024]
+*                                         [--repeats 5] [--threads n] [--output file.json]
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "CPU_vtkCUDAVolumeMapper_composite.h"
+#include "vtkCUDAHostThreadPool.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+struct BenchmarkOptions
+{
+  std::vector<int> Slabs;
+  int Width;
+  int Height;
+  int Repeats;
+  int Threads;
+  std::string Output;
+};
+
+//----------------------------------------------------------------------------
+std::vector<int> SplitList(const char* list)
+{
+  std::vector<int> items;
+  std::stringstream stream(list);
+  std::string item;
+  while( std::getline(stream, item, ',') )
+    if( !item.empty() ) items.push_back(atoi(item.c_str()));
+  return items;
+}
+
+//----------------------------------------------------------------------------
+// Uniform value in [0, 1], the same on every run
+float Random(unsigned int& seed)
+{
+  seed = seed * 1664525u + 1013904223u;
+  return (float) ((seed >> 8) % 65536u) / 65535.0f;
+}
+
+//----------------------------------------------------------------------------
+unsigned char Round(float value)
+{
+  value = 255.0f * value + 0.5f;
+  return (unsigned char) (value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value));
+}
+
+//----------------------------------------------------------------------------
+// Best of the repeats, in seconds
+double TimeCompositing(const std::vector<const uchar4*>& partials, const std::vector<int>& order, const uint2& resolution,
+                       int method, uchar4* output, std::vector<float4>& working, vtkCUDAHostThreadPool* pool, int repeats)
+{
+  double best = 0.0;
+  for( int r = 0; r < repeats; r++ )
+    {
+    double start = vtkTimerLog::GetUniversalTime();
+    CPU_vtkCUDAVolumeMapper_compositeSlabs(partials, order, resolution, method, output, working, pool);
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    if( r == 0 || elapsed < best ) best = elapsed;
+    }
+  return best;
+}
+
+//----------------------------------------------------------------------------
+int MaximumError(const std::vector<uchar4>& image, const std::vector<uchar4>& reference)
+{
+  int error = 0;
+  for( size_t i = 0; i < image.size(); i++ )
+    {
+    int channels[4] = { image[i].x - reference[i].x, image[i].y - reference[i].y,
+                        image[i].z - reference[i].z, image[i].w - reference[i].w };
+    for( int c = 0; c < 4; c++ )
+      error = (std::abs(channels[c]) > error) ? std::abs(channels[c]) : error;
+    }
+  return error;
+}
+
+//----------------------------------------------------------------------------
+bool ParseArguments(int argc, char* argv[], BenchmarkOptions& options)
+{
+  options.Slabs = SplitList("2,3,4,8");
+  options.Width = 1024;
+  options.Height = 1024;
+  options.Repeats = 5;
+  options.Threads = 0;
+
+  for( int i = 1; i < argc; i++ )
+    {
+    std::string arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i+1] : 0;
+    if( !value )
+      {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return false;
+      }
+    if( arg == "--slabs" ) options.Slabs = SplitList(value);
+    else if( arg == "--width" ) options.Width = atoi(value);
+    else if( arg == "--height" ) options.Height = atoi(value);
+    else if( arg == "--repeats" ) options.Repeats = atoi(value);
+    else if( arg == "--threads" ) options.Threads = atoi(value);
+    else if( arg == "--output" ) options.Output = value;
+    else
+      {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      return false;
+      }
+    i++;
+    }
+
+  for( size_t s = 0; s < options.Slabs.size(); s++ )
+    {
+    if( options.Slabs[s] < 1 )
+      {
+      std::cerr << "Numbers of slabs must be positive" << std::endl;
+      return false;
+      }
+    }
+  return !options.Slabs.empty() && options.Width > 0 && options.Height > 0 && options.Repeats > 0;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  BenchmarkOptions options;
+  if( !ParseArguments(argc, argv, options) )
+    {
+    std::cerr << "Usage: " << argv[0] << " [--slabs 2,3,4,8] [--width 1024] [--height 1024]"
+              << " [--repeats 5] [--threads n] [--output file.json]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkSmartPointer<vtkCUDAHostThreadPool> pool = vtkSmartPointer<vtkCUDAHostThreadPool>::New();
+  if( options.Threads > 0 ) pool->SetNumberOfThreads(options.Threads);
+
+  uint2 resolution;
+  resolution.x = options.Width;
+  resolution.y = options.Height;
+  const size_t numberOfPixels = (size_t) options.Width * (size_t) options.Height;
+
+  std::ostringstream json;
+  json << "{\n  \"benchmark\": \"CPU_vtkCUDAVolumeMapper_compositeSlabs\",\n"
+       << "  \"resolution\": [" << options.Width << ", " << options.Height << "],\n"
+       << "  \"threads\": " << pool->GetNumberOfThreads() << ",\n"
+       << "  \"runs\": [\n";
+
+  for( size_t s = 0; s < options.Slabs.size(); s++ )
+    {
+    const int slabs = options.Slabs[s];
+    std::cerr << "Compositing " << slabs << " slabs..." << std::endl;
+
+    //each slab gives every pixel a premultiplied colour with an opacity low enough that the slabs behind still show,
+    //the slabs being seen back to front so the order is not simply that of the partial images
+    std::vector< std::vector<uchar4> > images( slabs, std::vector<uchar4>(numberOfPixels) );
+    std::vector<const uchar4*> partials( slabs );
+    std::vector<int> order( slabs );
+    std::vector<float4> exact( numberOfPixels );
+    for( size_t i = 0; i < numberOfPixels; i++ )
+      exact[i].x = exact[i].y = exact[i].z = exact[i].w = 0.0f;
+    unsigned int seed = 12345;
+    for( int p = 0; p < slabs; p++ )
+      {
+      partials[p] = &(images[p][0]);
+      order[p] = slabs - 1 - p;
+      }
+    for( int p = 0; p < slabs; p++ )
+      {
+      std::vector<uchar4>& image = images[order[p]];
+      for( size_t i = 0; i < numberOfPixels; i++ )
+        {
+        float4 sample;
+        sample.w = 0.6f * Random(seed);
+        sample.x = sample.w * Random(seed);
+        sample.y = sample.w * Random(seed);
+        sample.z = sample.w * Random(seed);
+        image[i].x = Round(sample.x);
+        image[i].y = Round(sample.y);
+        image[i].z = Round(sample.z);
+        image[i].w = Round(sample.w);
+
+        const float transmittance = 1.0f - exact[i].w;
+        exact[i].x += transmittance * sample.x;
+        exact[i].y += transmittance * sample.y;
+        exact[i].z += transmittance * sample.z;
+        exact[i].w += transmittance * sample.w;
+        }
+      }
+    std::vector<uchar4> reference( numberOfPixels );
+    for( size_t i = 0; i < numberOfPixels; i++ )
+      {
+      reference[i].x = Round(exact[i].x);
+      reference[i].y = Round(exact[i].y);
+      reference[i].z = Round(exact[i].z);
+      reference[i].w = Round(exact[i].w);
+      }
+
+    //composite once so the working space is allocated and its page faults not timed
+    std::vector<float4> working;
+    std::vector<uchar4> directSend( numberOfPixels );
+    std::vector<uchar4> binarySwap( numberOfPixels );
+    CPU_vtkCUDAVolumeMapper_compositeSlabs(partials, order, resolution, CUDA_COMPOSITE_BINARY_SWAP, &binarySwap[0], working, pool);
+    double directSendTime = TimeCompositing(partials, order, resolution, CUDA_COMPOSITE_DIRECT_SEND, &directSend[0],
+                                            working, pool, options.Repeats);
+    double binarySwapTime = TimeCompositing(partials, order, resolution, CUDA_COMPOSITE_BINARY_SWAP, &binarySwap[0],
+                                            working, pool, options.Repeats);
+
+    const double megaPixels = (double) numberOfPixels / 1.0e6;
+    json << "    {\n"
+         << "      \"slabs\": " << slabs << ",\n"
+         << "      \"direct_send_ms\": " << 1000.0 * directSendTime << ",\n"
+         << "      \"binary_swap_ms\": " << 1000.0 * binarySwapTime << ",\n"
+         << "      \"direct_send_megapixels_per_second\": " << (directSendTime > 0.0 ? megaPixels / directSendTime : 0.0) << ",\n"
+         << "      \"binary_swap_megapixels_per_second\": " << (binarySwapTime > 0.0 ? megaPixels / binarySwapTime : 0.0) << ",\n"
+         << "      \"direct_send_max_error\": " << MaximumError(directSend, reference) << ",\n"
+         << "      \"binary_swap_max_error\": " << MaximumError(binarySwap, reference) << ",\n"
+         << "      \"methods_max_difference\": " << MaximumError(directSend, binarySwap) << "\n"
+         << "    }" << (s + 1 < options.Slabs.size() ? ",\n" : "\n");
+    }
+  json << "  ]\n}\n";
+
+  if( options.Output.empty() )
+    {
+    std::cout << json.str();
+    }
+  else
+    {
+    std::ofstream file( options.Output.c_str() );
+    if( !file )
+      {
+      std::cerr << "Cannot write " << options.Output << std::endl;
+      return EXIT_FAILURE;
+      }
+    file << json.str();
+    }
+  return EXIT_SUCCESS;
+}
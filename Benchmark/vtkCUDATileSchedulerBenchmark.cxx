@@ -0,0 +1,179 @@
+/** @file vtkCUDATileSchedulerBenchmark.cxx
+*
+*  @brief Benchmark of how quickly the tile scheduler balances the bands of devices of different speeds
+*
+*  Simulates devices rendering a number of rows per millisecond each, with some noise on every frame, and feeds their
+*  times to vtkCUDATileScheduler frame after frame. Writes the bands, the imbalance (slowest time over mean time) and
+*  the frame time (that of the slowest device) of every frame as JSON, along with the frame time an even split would
+*  have. No CUDA device is needed.
+*
+*  Usage: vtkCUDATileSchedulerBenchmark [--speeds 1,1,0.5] [--rows 1080] [--frames 20] [--noise 0.05]
+*                                       [--smoothing 0.5] [--output file.json]
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDATileScheduler.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+struct BenchmarkOptions
+{
+  std::vector<double> Speeds;
+  int Rows;
+  int Frames;
+  double Noise;
+  double Smoothing;
+  std::string Output;
+};
+
+//----------------------------------------------------------------------------
+std::vector<double> SplitList(const char* list)
+{
+  std::vector<double> items;
+  std::stringstream stream(list);
+  std::string item;
+  while( std::getline(stream, item, ',') )
+    if( !item.empty() ) items.push_back(atof(item.c_str()));
+  return items;
+}
+
+//----------------------------------------------------------------------------
+// Uniform noise in [-amplitude, amplitude], the same on every run
+double Noise(unsigned int& seed, double amplitude)
+{
+  seed = seed * 1664525u + 1013904223u;
+  return amplitude * (2.0 * (double) ((seed >> 8) % 65536u) / 65535.0 - 1.0);
+}
+
+//----------------------------------------------------------------------------
+bool ParseArguments(int argc, char* argv[], BenchmarkOptions& options)
+{
+  options.Speeds = SplitList("1,1,0.5");
+  options.Rows = 1080;
+  options.Frames = 20;
+  options.Noise = 0.05;
+  options.Smoothing = 0.5;
+
+  for( int i = 1; i < argc; i++ )
+    {
+    std::string arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i+1] : 0;
+    if( !value )
+      {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return false;
+      }
+    if( arg == "--speeds" ) options.Speeds = SplitList(value);
+    else if( arg == "--rows" ) options.Rows = atoi(value);
+    else if( arg == "--frames" ) options.Frames = atoi(value);
+    else if( arg == "--noise" ) options.Noise = atof(value);
+    else if( arg == "--smoothing" ) options.Smoothing = atof(value);
+    else if( arg == "--output" ) options.Output = value;
+    else
+      {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      return false;
+      }
+    i++;
+    }
+
+  for( size_t d = 0; d < options.Speeds.size(); d++ )
+    {
+    if( !(options.Speeds[d] > 0.0) )
+      {
+      std::cerr << "Device speeds must be positive" << std::endl;
+      return false;
+      }
+    }
+  return !options.Speeds.empty() && options.Rows > 0 && options.Frames > 0 && options.Noise >= 0.0 && options.Noise < 1.0;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  BenchmarkOptions options;
+  if( !ParseArguments(argc, argv, options) )
+    {
+    std::cerr << "Usage: " << argv[0] << " [--speeds 1,1,0.5] [--rows 1080] [--frames 20] [--noise 0.05]"
+              << " [--smoothing 0.5] [--output file.json]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const int devices = (int) options.Speeds.size();
+  vtkSmartPointer<vtkCUDATileScheduler> scheduler = vtkSmartPointer<vtkCUDATileScheduler>::New();
+  scheduler->SetNumberOfDevices(devices);
+  scheduler->SetSmoothing(options.Smoothing);
+
+  //an even split is as slow as its slowest device
+  double evenFrameTime = 0.0;
+  for( int d = 0; d < devices; d++ )
+    {
+    double time = ((double) options.Rows / (double) devices) / options.Speeds[d];
+    evenFrameTime = (time > evenFrameTime) ? time : evenFrameTime;
+    }
+
+  std::ostringstream json;
+  json << "{\n  \"benchmark\": \"vtkCUDATileScheduler\",\n"
+       << "  \"devices\": " << devices << ",\n"
+       << "  \"rows\": " << options.Rows << ",\n"
+       << "  \"even_split_frame_ms\": " << evenFrameTime << ",\n"
+       << "  \"frames\": [\n";
+
+  unsigned int seed = 12345;
+  for( int f = 0; f < options.Frames; f++ )
+    {
+    //each simulated device renders its band at its speed, give or take the noise
+    double frameTime = 0.0;
+    std::ostringstream bands;
+    for( int d = 0; d < devices; d++ )
+      {
+      int tile[2];
+      scheduler->GetTile(d, options.Rows, tile);
+      double time = (double) tile[1] / options.Speeds[d] * (1.0 + Noise(seed, options.Noise));
+      scheduler->ReportTime(d, 0.001 * time);
+      frameTime = (time > frameTime) ? time : frameTime;
+      bands << (d > 0 ? ", " : "") << "[" << tile[0] << ", " << tile[1] << "]";
+      }
+    scheduler->Rebalance();
+
+    json << "    {\n"
+         << "      \"frame\": " << f << ",\n"
+         << "      \"bands\": [" << bands.str() << "],\n"
+         << "      \"imbalance\": " << scheduler->GetImbalance() << ",\n"
+         << "      \"frame_ms\": " << frameTime << "\n"
+         << "    }" << (f + 1 < options.Frames ? ",\n" : "\n");
+    }
+  json << "  ]\n}\n";
+
+  if( options.Output.empty() )
+    {
+    std::cout << json.str();
+    }
+  else
+    {
+    std::ofstream file( options.Output.c_str() );
+    if( !file )
+      {
+      std::cerr << "Cannot write " << options.Output << std::endl;
+      return EXIT_FAILURE;
+      }
+    file << json.str();
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,590 @@
+/** @file vtkCUDAVolumeMapperBenchmark.cxx
+*
+*  @brief Headless benchmark of the vtkCUDA1DVolumeMapper render pipeline
+*
+*  Renders synthetic volumes (sphere, gradient ramp, noise and a CT-like phantom) from a scripted camera orbit into an
+*  off-screen image, with no render window or OpenGL context, and writes the per-stage timings, samples per second, the share of samples leapt over by
+*  empty space skipping and frame latency percentiles as JSON.
+*  With several timepoints the volume beats like a cardiac cine sequence, the frame changing with every render, and the
+*  playback rate and the hit rate of the device frame cache are reported as well.
+*  A bricked volume reports how many of its bricks were streamed to the device, and how many the last render still missed.
+*  On machines without a CUDA device the mapper falls back to its CPU backend, so the numbers can be tracked from any
+*  build machine, headless or not. With --window 1 the frames are rendered through an off-screen render window instead,
+*  which the interop display and the depth buffer readback need. With the mock runtime, the CPU backend renders while the device calls of the host code are answered and
+*  counted by vtkCUDAMockRuntime, and the allocations, copies and synchronizations per frame are reported, so a change
+*  making a frame allocate or copy more shows up without any device.
+*
+*  Usage: vtkCUDAVolumeMapperBenchmark [--volumes sphere,ramp,noise,phantom] [--sizes 128,256,512,1024] [--frames 36]
+*                                      [--width 512] [--height 512] [--backend cuda|cpu] [--threads n]
+*                                      [--sampling spacing|footprint] [--sample-distance 1.0] [--display interop|copy]
+*                                      [--latency 0|1] [--block auto|16x16] [--timepoints 1] [--cache-budget MB]
+*                                      [--prefetch 1] [--bricking auto|on|off] [--brick-loads 64] [--runtime cuda|mock]
+*                                      [--window 0|1] [--output file.json]
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDA1DVolumeMapper.h"
+#include "vtkCUDABrickManager.h"
+#include "vtkCUDAFrameCache.h"
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAHostThreadPool.h"
+#include "vtkCUDAMockRuntime.h"
+
+// VTK includes
+#include <vtkCamera.h>
+#include <vtkColorTransferFunction.h>
+#include <vtkImageData.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+#include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+struct BenchmarkOptions
+{
+  std::vector<std::string> Volumes;
+  std::vector<int> Sizes;
+  int Frames;
+  int Width;
+  int Height;
+  int Backend;
+  int Threads;
+  int Sampling;
+  float SampleDistance;
+  bool InteropDisplay;
+  bool OneFrameLatency;
+  int BlockShape[2];
+  int Timepoints;
+  double CacheBudget;
+  int Prefetch;
+  int Bricking;
+  int BrickLoads;
+  bool MockRuntime;
+  bool Window;
+  std::string Output;
+};
+
+//----------------------------------------------------------------------------
+std::vector<std::string> SplitList(const char* list)
+{
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while( std::getline(stream, item, ',') )
+    if( !item.empty() ) items.push_back(item);
+  return items;
+}
+
+//----------------------------------------------------------------------------
+// 12-bit CT-like intensities: value = HU + 1024
+const double AirValue = 0.0;
+const double WaterValue = 1024.0;
+
+//----------------------------------------------------------------------------
+// A soft edged sphere filling most of the volume
+double SphereValue(double x, double y, double z)
+{
+  double r = std::sqrt(x*x + y*y + z*z);
+  double edge = 1.0 / (1.0 + std::exp( (r - 0.8) * 40.0 ));
+  return AirValue + edge * 2000.0;
+}
+
+//----------------------------------------------------------------------------
+// A linear ramp along the diagonal, which makes every ray composite a long way into the volume
+double RampValue(double x, double y, double z)
+{
+  return 2000.0 * (x + y + z + 3.0) / 6.0;
+}
+
+//----------------------------------------------------------------------------
+// Deterministic white noise, the worst case for early ray termination and caching
+double NoiseValue(unsigned int& seed)
+{
+  seed = seed * 1664525u + 1013904223u;
+  return 2000.0 * (double) (seed >> 8) / (double) (1u << 24);
+}
+
+//----------------------------------------------------------------------------
+// The 3D Shepp-Logan head phantom (Kak & Slaney), with the densities scaled to HU
+double PhantomValue(double x, double y, double z)
+{
+  // centre (x,y,z), semi-axes (a,b,c), rotation about z (degrees), density
+  static const double ellipsoids[10][8] = {
+    {  0.0,    0.0,    0.0,   0.69,  0.92,  0.9,   0.0,  2.0 },
+    {  0.0,    0.0,    0.0,   0.6624,0.874, 0.88,  0.0, -0.98 },
+    { -0.22,   0.0,   -0.25,  0.41,  0.16,  0.21, 72.0, -0.02 },
+    {  0.22,   0.0,   -0.25,  0.31,  0.11,  0.22,-72.0, -0.02 },
+    {  0.0,    0.35,  -0.25,  0.21,  0.25,  0.5,   0.0,  0.02 },
+    {  0.0,    0.1,   -0.25,  0.046, 0.046, 0.046, 0.0,  0.02 },
+    { -0.08,  -0.65,  -0.25,  0.046, 0.023, 0.02,  0.0,  0.01 },
+    {  0.06,  -0.65,  -0.25,  0.046, 0.023, 0.02, 90.0,  0.01 },
+    {  0.06,  -0.105,  0.625, 0.056, 0.04,  0.1,  90.0,  0.02 },
+    {  0.0,    0.1,    0.625, 0.056, 0.056, 0.1,   0.0, -0.02 } };
+
+  double density = 0.0;
+  for( int i = 0; i < 10; i++ )
+    {
+    const double* e = ellipsoids[i];
+    double theta = e[6] * 3.14159265358979 / 180.0;
+    double dx = x - e[0];
+    double dy = y - e[1];
+    double dz = z - e[2];
+    double rx = ( dx*std::cos(theta) + dy*std::sin(theta) ) / e[3];
+    double ry = (-dx*std::sin(theta) + dy*std::cos(theta) ) / e[4];
+    double rz = dz / e[5];
+    if( rx*rx + ry*ry + rz*rz <= 1.0 ) density += e[7];
+    }
+
+  //map air to 0, soft tissue (1.02) to around water and bone (2.0) to around 2000
+  return (density <= 0.0) ? AirValue : WaterValue * density;
+}
+
+//----------------------------------------------------------------------------
+// The timepoint-th of a sequence of volumes beating once, the structures swelling by up to 10%
+vtkImageData* CreateVolume(const std::string& kind, int size, int timepoint, int timepoints)
+{
+  vtkImageData* image = vtkImageData::New();
+  image->SetDimensions(size, size, size);
+  image->SetSpacing(1.0, 1.0, 1.0);
+  image->SetOrigin(0.0, 0.0, 0.0);
+  image->SetScalarTypeToUnsignedShort();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+
+  unsigned short* voxels = static_cast<unsigned short*>( image->GetScalarPointer() );
+  unsigned int seed = 12345u + (unsigned int) timepoint;
+  const double beat = 1.0 + 0.1 * std::sin( 2.0 * 3.14159265358979 * (double) timepoint / (double) timepoints );
+  const double scale = 2.0 / (double) (size - 1) / beat;
+  for( int k = 0; k < size; k++ )
+    {
+    double z = k * scale - 1.0 / beat;
+    for( int j = 0; j < size; j++ )
+      {
+      double y = j * scale - 1.0 / beat;
+      for( int i = 0; i < size; i++, voxels++ )
+        {
+        double x = i * scale - 1.0 / beat;
+        double value = 0.0;
+        if( kind == "sphere" )       value = SphereValue(x, y, z);
+        else if( kind == "ramp" )    value = RampValue(x, y, z);
+        else if( kind == "noise" )   value = NoiseValue(seed);
+        else                         value = PhantomValue(x, y, z);
+        value = (value < 0.0) ? 0.0 : (value > 4095.0 ? 4095.0 : value);
+        *voxels = (unsigned short) value;
+        }
+      }
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+// Nearest rank percentile of already sorted values
+double Percentile(const std::vector<double>& sorted, double p)
+{
+  if( sorted.empty() ) return 0.0;
+  size_t rank = (size_t) std::ceil( p * (double) sorted.size() );
+  rank = (rank < 1) ? 1 : (rank > sorted.size() ? sorted.size() : rank);
+  return sorted[rank - 1];
+}
+
+//----------------------------------------------------------------------------
+double Mean(const std::vector<cudaRenderStatistics>& frames, double cudaRenderStatistics::* field)
+{
+  if( frames.empty() ) return 0.0;
+  double sum = 0.0;
+  for( size_t i = 0; i < frames.size(); i++ )
+    sum += frames[i].*field;
+  return sum / (double) frames.size();
+}
+
+//----------------------------------------------------------------------------
+void WriteRun(std::ostream& os, const std::string& kind, int size, const BenchmarkOptions& options,
+              int backend, const std::vector<cudaRenderStatistics>& frames, const std::vector<double>& latencies,
+              const std::vector<double>& frameChanges, vtkCUDAFrameCache* frameCache, bool bricked,
+              vtkCUDABrickManager* bricks, vtkCUDAMockRuntime* runtime)
+{
+  std::vector<double> sorted(latencies);
+  std::sort(sorted.begin(), sorted.end());
+  double totalTime = 0.0;
+  double totalSamples = 0.0;
+  double totalSkippedSamples = 0.0;
+  double savedRayBytes = 0.0;
+  double totalFrameChangeTime = 0.0;
+  for( size_t i = 0; i < frames.size(); i++ )
+    {
+    totalTime += latencies[i];
+    totalFrameChangeTime += frameChanges[i];
+    totalSamples += frames[i].NumberOfSamples;
+    totalSkippedSamples += frames[i].NumberOfSkippedSamples;
+
+    //the rays used to go through seven float arrays, written by the ray formation and read back by the compositing
+    if( backend == vtkCUDAVolumeMapper::CUDA_BACKEND )
+      savedRayBytes += 2.0 * 7.0 * sizeof(float) * frames[i].NumberOfRays - frames[i].RayBufferBytes;
+    }
+
+  const char* bricking = (options.Bricking == vtkCUDA1DVolumeMapper::BRICKING_ON) ? "on" :
+                         (options.Bricking == vtkCUDA1DVolumeMapper::BRICKING_OFF) ? "off" : "auto";
+
+  std::ostringstream blockShape;
+  if( options.BlockShape[0] > 0 ) blockShape << options.BlockShape[0] << "x" << options.BlockShape[1];
+  else blockShape << "auto";
+
+  os << "    {\n"
+     << "      \"volume\": \"" << kind << "\",\n"
+     << "      \"size\": [" << size << ", " << size << ", " << size << "],\n"
+     << "      \"backend\": \"" << (backend == vtkCUDAVolumeMapper::CPU_BACKEND ? "cpu" : "cuda") << "\",\n"
+     << "      \"viewport\": [" << options.Width << ", " << options.Height << "],\n"
+     << "      \"window\": " << (options.Window ? "true" : "false") << ",\n"
+     << "      \"sampling\": \"" << (options.Sampling == vtkCUDAVolumeMapper::VOXEL_FOOTPRINT_SAMPLING ? "footprint" : "spacing") << "\",\n"
+     << "      \"sample_distance\": " << options.SampleDistance << ",\n"
+     << "      \"interop_display_ratio\": " << Mean(frames, &cudaRenderStatistics::InteropDisplay) << ",\n"
+     << "      \"one_frame_latency\": " << (options.OneFrameLatency ? "true" : "false") << ",\n"
+     << "      \"block_shape\": \"" << blockShape.str() << "\",\n"
+     << "      \"readback_bytes_per_frame\": " << Mean(frames, &cudaRenderStatistics::BytesReadBack) << ",\n"
+     << "      \"zbuffer_readback_ratio\": " << Mean(frames, &cudaRenderStatistics::ZBufferCollected) << ",\n"
+     << "      \"zbuffer_allocations_per_frame\": " << Mean(frames, &cudaRenderStatistics::ZBufferAllocations) << ",\n"
+     << "      \"timepoints\": " << options.Timepoints << ",\n"
+     << "      \"frame_cache\": { \"budget_mb\": " << options.CacheBudget
+     << ", \"capacity\": " << frameCache->GetCapacity()
+     << ", \"prefetched_frames\": " << options.Prefetch
+     << ", \"hits\": " << frameCache->GetNumberOfHits()
+     << ", \"misses\": " << frameCache->GetNumberOfMisses()
+     << ", \"hit_rate\": " << frameCache->GetHitRate() << " },\n"
+     << "      \"bricks\": { \"mode\": \"" << bricking << "\""
+     << ", \"bricked\": " << (bricked ? "true" : "false")
+     << ", \"bricks\": " << (bricked ? bricks->GetNumberOfBricks() : 0)
+     << ", \"slots\": " << (bricked ? bricks->GetNumberOfSlots() : 0)
+     << ", \"resident\": " << (bricked ? bricks->GetNumberOfResidentBricks() : 0)
+     << ", \"missing\": " << (bricked ? bricks->GetNumberOfMissingBricks() : 0)
+     << ", \"loads\": " << (bricked ? bricks->GetNumberOfLoads() : 0)
+     << ", \"evictions\": " << (bricked ? bricks->GetNumberOfEvictions() : 0) << " },\n"
+     << "      \"frames\": " << frames.size() << ",\n";
+  if( runtime )
+    {
+    const double perFrame = frames.empty() ? 0.0 : 1.0 / (double) frames.size();
+    os << "      \"mock_runtime\": { \"allocations_per_frame\": " << perFrame * runtime->GetNumberOfAllocations()
+       << ", \"frees_per_frame\": " << perFrame * runtime->GetNumberOfFrees()
+       << ", \"host_allocations_per_frame\": " << perFrame * runtime->GetNumberOfHostAllocations()
+       << ", \"bytes_to_device_per_frame\": " << perFrame * (double) runtime->GetBytesCopiedToDevice()
+       << ", \"bytes_to_host_per_frame\": " << perFrame * (double) runtime->GetBytesCopiedToHost()
+       << ", \"synchronizations_per_frame\": " << perFrame * runtime->GetNumberOfSynchronizations()
+       << ", \"peak_device_bytes\": " << runtime->GetPeakDeviceBytes()
+       << ", \"invalid_calls\": " << runtime->GetNumberOfInvalidCalls() << " },\n";
+    }
+  os << "      \"stages_ms\": {\n"
+     << "        \"frame_change\": " << (frames.empty() ? 0.0 : 1000.0 * totalFrameChangeTime / (double) frames.size()) << ",\n"
+     << "        \"zbuffer_load\": " << 1000.0 * Mean(frames, &cudaRenderStatistics::ZBufferTime) << ",\n"
+     << "        \"compute_matrices\": " << 1000.0 * Mean(frames, &cudaRenderStatistics::ComputeMatricesTime) << ",\n"
+     << "        \"ray_formation\": " << 1000.0 * Mean(frames, &cudaRenderStatistics::RayFormationTime) << ",\n"
+     << "        \"compositing\": " << 1000.0 * Mean(frames, &cudaRenderStatistics::CompositingTime) << ",\n"
+     << "        \"readback\": " << 1000.0 * Mean(frames, &cudaRenderStatistics::ReadbackTime) << ",\n"
+     << "        \"display\": " << 1000.0 * Mean(frames, &cudaRenderStatistics::DisplayTime) << ",\n"
+     << "        \"mapper_render\": " << 1000.0 * Mean(frames, &cudaRenderStatistics::FrameTime) << "\n"
+     << "      },\n"
+     << "      \"rays_per_frame\": " << Mean(frames, &cudaRenderStatistics::NumberOfRays) << ",\n"
+     << "      \"samples_per_frame\": " << Mean(frames, &cudaRenderStatistics::NumberOfSamples) << ",\n"
+     << "      \"skipped_samples_per_frame\": " << Mean(frames, &cudaRenderStatistics::NumberOfSkippedSamples) << ",\n"
+     << "      \"ray_buffer_bytes_per_frame\": " << Mean(frames, &cudaRenderStatistics::RayBufferBytes) << ",\n"
+     << "      \"ray_buffer_bytes_saved_per_frame\": " << (frames.empty() ? 0.0 : savedRayBytes / (double) frames.size()) << ",\n"
+     << "      \"skipped_sample_ratio\": " << (totalSamples > 0.0 ? totalSkippedSamples / totalSamples : 0.0) << ",\n"
+     << "      \"samples_per_second\": " << (totalTime > 0.0 ? totalSamples / totalTime : 0.0) << ",\n"
+     << "      \"frames_per_second\": " << (totalTime > 0.0 ? (double) frames.size() / totalTime : 0.0) << ",\n"
+     << "      \"playback_frames_per_second\": " << (totalTime + totalFrameChangeTime > 0.0 ? (double) frames.size() / (totalTime + totalFrameChangeTime) : 0.0) << ",\n"
+     << "      \"latency_ms\": { \"p50\": " << 1000.0 * Percentile(sorted, 0.50)
+     << ", \"p99\": " << 1000.0 * Percentile(sorted, 0.99)
+     << ", \"max\": " << 1000.0 * (sorted.empty() ? 0.0 : sorted.back()) << " }\n"
+     << "    }";
+}
+
+//----------------------------------------------------------------------------
+// Renders a frame through the window if there is one, or straight into the mapper's off-screen image
+void RenderFrame(vtkRenderWindow* window, vtkRenderer* renderer, vtkCUDAVolumeMapper* mapper, vtkVolume* volume)
+{
+  if( window ) window->Render();
+  else mapper->Render(renderer, volume);
+}
+
+//----------------------------------------------------------------------------
+bool ParseArguments(int argc, char* argv[], BenchmarkOptions& options)
+{
+  options.Volumes = SplitList("sphere,ramp,noise,phantom");
+  options.Sizes.push_back(128);
+  options.Sizes.push_back(256);
+  options.Sizes.push_back(512);
+  options.Sizes.push_back(1024);
+  options.Frames = 36;
+  options.Width = 512;
+  options.Height = 512;
+  options.Backend = -1;
+  options.Threads = 0;
+  options.Sampling = vtkCUDAVolumeMapper::MINIMUM_SPACING_SAMPLING;
+  options.SampleDistance = 1.0f;
+  options.InteropDisplay = true;
+  options.OneFrameLatency = false;
+  options.BlockShape[0] = options.BlockShape[1] = 0;
+  options.Timepoints = 1;
+  options.CacheBudget = 0.0;
+  options.Prefetch = 1;
+  options.Bricking = vtkCUDA1DVolumeMapper::BRICKING_AUTO;
+  options.BrickLoads = 64;
+  options.MockRuntime = false;
+  options.Window = false;
+
+  for( int i = 1; i < argc; i++ )
+    {
+    std::string arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i+1] : 0;
+    if( !value )
+      {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return false;
+      }
+    if( arg == "--volumes" ) options.Volumes = SplitList(value);
+    else if( arg == "--sizes" )
+      {
+      std::vector<std::string> sizes = SplitList(value);
+      options.Sizes.clear();
+      for( size_t s = 0; s < sizes.size(); s++ )
+        options.Sizes.push_back( atoi(sizes[s].c_str()) );
+      }
+    else if( arg == "--frames" ) options.Frames = atoi(value);
+    else if( arg == "--width" ) options.Width = atoi(value);
+    else if( arg == "--height" ) options.Height = atoi(value);
+    else if( arg == "--backend" )
+      options.Backend = (std::string(value) == "cpu") ? vtkCUDAVolumeMapper::CPU_BACKEND : vtkCUDAVolumeMapper::CUDA_BACKEND;
+    else if( arg == "--threads" ) options.Threads = atoi(value);
+    else if( arg == "--sampling" )
+      options.Sampling = (std::string(value) == "footprint") ? vtkCUDAVolumeMapper::VOXEL_FOOTPRINT_SAMPLING : vtkCUDAVolumeMapper::MINIMUM_SPACING_SAMPLING;
+    else if( arg == "--sample-distance" ) options.SampleDistance = (float) atof(value);
+    else if( arg == "--display" ) options.InteropDisplay = (std::string(value) != "copy");
+    else if( arg == "--latency" ) options.OneFrameLatency = (atoi(value) != 0);
+    else if( arg == "--block" )
+      {
+      options.BlockShape[0] = options.BlockShape[1] = 0;
+      if( std::string(value) != "auto" && (sscanf(value, "%dx%d", &options.BlockShape[0], &options.BlockShape[1]) != 2 ||
+          options.BlockShape[0] < 1 || options.BlockShape[1] < 1) )
+        {
+        std::cerr << "Block shapes are auto or WxH" << std::endl;
+        return false;
+        }
+      }
+    else if( arg == "--timepoints" ) options.Timepoints = atoi(value);
+    else if( arg == "--cache-budget" ) options.CacheBudget = atof(value);
+    else if( arg == "--prefetch" ) options.Prefetch = atoi(value);
+    else if( arg == "--bricking" )
+      options.Bricking = (std::string(value) == "on") ? vtkCUDA1DVolumeMapper::BRICKING_ON :
+                         (std::string(value) == "off") ? vtkCUDA1DVolumeMapper::BRICKING_OFF : vtkCUDA1DVolumeMapper::BRICKING_AUTO;
+    else if( arg == "--brick-loads" ) options.BrickLoads = atoi(value);
+    else if( arg == "--runtime" ) options.MockRuntime = (std::string(value) == "mock");
+    else if( arg == "--window" ) options.Window = (atoi(value) != 0);
+    else if( arg == "--output" ) options.Output = value;
+    else
+      {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      return false;
+      }
+    i++;
+    }
+
+  for( size_t v = 0; v < options.Volumes.size(); v++ )
+    {
+    const std::string& kind = options.Volumes[v];
+    if( kind != "sphere" && kind != "ramp" && kind != "noise" && kind != "phantom" )
+      {
+      std::cerr << "Unknown volume " << kind << std::endl;
+      return false;
+      }
+    }
+  for( size_t s = 0; s < options.Sizes.size(); s++ )
+    {
+    if( options.Sizes[s] < 2 )
+      {
+      std::cerr << "Volume sizes must be at least 2" << std::endl;
+      return false;
+      }
+    }
+  return options.Frames > 0 && options.Width > 0 && options.Height > 0 && options.SampleDistance > 0.0f &&
+         options.Timepoints > 0 && options.CacheBudget >= 0.0 && options.Prefetch >= 0 && options.BrickLoads > 0;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  BenchmarkOptions options;
+  if( !ParseArguments(argc, argv, options) )
+    {
+    std::cerr << "Usage: " << argv[0] << " [--volumes sphere,ramp,noise,phantom] [--sizes 128,256,512,1024] [--frames 36]"
+              << " [--width 512] [--height 512] [--backend cuda|cpu] [--threads n]"
+              << " [--sampling spacing|footprint] [--sample-distance 1.0] [--display interop|copy]"
+              << " [--latency 0|1] [--block auto|16x16] [--timepoints 1] [--cache-budget MB] [--prefetch 1]"
+              << " [--bricking auto|on|off] [--brick-loads 64] [--runtime cuda|mock] [--window 0|1]"
+              << " [--output file.json]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //the mock runtime has to be in place before the first CUDA object takes a device, and runs no kernel
+  vtkSmartPointer<vtkCUDAMockRuntime> runtime;
+  if( options.MockRuntime )
+    {
+    runtime = vtkSmartPointer<vtkCUDAMockRuntime>::New();
+    vtkCUDADeviceManager::Singleton()->SetRuntime(runtime);
+    options.Backend = vtkCUDAVolumeMapper::CPU_BACKEND;
+    }
+
+  //transfer functions suited to the 12-bit CT-like intensities of every synthetic volume
+  vtkSmartPointer<vtkColorTransferFunction> colour = vtkSmartPointer<vtkColorTransferFunction>::New();
+  colour->AddRGBPoint(0.0, 0.0, 0.0, 0.0);
+  colour->AddRGBPoint(900.0, 0.55, 0.25, 0.15);
+  colour->AddRGBPoint(1100.0, 0.88, 0.60, 0.29);
+  colour->AddRGBPoint(2000.0, 1.0, 0.94, 0.95);
+  colour->AddRGBPoint(4095.0, 1.0, 1.0, 1.0);
+  vtkSmartPointer<vtkPiecewiseFunction> opacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  opacity->AddPoint(0.0, 0.0);
+  opacity->AddPoint(500.0, 0.0);
+  opacity->AddPoint(1000.0, 0.05);
+  opacity->AddPoint(1500.0, 0.2);
+  opacity->AddPoint(4095.0, 0.8);
+  vtkSmartPointer<vtkPiecewiseFunction> gradientOpacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  gradientOpacity->AddPoint(0.0, 1.0);
+  gradientOpacity->AddPoint(4095.0, 1.0);
+
+  vtkSmartPointer<vtkVolumeProperty> property = vtkSmartPointer<vtkVolumeProperty>::New();
+  property->SetColor(colour);
+  property->SetScalarOpacity(opacity);
+  property->SetGradientOpacity(gradientOpacity);
+  property->SetInterpolationTypeToLinear();
+  property->ShadeOn();
+
+  std::ostringstream json;
+  json << "{\n  \"benchmark\": \"vtkCUDA1DVolumeMapper\",\n  \"runs\": [\n";
+  bool firstRun = true;
+
+  for( size_t s = 0; s < options.Sizes.size(); s++ )
+    {
+    for( size_t v = 0; v < options.Volumes.size(); v++ )
+      {
+      const std::string& kind = options.Volumes[v];
+      const int size = options.Sizes[s];
+      std::cerr << "Rendering " << kind << " " << size << "^3..." << std::endl;
+
+      std::vector<vtkImageData*> images;
+      for( int t = 0; t < options.Timepoints; t++ )
+        images.push_back( CreateVolume(kind, size, t, options.Timepoints) );
+
+      //a fresh pipeline per run, so that no run is charged for the previous one's buffers
+      vtkSmartPointer<vtkCUDA1DVolumeMapper> mapper = vtkSmartPointer<vtkCUDA1DVolumeMapper>::New();
+      if( options.Backend != -1 ) mapper->SetRenderBackend(options.Backend);
+      if( options.Threads > 0 ) mapper->GetHostThreadPool()->SetNumberOfThreads(options.Threads);
+      mapper->SetSamplingMode(options.Sampling);
+      mapper->SetSampleDistanceFactor(options.SampleDistance);
+      mapper->SetInteropDisplay(options.InteropDisplay);
+      mapper->SetOneFrameLatency(options.OneFrameLatency);
+      mapper->SetAutoTuneBlockShape(options.BlockShape[0] == 0);
+      if( options.BlockShape[0] > 0 ) mapper->SetBlockShape(options.BlockShape[0], options.BlockShape[1]);
+      mapper->SetFrameCacheBudget(options.CacheBudget);
+      mapper->SetNumberOfPrefetchedFrames(options.Prefetch);
+      mapper->SetBrickingMode(options.Bricking);
+      mapper->SetMaximumNumberOfBrickLoads(options.BrickLoads);
+      for( int t = 0; t < options.Timepoints; t++ )
+        mapper->SetInput(images[t], t);
+      mapper->SetCollectStatistics(true);
+
+      vtkSmartPointer<vtkVolume> volume = vtkSmartPointer<vtkVolume>::New();
+      volume->SetMapper(mapper);
+      volume->SetProperty(property);
+
+      vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+      renderer->AddVolume(volume);
+      renderer->SetBackground(0.0, 0.0, 0.0);
+
+      //the image is left in host memory unless asked to go through a window, so no display or OpenGL is needed
+      vtkSmartPointer<vtkRenderWindow> window;
+      if( options.Window )
+        {
+        window = vtkSmartPointer<vtkRenderWindow>::New();
+        window->SetOffScreenRendering(1);
+        window->SetSize(options.Width, options.Height);
+        window->AddRenderer(renderer);
+        }
+      else
+        {
+        mapper->SetOffScreenImageSize(options.Width, options.Height);
+        }
+
+      renderer->ResetCamera();
+      vtkCamera* camera = renderer->GetActiveCamera();
+      camera->Elevation(20.0);
+      renderer->ResetCameraClippingRange();
+
+      //warm up (first texture uploads, lookup tables and buffer allocation)
+      RenderFrame(window, renderer, mapper, volume);
+      mapper->GetFrameCache()->ResetStatistics();
+      mapper->GetBrickManager()->ResetStatistics();
+      if( runtime ) runtime->ResetCounters();
+
+      //play the sequence back while orbiting, one timepoint per render
+      std::vector<cudaRenderStatistics> frames;
+      std::vector<double> latencies;
+      std::vector<double> frameChanges;
+      for( int f = 0; f < options.Frames; f++ )
+        {
+        camera->Azimuth(360.0 / options.Frames);
+        renderer->ResetCameraClippingRange();
+        double change = vtkTimerLog::GetUniversalTime();
+        if( options.Timepoints > 1 ) mapper->ChangeFrame( (f + 1) % options.Timepoints );
+        double start = vtkTimerLog::GetUniversalTime();
+        RenderFrame(window, renderer, mapper, volume);
+        latencies.push_back( vtkTimerLog::GetUniversalTime() - start );
+        frameChanges.push_back( start - change );
+        frames.push_back( mapper->GetRenderStatistics() );
+        }
+
+      if( !firstRun ) json << ",\n";
+      firstRun = false;
+      WriteRun(json, kind, size, options, mapper->GetRenderBackend(), frames, latencies, frameChanges, mapper->GetFrameCache(),
+               mapper->IsBricked(), mapper->GetBrickManager(), runtime);
+
+      renderer->RemoveVolume(volume);
+      for( int t = 0; t < options.Timepoints; t++ )
+        images[t]->Delete();
+      }
+    }
+  json << "\n  ]\n}\n";
+
+  if( options.Output.empty() )
+    {
+    std::cout << json.str();
+    }
+  else
+    {
+    std::ofstream file( options.Output.c_str() );
+    if( !file )
+      {
+      std::cerr << "Cannot write " << options.Output << std::endl;
+      return EXIT_FAILURE;
+      }
+    file << json.str();
+    }
+  return EXIT_SUCCESS;
+}
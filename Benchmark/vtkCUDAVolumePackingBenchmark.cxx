@@ -0,0 +1,227 @@
+/** @file vtkCUDAVolumePackingBenchmark.cxx
+*
+*  @brief Benchmark of the host conversion of VTK scalars into the voxel formats the ray casters sample
+*
+*  Converts a synthetic buffer of each scalar type with CPU_vtkCUDAVolumeMapper_packImageParallel, once on the calling
+*  thread and once on the host thread pool, and writes the conversion throughput in GB/s (of input read) as JSON.
+*  No CUDA device is needed.
+*
+*  Usage: vtkCUDAVolumePackingBenchmark [--types char,uchar,short,ushort,int,uint,float,double] [--voxels 64]
+*                                       [--repeats 5] [--threads n] [--output file.json]
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "CPU_vtkCUDAVolumeMapper_packImage.h"
+#include "vtkCUDAHostThreadPool.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+#include <vtkType.h>
+
+// STD includes
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+struct BenchmarkOptions
+{
+  std::vector<std::string> Types;
+  double MegaVoxels;
+  int Repeats;
+  int Threads;
+  std::string Output;
+};
+
+//----------------------------------------------------------------------------
+std::vector<std::string> SplitList(const char* list)
+{
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while( std::getline(stream, item, ',') )
+    if( !item.empty() ) items.push_back(item);
+  return items;
+}
+
+//----------------------------------------------------------------------------
+int ScalarTypeFromName(const std::string& name)
+{
+  if( name == "char" ) return VTK_SIGNED_CHAR;
+  if( name == "uchar" ) return VTK_UNSIGNED_CHAR;
+  if( name == "short" ) return VTK_SHORT;
+  if( name == "ushort" ) return VTK_UNSIGNED_SHORT;
+  if( name == "int" ) return VTK_INT;
+  if( name == "uint" ) return VTK_UNSIGNED_INT;
+  if( name == "float" ) return VTK_FLOAT;
+  if( name == "double" ) return VTK_DOUBLE;
+  return -1;
+}
+
+//----------------------------------------------------------------------------
+// Fills the buffer with 12-bit CT-like values, centred on zero for the signed types
+template< class T >
+void FillBuffer(T* buffer, size_t numberOfVoxels, double low, double scalarRange[2])
+{
+  unsigned int seed = 12345;
+  for( size_t i = 0; i < numberOfVoxels; i++ )
+    {
+    seed = seed * 1664525u + 1013904223u;
+    buffer[i] = (T) ( low + (double) ((seed >> 8) % 4096u) );
+    }
+  scalarRange[0] = low;
+  scalarRange[1] = low + 4095.0;
+}
+
+//----------------------------------------------------------------------------
+void FillBuffer(int scalarType, void* buffer, size_t numberOfVoxels, double scalarRange[2])
+{
+  switch( scalarType )
+    {
+    case VTK_SIGNED_CHAR:    FillBuffer( (signed char*) buffer, numberOfVoxels, -128.0, scalarRange ); scalarRange[1] = 127.0; break;
+    case VTK_UNSIGNED_CHAR:  FillBuffer( (unsigned char*) buffer, numberOfVoxels, 0.0, scalarRange ); scalarRange[1] = 255.0; break;
+    case VTK_SHORT:          FillBuffer( (short*) buffer, numberOfVoxels, -2048.0, scalarRange ); break;
+    case VTK_UNSIGNED_SHORT: FillBuffer( (unsigned short*) buffer, numberOfVoxels, 0.0, scalarRange ); break;
+    case VTK_INT:            FillBuffer( (int*) buffer, numberOfVoxels, -1024.0, scalarRange ); break;
+    case VTK_UNSIGNED_INT:   FillBuffer( (unsigned int*) buffer, numberOfVoxels, 0.0, scalarRange ); break;
+    case VTK_FLOAT:          FillBuffer( (float*) buffer, numberOfVoxels, -1024.0, scalarRange ); break;
+    case VTK_DOUBLE:         FillBuffer( (double*) buffer, numberOfVoxels, -1024.0, scalarRange ); break;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Best of the repeats, in seconds
+double TimeConversion(const void* input, int scalarType, size_t numberOfVoxels, const cudaVolumePackingInformation& packing,
+                      void* output, vtkCUDAHostThreadPool* pool, int repeats)
+{
+  double best = 0.0;
+  for( int r = 0; r < repeats; r++ )
+    {
+    double start = vtkTimerLog::GetUniversalTime();
+    CPU_vtkCUDAVolumeMapper_packImageParallel(input, scalarType, numberOfVoxels, packing, output, pool);
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    if( r == 0 || elapsed < best ) best = elapsed;
+    }
+  return best;
+}
+
+//----------------------------------------------------------------------------
+bool ParseArguments(int argc, char* argv[], BenchmarkOptions& options)
+{
+  options.Types = SplitList("char,uchar,short,ushort,int,uint,float,double");
+  options.MegaVoxels = 64.0;
+  options.Repeats = 5;
+  options.Threads = 0;
+
+  for( int i = 1; i < argc; i++ )
+    {
+    std::string arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i+1] : 0;
+    if( !value )
+      {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return false;
+      }
+    if( arg == "--types" ) options.Types = SplitList(value);
+    else if( arg == "--voxels" ) options.MegaVoxels = atof(value);
+    else if( arg == "--repeats" ) options.Repeats = atoi(value);
+    else if( arg == "--threads" ) options.Threads = atoi(value);
+    else if( arg == "--output" ) options.Output = value;
+    else
+      {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      return false;
+      }
+    i++;
+    }
+
+  for( size_t t = 0; t < options.Types.size(); t++ )
+    {
+    if( ScalarTypeFromName(options.Types[t]) == -1 )
+      {
+      std::cerr << "Unknown scalar type " << options.Types[t] << std::endl;
+      return false;
+      }
+    }
+  return options.MegaVoxels > 0.0 && options.Repeats > 0;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  BenchmarkOptions options;
+  if( !ParseArguments(argc, argv, options) )
+    {
+    std::cerr << "Usage: " << argv[0] << " [--types char,uchar,short,ushort,int,uint,float,double] [--voxels 64]"
+              << " [--repeats 5] [--threads n] [--output file.json]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkSmartPointer<vtkCUDAHostThreadPool> pool = vtkSmartPointer<vtkCUDAHostThreadPool>::New();
+  if( options.Threads > 0 ) pool->SetNumberOfThreads(options.Threads);
+  const size_t numberOfVoxels = (size_t) (options.MegaVoxels * 1024.0 * 1024.0);
+
+  std::ostringstream json;
+  json << "{\n  \"benchmark\": \"CPU_vtkCUDAVolumeMapper_packImage\",\n"
+       << "  \"voxels\": " << numberOfVoxels << ",\n"
+       << "  \"threads\": " << pool->GetNumberOfThreads() << ",\n"
+       << "  \"runs\": [\n";
+
+  for( size_t t = 0; t < options.Types.size(); t++ )
+    {
+    const int scalarType = ScalarTypeFromName(options.Types[t]);
+    std::cerr << "Converting " << options.Types[t] << "..." << std::endl;
+
+    std::vector<char> input( numberOfVoxels * CPU_vtkCUDAVolumeMapper_scalarSize(scalarType) );
+    double scalarRange[2];
+    FillBuffer(scalarType, &input[0], numberOfVoxels, scalarRange);
+    cudaVolumePackingInformation packing;
+    CPU_vtkCUDAVolumeMapper_choosePacking(scalarType, scalarRange, packing);
+    std::vector<char> output( numberOfVoxels * CPU_vtkCUDAVolumeMapper_packedVoxelSize(packing) );
+
+    //touch the output once so page faults are not timed
+    CPU_vtkCUDAVolumeMapper_packImageParallel(&input[0], scalarType, numberOfVoxels, packing, &output[0], pool);
+    double serial = TimeConversion(&input[0], scalarType, numberOfVoxels, packing, &output[0], 0, options.Repeats);
+    double pooled = TimeConversion(&input[0], scalarType, numberOfVoxels, packing, &output[0], pool, options.Repeats);
+
+    const double gigabytes = (double) input.size() / 1.0e9;
+    const char* format = packing.Format == CUDA_PACKED_UNSIGNED_CHAR ? "uchar" :
+                         packing.Format == CUDA_PACKED_UNSIGNED_SHORT ? "ushort" : "float";
+    json << "    {\n"
+         << "      \"scalar_type\": \"" << options.Types[t] << "\",\n"
+         << "      \"packed_format\": \"" << format << "\",\n"
+         << "      \"serial_ms\": " << 1000.0 * serial << ",\n"
+         << "      \"parallel_ms\": " << 1000.0 * pooled << ",\n"
+         << "      \"serial_gb_per_second\": " << (serial > 0.0 ? gigabytes / serial : 0.0) << ",\n"
+         << "      \"parallel_gb_per_second\": " << (pooled > 0.0 ? gigabytes / pooled : 0.0) << "\n"
+         << "    }" << (t + 1 < options.Types.size() ? ",\n" : "\n");
+    }
+  json << "  ]\n}\n";
+
+  if( options.Output.empty() )
+    {
+    std::cout << json.str();
+    }
+  else
+    {
+    std::ofstream file( options.Output.c_str() );
+    if( !file )
+      {
+      std::cerr << "Cannot write " << options.Output << std::endl;
+      return EXIT_FAILURE;
+      }
+    file << json.str();
+    }
+  return EXIT_SUCCESS;
+}
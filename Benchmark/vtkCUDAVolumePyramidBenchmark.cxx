@@ -0,0 +1,201 @@
+/** @file vtkCUDAVolumePyramidBenchmark.cxx
+*
+*  @brief Benchmark of the host generation of the mip pyramid the ray caster samples once a pixel covers several voxels
+*
+*  Builds the pyramid of a synthetic unsigned short cube with CPU_vtkCUDAVolumeMapper_buildPyramid for each reduction,
+*  once on the calling thread and once on the host thread pool, and writes the time taken and the throughput in
+*  voxels of input per second as JSON. No CUDA device is needed.
+*
+*  Usage: vtkCUDAVolumePyramidBenchmark [--reductions mean,max,min] [--voxels 64] [--levels 8]
+*                                       [--repeats 5] [--threads n] [--output file.json]
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "CPU_vtkCUDAVolumeMapper_pyramid.h"
+#include "vtkCUDAHostThreadPool.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+#include <vtkType.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+struct BenchmarkOptions
+{
+  std::vector<std::string> Reductions;
+  double MegaVoxels;
+  int Levels;
+  int Repeats;
+  int Threads;
+  std::string Output;
+};
+
+//----------------------------------------------------------------------------
+std::vector<std::string> SplitList(const char* list)
+{
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while( std::getline(stream, item, ',') )
+    if( !item.empty() ) items.push_back(item);
+  return items;
+}
+
+//----------------------------------------------------------------------------
+int ReductionFromName(const std::string& name)
+{
+  if( name == "mean" ) return CUDA_PYRAMID_MEAN;
+  if( name == "max" ) return CUDA_PYRAMID_MAX;
+  if( name == "min" ) return CUDA_PYRAMID_MIN;
+  return -1;
+}
+
+//----------------------------------------------------------------------------
+// Best of the repeats, in seconds
+double TimePyramid(const unsigned short* input, const int3& volumeSize, int levels, int reduction,
+                   cudaPyramidInformation& pyramid, std::vector<float>& voxels, vtkCUDAHostThreadPool* pool, int repeats)
+{
+  double best = 0.0;
+  for( int r = 0; r < repeats; r++ )
+    {
+    double start = vtkTimerLog::GetUniversalTime();
+    CPU_vtkCUDAVolumeMapper_buildPyramid(input, VTK_UNSIGNED_SHORT, volumeSize, levels, reduction, pyramid, voxels, pool);
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    if( r == 0 || elapsed < best ) best = elapsed;
+    }
+  return best;
+}
+
+//----------------------------------------------------------------------------
+bool ParseArguments(int argc, char* argv[], BenchmarkOptions& options)
+{
+  options.Reductions = SplitList("mean,max,min");
+  options.MegaVoxels = 64.0;
+  options.Levels = CUDA_MAX_PYRAMID_LEVELS;
+  options.Repeats = 5;
+  options.Threads = 0;
+
+  for( int i = 1; i < argc; i++ )
+    {
+    std::string arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i+1] : 0;
+    if( !value )
+      {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return false;
+      }
+    if( arg == "--reductions" ) options.Reductions = SplitList(value);
+    else if( arg == "--voxels" ) options.MegaVoxels = atof(value);
+    else if( arg == "--levels" ) options.Levels = atoi(value);
+    else if( arg == "--repeats" ) options.Repeats = atoi(value);
+    else if( arg == "--threads" ) options.Threads = atoi(value);
+    else if( arg == "--output" ) options.Output = value;
+    else
+      {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      return false;
+      }
+    i++;
+    }
+
+  for( size_t r = 0; r < options.Reductions.size(); r++ )
+    {
+    if( ReductionFromName(options.Reductions[r]) == -1 )
+      {
+      std::cerr << "Unknown reduction " << options.Reductions[r] << std::endl;
+      return false;
+      }
+    }
+  return options.MegaVoxels > 0.0 && options.Levels > 0 && options.Repeats > 0;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  BenchmarkOptions options;
+  if( !ParseArguments(argc, argv, options) )
+    {
+    std::cerr << "Usage: " << argv[0] << " [--reductions mean,max,min] [--voxels 64] [--levels 8]"
+              << " [--repeats 5] [--threads n] [--output file.json]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkSmartPointer<vtkCUDAHostThreadPool> pool = vtkSmartPointer<vtkCUDAHostThreadPool>::New();
+  if( options.Threads > 0 ) pool->SetNumberOfThreads(options.Threads);
+
+  //a cube of 12-bit CT-like values, with as many voxels as asked for
+  const int side = (int) std::ceil( std::pow( options.MegaVoxels * 1024.0 * 1024.0, 1.0 / 3.0 ) );
+  int3 volumeSize;
+  volumeSize.x = volumeSize.y = volumeSize.z = side;
+  const size_t numberOfVoxels = (size_t) side * (size_t) side * (size_t) side;
+  std::vector<unsigned short> input( numberOfVoxels );
+  unsigned int seed = 12345;
+  for( size_t i = 0; i < numberOfVoxels; i++ )
+    {
+    seed = seed * 1664525u + 1013904223u;
+    input[i] = (unsigned short) ((seed >> 8) % 4096u);
+    }
+
+  std::ostringstream json;
+  json << "{\n  \"benchmark\": \"CPU_vtkCUDAVolumeMapper_buildPyramid\",\n"
+       << "  \"volume_size\": [" << side << ", " << side << ", " << side << "],\n"
+       << "  \"threads\": " << pool->GetNumberOfThreads() << ",\n"
+       << "  \"runs\": [\n";
+
+  for( size_t r = 0; r < options.Reductions.size(); r++ )
+    {
+    const int reduction = ReductionFromName(options.Reductions[r]);
+    std::cerr << "Reducing by " << options.Reductions[r] << "..." << std::endl;
+
+    //build once so the levels are allocated and their page faults not timed
+    cudaPyramidInformation pyramid;
+    std::vector<float> voxels;
+    CPU_vtkCUDAVolumeMapper_buildPyramid(&input[0], VTK_UNSIGNED_SHORT, volumeSize, options.Levels, reduction,
+                                         pyramid, voxels, pool);
+    double serial = TimePyramid(&input[0], volumeSize, options.Levels, reduction, pyramid, voxels, 0, options.Repeats);
+    double pooled = TimePyramid(&input[0], volumeSize, options.Levels, reduction, pyramid, voxels, pool, options.Repeats);
+
+    const double megaVoxels = (double) numberOfVoxels / 1.0e6;
+    json << "    {\n"
+         << "      \"reduction\": \"" << options.Reductions[r] << "\",\n"
+         << "      \"levels\": " << pyramid.NumberOfLevels << ",\n"
+         << "      \"pyramid_voxels\": " << voxels.size() << ",\n"
+         << "      \"serial_ms\": " << 1000.0 * serial << ",\n"
+         << "      \"parallel_ms\": " << 1000.0 * pooled << ",\n"
+         << "      \"serial_megavoxels_per_second\": " << (serial > 0.0 ? megaVoxels / serial : 0.0) << ",\n"
+         << "      \"parallel_megavoxels_per_second\": " << (pooled > 0.0 ? megaVoxels / pooled : 0.0) << "\n"
+         << "    }" << (r + 1 < options.Reductions.size() ? ",\n" : "\n");
+    }
+  json << "  ]\n}\n";
+
+  if( options.Output.empty() )
+    {
+    std::cout << json.str();
+    }
+  else
+    {
+    std::ofstream file( options.Output.c_str() );
+    if( !file )
+      {
+      std::cerr << "Cannot write " << options.Output << std::endl;
+      return EXIT_FAILURE;
+      }
+    file << json.str();
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+/** @file CPU_vtkCUDA1DVolumeMapper_preIntegration.cxx
+*
+*  @brief Host function building the pre-integrated transfer function table of the 1D ray caster
+*
+*/
+
+#include "CPU_vtkCUDA1DVolumeMapper_preIntegration.h"
+#include "vtkCUDAHostThreadPool.h"
+
+// STD includes
+#include <cmath>
+#include <vector>
+
+/** @brief Number of intervals the integrals of the lookup tables are taken over per entry of the tables */
+#define CPU_PREINTEGRATION_SUBDIVISIONS 16
+
+/** @brief Number of parts a segment from the lowest to the highest intensity is composited in */
+#define CPU_PREINTEGRATION_SEGMENT_PARTS 64
+
+/** @brief The arguments shared by the tasks building a table, one task per intensity at the back of the segments */
+typedef struct
+{
+  const float* Alpha;
+  const float* Red;
+  const float* Green;
+  const float* Blue;
+  unsigned int FunctionSize;
+  unsigned int TableSize;
+  const double* Integrals;
+  int NumberOfIntervals;
+  float* Table;
+} CPU_vtkCUDA1DVolumeMapper_preIntegrationTask;
+
+//read a lookup table at a normalized co-ordinate as a linearly filtered, clamped texture would, with exact weights
+static double CPU_vtkCUDA1DVolumeMapper_lookUp(const float* table, int size, double u)
+{
+  double x = u * (double) size - 0.5;
+  double fx = std::floor(x);
+  double a = x - fx;
+  int i0 = (int) fx;
+  int i1 = i0 + 1;
+  i0 = i0 < 0 ? 0 : (i0 >= size ? size - 1 : i0);
+  i1 = i1 < 0 ? 0 : (i1 >= size ? size - 1 : i1);
+  return (1.0 - a) * table[i0] + a * table[i1];
+}
+
+//the extinction of a step of the smallest spacing, -ln(1-a), bounded so that an opaque entry stays finite
+static double CPU_vtkCUDA1DVolumeMapper_extinction(double alpha)
+{
+  return -std::log( alpha < 1.0 - 1e-12 ? 1.0 - alpha : 1e-12 );
+}
+
+//read the integrals of the extinction (and of the colours weighted by it) from 0 to a normalized co-ordinate
+static void CPU_vtkCUDA1DVolumeMapper_integrals(const CPU_vtkCUDA1DVolumeMapper_preIntegrationTask& args, double u, double* integrals)
+{
+  double x = u * (double) args.NumberOfIntervals;
+  int i = (int) std::floor(x);
+  i = i < 0 ? 0 : (i >= args.NumberOfIntervals ? args.NumberOfIntervals - 1 : i);
+  double a = x - (double) i;
+  const double* i0 = args.Integrals + 4 * i;
+  for( int c = 0; c < 4; c++ )
+    integrals[c] = (1.0 - a) * i0[c] + a * i0[c+4];
+}
+
+//integrate the row of segments ending at one intensity, from every intensity at their front
+static void CPU_vtkCUDA1DVolumeMapper_preIntegrateRow(int row, int, void* userData)
+{
+  const CPU_vtkCUDA1DVolumeMapper_preIntegrationTask& args = *static_cast<CPU_vtkCUDA1DVolumeMapper_preIntegrationTask*>(userData);
+  const int functionSize = (int) args.FunctionSize;
+  const double tableSize = (double) args.TableSize;
+  const double back = ((double) row + 0.5) / tableSize;
+  double backIntegrals[4];
+  CPU_vtkCUDA1DVolumeMapper_integrals(args, back, backIntegrals);
+  float* entry = args.Table + 4 * (size_t) row * (size_t) args.TableSize;
+
+  for( unsigned int column = 0; column < args.TableSize; column++, entry += 4 )
+    {
+    const double front = ((double) column + 0.5) / tableSize;
+
+    //a segment between equal intensities is a point sample, which the rays then classify as the 1D lookup tables do
+    if( row == (int) column )
+      {
+      entry[0] = (float) CPU_vtkCUDA1DVolumeMapper_lookUp(args.Red, functionSize, front);
+      entry[1] = (float) CPU_vtkCUDA1DVolumeMapper_lookUp(args.Green, functionSize, front);
+      entry[2] = (float) CPU_vtkCUDA1DVolumeMapper_lookUp(args.Blue, functionSize, front);
+      entry[3] = (float) CPU_vtkCUDA1DVolumeMapper_lookUp(args.Alpha, functionSize, front);
+      continue;
+      }
+
+    //the intensity varies linearly along the segment, so the extinction of a part of it is the mean extinction of the
+    //intensities the part crosses, and its colour their mean colour weighted by their extinction. The parts are composited
+    //front to back, so the attenuation within the segment darkens its back, short enough for that to be negligible within each.
+    const int numParts = 1 + (int) (std::fabs(back - front) * (double) CPU_PREINTEGRATION_SEGMENT_PARTS);
+    double remaining = 1.0;
+    double red = 0.0;
+    double green = 0.0;
+    double blue = 0.0;
+    double partFront[4];
+    double partBack[4];
+    CPU_vtkCUDA1DVolumeMapper_integrals(args, front, partFront);
+    for( int k = 1; k <= numParts; k++ )
+      {
+      if( k < numParts )
+        CPU_vtkCUDA1DVolumeMapper_integrals(args, front + (back - front) * (double) k / (double) numParts, partBack);
+      else
+        for( int c = 0; c < 4; c++ ) partBack[c] = backIntegrals[c];
+      const double integral = partBack[0] - partFront[0];
+      if( integral != 0.0 )
+        {
+        const double alpha = 1.0 - std::exp( -integral / (back - front) );
+        const double multiplier = remaining * alpha / integral;
+        red += multiplier * (partBack[1] - partFront[1]);
+        green += multiplier * (partBack[2] - partFront[2]);
+        blue += multiplier * (partBack[3] - partFront[3]);
+        remaining *= (1.0 - alpha);
+        }
+      for( int c = 0; c < 4; c++ ) partFront[c] = partBack[c];
+      }
+
+    //keep the mean colour rather than premultiplying it, so the rays shade it as they shade the colour of a point, or that
+    //of the middle of an empty segment so the linear filtering between entries does not darken the segments beside it
+    const double alpha = 1.0 - remaining;
+    if( alpha > 0.0 )
+      {
+      entry[0] = (float) (red / alpha);
+      entry[1] = (float) (green / alpha);
+      entry[2] = (float) (blue / alpha);
+      }
+    else
+      {
+      const double middle = 0.5 * (front + back);
+      entry[0] = (float) CPU_vtkCUDA1DVolumeMapper_lookUp(args.Red, functionSize, middle);
+      entry[1] = (float) CPU_vtkCUDA1DVolumeMapper_lookUp(args.Green, functionSize, middle);
+      entry[2] = (float) CPU_vtkCUDA1DVolumeMapper_lookUp(args.Blue, functionSize, middle);
+      }
+    entry[3] = (float) alpha;
+    }
+}
+
+void CPU_vtkCUDA1DVolumeMapper_preIntegrate(const float* alphaTable, const float* redTable, const float* greenTable,
+                                            const float* blueTable, unsigned int functionSize, unsigned int tableSize,
+                                            float* table, vtkCUDAHostThreadPool* pool)
+{
+  if( !alphaTable || !redTable || !greenTable || !blueTable || !table || functionSize == 0 || tableSize == 0 ) return;
+
+  CPU_vtkCUDA1DVolumeMapper_preIntegrationTask args;
+  args.Alpha = alphaTable;
+  args.Red = redTable;
+  args.Green = greenTable;
+  args.Blue = blueTable;
+  args.FunctionSize = functionSize;
+  args.TableSize = tableSize;
+  args.Table = table;
+
+  //integrate the extinction, and the colours weighted by it, over the intensities by the midpoint rule, in intervals
+  //fine enough for the linear interpolation between their ends to follow the entries of the lookup tables
+  args.NumberOfIntervals = CPU_PREINTEGRATION_SUBDIVISIONS * (int) functionSize;
+  std::vector<double> integrals( 4 * (args.NumberOfIntervals + 1), 0.0 );
+  const double interval = 1.0 / (double) args.NumberOfIntervals;
+  for( int i = 0; i < args.NumberOfIntervals; i++ )
+    {
+    const double u = ((double) i + 0.5) * interval;
+    const double extinction = interval * CPU_vtkCUDA1DVolumeMapper_extinction( CPU_vtkCUDA1DVolumeMapper_lookUp(alphaTable, functionSize, u) );
+    integrals[4*i+4] = integrals[4*i] + extinction;
+    integrals[4*i+5] = integrals[4*i+1] + extinction * CPU_vtkCUDA1DVolumeMapper_lookUp(redTable, functionSize, u);
+    integrals[4*i+6] = integrals[4*i+2] + extinction * CPU_vtkCUDA1DVolumeMapper_lookUp(greenTable, functionSize, u);
+    integrals[4*i+7] = integrals[4*i+3] + extinction * CPU_vtkCUDA1DVolumeMapper_lookUp(blueTable, functionSize, u);
+    }
+  args.Integrals = &(integrals[0]);
+
+  if( pool )
+    {
+    pool->ParallelFor( (int) tableSize, CPU_vtkCUDA1DVolumeMapper_preIntegrateRow, &args );
+    }
+  else
+    {
+    for( unsigned int row = 0; row < tableSize; row++ )
+      CPU_vtkCUDA1DVolumeMapper_preIntegrateRow( (int) row, 0, &args );
+    }
+}
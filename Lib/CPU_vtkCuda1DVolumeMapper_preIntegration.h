@@ -0,0 +1,43 @@
+/** @file CPU_vtkCUDA1DVolumeMapper_preIntegration.h
+*
+*  @brief Header file with definitions for the host function building the pre-integrated transfer function table of the 1D ray caster
+*
+*  @note This is primarily an internal file. The table is built from the 1D lookup tables each time the transfer function
+*        changes, and holds the colour and opacity of a segment of the ray between two samples for every pair of
+*        intensities at its front and back, integrated as the intensity varies linearly along the segment. Sampling
+*        segments rather than points keeps thin features of the transfer function from aliasing at long steps.
+*
+*/
+
+#ifndef __CPU_vtkCUDA1DVolumeMapper_preIntegration_h
+#define __CPU_vtkCUDA1DVolumeMapper_preIntegration_h
+
+class vtkCUDAHostThreadPool;
+
+/** @brief Default number of intensities along each side of the pre-integrated table */
+#define CPU_PREINTEGRATED_TABLE_SIZE 256
+
+/** @brief Builds the pre-integrated table of the segments of one smallest spacing in length
+*
+*  @param alphaTable The opacity lookup table, each entry being the opacity of a step of one smallest spacing
+*  @param redTable The red lookup table
+*  @param greenTable The green lookup table
+*  @param blueTable The blue lookup table
+*  @param functionSize The number of entries in each lookup table, read as linearly filtered, clamped textures with normalized co-ordinates
+*  @param tableSize The number of intensities along each side of the table
+*  @param table Receives tableSize x tableSize RGBA entries, the intensity at the front of the segment varying fastest, each
+*               holding the opacity of the segment in A and the mean colour of the light it emits (not premultiplied) in RGB
+*  @param pool The threads to build with, or null to build on the calling thread
+*
+*  @note Entry (i, j) is the segment from intensity (i + 0.5) / tableSize to (j + 0.5) / tableSize in the normalized
+*        co-ordinates of the lookup tables, so the table is read as a linearly filtered, clamped texture with normalized
+*        co-ordinates at the indices the lookup tables are read at. The opacity of a segment comes from the integral of the
+*        extinction over the intensities it crosses, so a feature one entry wide is never stepped over, while its colour
+*        is composited front to back in parts so the segment attenuates its own back. Entries on the diagonal are the
+*        lookup tables themselves.
+*/
+void CPU_vtkCUDA1DVolumeMapper_preIntegrate(const float* alphaTable, const float* redTable, const float* greenTable,
+                                            const float* blueTable, unsigned int functionSize, unsigned int tableSize,
+                                            float* table, vtkCUDAHostThreadPool* pool);
+
+#endif
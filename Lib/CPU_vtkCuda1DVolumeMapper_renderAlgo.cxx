@@ -0,0 +1,861 @@
+/** @file CPU_vtkCUDA1DVolumeMapper_renderAlgo.cxx
+ *
+ *  @brief Host (CPU) implementation of the 1D volume ray caster
+ *
+ *  @note The compositing mirrors CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D operation for operation so the
+ *        two produce the same image. Keep them in step when changing either one.
+ *
+ */
+
+#include "CPU_vtkCUDA1DVolumeMapper_renderAlgo.h"
+#include "vtkCUDAHostThreadPool.h"
+
+// VTK includes
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cstring>
+#include <limits>
+
+/** @brief Everything the rays of a packet carry from one sample to the next, one lane of each array per ray, so that
+*          the arithmetic of a step runs across the lanes */
+typedef struct
+{
+  float rayStartX[CPU_PACKET_WIDTH];
+  float rayStartY[CPU_PACKET_WIDTH];
+  float rayStartZ[CPU_PACKET_WIDTH];
+  float rayIncX[CPU_PACKET_WIDTH];
+  float rayIncY[CPU_PACKET_WIDTH];
+  float rayIncZ[CPU_PACKET_WIDTH];
+  int   maxSteps[CPU_PACKET_WIDTH];
+  int   stepX[CPU_PACKET_WIDTH];       //whether the last step went backward, as step.x in the kernel
+  int   stepY[CPU_PACKET_WIDTH];       //whether the next visible sample steps backward, as step.y in the kernel
+  float outputX[CPU_PACKET_WIDTH];
+  float outputY[CPU_PACKET_WIDTH];
+  float outputZ[CPU_PACKET_WIDTH];
+  float outputW[CPU_PACKET_WIDTH];     //the remaining opacity, not the output opacity
+  float rayLength[CPU_PACKET_WIDTH];
+  float opacityExponent[CPU_PACKET_WIDTH];
+  int   skippedSteps[CPU_PACKET_WIDTH];
+  float frontIndex[CPU_PACKET_WIDTH];
+  int   active[CPU_PACKET_WIDTH];      //the mask of the lanes whose ray is still being cast
+} cpu1DRayPacketState;
+
+/** @brief The work each host thread measures when statistics are requested, padded to keep threads off each other's cache lines */
+typedef struct
+{
+  double RayFormationTime;
+  double CompositingTime;
+  double NumberOfSamples;
+  double NumberOfSkippedSamples;
+  char   padding[32];
+} cpu1DThreadStatistics;
+
+/** @brief The constant information shared by all the tiles of a frame */
+typedef struct
+{
+  const cudaOutputImageInformation*        outInfo;
+  const cudaRendererInformation*           renInfo;
+  const cudaVolumeInformation*             volInfo;
+  const cuda1DTransferFunctionInformation* trfInfo;
+  const cpuRendererBuffers*                rendererBuffers;
+  const cpu1DVolumeBuffers*                volumeBuffers;
+  int                                      tilesX;
+  cpu1DThreadStatistics*                   threadStatistics;
+} cpu1DFrameInformation;
+
+//set up lane l of a packet the way the start of CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D sets up a ray
+static void CPU_vtkCUDA1DVolumeMapper_StartRay(const cudaVolumeInformation& volInfo, float retDepth,
+                                               float3 rayStart, float3 rayInc, float numSteps,
+                                               cpu1DRayPacketState& ray, int l)
+{
+  //set the default values for the output (note A is currently the remaining opacity, not the output opacity)
+  ray.outputX[l] = 0.0f;
+  ray.outputY[l] = 0.0f;
+  ray.outputZ[l] = 0.0f;
+  ray.outputW[l] = 1.0f;
+
+  //apply a randomized offset to the ray
+  ray.maxSteps[l] = CPU_vtkCUDAVolumeMapper_float2int_rd(numSteps - retDepth);
+  ray.rayStartX[l] = rayStart.x + retDepth*rayInc.x;
+  ray.rayStartY[l] = rayStart.y + retDepth*rayInc.y;
+  ray.rayStartZ[l] = rayStart.z + retDepth*rayInc.z;
+  ray.rayIncX[l] = rayInc.x;
+  ray.rayIncY[l] = rayInc.y;
+  ray.rayIncZ[l] = rayInc.z;
+  ray.rayLength[l] = std::sqrt(rayInc.x*rayInc.x*volInfo.Spacing.x*volInfo.Spacing.x +
+                               rayInc.y*rayInc.y*volInfo.Spacing.y*volInfo.Spacing.y +
+                               rayInc.z*rayInc.z*volInfo.Spacing.z*volInfo.Spacing.z);
+  ray.opacityExponent[l] = ray.rayLength[l] / volInfo.MinSpacing;
+  if( std::fabs(ray.opacityExponent[l] - 1.0f) <= 0.0009765625f ) ray.opacityExponent[l] = 1.0f;
+  ray.stepX[l] = 0;
+  ray.stepY[l] = 0;
+  ray.skippedSteps[l] = 0;
+  ray.frontIndex[l] = 0.0f;
+  ray.active[l] = 0;
+}
+
+//look up a macro cell, treating anything outside the grid as occupied
+static bool CPU_vtkCUDA1DVolumeMapper_IsOccupied(const cuda1DTransferFunctionInformation& trfInfo,
+                                                 const unsigned char* occupancy, const int3& cell)
+{
+  const int3& gridSize = trfInfo.macroCellGridSize;
+  return cell.x < 0 || cell.y < 0 || cell.z < 0 || cell.x >= gridSize.x || cell.y >= gridSize.y || cell.z >= gridSize.z ||
+         occupancy[cell.x + gridSize.x * (cell.y + gridSize.y * cell.z)];
+}
+
+//the 3D DDA of CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_LeapEmptySpace, returning how many whole steps stay within empty macro cells
+static int CPU_vtkCUDA1DVolumeMapper_LeapEmptySpace(const cuda1DTransferFunctionInformation& trfInfo,
+                                                    const unsigned char* occupancy,
+                                                    const float3& rayStart, const float3& rayInc, int maxSteps)
+{
+  const int cellSize = trfInfo.macroCellSize;
+  const float infinity = std::numeric_limits<float>::infinity();
+
+  //find the cell holding the sample
+  int3 cell;
+  cell.x = CPU_vtkCUDAVolumeMapper_float2int_rd(rayStart.x / (float) cellSize);
+  cell.y = CPU_vtkCUDAVolumeMapper_float2int_rd(rayStart.y / (float) cellSize);
+  cell.z = CPU_vtkCUDAVolumeMapper_float2int_rd(rayStart.z / (float) cellSize);
+  if( CPU_vtkCUDA1DVolumeMapper_IsOccupied(trfInfo, occupancy, cell) ) return 0;
+
+  //distance (in steps) to the next cell boundary along each axis, and between boundaries
+  float3 tMax, tDelta;
+  int3 cellStep;
+  cellStep.x = (rayInc.x > 0.0f) ? 1 : ((rayInc.x < 0.0f) ? -1 : 0);
+  cellStep.y = (rayInc.y > 0.0f) ? 1 : ((rayInc.y < 0.0f) ? -1 : 0);
+  cellStep.z = (rayInc.z > 0.0f) ? 1 : ((rayInc.z < 0.0f) ? -1 : 0);
+  tMax.x = cellStep.x ? ((float) ((cell.x + (cellStep.x > 0)) * cellSize) - rayStart.x) / rayInc.x : infinity;
+  tMax.y = cellStep.y ? ((float) ((cell.y + (cellStep.y > 0)) * cellSize) - rayStart.y) / rayInc.y : infinity;
+  tMax.z = cellStep.z ? ((float) ((cell.z + (cellStep.z > 0)) * cellSize) - rayStart.z) / rayInc.z : infinity;
+  tDelta.x = cellStep.x ? (float) cellSize / std::fabs(rayInc.x) : infinity;
+  tDelta.y = cellStep.y ? (float) cellSize / std::fabs(rayInc.y) : infinity;
+  tDelta.z = cellStep.z ? (float) cellSize / std::fabs(rayInc.z) : infinity;
+
+  //leave empty cells until reaching an occupied one, the edge of the grid or the end of the ray
+  float t = 0.0f;
+  while( t < (float) maxSteps )
+    {
+    if( tMax.x <= tMax.y && tMax.x <= tMax.z )
+      {
+      t = tMax.x;
+      cell.x += cellStep.x;
+      tMax.x += tDelta.x;
+      }
+    else if( tMax.y <= tMax.z )
+      {
+      t = tMax.y;
+      cell.y += cellStep.y;
+      tMax.y += tDelta.y;
+      }
+    else
+      {
+      t = tMax.z;
+      cell.z += cellStep.z;
+      tMax.z += tDelta.z;
+      }
+    if( CPU_vtkCUDA1DVolumeMapper_IsOccupied(trfInfo, occupancy, cell) ) break;
+    }
+
+  //only the samples strictly before the boundary are known to be empty
+  float steps = std::ceil(t);
+  return (steps < (float) maxSteps) ? (int) steps : maxSteps;
+}
+
+//the gradient at the sample of each lane to be composited, fetched lane by lane, and its magnitude across the lanes
+template< class T >
+static void CPU_vtkCUDA1DVolumeMapper_GatherGradients(const cudaVolumeInformation& volInfo, const T* volume,
+                                                      const cpu1DRayPacketState& ray, const int* composite,
+                                                      float* gradientX, float* gradientY, float* gradientZ, float* gradMag)
+{
+  const int3& size = volInfo.VolumeSize;
+  const float3& space = volInfo.SpacingReciprocal;
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    gradientX[l] = gradientY[l] = gradientZ[l] = 0.0f;
+    if( !composite[l] ) continue;
+    const float x = ray.rayStartX[l];
+    const float y = ray.rayStartY[l];
+    const float z = ray.rayStartZ[l];
+    gradientX[l] = ( CPU_vtkCUDAVolumeMapper_tex3D(volume, size, x+0.5f, y, z)
+                   - CPU_vtkCUDAVolumeMapper_tex3D(volume, size, x-0.5f, y, z) ) * space.x;
+    gradientY[l] = ( CPU_vtkCUDAVolumeMapper_tex3D(volume, size, x, y+0.5f, z)
+                   - CPU_vtkCUDAVolumeMapper_tex3D(volume, size, x, y-0.5f, z) ) * space.y;
+    gradientZ[l] = ( CPU_vtkCUDAVolumeMapper_tex3D(volume, size, x, y, z+0.5f)
+                   - CPU_vtkCUDAVolumeMapper_tex3D(volume, size, x, y, z-0.5f) ) * space.z;
+    }
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    gradMag[l] = std::sqrt(gradientX[l]*gradientX[l] + gradientY[l]*gradientY[l] + gradientZ[l]*gradientZ[l]);
+}
+
+//the end of a pass of the while loops in the kernels once the samples (or segments) are classified: weigh, shade and
+//composite the lanes to be composited, whose opacity is in alpha and colour in red, green and blue, and end the visible
+//lanes which have hit an opacity where further sampling becomes neglible
+template< class T, bool Shaded, bool GradientOpacity, bool General >
+static void CPU_vtkCUDA1DVolumeMapper_CompositeSamples(const cudaVolumeInformation& volInfo,
+                                                       const cuda1DTransferFunctionInformation& trfInfo,
+                                                       const cpu1DVolumeBuffers& buffers,
+                                                       cpu1DRayPacketState& ray, const int* visible, const int* composite,
+                                                       float* alpha, const float* red, const float* green, const float* blue)
+{
+  const float3& incSpace = volInfo.Spacing;
+  float gradientX[CPU_PACKET_WIDTH];
+  float gradientY[CPU_PACKET_WIDTH];
+  float gradientZ[CPU_PACKET_WIDTH];
+  float gradMag[CPU_PACKET_WIDTH];
+  if(Shaded || GradientOpacity)
+    CPU_vtkCUDA1DVolumeMapper_GatherGradients(volInfo, static_cast<const T*>(buffers.Volume), ray, composite,
+                                              gradientX, gradientY, gradientZ, gradMag);
+  if(GradientOpacity){
+    const float gradRangeMulti = trfInfo.gradientMultiplier;
+    if(!General || (gradRangeMulti - gradRangeMulti) == 0.0f){
+      for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+        if( composite[l] )
+          alpha[l] *= CPU_vtkCUDAVolumeMapper_tex1D(buffers.GAlphaTransferFunction, trfInfo.functionSize, gradRangeMulti*(gradMag[l]-trfInfo.gradientLow));
+    }
+  }
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    if( composite[l] && ray.opacityExponent[l] != 1.0f )
+      alpha[l] = 1.0f - std::pow(1.0f - alpha[l], ray.opacityExponent[l]);
+
+  //without shading the colour is the one classified, as the neutral constants (1, 0, 0) of an unshaded volume give
+  float shadeD[CPU_PACKET_WIDTH];
+  float shadeS[CPU_PACKET_WIDTH];
+  if(Shaded){
+    float phongLambert[CPU_PACKET_WIDTH];
+    for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+      {
+      phongLambert[l] = CPU_vtkCUDAVolumeMapper_saturate( std::fabs( gradientX[l]*ray.rayIncX[l]*incSpace.x +
+                                                                     gradientY[l]*ray.rayIncY[l]*incSpace.y +
+                                                                     gradientZ[l]*ray.rayIncZ[l]*incSpace.z ) / (gradMag[l] * ray.rayLength[l]) );
+      shadeD[l] = volInfo.Ambient + volInfo.Diffuse * phongLambert[l];
+      }
+    for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+      shadeS[l] = composite[l] ? volInfo.Specular.x * std::pow(phongLambert[l], volInfo.Specular.y) : 0.0f;
+  }else{
+    for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+      {
+      shadeD[l] = 1.0f;
+      shadeS[l] = 0.0f;
+      }
+  }
+
+  //accumulate the opacity and the colour of the lanes composited, leaving the others as they are
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    const float multiplier = ray.outputW[l] * alpha[l];
+    const float outputX = ray.outputX[l] + multiplier * CPU_vtkCUDAVolumeMapper_saturate(shadeD[l] * red[l] + shadeS[l]);
+    const float outputY = ray.outputY[l] + multiplier * CPU_vtkCUDAVolumeMapper_saturate(shadeD[l] * green[l] + shadeS[l]);
+    const float outputZ = ray.outputZ[l] + multiplier * CPU_vtkCUDAVolumeMapper_saturate(shadeD[l] * blue[l] + shadeS[l]);
+    const float outputW = ray.outputW[l] * (1.0f - alpha[l]);
+    ray.outputX[l] = composite[l] ? outputX : ray.outputX[l];
+    ray.outputY[l] = composite[l] ? outputY : ray.outputY[l];
+    ray.outputZ[l] = composite[l] ? outputZ : ray.outputZ[l];
+    ray.outputW[l] = composite[l] ? outputW : ray.outputW[l];
+    }
+
+  //determine whether or not we've hit an opacity where further sampling becomes neglible
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    const int opaque = visible[l] && ray.outputW[l] < 0.015625f;
+    ray.outputW[l] = opaque ? 0.0f : ray.outputW[l];
+    ray.active[l] = ray.active[l] && !opaque;
+    }
+}
+
+//one pass of the while loop in CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D for each active lane of a packet,
+//specialized as it, returning the number of lanes still active
+template< class T, bool Shaded, bool GradientOpacity, bool General >
+static int CPU_vtkCUDA1DVolumeMapper_StepRays(const cudaVolumeInformation& volInfo,
+                                              const cuda1DTransferFunctionInformation& trfInfo,
+                                              const cpu1DVolumeBuffers& buffers,
+                                              cpu1DRayPacketState& ray)
+{
+  const T* volume = static_cast<const T*>(buffers.Volume);
+  const int3& size = volInfo.VolumeSize;
+
+  // fetching the intensity index into the transfer function, and the opacity value of the sampling point
+  float tempIndex[CPU_PACKET_WIDTH];
+  float alpha[CPU_PACKET_WIDTH];
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    tempIndex[l] = alpha[l] = 0.0f;
+    if( !ray.active[l] ) continue;
+    tempIndex[l] = trfInfo.intensityMultiplier *
+      (CPU_vtkCUDAVolumeMapper_tex3D(volume, size, ray.rayStartX[l], ray.rayStartY[l], ray.rayStartZ[l]) - trfInfo.intensityLow);
+    alpha[l] = CPU_vtkCUDAVolumeMapper_tex1D(buffers.AlphaTransferFunction, trfInfo.functionSize, tempIndex[l]);
+    }
+
+  //filter out objects with too low opacity (deemed unimportant, and this saves time and reduces cloudiness): the lanes
+  //with a visible sample make the kind of step they were due (which may be backward), the others skip ahead below
+  int visible[CPU_PACKET_WIDTH];
+  int invisible[CPU_PACKET_WIDTH];
+  int composite[CPU_PACKET_WIDTH];
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    visible[l] = ray.active[l] && alpha[l] > 0.0f;
+    invisible[l] = ray.active[l] && !visible[l];
+    const int backward = ray.stepY[l];
+    ray.stepX[l] = visible[l] ? backward : ray.stepX[l];
+    ray.stepY[l] = visible[l] ? 0 : ray.stepY[l];
+    ray.rayStartX[l] = visible[l] ? ray.rayStartX[l] + (backward ? -ray.rayIncX[l] : ray.rayIncX[l]) : ray.rayStartX[l];
+    ray.rayStartY[l] = visible[l] ? ray.rayStartY[l] + (backward ? -ray.rayIncY[l] : ray.rayIncY[l]) : ray.rayStartY[l];
+    ray.rayStartZ[l] = visible[l] ? ray.rayStartZ[l] + (backward ? -ray.rayIncZ[l] : ray.rayIncZ[l]) : ray.rayStartZ[l];
+    ray.maxSteps[l] = visible[l] ? ray.maxSteps[l] + (backward ? 1 : -1) : ray.maxSteps[l];
+    composite[l] = visible[l] && !backward;
+    }
+
+  //the colour of the samples composited
+  float red[CPU_PACKET_WIDTH];
+  float green[CPU_PACKET_WIDTH];
+  float blue[CPU_PACKET_WIDTH];
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    red[l] = green[l] = blue[l] = 0.0f;
+    if( !composite[l] ) continue;
+    red[l] = CPU_vtkCUDAVolumeMapper_tex1D(buffers.ColorRTransferFunction, trfInfo.functionSize, tempIndex[l]);
+    green[l] = CPU_vtkCUDAVolumeMapper_tex1D(buffers.ColorGTransferFunction, trfInfo.functionSize, tempIndex[l]);
+    blue[l] = CPU_vtkCUDAVolumeMapper_tex1D(buffers.ColorBTransferFunction, trfInfo.functionSize, tempIndex[l]);
+    }
+  CPU_vtkCUDA1DVolumeMapper_CompositeSamples<T, Shaded, GradientOpacity, General>(volInfo, trfInfo, buffers, ray,
+                                                                                 visible, composite, alpha, red, green, blue);
+
+  //leap over the macro cells where no sample can be visible, none of which needs revisiting
+  int leapt[CPU_PACKET_WIDTH];
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    leapt[l] = 0;
+  if( buffers.MacroCellOccupancy && trfInfo.macroCellSize > 0 )
+    {
+    for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+      {
+      if( !invisible[l] ) continue;
+      float3 rayStart;
+      float3 rayInc;
+      rayStart.x = ray.rayStartX[l]; rayStart.y = ray.rayStartY[l]; rayStart.z = ray.rayStartZ[l];
+      rayInc.x = ray.rayIncX[l]; rayInc.y = ray.rayIncY[l]; rayInc.z = ray.rayIncZ[l];
+      const int leap = CPU_vtkCUDA1DVolumeMapper_LeapEmptySpace(trfInfo, buffers.MacroCellOccupancy, rayStart, rayInc, ray.maxSteps[l]);
+      if( leap <= 0 ) continue;
+      ray.rayStartX[l] += leap * ray.rayIncX[l];
+      ray.rayStartY[l] += leap * ray.rayIncY[l];
+      ray.rayStartZ[l] += leap * ray.rayIncZ[l];
+      ray.maxSteps[l] -= leap;
+      ray.skippedSteps[l] += leap;
+      ray.stepX[l] = 0;
+      ray.stepY[l] = 0;
+      leapt[l] = 1;
+      }
+    }
+
+  //the other lanes without a visible sample move to the next one, skipping a sample if they aren't backstepping
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    const int skip = invisible[l] && !leapt[l];
+    const int twice = skip && !ray.stepX[l];
+    float x = ray.rayStartX[l];
+    float y = ray.rayStartY[l];
+    float z = ray.rayStartZ[l];
+    x = twice ? x + ray.rayIncX[l] : x;
+    y = twice ? y + ray.rayIncY[l] : y;
+    z = twice ? z + ray.rayIncZ[l] : z;
+    ray.rayStartX[l] = skip ? x + ray.rayIncX[l] : x;
+    ray.rayStartY[l] = skip ? y + ray.rayIncY[l] : y;
+    ray.rayStartZ[l] = skip ? z + ray.rayIncZ[l] : z;
+    ray.maxSteps[l] -= twice ? 2 : (skip ? 1 : 0);
+    ray.stepY[l] = skip ? !ray.stepX[l] : ray.stepY[l];
+    ray.stepX[l] = skip ? 0 : ray.stepX[l];
+    }
+
+  int numberActive = 0;
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    ray.active[l] = ray.active[l] && ray.maxSteps[l] > 0;
+    numberActive += ray.active[l];
+    }
+  return numberActive;
+}
+
+//one pass of the while loop in CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastSegments1D for each active lane of a packet,
+//specialized as it, returning the number of lanes still active
+template< class T, bool Shaded, bool GradientOpacity, bool General >
+static int CPU_vtkCUDA1DVolumeMapper_StepSegments(const cudaVolumeInformation& volInfo,
+                                                  const cuda1DTransferFunctionInformation& trfInfo,
+                                                  const cpu1DVolumeBuffers& buffers,
+                                                  cpu1DRayPacketState& ray)
+{
+  const T* volume = static_cast<const T*>(buffers.Volume);
+  const int3& size = volInfo.VolumeSize;
+
+  //move to the back of the segment and fetch its intensity index into the transfer function, then the opacity and
+  //mean colour of the segment
+  float backIndex[CPU_PACKET_WIDTH];
+  float alpha[CPU_PACKET_WIDTH];
+  float red[CPU_PACKET_WIDTH];
+  float green[CPU_PACKET_WIDTH];
+  float blue[CPU_PACKET_WIDTH];
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    backIndex[l] = alpha[l] = red[l] = green[l] = blue[l] = 0.0f;
+    if( !ray.active[l] ) continue;
+    ray.rayStartX[l] += ray.rayIncX[l];
+    ray.rayStartY[l] += ray.rayIncY[l];
+    ray.rayStartZ[l] += ray.rayIncZ[l];
+    ray.maxSteps[l]--;
+    backIndex[l] = trfInfo.intensityMultiplier *
+      (CPU_vtkCUDAVolumeMapper_tex3D(volume, size, ray.rayStartX[l], ray.rayStartY[l], ray.rayStartZ[l]) - trfInfo.intensityLow);
+    const float4 segment = CPU_vtkCUDAVolumeMapper_tex2D(buffers.PreIntegratedTransferFunction, trfInfo.preIntegratedSize,
+                                                         ray.frontIndex[l], backIndex[l]);
+    red[l] = segment.x;
+    green[l] = segment.y;
+    blue[l] = segment.z;
+    alpha[l] = segment.w;
+    }
+
+  //shade the visible segments as their back sample
+  int visible[CPU_PACKET_WIDTH];
+  int invisible[CPU_PACKET_WIDTH];
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    visible[l] = ray.active[l] && alpha[l] > 0.0f;
+    invisible[l] = ray.active[l] && !visible[l];
+    }
+  CPU_vtkCUDA1DVolumeMapper_CompositeSamples<T, Shaded, GradientOpacity, General>(volInfo, trfInfo, buffers, ray,
+                                                                                 visible, visible, alpha, red, green, blue);
+
+  //leap over the macro cells where no segment can be visible, landing on their last sample so the segment leaving
+  //them is still integrated
+  if( buffers.MacroCellOccupancy && trfInfo.macroCellSize > 0 )
+    {
+    for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+      {
+      if( !invisible[l] ) continue;
+      float3 rayStart;
+      float3 rayInc;
+      rayStart.x = ray.rayStartX[l]; rayStart.y = ray.rayStartY[l]; rayStart.z = ray.rayStartZ[l];
+      rayInc.x = ray.rayIncX[l]; rayInc.y = ray.rayIncY[l]; rayInc.z = ray.rayIncZ[l];
+      const int leap = CPU_vtkCUDA1DVolumeMapper_LeapEmptySpace(trfInfo, buffers.MacroCellOccupancy, rayStart, rayInc, ray.maxSteps[l]) - 1;
+      if( leap <= 0 ) continue;
+      ray.rayStartX[l] += leap * ray.rayIncX[l];
+      ray.rayStartY[l] += leap * ray.rayIncY[l];
+      ray.rayStartZ[l] += leap * ray.rayIncZ[l];
+      ray.maxSteps[l] -= leap;
+      ray.skippedSteps[l] += leap;
+      backIndex[l] = trfInfo.intensityMultiplier *
+        (CPU_vtkCUDAVolumeMapper_tex3D(volume, size, ray.rayStartX[l], ray.rayStartY[l], ray.rayStartZ[l]) - trfInfo.intensityLow);
+      }
+    }
+
+  //the back of this segment is the front of the next
+  int numberActive = 0;
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    ray.frontIndex[l] = ray.active[l] ? backIndex[l] : ray.frontIndex[l];
+    ray.active[l] = ray.active[l] && ray.maxSteps[l] > 0;
+    numberActive += ray.active[l];
+    }
+  return numberActive;
+}
+
+//trace a packet of rays, specialized as CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_Composite: the rays are formed and then
+//stepped together, a pass of the kernel's loop at a time for every lane still active, the lanes beyond the image and
+//those whose ray is done being masked off. The texture fetches gather lane by lane, but the arithmetic of a step runs
+//across the lanes with the branches of the kernel turned into selects under the mask, so that the compiler can
+//vectorize it, and neighbouring rays walk through the same cache lines together.
+template< class T, bool Shaded, bool GradientOpacity, bool Clipped, bool Perspective, bool PreIntegrated, bool General >
+static void CPU_vtkCUDA1DVolumeMapper_CastRays1D(const cpu1DFrameInformation& frame, int x, int y,
+                                                 cpu1DThreadStatistics* stats)
+{
+  const cudaOutputImageInformation& outInfo = *(frame.outInfo);
+  const cudaVolumeInformation& volInfo = *(frame.volInfo);
+
+  double startTime = stats ? vtkTimerLog::GetUniversalTime() : 0.0;
+  cpuRayPacket rays;
+  CPU_vtkCUDAVolumeMapper_renderAlgo_formRays<Clipped, Perspective>(outInfo, *(frame.renInfo), volInfo, *(frame.rendererBuffers), x, y, rays);
+
+  cpu1DRayPacketState state;
+  int numberActive = 0;
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    float3 rayStart;
+    float3 rayInc;
+    rayStart.x = rays.StartX[l]; rayStart.y = rays.StartY[l]; rayStart.z = rays.StartZ[l];
+    rayInc.x = rays.IncX[l]; rayInc.y = rays.IncY[l]; rayInc.z = rays.IncZ[l];
+    float retDepth = frame.rendererBuffers->RandomRayOffsets[((x + l) % CPU_BLOCK_DIM2D) + CPU_BLOCK_DIM2D * (y % CPU_BLOCK_DIM2D)];
+    CPU_vtkCUDA1DVolumeMapper_StartRay(volInfo, retDepth, rayStart, rayInc, rays.NumSteps[l], state, l);
+
+    //the segments start from the intensity at the first sample
+    if( PreIntegrated )
+      {
+      state.frontIndex[l] = frame.trfInfo->intensityMultiplier *
+        (CPU_vtkCUDAVolumeMapper_tex3D(static_cast<const T*>(frame.volumeBuffers->Volume), volInfo.VolumeSize,
+                                       state.rayStartX[l], state.rayStartY[l], state.rayStartZ[l]) - frame.trfInfo->intensityLow);
+      state.maxSteps[l]--;
+      }
+    state.active[l] = (x + l < (int) outInfo.resolution.x) && state.maxSteps[l] > 0;
+    numberActive += state.active[l];
+    }
+  double formedTime = 0.0;
+  if( stats )
+    {
+    formedTime = vtkTimerLog::GetUniversalTime();
+    stats->RayFormationTime += formedTime - startTime;
+    for( int l = 0; l < CPU_PACKET_WIDTH && x + l < (int) outInfo.resolution.x; l++ )
+      stats->NumberOfSamples += (rays.NumSteps[l] > 0.0f) ? rays.NumSteps[l] : 0.0f;
+    }
+
+  while( numberActive > 0 )
+    numberActive = PreIntegrated ?
+      CPU_vtkCUDA1DVolumeMapper_StepSegments<T, Shaded, GradientOpacity, General>(volInfo, *(frame.trfInfo), *(frame.volumeBuffers), state) :
+      CPU_vtkCUDA1DVolumeMapper_StepRays<T, Shaded, GradientOpacity, General>(volInfo, *(frame.trfInfo), *(frame.volumeBuffers), state);
+
+  //adjust the opacity output to reflect the collected opacity, convert to uchar and write out
+  uchar4* output = frame.rendererBuffers->OutputImage + x + y * outInfo.resolution.x;
+  for( int l = 0; l < CPU_PACKET_WIDTH && x + l < (int) outInfo.resolution.x; l++ )
+    {
+    output[l].x = (unsigned char) (255.0f * CPU_vtkCUDAVolumeMapper_saturate( state.outputX[l] ));
+    output[l].y = (unsigned char) (255.0f * CPU_vtkCUDAVolumeMapper_saturate( state.outputY[l] ));
+    output[l].z = (unsigned char) (255.0f * CPU_vtkCUDAVolumeMapper_saturate( state.outputZ[l] ));
+    output[l].w = (unsigned char) (255.0f * (1.0f - state.outputW[l]));
+    }
+
+  if( stats )
+    {
+    stats->CompositingTime += vtkTimerLog::GetUniversalTime() - formedTime;
+    for( int l = 0; l < CPU_PACKET_WIDTH && x + l < (int) outInfo.resolution.x; l++ )
+      stats->NumberOfSkippedSamples += state.skippedSteps[l];
+    }
+}
+
+//render one 16x16 tile of the image, packet by packet
+template< class T, bool Shaded, bool GradientOpacity, bool Clipped, bool Perspective, bool PreIntegrated, bool General >
+static void CPU_vtkCUDA1DVolumeMapper_RenderTile(int tile, int thread, void* userData)
+{
+  const cpu1DFrameInformation& frame = *static_cast<cpu1DFrameInformation*>(userData);
+  cpu1DThreadStatistics* stats = frame.threadStatistics ? frame.threadStatistics + thread : 0;
+  const uint2& resolution = frame.outInfo->resolution;
+  const int tileX = (tile % frame.tilesX) * CPU_BLOCK_DIM2D;
+  const int tileY = (tile / frame.tilesX) * CPU_BLOCK_DIM2D;
+
+  for( int y = tileY; y < tileY + CPU_BLOCK_DIM2D && y < (int) resolution.y; y++ )
+    for( int x = tileX; x < tileX + CPU_BLOCK_DIM2D && x < (int) resolution.x; x += CPU_PACKET_WIDTH )
+      CPU_vtkCUDA1DVolumeMapper_CastRays1D<T, Shaded, GradientOpacity, Clipped, Perspective, PreIntegrated, General>(frame, x, y, stats);
+}
+
+//the four shading variants of the tile task, in the order of the flags of CUDA_containerKernelVariant.h, the last being
+//the entry of CUDA_VARIANT_GENERAL when General, the only one checking the gradient range is finite
+#define CPU_1D_RENDER_TILE_SHADING_VARIANTS(T, Clipped, Perspective, PreIntegrated, General) \
+  CPU_vtkCUDA1DVolumeMapper_RenderTile<T, false, false, Clipped, Perspective, PreIntegrated, false>, \
+  CPU_vtkCUDA1DVolumeMapper_RenderTile<T, true, false, Clipped, Perspective, PreIntegrated, false>, \
+  CPU_vtkCUDA1DVolumeMapper_RenderTile<T, false, true, Clipped, Perspective, PreIntegrated, false>, \
+  CPU_vtkCUDA1DVolumeMapper_RenderTile<T, true, true, Clipped, Perspective, PreIntegrated, General>
+
+//the sixteen variants of the tile task, classifying either points or pre-integrated segments
+#define CPU_1D_RENDER_TILE_VARIANTS(T, PreIntegrated) \
+  CPU_1D_RENDER_TILE_SHADING_VARIANTS(T, false, false, PreIntegrated, false), CPU_1D_RENDER_TILE_SHADING_VARIANTS(T, true, false, PreIntegrated, false), \
+  CPU_1D_RENDER_TILE_SHADING_VARIANTS(T, false, true, PreIntegrated, false), CPU_1D_RENDER_TILE_SHADING_VARIANTS(T, true, true, PreIntegrated, true)
+
+//look up the tile task of a variant in the dispatch table of the voxel type
+template< class T >
+static vtkCUDAHostThreadPoolTask CPU_vtkCUDA1DVolumeMapper_RenderTileVariant(int variant)
+{
+  static const vtkCUDAHostThreadPoolTask variants[CUDA_NUMBER_OF_VARIANTS] = {
+    CPU_1D_RENDER_TILE_VARIANTS(T, false), CPU_1D_RENDER_TILE_VARIANTS(T, true) };
+  return variants[variant];
+}
+
+#undef CPU_1D_RENDER_TILE_VARIANTS
+#undef CPU_1D_RENDER_TILE_SHADING_VARIANTS
+
+//sample one of the volumes composited together, 0 being the rendered volume and the others the fused ones
+template< class T >
+static float CPU_vtkCUDA1DVolumeMapper_SampleFused(const cudaVolumeInformation& volInfo, const cpu1DVolumeBuffers& buffers,
+                                                   int volume, float x, float y, float z)
+{
+  if( !volume )
+    return CPU_vtkCUDAVolumeMapper_tex3D(static_cast<const T*>(buffers.Volume), volInfo.VolumeSize, x, y, z);
+  return CPU_vtkCUDAVolumeMapper_tex3D(buffers.FusedVolumes[volume-1], volInfo.FusedVolumeSize[volume-1], x, y, z);
+}
+
+//the march of CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CompositeFused for one pixel, returning the number of samples taken
+template< class T >
+static int CPU_vtkCUDA1DVolumeMapper_CompositeFused(const cpu1DFrameInformation& frame, int x, int y)
+{
+  const cudaOutputImageInformation& outInfo = *(frame.outInfo);
+  const cudaRendererInformation& renInfo = *(frame.renInfo);
+  const cudaVolumeInformation& volInfo = *(frame.volInfo);
+  const cuda1DTransferFunctionInformation& trfInfo = *(frame.trfInfo);
+  const cpu1DVolumeBuffers& buffers = *(frame.volumeBuffers);
+  const cpuRendererBuffers& rendererBuffers = *(frame.rendererBuffers);
+
+  //project the segment of the pixel up to the opaque geometry into the voxels of each volume
+  const float viewRayX = 1.0f - ( ((float) x) / (float) outInfo.resolution.x );
+  const float viewRayY = ( ((float) y) / (float) outInfo.resolution.y );
+  const float endDepth = CPU_vtkCUDAVolumeMapper_tex2DPoint( rendererBuffers.ZBuffer, rendererBuffers.ZBufferSize, 1.0f-viewRayX, viewRayY );
+  const int numVolumes = volInfo.NumberOfFusedVolumes + 1;
+  float3 rayStart[CUDA_MAX_FUSED_VOLUMES+1];
+  float3 rayDir[CUDA_MAX_FUSED_VOLUMES+1];
+  float2 range[CUDA_MAX_FUSED_VOLUMES+1];
+
+  //the clipping planes are given in the voxels of the rendered volume, and clip every volume alike
+  float2 clipped;
+  clipped.x = 0.0f;
+  clipped.y = 1.0f;
+  CPU_vtkCUDAVolumeMapper_renderAlgo_projectRay(viewRayX, viewRayY, endDepth, renInfo.ViewToVoxelsMatrix, rayStart[0], rayDir[0]);
+  CPU_vtkCUDAVolumeMapper_renderAlgo_clipRangeAgainstClippingPlanes(renInfo, rayStart[0], rayDir[0], clipped);
+
+  //march from the first volume entered to the last one left, as finely as the finest volume asks
+  float sBegin = 1.0f;
+  float sEnd = 0.0f;
+  float numSteps = 0.0f;
+  for( int v = 0; v < numVolumes; v++ )
+    {
+    if( v )
+      CPU_vtkCUDAVolumeMapper_renderAlgo_projectRay(viewRayX, viewRayY, endDepth, renInfo.FusedViewToVoxelsMatrix + 16*(v-1), rayStart[v], rayDir[v]);
+    range[v] = clipped;
+    CPU_vtkCUDAVolumeMapper_renderAlgo_clipRangeAgainstVolume(v ? volInfo.FusedBounds + 6*(v-1) : volInfo.Bounds, rayStart[v], rayDir[v], range[v]);
+    if( range[v].x < range[v].y )
+      {
+      const float3& spacing = v ? volInfo.FusedSpacing[v-1] : volInfo.Spacing;
+      const bool footprint = (renInfo.SamplingMode == CUDA_SAMPLE_VOXEL_FOOTPRINT);
+      float steps = std::sqrt( rayDir[v].x*rayDir[v].x*(footprint ? 1.0f : spacing.x*spacing.x) +
+                               rayDir[v].y*rayDir[v].y*(footprint ? 1.0f : spacing.y*spacing.y) +
+                               rayDir[v].z*rayDir[v].z*(footprint ? 1.0f : spacing.z*spacing.z) );
+      if( !footprint ) steps /= v ? volInfo.FusedMinSpacing[v-1] : volInfo.MinSpacing;
+      numSteps = steps > numSteps ? steps : numSteps;
+      sBegin = range[v].x < sBegin ? range[v].x : sBegin;
+      sEnd = range[v].y > sEnd ? range[v].y : sEnd;
+      }
+    }
+  numSteps /= renInfo.SampleDistanceFactor;
+
+  //set the default values for the output (note A is currently the remaining opacity, not the output opacity)
+  float4 outputVal;
+  outputVal.x = 0.0f;
+  outputVal.y = 0.0f;
+  outputVal.z = 0.0f;
+  outputVal.w = 1.0f;
+  int samples = 0;
+  if( numSteps > 0.0f && sBegin < sEnd )
+    {
+    const float ds = 1.0f / numSteps;
+
+    //the length of a step in each volume, which corrects its opacities as in CastRays1D
+    float rayLength[CUDA_MAX_FUSED_VOLUMES+1];
+    for( int v = 0; v < numVolumes; v++ )
+      {
+      const float3& spacing = v ? volInfo.FusedSpacing[v-1] : volInfo.Spacing;
+      rayLength[v] = ds * std::sqrt(rayDir[v].x*rayDir[v].x*spacing.x*spacing.x +
+                                    rayDir[v].y*rayDir[v].y*spacing.y*spacing.y +
+                                    rayDir[v].z*rayDir[v].z*spacing.z*spacing.z);
+      }
+
+    //apply a randomized offset to the ray
+    float s = sBegin + ds * rendererBuffers.RandomRayOffsets[(x % CPU_BLOCK_DIM2D) + CPU_BLOCK_DIM2D * (y % CPU_BLOCK_DIM2D)];
+    for( ; s < sEnd; s += ds )
+      {
+      samples++;
+
+      //classify and shade each volume covering the sample, merging them independently of their order
+      float remaining = 1.0f;
+      float weight = 0.0f;
+      float3 colour;
+      colour.x = colour.y = colour.z = 0.0f;
+      for( int v = 0; v < numVolumes; v++ )
+        {
+        if( s < range[v].x || s > range[v].y ) continue;
+        const float px = rayStart[v].x + s*rayDir[v].x;
+        const float py = rayStart[v].y + s*rayDir[v].y;
+        const float pz = rayStart[v].z + s*rayDir[v].z;
+        const float* colorRow = v ? buffers.FusedColorTransferFunctions + 4 * (v-1) * trfInfo.functionSize : 0;
+
+        const float tempIndex = v ? trfInfo.fusedIntensityMultiplier[v-1] *
+                                    (CPU_vtkCUDA1DVolumeMapper_SampleFused<T>(volInfo, buffers, v, px, py, pz) - trfInfo.fusedIntensityLow[v-1]) :
+                                    trfInfo.intensityMultiplier *
+                                    (CPU_vtkCUDA1DVolumeMapper_SampleFused<T>(volInfo, buffers, v, px, py, pz) - trfInfo.intensityLow);
+        float4 classified;
+        if( v )
+          {
+          classified.x = CPU_vtkCUDAVolumeMapper_tex1D(colorRow, trfInfo.functionSize, 4, tempIndex);
+          classified.y = CPU_vtkCUDAVolumeMapper_tex1D(colorRow + 1, trfInfo.functionSize, 4, tempIndex);
+          classified.z = CPU_vtkCUDAVolumeMapper_tex1D(colorRow + 2, trfInfo.functionSize, 4, tempIndex);
+          classified.w = CPU_vtkCUDAVolumeMapper_tex1D(colorRow + 3, trfInfo.functionSize, 4, tempIndex);
+          }
+        else
+          {
+          classified.w = CPU_vtkCUDAVolumeMapper_tex1D(buffers.AlphaTransferFunction, trfInfo.functionSize, tempIndex);
+          classified.x = CPU_vtkCUDAVolumeMapper_tex1D(buffers.ColorRTransferFunction, trfInfo.functionSize, tempIndex);
+          classified.y = CPU_vtkCUDAVolumeMapper_tex1D(buffers.ColorGTransferFunction, trfInfo.functionSize, tempIndex);
+          classified.z = CPU_vtkCUDAVolumeMapper_tex1D(buffers.ColorBTransferFunction, trfInfo.functionSize, tempIndex);
+          }
+        if( classified.w <= 0.0f ) continue;
+
+        const float3& spacing = v ? volInfo.FusedSpacing[v-1] : volInfo.Spacing;
+        const float minSpacing = v ? volInfo.FusedMinSpacing[v-1] : volInfo.MinSpacing;
+        float3 gradient;
+        gradient.x = ( CPU_vtkCUDA1DVolumeMapper_SampleFused<T>(volInfo, buffers, v, px+0.5f, py, pz)
+                     - CPU_vtkCUDA1DVolumeMapper_SampleFused<T>(volInfo, buffers, v, px-0.5f, py, pz) ) / spacing.x;
+        gradient.y = ( CPU_vtkCUDA1DVolumeMapper_SampleFused<T>(volInfo, buffers, v, px, py+0.5f, pz)
+                     - CPU_vtkCUDA1DVolumeMapper_SampleFused<T>(volInfo, buffers, v, px, py-0.5f, pz) ) / spacing.y;
+        gradient.z = ( CPU_vtkCUDA1DVolumeMapper_SampleFused<T>(volInfo, buffers, v, px, py, pz+0.5f)
+                     - CPU_vtkCUDA1DVolumeMapper_SampleFused<T>(volInfo, buffers, v, px, py, pz-0.5f) ) / spacing.z;
+        float gradMag = std::sqrt(gradient.x*gradient.x + gradient.y*gradient.y + gradient.z*gradient.z);
+        const float gradRangeLow = v ? trfInfo.fusedGradientLow[v-1] : trfInfo.gradientLow;
+        const float gradRangeMulti = v ? trfInfo.fusedGradientMultiplier[v-1] : trfInfo.gradientMultiplier;
+        float alpha = classified.w;
+        if( (gradRangeMulti - gradRangeMulti) == 0.0f )
+          alpha *= v ? CPU_vtkCUDAVolumeMapper_tex1D(buffers.FusedGAlphaTransferFunctions + (v-1) * trfInfo.functionSize,
+                                                     trfInfo.functionSize, gradRangeMulti*(gradMag-gradRangeLow)) :
+                       CPU_vtkCUDAVolumeMapper_tex1D(buffers.GAlphaTransferFunction, trfInfo.functionSize, gradRangeMulti*(gradMag-gradRangeLow));
+        const float opacityExponent = rayLength[v] / minSpacing;
+        alpha = std::fabs(opacityExponent - 1.0f) > 0.0009765625f ? 1.0f - std::pow(1.0f - alpha, opacityExponent) : alpha;
+        float phongLambert = CPU_vtkCUDAVolumeMapper_saturate( std::fabs( gradient.x*rayDir[v].x*ds*spacing.x +
+                                                                          gradient.y*rayDir[v].y*ds*spacing.y +
+                                                                          gradient.z*rayDir[v].z*ds*spacing.z ) / (gradMag * rayLength[v]) );
+        float shadeD = volInfo.Ambient + volInfo.Diffuse * phongLambert;
+        float shadeS = volInfo.Specular.x * std::pow(phongLambert, volInfo.Specular.y);
+
+        colour.x += alpha * CPU_vtkCUDAVolumeMapper_saturate(shadeD * classified.x + shadeS);
+        colour.y += alpha * CPU_vtkCUDAVolumeMapper_saturate(shadeD * classified.y + shadeS);
+        colour.z += alpha * CPU_vtkCUDAVolumeMapper_saturate(shadeD * classified.z + shadeS);
+        weight += alpha;
+        remaining *= (1.0f - alpha);
+        }
+      if( weight <= 0.0f ) continue;
+
+      //composite the merged sample front to back, its colour being the mean of the volumes weighted by their opacities
+      float multiplier = outputVal.w * (1.0f - remaining) / weight;
+      outputVal.w *= remaining;
+      outputVal.x += multiplier * colour.x;
+      outputVal.y += multiplier * colour.y;
+      outputVal.z += multiplier * colour.z;
+
+      //determine whether or not we've hit an opacity where further sampling becomes neglible
+      if( outputVal.w < 0.015625f )
+        {
+        outputVal.w = 0.0f;
+        break;
+        }
+      }
+    }
+
+  //convert to uchar and write out
+  uchar4& output = rendererBuffers.OutputImage[x + y * outInfo.resolution.x];
+  output.x = (unsigned char) (255.0f * CPU_vtkCUDAVolumeMapper_saturate( outputVal.x ));
+  output.y = (unsigned char) (255.0f * CPU_vtkCUDAVolumeMapper_saturate( outputVal.y ));
+  output.z = (unsigned char) (255.0f * CPU_vtkCUDAVolumeMapper_saturate( outputVal.z ));
+  output.w = (unsigned char) (255.0f * (1.0f - outputVal.w));
+  return samples;
+}
+
+//render one 16x16 tile of the image with the fused volumes, ray by ray since the rays of a packet no longer share a volume
+template< class T >
+static void CPU_vtkCUDA1DVolumeMapper_RenderFusedTile(int tile, int thread, void* userData)
+{
+  const cpu1DFrameInformation& frame = *static_cast<cpu1DFrameInformation*>(userData);
+  cpu1DThreadStatistics* stats = frame.threadStatistics ? frame.threadStatistics + thread : 0;
+  const uint2& resolution = frame.outInfo->resolution;
+  const int tileX = (tile % frame.tilesX) * CPU_BLOCK_DIM2D;
+  const int tileY = (tile / frame.tilesX) * CPU_BLOCK_DIM2D;
+
+  double startTime = stats ? vtkTimerLog::GetUniversalTime() : 0.0;
+  double samples = 0.0;
+  for( int y = tileY; y < tileY + CPU_BLOCK_DIM2D && y < (int) resolution.y; y++ )
+    for( int x = tileX; x < tileX + CPU_BLOCK_DIM2D && x < (int) resolution.x; x++ )
+      samples += CPU_vtkCUDA1DVolumeMapper_CompositeFused<T>(frame, x, y);
+  if( stats )
+    {
+    stats->CompositingTime += vtkTimerLog::GetUniversalTime() - startTime;
+    stats->NumberOfSamples += samples;
+    }
+}
+
+bool CPU_vtkCUDA1DVolumeMapper_renderAlgo_doRender(const cudaOutputImageInformation& outputInfo,
+                                                   const cudaRendererInformation& rendererInfo,
+                                                   const cudaVolumeInformation& volumeInfo,
+                                                   const cuda1DTransferFunctionInformation& transInfo,
+                                                   const cpuRendererBuffers& rendererBuffers,
+                                                   const cpu1DVolumeBuffers& volumeBuffers,
+                                                   int variant,
+                                                   vtkCUDAHostThreadPool* pool,
+                                                   cudaRenderStatistics* stats)
+{
+  if( !rendererBuffers.OutputImage || !rendererBuffers.ZBuffer || !rendererBuffers.RandomRayOffsets ||
+      !volumeBuffers.Volume || !volumeBuffers.AlphaTransferFunction || !volumeBuffers.GAlphaTransferFunction ||
+      !volumeBuffers.ColorRTransferFunction || !volumeBuffers.ColorGTransferFunction ||
+      !volumeBuffers.ColorBTransferFunction || transInfo.functionSize == 0 )
+    return false;
+  for( int v = 0; v < volumeInfo.NumberOfFusedVolumes; v++ )
+    if( !volumeBuffers.FusedVolumes[v] || !volumeBuffers.FusedColorTransferFunctions || !volumeBuffers.FusedGAlphaTransferFunctions )
+      return false;
+  if( variant < 0 || variant >= CUDA_NUMBER_OF_VARIANTS ) variant = CUDA_VARIANT_GENERAL;
+  if( !volumeBuffers.PreIntegratedTransferFunction || transInfo.preIntegratedSize == 0 ) variant &= ~CUDA_VARIANT_PREINTEGRATED;
+
+  cpu1DFrameInformation frame;
+  frame.outInfo = &outputInfo;
+  frame.renInfo = &rendererInfo;
+  frame.volInfo = &volumeInfo;
+  frame.trfInfo = &transInfo;
+  frame.rendererBuffers = &rendererBuffers;
+  frame.volumeBuffers = &volumeBuffers;
+  frame.tilesX = (outputInfo.resolution.x + CPU_BLOCK_DIM2D - 1) / CPU_BLOCK_DIM2D;
+  int tilesY = (outputInfo.resolution.y + CPU_BLOCK_DIM2D - 1) / CPU_BLOCK_DIM2D;
+
+  cpu1DThreadStatistics threadStatistics[VTK_MAX_THREADS];
+  frame.threadStatistics = 0;
+  double startTime = 0.0;
+  if( stats )
+    {
+    memset( threadStatistics, 0, sizeof(threadStatistics) );
+    frame.threadStatistics = threadStatistics;
+    startTime = vtkTimerLog::GetUniversalTime();
+    }
+
+  vtkCUDAHostThreadPoolTask renderTile;
+  const bool fused = (volumeInfo.NumberOfFusedVolumes > 0);
+  switch( volumeBuffers.VolumeFormat )
+    {
+    case CUDA_PACKED_UNSIGNED_CHAR:
+      renderTile = fused ? CPU_vtkCUDA1DVolumeMapper_RenderFusedTile<unsigned char> : CPU_vtkCUDA1DVolumeMapper_RenderTileVariant<unsigned char>(variant);
+      break;
+    case CUDA_PACKED_UNSIGNED_SHORT:
+      renderTile = fused ? CPU_vtkCUDA1DVolumeMapper_RenderFusedTile<unsigned short> : CPU_vtkCUDA1DVolumeMapper_RenderTileVariant<unsigned short>(variant);
+      break;
+    case CUDA_PACKED_FLOAT:
+      renderTile = fused ? CPU_vtkCUDA1DVolumeMapper_RenderFusedTile<float> : CPU_vtkCUDA1DVolumeMapper_RenderTileVariant<float>(variant);
+      break;
+    default:
+      return false;
+    }
+
+  if( pool )
+    {
+    pool->ParallelFor( frame.tilesX * tilesY, renderTile, &frame );
+    }
+  else
+    {
+    for( int tile = 0; tile < frame.tilesX * tilesY; tile++ )
+      renderTile( tile, 0, &frame );
+    }
+
+  //formation and compositing are interleaved, so split the wall time in proportion to the time the threads spent in each
+  if( stats )
+    {
+    double wallTime = vtkTimerLog::GetUniversalTime() - startTime;
+    double formTime = 0.0;
+    double compositeTime = 0.0;
+    stats->NumberOfSamples = 0.0;
+    stats->NumberOfSkippedSamples = 0.0;
+    stats->RayBufferBytes = 0.0;
+    for( int i = 0; i < VTK_MAX_THREADS; i++ )
+      {
+      formTime += threadStatistics[i].RayFormationTime;
+      compositeTime += threadStatistics[i].CompositingTime;
+      stats->NumberOfSamples += threadStatistics[i].NumberOfSamples;
+      stats->NumberOfSkippedSamples += threadStatistics[i].NumberOfSkippedSamples;
+      }
+    double busyTime = formTime + compositeTime;
+    stats->RayFormationTime = busyTime > 0.0 ? wallTime * formTime / busyTime : 0.0;
+    stats->CompositingTime = wallTime - stats->RayFormationTime;
+    }
+
+  return true;
+}
@@ -0,0 +1,68 @@
+/** @file CPU_vtkCUDA1DVolumeMapper_renderAlgo.h
+*
+*  @brief Header file with definitions for the host (CPU) implementation of the 1D transfer function ray caster
+*
+*  @note This is primarily an internal file used by the vtkCUDA1DVolumeMapper when rendering without a CUDA device, and
+*        as a reference to regression test the CUDA implementation against
+*
+*/
+
+#ifndef __CPU_vtkCUDA1DVolumeMapper_renderAlgo_h
+#define __CPU_vtkCUDA1DVolumeMapper_renderAlgo_h
+
+// CUDA Volume Rendering includes
+#include "CPU_vtkCUDAVolumeMapper_renderAlgo.h"
+#include "CUDA_container1DTransferFunctionInformation.h"
+#include "CUDA_containerKernelVariant.h"
+#include "CUDA_containerRenderStatistics.h"
+#include "CUDA_containerVolumePackingInformation.h"
+class vtkCUDAHostThreadPool;
+
+/** @brief Host stand-ins for the volume and transfer function textures of the 1D ray caster
+*
+*/
+typedef struct
+{
+  const void*   Volume;                 /**< The volume in voxel order (x fastest), VolumeSize in size */
+  int           VolumeFormat;           /**< The format of the voxels, one of the cudaVolumePackingFormat values */
+  const float*  AlphaTransferFunction;  /**< Opacity lookup table, functionSize in size */
+  const float*  GAlphaTransferFunction; /**< Gradient opacity lookup table, functionSize in size */
+  const float*  ColorRTransferFunction; /**< Red lookup table, functionSize in size */
+  const float*  ColorGTransferFunction; /**< Green lookup table, functionSize in size */
+  const float*  ColorBTransferFunction; /**< Blue lookup table, functionSize in size */
+  const float*  PreIntegratedTransferFunction; /**< Pre-integrated RGBA lookup table, preIntegratedSize squared in size, or null */
+  const unsigned char* MacroCellOccupancy; /**< Classification of the macro cells (see transInfo.macroCellSize), or null to sample every step */
+  const float*  FusedVolumes[CUDA_MAX_FUSED_VOLUMES]; /**< The volumes fused with this one as floats, volumeInfo.FusedVolumeSize in size */
+  const float*  FusedColorTransferFunctions;  /**< CUDA_MAX_FUSED_VOLUMES rows of functionSize RGBA lookup entries, the opacity in A */
+  const float*  FusedGAlphaTransferFunctions; /**< CUDA_MAX_FUSED_VOLUMES rows of functionSize gradient opacity lookup entries */
+} cpu1DVolumeBuffers;
+
+/** @brief Compute the image of the volume on the host, taking into account occluding geometry through the Z buffer
+*
+*  @param outputInfo Structure containing information for the rendering process describing the output image and how it is handled
+*  @param rendererInfo Structure containing information for the rendering process taken primarily from the renderer, such as camera/shading properties
+*  @param volumeInfo Structure containing information for the rendering process taken primarily from the volume, such as dimensions and location in space
+*  @param transInfo Structure containing the ranges of the transfer functions, with the volume packing folded in (the CUDA arrays are not used)
+*  @param rendererBuffers Host copies of the Z buffer and random ray offsets, and the host output image
+*  @param volumeBuffers Host copies of the volume and transfer function lookup tables
+*  @param variant The features the rays are specialized for, as for CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender, each
+*                 variant being instantiated on the host as well so they can be checked against each other without a device
+*                 (CUDA_VARIANT_PREINTEGRATED falling back to the samples when there is no pre-integrated table)
+*  @param pool The threads the 16x16 image tiles are shared among, or null to render on the calling thread
+*  @param stats If not null, receives the ray formation and compositing times, and the number of samples and of samples leapt over
+*
+*  @note When volumeInfo counts fused volumes, they are composited in the same march as the volume (and macro cells are not leapt over)
+*  @note This follows CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender sample for sample, and matches it up to the rounding of the device's fast math intrinsics
+*
+*/
+bool CPU_vtkCUDA1DVolumeMapper_renderAlgo_doRender(const cudaOutputImageInformation& outputInfo,
+                                                   const cudaRendererInformation& rendererInfo,
+                                                   const cudaVolumeInformation& volumeInfo,
+                                                   const cuda1DTransferFunctionInformation& transInfo,
+                                                   const cpuRendererBuffers& rendererBuffers,
+                                                   const cpu1DVolumeBuffers& volumeBuffers,
+                                                   int variant,
+                                                   vtkCUDAHostThreadPool* pool,
+                                                   cudaRenderStatistics* stats);
+
+#endif
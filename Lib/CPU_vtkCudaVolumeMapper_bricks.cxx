@@ -0,0 +1,180 @@
+/** @file CPU_vtkCUDAVolumeMapper_bricks.cxx
+*
+*  @brief Host functions cutting a volume into bricks and reducing it to a low resolution
+*
+*/
+
+#include "CPU_vtkCUDAVolumeMapper_bricks.h"
+#include "CPU_vtkCUDAVolumeMapper_packImage.h"
+#include "CUDA_containerBrickInformation.h"
+#include "CUDA_containerPyramidInformation.h"
+#include "vtkCUDAHostThreadPool.h"
+#include "vector_functions.h"
+
+// VTK includes
+#include <vtkType.h>
+
+// STD includes
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+bool CPU_vtkCUDAVolumeMapper_packBrick(const void* input, int scalarType, const int3& volumeSize, const int3& brick,
+                                       int brickSize, const cudaVolumePackingInformation& packing, void* output)
+{
+  const size_t scalarSize = CPU_vtkCUDAVolumeMapper_scalarSize(scalarType);
+  if( !input || scalarSize == 0 || brickSize < 1 ) return false;
+
+  //gather the brick and its apron in the input type, clamping to the edges of the volume
+  const int n = brickSize + 2 * CUDA_BRICK_APRON;
+  const int3 first = make_int3( brick.x * brickSize - CUDA_BRICK_APRON, brick.y * brickSize - CUDA_BRICK_APRON,
+                                brick.z * brickSize - CUDA_BRICK_APRON );
+  std::vector<char> gathered( (size_t) n * (size_t) n * (size_t) n * scalarSize );
+
+  //the voxels of a row within the volume are copied at once, and those past its edges one at a time
+  int xBegin = first.x < 0 ? -first.x : 0;
+  int xEnd = (first.x + n > volumeSize.x) ? volumeSize.x - first.x : n;
+  xEnd = xEnd < xBegin ? xBegin : xEnd;
+  char* destination = &(gathered[0]);
+  for( int z = 0; z < n; z++ )
+    {
+    int sz = first.z + z;
+    sz = sz < 0 ? 0 : (sz > volumeSize.z - 1 ? volumeSize.z - 1 : sz);
+    for( int y = 0; y < n; y++, destination += n * scalarSize )
+      {
+      int sy = first.y + y;
+      sy = sy < 0 ? 0 : (sy > volumeSize.y - 1 ? volumeSize.y - 1 : sy);
+      const char* row = (const char*) input + ((size_t) sz * (size_t) volumeSize.y + (size_t) sy) * (size_t) volumeSize.x * scalarSize;
+      if( xEnd > xBegin )
+        memcpy( destination + xBegin * scalarSize, row + (first.x + xBegin) * scalarSize, (xEnd - xBegin) * scalarSize );
+      for( int x = 0; x < xBegin; x++ )
+        memcpy( destination + x * scalarSize, row, scalarSize );
+      for( int x = xEnd; x < n; x++ )
+        memcpy( destination + x * scalarSize, row + (volumeSize.x - 1) * scalarSize, scalarSize );
+      }
+    }
+
+  return CPU_vtkCUDAVolumeMapper_packImage( &(gathered[0]), scalarType, gathered.size() / scalarSize, packing, output );
+}
+
+/** @brief The arguments shared by the tasks reducing a volume, one task per slice of the reduced volume */
+typedef struct
+{
+  const void* Input;
+  int ScalarType;
+  int3 VolumeSize;
+  int3 ReducedSize;
+  int Factor;
+  int Reduction;
+  const cudaVolumePackingInformation* Packing;
+  char* Output;
+  bool Result;
+} CPU_vtkCUDAVolumeMapper_downsampleTask;
+
+template< class T >
+static T CPU_vtkCUDAVolumeMapper_roundAverage(double sum, double count, T*)
+{
+  return (T) std::floor( sum / count + 0.5 );
+}
+
+static float CPU_vtkCUDAVolumeMapper_roundAverage(double sum, double count, float*)
+{
+  return (float) (sum / count);
+}
+
+static double CPU_vtkCUDAVolumeMapper_roundAverage(double sum, double count, double*)
+{
+  return sum / count;
+}
+
+template< class T >
+static void CPU_vtkCUDAVolumeMapper_downsampleSliceTask(int rz, int, void* userData)
+{
+  CPU_vtkCUDAVolumeMapper_downsampleTask& args = *static_cast<CPU_vtkCUDAVolumeMapper_downsampleTask*>(userData);
+  const T* input = static_cast<const T*>(args.Input);
+  const int3& size = args.VolumeSize;
+  const int3& reduced = args.ReducedSize;
+  const int F = args.Factor;
+  const size_t packedSize = CPU_vtkCUDAVolumeMapper_packedVoxelSize( *(args.Packing) );
+
+  //reduce each row in the input type, then pack it as the full volume is packed
+  std::vector<T> row(reduced.x);
+  const int zBegin = rz * F;
+  const int zEnd = (zBegin + F > size.z) ? size.z : zBegin + F;
+  for( int ry = 0; ry < reduced.y; ry++ )
+    {
+    const int yBegin = ry * F;
+    const int yEnd = (yBegin + F > size.y) ? size.y : yBegin + F;
+    for( int rx = 0; rx < reduced.x; rx++ )
+      {
+      const int xBegin = rx * F;
+      const int xEnd = (xBegin + F > size.x) ? size.x : xBegin + F;
+      double sum = 0.0;
+      T low = input[((size_t) zBegin * (size_t) size.y + (size_t) yBegin) * (size_t) size.x + xBegin];
+      T high = low;
+      for( int z = zBegin; z < zEnd; z++ )
+        for( int y = yBegin; y < yEnd; y++ )
+          {
+          const T* voxel = input + ((size_t) z * (size_t) size.y + (size_t) y) * (size_t) size.x;
+          for( int x = xBegin; x < xEnd; x++ )
+            {
+            sum += (double) voxel[x];
+            low = voxel[x] < low ? voxel[x] : low;
+            high = voxel[x] > high ? voxel[x] : high;
+            }
+          }
+      if( args.Reduction == CUDA_PYRAMID_MAX ) row[rx] = high;
+      else if( args.Reduction == CUDA_PYRAMID_MIN ) row[rx] = low;
+      else row[rx] = CPU_vtkCUDAVolumeMapper_roundAverage( sum, (double) ((zEnd - zBegin) * (yEnd - yBegin) * (xEnd - xBegin)), (T*) 0 );
+      }
+    char* output = args.Output + ((size_t) rz * (size_t) reduced.y + (size_t) ry) * (size_t) reduced.x * packedSize;
+    if( !CPU_vtkCUDAVolumeMapper_packImage( &(row[0]), args.ScalarType, reduced.x, *(args.Packing), output ) )
+      args.Result = false;
+    }
+}
+
+bool CPU_vtkCUDAVolumeMapper_downsampleImage(const void* input, int scalarType, const int3& volumeSize, int factor, int reduction,
+                                             const cudaVolumePackingInformation& packing, void* output,
+                                             vtkCUDAHostThreadPool* pool)
+{
+  if( !input || !output || factor < 1 || volumeSize.x < 1 || volumeSize.y < 1 || volumeSize.z < 1 ) return false;
+
+  vtkCUDAHostThreadPoolTask task;
+  switch( scalarType )
+    {
+    case VTK_CHAR:           task = CPU_vtkCUDAVolumeMapper_downsampleSliceTask<char>; break;
+    case VTK_SIGNED_CHAR:    task = CPU_vtkCUDAVolumeMapper_downsampleSliceTask<signed char>; break;
+    case VTK_UNSIGNED_CHAR:  task = CPU_vtkCUDAVolumeMapper_downsampleSliceTask<unsigned char>; break;
+    case VTK_SHORT:          task = CPU_vtkCUDAVolumeMapper_downsampleSliceTask<short>; break;
+    case VTK_UNSIGNED_SHORT: task = CPU_vtkCUDAVolumeMapper_downsampleSliceTask<unsigned short>; break;
+    case VTK_INT:            task = CPU_vtkCUDAVolumeMapper_downsampleSliceTask<int>; break;
+    case VTK_UNSIGNED_INT:   task = CPU_vtkCUDAVolumeMapper_downsampleSliceTask<unsigned int>; break;
+    case VTK_LONG:           task = CPU_vtkCUDAVolumeMapper_downsampleSliceTask<long>; break;
+    case VTK_UNSIGNED_LONG:  task = CPU_vtkCUDAVolumeMapper_downsampleSliceTask<unsigned long>; break;
+    case VTK_FLOAT:          task = CPU_vtkCUDAVolumeMapper_downsampleSliceTask<float>; break;
+    case VTK_DOUBLE:         task = CPU_vtkCUDAVolumeMapper_downsampleSliceTask<double>; break;
+    default:                 return false;
+    }
+
+  CPU_vtkCUDAVolumeMapper_downsampleTask args;
+  args.Input = input;
+  args.ScalarType = scalarType;
+  args.VolumeSize = volumeSize;
+  args.ReducedSize = make_int3( (volumeSize.x + factor - 1) / factor, (volumeSize.y + factor - 1) / factor,
+                                (volumeSize.z + factor - 1) / factor );
+  args.Factor = factor;
+  args.Reduction = reduction;
+  args.Packing = &packing;
+  args.Output = (char*) output;
+  args.Result = true;
+  if( pool )
+    {
+    pool->ParallelFor( args.ReducedSize.z, task, &args );
+    }
+  else
+    {
+    for( int rz = 0; rz < args.ReducedSize.z; rz++ )
+      task( rz, 0, &args );
+    }
+  return args.Result;
+}
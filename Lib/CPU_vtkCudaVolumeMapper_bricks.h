@@ -0,0 +1,52 @@
+/** @file CPU_vtkCUDAVolumeMapper_bricks.h
+*
+*  @brief Header file with definitions for the host functions cutting a volume into bricks and reducing it to a low resolution
+*
+*  @note This is primarily an internal file used by the volume mappers when a volume does not fit on the device. Its bricks
+*        are packed one at a time as the rays ask for them, while a low resolution copy of the whole volume stands in for
+*        the bricks that are not held yet.
+*
+*/
+
+#ifndef __CPU_vtkCUDAVolumeMapper_bricks_h
+#define __CPU_vtkCUDAVolumeMapper_bricks_h
+
+// CUDA Volume Rendering includes
+#include "CUDA_containerPyramidInformation.h"
+#include "CUDA_containerVolumePackingInformation.h"
+#include "vector_types.h"
+
+class vtkCUDAHostThreadPool;
+
+/** @brief Packs one brick of a volume, along with its apron
+*
+*  @param input The voxels of the volume, of type scalarType and x fastest
+*  @param scalarType The VTK scalar type of the input
+*  @param volumeSize The size of the volume in voxels
+*  @param brick The index of the brick along each axis
+*  @param brickSize The size of a brick along each axis, without its apron
+*  @param packing The format chosen by CPU_vtkCUDAVolumeMapper_choosePacking for the whole volume
+*  @param output Receives (brickSize + 2 * CUDA_BRICK_APRON)^3 packed voxels, x fastest
+*
+*  @note The voxels past the edges of the volume repeat the nearest voxel within it, as a clamped texture would read them
+*  @return false if the scalar type is not supported
+*/
+bool CPU_vtkCUDAVolumeMapper_packBrick(const void* input, int scalarType, const int3& volumeSize, const int3& brick,
+                                       int brickSize, const cudaVolumePackingInformation& packing, void* output);
+
+/** @brief Reduces a volume by averaging blocks of voxels (or taking their extremes), packing the result as the volume itself is packed
+*
+*  @param factor The size of the blocks along each axis, the output being ceil(volumeSize / factor) voxels along each axis
+*  @param reduction How each block is reduced, one of CUDA_PYRAMID_MEAN, CUDA_PYRAMID_MAX or CUDA_PYRAMID_MIN
+*  @param output Receives the packed voxels of the reduced volume, x fastest
+*  @param pool The threads to reduce with, or null to reduce on the calling thread
+*
+*  @note The voxel at the centre of each block of the input is the centre of the output voxel it is averaged into, so the
+*        reduced volume is sampled at the co-ordinates of the volume divided by factor
+*  @return false if the scalar type is not supported or the factor is less than 1
+*/
+bool CPU_vtkCUDAVolumeMapper_downsampleImage(const void* input, int scalarType, const int3& volumeSize, int factor, int reduction,
+                                             const cudaVolumePackingInformation& packing, void* output,
+                                             vtkCUDAHostThreadPool* pool);
+
+#endif
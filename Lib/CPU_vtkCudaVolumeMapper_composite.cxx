@@ -0,0 +1,269 @@
+/** @file CPU_vtkCUDAVolumeMapper_composite.cxx
+*
+*  @brief Host functions splitting a volume into slabs rendered on several devices and compositing the images of the slabs
+*
+*/
+
+#include "CPU_vtkCUDAVolumeMapper_composite.h"
+#include "vtkCUDAHostThreadPool.h"
+
+// STD includes
+#include <cmath>
+#include <cstring>
+
+#define CPU_COMPOSITE_CHUNK 16384 //number of pixels composited by one task
+
+int CPU_vtkCUDAVolumeMapper_splitSlabs(const int extent[6], int numberOfSlabs, std::vector<int>& slabExtents)
+{
+  slabExtents.clear();
+  if( extent[1] < extent[0] || extent[3] < extent[2] || extent[5] < extent[4] ) return -1;
+
+  //split along the longest axis, so the slabs stay as thick as they can be
+  int axis = 0;
+  for( int a = 1; a < 3; a++ )
+    if( extent[2*a+1] - extent[2*a] > extent[2*axis+1] - extent[2*axis] ) axis = a;
+  const int first = extent[2*axis];
+  const int gaps = extent[2*axis+1] - first;
+  numberOfSlabs = (numberOfSlabs < 1) ? 1 : numberOfSlabs;
+  numberOfSlabs = (numberOfSlabs > gaps && gaps > 0) ? gaps : numberOfSlabs;
+  numberOfSlabs = (gaps == 0) ? 1 : numberOfSlabs;
+
+  //share the gaps between the slices, rather than the slices, so the slabs meet on a shared slice
+  slabExtents.resize( 6 * numberOfSlabs );
+  for( int s = 0; s < numberOfSlabs; s++ )
+    {
+    for( int i = 0; i < 6; i++ ) slabExtents[6*s+i] = extent[i];
+    slabExtents[6*s+2*axis] = first + (gaps * s) / numberOfSlabs;
+    slabExtents[6*s+2*axis+1] = first + (gaps * (s + 1)) / numberOfSlabs;
+    }
+  return axis;
+}
+
+void CPU_vtkCUDAVolumeMapper_orderSlabs(const std::vector<int>& slabExtents, int axis, const double eye[4], std::vector<int>& order)
+{
+  const int numberOfSlabs = (int) slabExtents.size() / 6;
+  order.resize( numberOfSlabs );
+  if( numberOfSlabs == 0 ) return;
+  axis = (axis < 0 || axis > 2) ? 0 : axis;
+
+  //the distance of each slab from the camera along the axis, a camera at infinity (w of 0) being beyond every slab
+  std::vector<double> distance( numberOfSlabs );
+  for( int s = 0; s < numberOfSlabs; s++ )
+    {
+    const double low = (double) slabExtents[6*s+2*axis];
+    const double high = (double) slabExtents[6*s+2*axis+1];
+    if( eye[3] != 0.0 )
+      {
+      const double position = eye[axis] / eye[3];
+      distance[s] = (position < low) ? low - position : ((position > high) ? position - high : 0.0);
+      }
+    else
+      {
+      distance[s] = (eye[axis] > 0.0) ? -high : ((eye[axis] < 0.0) ? low : 0.0);
+      }
+    }
+
+  //there are only ever as many slabs as devices, so a stable insertion sort is plenty
+  for( int s = 0; s < numberOfSlabs; s++ )
+    {
+    int i = s;
+    for( ; i > 0 && distance[order[i-1]] > distance[s]; i-- )
+      order[i] = order[i-1];
+    order[i] = s;
+    }
+}
+
+/** @brief The arguments shared by the tasks compositing the partial images, one task per chunk of pixels */
+typedef struct
+{
+  const uchar4* const* Partials;
+  const int* Order;
+  int NumberOfPartials;
+  size_t NumberOfPixels;
+  uchar4* Output;
+
+  //binary swap only
+  float4* Working;
+  int NumberOfRanks;      /**< The number of partial images (or pairs of them) swapping regions, a power of two */
+  int NumberOfPairs;      /**< The number of ranks made of a pair of partial images, folded together in the first round */
+  int Round;
+  int NumberOfRounds;
+} CPU_vtkCUDAVolumeMapper_compositeTask;
+
+static inline void CPU_vtkCUDAVolumeMapper_under(float4& front, const uchar4& back)
+{
+  const float remaining = (1.0f - front.w) * (1.0f / 255.0f);
+  front.x += remaining * (float) back.x;
+  front.y += remaining * (float) back.y;
+  front.z += remaining * (float) back.z;
+  front.w += remaining * (float) back.w;
+}
+
+static inline void CPU_vtkCUDAVolumeMapper_under(float4& front, const float4& back)
+{
+  const float remaining = 1.0f - front.w;
+  front.x += remaining * back.x;
+  front.y += remaining * back.y;
+  front.z += remaining * back.z;
+  front.w += remaining * back.w;
+}
+
+static inline unsigned char CPU_vtkCUDAVolumeMapper_toUnsignedChar(float value)
+{
+  value = 255.0f * value + 0.5f;
+  return (unsigned char) (value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value));
+}
+
+static inline uchar4 CPU_vtkCUDAVolumeMapper_toUnsignedChar4(const float4& value)
+{
+  uchar4 pixel;
+  pixel.x = CPU_vtkCUDAVolumeMapper_toUnsignedChar(value.x);
+  pixel.y = CPU_vtkCUDAVolumeMapper_toUnsignedChar(value.y);
+  pixel.z = CPU_vtkCUDAVolumeMapper_toUnsignedChar(value.z);
+  pixel.w = CPU_vtkCUDAVolumeMapper_toUnsignedChar(value.w);
+  return pixel;
+}
+
+//composite the partial images of the ranks [firstRank, lastRank) over a range of pixels, front to back
+static inline float4 CPU_vtkCUDAVolumeMapper_compositePixel(const CPU_vtkCUDAVolumeMapper_compositeTask& args, size_t pixel,
+                                                            int firstRank, int lastRank)
+{
+  float4 composited;
+  composited.x = composited.y = composited.z = composited.w = 0.0f;
+  for( int r = firstRank; r < lastRank && composited.w < 1.0f; r++ )
+    CPU_vtkCUDAVolumeMapper_under( composited, args.Partials[args.Order[r]][pixel] );
+  return composited;
+}
+
+static void CPU_vtkCUDAVolumeMapper_directSendTask(int chunk, int, void* userData)
+{
+  const CPU_vtkCUDAVolumeMapper_compositeTask& args = *static_cast<const CPU_vtkCUDAVolumeMapper_compositeTask*>(userData);
+  const size_t begin = (size_t) chunk * CPU_COMPOSITE_CHUNK;
+  const size_t end = (begin + CPU_COMPOSITE_CHUNK > args.NumberOfPixels) ? args.NumberOfPixels : begin + CPU_COMPOSITE_CHUNK;
+  for( size_t p = begin; p < end; p++ )
+    args.Output[p] = CPU_vtkCUDAVolumeMapper_toUnsignedChar4(
+      CPU_vtkCUDAVolumeMapper_compositePixel(args, p, 0, args.NumberOfPartials) );
+}
+
+//the pixels a rank is left with after a number of rounds, the rank keeping the first half of its region in a round
+//where its bit is 0 and the second half where it is 1
+static void CPU_vtkCUDAVolumeMapper_swapRegion(int rank, int rounds, size_t numberOfPixels, size_t& begin, size_t& end)
+{
+  begin = 0;
+  end = numberOfPixels;
+  for( int r = 0; r < rounds; r++ )
+    {
+    const size_t middle = begin + (end - begin) / 2;
+    if( (rank >> r) & 1 ) begin = middle;
+    else end = middle;
+    }
+}
+
+static void CPU_vtkCUDAVolumeMapper_binarySwapTask(int task, int, void* userData)
+{
+  const CPU_vtkCUDAVolumeMapper_compositeTask& args = *static_cast<const CPU_vtkCUDAVolumeMapper_compositeTask*>(userData);
+  const int rank = task % args.NumberOfRanks;
+  const size_t chunk = (size_t) (task / args.NumberOfRanks);
+
+  //the part of the half of its region the rank keeps this round that this task composites
+  size_t begin, end;
+  CPU_vtkCUDAVolumeMapper_swapRegion(rank, args.Round + 1, args.NumberOfPixels, begin, end);
+  begin += chunk * CPU_COMPOSITE_CHUNK;
+  end = (begin + CPU_COMPOSITE_CHUNK > end) ? end : begin + CPU_COMPOSITE_CHUNK;
+  if( begin >= end ) return;
+
+  //the rank whose bit is 0 this round holds the ranks in front of those of its partner
+  const int front = rank & ~(1 << args.Round);
+  const int back = rank | (1 << args.Round);
+  const bool last = (args.Round + 1 == args.NumberOfRounds);
+  float4* working = last ? 0 : args.Working + (size_t) rank * args.NumberOfPixels;
+  if( args.Round == 0 )
+    {
+    //the first round composites the partial images of both ranks, a rank being a pair of partial images if folded
+    const int firstRank = (front < args.NumberOfPairs) ? 2 * front : front + args.NumberOfPairs;
+    const int lastRank = (back < args.NumberOfPairs) ? 2 * back + 2 : back + args.NumberOfPairs + 1;
+    for( size_t p = begin; p < end; p++ )
+      {
+      float4 composited = CPU_vtkCUDAVolumeMapper_compositePixel(args, p, firstRank, lastRank);
+      if( last ) args.Output[p] = CPU_vtkCUDAVolumeMapper_toUnsignedChar4(composited);
+      else working[p] = composited;
+      }
+    }
+  else
+    {
+    const float4* frontWorking = args.Working + (size_t) front * args.NumberOfPixels;
+    const float4* backWorking = args.Working + (size_t) back * args.NumberOfPixels;
+    for( size_t p = begin; p < end; p++ )
+      {
+      float4 composited = frontWorking[p];
+      CPU_vtkCUDAVolumeMapper_under( composited, backWorking[p] );
+      if( last ) args.Output[p] = CPU_vtkCUDAVolumeMapper_toUnsignedChar4(composited);
+      else working[p] = composited;
+      }
+    }
+}
+
+bool CPU_vtkCUDAVolumeMapper_compositeSlabs(const std::vector<const uchar4*>& partials, const std::vector<int>& order,
+                                            const uint2& resolution, int method, uchar4* output,
+                                            std::vector<float4>& working, vtkCUDAHostThreadPool* pool)
+{
+  const int numberOfPartials = (int) partials.size();
+  if( numberOfPartials == 0 || (int) order.size() != numberOfPartials || !output ) return false;
+  if( method != CUDA_COMPOSITE_DIRECT_SEND && method != CUDA_COMPOSITE_BINARY_SWAP ) return false;
+  for( int i = 0; i < numberOfPartials; i++ )
+    if( order[i] < 0 || order[i] >= numberOfPartials || !partials[order[i]] ) return false;
+
+  CPU_vtkCUDAVolumeMapper_compositeTask args;
+  memset( &args, 0, sizeof(CPU_vtkCUDAVolumeMapper_compositeTask) );
+  args.Partials = &(partials[0]);
+  args.Order = &(order[0]);
+  args.NumberOfPartials = numberOfPartials;
+  args.NumberOfPixels = (size_t) resolution.x * (size_t) resolution.y;
+  args.Output = output;
+  if( args.NumberOfPixels == 0 ) return true;
+
+  //binary swap works on a power of two of ranks, so the first partial images past it are folded pairwise into ranks
+  if( method == CUDA_COMPOSITE_BINARY_SWAP && numberOfPartials > 1 )
+    {
+    args.NumberOfRanks = 1;
+    while( 2 * args.NumberOfRanks <= numberOfPartials ) args.NumberOfRanks *= 2;
+    args.NumberOfPairs = numberOfPartials - args.NumberOfRanks;
+    while( (1 << args.NumberOfRounds) < args.NumberOfRanks ) args.NumberOfRounds++;
+    if( args.NumberOfRounds > 1 )
+      {
+      const size_t needed = (size_t) args.NumberOfRanks * args.NumberOfPixels;
+      if( working.size() < needed ) working.resize( needed );
+      args.Working = &(working[0]);
+      }
+
+    for( args.Round = 0; args.Round < args.NumberOfRounds; args.Round++ )
+      {
+      const size_t regionPixels = (args.NumberOfPixels + ((size_t) 1 << (args.Round + 1)) - 1) >> (args.Round + 1);
+      const size_t chunksPerRank = (regionPixels + CPU_COMPOSITE_CHUNK - 1) / CPU_COMPOSITE_CHUNK;
+      const int numberOfTasks = (int) ((size_t) args.NumberOfRanks * chunksPerRank);
+      if( pool )
+        {
+        pool->ParallelFor( numberOfTasks, CPU_vtkCUDAVolumeMapper_binarySwapTask, &args );
+        }
+      else
+        {
+        for( int t = 0; t < numberOfTasks; t++ )
+          CPU_vtkCUDAVolumeMapper_binarySwapTask( t, 0, &args );
+        }
+      }
+    return true;
+    }
+
+  //direct send, each chunk of the image compositing every partial image at once
+  const int numberOfChunks = (int) ((args.NumberOfPixels + CPU_COMPOSITE_CHUNK - 1) / CPU_COMPOSITE_CHUNK);
+  if( pool )
+    {
+    pool->ParallelFor( numberOfChunks, CPU_vtkCUDAVolumeMapper_directSendTask, &args );
+    }
+  else
+    {
+    for( int c = 0; c < numberOfChunks; c++ )
+      CPU_vtkCUDAVolumeMapper_directSendTask( c, 0, &args );
+    }
+  return true;
+}
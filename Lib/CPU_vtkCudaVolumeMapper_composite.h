@@ -0,0 +1,71 @@
+/** @file CPU_vtkCUDAVolumeMapper_composite.h
+*
+*  @brief Header file with definitions for the host functions splitting a volume into slabs rendered on several devices
+*         and compositing the images of the slabs
+*
+*  @note This is primarily an internal file used by the volume mappers when rendering a volume sort-last. Each device casts
+*        the rays through its own slab over the whole image, giving a premultiplied RGBA partial image, and the partial
+*        images are composited front to back in the order the slabs are seen from the camera.
+*
+*/
+
+#ifndef __CPU_vtkCUDAVolumeMapper_composite_h
+#define __CPU_vtkCUDAVolumeMapper_composite_h
+
+// CUDA Volume Rendering includes
+#include "vector_types.h"
+
+// STD includes
+#include <vector>
+
+class vtkCUDAHostThreadPool;
+
+/** @brief Every partial image sends each region of the image to the thread compositing it, which composites all of them at once */
+#define CUDA_COMPOSITE_DIRECT_SEND 0
+
+/** @brief The partial images are composited pairwise in rounds, each of the pair keeping half of the region it composited the round before */
+#define CUDA_COMPOSITE_BINARY_SWAP 1
+
+/** @brief Splits the extent of a volume into slabs of (about) as many slices each along its longest axis
+*
+*  @param extent The extent of the volume
+*  @param numberOfSlabs The number of slabs wanted, lowered to the number of slices between the first and last along the axis
+*  @param slabExtents Receives the extent of each slab, 6 after 6, the last slice of a slab being the first slice of the next
+*         so the rays of neighbouring slabs meet without a gap
+*
+*  @return The axis the volume is split along, or -1 if the extent is empty
+*/
+int CPU_vtkCUDAVolumeMapper_splitSlabs(const int extent[6], int numberOfSlabs, std::vector<int>& slabExtents);
+
+/** @brief Orders the slabs of a volume front to back from the camera
+*
+*  @param slabExtents The extents of the slabs, 6 after 6, as CPU_vtkCUDAVolumeMapper_splitSlabs gives them
+*  @param axis The axis the volume is split along
+*  @param eye The position of the camera in the index co-ordinates of the extents, homogeneous, with a w of 0 for a
+*         parallel projection (x, y and z then being the direction towards the camera)
+*  @param order Receives the index of the slab composited first, then second, and so on
+*
+*  @note A ray crosses the slabs one after the other along the axis, going away from the camera, so the slab holding the
+*        camera comes first and the others follow by their distance to the camera along the axis
+*/
+void CPU_vtkCUDAVolumeMapper_orderSlabs(const std::vector<int>& slabExtents, int axis, const double eye[4], std::vector<int>& order);
+
+/** @brief Composites premultiplied RGBA partial images front to back into one image
+*
+*  @param partials The partial images, each resolution.x by resolution.y pixels with their colours premultiplied by their opacity
+*  @param order The indices of the partial images, the front one first, as CPU_vtkCUDAVolumeMapper_orderSlabs gives them
+*  @param resolution The size of the images in pixels
+*  @param method How the work is split among the threads, one of CUDA_COMPOSITE_DIRECT_SEND or CUDA_COMPOSITE_BINARY_SWAP
+*  @param output Receives the composited image, which may be one of the partial images
+*  @param working Scratch space kept by the caller between frames, only used by CUDA_COMPOSITE_BINARY_SWAP
+*  @param pool The threads to composite with, or null to composite on the calling thread
+*
+*  @note Both methods composite in floating point and round once, so their images agree to within one level, and differ
+*        from the image a single device would have rendered only by the rounding of the partial images
+*  @return false if there is no partial image or the method is unknown
+*/
+bool CPU_vtkCUDAVolumeMapper_compositeSlabs(const std::vector<const uchar4*>& partials, const std::vector<int>& order,
+                                            const uint2& resolution, int method, uchar4* output,
+                                            std::vector<float4>& working, vtkCUDAHostThreadPool* pool);
+
+#endif
@@ -0,0 +1,198 @@
+/** @file CPU_vtkCUDAVolumeMapper_macroCells.cxx
+*
+*  @brief Host functions building and classifying the macro cell grid used for empty space skipping
+*
+*/
+
+#include "CPU_vtkCUDAVolumeMapper_macroCells.h"
+#include "vtkCUDAHostThreadPool.h"
+
+// VTK includes
+#include <vtkType.h>
+
+// STD includes
+#include <cmath>
+#include <vector>
+
+/** @brief The arguments shared by the tasks building a grid, one task per layer of macro cells along z */
+typedef struct
+{
+  const void* Input;
+  int3 VolumeSize;
+  double Scale;
+  double Shift;
+  cudaMacroCellGrid* Grid;
+} CPU_vtkCUDAVolumeMapper_macroCellTask;
+
+template< class T >
+static void CPU_vtkCUDAVolumeMapper_buildMacroCellLayer(const T* input, const CPU_vtkCUDAVolumeMapper_macroCellTask& args, int cz)
+{
+  const int3& size = args.VolumeSize;
+  const cudaMacroCellGrid& grid = *(args.Grid);
+  const int B = grid.CellSize;
+  const int cellsPerLayer = grid.GridSize.x * grid.GridSize.y;
+
+  //running range of each cell of the layer, in input units
+  std::vector<double> low(cellsPerLayer, HUGE_VAL);
+  std::vector<double> high(cellsPerLayer, -HUGE_VAL);
+  std::vector<double> rowLow(grid.GridSize.x);
+  std::vector<double> rowHigh(grid.GridSize.x);
+
+  //each cell reaches one voxel beyond its faces, which the linear interpolation at its border reads
+  const int zBegin = (cz * B - 1 < 0) ? 0 : cz * B - 1;
+  const int zEnd = ((cz + 1) * B > size.z - 1) ? size.z - 1 : (cz + 1) * B;
+  for( int z = zBegin; z <= zEnd; z++ )
+    {
+    for( int y = 0; y < size.y; y++ )
+      {
+      const T* row = input + ((size_t) z * (size_t) size.y + (size_t) y) * (size_t) size.x;
+
+      //range of the row within each cell along x
+      for( int cx = 0; cx < grid.GridSize.x; cx++ )
+        {
+        const int xBegin = (cx * B - 1 < 0) ? 0 : cx * B - 1;
+        const int xEnd = ((cx + 1) * B > size.x - 1) ? size.x - 1 : (cx + 1) * B;
+        double l = (double) row[xBegin];
+        double h = l;
+        for( int x = xBegin + 1; x <= xEnd; x++ )
+          {
+          double v = (double) row[x];
+          l = v < l ? v : l;
+          h = v > h ? v : h;
+          }
+        rowLow[cx] = l;
+        rowHigh[cx] = h;
+        }
+
+      //merge the row into the one or two cells along y that reach it
+      int cyBegin = (y + B - 1) / B - 1;
+      int cyEnd = (y + 1) / B;
+      cyBegin = cyBegin < 0 ? 0 : cyBegin;
+      cyEnd = cyEnd > grid.GridSize.y - 1 ? grid.GridSize.y - 1 : cyEnd;
+      for( int cy = cyBegin; cy <= cyEnd; cy++ )
+        {
+        for( int cx = 0; cx < grid.GridSize.x; cx++ )
+          {
+          const int cell = cx + cy * grid.GridSize.x;
+          low[cell] = rowLow[cx] < low[cell] ? rowLow[cx] : low[cell];
+          high[cell] = rowHigh[cx] > high[cell] ? rowHigh[cx] : high[cell];
+          }
+        }
+      }
+    }
+
+  //store the layer in the units read through the texture
+  float* minimum = grid.Minimum + (size_t) cz * (size_t) cellsPerLayer;
+  float* maximum = grid.Maximum + (size_t) cz * (size_t) cellsPerLayer;
+  for( int cell = 0; cell < cellsPerLayer; cell++ )
+    {
+    minimum[cell] = (float) ( (low[cell] - args.Shift) / args.Scale );
+    maximum[cell] = (float) ( (high[cell] - args.Shift) / args.Scale );
+    }
+}
+
+template< class T >
+static void CPU_vtkCUDAVolumeMapper_buildMacroCellLayerTask(int cz, int, void* userData)
+{
+  const CPU_vtkCUDAVolumeMapper_macroCellTask& args = *static_cast<CPU_vtkCUDAVolumeMapper_macroCellTask*>(userData);
+  CPU_vtkCUDAVolumeMapper_buildMacroCellLayer( static_cast<const T*>(args.Input), args, cz );
+}
+
+bool CPU_vtkCUDAVolumeMapper_buildMacroCellGrid(const void* input, int scalarType, const int3& volumeSize,
+                                                const cudaVolumePackingInformation& packing, int cellSize,
+                                                cudaMacroCellGrid& grid, vtkCUDAHostThreadPool* pool)
+{
+  CPU_vtkCUDAVolumeMapper_freeMacroCellGrid(grid);
+  if( !input || cellSize < 1 || volumeSize.x < 1 || volumeSize.y < 1 || volumeSize.z < 1 || packing.Scale == 0.0f )
+    return false;
+
+  vtkCUDAHostThreadPoolTask task;
+  switch( scalarType )
+    {
+    case VTK_CHAR:           task = CPU_vtkCUDAVolumeMapper_buildMacroCellLayerTask<char>; break;
+    case VTK_SIGNED_CHAR:    task = CPU_vtkCUDAVolumeMapper_buildMacroCellLayerTask<signed char>; break;
+    case VTK_UNSIGNED_CHAR:  task = CPU_vtkCUDAVolumeMapper_buildMacroCellLayerTask<unsigned char>; break;
+    case VTK_SHORT:          task = CPU_vtkCUDAVolumeMapper_buildMacroCellLayerTask<short>; break;
+    case VTK_UNSIGNED_SHORT: task = CPU_vtkCUDAVolumeMapper_buildMacroCellLayerTask<unsigned short>; break;
+    case VTK_INT:            task = CPU_vtkCUDAVolumeMapper_buildMacroCellLayerTask<int>; break;
+    case VTK_UNSIGNED_INT:   task = CPU_vtkCUDAVolumeMapper_buildMacroCellLayerTask<unsigned int>; break;
+    case VTK_LONG:           task = CPU_vtkCUDAVolumeMapper_buildMacroCellLayerTask<long>; break;
+    case VTK_UNSIGNED_LONG:  task = CPU_vtkCUDAVolumeMapper_buildMacroCellLayerTask<unsigned long>; break;
+    case VTK_FLOAT:          task = CPU_vtkCUDAVolumeMapper_buildMacroCellLayerTask<float>; break;
+    case VTK_DOUBLE:         task = CPU_vtkCUDAVolumeMapper_buildMacroCellLayerTask<double>; break;
+    default:                 return false;
+    }
+
+  grid.CellSize = cellSize;
+  grid.GridSize.x = (volumeSize.x + cellSize - 1) / cellSize;
+  grid.GridSize.y = (volumeSize.y + cellSize - 1) / cellSize;
+  grid.GridSize.z = (volumeSize.z + cellSize - 1) / cellSize;
+  size_t numberOfCells = (size_t) grid.GridSize.x * (size_t) grid.GridSize.y * (size_t) grid.GridSize.z;
+  grid.Minimum = new float[numberOfCells];
+  grid.Maximum = new float[numberOfCells];
+
+  CPU_vtkCUDAVolumeMapper_macroCellTask args;
+  args.Input = input;
+  args.VolumeSize = volumeSize;
+  args.Scale = packing.Scale;
+  args.Shift = packing.Shift;
+  args.Grid = &grid;
+  if( pool )
+    {
+    pool->ParallelFor( grid.GridSize.z, task, &args );
+    }
+  else
+    {
+    for( int cz = 0; cz < grid.GridSize.z; cz++ )
+      task( cz, 0, &args );
+    }
+  return true;
+}
+
+void CPU_vtkCUDAVolumeMapper_freeMacroCellGrid(cudaMacroCellGrid& grid)
+{
+  delete[] grid.Minimum;
+  delete[] grid.Maximum;
+  grid.Minimum = 0;
+  grid.Maximum = 0;
+  grid.GridSize.x = 0;
+  grid.GridSize.y = 0;
+  grid.GridSize.z = 0;
+  grid.CellSize = 0;
+}
+
+void CPU_vtkCUDAVolumeMapper_classifyMacroCells(const cudaMacroCellGrid& grid, const float* alphaTable, unsigned int tableSize,
+                                                float intensityLow, float intensityMultiplier, unsigned char* occupancy)
+{
+  size_t numberOfCells = (size_t) grid.GridSize.x * (size_t) grid.GridSize.y * (size_t) grid.GridSize.z;
+  if( numberOfCells == 0 ) return;
+
+  //without a usable mapping to the table, nothing can be proven empty
+  const double multiplier = intensityMultiplier;
+  if( !grid.Minimum || !alphaTable || tableSize == 0 || !(multiplier - multiplier == 0.0) || multiplier <= 0.0 )
+    {
+    for( size_t cell = 0; cell < numberOfCells; cell++ )
+      occupancy[cell] = 1;
+    return;
+    }
+
+  //count the visible entries up to each one, so any range of the table is checked in constant time
+  std::vector<unsigned int> visibleBefore(tableSize + 1, 0);
+  for( unsigned int i = 0; i < tableSize; i++ )
+    visibleBefore[i+1] = visibleBefore[i] + (alphaTable[i] > 0.0f ? 1 : 0);
+
+  for( size_t cell = 0; cell < numberOfCells; cell++ )
+    {
+    //the entries interpolated between, widened by one either side to stay clear of rounding on the device
+    double first = std::floor( multiplier * (grid.Minimum[cell] - intensityLow) * tableSize - 0.5 ) - 1.0;
+    double last = std::floor( multiplier * (grid.Maximum[cell] - intensityLow) * tableSize - 0.5 ) + 2.0;
+    if( !(first == first) || !(last == last) )
+      {
+      occupancy[cell] = 1;
+      continue;
+      }
+    first = first < 0.0 ? 0.0 : (first > tableSize - 1 ? tableSize - 1 : first);
+    last = last < 0.0 ? 0.0 : (last > tableSize - 1 ? tableSize - 1 : last);
+    occupancy[cell] = ( visibleBefore[(unsigned int) last + 1] > visibleBefore[(unsigned int) first] ) ? 1 : 0;
+    }
+}
@@ -0,0 +1,58 @@
+/** @file CPU_vtkCUDAVolumeMapper_macroCells.h
+*
+*  @brief Header file with definitions for the host functions building and classifying the macro cell grid used for empty space skipping
+*
+*  @note This is primarily an internal file. The grid is built once when a volume is loaded, and classified against the
+*        opacity lookup table each time the transfer function changes. Both ray casters then leap over the cells that
+*        classify as empty, since every sample taken inside them is known to be fully transparent.
+*
+*/
+
+#ifndef __CPU_vtkCUDAVolumeMapper_macroCells_h
+#define __CPU_vtkCUDAVolumeMapper_macroCells_h
+
+// CUDA Volume Rendering includes
+#include "CUDA_containerMacroCellGrid.h"
+#include "CUDA_containerVolumePackingInformation.h"
+
+class vtkCUDAHostThreadPool;
+
+/** @brief Default size of a macro cell along each axis, in voxels */
+#define CPU_MACRO_CELL_SIZE 8
+
+/** @brief Builds the min/max grid of a volume
+*
+*  @param input The voxels of the volume, of type scalarType and x fastest
+*  @param scalarType The VTK scalar type of the input
+*  @param volumeSize The size of the volume in voxels
+*  @param packing The packing of the volume on the device, so the ranges are kept in the units the textures return
+*  @param cellSize The size of a macro cell along each axis, in voxels
+*  @param grid Receives the grid, whose buffers are allocated here and released by CPU_vtkCUDAVolumeMapper_freeMacroCellGrid
+*  @param pool The threads to build with, or null to build on the calling thread
+*
+*  @return false if the scalar type is not supported or the sizes are invalid (the grid is then left empty)
+*/
+bool CPU_vtkCUDAVolumeMapper_buildMacroCellGrid(const void* input, int scalarType, const int3& volumeSize,
+                                                const cudaVolumePackingInformation& packing, int cellSize,
+                                                cudaMacroCellGrid& grid, vtkCUDAHostThreadPool* pool);
+
+/** @brief Releases the buffers of a grid and marks it as empty
+*
+*/
+void CPU_vtkCUDAVolumeMapper_freeMacroCellGrid(cudaMacroCellGrid& grid);
+
+/** @brief Marks the macro cells which can hold a sample of non-zero opacity
+*
+*  @param grid The min/max grid of the volume
+*  @param alphaTable The opacity lookup table, read as a linearly filtered, clamped texture with normalized co-ordinates
+*  @param tableSize The number of entries in the table
+*  @param intensityLow The value read through the volume texture that maps to the start of the table
+*  @param intensityMultiplier The factor from the value read (less intensityLow) to the normalized table co-ordinate
+*  @param occupancy Receives 1 for each cell that may be visible and 0 for each cell that is fully transparent, x fastest
+*
+*  @note The classification is conservative: a cell is only empty if every table entry its range can touch is zero
+*/
+void CPU_vtkCUDAVolumeMapper_classifyMacroCells(const cudaMacroCellGrid& grid, const float* alphaTable, unsigned int tableSize,
+                                                float intensityLow, float intensityMultiplier, unsigned char* occupancy);
+
+#endif
@@ -0,0 +1,306 @@
+/** @file CPU_vtkCUDAVolumeMapper_packImage.cxx
+*
+*  @brief Host functions converting VTK scalars into the voxel formats the ray casters sample
+*
+*/
+
+#include "CPU_vtkCUDAVolumeMapper_packImage.h"
+#include "vtkCUDAHostThreadPool.h"
+
+// VTK includes
+#include <vtkType.h>
+
+// STD includes
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// SSE2 is part of every x86-64 target, and is used for the conversions it can do directly
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CPU_vtkCUDAVolumeMapper_USE_SSE2
+#endif
+
+//number of voxels converted by one task of the thread pool
+#define CPU_PACK_VOXELS_PER_TASK 65536
+
+//largest magnitude for which every integer is exact in a float, past which a shift cannot be trusted
+static const double CPU_vtkCUDAVolumeMapper_exactFloatLimit = 16777216.0;
+
+static void CPU_vtkCUDAVolumeMapper_setPacking(cudaVolumePackingInformation& packing, int format, double shift)
+{
+  packing.Format = format;
+  packing.Scale = (format == CUDA_PACKED_UNSIGNED_CHAR) ? 255.0f :
+                  (format == CUDA_PACKED_UNSIGNED_SHORT) ? 65535.0f : 1.0f;
+  packing.Shift = (float) shift;
+}
+
+bool CPU_vtkCUDAVolumeMapper_choosePacking(int scalarType, const double scalarRange[2], cudaVolumePackingInformation& packing)
+{
+  switch( scalarType )
+    {
+    case VTK_UNSIGNED_CHAR:
+      CPU_vtkCUDAVolumeMapper_setPacking(packing, CUDA_PACKED_UNSIGNED_CHAR, 0.0);
+      return true;
+    case VTK_CHAR:
+      CPU_vtkCUDAVolumeMapper_setPacking(packing, CUDA_PACKED_UNSIGNED_CHAR, (double) std::numeric_limits<char>::min());
+      return true;
+    case VTK_SIGNED_CHAR:
+      CPU_vtkCUDAVolumeMapper_setPacking(packing, CUDA_PACKED_UNSIGNED_CHAR, -128.0);
+      return true;
+    case VTK_UNSIGNED_SHORT:
+      CPU_vtkCUDAVolumeMapper_setPacking(packing, CUDA_PACKED_UNSIGNED_SHORT, 0.0);
+      return true;
+    case VTK_SHORT:
+      CPU_vtkCUDAVolumeMapper_setPacking(packing, CUDA_PACKED_UNSIGNED_SHORT, -32768.0);
+      return true;
+    case VTK_INT:
+    case VTK_UNSIGNED_INT:
+    case VTK_LONG:
+    case VTK_UNSIGNED_LONG:
+      {
+      //wider integers still fit a narrow format when their range is small enough
+      double low = std::floor(scalarRange[0]);
+      double span = std::ceil(scalarRange[1]) - low;
+      if( std::fabs(low) < CPU_vtkCUDAVolumeMapper_exactFloatLimit && span >= 0.0 && span <= 255.0 )
+        CPU_vtkCUDAVolumeMapper_setPacking(packing, CUDA_PACKED_UNSIGNED_CHAR, low);
+      else if( std::fabs(low) < CPU_vtkCUDAVolumeMapper_exactFloatLimit && span >= 0.0 && span <= 65535.0 )
+        CPU_vtkCUDAVolumeMapper_setPacking(packing, CUDA_PACKED_UNSIGNED_SHORT, low);
+      else
+        CPU_vtkCUDAVolumeMapper_setPacking(packing, CUDA_PACKED_FLOAT, 0.0);
+      return true;
+      }
+    case VTK_FLOAT:
+    case VTK_DOUBLE:
+      CPU_vtkCUDAVolumeMapper_setPacking(packing, CUDA_PACKED_FLOAT, 0.0);
+      return true;
+    default:
+      return false;
+    }
+}
+
+bool CPU_vtkCUDAVolumeMapper_isNativePacking(int scalarType, const cudaVolumePackingInformation& packing)
+{
+  return (scalarType == VTK_UNSIGNED_CHAR && packing.Format == CUDA_PACKED_UNSIGNED_CHAR && packing.Shift == 0.0f) ||
+         (scalarType == VTK_UNSIGNED_SHORT && packing.Format == CUDA_PACKED_UNSIGNED_SHORT && packing.Shift == 0.0f) ||
+         (scalarType == VTK_FLOAT && packing.Format == CUDA_PACKED_FLOAT);
+}
+
+size_t CPU_vtkCUDAVolumeMapper_packedVoxelSize(const cudaVolumePackingInformation& packing)
+{
+  return (packing.Format == CUDA_PACKED_UNSIGNED_CHAR) ? sizeof(unsigned char) :
+         (packing.Format == CUDA_PACKED_UNSIGNED_SHORT) ? sizeof(unsigned short) : sizeof(float);
+}
+
+template< class TIn, class TOut >
+static void CPU_vtkCUDAVolumeMapper_packIntegers(const TIn* input, size_t numberOfVoxels, double shift, TOut* output)
+{
+  //branchless clamp so the loop vectorizes
+  const double high = (double) std::numeric_limits<TOut>::max();
+  for( size_t i = 0; i < numberOfVoxels; i++ )
+    {
+    double v = (double) input[i] - shift;
+    v = v < 0.0 ? 0.0 : v;
+    v = v > high ? high : v;
+    output[i] = (TOut) v;
+    }
+}
+
+template< class TIn >
+static void CPU_vtkCUDAVolumeMapper_packFloats(const TIn* input, size_t numberOfVoxels, float* output)
+{
+  for( size_t i = 0; i < numberOfVoxels; i++ )
+    output[i] = (float) input[i];
+}
+
+#ifdef CPU_vtkCUDAVolumeMapper_USE_SSE2
+//signed 8 and 16-bit data shifted by its type minimum only needs its sign bit flipped
+static void CPU_vtkCUDAVolumeMapper_flipSign8(const char* input, size_t numberOfVoxels, unsigned char* output)
+{
+  const __m128i sign = _mm_set1_epi8( (char) 0x80 );
+  size_t i = 0;
+  for( ; i + 16 <= numberOfVoxels; i += 16 )
+    _mm_storeu_si128( (__m128i*) (output + i), _mm_xor_si128( _mm_loadu_si128( (const __m128i*) (input + i) ), sign ) );
+  for( ; i < numberOfVoxels; i++ )
+    output[i] = (unsigned char) (input[i] ^ 0x80);
+}
+
+static void CPU_vtkCUDAVolumeMapper_flipSign16(const short* input, size_t numberOfVoxels, unsigned short* output)
+{
+  const __m128i sign = _mm_set1_epi16( (short) 0x8000 );
+  size_t i = 0;
+  for( ; i + 8 <= numberOfVoxels; i += 8 )
+    _mm_storeu_si128( (__m128i*) (output + i), _mm_xor_si128( _mm_loadu_si128( (const __m128i*) (input + i) ), sign ) );
+  for( ; i < numberOfVoxels; i++ )
+    output[i] = (unsigned short) (input[i] ^ 0x8000);
+}
+
+static void CPU_vtkCUDAVolumeMapper_packFloats(const int* input, size_t numberOfVoxels, float* output)
+{
+  size_t i = 0;
+  for( ; i + 4 <= numberOfVoxels; i += 4 )
+    _mm_storeu_ps( output + i, _mm_cvtepi32_ps( _mm_loadu_si128( (const __m128i*) (input + i) ) ) );
+  for( ; i < numberOfVoxels; i++ )
+    output[i] = (float) input[i];
+}
+
+static void CPU_vtkCUDAVolumeMapper_packFloats(const double* input, size_t numberOfVoxels, float* output)
+{
+  size_t i = 0;
+  for( ; i + 4 <= numberOfVoxels; i += 4 )
+    {
+    __m128 low = _mm_cvtpd_ps( _mm_loadu_pd( input + i ) );
+    __m128 high = _mm_cvtpd_ps( _mm_loadu_pd( input + i + 2 ) );
+    _mm_storeu_ps( output + i, _mm_movelh_ps( low, high ) );
+    }
+  for( ; i < numberOfVoxels; i++ )
+    output[i] = (float) input[i];
+}
+
+static void CPU_vtkCUDAVolumeMapper_packIntegers(const char* input, size_t numberOfVoxels, double shift, unsigned char* output)
+{
+  if( shift == -128.0 ) CPU_vtkCUDAVolumeMapper_flipSign8( input, numberOfVoxels, output );
+  else CPU_vtkCUDAVolumeMapper_packIntegers<char, unsigned char>( input, numberOfVoxels, shift, output );
+}
+
+static void CPU_vtkCUDAVolumeMapper_packIntegers(const signed char* input, size_t numberOfVoxels, double shift, unsigned char* output)
+{
+  if( shift == -128.0 ) CPU_vtkCUDAVolumeMapper_flipSign8( (const char*) input, numberOfVoxels, output );
+  else CPU_vtkCUDAVolumeMapper_packIntegers<signed char, unsigned char>( input, numberOfVoxels, shift, output );
+}
+
+static void CPU_vtkCUDAVolumeMapper_packIntegers(const short* input, size_t numberOfVoxels, double shift, unsigned short* output)
+{
+  if( shift == -32768.0 ) CPU_vtkCUDAVolumeMapper_flipSign16( input, numberOfVoxels, output );
+  else CPU_vtkCUDAVolumeMapper_packIntegers<short, unsigned short>( input, numberOfVoxels, shift, output );
+}
+#endif
+
+template< class TIn >
+static bool CPU_vtkCUDAVolumeMapper_packImageTemplate(const TIn* input, size_t numberOfVoxels,
+                                                      const cudaVolumePackingInformation& packing, void* output)
+{
+  switch( packing.Format )
+    {
+    case CUDA_PACKED_UNSIGNED_CHAR:
+      CPU_vtkCUDAVolumeMapper_packIntegers(input, numberOfVoxels, (double) packing.Shift, (unsigned char*) output);
+      return true;
+    case CUDA_PACKED_UNSIGNED_SHORT:
+      CPU_vtkCUDAVolumeMapper_packIntegers(input, numberOfVoxels, (double) packing.Shift, (unsigned short*) output);
+      return true;
+    case CUDA_PACKED_FLOAT:
+      CPU_vtkCUDAVolumeMapper_packFloats(input, numberOfVoxels, (float*) output);
+      return true;
+    default:
+      return false;
+    }
+}
+
+bool CPU_vtkCUDAVolumeMapper_packImage(const void* input, int scalarType, size_t numberOfVoxels,
+                                       const cudaVolumePackingInformation& packing, void* output)
+{
+  if( !input || !output ) return false;
+
+  //data already in the packed format is just copied
+  if( CPU_vtkCUDAVolumeMapper_isNativePacking(scalarType, packing) )
+    {
+    memcpy( output, input, numberOfVoxels * CPU_vtkCUDAVolumeMapper_packedVoxelSize(packing) );
+    return true;
+    }
+
+  switch( scalarType )
+    {
+    case VTK_CHAR:           return CPU_vtkCUDAVolumeMapper_packImageTemplate( (const char*) input, numberOfVoxels, packing, output );
+    case VTK_SIGNED_CHAR:    return CPU_vtkCUDAVolumeMapper_packImageTemplate( (const signed char*) input, numberOfVoxels, packing, output );
+    case VTK_UNSIGNED_CHAR:  return CPU_vtkCUDAVolumeMapper_packImageTemplate( (const unsigned char*) input, numberOfVoxels, packing, output );
+    case VTK_SHORT:          return CPU_vtkCUDAVolumeMapper_packImageTemplate( (const short*) input, numberOfVoxels, packing, output );
+    case VTK_UNSIGNED_SHORT: return CPU_vtkCUDAVolumeMapper_packImageTemplate( (const unsigned short*) input, numberOfVoxels, packing, output );
+    case VTK_INT:            return CPU_vtkCUDAVolumeMapper_packImageTemplate( (const int*) input, numberOfVoxels, packing, output );
+    case VTK_UNSIGNED_INT:   return CPU_vtkCUDAVolumeMapper_packImageTemplate( (const unsigned int*) input, numberOfVoxels, packing, output );
+    case VTK_LONG:           return CPU_vtkCUDAVolumeMapper_packImageTemplate( (const long*) input, numberOfVoxels, packing, output );
+    case VTK_UNSIGNED_LONG:  return CPU_vtkCUDAVolumeMapper_packImageTemplate( (const unsigned long*) input, numberOfVoxels, packing, output );
+    case VTK_FLOAT:          return CPU_vtkCUDAVolumeMapper_packImageTemplate( (const float*) input, numberOfVoxels, packing, output );
+    case VTK_DOUBLE:         return CPU_vtkCUDAVolumeMapper_packImageTemplate( (const double*) input, numberOfVoxels, packing, output );
+    default:                 return false;
+    }
+}
+
+float CPU_vtkCUDAVolumeMapper_unpackVoxel(const void* packed, size_t index, const cudaVolumePackingInformation& packing)
+{
+  switch( packing.Format )
+    {
+    case CUDA_PACKED_UNSIGNED_CHAR:
+      return packing.Scale * ( ((const unsigned char*) packed)[index] / 255.0f ) + packing.Shift;
+    case CUDA_PACKED_UNSIGNED_SHORT:
+      return packing.Scale * ( ((const unsigned short*) packed)[index] / 65535.0f ) + packing.Shift;
+    default:
+      return packing.Scale * ((const float*) packed)[index] + packing.Shift;
+    }
+}
+
+/** @brief The arguments shared by the tasks of a parallel conversion
+*
+*/
+typedef struct
+{
+  const char* Input;
+  int ScalarType;
+  size_t InputVoxelSize;
+  size_t NumberOfVoxels;
+  const cudaVolumePackingInformation* Packing;
+  char* Output;
+  size_t OutputVoxelSize;
+  bool Failed;
+} CPU_vtkCUDAVolumeMapper_packTask;
+
+static void CPU_vtkCUDAVolumeMapper_packImageTask(int task, int, void* userData)
+{
+  CPU_vtkCUDAVolumeMapper_packTask* args = (CPU_vtkCUDAVolumeMapper_packTask*) userData;
+  size_t first = (size_t) task * CPU_PACK_VOXELS_PER_TASK;
+  size_t count = args->NumberOfVoxels - first;
+  if( count > CPU_PACK_VOXELS_PER_TASK ) count = CPU_PACK_VOXELS_PER_TASK;
+  if( !CPU_vtkCUDAVolumeMapper_packImage( args->Input + first * args->InputVoxelSize, args->ScalarType, count,
+                                          *(args->Packing), args->Output + first * args->OutputVoxelSize ) )
+    args->Failed = true;
+}
+
+size_t CPU_vtkCUDAVolumeMapper_scalarSize(int scalarType)
+{
+  switch( scalarType )
+    {
+    case VTK_CHAR:           return sizeof(char);
+    case VTK_SIGNED_CHAR:    return sizeof(signed char);
+    case VTK_UNSIGNED_CHAR:  return sizeof(unsigned char);
+    case VTK_SHORT:          return sizeof(short);
+    case VTK_UNSIGNED_SHORT: return sizeof(unsigned short);
+    case VTK_INT:            return sizeof(int);
+    case VTK_UNSIGNED_INT:   return sizeof(unsigned int);
+    case VTK_LONG:           return sizeof(long);
+    case VTK_UNSIGNED_LONG:  return sizeof(unsigned long);
+    case VTK_FLOAT:          return sizeof(float);
+    case VTK_DOUBLE:         return sizeof(double);
+    default:                 return 0;
+    }
+}
+
+bool CPU_vtkCUDAVolumeMapper_packImageParallel(const void* input, int scalarType, size_t numberOfVoxels,
+                                               const cudaVolumePackingInformation& packing, void* output,
+                                               vtkCUDAHostThreadPool* pool)
+{
+  int numberOfTasks = (int) ((numberOfVoxels + CPU_PACK_VOXELS_PER_TASK - 1) / CPU_PACK_VOXELS_PER_TASK);
+  if( !pool || numberOfTasks < 2 )
+    return CPU_vtkCUDAVolumeMapper_packImage(input, scalarType, numberOfVoxels, packing, output);
+  if( !input || !output || CPU_vtkCUDAVolumeMapper_scalarSize(scalarType) == 0 ) return false;
+
+  CPU_vtkCUDAVolumeMapper_packTask args;
+  args.Input = (const char*) input;
+  args.ScalarType = scalarType;
+  args.InputVoxelSize = CPU_vtkCUDAVolumeMapper_scalarSize(scalarType);
+  args.NumberOfVoxels = numberOfVoxels;
+  args.Packing = &packing;
+  args.Output = (char*) output;
+  args.OutputVoxelSize = CPU_vtkCUDAVolumeMapper_packedVoxelSize(packing);
+  args.Failed = false;
+  pool->ParallelFor(numberOfTasks, CPU_vtkCUDAVolumeMapper_packImageTask, &args);
+  return !args.Failed;
+}
@@ -0,0 +1,76 @@
+/** @file CPU_vtkCUDAVolumeMapper_packImage.h
+*
+*  @brief Header file with definitions for the host functions converting VTK scalars into the voxel formats the ray casters sample
+*
+*  @note This is primarily an internal file used by the volume mappers when loading image data. 8 and 16-bit data is kept
+*        at its native width (read back through the textures as normalized floats), so only the scale and shift needed
+*        to recover the original intensities are passed on, to be folded into the transfer function ranges.
+*
+*/
+
+#ifndef __CPU_vtkCUDAVolumeMapper_packImage_h
+#define __CPU_vtkCUDAVolumeMapper_packImage_h
+
+// CUDA Volume Rendering includes
+#include "CUDA_containerVolumePackingInformation.h"
+
+// STD includes
+#include <cstddef>
+
+class vtkCUDAHostThreadPool;
+
+/** @brief Picks the narrowest voxel format that holds every value of the image exactly
+*
+*  @param scalarType The VTK scalar type of the image (VTK_CHAR through VTK_DOUBLE)
+*  @param scalarRange The minimum and maximum value in the image, used to fit wider integer types into 8 or 16 bits
+*  @param packing Receives the format, and the scale and shift such that intensity = Scale * read value + Shift
+*
+*  @return false if the scalar type is not supported
+*/
+bool CPU_vtkCUDAVolumeMapper_choosePacking(int scalarType, const double scalarRange[2], cudaVolumePackingInformation& packing);
+
+/** @brief Whether the packed voxels are bit for bit the input scalars, so the input can be loaded without conversion
+*
+*/
+bool CPU_vtkCUDAVolumeMapper_isNativePacking(int scalarType, const cudaVolumePackingInformation& packing);
+
+/** @brief The size in bytes of one voxel in the given packing
+*
+*/
+size_t CPU_vtkCUDAVolumeMapper_packedVoxelSize(const cudaVolumePackingInformation& packing);
+
+/** @brief Converts a run of voxels into the given packing
+*
+*  @param input The first voxel to convert, of type scalarType
+*  @param scalarType The VTK scalar type of the input
+*  @param numberOfVoxels The number of voxels to convert
+*  @param packing The format chosen by CPU_vtkCUDAVolumeMapper_choosePacking for the whole image
+*  @param output Receives numberOfVoxels voxels of CPU_vtkCUDAVolumeMapper_packedVoxelSize bytes each
+*
+*  @pre Every input value lies within the scalar range the packing was chosen for (values outside it are clamped)
+*  @note Runs are independent, so an image can be converted in chunks
+*/
+bool CPU_vtkCUDAVolumeMapper_packImage(const void* input, int scalarType, size_t numberOfVoxels,
+                                       const cudaVolumePackingInformation& packing, void* output);
+
+/** @brief Converts a run of voxels into the given packing, splitting the work between the threads of a pool
+*
+*  @param pool The threads to convert with, or null to convert on the calling thread
+*
+*  @see CPU_vtkCUDAVolumeMapper_packImage
+*/
+bool CPU_vtkCUDAVolumeMapper_packImageParallel(const void* input, int scalarType, size_t numberOfVoxels,
+                                               const cudaVolumePackingInformation& packing, void* output,
+                                               vtkCUDAHostThreadPool* pool);
+
+/** @brief The size in bytes of one scalar of the given VTK type, or 0 if the type is not supported
+*
+*/
+size_t CPU_vtkCUDAVolumeMapper_scalarSize(int scalarType);
+
+/** @brief Recovers the original intensity of a packed voxel, as the ray casters see it
+*
+*/
+float CPU_vtkCUDAVolumeMapper_unpackVoxel(const void* packed, size_t index, const cudaVolumePackingInformation& packing);
+
+#endif
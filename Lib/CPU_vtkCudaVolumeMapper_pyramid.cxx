@@ -0,0 +1,72 @@
+/** @file CPU_vtkCUDAVolumeMapper_pyramid.cxx
+*
+*  @brief Host functions building the mip pyramid of a volume
+*
+*/
+
+#include "CPU_vtkCUDAVolumeMapper_pyramid.h"
+#include "CPU_vtkCUDAVolumeMapper_bricks.h"
+#include "vector_functions.h"
+
+// VTK includes
+#include <vtkType.h>
+
+bool CPU_vtkCUDAVolumeMapper_buildPyramid(const void* input, int scalarType, const int3& volumeSize, int numberOfLevels,
+                                          int reduction, cudaPyramidInformation& pyramid, std::vector<float>& levels,
+                                          vtkCUDAHostThreadPool* pool)
+{
+  pyramid.NumberOfLevels = 0;
+  pyramid.Reduction = reduction;
+  levels.clear();
+  if( !input || volumeSize.x < 1 || volumeSize.y < 1 || volumeSize.z < 1 ) return false;
+
+  //halve the volume until it is a single voxel, laying the levels side by side along x
+  numberOfLevels = numberOfLevels > CUDA_MAX_PYRAMID_LEVELS ? CUDA_MAX_PYRAMID_LEVELS : numberOfLevels;
+  int3 size = volumeSize;
+  int origin = 0;
+  size_t numberOfVoxels = 0;
+  int count = 0;
+  while( count < numberOfLevels && (size.x > 1 || size.y > 1 || size.z > 1) )
+    {
+    size = make_int3( (size.x + 1) / 2, (size.y + 1) / 2, (size.z + 1) / 2 );
+    pyramid.LevelSize[count] = size;
+    pyramid.LevelOrigin[count] = origin;
+    pyramid.LevelScale[count] = 1.0f / (float) (2 << count);
+    origin += size.x;
+    numberOfVoxels += (size_t) size.x * (size_t) size.y * (size_t) size.z;
+    count++;
+    }
+  levels.resize( numberOfVoxels );
+  if( count == 0 ) return true;
+
+  //the first level is reduced from the input, and each following one from the level before it, keeping the intensities as they are
+  cudaVolumePackingInformation asIs;
+  asIs.Format = CUDA_PACKED_FLOAT;
+  asIs.Scale = 1.0f;
+  asIs.Shift = 0.0f;
+  const void* finer = input;
+  int finerType = scalarType;
+  int3 finerSize = volumeSize;
+  for( int l = 0; l < count; l++ )
+    {
+    float* level = &(levels[0]) + CPU_vtkCUDAVolumeMapper_pyramidLevelOffset( pyramid, l + 1 );
+    if( !CPU_vtkCUDAVolumeMapper_downsampleImage( finer, finerType, finerSize, 2, reduction, asIs, level, pool ) )
+      {
+      levels.clear();
+      return false;
+      }
+    finer = level;
+    finerType = VTK_FLOAT;
+    finerSize = pyramid.LevelSize[l];
+    }
+  pyramid.NumberOfLevels = count;
+  return true;
+}
+
+size_t CPU_vtkCUDAVolumeMapper_pyramidLevelOffset(const cudaPyramidInformation& pyramid, int level)
+{
+  size_t offset = 0;
+  for( int l = 0; l < level - 1 && l < CUDA_MAX_PYRAMID_LEVELS; l++ )
+    offset += (size_t) pyramid.LevelSize[l].x * (size_t) pyramid.LevelSize[l].y * (size_t) pyramid.LevelSize[l].z;
+  return offset;
+}
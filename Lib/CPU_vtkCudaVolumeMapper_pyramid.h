@@ -0,0 +1,46 @@
+/** @file CPU_vtkCUDAVolumeMapper_pyramid.h
+*
+*  @brief Header file with definitions for the host functions building the mip pyramid of a volume
+*
+*  @note This is primarily an internal file used by the vtkCUDAVolumeInformationHandler when loading image data. The levels
+*        are kept as floats holding the original intensities, so they can be packed like any frame whatever the packing
+*        chosen for the volume.
+*
+*/
+
+#ifndef __CPU_vtkCUDAVolumeMapper_pyramid_h
+#define __CPU_vtkCUDAVolumeMapper_pyramid_h
+
+// CUDA Volume Rendering includes
+#include "CUDA_containerPyramidInformation.h"
+
+// STD includes
+#include <cstddef>
+#include <vector>
+
+class vtkCUDAHostThreadPool;
+
+/** @brief Builds the levels of the mip pyramid of a volume, each halving the one before it along every axis
+*
+*  @param input The voxels of the volume, of type scalarType and x fastest
+*  @param scalarType The VTK scalar type of the input
+*  @param volumeSize The size of the volume in voxels
+*  @param numberOfLevels The number of levels wanted, lowered to CUDA_MAX_PYRAMID_LEVELS and to where a level is a single voxel
+*  @param reduction How the voxels of a level are reduced, one of CUDA_PYRAMID_MEAN, CUDA_PYRAMID_MAX or CUDA_PYRAMID_MIN
+*  @param pyramid Receives the layout of the levels
+*  @param levels Receives the voxels of the levels as floats, level 1 first and each x fastest
+*  @param pool The threads to reduce with, or null to reduce on the calling thread
+*
+*  @return false if the scalar type is not supported, the pyramid being left without levels
+*/
+bool CPU_vtkCUDAVolumeMapper_buildPyramid(const void* input, int scalarType, const int3& volumeSize, int numberOfLevels,
+                                          int reduction, cudaPyramidInformation& pyramid, std::vector<float>& levels,
+                                          vtkCUDAHostThreadPool* pool);
+
+/** @brief The number of voxels in the levels of a pyramid finer than the given one, which is the offset of that level in the voxels
+*
+*  @param level The level, from 1 to NumberOfLevels + 1 (for the number of voxels in the whole pyramid)
+*/
+size_t CPU_vtkCUDAVolumeMapper_pyramidLevelOffset(const cudaPyramidInformation& pyramid, int level);
+
+#endif
@@ -0,0 +1,310 @@
+/** @file CPU_vtkCUDAVolumeMapper_renderAlgo.cxx
+ *
+ *  @brief Host (CPU) implementation of the ray set up common to the CUDA volume ray casters
+ *
+ *  @note Each function mirrors its device counterpart in CUDA_vtkCUDAVolumeMapper_renderAlgo.cu operation for
+ *        operation so the two produce the same rays. Keep them in step when changing either one.
+ *
+ */
+
+#include "CPU_vtkCUDAVolumeMapper_renderAlgo.h"
+
+// STD includes
+#include <algorithm>
+
+inline bool CPU_vtkCUDAVolumeMapper_isfinite(float v)
+{
+  return (v - v) == 0.0f;
+}
+
+//equivalent of CUDAkernel_ClipRayAgainstClippingPlanes
+static void CPU_vtkCUDAVolumeMapper_ClipRayAgainstClippingPlanes(const cudaRendererInformation& renInfo,
+                                                                 float3& rayStart, float3& rayEnd, float3& rayDir)
+{
+  const int numPlanes = renInfo.NumberOfClippingPlanes;
+  if(!numPlanes) return;
+
+  int flag = 0;
+  for( int i = 0; i < numPlanes; i++ ){
+
+    //refine the ray direction to account for any changes in starting or ending position
+    rayDir.x = rayEnd.x - rayStart.x;
+    rayDir.y = rayEnd.y - rayStart.y;
+    rayDir.z = rayEnd.z - rayStart.z;
+
+    const float* clippingPlane = renInfo.ClippingPlanes + 4*i;
+    const float dp = clippingPlane[0]*rayDir.x +
+                     clippingPlane[1]*rayDir.y +
+                     clippingPlane[2]*rayDir.z;
+    const float t = -(clippingPlane[0]*rayStart.x +
+                      clippingPlane[1]*rayStart.y +
+                      clippingPlane[2]*rayStart.z +
+                      clippingPlane[3]) / dp;
+
+    const float point0 = rayStart.x + t*rayDir.x;
+    const float point1 = rayStart.y + t*rayDir.y;
+    const float point2 = rayStart.z + t*rayDir.z;
+
+    //if the ray intersects the plane, set the start or end point to the intersection point
+    if( t > 0.0f && t < 1.0f ){
+      if( dp > 0.0f ){
+        rayStart.x = point0; rayStart.y = point1; rayStart.z = point2;
+      }else{
+        rayEnd.x = point0; rayEnd.y = point1; rayEnd.z = point2;
+      }
+    }
+
+    //flag this ray if it is outside the plane entirely
+    flag |= (dp > 0.0f && t > 1.0f);
+    flag |= (dp < 0.0f && t < 0.0f);
+  }
+
+  //if the ray is not inside the clipping planes, make the ray zero length
+  if(flag) rayStart = rayEnd;
+}
+
+//one axis of CUDAkernel_ClipRayAgainstVolume, with start/end/dir the components along that axis
+static void CPU_vtkCUDAVolumeMapper_ClipRayAgainstSlab(float boundsLow, float boundsHigh,
+                                                       float startA, float endA, float dirA,
+                                                       float3& rayStart, float3& rayEnd, const float3& rayDir)
+{
+  float diffS;
+  float diffE;
+  if(dirA > 0.0f){
+    diffS = startA < boundsLow ? boundsLow - startA : 0.0f;
+    diffE = endA > boundsHigh ? boundsHigh - endA : 0.0f;
+  }else{
+    diffS = startA > boundsHigh ? boundsHigh - startA : 0.0f;
+    diffE = endA < boundsLow ? boundsLow - endA : 0.0f;
+  }
+  diffS /= dirA;
+  diffE /= dirA;
+
+  //crop the ray to fit this direction if possible
+  if(CPU_vtkCUDAVolumeMapper_isfinite(diffS)){
+    rayStart.x += rayDir.x * diffS;
+    rayStart.y += rayDir.y * diffS;
+    rayStart.z += rayDir.z * diffS;
+    rayEnd.x += rayDir.x * diffE;
+    rayEnd.y += rayDir.y * diffE;
+    rayEnd.z += rayDir.z * diffE;
+  }
+}
+
+//equivalent of CUDAkernel_ClipRayAgainstVolume
+static void CPU_vtkCUDAVolumeMapper_ClipRayAgainstVolume(const cudaVolumeInformation& volInfo,
+                                                         float3& rayStart, float3& rayEnd, float3& rayDir)
+{
+  const float bounds0 = volInfo.Bounds[0]+1.0f;
+  const float bounds1 = volInfo.Bounds[1]-1.0f;
+  const float bounds2 = volInfo.Bounds[2]+1.0f;
+  const float bounds3 = volInfo.Bounds[3]-1.0f;
+  const float bounds4 = volInfo.Bounds[4]+1.0f;
+  const float bounds5 = volInfo.Bounds[5]-1.0f;
+
+  rayDir.x = rayEnd.x - rayStart.x;
+  rayDir.y = rayEnd.y - rayStart.y;
+  rayDir.z = rayEnd.z - rayStart.z;
+  CPU_vtkCUDAVolumeMapper_ClipRayAgainstSlab(bounds0, bounds1, rayStart.x, rayEnd.x, rayDir.x, rayStart, rayEnd, rayDir);
+
+  rayDir.x = rayEnd.x - rayStart.x;
+  rayDir.y = rayEnd.y - rayStart.y;
+  rayDir.z = rayEnd.z - rayStart.z;
+  CPU_vtkCUDAVolumeMapper_ClipRayAgainstSlab(bounds2, bounds3, rayStart.y, rayEnd.y, rayDir.y, rayStart, rayEnd, rayDir);
+
+  rayDir.x = rayEnd.x - rayStart.x;
+  rayDir.y = rayEnd.y - rayStart.y;
+  rayDir.z = rayEnd.z - rayStart.z;
+  CPU_vtkCUDAVolumeMapper_ClipRayAgainstSlab(bounds4, bounds5, rayStart.z, rayEnd.z, rayDir.z, rayStart, rayEnd, rayDir);
+
+  // If the voxel still isn't inside the volume, then this ray
+  // doesn't really intersect the volume, thus, make it all zero
+  if (rayEnd.x > bounds1 + 1.0f ||
+    rayEnd.y > bounds3 + 1.0f ||
+    rayEnd.z > bounds5 + 1.0f ||
+    rayEnd.x < bounds0 - 1.0f ||
+    rayEnd.y < bounds2 - 1.0f ||
+    rayEnd.z < bounds4 - 1.0f||
+    rayStart.x > bounds1 + 1.0f ||
+    rayStart.y > bounds3 + 1.0f ||
+    rayStart.z > bounds5 + 1.0f ||
+    rayStart.x < bounds0 - 1.0f ||
+    rayStart.y < bounds2 - 1.0f ||
+    rayStart.z < bounds4 - 1.0f ){
+    rayStart = rayEnd;
+  }
+
+  //refine the ray's length and direction to reflect any changes in the starting and ending co-ordinates
+  rayDir.x = rayEnd.x - rayStart.x;
+  rayDir.y = rayEnd.y - rayStart.y;
+  rayDir.z = rayEnd.z - rayStart.z;
+}
+
+template< bool Clipped, bool Perspective >
+void CPU_vtkCUDAVolumeMapper_renderAlgo_formRays(const cudaOutputImageInformation& outInfo,
+                                                 const cudaRendererInformation& renInfo,
+                                                 const cudaVolumeInformation& volInfo,
+                                                 const cpuRendererBuffers& buffers,
+                                                 int x, int y, cpuRayPacket& rays)
+{
+  const float* m = renInfo.ViewToVoxelsMatrix;
+
+  //project the whole packet into voxel space, one component at a time
+  float viewRayX[CPU_PACKET_WIDTH];
+  float endDepth[CPU_PACKET_WIDTH];
+  float endX[CPU_PACKET_WIDTH];
+  float endY[CPU_PACKET_WIDTH];
+  float endZ[CPU_PACKET_WIDTH];
+  const float viewRayY = ( ((float) y) / (float) outInfo.resolution.y );
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    viewRayX[l] = 1.0f - ( ((float) (x + l)) / (float) outInfo.resolution.x );
+    endDepth[l] = CPU_vtkCUDAVolumeMapper_tex2DPoint( buffers.ZBuffer, buffers.ZBufferSize, 1.0f-viewRayX[l], viewRayY );
+    }
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    rays.StartX[l] = viewRayX[l]*m[0] + viewRayY*m[1] + m[3];
+    rays.StartY[l] = viewRayX[l]*m[4] + viewRayY*m[5] + m[7];
+    rays.StartZ[l] = viewRayX[l]*m[8] + viewRayY*m[9] + m[11];
+    endX[l] = rays.StartX[l] + endDepth[l]*m[2];
+    endY[l] = rays.StartY[l] + endDepth[l]*m[6];
+    endZ[l] = rays.StartZ[l] + endDepth[l]*m[10];
+    }
+
+  //normalize the projections, which a parallel projection leaves normalized
+  if( Perspective )
+    {
+    for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+      {
+      const float startNorm = viewRayX[l]*m[12] + viewRayY*m[13] + m[15];
+      const float endNorm = startNorm + endDepth[l]*m[14];
+      rays.StartX[l] /= startNorm;
+      rays.StartY[l] /= startNorm;
+      rays.StartZ[l] /= startNorm;
+      endX[l] /= endNorm;
+      endY[l] /= endNorm;
+      endZ[l] /= endNorm;
+      }
+    }
+
+  //clipping is branchy, so it is done ray by ray
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    float3 rayStart;
+    float3 rayEnd;
+    float3 rayDir;
+    rayStart.x = rays.StartX[l]; rayStart.y = rays.StartY[l]; rayStart.z = rays.StartZ[l];
+    rayEnd.x = endX[l]; rayEnd.y = endY[l]; rayEnd.z = endZ[l];
+    if( Clipped ) CPU_vtkCUDAVolumeMapper_ClipRayAgainstClippingPlanes(renInfo, rayStart, rayEnd, rayDir);
+    CPU_vtkCUDAVolumeMapper_ClipRayAgainstVolume(volInfo, rayStart, rayEnd, rayDir);
+    rays.StartX[l] = rayStart.x; rays.StartY[l] = rayStart.y; rays.StartZ[l] = rayStart.z;
+    rays.IncX[l] = rayDir.x; rays.IncY[l] = rayDir.y; rays.IncZ[l] = rayDir.z;
+    }
+
+  //determine the maximum number of steps each ray should sample and determine the length of each step
+  //(either one smallest spacing in world units, or one voxel along the ray in voxel units, scaled by the quality)
+  const bool footprint = (renInfo.SamplingMode == CUDA_SAMPLE_VOXEL_FOOTPRINT);
+  const float sx = footprint ? 1.0f : volInfo.Spacing.x*volInfo.Spacing.x;
+  const float sy = footprint ? 1.0f : volInfo.Spacing.y*volInfo.Spacing.y;
+  const float sz = footprint ? 1.0f : volInfo.Spacing.z*volInfo.Spacing.z;
+  const float stepLength = footprint ? 1.0f : volInfo.MinSpacing;
+  for( int l = 0; l < CPU_PACKET_WIDTH; l++ )
+    {
+    rays.NumSteps[l] = std::sqrt( rays.IncX[l]*rays.IncX[l]*sx +
+                                  rays.IncY[l]*rays.IncY[l]*sy +
+                                  rays.IncZ[l]*rays.IncZ[l]*sz ) / stepLength;
+    rays.NumSteps[l] /= renInfo.SampleDistanceFactor;
+    rays.IncX[l] /= rays.NumSteps[l];
+    rays.IncY[l] /= rays.NumSteps[l];
+    rays.IncZ[l] /= rays.NumSteps[l];
+    }
+}
+
+template void CPU_vtkCUDAVolumeMapper_renderAlgo_formRays<false, false>(const cudaOutputImageInformation&, const cudaRendererInformation&,
+  const cudaVolumeInformation&, const cpuRendererBuffers&, int, int, cpuRayPacket&);
+template void CPU_vtkCUDAVolumeMapper_renderAlgo_formRays<true, false>(const cudaOutputImageInformation&, const cudaRendererInformation&,
+  const cudaVolumeInformation&, const cpuRendererBuffers&, int, int, cpuRayPacket&);
+template void CPU_vtkCUDAVolumeMapper_renderAlgo_formRays<false, true>(const cudaOutputImageInformation&, const cudaRendererInformation&,
+  const cudaVolumeInformation&, const cpuRendererBuffers&, int, int, cpuRayPacket&);
+template void CPU_vtkCUDAVolumeMapper_renderAlgo_formRays<true, true>(const cudaOutputImageInformation&, const cudaRendererInformation&,
+  const cudaVolumeInformation&, const cpuRendererBuffers&, int, int, cpuRayPacket&);
+
+void CPU_vtkCUDAVolumeMapper_renderAlgo_projectRay(float viewRayX, float viewRayY, float endDepth, const float* m,
+                                                   float3& rayStart, float3& rayDir)
+{
+  float startNorm = viewRayX*m[12] + viewRayY*m[13] + m[15];
+  float endNorm = startNorm + endDepth*m[14];
+  rayStart.x = viewRayX*m[0] + viewRayY*m[1] + m[3];
+  rayStart.y = viewRayX*m[4] + viewRayY*m[5] + m[7];
+  rayStart.z = viewRayX*m[8] + viewRayY*m[9] + m[11];
+  rayDir.x = (rayStart.x + endDepth*m[2]) / endNorm - rayStart.x / startNorm;
+  rayDir.y = (rayStart.y + endDepth*m[6]) / endNorm - rayStart.y / startNorm;
+  rayDir.z = (rayStart.z + endDepth*m[10]) / endNorm - rayStart.z / startNorm;
+  rayStart.x /= startNorm;
+  rayStart.y /= startNorm;
+  rayStart.z /= startNorm;
+}
+
+void CPU_vtkCUDAVolumeMapper_renderAlgo_clipRangeAgainstClippingPlanes(const cudaRendererInformation& renInfo,
+                                                                       const float3& rayStart, const float3& rayDir, float2& range)
+{
+  for( int i = 0; i < renInfo.NumberOfClippingPlanes; i++ ){
+    const float* clippingPlane = renInfo.ClippingPlanes + 4*i;
+    const float dp = clippingPlane[0]*rayDir.x +
+                     clippingPlane[1]*rayDir.y +
+                     clippingPlane[2]*rayDir.z;
+    const float distance = clippingPlane[0]*rayStart.x +
+                           clippingPlane[1]*rayStart.y +
+                           clippingPlane[2]*rayStart.z +
+                           clippingPlane[3];
+    if(dp > 0.0f) range.x = std::max(range.x, -distance / dp);
+    else if(dp < 0.0f) range.y = std::min(range.y, -distance / dp);
+    else if(distance < 0.0f) range.y = range.x;
+  }
+}
+
+void CPU_vtkCUDAVolumeMapper_renderAlgo_clipRangeAgainstVolume(const float* bounds, const float3& rayStart, const float3& rayDir,
+                                                               float2& range)
+{
+  const float start[3] = { rayStart.x, rayStart.y, rayStart.z };
+  const float dir[3] = { rayDir.x, rayDir.y, rayDir.z };
+  for( int i = 0; i < 3; i++ ){
+    const float low = bounds[2*i] + 1.0f;
+    const float high = bounds[2*i+1] - 1.0f;
+    if(dir[i] != 0.0f){
+      float t0 = (low - start[i]) / dir[i];
+      float t1 = (high - start[i]) / dir[i];
+      range.x = std::max(range.x, std::min(t0, t1));
+      range.y = std::min(range.y, std::max(t0, t1));
+    }else if(start[i] < low || start[i] > high){
+      range.y = range.x;
+    }
+  }
+}
+
+void CPU_vtkCUDAVolumeMapper_renderAlgo_accumulateImage(uchar4* image, float4* accumulation, const uint2& resolution, int pass)
+{
+  const size_t numberOfPixels = (size_t) resolution.x * (size_t) resolution.y;
+  const float count = (float) (pass + 1);
+  const float half = 0.5f * count;
+  for( size_t i = 0; i < numberOfPixels; i++ )
+    {
+    //add the pass to the sum, which holds whole numbers so it is exact in any order
+    uchar4 colour = image[i];
+    float4 sum;
+    if( pass ) sum = accumulation[i];
+    else sum.x = sum.y = sum.z = sum.w = 0.0f;
+    sum.x += (float) colour.x;
+    sum.y += (float) colour.y;
+    sum.z += (float) colour.z;
+    sum.w += (float) colour.w;
+    accumulation[i] = sum;
+
+    //replace the pass by the rounded mean
+    colour.x = (unsigned char) ((sum.x + half) / count);
+    colour.y = (unsigned char) ((sum.y + half) / count);
+    colour.z = (unsigned char) ((sum.z + half) / count);
+    colour.w = (unsigned char) ((sum.w + half) / count);
+    image[i] = colour;
+    }
+}
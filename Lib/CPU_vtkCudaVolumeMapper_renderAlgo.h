@@ -0,0 +1,227 @@
+/** @file CPU_vtkCUDAVolumeMapper_renderAlgo.h
+*
+*  @brief Header file with definitions for the host (CPU) counterparts of the common CUDA functions used to set up
+*         the ray casting process, together with host emulations of the texture fetches they rely on
+*
+*  @note This is primarily an internal file used by the vtkCUDAVolumeMapper and subclasses when rendering without
+*        a CUDA device, or when a reference image is needed to check the CUDA implementation against.
+*
+*/
+
+#ifndef __CPU_vtkCUDAVolumeMapper_renderAlgo_h
+#define __CPU_vtkCUDAVolumeMapper_renderAlgo_h
+
+// CUDA Volume Rendering includes
+#include "CUDA_containerOutputImageInformation.h"
+#include "CUDA_containerRendererInformation.h"
+#include "CUDA_containerVolumeInformation.h"
+
+// STD includes
+#include <climits>
+#include <cmath>
+
+#define CPU_BLOCK_DIM2D 16  //size of the image tiles, matching the tile of CUDA ray offsets so they agree
+#define CPU_PACKET_WIDTH 8  //number of neighbouring rays traced together
+
+/** @brief Host stand-ins for the device buffers and textures shared by all the CUDA ray casters
+*
+*/
+typedef struct
+{
+  const float*  ZBuffer;            /**< The depth buffer of the renderer (as loaded by loadZBuffer) */
+  uint2         ZBufferSize;        /**< The size of the depth buffer */
+  const float*  RandomRayOffsets;   /**< The 16x16 array of ray start offsets (as loaded by loadrandomRayOffsets) */
+  uchar4*       OutputImage;        /**< The host image the rays are composited into (outputInfo.resolution in size) */
+} cpuRendererBuffers;
+
+/** @brief A packet of neighbouring rays on a single image row, stored as structure-of-arrays so the lane loops forming them can be vectorized
+*
+*  Only the formation of the rays is done across lanes; the rays are then marched one lane after the other
+*
+*/
+typedef struct
+{
+  float StartX[CPU_PACKET_WIDTH];   /**< The ray starting location (x component) */
+  float StartY[CPU_PACKET_WIDTH];   /**< The ray starting location (y component) */
+  float StartZ[CPU_PACKET_WIDTH];   /**< The ray starting location (z component) */
+  float IncX[CPU_PACKET_WIDTH];     /**< The ray increment amount (x component) */
+  float IncY[CPU_PACKET_WIDTH];     /**< The ray increment amount (y component) */
+  float IncZ[CPU_PACKET_WIDTH];     /**< The ray increment amount (z component) */
+  float NumSteps[CPU_PACKET_WIDTH]; /**< The number of sample points on the ray */
+} cpuRayPacket;
+
+/** @brief Host equivalent of CUDAkernel_renderAlgo_formRays for the rays of the pixels (x, y) to (x+CPU_PACKET_WIDTH-1, y)
+*
+*  @param x The column of the first pixel in the packet
+*  @param y The row of the pixels in the packet
+*  @param rays The packet receiving the starting points, increments and number of steps of the rays
+*
+*  @note Specialized as the kernel, for whether the rays are clipped against the clipping planes (Clipped) and whether they
+*        are projected in perspective (Perspective), each of the four being instantiated in CPU_vtkCUDAVolumeMapper_renderAlgo.cxx
+*/
+template< bool Clipped, bool Perspective >
+void CPU_vtkCUDAVolumeMapper_renderAlgo_formRays(const cudaOutputImageInformation& outputInfo,
+                                                 const cudaRendererInformation& rendererInfo,
+                                                 const cudaVolumeInformation& volumeInfo,
+                                                 const cpuRendererBuffers& buffers,
+                                                 int x, int y, cpuRayPacket& rays);
+
+/** @brief Host equivalent of CUDAkernel_ProjectRay, projecting the ray of a pixel into the voxels of a volume without clipping it
+*
+*  @param viewRayX The horizontal view co-ordinate of the pixel
+*  @param viewRayY The vertical view co-ordinate of the pixel
+*  @param endDepth The depth of the opaque geometry behind the pixel
+*  @param viewToVoxels The view to voxels matrix of the volume
+*  @param rayStart Receives the start of the ray in voxels
+*  @param rayDir Receives the span of the ray up to the opaque geometry
+*
+*/
+void CPU_vtkCUDAVolumeMapper_renderAlgo_projectRay(float viewRayX, float viewRayY, float endDepth, const float* viewToVoxels,
+                                                   float3& rayStart, float3& rayDir);
+
+/** @brief Host equivalent of CUDAkernel_ClipRangeAgainstClippingPlanes, narrowing the range (in fractions of rayDir) of a
+*          ray projected into the voxels of the rendered volume to the inside of the clipping planes
+*
+*/
+void CPU_vtkCUDAVolumeMapper_renderAlgo_clipRangeAgainstClippingPlanes(const cudaRendererInformation& rendererInfo,
+                                                                       const float3& rayStart, const float3& rayDir, float2& range);
+
+/** @brief Host equivalent of CUDAkernel_ClipRangeAgainstVolume, narrowing the range (in fractions of rayDir) of a projected
+*          ray to the inside of the bounds of a volume, kept one voxel clear of the faces
+*
+*/
+void CPU_vtkCUDAVolumeMapper_renderAlgo_clipRangeAgainstVolume(const float* bounds, const float3& rayStart, const float3& rayDir,
+                                                               float2& range);
+
+/** @brief Host equivalent of CUDA_vtkCUDAVolumeMapper_renderAlgo_accumulateImage, adding the image just rendered to the running
+*          sum of the previous passes and replacing it with their mean
+*
+*  @param image The image just rendered, which receives the mean of all the passes rendered so far
+*  @param accumulation The running sum of the passes, in 0 to 255 units
+*  @param resolution The size of both images
+*  @param pass The number of passes already in the sum, 0 to restart it from this image
+*
+*/
+void CPU_vtkCUDAVolumeMapper_renderAlgo_accumulateImage(uchar4* image, float4* accumulation, const uint2& resolution, int pass);
+
+//----------------------------------------------------------------------------
+// Host emulation of the texture fetches. Linear filtering mirrors the hardware, where
+// the interpolation weights are held in 9-bit fixed point with 8 fractional bits.
+
+/** @brief Equivalent of saturate, which maps NaN (such as the shading of a sample without a gradient) to 0 */
+inline float CPU_vtkCUDAVolumeMapper_saturate(float v)
+{
+  return v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f;
+}
+
+/** @brief Equivalent of __float2int_rd, which saturates and maps NaN to 0 rather than being undefined */
+inline int CPU_vtkCUDAVolumeMapper_float2int_rd(float v)
+{
+  if( !(v == v) ) return 0;
+  if( v >= 2147483647.0f ) return INT_MAX;
+  if( v <= -2147483648.0f ) return INT_MIN;
+  return (int) std::floor(v);
+}
+
+inline float CPU_vtkCUDAVolumeMapper_textureWeight(float a)
+{
+  return std::floor(a * 256.0f + 0.5f) * (1.0f / 256.0f);
+}
+
+inline int CPU_vtkCUDAVolumeMapper_clampIndex(int i, int size)
+{
+  return i < 0 ? 0 : (i >= size ? size - 1 : i);
+}
+
+/** @brief Equivalent of tex2D on a point-filtered, clamped texture with normalized co-ordinates */
+inline float CPU_vtkCUDAVolumeMapper_tex2DPoint(const float* image, uint2 size, float u, float v)
+{
+  int i = CPU_vtkCUDAVolumeMapper_clampIndex( (int) std::floor(u * (float) size.x), (int) size.x );
+  int j = CPU_vtkCUDAVolumeMapper_clampIndex( (int) std::floor(v * (float) size.y), (int) size.y );
+  return image[i + j * size.x];
+}
+
+/** @brief Equivalent of tex1D on a linearly filtered, clamped texture with normalized co-ordinates */
+inline float CPU_vtkCUDAVolumeMapper_tex1D(const float* table, unsigned int size, float u)
+{
+  float xB = u * (float) size - 0.5f;
+  float fx = std::floor(xB);
+  float a = CPU_vtkCUDAVolumeMapper_textureWeight(xB - fx);
+  int i0 = CPU_vtkCUDAVolumeMapper_clampIndex( (int) fx, (int) size );
+  int i1 = CPU_vtkCUDAVolumeMapper_clampIndex( (int) fx + 1, (int) size );
+  return (1.0f - a) * table[i0] + a * table[i1];
+}
+
+/** @brief Equivalent of tex1D on one channel of a table of interleaved channels, such as a row of a 2D RGBA texture read at its centre */
+inline float CPU_vtkCUDAVolumeMapper_tex1D(const float* table, unsigned int size, unsigned int stride, float u)
+{
+  float xB = u * (float) size - 0.5f;
+  float fx = std::floor(xB);
+  float a = CPU_vtkCUDAVolumeMapper_textureWeight(xB - fx);
+  int i0 = CPU_vtkCUDAVolumeMapper_clampIndex( (int) fx, (int) size );
+  int i1 = CPU_vtkCUDAVolumeMapper_clampIndex( (int) fx + 1, (int) size );
+  return (1.0f - a) * table[i0 * stride] + a * table[i1 * stride];
+}
+
+/** @brief Equivalent of tex2D on a linearly filtered, clamped RGBA texture with normalized co-ordinates */
+inline float4 CPU_vtkCUDAVolumeMapper_tex2D(const float* image, unsigned int size, float u, float v)
+{
+  float xB = u * (float) size - 0.5f;
+  float yB = v * (float) size - 0.5f;
+  float fx = std::floor(xB);
+  float fy = std::floor(yB);
+  float a = CPU_vtkCUDAVolumeMapper_textureWeight(xB - fx);
+  float b = CPU_vtkCUDAVolumeMapper_textureWeight(yB - fy);
+  int i0 = 4 * CPU_vtkCUDAVolumeMapper_clampIndex( (int) fx, (int) size );
+  int i1 = 4 * CPU_vtkCUDAVolumeMapper_clampIndex( (int) fx + 1, (int) size );
+  int j0 = 4 * CPU_vtkCUDAVolumeMapper_clampIndex( (int) fy, (int) size ) * (int) size;
+  int j1 = 4 * CPU_vtkCUDAVolumeMapper_clampIndex( (int) fy + 1, (int) size ) * (int) size;
+  float texel[4];
+  for( int c = 0; c < 4; c++ )
+    texel[c] = (1.0f - b) * ((1.0f - a) * image[j0 + i0 + c] + a * image[j0 + i1 + c]) +
+               b * ((1.0f - a) * image[j1 + i0 + c] + a * image[j1 + i1 + c]);
+  float4 value;
+  value.x = texel[0];
+  value.y = texel[1];
+  value.z = texel[2];
+  value.w = texel[3];
+  return value;
+}
+
+/** @brief Equivalent of reading a voxel through a texture, 8 and 16-bit voxels being read as normalized floats */
+inline float CPU_vtkCUDAVolumeMapper_readVoxel(const unsigned char* volume, size_t i) { return volume[i] / 255.0f; }
+inline float CPU_vtkCUDAVolumeMapper_readVoxel(const unsigned short* volume, size_t i) { return volume[i] / 65535.0f; }
+inline float CPU_vtkCUDAVolumeMapper_readVoxel(const float* volume, size_t i) { return volume[i]; }
+
+/** @brief Equivalent of tex3D on a linearly filtered, clamped texture with unnormalized co-ordinates */
+template< class T >
+inline float CPU_vtkCUDAVolumeMapper_tex3D(const T* volume, const int3& size, float x, float y, float z)
+{
+  float xB = x - 0.5f;
+  float yB = y - 0.5f;
+  float zB = z - 0.5f;
+  float fx = std::floor(xB);
+  float fy = std::floor(yB);
+  float fz = std::floor(zB);
+  float a = CPU_vtkCUDAVolumeMapper_textureWeight(xB - fx);
+  float b = CPU_vtkCUDAVolumeMapper_textureWeight(yB - fy);
+  float c = CPU_vtkCUDAVolumeMapper_textureWeight(zB - fz);
+
+  int i0 = CPU_vtkCUDAVolumeMapper_clampIndex( (int) fx, size.x );
+  int i1 = CPU_vtkCUDAVolumeMapper_clampIndex( (int) fx + 1, size.x );
+  int j0 = CPU_vtkCUDAVolumeMapper_clampIndex( (int) fy, size.y ) * size.x;
+  int j1 = CPU_vtkCUDAVolumeMapper_clampIndex( (int) fy + 1, size.y ) * size.x;
+  size_t slice = (size_t) size.x * (size_t) size.y;
+  size_t k0 = (size_t) CPU_vtkCUDAVolumeMapper_clampIndex( (int) fz, size.z ) * slice;
+  size_t k1 = (size_t) CPU_vtkCUDAVolumeMapper_clampIndex( (int) fz + 1, size.z ) * slice;
+
+  float v00 = (1.0f - a) * CPU_vtkCUDAVolumeMapper_readVoxel(volume, k0 + j0 + i0) + a * CPU_vtkCUDAVolumeMapper_readVoxel(volume, k0 + j0 + i1);
+  float v10 = (1.0f - a) * CPU_vtkCUDAVolumeMapper_readVoxel(volume, k0 + j1 + i0) + a * CPU_vtkCUDAVolumeMapper_readVoxel(volume, k0 + j1 + i1);
+  float v01 = (1.0f - a) * CPU_vtkCUDAVolumeMapper_readVoxel(volume, k1 + j0 + i0) + a * CPU_vtkCUDAVolumeMapper_readVoxel(volume, k1 + j0 + i1);
+  float v11 = (1.0f - a) * CPU_vtkCUDAVolumeMapper_readVoxel(volume, k1 + j1 + i0) + a * CPU_vtkCUDAVolumeMapper_readVoxel(volume, k1 + j1 + i1);
+  float v0 = (1.0f - b) * v00 + b * v10;
+  float v1 = (1.0f - b) * v01 + b * v11;
+  return (1.0f - c) * v0 + c * v1;
+}
+
+#endif
@@ -13,6 +13,8 @@
 #define __CUDA_container1DTransferFunctionInformation_h
 
 // CUDA Volume Rendering includes
+#include "CUDA_containerVolumeInformation.h"
+#include "texture_types.h"
 #include "vector_types.h"
 
 /** @brief A stucture located on the CUDA hardware that holds all the information required about the volume being renderered.
@@ -27,12 +29,35 @@ typedef struct __align__(16)
   float      gradientMultiplier;   /**< Scale factor to normalize intensities to between 0 and 1 */
   unsigned int  functionSize;      /**< The size of the lookup table */
 
+  // The same for each fused volume, whose lookup tables are rows of 2D textures
+  float      fusedIntensityLow[CUDA_MAX_FUSED_VOLUMES];         /**< Minimum intensity of each fused volume */
+  float      fusedIntensityMultiplier[CUDA_MAX_FUSED_VOLUMES];  /**< Scale factor to normalize the intensities of each fused volume */
+  float      fusedGradientLow[CUDA_MAX_FUSED_VOLUMES];          /**< Minimum gradient of each fused volume */
+  float      fusedGradientMultiplier[CUDA_MAX_FUSED_VOLUMES];   /**< Scale factor to normalize the gradients of each fused volume */
+
+  // The macro cells of the volume that the opacity lookup table leaves fully transparent
+  int        macroCellSize;        /**< Size of a macro cell along each axis in voxels, 0 when empty space is not skipped */
+  int3       macroCellGridSize;    /**< Number of macro cells in X, Y and Z */
+  unsigned char* macroCellOccupancy; /**< Device buffer holding 0 for each empty cell and 1 for each other cell, x fastest */
+
+  // The pre-integrated lookup table of the segments between two samples, indexed by the intensities at their front and back
+  unsigned int  preIntegratedSize; /**< The size of each side of the table, 0 when the samples are classified as points */
+
   //opague memory back for the transfer function
   cudaArray* alphaTransferArray1D;
   cudaArray* galphaTransferArray1D;
   cudaArray* colorRTransferArray1D;
   cudaArray* colorGTransferArray1D;
   cudaArray* colorBTransferArray1D;
+  cudaArray* preIntegratedTransferArray2D;
+
+  //texture objects reading each array, normalized and linearly interpolated
+  cudaTextureObject_t alphaTexture1D;
+  cudaTextureObject_t galphaTexture1D;
+  cudaTextureObject_t colorRTexture1D;
+  cudaTextureObject_t colorGTexture1D;
+  cudaTextureObject_t colorBTexture1D;
+  cudaTextureObject_t preIntegratedTexture2D; /**< RGBA, the opacity of the segment in A and its mean colour in RGB */
 
 } cuda1DTransferFunctionInformation;
 
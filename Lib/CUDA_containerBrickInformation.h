@@ -0,0 +1,35 @@
+/** @file CUDA_containerBrickInformation.h
+*
+*  @brief File for the structure describing a volume split into bricks, only some of which are held on the device
+*
+*  @note This is primarily an internal file used by the vtkCUDABrickManager, the volume mappers and CUDA_renderAlgo to agree
+*        on where each brick of a volume too large for the device lies in the pool of bricks held there
+*
+*/
+
+#ifndef __CUDA_containerBrickInformation_h
+#define __CUDA_containerBrickInformation_h
+
+// CUDA Volume Rendering includes
+#include "vector_types.h"
+
+/** @brief Size of a brick along each axis, in voxels of the volume */
+#define CUDA_BRICK_SIZE 32
+
+/** @brief Voxels repeated from the neighbouring bricks on each face of a brick, so its samples interpolate across the faces */
+#define CUDA_BRICK_APRON 1
+
+/** @brief A stucture located on the CUDA hardware that holds the page table of a bricked volume
+*
+*/
+typedef struct __align__(16)
+{
+  int4*           PageTable;    /**< Per brick (x fastest), the origin of its slot in the pool in voxels (x, y, z) and whether it is held (w) */
+  unsigned char*  Requests;     /**< Per brick, set to 1 by every ray sampling it, read back and cleared by the host after each frame */
+  int3            GridSize;     /**< Number of bricks along X, Y and Z */
+  int             BrickSize;    /**< Size of a brick along each axis, without its apron */
+  float           CoarseScale;  /**< Factor from the voxels of the volume to those of the low resolution volume sampled where bricks are missing */
+
+} cudaBrickInformation;
+
+#endif
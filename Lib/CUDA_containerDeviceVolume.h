@@ -0,0 +1,29 @@
+/** @file CUDA_containerDeviceVolume.h
+*
+*  @brief File for the structure holding a volume resident on a device for volume ray casting
+*
+*  @note This is primarily an internal file used by the vtkCUDAVolumeCache, the volume mappers and CUDA_renderAlgo to share
+*        the frames uploaded to a device between the mappers rendering them
+*
+*/
+
+#ifndef __CUDA_containerDeviceVolume_h
+#define __CUDA_containerDeviceVolume_h
+
+// CUDA Volume Rendering includes
+#include "texture_types.h"
+#include "vector_types.h"
+
+/** @brief A structure located on the host describing a volume held in a 3D CUDA array, and the texture object reading it
+*
+*/
+typedef struct
+{
+  cudaArray*          Array;     /**< The voxels, in the packing given by Format */
+  cudaTextureObject_t Texture;   /**< Texture object reading Array in voxel co-ordinates, linearly interpolated */
+  int                 Format;    /**< How the voxels are stored, one of the cudaVolumePackingFormat values */
+  cudaEvent_t         Uploaded;  /**< Recorded on the stream the volume was copied on, after its last copy, for the streams rendering it to wait on */
+
+} cudaDeviceVolume;
+
+#endif
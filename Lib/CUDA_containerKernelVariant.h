@@ -0,0 +1,32 @@
+/** @file CUDA_containerKernelVariant.h
+*
+*  @brief File for the flags naming the features a variant of the ray casting kernels is compiled with
+*
+*  @note This is primarily an internal file used by the vtkCUDA1DVolumeMapper and CUDA_renderAlgo to agree on which of the
+*        kernels specialized at compile time renders a frame, the mapper picking the features the frame uses and the
+*        renderAlgo functions indexing their dispatch tables with them
+*
+*/
+
+#ifndef __CUDA_containerKernelVariant_h
+#define __CUDA_containerKernelVariant_h
+
+/** @brief The samples are Phong shaded from their gradient (without it the colour is the one looked up) */
+#define CUDA_VARIANT_SHADED 1
+/** @brief The opacity of the samples is scaled by the gradient opacity lookup table */
+#define CUDA_VARIANT_GRADIENT_OPACITY 2
+/** @brief The rays are clipped against the user defined clipping planes */
+#define CUDA_VARIANT_CLIPPED 4
+/** @brief The rays are formed through a perspective projection (without it the last row of the view to voxels matrix is (0, 0, 0, 1)) */
+#define CUDA_VARIANT_PERSPECTIVE 8
+
+/** @brief The rays composite the segments between samples through the pre-integrated lookup table rather than the samples themselves */
+#define CUDA_VARIANT_PREINTEGRATED 16
+
+/** @brief The number of variants, each combination of the flags above being one */
+#define CUDA_NUMBER_OF_VARIANTS 32
+/** @brief The variant compiled with every feature, which renders any frame classified sample by sample (pre-integration
+*          classifies differently rather than adding a feature, and is combined with it when asked for) */
+#define CUDA_VARIANT_GENERAL (CUDA_VARIANT_SHADED | CUDA_VARIANT_GRADIENT_OPACITY | CUDA_VARIANT_CLIPPED | CUDA_VARIANT_PERSPECTIVE)
+
+#endif
@@ -0,0 +1,30 @@
+/** @file CUDA_containerMacroCellGrid.h
+*
+*  @brief File for the structure holding the coarse min/max grid used to skip empty space during volume ray casting
+*
+*  @note This is primarily an internal file used by the volume mappers and transfer function handlers to agree on the macro cell layout
+*
+*/
+
+#ifndef __CUDA_containerMacroCellGrid_h
+#define __CUDA_containerMacroCellGrid_h
+
+// CUDA Volume Rendering includes
+#include "vector_types.h"
+
+/** @brief A structure located on the host holding the range of the voxels each macro cell of a volume can interpolate between
+*
+*  @note Macro cell (i,j,k) covers the sample positions [i,i+1)*CellSize along x (and likewise along y and z) in the
+*        unnormalized texture co-ordinates of the volume, so its range includes the voxels one beyond each face
+*
+*/
+typedef struct
+{
+  int3        GridSize;   /**< Number of macro cells in X, Y and Z */
+  int         CellSize;   /**< Size of a macro cell along each axis, in voxels */
+  float*      Minimum;    /**< Smallest value of each cell as read through the texture (ie: before the packing scale and shift), x fastest */
+  float*      Maximum;    /**< Largest value of each cell as read through the texture (ie: before the packing scale and shift), x fastest */
+
+} cudaMacroCellGrid;
+
+#endif
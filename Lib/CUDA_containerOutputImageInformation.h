@@ -22,14 +22,12 @@ typedef struct
 {
   uint2       resolution;        /**< The resolution of the texture/image that will be textured to the screen */
   uchar4*     deviceOutputImage; /**< The texture/image that will be textured to the screen on device memory */
+  uint2       blockSize;         /**< The shape of the thread blocks the rays are cast in (the grid covers the tile, hanging over its edges) */
+  uint2       tileOffset;        /**< The first pixel of the part of the image the rays are cast for, when the image is split among devices */
+  uint2       tileSize;          /**< The size of the part of the image the rays are cast for, the whole image unless it is split among devices */
 
-  float*      rayStartX;         /**< The ray starting location buffer (x component) */
-  float*      rayStartY;         /**< The ray starting location buffer (y component) */
-  float*      rayStartZ;         /**< The ray starting location buffer (z component) */
-  float*      rayIncX;           /**< The ray increment amount buffer (x component) */
-  float*      rayIncY;           /**< The ray increment amount buffer (y component) */
-  float*      rayIncZ;           /**< The ray increment amount buffer (z component) */
-  float*      numSteps;          /**< The number of sample points on the ray */
+  float4*     rayBuffer;         /**< The packed rays (start with the number of sample points in w, then increment) for modes which composite
+                                      the same rays more than once, or null to form each ray as it is composited */
 
 } cudaOutputImageInformation;
 
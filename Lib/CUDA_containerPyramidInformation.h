@@ -0,0 +1,41 @@
+/** @file CUDA_containerPyramidInformation.h
+*
+*  @brief File for the structure describing the mip pyramid of a volume, its levels halving the volume one after the other
+*
+*  @note This is primarily an internal file used by the vtkCUDAVolumeInformationHandler, the volume mappers and CUDA_renderAlgo
+*        to agree on where each level of the pyramid lies in the array holding them side by side on the device
+*
+*/
+
+#ifndef __CUDA_containerPyramidInformation_h
+#define __CUDA_containerPyramidInformation_h
+
+// CUDA Volume Rendering includes
+#include "vector_types.h"
+
+/** @brief Largest number of levels coarser than the volume in a pyramid */
+#define CUDA_MAX_PYRAMID_LEVELS 8
+
+/** @brief Each voxel of a level is the mean of the 8 voxels it covers in the finer level */
+#define CUDA_PYRAMID_MEAN 0
+/** @brief Each voxel of a level is the maximum of the voxels it covers, so bright structures never fade into the empty space around them */
+#define CUDA_PYRAMID_MAX 1
+/** @brief Each voxel of a level is the minimum of the voxels it covers, so dark structures never fade into the space around them */
+#define CUDA_PYRAMID_MIN 2
+
+/** @brief A stucture located on the CUDA hardware that holds the layout of the mip pyramid of the rendered volume
+*
+*  @note Level l (from 1) is the volume reduced 2^l times along each axis, sampled at the voxel co-ordinates of the volume
+*        times LevelScale[l-1]. The levels lie side by side along X in a single array, level 1 first.
+*/
+typedef struct __align__(16)
+{
+  int     NumberOfLevels;                           /**< Number of levels coarser than the volume, 0 when the volume has no pyramid */
+  int     Reduction;                                /**< How the voxels of a level are reduced, one of CUDA_PYRAMID_MEAN, MAX or MIN */
+  int3    LevelSize[CUDA_MAX_PYRAMID_LEVELS];       /**< Size of each level in X, Y and Z */
+  int     LevelOrigin[CUDA_MAX_PYRAMID_LEVELS];     /**< X co-ordinate of the first voxel of each level in the array */
+  float   LevelScale[CUDA_MAX_PYRAMID_LEVELS];      /**< Factor from the voxels of the volume to those of each level, 2^-l */
+
+} cudaPyramidInformation;
+
+#endif
@@ -0,0 +1,41 @@
+/** @file CUDA_containerRenderStatistics.h
+*
+*  @brief File for the per-frame statistics holding structure used to profile volume ray casting
+*
+*  @note This is primarily an internal file used by the vtkCUDAVolumeMapper and its renderAlgo functions to report where the time of a frame goes
+*
+*/
+
+#ifndef __CUDA_containerRenderStatistics_h
+#define __CUDA_containerRenderStatistics_h
+
+/** @brief A structure located on the host that holds the timings (in seconds) and work counts of the last frame rendered
+*
+*/
+typedef struct
+{
+  double      ZBufferTime;          /**< Time spent collecting the Z buffer from the render window and loading it */
+  double      ComputeMatricesTime;  /**< Time spent recomputing the view to voxels matrices */
+  double      RayFormationTime;     /**< Time spent forming and clipping the rays */
+  double      CompositingTime;      /**< Time spent sampling and compositing along the rays */
+  double      ReadbackTime;         /**< Time spent bringing the output image back to the host */
+  double      DisplayTime;          /**< Time spent texturing the output image to the render window */
+  double      SlabCompositingTime;  /**< Time spent compositing the images of the slabs of a volume rendered sort-last on the host */
+  double      FrameTime;            /**< Time spent in the whole of vtkCUDAVolumeMapper::Render */
+
+  double      NumberOfRays;         /**< Number of rays cast (the output image resolution) */
+  double      NumberOfSamples;      /**< Number of sample points along the clipped rays */
+  double      NumberOfSkippedSamples; /**< Number of those sample points leapt over inside empty macro cells */
+  double      RayBufferBytes;       /**< Number of bytes of packed rays written to and read from device memory (0 when formed as composited) */
+
+  double      InteropDisplay;       /**< 1 if the image was displayed from a CUDA-GL pixel buffer, 0 if it was copied through the host */
+  double      BytesReadBack;        /**< Number of bytes of output image copied from the device to the host */
+
+  double      ZBufferCollected;     /**< 1 if the depth buffer was read back from the render window, 0 if the previous one was reused */
+  double      ZBufferAllocations;   /**< Number of buffers allocated on the host or the device to hold the Z buffer */
+
+  double      ImageReused;          /**< 0 if the image was rendered, 1 if the image last rendered was displayed again, 2 if a cached image was */
+
+} cudaRenderStatistics;
+
+#endif
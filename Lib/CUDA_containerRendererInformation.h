@@ -13,8 +13,15 @@
 #define __CUDA_containerRendererInformation_h
 
 // CUDA Volume Rendering includes
+#include "CUDA_containerVolumeInformation.h"
+#include "texture_types.h"
 #include "vector_types.h"
 
+/** @brief Step by the smallest voxel spacing in world units, whatever the direction of the ray (the original sampling) */
+#define CUDA_SAMPLE_MINIMUM_SPACING 0
+/** @brief Step by the length of one voxel along the direction of the ray, so anisotropic volumes are not oversampled along their coarse axes */
+#define CUDA_SAMPLE_VOXEL_FOOTPRINT 1
+
 /** @brief A stucture located on the CUDA hardware that holds all the information required about the renderer.
 *
 */
@@ -23,6 +30,9 @@ typedef struct __align__(16)
   uint2 actualResolution;        /**< The resolution of the rendering screen */
 
   float ViewToVoxelsMatrix[16];  /**< 4x4 matrix mapping the view space (0 to 1 in each direction, with 0 and 1 in x and y being the borders of the screen, and 0 and 1 in z being the clipping planes) to the volume space */
+  float FusedViewToVoxelsMatrix[16*CUDA_MAX_FUSED_VOLUMES]; /**< The equivalent of ViewToVoxelsMatrix for each fused volume, 16 after 16 */
+  float4 VoxelFootprint;         /**< Plane giving the depth of a voxel co-ordinate, which the width of a pixel in voxels grows with (dot with (x, y, z, 1)) */
+  float2 VoxelFootprintScale;    /**< Width in voxels of the whole screen along X and Y at a depth of 1, so a pixel is this over the resolution times the depth */
 
   int NumberOfClippingPlanes;    /**< Number of additional user defined clipping planes to a maximum of 6 */
   float ClippingPlanes[24];      /**< Parameters defining each of the additional user defined clipping planes */
@@ -31,6 +41,15 @@ typedef struct __align__(16)
   float gradShadeScale;      /**< Multiplicative constant for flat-like shading of the volume */
   float gradShadeShift;      /**< Additive constant for the flat-like shading of the volume */
 
+  //Sampling constants
+  int SamplingMode;            /**< How the step between samples is chosen, one of CUDA_SAMPLE_MINIMUM_SPACING or CUDA_SAMPLE_VOXEL_FOOTPRINT */
+  float SampleDistanceFactor;  /**< Multiplier of the step chosen by the sampling mode (greater than 1.0f for coarser, faster sampling) */
+
+  //Depth of the opaque geometry, where the rays stop
+  cudaArray* ZBufferArray;             /**< Device copy of the Z buffer, kept between frames and reallocated when its size changes */
+  uint2 ZBufferSize;                   /**< The size of ZBufferArray */
+  cudaTextureObject_t ZBufferTexture;  /**< Texture object reading ZBufferArray in normalized co-ordinates */
+
 } cudaRendererInformation;
 
 #endif
@@ -15,6 +15,12 @@
 // CUDA Volume Rendering includes
 #include "vector_types.h"
 
+/** @brief Largest number of volumes that can be fused with the rendered volume, each being composited in the same ray pass */
+#define CUDA_MAX_FUSED_VOLUMES 3
+
+/** @brief Largest number of frames of a 4D sequence that can be held on the device at once, whatever the memory budget */
+#define CUDA_MAX_CACHED_FRAMES 64
+
 /** @brief A stucture located on the CUDA hardware that holds all the information required about the volume being renderered.
 *
 */
@@ -32,6 +38,13 @@ typedef struct __align__(16)
   float      Diffuse;
   float2     Specular;
 
+  // The volumes composited in the same ray pass, each in its own voxel space (see cudaRendererInformation::FusedViewToVoxelsMatrix)
+  int        NumberOfFusedVolumes;                          /**< Number of volumes fused with this one, up to CUDA_MAX_FUSED_VOLUMES */
+  int3       FusedVolumeSize[CUDA_MAX_FUSED_VOLUMES];       /**< Size of each fused volume in X, Y and Z */
+  float      FusedBounds[6*CUDA_MAX_FUSED_VOLUMES];         /**< The bounds of each fused volume in its voxels, 6 after 6 */
+  float3     FusedSpacing[CUDA_MAX_FUSED_VOLUMES];          /**< The spacing between pixels of each fused volume */
+  float      FusedMinSpacing[CUDA_MAX_FUSED_VOLUMES];       /**< The smallest spacing of each fused volume */
+
 } cudaVolumeInformation;
 
 #endif
@@ -0,0 +1,33 @@
+/** @file CUDA_containerVolumePackingInformation.h
+*
+*  @brief File for the structure describing how the voxels of a volume are stored for volume ray casting
+*
+*  @note This is primarily an internal file used by the volume mappers, the image packing functions and CUDA_renderAlgo to agree on a voxel format
+*
+*/
+
+#ifndef __CUDA_containerVolumePackingInformation_h
+#define __CUDA_containerVolumePackingInformation_h
+
+/** @brief The formats a volume can be stored in, 8 and 16-bit formats being read back as normalized floats
+*
+*/
+enum cudaVolumePackingFormat
+{
+  CUDA_PACKED_UNSIGNED_CHAR = 0,   /**< 8-bit voxels, read as value / 255 */
+  CUDA_PACKED_UNSIGNED_SHORT = 1,  /**< 16-bit voxels, read as value / 65535 */
+  CUDA_PACKED_FLOAT = 2            /**< 32-bit floating point voxels, read as is */
+};
+
+/** @brief A structure located on the host that describes the stored voxels, such that intensity = Scale * read value + Shift
+*
+*/
+typedef struct
+{
+  int         Format;   /**< How the voxels are stored, one of the cudaVolumePackingFormat values */
+  float       Scale;    /**< Factor from the value read through the texture to the original intensity */
+  float       Shift;    /**< Offset added after scaling to recover the original intensity */
+
+} cudaVolumePackingInformation;
+
+#endif
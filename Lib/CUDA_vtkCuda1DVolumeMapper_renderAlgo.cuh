@@ -10,25 +10,154 @@
 #include "CUDA_vtkCUDA1DVolumeMapper_renderAlgo.h"
 #include "CUDA_vtkCUDAVolumeMapper_renderAlgo.h"
 #include <cuda.h>
+#include <math_constants.h>
+#include <cstring>
 
-//execution parameters and general information
-__constant__ cuda1DTransferFunctionInformation  CUDA_vtkCUDA1DVolumeMapper_trfInfo;
+//sample the volume, or the pool of its bricks, through its texture object, which reads 8 and 16-bit packings as normalized floats
+__device__ float CUDA_vtkCUDA1DVolumeMapper_sampleVolume(const CUDA_vtkCUDAVolumeMapper_renderParameters& params,
+                                                         float x, float y, float z){
+  return tex3D<float>(params.volumeTexture, x, y, z);
+}
+__device__ float CUDA_vtkCUDA1DVolumeMapper_sampleBrickPool(const CUDA_vtkCUDAVolumeMapper_renderParameters& params,
+                                                            float x, float y, float z){
+  return tex3D<float>(params.brickPoolTexture, x, y, z);
+}
+
+//sample the rendered volume at a voxel co-ordinate, through the page table when it is bricked, asking for the brick
+//sampled and reading the low resolution volume where that brick is missing
+template< bool Bricked >
+__device__ float CUDA_vtkCUDA1DVolumeMapper_sample(const CUDA_vtkCUDAVolumeMapper_renderParameters& params,
+                                                   float x, float y, float z){
+  if(!Bricked) return CUDA_vtkCUDA1DVolumeMapper_sampleVolume(params, x, y, z);
+
+  const int3 gridSize = params.brickInfo.GridSize;
+  const float brickSize = (float) params.brickInfo.BrickSize;
+  int3 brick;
+  brick.x = min(max(__float2int_rd(x / brickSize), 0), gridSize.x - 1);
+  brick.y = min(max(__float2int_rd(y / brickSize), 0), gridSize.y - 1);
+  brick.z = min(max(__float2int_rd(z / brickSize), 0), gridSize.z - 1);
+  const int index = brick.x + gridSize.x * (brick.y + gridSize.y * brick.z);
+  params.brickInfo.Requests[index] = 1;
+
+  const int4 entry = params.brickInfo.PageTable[index];
+  if(!entry.w){
+    const float coarseScale = params.brickInfo.CoarseScale;
+    return CUDA_vtkCUDA1DVolumeMapper_sampleVolume(params, x * coarseScale, y * coarseScale, z * coarseScale);
+  }
+
+  //stay within the apron of the slot outside the volume, where the texture would have clamped to the edge voxels
+  const float apron = (float) CUDA_BRICK_APRON;
+  const float3 local = make_float3(fminf(fmaxf(x - brick.x * brickSize, 0.5f - apron), brickSize + apron - 0.5f),
+                                   fminf(fmaxf(y - brick.y * brickSize, 0.5f - apron), brickSize + apron - 0.5f),
+                                   fminf(fmaxf(z - brick.z * brickSize, 0.5f - apron), brickSize + apron - 0.5f));
+  return CUDA_vtkCUDA1DVolumeMapper_sampleBrickPool(params, entry.x + apron + local.x, entry.y + apron + local.y,
+                                                    entry.z + apron + local.z);
+}
+
+//sample a level of the mip pyramid through its texture object, clamping to the edges of the level so its neighbours in the
+//array never bleed into it
+__device__ float CUDA_vtkCUDA1DVolumeMapper_samplePyramid(const CUDA_vtkCUDAVolumeMapper_renderParameters& params,
+                                                          int level, float x, float y, float z){
+  const float scale = params.pyramidInfo.LevelScale[level-1];
+  const int3 size = params.pyramidInfo.LevelSize[level-1];
+  x = fminf(fmaxf(x * scale, 0.5f), (float) size.x - 0.5f) + (float) params.pyramidInfo.LevelOrigin[level-1];
+  y = fminf(fmaxf(y * scale, 0.5f), (float) size.y - 0.5f);
+  z = fminf(fmaxf(z * scale, 0.5f), (float) size.z - 0.5f);
+  return tex3D<float>(params.pyramidTexture, x, y, z);
+}
+
+//sample the rendered volume at a level of detail, 0 being the volume itself
+template< bool Bricked >
+__device__ float CUDA_vtkCUDA1DVolumeMapper_sampleLevel(const CUDA_vtkCUDAVolumeMapper_renderParameters& params,
+                                                        int level, float x, float y, float z){
+  return level ? CUDA_vtkCUDA1DVolumeMapper_samplePyramid(params, level, x, y, z) :
+                 CUDA_vtkCUDA1DVolumeMapper_sample<Bricked>(params, x, y, z);
+}
+
+//pick the level of the mip pyramid whose voxels are as wide as the pixel (or the step) at a sample, in voxels of the volume
+__device__ int CUDA_vtkCUDA1DVolumeMapper_pickLevel(const CUDA_vtkCUDAVolumeMapper_renderParameters& params,
+                                                    const float3& sample, float pixelScale, float stepLength){
+  const int numLevels = params.pyramidInfo.NumberOfLevels;
+  if(!numLevels) return 0;
+  const float4 plane = params.renInfo.VoxelFootprint;
+  const float footprint = fmaxf(stepLength, pixelScale * fabsf(plane.x*sample.x + plane.y*sample.y + plane.z*sample.z + plane.w));
+  return min(max(__float2int_rd(__log2f(footprint)), 0), numLevels);
+}
+
+//sample one of the volumes composited together, 0 being the rendered volume and the others the fused ones
+template< bool Bricked >
+__device__ float CUDA_vtkCUDA1DVolumeMapper_sampleFused(const CUDA_vtkCUDAVolumeMapper_renderParameters& params,
+                                                        int volume, float x, float y, float z){
+  switch(volume){
+  case 0: return CUDA_vtkCUDA1DVolumeMapper_sample<Bricked>(params, x, y, z);
+  default: return tex3D<float>(params.fusedTexture[volume-1], x, y, z);
+  }
+}
 
-//transfer function as read-only textures
-texture<float, 1, cudaReadModeElementType> alpha_texture_1D;
-texture<float, 1, cudaReadModeElementType> galpha_texture_1D;
-texture<float, 1, cudaReadModeElementType> colorR_texture_1D;
-texture<float, 1, cudaReadModeElementType> colorG_texture_1D;
-texture<float, 1, cudaReadModeElementType> colorB_texture_1D;
+//walk the macro cells along the ray with a 3D DDA, returning how many whole steps stay within cells the transfer function leaves empty
+__device__ int CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_LeapEmptySpace(const CUDA_vtkCUDAVolumeMapper_renderParameters& params,
+                                                                   const float3& rayStart, const float3& rayInc, int maxSteps){
 
-//3D input data (read-only texture with corresponding opague device memory back)
-texture<float, 3, cudaReadModeElementType> CUDA_vtkCUDA1DVolumeMapper_input_texture;
-cudaArray* CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[1];
+  const int cellSize = params.trfInfo.macroCellSize;
+  const int3 gridSize = params.trfInfo.macroCellGridSize;
+  const unsigned char* occupancy = params.trfInfo.macroCellOccupancy;
 
-__device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(float3& rayStart,
+  //find the cell holding the sample, treating anything outside the grid as occupied
+  int3 cell;
+  cell.x = __float2int_rd(rayStart.x / (float) cellSize);
+  cell.y = __float2int_rd(rayStart.y / (float) cellSize);
+  cell.z = __float2int_rd(rayStart.z / (float) cellSize);
+  if(cell.x < 0 || cell.y < 0 || cell.z < 0 || cell.x >= gridSize.x || cell.y >= gridSize.y || cell.z >= gridSize.z ||
+     occupancy[cell.x + gridSize.x * (cell.y + gridSize.y * cell.z)]) return 0;
+
+  //distance (in steps) to the next cell boundary along each axis, and between boundaries
+  float3 tMax, tDelta;
+  int3 cellStep;
+  cellStep.x = (rayInc.x > 0.0f) ? 1 : ((rayInc.x < 0.0f) ? -1 : 0);
+  cellStep.y = (rayInc.y > 0.0f) ? 1 : ((rayInc.y < 0.0f) ? -1 : 0);
+  cellStep.z = (rayInc.z > 0.0f) ? 1 : ((rayInc.z < 0.0f) ? -1 : 0);
+  tMax.x = cellStep.x ? ((float) ((cell.x + (cellStep.x > 0)) * cellSize) - rayStart.x) / rayInc.x : CUDART_INF_F;
+  tMax.y = cellStep.y ? ((float) ((cell.y + (cellStep.y > 0)) * cellSize) - rayStart.y) / rayInc.y : CUDART_INF_F;
+  tMax.z = cellStep.z ? ((float) ((cell.z + (cellStep.z > 0)) * cellSize) - rayStart.z) / rayInc.z : CUDART_INF_F;
+  tDelta.x = cellStep.x ? (float) cellSize / fabsf(rayInc.x) : CUDART_INF_F;
+  tDelta.y = cellStep.y ? (float) cellSize / fabsf(rayInc.y) : CUDART_INF_F;
+  tDelta.z = cellStep.z ? (float) cellSize / fabsf(rayInc.z) : CUDART_INF_F;
+
+  //leave empty cells until reaching an occupied one, the edge of the grid or the end of the ray
+  float t = 0.0f;
+  while(t < (float) maxSteps){
+    if(tMax.x <= tMax.y && tMax.x <= tMax.z){
+      t = tMax.x;
+      cell.x += cellStep.x;
+      tMax.x += tDelta.x;
+    }else if(tMax.y <= tMax.z){
+      t = tMax.y;
+      cell.y += cellStep.y;
+      tMax.y += tDelta.y;
+    }else{
+      t = tMax.z;
+      cell.z += cellStep.z;
+      tMax.z += tDelta.z;
+    }
+    if(cell.x < 0 || cell.y < 0 || cell.z < 0 || cell.x >= gridSize.x || cell.y >= gridSize.y || cell.z >= gridSize.z ||
+       occupancy[cell.x + gridSize.x * (cell.y + gridSize.y * cell.z)]) break;
+  }
+
+  //only the samples strictly before the boundary are known to be empty
+  float steps = ceilf(t);
+  return (steps < (float) maxSteps) ? (int) steps : maxSteps;
+}
+
+//composite along a ray, specialized for whether the volume is bricked, whether the samples are shaded (Shaded) and whether
+//their opacity is scaled by the gradient opacity (GradientOpacity), the gradient only being sampled when either needs it;
+//only the general variant (General) checks the gradient range is finite, the others only being picked when it is
+template< bool Bricked, bool Shaded, bool GradientOpacity, bool General >
+__device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(const CUDA_vtkCUDAVolumeMapper_renderParameters& params,
+                  float3& rayStart,
                   const float& numSteps,
                   const float3& rayInc,
-                  float4& outputVal) {
+                  float4& outputVal,
+                  int& skippedSteps) {
 
   //set the default values for the output (note A is currently the remaining opacity, not the output opacity)
   outputVal.x = 0.0f; //R
@@ -37,21 +166,22 @@ __device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(float3& rayStar
   outputVal.w = 1.0f; //A
     
   //fetch the required information about the size and range of the transfer function from memory to registers
-  __syncthreads();
-  const float functRangeLow = CUDA_vtkCUDA1DVolumeMapper_trfInfo.intensityLow;
-  const float functRangeMulti = CUDA_vtkCUDA1DVolumeMapper_trfInfo.intensityMultiplier;
-  const float gradRangeLow = CUDA_vtkCUDA1DVolumeMapper_trfInfo.gradientLow;
-  const float gradRangeMulti = CUDA_vtkCUDA1DVolumeMapper_trfInfo.gradientMultiplier;
-  const float3 space = volInfo.SpacingReciprocal;
-  const float3 incSpace = volInfo.Spacing;
-  const float ambient = volInfo.Ambient;
-  const float diffuse = volInfo.Diffuse;
-  const float2 spec = volInfo.Specular;
-  __syncthreads();
-
-  //apply a randomized offset to the ray
-  float retDepth = dRandomRayOffsets[threadIdx.x + BLOCK_DIM2D * threadIdx.y];
-  __syncthreads();
+  const float functRangeLow = params.trfInfo.intensityLow;
+  const float functRangeMulti = params.trfInfo.intensityMultiplier;
+  const float gradRangeLow = params.trfInfo.gradientLow;
+  const float gradRangeMulti = params.trfInfo.gradientMultiplier;
+  const float3 space = params.volInfo.SpacingReciprocal;
+  const float3 incSpace = params.volInfo.Spacing;
+  const float ambient = params.volInfo.Ambient;
+  const float diffuse = params.volInfo.Diffuse;
+  const float2 spec = params.volInfo.Specular;
+  const bool skipEmptySpace = (params.trfInfo.macroCellSize > 0);
+  skippedSteps = 0;
+
+  //apply a randomized offset to the ray, tiled over the image whatever the shape of the blocks
+  const int pixelX = blockDim.x * blockIdx.x + threadIdx.x + params.outInfo.tileOffset.x;
+  const int pixelY = blockDim.y * blockIdx.y + threadIdx.y + params.outInfo.tileOffset.y;
+  float retDepth = params.rayOffsets[(pixelX % BLOCK_DIM2D) + BLOCK_DIM2D * (pixelY % BLOCK_DIM2D)];
   int maxSteps = __float2int_rd(numSteps - retDepth) ;
   rayStart.x += retDepth*rayInc.x;
   rayStart.y += retDepth*rayInc.y;
@@ -59,6 +189,15 @@ __device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(float3& rayStar
   float rayLength = sqrtf(rayInc.x*rayInc.x*incSpace.x*incSpace.x +
               rayInc.y*rayInc.y*incSpace.y*incSpace.y +
               rayInc.z*rayInc.z*incSpace.z*incSpace.z);
+
+  //the opacities are defined for steps of the smallest spacing, so other step lengths correct them by 1-(1-a)^(step/spacing)
+  const float opacityExponent = rayLength / params.volInfo.MinSpacing;
+  const bool correctOpacity = fabsf(opacityExponent - 1.0f) > 0.0009765625f;
+
+  //the width of a pixel in voxels per unit of depth, and the length of a step in voxels, which pick the level of detail
+  const float pixelScale = fmaxf(params.renInfo.VoxelFootprintScale.x / (float) params.outInfo.resolution.x,
+                                 params.renInfo.VoxelFootprintScale.y / (float) params.outInfo.resolution.y);
+  const float stepLength = sqrtf(dot(rayInc, rayInc));
   //allocate flags
   char2 step;
   step.x = 0;
@@ -67,12 +206,13 @@ __device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(float3& rayStar
   //loop as long as we are still *roughly* in the range of the clipped and cropped volume
   while( maxSteps > 0 ){
 
-    // fetching the intensity index into the transfer function
-    const float tempIndex = functRangeMulti * (tex3D(CUDA_vtkCUDA1DVolumeMapper_input_texture, rayStart.x, rayStart.y, rayStart.z) - functRangeLow);
+    // fetching the intensity index into the transfer function, from the level of detail matching the footprint of the pixel
+    const int level = CUDA_vtkCUDA1DVolumeMapper_pickLevel(params, rayStart, pixelScale, stepLength);
+    const float tempIndex = functRangeMulti * (CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x, rayStart.y, rayStart.z) - functRangeLow);
   
     //fetching the opacity value of the sampling point (apply transfer function in stages to minimize work)
     // as well as the colour multiplier (with photorealistic shading)
-    float alpha = tex1D(alpha_texture_1D, tempIndex);
+    float alpha = tex1D<float>(params.trfInfo.alphaTexture1D, tempIndex);
 
     //filter out objects with too low opacity (deemed unimportant, and this saves time and reduces cloudiness)
     if(alpha > 0.0f){
@@ -90,28 +230,39 @@ __device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(float3& rayStar
       if(!step.x){
 
         float3 gradient;
-        gradient.x = ( tex3D(CUDA_vtkCUDA1DVolumeMapper_input_texture, rayStart.x+0.5f, rayStart.y, rayStart.z)
-               - tex3D(CUDA_vtkCUDA1DVolumeMapper_input_texture, rayStart.x-0.5f, rayStart.y, rayStart.z) ) * space.x;
-        gradient.y = ( tex3D(CUDA_vtkCUDA1DVolumeMapper_input_texture, rayStart.x, rayStart.y+0.5f, rayStart.z)
-               - tex3D(CUDA_vtkCUDA1DVolumeMapper_input_texture, rayStart.x, rayStart.y-0.5f, rayStart.z) ) * space.y;
-        gradient.z = ( tex3D(CUDA_vtkCUDA1DVolumeMapper_input_texture, rayStart.x, rayStart.y, rayStart.z+0.5f)
-               - tex3D(CUDA_vtkCUDA1DVolumeMapper_input_texture, rayStart.x, rayStart.y, rayStart.z-0.5f) ) * space.z;
-        float gradMag = sqrtf(dot(gradient, gradient));
-        alpha *= isfinite(gradRangeMulti) ? tex1D(galpha_texture_1D, gradRangeMulti*(gradMag-gradRangeLow)) : 1.0f;
-        float phongLambert = saturate( abs ( gradient.x*rayInc.x*incSpace.x + 
-                           gradient.y*rayInc.y*incSpace.y +
-                           gradient.z*rayInc.z*incSpace.z   ) / (gradMag * rayLength) );
-        float shadeD = ambient + diffuse * phongLambert;
-        float shadeS = spec.x * pow(phongLambert, spec.y);
+        float gradMag = 0.0f;
+        if(Shaded || GradientOpacity){
+          gradient.x = ( CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x+0.5f, rayStart.y, rayStart.z)
+                 - CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x-0.5f, rayStart.y, rayStart.z) ) * space.x;
+          gradient.y = ( CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x, rayStart.y+0.5f, rayStart.z)
+                 - CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x, rayStart.y-0.5f, rayStart.z) ) * space.y;
+          gradient.z = ( CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x, rayStart.y, rayStart.z+0.5f)
+                 - CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x, rayStart.y, rayStart.z-0.5f) ) * space.z;
+          gradMag = sqrtf(dot(gradient, gradient));
+        }
+        if(GradientOpacity)
+          alpha *= (!General || isfinite(gradRangeMulti)) ? tex1D<float>(params.trfInfo.galphaTexture1D, gradRangeMulti*(gradMag-gradRangeLow)) : 1.0f;
+        alpha = correctOpacity ? 1.0f - __powf(1.0f - alpha, opacityExponent) : alpha;
+
+        //without shading the colour is the one looked up, as the neutral constants (1, 0, 0) of an unshaded volume give
+        float shadeD = 1.0f;
+        float shadeS = 0.0f;
+        if(Shaded){
+          float phongLambert = saturate( abs ( gradient.x*rayInc.x*incSpace.x + 
+                             gradient.y*rayInc.y*incSpace.y +
+                             gradient.z*rayInc.z*incSpace.z   ) / (gradMag * rayLength) );
+          shadeD = ambient + diffuse * phongLambert;
+          shadeS = spec.x * pow(phongLambert, spec.y);
+        }
 
         //accumulate the opacity for this sample point
         float multiplier = outputVal.w * alpha;
         outputVal.w *= (1.0f - alpha);
 
         //accumulate the colour information from this sample point
-        outputVal.x += multiplier * saturate(shadeD * tex1D(colorR_texture_1D, tempIndex) + shadeS);
-        outputVal.y += multiplier * saturate(shadeD * tex1D(colorG_texture_1D, tempIndex) + shadeS);
-        outputVal.z += multiplier * saturate(shadeD * tex1D(colorB_texture_1D, tempIndex) + shadeS);
+        outputVal.x += multiplier * saturate(shadeD * tex1D<float>(params.trfInfo.colorRTexture1D, tempIndex) + shadeS);
+        outputVal.y += multiplier * saturate(shadeD * tex1D<float>(params.trfInfo.colorGTexture1D, tempIndex) + shadeS);
+        outputVal.z += multiplier * saturate(shadeD * tex1D<float>(params.trfInfo.colorBTexture1D, tempIndex) + shadeS);
       }
       
       //determine whether or not we've hit an opacity where further sampling becomes neglible
@@ -122,6 +273,19 @@ __device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(float3& rayStar
 
     }else{
 
+      //leap over the macro cells where no sample can be visible, none of which needs revisiting
+      int leap = skipEmptySpace ? CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_LeapEmptySpace(params, rayStart, rayInc, maxSteps) : 0;
+      if(leap > 0){
+        rayStart.x += leap * rayInc.x;
+        rayStart.y += leap * rayInc.y;
+        rayStart.z += leap * rayInc.z;
+        maxSteps -= leap;
+        skippedSteps += leap;
+        step.x = 0;
+        step.y = 0;
+        continue;
+      }
+
       //if we aren't backstepping, we can skip a sample
       if(!step.x){
         rayStart.x += rayInc.x;
@@ -150,40 +314,191 @@ __device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(float3& rayStar
 
 }
 
-__global__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_Composite( ) {
-  
-  //index in the output image (2D)
+//composite along a ray segment by segment, classifying the segment between each two samples through the pre-integrated
+//lookup table of the intensities at its ends, so features thinner than a step still show, specialized as CastRays1D
+template< bool Bricked, bool Shaded, bool GradientOpacity, bool General >
+__device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastSegments1D(const CUDA_vtkCUDAVolumeMapper_renderParameters& params,
+                  float3& rayStart,
+                  const float& numSteps,
+                  const float3& rayInc,
+                  float4& outputVal,
+                  int& skippedSteps) {
+
+  //set the default values for the output (note A is currently the remaining opacity, not the output opacity)
+  outputVal.x = 0.0f; //R
+  outputVal.y = 0.0f; //G
+  outputVal.z = 0.0f; //B
+  outputVal.w = 1.0f; //A
+
+  //fetch the required information about the size and range of the transfer function from memory to registers
+  const float functRangeLow = params.trfInfo.intensityLow;
+  const float functRangeMulti = params.trfInfo.intensityMultiplier;
+  const float gradRangeLow = params.trfInfo.gradientLow;
+  const float gradRangeMulti = params.trfInfo.gradientMultiplier;
+  const float3 space = params.volInfo.SpacingReciprocal;
+  const float3 incSpace = params.volInfo.Spacing;
+  const float ambient = params.volInfo.Ambient;
+  const float diffuse = params.volInfo.Diffuse;
+  const float2 spec = params.volInfo.Specular;
+  const bool skipEmptySpace = (params.trfInfo.macroCellSize > 0);
+  skippedSteps = 0;
+
+  //apply a randomized offset to the ray, tiled over the image whatever the shape of the blocks
+  const int pixelX = blockDim.x * blockIdx.x + threadIdx.x + params.outInfo.tileOffset.x;
+  const int pixelY = blockDim.y * blockIdx.y + threadIdx.y + params.outInfo.tileOffset.y;
+  float retDepth = params.rayOffsets[(pixelX % BLOCK_DIM2D) + BLOCK_DIM2D * (pixelY % BLOCK_DIM2D)];
+  int maxSteps = __float2int_rd(numSteps - retDepth) ;
+  rayStart.x += retDepth*rayInc.x;
+  rayStart.y += retDepth*rayInc.y;
+  rayStart.z += retDepth*rayInc.z;
+  float rayLength = sqrtf(rayInc.x*rayInc.x*incSpace.x*incSpace.x +
+              rayInc.y*rayInc.y*incSpace.y*incSpace.y +
+              rayInc.z*rayInc.z*incSpace.z*incSpace.z);
+
+  //the table holds segments of the smallest spacing, so other step lengths correct them by 1-(1-a)^(step/spacing), which
+  //is exact for the opacity of a segment as its extinction grows with its length
+  const float opacityExponent = rayLength / params.volInfo.MinSpacing;
+  const bool correctOpacity = fabsf(opacityExponent - 1.0f) > 0.0009765625f;
+
+  //the width of a pixel in voxels per unit of depth, and the length of a step in voxels, which pick the level of detail
+  const float pixelScale = fmaxf(params.renInfo.VoxelFootprintScale.x / (float) params.outInfo.resolution.x,
+                                 params.renInfo.VoxelFootprintScale.y / (float) params.outInfo.resolution.y);
+  const float stepLength = sqrtf(dot(rayInc, rayInc));
+
+  //the intensity at the front of the first segment
+  int level = CUDA_vtkCUDA1DVolumeMapper_pickLevel(params, rayStart, pixelScale, stepLength);
+  float frontIndex = functRangeMulti * (CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x, rayStart.y, rayStart.z) - functRangeLow);
+  maxSteps--;
+
+  //loop as long as we are still *roughly* in the range of the clipped and cropped volume
+  while( maxSteps > 0 ){
+
+    //move to the back of the segment and fetch its intensity index into the transfer function
+    rayStart.x += rayInc.x;
+    rayStart.y += rayInc.y;
+    rayStart.z += rayInc.z;
+    maxSteps--;
+    level = CUDA_vtkCUDA1DVolumeMapper_pickLevel(params, rayStart, pixelScale, stepLength);
+    float backIndex = functRangeMulti * (CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x, rayStart.y, rayStart.z) - functRangeLow);
+
+    //fetching the opacity and mean colour of the segment
+    const float4 segment = tex2D<float4>(params.trfInfo.preIntegratedTexture2D, frontIndex, backIndex);
+    float alpha = segment.w;
+
+    if(alpha > 0.0f){
+
+      //shade the segment as its back sample
+      float3 gradient;
+      float gradMag = 0.0f;
+      if(Shaded || GradientOpacity){
+        gradient.x = ( CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x+0.5f, rayStart.y, rayStart.z)
+               - CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x-0.5f, rayStart.y, rayStart.z) ) * space.x;
+        gradient.y = ( CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x, rayStart.y+0.5f, rayStart.z)
+               - CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x, rayStart.y-0.5f, rayStart.z) ) * space.y;
+        gradient.z = ( CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x, rayStart.y, rayStart.z+0.5f)
+               - CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x, rayStart.y, rayStart.z-0.5f) ) * space.z;
+        gradMag = sqrtf(dot(gradient, gradient));
+      }
+      if(GradientOpacity)
+        alpha *= (!General || isfinite(gradRangeMulti)) ? tex1D<float>(params.trfInfo.galphaTexture1D, gradRangeMulti*(gradMag-gradRangeLow)) : 1.0f;
+      alpha = correctOpacity ? 1.0f - __powf(1.0f - alpha, opacityExponent) : alpha;
+
+      float shadeD = 1.0f;
+      float shadeS = 0.0f;
+      if(Shaded){
+        float phongLambert = saturate( abs ( gradient.x*rayInc.x*incSpace.x +
+                           gradient.y*rayInc.y*incSpace.y +
+                           gradient.z*rayInc.z*incSpace.z   ) / (gradMag * rayLength) );
+        shadeD = ambient + diffuse * phongLambert;
+        shadeS = spec.x * pow(phongLambert, spec.y);
+      }
+
+      //accumulate the opacity and colour of this segment
+      float multiplier = outputVal.w * alpha;
+      outputVal.w *= (1.0f - alpha);
+      outputVal.x += multiplier * saturate(shadeD * segment.x + shadeS);
+      outputVal.y += multiplier * saturate(shadeD * segment.y + shadeS);
+      outputVal.z += multiplier * saturate(shadeD * segment.z + shadeS);
+
+      //determine whether or not we've hit an opacity where further sampling becomes neglible
+      if(outputVal.w < 0.015625f){
+        outputVal.w = 0.0f;
+        break;
+      }
+
+    }else if(skipEmptySpace){
+
+      //leap over the macro cells where no segment can be visible, landing on their last sample so the segment leaving
+      //them is still integrated
+      int leap = CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_LeapEmptySpace(params, rayStart, rayInc, maxSteps) - 1;
+      if(leap > 0){
+        rayStart.x += leap * rayInc.x;
+        rayStart.y += leap * rayInc.y;
+        rayStart.z += leap * rayInc.z;
+        maxSteps -= leap;
+        skippedSteps += leap;
+        level = CUDA_vtkCUDA1DVolumeMapper_pickLevel(params, rayStart, pixelScale, stepLength);
+        backIndex = functRangeMulti * (CUDA_vtkCUDA1DVolumeMapper_sampleLevel<Bricked>(params, level, rayStart.x, rayStart.y, rayStart.z) - functRangeLow);
+      }
+
+    }
+
+    //the back of this segment is the front of the next
+    frontIndex = backIndex;
+
+  }//while
+
+  //adjust the opacity output to reflect the collected opacity, and not the remaining opacity
+  outputVal.w = 1.0f - outputVal.w;
+  outputVal.x = saturate( outputVal.x );
+  outputVal.y = saturate( outputVal.y );
+  outputVal.z = saturate( outputVal.z );
+
+}
+
+//composite the rays, either forming each one in registers (FormRays) or reading those packed in the ray buffer, specialized
+//as CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D (or CastSegments1D when PreIntegrated) and CUDAkernel_SetRayEnds
+template< bool FormRays, bool Bricked, bool Shaded, bool GradientOpacity, bool Clipped, bool Perspective, bool PreIntegrated, bool General >
+__global__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_Composite(const CUDA_vtkCUDAVolumeMapper_renderParameters* __restrict__ parameters) {
+  const CUDA_vtkCUDAVolumeMapper_renderParameters& params = *parameters;
+
+  //index in the output image (2D), the grid covering the tile
   int2 index;
   index.x = blockDim.x * blockIdx.x + threadIdx.x;
   index.y = blockDim.y * blockIdx.y + threadIdx.y;
+  if(index.x >= params.outInfo.tileSize.x || index.y >= params.outInfo.tileSize.y) return;
+  index.x += params.outInfo.tileOffset.x;
+  index.y += params.outInfo.tileOffset.y;
+  if(index.x >= params.outInfo.resolution.x || index.y >= params.outInfo.resolution.y) return;
 
   //index in the output image (1D)
-  int outindex = index.x + index.y * outInfo.resolution.x;
+  int outindex = index.x + index.y * params.outInfo.resolution.x;
   
   float3 rayStart; //ray starting point
   float3 rayInc; // ray sample increment
   float numSteps; //maximum number of samples along this ray
   float4 outputVal; //rgba value of this ray (calculated in castRays, used in WriteData)
 
-  //load in the rays
-  __syncthreads();
-  rayStart.x = outInfo.rayStartX[outindex];
-  __syncthreads();
-  rayStart.y = outInfo.rayStartY[outindex];
-  __syncthreads();
-  rayStart.z = outInfo.rayStartZ[outindex];
-  __syncthreads();
-  rayInc.x = outInfo.rayIncX[outindex];
-  __syncthreads();
-  rayInc.y = outInfo.rayIncY[outindex];
-  __syncthreads();
-  rayInc.z = outInfo.rayIncZ[outindex];
-  __syncthreads();
-  numSteps = outInfo.numSteps[outindex];
-  __syncthreads();
+  //form the ray, or load it in
+  if(FormRays){
+    CUDAkernel_FormRay<Clipped, Perspective>(params, index, rayStart, rayInc, numSteps);
+  }else{
+    float4 start = params.outInfo.rayBuffer[2*outindex];
+    float4 inc = params.outInfo.rayBuffer[2*outindex+1];
+    rayStart = make_float3(start.x, start.y, start.z);
+    rayInc = make_float3(inc.x, inc.y, inc.z);
+    numSteps = start.w;
+  }
 
   // trace along the ray (composite)
-  CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(rayStart, numSteps, rayInc, outputVal);
+  int skippedSteps;
+  float clippedSteps = numSteps > 0.0f ? numSteps : 0.0f;
+  if(PreIntegrated)
+    CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastSegments1D<Bricked, Shaded, GradientOpacity, General>(params, rayStart, numSteps, rayInc, outputVal, skippedSteps);
+  else
+    CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D<Bricked, Shaded, GradientOpacity, General>(params, rayStart, numSteps, rayInc, outputVal, skippedSteps);
+  if(params.rayStatistics)
+    params.rayStatistics[outindex] = make_float2(clippedSteps, (float) skippedSteps);
 
   //convert output to uchar, adjusting it to be valued from [0,256) rather than [0,1]
   uchar4 temp;
@@ -193,179 +508,894 @@ __global__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_Composite( ) {
   temp.w = 255.0f * outputVal.w;
   
   //place output in the image buffer
-  __syncthreads();
-  outInfo.deviceOutputImage[outindex] = temp;
+  params.outInfo.deviceOutputImage[outindex] = temp;
+
+}
+
+//composite the rendered volume and the volumes fused with it in one march along the ray of the pixel
+template< bool Bricked >
+__global__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CompositeFused(const CUDA_vtkCUDAVolumeMapper_renderParameters* __restrict__ parameters) {
+  const CUDA_vtkCUDAVolumeMapper_renderParameters& params = *parameters;
+
+  //index in the output image (2D), the grid covering the tile
+  int2 index;
+  index.x = blockDim.x * blockIdx.x + threadIdx.x;
+  index.y = blockDim.y * blockIdx.y + threadIdx.y;
+  if(index.x >= params.outInfo.tileSize.x || index.y >= params.outInfo.tileSize.y) return;
+  index.x += params.outInfo.tileOffset.x;
+  index.y += params.outInfo.tileOffset.y;
+  if(index.x >= params.outInfo.resolution.x || index.y >= params.outInfo.resolution.y) return;
+
+  //index in the output image (1D)
+  int outindex = index.x + index.y * params.outInfo.resolution.x;
+
+  //project the segment of the pixel up to the opaque geometry into the voxels of each volume, every volume being an
+  //affine map of the world so that the fraction s along the segment is the same point in all of them
+  const float viewRayX = 1.0f - ( ((float) index.x) / (float) params.outInfo.resolution.x );
+  const float viewRayY = ( ((float) index.y) / (float) params.outInfo.resolution.y );
+  const float endDepth = tex2D<float>(params.renInfo.ZBufferTexture, 1.0f-viewRayX, viewRayY );
+  const int numVolumes = params.volInfo.NumberOfFusedVolumes + 1;
+  float3 rayStart[CUDA_MAX_FUSED_VOLUMES+1];
+  float3 rayDir[CUDA_MAX_FUSED_VOLUMES+1];
+  float2 range[CUDA_MAX_FUSED_VOLUMES+1];
+
+  //the clipping planes are given in the voxels of the rendered volume, and clip every volume alike
+  float2 clipped = make_float2(0.0f, 1.0f);
+  CUDAkernel_ProjectRay(viewRayX, viewRayY, endDepth, params.renInfo.ViewToVoxelsMatrix, rayStart[0], rayDir[0]);
+  CUDAkernel_ClipRangeAgainstClippingPlanes(params, rayStart[0], rayDir[0], clipped);
+
+  //march from the first volume entered to the last one left, as finely as the finest volume asks
+  float sBegin = 1.0f;
+  float sEnd = 0.0f;
+  float numSteps = 0.0f;
+  #pragma unroll
+  for(int v = 0; v <= CUDA_MAX_FUSED_VOLUMES; v++){
+    if(v < numVolumes){
+      if(v) CUDAkernel_ProjectRay(viewRayX, viewRayY, endDepth, params.renInfo.FusedViewToVoxelsMatrix + 16*(v-1), rayStart[v], rayDir[v]);
+      range[v] = clipped;
+      CUDAkernel_ClipRangeAgainstVolume(rayStart[v], rayDir[v], v ? params.volInfo.FusedBounds + 6*(v-1) : params.volInfo.Bounds, range[v]);
+      if(range[v].x < range[v].y){
+        const float3 spacing = v ? params.volInfo.FusedSpacing[v-1] : params.volInfo.Spacing;
+        const float minSpacing = v ? params.volInfo.FusedMinSpacing[v-1] : params.volInfo.MinSpacing;
+        float steps;
+        if( params.renInfo.SamplingMode == CUDA_SAMPLE_VOXEL_FOOTPRINT )
+          steps = __fsqrt_rz( rayDir[v].x*rayDir[v].x + rayDir[v].y*rayDir[v].y + rayDir[v].z*rayDir[v].z );
+        else
+          steps = __fsqrt_rz( rayDir[v].x*rayDir[v].x*spacing.x*spacing.x +
+                              rayDir[v].y*rayDir[v].y*spacing.y*spacing.y +
+                              rayDir[v].z*rayDir[v].z*spacing.z*spacing.z ) / minSpacing;
+        numSteps = fmaxf(numSteps, steps);
+        sBegin = fminf(sBegin, range[v].x);
+        sEnd = fmaxf(sEnd, range[v].y);
+      }
+    }
+  }
+  numSteps /= params.renInfo.SampleDistanceFactor;
+
+  //set the default values for the output (note A is currently the remaining opacity, not the output opacity)
+  float4 outputVal = make_float4(0.0f, 0.0f, 0.0f, 1.0f);
+  int samples = 0;
+  if(numSteps > 0.0f && sBegin < sEnd){
+    const float ds = 1.0f / numSteps;
+
+    //the length of a step in each volume, which corrects its opacities as in CastRays1D
+    float rayLength[CUDA_MAX_FUSED_VOLUMES+1];
+    #pragma unroll
+    for(int v = 0; v <= CUDA_MAX_FUSED_VOLUMES; v++){
+      rayLength[v] = 0.0f;
+      if(v >= numVolumes) continue;
+      const float3 spacing = v ? params.volInfo.FusedSpacing[v-1] : params.volInfo.Spacing;
+      rayLength[v] = ds * sqrtf(rayDir[v].x*rayDir[v].x*spacing.x*spacing.x +
+                                rayDir[v].y*rayDir[v].y*spacing.y*spacing.y +
+                                rayDir[v].z*rayDir[v].z*spacing.z*spacing.z);
+    }
+
+    //apply a randomized offset to the ray, tiled over the image whatever the shape of the blocks
+    float s = sBegin + ds * params.rayOffsets[(index.x % BLOCK_DIM2D) + BLOCK_DIM2D * (index.y % BLOCK_DIM2D)];
+    for( ; s < sEnd; s += ds){
+      samples++;
+
+      //classify and shade each volume covering the sample, merging them independently of their order
+      float remaining = 1.0f;
+      float weight = 0.0f;
+      float3 colour = make_float3(0.0f, 0.0f, 0.0f);
+      #pragma unroll
+      for(int v = 0; v <= CUDA_MAX_FUSED_VOLUMES; v++){
+        if(v >= numVolumes || s < range[v].x || s > range[v].y) continue;
+        const float x = rayStart[v].x + s*rayDir[v].x;
+        const float y = rayStart[v].y + s*rayDir[v].y;
+        const float z = rayStart[v].z + s*rayDir[v].z;
+        const float row = ((float) (v-1) + 0.5f) / (float) CUDA_MAX_FUSED_VOLUMES;
+
+        const float tempIndex = v ? params.trfInfo.fusedIntensityMultiplier[v-1] *
+                                    (CUDA_vtkCUDA1DVolumeMapper_sampleFused<Bricked>(params, v, x, y, z) - params.trfInfo.fusedIntensityLow[v-1]) :
+                                    params.trfInfo.intensityMultiplier *
+                                    (CUDA_vtkCUDA1DVolumeMapper_sampleFused<Bricked>(params, v, x, y, z) - params.trfInfo.intensityLow);
+        float4 classified;
+        if(v){
+          classified = tex2D<float4>(params.fusedColorTexture, tempIndex, row);
+        }else{
+          classified.w = tex1D<float>(params.trfInfo.alphaTexture1D, tempIndex);
+          classified.x = tex1D<float>(params.trfInfo.colorRTexture1D, tempIndex);
+          classified.y = tex1D<float>(params.trfInfo.colorGTexture1D, tempIndex);
+          classified.z = tex1D<float>(params.trfInfo.colorBTexture1D, tempIndex);
+        }
+        if(classified.w <= 0.0f) continue;
+
+        const float3 spacing = v ? params.volInfo.FusedSpacing[v-1] : params.volInfo.Spacing;
+        const float minSpacing = v ? params.volInfo.FusedMinSpacing[v-1] : params.volInfo.MinSpacing;
+        float3 gradient;
+        gradient.x = ( CUDA_vtkCUDA1DVolumeMapper_sampleFused<Bricked>(params, v, x+0.5f, y, z)
+               - CUDA_vtkCUDA1DVolumeMapper_sampleFused<Bricked>(params, v, x-0.5f, y, z) ) / spacing.x;
+        gradient.y = ( CUDA_vtkCUDA1DVolumeMapper_sampleFused<Bricked>(params, v, x, y+0.5f, z)
+               - CUDA_vtkCUDA1DVolumeMapper_sampleFused<Bricked>(params, v, x, y-0.5f, z) ) / spacing.y;
+        gradient.z = ( CUDA_vtkCUDA1DVolumeMapper_sampleFused<Bricked>(params, v, x, y, z+0.5f)
+               - CUDA_vtkCUDA1DVolumeMapper_sampleFused<Bricked>(params, v, x, y, z-0.5f) ) / spacing.z;
+        float gradMag = sqrtf(dot(gradient, gradient));
+        const float gradRangeLow = v ? params.trfInfo.fusedGradientLow[v-1] : params.trfInfo.gradientLow;
+        const float gradRangeMulti = v ? params.trfInfo.fusedGradientMultiplier[v-1] : params.trfInfo.gradientMultiplier;
+        float alpha = classified.w;
+        if(isfinite(gradRangeMulti))
+          alpha *= v ? tex2D<float>(params.fusedGAlphaTexture, gradRangeMulti*(gradMag-gradRangeLow), row) :
+                       tex1D<float>(params.trfInfo.galphaTexture1D, gradRangeMulti*(gradMag-gradRangeLow));
+        const float opacityExponent = rayLength[v] / minSpacing;
+        alpha = fabsf(opacityExponent - 1.0f) > 0.0009765625f ? 1.0f - __powf(1.0f - alpha, opacityExponent) : alpha;
+        float phongLambert = saturate( abs ( gradient.x*rayDir[v].x*ds*spacing.x +
+                           gradient.y*rayDir[v].y*ds*spacing.y +
+                           gradient.z*rayDir[v].z*ds*spacing.z   ) / (gradMag * rayLength[v]) );
+        float shadeD = params.volInfo.Ambient + params.volInfo.Diffuse * phongLambert;
+        float shadeS = params.volInfo.Specular.x * pow(phongLambert, params.volInfo.Specular.y);
+
+        colour.x += alpha * saturate(shadeD * classified.x + shadeS);
+        colour.y += alpha * saturate(shadeD * classified.y + shadeS);
+        colour.z += alpha * saturate(shadeD * classified.z + shadeS);
+        weight += alpha;
+        remaining *= (1.0f - alpha);
+      }
+      if(weight <= 0.0f) continue;
+
+      //composite the merged sample front to back, its colour being the mean of the volumes weighted by their opacities
+      float multiplier = outputVal.w * (1.0f - remaining) / weight;
+      outputVal.w *= remaining;
+      outputVal.x += multiplier * colour.x;
+      outputVal.y += multiplier * colour.y;
+      outputVal.z += multiplier * colour.z;
+
+      //determine whether or not we've hit an opacity where further sampling becomes neglible
+      if(outputVal.w < 0.015625f){
+        outputVal.w = 0.0f;
+        break;
+      }
+    }
+  }
+  if(params.rayStatistics)
+    params.rayStatistics[outindex] = make_float2((float) samples, 0.0f);
+
+  //convert output to uchar, adjusting it to be valued from [0,256) rather than [0,1]
+  uchar4 temp;
+  temp.x = 255.0f * saturate( outputVal.x );
+  temp.y = 255.0f * saturate( outputVal.y );
+  temp.z = 255.0f * saturate( outputVal.z );
+  temp.w = 255.0f * (1.0f - outputVal.w);
+
+  //place output in the image buffer
+  params.outInfo.deviceOutputImage[outindex] = temp;
 
 }
 
-//pre: the resolution of the image has been processed such that it's x and y size are both multiples of 16 (enforced automatically) and y > 256 (enforced automatically)
+//launch one specialization of the compositing kernel
+template< bool FormRays, bool Bricked, bool Shaded, bool GradientOpacity, bool Clipped, bool Perspective, bool PreIntegrated, bool General >
+static void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_launchComposite(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                                  const dim3& grid, const dim3& threads, cudaStream_t* stream)
+{
+  CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_Composite<FormRays, Bricked, Shaded, GradientOpacity, Clipped, Perspective, PreIntegrated, General>
+    <<< grid, threads, 0, *stream >>>(context->DeviceParameters);
+}
+
+typedef void (*CUDA_vtkCUDA1DVolumeMapper_compositeLauncher)(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                             const dim3& grid, const dim3& threads, cudaStream_t* stream);
+
+//the four shading variants of a compositing kernel, in the order of the flags of CUDA_containerKernelVariant.h, the last
+//being the entry of CUDA_VARIANT_GENERAL when General
+#define CUDA_1D_COMPOSITE_SHADING_VARIANTS(FormRays, Bricked, Clipped, Perspective, PreIntegrated, General) \
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_launchComposite<FormRays, Bricked, false, false, Clipped, Perspective, PreIntegrated, false>, \
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_launchComposite<FormRays, Bricked, true, false, Clipped, Perspective, PreIntegrated, false>, \
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_launchComposite<FormRays, Bricked, false, true, Clipped, Perspective, PreIntegrated, false>, \
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_launchComposite<FormRays, Bricked, true, true, Clipped, Perspective, PreIntegrated, General>
+
+//the sixteen variants of a compositing kernel forming its rays, classifying either points or pre-integrated segments
+#define CUDA_1D_COMPOSITE_FORMING_VARIANTS(Bricked, PreIntegrated) \
+  CUDA_1D_COMPOSITE_SHADING_VARIANTS(true, Bricked, false, false, PreIntegrated, false), \
+  CUDA_1D_COMPOSITE_SHADING_VARIANTS(true, Bricked, true, false, PreIntegrated, false), \
+  CUDA_1D_COMPOSITE_SHADING_VARIANTS(true, Bricked, false, true, PreIntegrated, false), \
+  CUDA_1D_COMPOSITE_SHADING_VARIANTS(true, Bricked, true, true, PreIntegrated, true)
+
+//the variants of a compositing kernel reading its rays from the ray buffer, which has them formed already so only their
+//shading varies, repeated in the entries of the variants differing in how the rays are formed
+#define CUDA_1D_COMPOSITE_BUFFERED_VARIANTS(Bricked, PreIntegrated) \
+  CUDA_1D_COMPOSITE_SHADING_VARIANTS(false, Bricked, false, false, PreIntegrated, false), \
+  CUDA_1D_COMPOSITE_SHADING_VARIANTS(false, Bricked, false, false, PreIntegrated, false), \
+  CUDA_1D_COMPOSITE_SHADING_VARIANTS(false, Bricked, false, false, PreIntegrated, false), \
+  CUDA_1D_COMPOSITE_SHADING_VARIANTS(false, Bricked, false, false, PreIntegrated, true)
+
+//the dispatch tables of the compositing kernels by whether the volume is bricked and by variant
+static const CUDA_vtkCUDA1DVolumeMapper_compositeLauncher CUDA_vtkCUDA1DVolumeMapper_formingCompositeVariants[2][CUDA_NUMBER_OF_VARIANTS] = {
+  { CUDA_1D_COMPOSITE_FORMING_VARIANTS(false, false), CUDA_1D_COMPOSITE_FORMING_VARIANTS(false, true) },
+  { CUDA_1D_COMPOSITE_FORMING_VARIANTS(true, false), CUDA_1D_COMPOSITE_FORMING_VARIANTS(true, true) } };
+static const CUDA_vtkCUDA1DVolumeMapper_compositeLauncher CUDA_vtkCUDA1DVolumeMapper_bufferedCompositeVariants[2][CUDA_NUMBER_OF_VARIANTS] = {
+  { CUDA_1D_COMPOSITE_BUFFERED_VARIANTS(false, false), CUDA_1D_COMPOSITE_BUFFERED_VARIANTS(false, true) },
+  { CUDA_1D_COMPOSITE_BUFFERED_VARIANTS(true, false), CUDA_1D_COMPOSITE_BUFFERED_VARIANTS(true, true) } };
+
+#undef CUDA_1D_COMPOSITE_BUFFERED_VARIANTS
+#undef CUDA_1D_COMPOSITE_FORMING_VARIANTS
+#undef CUDA_1D_COMPOSITE_SHADING_VARIANTS
+
+//launch the compositing kernel specialized for whether the volume is bricked and for the variant
+static void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_composite(CUDA_vtkCUDAVolumeMapper_renderContext* context, bool formRays,
+                                                            int variant, const dim3& grid, const dim3& threads, cudaStream_t* stream)
+{
+  const int bricked = context->Parameters.brickInfo.PageTable ? 1 : 0;
+  if(formRays)
+    CUDA_vtkCUDA1DVolumeMapper_formingCompositeVariants[bricked][variant](context, grid, threads, stream);
+  else
+    CUDA_vtkCUDA1DVolumeMapper_bufferedCompositeVariants[bricked][variant](context, grid, threads, stream);
+}
+
+//launch the fused compositing kernel specialized for whether the rendered volume is bricked
+static void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_compositeFused(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                                 const dim3& grid, const dim3& threads, cudaStream_t* stream)
+{
+  if(context->Parameters.brickInfo.PageTable)
+    CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CompositeFused<true> <<< grid, threads, 0, *stream >>>(context->DeviceParameters);
+  else
+    CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CompositeFused<false> <<< grid, threads, 0, *stream >>>(context->DeviceParameters);
+}
+
+//without a ray buffer the rays are formed and composited in one pass, otherwise they are formed into it (unless
+//they are being reused) and composited from it, while fused volumes always form their rays in the compositing pass
+static void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_castRays(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                           const cudaOutputImageInformation& outputInfo, bool reuseRays, bool fused,
+                                                           int variant, const dim3& grid, const dim3& threads, cudaStream_t* stream,
+                                                           cudaEvent_t formed = 0)
+{
+  if(fused){
+    if(formed) context->Runtime->EventRecord(formed, *stream);
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_compositeFused(context, grid, threads, stream);
+    return;
+  }
+  if(!outputInfo.rayBuffer){
+    if(formed) context->Runtime->EventRecord(formed, *stream);
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_composite(context, true, variant, grid, threads, stream);
+    return;
+  }
+  if(!reuseRays) CUDA_vtkCUDAVolumeMapper_renderAlgo_formRays(context, variant, grid, threads, stream);
+  if(formed) context->Runtime->EventRecord(formed, *stream);
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_composite(context, false, variant, grid, threads, stream);
+}
+
+//pre: the block shape of the output information holds no more threads than the device allows in a block
 //post: the OutputImage pointer will hold the ray casted information
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender(const cudaOutputImageInformation& outputInfo,
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+               const cudaOutputImageInformation& outputInfo,
                const cudaRendererInformation& rendererInfo,
                const cudaVolumeInformation& volumeInfo,
                const cuda1DTransferFunctionInformation& transInfo,
+               bool reuseRays,
+               int variant,
+               cudaRenderStatistics* stats,
                cudaStream_t* stream)
 {
+  if(!context) return false;
+  vtkCUDARuntime* runtime = context->Runtime;
+  if(variant < 0 || variant >= CUDA_NUMBER_OF_VARIANTS) variant = CUDA_VARIANT_GENERAL;
+  if(!transInfo.preIntegratedTexture2D) variant &= ~CUDA_VARIANT_PREINTEGRATED;
 
-  // setup execution parameters - staggered to improve parallelism
-  cudaMemcpyToSymbolAsync(volInfo, &volumeInfo, sizeof(cudaVolumeInformation) );
-  cudaMemcpyToSymbolAsync(renInfo, &rendererInfo, sizeof(cudaRendererInformation));
-  cudaMemcpyToSymbolAsync(outInfo, &outputInfo, sizeof(cudaOutputImageInformation));
-  cudaMemcpyToSymbolAsync(CUDA_vtkCUDA1DVolumeMapper_trfInfo, &transInfo, sizeof(cuda1DTransferFunctionInformation));
-  
-  //map the texture for the transfer function
-  alpha_texture_1D.normalized = true;
-  alpha_texture_1D.filterMode = cudaFilterModeLinear;
-  alpha_texture_1D.addressMode[0] = cudaAddressModeClamp;
-  cudaBindTextureToArray(alpha_texture_1D, transInfo.alphaTransferArray1D);
-  galpha_texture_1D.normalized = true;
-  galpha_texture_1D.filterMode = cudaFilterModeLinear;
-  galpha_texture_1D.addressMode[0] = cudaAddressModeClamp;
-  cudaBindTextureToArray(galpha_texture_1D, transInfo.galphaTransferArray1D);
-  colorR_texture_1D.normalized = true;
-  colorR_texture_1D.filterMode = cudaFilterModeLinear;
-  colorR_texture_1D.addressMode[0] = cudaAddressModeClamp;
-  cudaBindTextureToArray(colorR_texture_1D, transInfo.colorRTransferArray1D);
-  colorG_texture_1D.normalized = true;
-  colorG_texture_1D.filterMode = cudaFilterModeLinear;
-  colorG_texture_1D.addressMode[0] = cudaAddressModeClamp;
-  cudaBindTextureToArray(colorG_texture_1D, transInfo.colorGTransferArray1D);
-  colorB_texture_1D.normalized = true;
-  colorB_texture_1D.filterMode = cudaFilterModeLinear;
-  colorB_texture_1D.addressMode[0] = cudaAddressModeClamp;
-  cudaBindTextureToArray(colorB_texture_1D, transInfo.colorBTransferArray1D);
-
-  //create the necessary execution amount parameters from the block sizes and calculate th volume rendering integral
-  int blockX = outputInfo.resolution.x / BLOCK_DIM2D ;
-  int blockY = outputInfo.resolution.y / BLOCK_DIM2D ;
-
-  dim3 grid(blockX, blockY, 1);
-  dim3 threads(BLOCK_DIM2D, BLOCK_DIM2D, 1);
-  CUDAkernel_renderAlgo_formRays <<< grid, threads, 0, *stream >>>();
-  CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_Composite <<< grid, threads, 0, *stream >>>();
-
-  return (cudaGetLastError() == 0);
-}
-
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(const int frame, cudaStream_t* stream){
-
-  // set the texture to the correct image
-  CUDA_vtkCUDA1DVolumeMapper_input_texture.normalized = false;          // access with unnormalized texture coordinates
-  CUDA_vtkCUDA1DVolumeMapper_input_texture.filterMode = cudaFilterModeLinear;    // linear interpolation
-  CUDA_vtkCUDA1DVolumeMapper_input_texture.addressMode[0] = cudaAddressModeClamp;  // wrap texture coordinates
-  CUDA_vtkCUDA1DVolumeMapper_input_texture.addressMode[1] = cudaAddressModeClamp;
-  CUDA_vtkCUDA1DVolumeMapper_input_texture.addressMode[2] = cudaAddressModeClamp;
-
-  // bind array to 3D texture
-  cudaBindTextureToArray(CUDA_vtkCUDA1DVolumeMapper_input_texture,
-              CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0], channelDesc);
-
-  return (cudaGetLastError() == 0);
+  // setup execution parameters in the parameter block of the context, the transfer function and Z buffer textures
+  // being objects held in the information passed
+  CUDA_vtkCUDAVolumeMapper_renderParameters& params = context->Parameters;
+  params.volInfo = volumeInfo;
+  params.renInfo = rendererInfo;
+  params.outInfo = outputInfo;
+  params.trfInfo = transInfo;
+  params.rayStatistics = 0;
+  const bool fused = (volumeInfo.NumberOfFusedVolumes > 0);
+
+  //create the necessary execution amount parameters from the block shape and calculate th volume rendering integral,
+  //the blocks on the right and top edges hanging over the tile
+  dim3 threads(outputInfo.blockSize.x, outputInfo.blockSize.y, 1);
+  dim3 grid((outputInfo.tileSize.x + threads.x - 1) / threads.x, (outputInfo.tileSize.y + threads.y - 1) / threads.y, 1);
+  if(!stats){
+    CUDA_vtkCUDAVolumeMapper_renderAlgo_loadParameters(context, stream);
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_castRays(context, outputInfo, reuseRays, fused, variant, grid, threads, stream);
+    return (runtime->GetLastError() == cudaSuccess);
+  }
+
+  //time each kernel separately when profiling, and have the rays report the samples they take and leap over
+  int numRays = outputInfo.resolution.x*outputInfo.resolution.y;
+  float2* rayStatistics = 0;
+  runtime->Malloc( (void**) &rayStatistics, sizeof(float2)*numRays );
+  runtime->MemsetAsync( rayStatistics, 0, sizeof(float2)*numRays, *stream );
+  params.rayStatistics = rayStatistics;
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_loadParameters(context, stream);
+  cudaEvent_t stageEvents[3];
+  for(int i = 0; i < 3; i++) runtime->EventCreate(&(stageEvents[i]), cudaEventDefault);
+  runtime->EventRecord(stageEvents[0], *stream);
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_castRays(context, outputInfo, reuseRays, fused, variant, grid, threads, stream, stageEvents[1]);
+  runtime->EventRecord(stageEvents[2], *stream);
+  runtime->EventSynchronize(stageEvents[2]);
+  params.rayStatistics = 0;
+
+  float formMilliseconds = 0.0f;
+  float compositeMilliseconds = 0.0f;
+  runtime->EventElapsedTime(&formMilliseconds, stageEvents[0], stageEvents[1]);
+  runtime->EventElapsedTime(&compositeMilliseconds, stageEvents[1], stageEvents[2]);
+  stats->RayFormationTime = 0.001 * formMilliseconds;
+  stats->CompositingTime = 0.001 * compositeMilliseconds;
+  for(int i = 0; i < 3; i++) runtime->EventDestroy(stageEvents[i]);
+
+  //the packed rays are written once and read once when formed, and only read when reused
+  stats->RayBufferBytes = 0.0;
+  if(outputInfo.rayBuffer && !fused)
+    stats->RayBufferBytes = (reuseRays ? 1.0 : 2.0) * 2.0 * sizeof(float4) * (double) numRays;
+
+  //count the samples along the clipped rays, and those leapt over, the kernels being done with them already
+  float2* counts = new float2[numRays];
+  runtime->MemcpyAsync(counts, rayStatistics, sizeof(float2)*numRays, cudaMemcpyDeviceToHost, *stream);
+  runtime->StreamSynchronize(*stream);
+  stats->NumberOfSamples = 0.0;
+  stats->NumberOfSkippedSamples = 0.0;
+  for(int i = 0; i < numRays; i++){
+    stats->NumberOfSamples += (double) counts[i].x;
+    stats->NumberOfSkippedSamples += (double) counts[i].y;
+  }
+  delete[] counts;
+  runtime->Free(rayStatistics);
+
+  return (runtime->GetLastError() == cudaSuccess);
+}
+
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(CUDA_vtkCUDAVolumeMapper_renderContext* context, const int slot,
+                                                       cudaStream_t* stream){
+  if(!context || slot < 0 || slot >= CUDA_MAX_CACHED_FRAMES) return false;
+
+  // point the rays at the texture object of the image held in the slot, which the next render uploads, the stream first
+  // waiting on the device for the copies of the image, which may still be running on the stream that prefetched it
+  if(context->SourceDataUploaded[slot])
+    context->Runtime->StreamWaitEvent(*stream, context->SourceDataUploaded[slot], 0);
+  context->Parameters.volumeTexture = context->SourceDataTexture[slot];
+
+  return (context->Runtime->GetLastError() == cudaSuccess);
 
 }
 
+//create the texture object reading one of the 1D transfer functions, normalized and linearly interpolated
+static cudaTextureObject_t CUDA_vtkCUDA1DVolumeMapper_renderAlgo_createTransferTexture(vtkCUDARuntime* runtime, cudaArray* array){
+  return CUDA_vtkCUDAVolumeMapper_renderAlgo_createTexture(runtime, array, CUDA_PACKED_FLOAT, true, cudaFilterModeLinear);
+}
+
 //pre: the transfer functions are all of type float and are all of size FunctionSize
-//post: the alpha, colorR, G and B 1D textures will map to each transfer function
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadTextures(cuda1DTransferFunctionInformation& transInfo,
+//post: the alpha, colorR, G and B texture objects of the information will map to each transfer function
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadTextures(vtkCUDARuntime* runtime, cuda1DTransferFunctionInformation& transInfo,
                   float* redTF, float* greenTF, float* blueTF, float* alphaTF, float* galphaTF,
                   cudaStream_t* stream){
 
   //retrieve the size of the transer functions
   size_t size = sizeof(float) * transInfo.functionSize;
+
+  //the renders already queued read the previous tables, so they are only released once the stream is done with them
+  runtime->StreamSynchronize(*stream);
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_UnloadTextures(runtime, transInfo, stream);
     
   //define the texture mapping for the alpha component after copying information from host to device array
-  if(transInfo.alphaTransferArray1D)
-    cudaFreeArray(transInfo.alphaTransferArray1D);
-  cudaMallocArray( &(transInfo.alphaTransferArray1D), &channelDesc, transInfo.functionSize, 1);
-  cudaMemcpyToArrayAsync(transInfo.alphaTransferArray1D, 0, 0, alphaTF, size, cudaMemcpyHostToDevice, *stream);
-  if(transInfo.galphaTransferArray1D)
-    cudaFreeArray(transInfo.galphaTransferArray1D);
-  cudaMallocArray( &(transInfo.galphaTransferArray1D), &channelDesc, transInfo.functionSize, 1);
-  cudaMemcpyToArrayAsync(transInfo.galphaTransferArray1D, 0, 0, galphaTF, size, cudaMemcpyHostToDevice, *stream);
+  runtime->MallocArray( &(transInfo.alphaTransferArray1D), &channelDesc, transInfo.functionSize, 1);
+  runtime->MemcpyToArrayAsync(transInfo.alphaTransferArray1D, 0, 0, alphaTF, size, cudaMemcpyHostToDevice, *stream);
+  transInfo.alphaTexture1D = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_createTransferTexture(runtime, transInfo.alphaTransferArray1D);
+  runtime->MallocArray( &(transInfo.galphaTransferArray1D), &channelDesc, transInfo.functionSize, 1);
+  runtime->MemcpyToArrayAsync(transInfo.galphaTransferArray1D, 0, 0, galphaTF, size, cudaMemcpyHostToDevice, *stream);
+  transInfo.galphaTexture1D = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_createTransferTexture(runtime, transInfo.galphaTransferArray1D);
     
   //define the texture mapping for the red component after copying information from host to device array
-  if(transInfo.colorRTransferArray1D)
-    cudaFreeArray(transInfo.colorRTransferArray1D);
-  cudaMallocArray( &(transInfo.colorRTransferArray1D), &channelDesc, transInfo.functionSize, 1);
-  cudaMemcpyToArrayAsync(transInfo.colorRTransferArray1D, 0, 0, redTF, size, cudaMemcpyHostToDevice, *stream);
+  runtime->MallocArray( &(transInfo.colorRTransferArray1D), &channelDesc, transInfo.functionSize, 1);
+  runtime->MemcpyToArrayAsync(transInfo.colorRTransferArray1D, 0, 0, redTF, size, cudaMemcpyHostToDevice, *stream);
+  transInfo.colorRTexture1D = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_createTransferTexture(runtime, transInfo.colorRTransferArray1D);
   
   //define the texture mapping for the green component after copying information from host to device array
-  if(transInfo.colorGTransferArray1D)
-    cudaFreeArray(transInfo.colorGTransferArray1D);
-  cudaMallocArray( &(transInfo.colorGTransferArray1D), &channelDesc, transInfo.functionSize, 1);
-  cudaMemcpyToArrayAsync(transInfo.colorGTransferArray1D, 0, 0, greenTF, size, cudaMemcpyHostToDevice, *stream);
+  runtime->MallocArray( &(transInfo.colorGTransferArray1D), &channelDesc, transInfo.functionSize, 1);
+  runtime->MemcpyToArrayAsync(transInfo.colorGTransferArray1D, 0, 0, greenTF, size, cudaMemcpyHostToDevice, *stream);
+  transInfo.colorGTexture1D = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_createTransferTexture(runtime, transInfo.colorGTransferArray1D);
   
   //define the texture mapping for the blue component after copying information from host to device array
-  if(transInfo.colorBTransferArray1D)
-    cudaFreeArray(transInfo.colorBTransferArray1D);
-  cudaMallocArray( &(transInfo.colorBTransferArray1D), &channelDesc, transInfo.functionSize, 1);
-  cudaMemcpyToArrayAsync(transInfo.colorBTransferArray1D, 0, 0, blueTF, size, cudaMemcpyHostToDevice, *stream);
+  runtime->MallocArray( &(transInfo.colorBTransferArray1D), &channelDesc, transInfo.functionSize, 1);
+  runtime->MemcpyToArrayAsync(transInfo.colorBTransferArray1D, 0, 0, blueTF, size, cudaMemcpyHostToDevice, *stream);
+  transInfo.colorBTexture1D = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_createTransferTexture(runtime, transInfo.colorBTransferArray1D);
 
-  return (cudaGetLastError() == 0);
+  return (runtime->GetLastError() == cudaSuccess);
 
 }
 
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_UnloadTextures(cuda1DTransferFunctionInformation& transInfo, cudaStream_t* stream){
+//pre: the table holds preIntegratedSize squared RGBA entries of type float
+//post: the pre-integrated texture object of the information will map to the table
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadPreIntegratedTexture(vtkCUDARuntime* runtime,
+                  cuda1DTransferFunctionInformation& transInfo,
+                  const float* table, cudaStream_t* stream){
+
+  //the renders already queued read the previous table, so it is only released once the stream is done with it
+  const unsigned int size = transInfo.preIntegratedSize;
+  runtime->StreamSynchronize(*stream);
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(runtime, transInfo.preIntegratedTexture2D);
+  if(transInfo.preIntegratedTransferArray2D)
+    runtime->FreeArray(transInfo.preIntegratedTransferArray2D);
+  transInfo.preIntegratedTransferArray2D = 0;
+  if(!size || !table) return (runtime->GetLastError() == cudaSuccess);
 
+  //define the texture mapping for the segments after copying information from host to device array
+  cudaChannelFormatDesc segmentDesc = cudaCreateChannelDesc<float4>();
+  runtime->MallocArray( &(transInfo.preIntegratedTransferArray2D), &segmentDesc, size, size);
+  runtime->MemcpyToArrayAsync(transInfo.preIntegratedTransferArray2D, 0, 0, table, sizeof(float4) * size * size,
+                              cudaMemcpyHostToDevice, *stream);
+  transInfo.preIntegratedTexture2D = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_createTransferTexture(runtime,
+                                                                                                 transInfo.preIntegratedTransferArray2D);
+
+  return (runtime->GetLastError() == cudaSuccess);
+}
+
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadMacroCells(vtkCUDARuntime* runtime, cuda1DTransferFunctionInformation& transInfo,
+                  const unsigned char* occupancy, const int3& gridSize, int cellSize,
+                  cudaStream_t* stream){
+
+  //reallocate the occupancy buffer only when the grid changes size
+  size_t numberOfCells = (size_t) gridSize.x * (size_t) gridSize.y * (size_t) gridSize.z;
+  if(transInfo.macroCellOccupancy && (transInfo.macroCellGridSize.x != gridSize.x ||
+     transInfo.macroCellGridSize.y != gridSize.y || transInfo.macroCellGridSize.z != gridSize.z)){
+    runtime->Free(transInfo.macroCellOccupancy);
+    transInfo.macroCellOccupancy = 0;
+  }
+  if(!transInfo.macroCellOccupancy)
+    runtime->Malloc( (void**) &(transInfo.macroCellOccupancy), numberOfCells );
+  runtime->MemcpyAsync(transInfo.macroCellOccupancy, occupancy, numberOfCells, cudaMemcpyHostToDevice, *stream);
+  transInfo.macroCellGridSize = gridSize;
+  transInfo.macroCellSize = cellSize;
+
+  return (runtime->GetLastError() == cudaSuccess);
+}
+
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadMacroCells(vtkCUDARuntime* runtime, cuda1DTransferFunctionInformation& transInfo,
+                                                            cudaStream_t* stream){
+  if(transInfo.macroCellOccupancy)
+    runtime->Free(transInfo.macroCellOccupancy);
+  transInfo.macroCellOccupancy = 0;
+  transInfo.macroCellSize = 0;
+
+  return (runtime->GetLastError() == cudaSuccess);
+}
+
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_UnloadTextures(vtkCUDARuntime* runtime, cuda1DTransferFunctionInformation& transInfo,
+                                                          cudaStream_t* stream){
+
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(runtime, transInfo.colorRTexture1D);
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(runtime, transInfo.colorGTexture1D);
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(runtime, transInfo.colorBTexture1D);
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(runtime, transInfo.alphaTexture1D);
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(runtime, transInfo.galphaTexture1D);
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(runtime, transInfo.preIntegratedTexture2D);
   if(transInfo.colorRTransferArray1D)
-    cudaFreeArray(transInfo.colorRTransferArray1D);
+    runtime->FreeArray(transInfo.colorRTransferArray1D);
   transInfo.colorRTransferArray1D = 0;
   if(transInfo.colorGTransferArray1D)
-    cudaFreeArray(transInfo.colorGTransferArray1D);
+    runtime->FreeArray(transInfo.colorGTransferArray1D);
   transInfo.colorGTransferArray1D = 0;
   if(transInfo.colorBTransferArray1D)
-    cudaFreeArray(transInfo.colorBTransferArray1D);
+    runtime->FreeArray(transInfo.colorBTransferArray1D);
   transInfo.colorBTransferArray1D = 0;
   if(transInfo.alphaTransferArray1D)
-    cudaFreeArray(transInfo.alphaTransferArray1D);
+    runtime->FreeArray(transInfo.alphaTransferArray1D);
   transInfo.alphaTransferArray1D = 0;
   if(transInfo.galphaTransferArray1D)
-    cudaFreeArray(transInfo.galphaTransferArray1D);
+    runtime->FreeArray(transInfo.galphaTransferArray1D);
   transInfo.galphaTransferArray1D = 0;
+  if(transInfo.preIntegratedTransferArray2D)
+    runtime->FreeArray(transInfo.preIntegratedTransferArray2D);
+  transInfo.preIntegratedTransferArray2D = 0;
 
-  return (cudaGetLastError() == 0);
+  return (runtime->GetLastError() == cudaSuccess);
 }
 
-//pre:  the data has been preprocessed by the volumeInformationHandler such that it is float data
-//    the index is between 0 and 100
-//post: the input_texture will map to the source data in voxel coordinate space
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageInfo(const float* data, const cudaVolumeInformation& volumeInfo,
-                             cudaStream_t* stream){
-
-  // if the array is already populated with information, free it to prevent leaking
-  if(CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0]){
-    cudaFreeArray(CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0]);
+//the format of the voxels of an array, and the size of one voxel
+static cudaChannelFormatDesc CUDA_vtkCUDA1DVolumeMapper_renderAlgo_voxelDesc(int format, size_t* voxelSize){
+  if(format == CUDA_PACKED_UNSIGNED_CHAR){
+    if(voxelSize) *voxelSize = sizeof(unsigned char);
+    return cudaCreateChannelDesc<unsigned char>();
+  }else if(format == CUDA_PACKED_UNSIGNED_SHORT){
+    if(voxelSize) *voxelSize = sizeof(unsigned short);
+    return cudaCreateChannelDesc<unsigned short>();
   }
-  
+  if(voxelSize) *voxelSize = sizeof(float);
+  return channelDesc;
+}
+
+//pre:  the data has been packed by CPU_vtkCUDAVolumeMapper_packImage into the given format
+//post: the volume holds the source data and a texture object reading it in voxel co-ordinates, ready to be shared by the
+//      contexts of every mapper rendering the same data on the device
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageInfo(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaDeviceVolume& volume,
+                             CUDA_vtkCUDAVolumeMapper_fillSlab fillSlab, void* userData,
+                             const cudaVolumePackingInformation& packing,
+                             const cudaVolumeInformation& volumeInfo, cudaStream_t* stream){
+  volume.Array = 0;
+  volume.Texture = 0;
+  volume.Format = packing.Format;
+  volume.Uploaded = 0;
+  if(!context) return false;
+  vtkCUDARuntime* runtime = context->Runtime;
+
   //define the size of the data, retrieved from the volume information
   cudaExtent volumeSize;
   volumeSize.width = volumeInfo.VolumeSize.x;
   volumeSize.height = volumeInfo.VolumeSize.y;
   volumeSize.depth = volumeInfo.VolumeSize.z;
   
-  // create 3D array to store the image data in
-  cudaMalloc3DArray(&(CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0]), &channelDesc, volumeSize);
-
-  // copy data to 3D array
-  cudaMemcpy3DParms copyParams = {0};
-  copyParams.srcPtr   = make_cudaPitchedPtr( (void*) data, volumeSize.width*sizeof(float),
-                        volumeSize.width, volumeSize.height);
-  copyParams.dstArray = CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0];
-  copyParams.extent   = volumeSize;
-  copyParams.kind     = cudaMemcpyHostToDevice;
-  cudaMemcpy3D(&copyParams);
+  // create 3D array of the packed voxel type to store the image data in
+  size_t voxelSize = sizeof(float);
+  cudaChannelFormatDesc voxelDesc = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_voxelDesc(packing.Format, &voxelSize);
+  if(runtime->Malloc3DArray(&(volume.Array), &voxelDesc, volumeSize) != cudaSuccess){
+    volume.Array = 0;
+    return false;
+  }
+  volume.Texture = CUDA_vtkCUDAVolumeMapper_renderAlgo_createTexture(runtime, volume.Array, packing.Format, false,
+                                                                     cudaFilterModeLinear);
+
+  // stream the data to the 3D array, packing each slab as it goes
+  uint3 size = make_uint3(volumeInfo.VolumeSize.x, volumeInfo.VolumeSize.y, volumeInfo.VolumeSize.z);
+  if(!CUDA_vtkCUDAVolumeMapper_renderAlgo_streamToArray(context, volume.Array, size, voxelSize, fillSlab, userData, stream)){
+    runtime->StreamSynchronize(*stream);
+    CUDA_vtkCUDAVolumeMapper_renderAlgo_freeVolume(runtime, volume);
+    return false;
+  }
+
+  //the volume is shared with the mappers rendering on other streams, which wait on the end of its copies on the device
+  //(see CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame) rather than the host waiting for them here
+  if(runtime->EventCreate(&(volume.Uploaded), cudaEventDisableTiming) != cudaSuccess){
+    volume.Uploaded = 0;
+    runtime->StreamSynchronize(*stream);
+    CUDA_vtkCUDAVolumeMapper_renderAlgo_freeVolume(runtime, volume);
+    return false;
+  }
+  runtime->EventRecord(volume.Uploaded, *stream);
+  return (runtime->GetLastError() == cudaSuccess);
+
+}
 
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_setImageArray(CUDA_vtkCUDAVolumeMapper_renderContext* context, int slot,
+                                                         const cudaDeviceVolume& volume){
+  if(!context || slot < 0 || slot >= CUDA_MAX_CACHED_FRAMES) return false;
+  context->SourceDataArray[slot] = volume.Array;
+  context->SourceDataTexture[slot] = volume.Texture;
+  context->SourceDataUploaded[slot] = volume.Uploaded;
+  context->SourceDataFormat = volume.Format;
   return true;
+}
+
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_initImageArray(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaStream_t* stream){
+  if(!context) return;
+  for(int i = 0; i < CUDA_MAX_CACHED_FRAMES; i++){
+    context->SourceDataArray[i] = 0;
+    context->SourceDataTexture[i] = 0;
+    context->SourceDataUploaded[i] = 0;
+  }
+}
+
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(CUDA_vtkCUDAVolumeMapper_renderContext* context, int slot,
+                                                           cudaStream_t* stream){
+  if(!context) return;
+
+  // forget the volume of the slot, which the mappers sharing it free once none of them holds it any more
+  for(int i = 0; i < CUDA_MAX_CACHED_FRAMES; i++){
+    if(slot >= 0 && i != slot) continue;
+    if(context->Parameters.volumeTexture == context->SourceDataTexture[i])
+      context->Parameters.volumeTexture = 0;
+    context->SourceDataArray[i] = 0;
+    context->SourceDataTexture[i] = 0;
+    context->SourceDataUploaded[i] = 0;
+  }
+}
+
+//pre:  the data has been packed by CPU_vtkCUDAVolumeMapper_packImage as floats
+//post: the fused texture object of the slot will map to the source data in voxel coordinate space
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadFusedImageInfo(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                              int volume, CUDA_vtkCUDAVolumeMapper_fillSlab fillSlab, void* userData,
+                                                              const int3& volumeSize, cudaStream_t* stream){
+  if(!context || volume < 0 || volume >= CUDA_MAX_FUSED_VOLUMES) return false;
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearFusedImageArray(context, volume, stream);
+
+  cudaExtent extent = make_cudaExtent(volumeSize.x, volumeSize.y, volumeSize.z);
+  if(context->Runtime->Malloc3DArray(&(context->FusedDataArray[volume]), &channelDesc, extent) != cudaSuccess){
+    context->FusedDataArray[volume] = 0;
+    return false;
+  }
+  uint3 size = make_uint3(volumeSize.x, volumeSize.y, volumeSize.z);
+  if(!CUDA_vtkCUDAVolumeMapper_renderAlgo_streamToArray(context, context->FusedDataArray[volume],
+                                                        size, sizeof(float), fillSlab, userData, stream))
+    return false;
+
+  context->Parameters.fusedTexture[volume] = CUDA_vtkCUDAVolumeMapper_renderAlgo_createTexture(context->Runtime,
+                                                                                               context->FusedDataArray[volume],
+                                                                                               CUDA_PACKED_FLOAT, false, cudaFilterModeLinear);
+  return (context->Runtime->GetLastError() == cudaSuccess);
+}
+
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearFusedImageArray(CUDA_vtkCUDAVolumeMapper_renderContext* context, int volume,
+                                                                cudaStream_t* stream){
+  if(!context) return;
+  for(int i = 0; i < CUDA_MAX_FUSED_VOLUMES; i++){
+    if(volume >= 0 && i != volume) continue;
+    CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(context->Runtime, context->Parameters.fusedTexture[i]);
+    if(context->FusedDataArray[i])
+      context->Runtime->FreeArray(context->FusedDataArray[i]);
+    context->FusedDataArray[i] = 0;
+  }
+}
+
+//pre:  each table holds CUDA_MAX_FUSED_VOLUMES rows of functionSize entries, one row per fused volume
+//post: the fused colour and gradient opacity 2D texture objects will map to the tables
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadFusedTextures(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                             const float* colorTF, const float* galphaTF, unsigned int functionSize,
+                                                             cudaStream_t* stream){
+  if(!context) return false;
+
+  //the arrays are only recreated when the size of the tables changes
+  cudaChannelFormatDesc colorDesc = cudaCreateChannelDesc<float4>();
+  if(!context->FusedColorArray || context->FusedTableSize != functionSize){
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadFusedTextures(context, stream);
+    context->Runtime->MallocArray(&(context->FusedColorArray), &colorDesc, functionSize, CUDA_MAX_FUSED_VOLUMES);
+    context->Runtime->MallocArray(&(context->FusedGAlphaArray), &channelDesc, functionSize, CUDA_MAX_FUSED_VOLUMES);
+    context->FusedTableSize = functionSize;
+    context->Parameters.fusedColorTexture = CUDA_vtkCUDAVolumeMapper_renderAlgo_createTexture(context->Runtime,
+                                                                                              context->FusedColorArray,
+                                                                                              CUDA_PACKED_FLOAT, true, cudaFilterModeLinear);
+    context->Parameters.fusedGAlphaTexture = CUDA_vtkCUDAVolumeMapper_renderAlgo_createTexture(context->Runtime,
+                                                                                               context->FusedGAlphaArray,
+                                                                                               CUDA_PACKED_FLOAT, true, cudaFilterModeLinear);
+  }
+
+  size_t rows = (size_t) functionSize * CUDA_MAX_FUSED_VOLUMES;
+  context->Runtime->MemcpyToArrayAsync(context->FusedColorArray, 0, 0, colorTF, sizeof(float4)*rows,
+                                       cudaMemcpyHostToDevice, *stream);
+  context->Runtime->MemcpyToArrayAsync(context->FusedGAlphaArray, 0, 0, galphaTF, sizeof(float)*rows,
+                                       cudaMemcpyHostToDevice, *stream);
+
+  return (context->Runtime->GetLastError() == cudaSuccess);
+}
+
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadFusedTextures(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaStream_t* stream){
+  if(!context) return true;
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(context->Runtime, context->Parameters.fusedColorTexture);
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(context->Runtime, context->Parameters.fusedGAlphaTexture);
+  if(context->FusedColorArray)
+    context->Runtime->FreeArray(context->FusedColorArray);
+  context->FusedColorArray = 0;
+  if(context->FusedGAlphaArray)
+    context->Runtime->FreeArray(context->FusedGAlphaArray);
+  context->FusedGAlphaArray = 0;
+  context->FusedTableSize = 0;
+
+  return (context->Runtime->GetLastError() == cudaSuccess);
+}
+
+//pre:  the low resolution volume is loaded as the current frame, in the same packing
+//post: the ray casters sample the volume through the page table, every brick being missing
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadBrickPool(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                         const int3& poolSize, const int3& gridSize, int brickSize, float coarseScale,
+                                                         const cudaVolumePackingInformation& packing, cudaStream_t* stream){
+  if(!context) return false;
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadBrickPool(context, stream);
+  vtkCUDARuntime* runtime = context->Runtime;
+
+  //the pool takes the packing of the volume, so the bricks are read in the same units as the low resolution volume
+  cudaChannelFormatDesc voxelDesc = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_voxelDesc(packing.Format, 0);
+  if(runtime->Malloc3DArray(&(context->BrickPoolArray), &voxelDesc,
+                            make_cudaExtent(poolSize.x, poolSize.y, poolSize.z)) != cudaSuccess){
+    context->BrickPoolArray = 0;
+    return false;
+  }
+  context->Parameters.brickPoolTexture = CUDA_vtkCUDAVolumeMapper_renderAlgo_createTexture(runtime, context->BrickPoolArray,
+                                                                                           packing.Format, false, cudaFilterModeLinear);
 
+  //every brick starts missing and unrequested, the rays reading the page table from the next render on, and the page
+  //table and requests going through page-locked copies of their own so that neither copy waits for the host
+  cudaBrickInformation& bricks = context->Parameters.brickInfo;
+  size_t numberOfBricks = (size_t) gridSize.x * (size_t) gridSize.y * (size_t) gridSize.z;
+  runtime->Malloc( (void**) &(bricks.PageTable), sizeof(int4) * numberOfBricks );
+  runtime->Malloc( (void**) &(bricks.Requests), numberOfBricks );
+  runtime->HostAlloc( (void**) &(context->PageTableStaging), sizeof(int4) * numberOfBricks, cudaHostAllocWriteCombined );
+  runtime->HostAlloc( (void**) &(context->BrickRequestsStaging), numberOfBricks, cudaHostAllocDefault );
+  runtime->MemsetAsync( bricks.PageTable, 0, sizeof(int4) * numberOfBricks, *stream );
+  runtime->MemsetAsync( bricks.Requests, 0, numberOfBricks, *stream );
+  bricks.GridSize = gridSize;
+  bricks.BrickSize = brickSize;
+  bricks.CoarseScale = coarseScale;
+
+  if(runtime->GetLastError() == cudaSuccess && context->PageTableStaging && context->BrickRequestsStaging) return true;
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadBrickPool(context, stream);
+  return false;
+}
+
+//the size in bytes of a brick of the pool with its apron
+static size_t CUDA_vtkCUDA1DVolumeMapper_renderAlgo_brickBytes(CUDA_vtkCUDAVolumeMapper_renderContext* context){
+  size_t voxelSize = sizeof(float);
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_voxelDesc(context->SourceDataFormat, &voxelSize);
+  const size_t n = (size_t) (context->Parameters.brickInfo.BrickSize + 2 * CUDA_BRICK_APRON);
+  return n * n * n * voxelSize;
 }
 
-void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_initImageArray(cudaStream_t* stream){
-  CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0] = 0;
+//pre:  the pool of bricks is loaded
+//post: the staging buffer holds at least numberOfBricks bricks, and the copies out of it queued earlier are done
+void* CUDA_vtkCUDA1DVolumeMapper_renderAlgo_reserveBrickStaging(CUDA_vtkCUDAVolumeMapper_renderContext* context, int numberOfBricks){
+  if(!context || !context->BrickPoolArray || numberOfBricks < 1) return 0;
+  vtkCUDARuntime* runtime = context->Runtime;
+
+  //the last batch was queued a render ago, so its copies have normally finished by now
+  runtime->EventSynchronize(context->BrickCopied);
+  const size_t bytes = (size_t) numberOfBricks * CUDA_vtkCUDA1DVolumeMapper_renderAlgo_brickBytes(context);
+  if(context->BrickStagingBytes >= bytes) return context->BrickStaging;
+  if(context->BrickStaging) runtime->FreeHost(context->BrickStaging);
+  context->BrickStaging = 0;
+  context->BrickStagingBytes = 0;
+  if(runtime->HostAlloc(&(context->BrickStaging), bytes, cudaHostAllocWriteCombined) != cudaSuccess){
+    context->BrickStaging = 0;
+    return 0;
+  }
+  context->BrickStagingBytes = bytes;
+  return context->BrickStaging;
 }
 
-void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(cudaStream_t* stream){
-  // if the array is already populated with information, free it to prevent leaking
-  if(CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0])
-    cudaFreeArray(CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0]);
-  CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0] = 0;
-}
\ No newline at end of file
+//pre:  the bricks are packed in the format of the pool, each with its apron, into the staging buffer of the context
+//post: the copies of the bricks into their slots are queued on the stream, followed by the event the page table waits on
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadBricks(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                      int numberOfBricks, const int* origins, cudaStream_t* stream){
+  if(numberOfBricks < 1) return true;
+  if(!context || !context->BrickPoolArray || !context->BrickStaging) return false;
+  vtkCUDARuntime* runtime = context->Runtime;
+  const size_t brickBytes = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_brickBytes(context);
+  if((size_t) numberOfBricks * brickBytes > context->BrickStagingBytes) return false;
+
+  const int n = context->Parameters.brickInfo.BrickSize + 2 * CUDA_BRICK_APRON;
+  const size_t rowBytes = brickBytes / ((size_t) n * (size_t) n);
+  for(int i = 0; i < numberOfBricks; i++){
+    cudaMemcpy3DParms copyParams = {0};
+    copyParams.srcPtr   = make_cudaPitchedPtr( (char*) context->BrickStaging + i * brickBytes, rowBytes, n, n);
+    copyParams.dstArray = context->BrickPoolArray;
+    copyParams.dstPos   = make_cudaPos(origins[3*i], origins[3*i+1], origins[3*i+2]);
+    copyParams.extent   = make_cudaExtent(n, n, n);
+    copyParams.kind     = cudaMemcpyHostToDevice;
+    runtime->Memcpy3DAsync(&copyParams, *stream);
+  }
+  runtime->EventRecord(context->BrickCopied, *stream);
+
+  return (runtime->GetLastError() == cudaSuccess);
+}
+
+//pre:  the bricks the page table shows as held have been queued by CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadBricks
+//post: the page table is copied on the stream once the copies of the bricks are done, the host table being free to change
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadPageTable(CUDA_vtkCUDAVolumeMapper_renderContext* context, const int* pageTable,
+                                                         cudaStream_t* stream){
+  if(!context) return false;
+  const cudaBrickInformation& bricks = context->Parameters.brickInfo;
+  if(!bricks.PageTable || !context->PageTableStaging) return false;
+  vtkCUDARuntime* runtime = context->Runtime;
+  size_t numberOfBricks = (size_t) bricks.GridSize.x * (size_t) bricks.GridSize.y * (size_t) bricks.GridSize.z;
+
+  //the staging copy of the previous table went out a render ago, and the rays only see the bricks once they have arrived
+  runtime->EventSynchronize(context->PageTableCopied);
+  memcpy(context->PageTableStaging, pageTable, sizeof(int4) * numberOfBricks);
+  runtime->StreamWaitEvent(*stream, context->BrickCopied, 0);
+  runtime->MemcpyAsync(bricks.PageTable, context->PageTableStaging, sizeof(int4) * numberOfBricks, cudaMemcpyHostToDevice, *stream);
+  runtime->EventRecord(context->PageTableCopied, *stream);
+  return (runtime->GetLastError() == cudaSuccess);
+}
+
+//post: the requests of the rays queued so far are copied back behind them on the stream and cleared for the next render
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_readBrickRequests(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaStream_t* stream){
+  if(!context) return false;
+  const cudaBrickInformation& bricks = context->Parameters.brickInfo;
+  if(!bricks.Requests || !context->BrickRequestsStaging) return false;
+  vtkCUDARuntime* runtime = context->Runtime;
+  size_t numberOfBricks = (size_t) bricks.GridSize.x * (size_t) bricks.GridSize.y * (size_t) bricks.GridSize.z;
+  runtime->MemcpyAsync(context->BrickRequestsStaging, bricks.Requests, numberOfBricks, cudaMemcpyDeviceToHost, *stream);
+  runtime->MemsetAsync(bricks.Requests, 0, numberOfBricks, *stream);
+  runtime->EventRecord(context->BrickRequestsRead, *stream);
+  return (runtime->GetLastError() == cudaSuccess);
+}
+
+const unsigned char* CUDA_vtkCUDA1DVolumeMapper_renderAlgo_takeBrickRequests(CUDA_vtkCUDAVolumeMapper_renderContext* context){
+  if(!context || !context->BrickRequestsStaging) return 0;
+
+  //read back a render ago, so the copy has normally finished by now
+  context->Runtime->EventSynchronize(context->BrickRequestsRead);
+  return context->BrickRequestsStaging;
+}
+
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadBrickPool(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaStream_t* stream){
+  if(!context) return;
+  vtkCUDARuntime* runtime = context->Runtime;
+
+  //the renders already queued may still read the pool, and the bricks may still be copied on another stream
+  runtime->StreamSynchronize(*stream);
+  runtime->EventSynchronize(context->BrickCopied);
+  cudaBrickInformation& bricks = context->Parameters.brickInfo;
+  if(bricks.PageTable) runtime->Free(bricks.PageTable);
+  if(bricks.Requests) runtime->Free(bricks.Requests);
+  bricks.PageTable = 0;
+  bricks.Requests = 0;
+  if(context->PageTableStaging) runtime->FreeHost(context->PageTableStaging);
+  if(context->BrickRequestsStaging) runtime->FreeHost(context->BrickRequestsStaging);
+  context->PageTableStaging = 0;
+  context->BrickRequestsStaging = 0;
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(runtime, context->Parameters.brickPoolTexture);
+  if(context->BrickPoolArray)
+    runtime->FreeArray(context->BrickPoolArray);
+  context->BrickPoolArray = 0;
+}
+
+//pre:  the levels are packed in the format of the volume, one after the other (see CPU_vtkCUDAVolumeMapper_buildPyramid)
+//post: the ray casters sample the levels of the pyramid as the footprint of the pixels grows, the host buffer being free to reuse
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadPyramid(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                       const cudaPyramidInformation& pyramid, const void* levels,
+                                                       const cudaVolumePackingInformation& packing, cudaStream_t* stream){
+  if(!context) return false;
+  if(pyramid.NumberOfLevels < 1 || !levels){
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadPyramid(context, stream);
+    return true;
+  }
+
+  //the levels lie side by side along x, so the array is as high and deep as the first one
+  const int last = pyramid.NumberOfLevels - 1;
+  cudaExtent extent = make_cudaExtent(pyramid.LevelOrigin[last] + pyramid.LevelSize[last].x, pyramid.LevelSize[0].y,
+                                      pyramid.LevelSize[0].z);
+  size_t voxelSize = sizeof(float);
+  cudaChannelFormatDesc voxelDesc = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_voxelDesc(packing.Format, &voxelSize);
+
+  //the array is only reallocated when the pyramid changes shape or format, as when the frames of a sequence follow each other
+  cudaExtent& allocated = context->PyramidExtent;
+  if(!context->PyramidArray || allocated.width != extent.width || allocated.height != extent.height ||
+     allocated.depth != extent.depth || context->PyramidFormat != packing.Format){
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadPyramid(context, stream);
+    if(context->Runtime->Malloc3DArray(&(context->PyramidArray), &voxelDesc, extent) != cudaSuccess){
+      context->PyramidArray = 0;
+      return false;
+    }
+    allocated = extent;
+    context->PyramidFormat = packing.Format;
+    context->Parameters.pyramidTexture = CUDA_vtkCUDAVolumeMapper_renderAlgo_createTexture(context->Runtime, context->PyramidArray,
+                                                                                           packing.Format, false, cudaFilterModeLinear);
+  }
+
+  //copy each level to its place in the array
+  const char* level = (const char*) levels;
+  for(int l = 0; l < pyramid.NumberOfLevels; l++){
+    const int3 size = pyramid.LevelSize[l];
+    cudaMemcpy3DParms copyParams = {0};
+    copyParams.srcPtr   = make_cudaPitchedPtr( (void*) level, size.x*voxelSize, size.x, size.y);
+    copyParams.dstArray = context->PyramidArray;
+    copyParams.dstPos   = make_cudaPos(pyramid.LevelOrigin[l], 0, 0);
+    copyParams.extent   = make_cudaExtent(size.x, size.y, size.z);
+    copyParams.kind     = cudaMemcpyHostToDevice;
+    context->Runtime->Memcpy3DAsync(&copyParams, *stream);
+    level += (size_t) size.x * (size_t) size.y * (size_t) size.z * voxelSize;
+  }
+  context->Parameters.pyramidInfo = pyramid;
+  context->Runtime->StreamSynchronize(*stream);
+
+  return (context->Runtime->GetLastError() == cudaSuccess);
+}
+
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadPyramid(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaStream_t* stream){
+  if(!context) return;
+
+  //the ray casters only ever sample the volume once the pyramid has no levels, and the renders already queued may still read it
+  context->Parameters.pyramidInfo.NumberOfLevels = 0;
+  context->Runtime->StreamSynchronize(*stream);
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(context->Runtime, context->Parameters.pyramidTexture);
+  if(context->PyramidArray)
+    context->Runtime->FreeArray(context->PyramidArray);
+  context->PyramidArray = 0;
+  context->PyramidExtent = make_cudaExtent(0, 0, 0);
+}
@@ -14,46 +14,83 @@
 
 // CUDA Volume Rendering includes
 #include "CUDA_container1DTransferFunctionInformation.h"
+#include "CUDA_containerBrickInformation.h"
+#include "CUDA_containerPyramidInformation.h"
 #include "CUDA_containerOutputImageInformation.h"
+#include "CUDA_containerRenderStatistics.h"
 #include "CUDA_containerRendererInformation.h"
 #include "CUDA_containerVolumeInformation.h"
+#include "CUDA_containerVolumePackingInformation.h"
+#include "CUDA_vtkCUDAVolumeMapper_renderAlgo.h"
 
 /** @brief Compute the image of the volume taking into account occluding isosurfaces returning it in a image buffer
 *
+*  @param context The device state of the mapper, whose parameter block is uploaded on the stream before the kernels read it
 *  @param outputInfo Structure containing information for the rendering process describing the output image and how it is handled
 *  @param renderInfo Structure containing information for the rendering process taken primarily from the renderer, such as camera/shading properties
 *  @param volumeInfo Structure containing information for the rendering process taken primarily from the volume, such as dimensions and location in space
+*  @param reuseRays Whether the ray buffer of outputInfo already holds the rays of this frame, so they are only composited
+*  @param variant The features the kernels are specialized for (see CUDA_containerKernelVariant.h), which have to cover those
+*                 the frame uses, CUDA_VARIANT_GENERAL rendering any frame
+*  @param stats If not null, receives the ray formation and compositing times and the number of samples (this synchronizes the stream)
+*
+*  @note Without a ray buffer each ray is formed in registers by the compositing kernel, and the ray formation time is zero
+*  @note Every variant renders the image the general one does, the features left out being those that would not change it.
+*        Fused volumes are always composited by the general kernel.
+*  @note Variants with CUDA_VARIANT_PREINTEGRATED composite the segments between samples through the pre-integrated table
+*        of transInfo instead, and fall back to classifying the samples when no table is loaded
 *
 *  @pre The current frame is less than the number of frames, and is non-negative
 *  @pre CUDA-OpenGL interoperability is functional (ie. Only 1 OpenGL context which corresponds solely to the singular renderer/window)
 *
 */
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender(const cudaOutputImageInformation& outputInfo,
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                    const cudaOutputImageInformation& outputInfo,
                                                     const cudaRendererInformation& rendererInfo,
                                                     const cudaVolumeInformation& volumeInfo,
                                                     const cuda1DTransferFunctionInformation& transInfo,
+                                                    bool reuseRays,
+                                                    int variant,
+                                                    cudaRenderStatistics* stats,
                                                     cudaStream_t* stream);
 
-/** @brief Changes the current volume to be rendered to this particular frame, used in 4D visualization
+/** @brief Changes the current volume to be rendered to the frame held in a slot of the frame cache, used in 4D visualization
+*
+*  @param slot The slot (starting with 0) holding the frame that you want to change the currently rendering volume to
+*  @param stream The stream rendering the frame, which is made to wait on the device for the end of the upload of the frame
 *
-*  @param frame The frame (starting with 0) that you want to change the currently rendering volume to
+*  @pre slot is less than CUDA_MAX_CACHED_FRAMES and is non-negative
 *
-*  @pre frame is less than the total number of frames and is non-negative
+*  @note Only the texture object the rays read is changed, the frame having been put into the slot by CUDA_vtkCUDA1DVolumeMapper_renderAlgo_setImageArray
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(CUDA_vtkCUDAVolumeMapper_renderContext* context, const int slot,
+                                                       cudaStream_t* stream);
+
+/** @brief Prepares the slots of the frame cache at the initialization of the renderer
 *
 */
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(const int frame, cudaStream_t* stream);
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_initImageArray(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaStream_t* stream);
 
-/** @brief Prepares the container for the frame at the initialization of the renderer
+/** @brief Puts a volume resident on the device into a slot of the frame cache, without copying it
 *
+*  @param slot The slot the frame is held in, between 0 and CUDA_MAX_CACHED_FRAMES (exclusive)
+*  @param volume The volume, loaded by CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageInfo or shared by another mapper
+*
+*  @pre The slot is not the one bound for rendering while a frame is in flight
 */
-void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_initImageArray(cudaStream_t* stream);
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_setImageArray(CUDA_vtkCUDAVolumeMapper_renderContext* context, int slot,
+                                                         const cudaDeviceVolume& volume);
 
-/** @brief Deallocates the frames and clears the container (needed for ray caster deallocation)
+/** @brief Empties a slot of the frame cache (needed for eviction and ray caster deallocation)
+*
+*  @param slot The slot of the frame, or -1 for every slot
 *
+*  @note The volume is not freed, as other mappers may share it, but released by the caller through the volume cache
 */
-void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(cudaStream_t* stream);
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(CUDA_vtkCUDAVolumeMapper_renderContext* context, int slot,
+                                                           cudaStream_t* stream);
 
-/** @brief Loads the RGBA 2D transfer functions into texture memory
+/** @brief Loads the RGBA 2D transfer functions into arrays read by the texture objects of the transfer function information
 *
 *  @param volumeInfo Structure containing information for the rendering process taken primarily from the volume, such as dimensions and location in space
 *  @param FunctionSize The size of each dimension of each transfer function
@@ -65,20 +102,178 @@ void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(cudaStream_t* stream)
 *  @pre Each transfer function is square with the intensities separated by 1, and gradients by FunctionSize
 *
 */
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadTextures(cuda1DTransferFunctionInformation& transInfo,
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadTextures(vtkCUDARuntime* runtime, cuda1DTransferFunctionInformation& transInfo,
                                                         float* redTF, float* greenTF, float* blueTF, float* alphaTF, float* galphaTF,
                                                         cudaStream_t* stream);
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_UnloadTextures(cuda1DTransferFunctionInformation& transInfo, cudaStream_t* stream);
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_UnloadTextures(vtkCUDARuntime* runtime, cuda1DTransferFunctionInformation& transInfo,
+                                                          cudaStream_t* stream);
+
+/** @brief Loads the pre-integrated transfer function into an array read by the 2D texture object of the transfer function
+*          information, enabling the CUDA_VARIANT_PREINTEGRATED kernels
+*
+*  @param transInfo Holds the size of the table in preIntegratedSize, and receives the array and texture object
+*  @param table preIntegratedSize x preIntegratedSize RGBA entries, the intensity at the front of the segment varying fastest
+*
+*  @see CPU_vtkCUDA1DVolumeMapper_preIntegrate
+*  @note The table is released by CUDA_vtkCUDA1DVolumeMapper_renderAlgo_UnloadTextures along with the 1D tables
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadPreIntegratedTexture(vtkCUDARuntime* runtime,
+                                                                    cuda1DTransferFunctionInformation& transInfo,
+                                                                    const float* table, cudaStream_t* stream);
+
+/** @brief Loads the classification of the macro cells of the volume, enabling empty space skipping
+*
+*  @param transInfo Receives the device buffer holding the classification along with the layout of the grid
+*  @param occupancy 0 for each macro cell the opacity lookup table leaves fully transparent and 1 for the others, x fastest
+*  @param gridSize The number of macro cells in X, Y and Z
+*  @param cellSize The size of a macro cell along each axis in voxels
+*
+*  @see CPU_vtkCUDAVolumeMapper_classifyMacroCells
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadMacroCells(vtkCUDARuntime* runtime, cuda1DTransferFunctionInformation& transInfo,
+                                                          const unsigned char* occupancy, const int3& gridSize, int cellSize,
+                                                          cudaStream_t* stream);
 
-/** @brief Loads an image into a 3D CUDA array which will be bound to a 3D texture for rendering
+/** @brief Releases the classification of the macro cells, disabling empty space skipping
 *
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadMacroCells(vtkCUDARuntime* runtime, cuda1DTransferFunctionInformation& transInfo,
+                                                            cudaStream_t* stream);
+
+/** @brief Loads an image into a 3D CUDA array read by a 3D texture object for rendering
+*
+*  @param context The context whose staging ring the slabs are streamed through
+*  @param volume Receives the array and the texture object, which any mapper on the device can put into its frame cache
+*  @param fillSlab Called on the host to pack each slab of voxels (see CPU_vtkCUDAVolumeMapper_packImage) as it is streamed to the device
+*  @param userData Passed on to fillSlab
+*  @param packing The format of the voxels, 8 and 16-bit voxels being kept at their native width and read as normalized floats
 *  @param volumeInfo Structure containing information for the rendering process taken primarily from the volume, such as dimensions and location in space
-*  @param index The frame number of this image
+*  @param stream The stream the slabs are copied on, which may be a copy stream other than the one rendering so that frames are prefetched during a render
+*
+*  @pre The scale and shift of the packing have been folded into the transfer function ranges
+*
+*  @note The copies may still be running when the function returns, the event of the volume being recorded behind them, which
+*        CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame makes the rendering stream wait on
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageInfo(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaDeviceVolume& volume,
+                                                         CUDA_vtkCUDAVolumeMapper_fillSlab fillSlab, void* userData,
+                                                         const cudaVolumePackingInformation& packing,
+                                                         const cudaVolumeInformation& volumeInfo, cudaStream_t* stream);
+
+/** @brief Loads a volume fused with the rendered one into a 3D CUDA array read by the texture object of its slot
+*
+*  @param volume The slot of the fused volume, between 0 and CUDA_MAX_FUSED_VOLUMES (exclusive)
+*  @param fillSlab Called on the host to pack each slab of voxels as floats as it is streamed to the device
+*  @param userData Passed on to fillSlab
+*  @param volumeSize The size of the fused volume in X, Y and Z
+*
+*  @note Fused volumes are composited by the same ray pass as the rendered volume whenever the volume information
+*        given to CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender counts any
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadFusedImageInfo(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                              int volume, CUDA_vtkCUDAVolumeMapper_fillSlab fillSlab, void* userData,
+                                                              const int3& volumeSize, cudaStream_t* stream);
+
+/** @brief Deallocates the array of a fused volume
+*
+*  @param volume The slot of the fused volume, or -1 for every slot
+*/
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearFusedImageArray(CUDA_vtkCUDAVolumeMapper_renderContext* context, int volume,
+                                                                cudaStream_t* stream);
+
+/** @brief Loads the lookup tables of the fused volumes into 2D arrays read by texture objects, one row per slot
+*
+*  @param colorTF CUDA_MAX_FUSED_VOLUMES rows of functionSize RGBA entries, the opacity in A
+*  @param galphaTF CUDA_MAX_FUSED_VOLUMES rows of functionSize gradient opacity entries
+*  @param functionSize The number of entries in each row, the same as the tables of the rendered volume
+*
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadFusedTextures(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                             const float* colorTF, const float* galphaTF, unsigned int functionSize,
+                                                             cudaStream_t* stream);
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadFusedTextures(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaStream_t* stream);
+
+/** @brief Allocates the pool of bricks of a volume too large for the device, and its page table with every brick missing
+*
+*  @param poolSize The size of the pool in voxels, each slot holding a brick and its apron (see vtkCUDABrickManager)
+*  @param gridSize The number of bricks along X, Y and Z
+*  @param brickSize The size of a brick along each axis, without its apron
+*  @param coarseScale The factor from the voxels of the volume to those of the low resolution volume bound as the current frame
+*  @param packing The format of the voxels, the same as the low resolution volume's
+*
+*  @note Once the pool is loaded, the ray casters sample the volume through the page table until it is unloaded
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadBrickPool(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                         const int3& poolSize, const int3& gridSize, int brickSize, float coarseScale,
+                                                         const cudaVolumePackingInformation& packing, cudaStream_t* stream);
+
+/** @brief Gets the page-locked buffer the bricks are packed into before they are copied to the pool
+*
+*  @param numberOfBricks The number of bricks to pack, one after the other with their aprons (see CPU_vtkCUDAVolumeMapper_packBrick)
+*
+*  @note The buffer is kept by the context and only grown, and the copies queued out of it before are done when it is returned
+*  @return The buffer, or null if it cannot be allocated
+*/
+void* CUDA_vtkCUDA1DVolumeMapper_renderAlgo_reserveBrickStaging(CUDA_vtkCUDAVolumeMapper_renderContext* context, int numberOfBricks);
+
+/** @brief Queues the copies of the bricks packed in the staging buffer into their slots of the pool
+*
+*  @param numberOfBricks The number of bricks to copy
+*  @param origins The origin of the slot of each brick in the pool, 3 voxel co-ordinates per brick
+*  @param stream The stream the bricks are copied on, usually a copy stream other than the one rendering
+*
+*  @pre The bricks were packed into the buffer given by CUDA_vtkCUDA1DVolumeMapper_renderAlgo_reserveBrickStaging
+*  @note The copies are followed by an event, which CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadPageTable waits on
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadBricks(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                      int numberOfBricks, const int* origins, cudaStream_t* stream);
+
+/** @brief Copies the page table to the device once the bricks last queued by CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadBricks are in the pool
 *
-*  @pre index is between 0 and 99 inclusive
+*  @param pageTable 4 integers per brick: the origin of its slot in the pool and 1 if it is held (see vtkCUDABrickManager)
+*  @param stream The stream rendering, which waits on the device for the bricks before taking the table
 *
+*  @note The table is staged in page-locked memory, so the host table may change as soon as the function returns
 */
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageInfo(const float* imageData, const cudaVolumeInformation& volumeInfo,
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadPageTable(CUDA_vtkCUDAVolumeMapper_renderContext* context, const int* pageTable,
                                                          cudaStream_t* stream);
 
+/** @brief Queues the readback of the bricks the rays sampled since the last call, and the clearing of the requests for the next render
+*
+*  @param stream The stream rendering, behind whose renders the requests are read
+*
+*  @note The host does not wait for the copy, whose requests are taken by CUDA_vtkCUDA1DVolumeMapper_renderAlgo_takeBrickRequests
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_readBrickRequests(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaStream_t* stream);
+
+/** @brief Takes the requests last read back by CUDA_vtkCUDA1DVolumeMapper_renderAlgo_readBrickRequests, waiting for their copy
+*
+*  @return 1 for each brick sampled and 0 for the others, valid until the requests are read back again, or null without a pool
+*
+*  @note Taken a render after they were read back, the requests are normally there already
+*/
+const unsigned char* CUDA_vtkCUDA1DVolumeMapper_renderAlgo_takeBrickRequests(CUDA_vtkCUDAVolumeMapper_renderContext* context);
+
+/** @brief Deallocates the pool of bricks and its page table, the ray casters sampling the current frame directly again
+*
+*/
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadBrickPool(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaStream_t* stream);
+
+/** @brief Loads the mip pyramid of the current frame, which the ray casters sample wherever a pixel covers several voxels
+*
+*  @param pyramid The layout of the levels (see CPU_vtkCUDAVolumeMapper_buildPyramid)
+*  @param levels The levels packed in the format of the volume, one after the other, level 1 first
+*  @param packing The format of the voxels, the same as the current frame's
+*
+*  @note This returns once the levels are copied, so the host buffer can be reused. A pyramid without levels unloads it.
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadPyramid(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                       const cudaPyramidInformation& pyramid, const void* levels,
+                                                       const cudaVolumePackingInformation& packing, cudaStream_t* stream);
+
+/** @brief Deallocates the mip pyramid, the ray casters sampling the current frame at full resolution again
+*
+*/
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadPyramid(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaStream_t* stream);
+
 #endif
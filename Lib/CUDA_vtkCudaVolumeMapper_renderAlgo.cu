@@ -11,33 +11,126 @@
 #define _CUDA_VTKCUDAVOLUMEMAPPER_RENDERALGO_H
 
 #include "CUDA_vtkCUDAVolumeMapper_renderAlgo.h"
+#include "CUDA_vtkCUDA1DVolumeMapper_renderAlgo.h"
+#include "vtkCUDARuntime.h"
 #include <cuda.h>
-
-#define BLOCK_DIM2D 16 //16 is optimal, 4 is the minimum and 16 is the maximum
-
-//execution parameters and general information
-__constant__ cudaVolumeInformation        volInfo;
-__constant__ cudaRendererInformation      renInfo;
-__constant__ cudaOutputImageInformation      outInfo;
-__constant__ float dRandomRayOffsets[BLOCK_DIM2D*BLOCK_DIM2D];
-
-//texture element information for the ZBuffer
-cudaArray* ZBufferArray = 0;
-texture<float, 2, cudaReadModeElementType> zbuffer_texture;
+#include <cstring>
+
+#define BLOCK_DIM2D 16 //size of the tile of random ray offsets, and of the blocks of the image-wide helper kernels
+#define STAGING_RING_SIZE 3 //number of pinned slabs, so one is filled while the others are copied
+#define STAGING_SLAB_BYTES (4 << 20) //size of a pinned slab, the slabs filled with as many whole slices as fit
+
+//execution parameters and general information of one mapper, which its kernels read from its own block of device memory
+//so that mappers sharing a device neither clobber each other's state nor wait for each other
+typedef struct __align__(16)
+{
+  cudaVolumeInformation             volInfo;
+  cudaRendererInformation           renInfo;
+  cudaOutputImageInformation        outInfo;
+  cuda1DTransferFunctionInformation trfInfo;
+  cudaBrickInformation              brickInfo;
+  cudaPyramidInformation            pyramidInfo;
+
+  float*              rayOffsets;          //BLOCK_DIM2D*BLOCK_DIM2D random offsets of the first sample of the rays
+  float2*             rayStatistics;       //per ray count of the samples along the clipped ray (x) and of those leapt over in
+                                           //empty macro cells (y), only gathered when profiling
+
+  cudaTextureObject_t volumeTexture;       //the frame being rendered, read in the packing of the volume
+  cudaTextureObject_t fusedTexture[CUDA_MAX_FUSED_VOLUMES]; //the volumes fused with the rendered one, read as floats
+  cudaTextureObject_t fusedColorTexture;   //the RGBA lookup tables of the fused volumes, one row per slot
+  cudaTextureObject_t fusedGAlphaTexture;  //the gradient opacity lookup tables of the fused volumes, one row per slot
+  cudaTextureObject_t brickPoolTexture;    //the pool of bricks of a volume too large for the device
+  cudaTextureObject_t pyramidTexture;      //the levels of the mip pyramid of the frame, side by side along x
+} CUDA_vtkCUDAVolumeMapper_renderParameters;
+
+//the device state of one mapper: its parameter block and the arrays behind its textures
+struct CUDA_vtkCUDAVolumeMapper_renderContext
+{
+  vtkCUDARuntime*                            Runtime;           //the runtime every call made for the context goes through
+  CUDA_vtkCUDAVolumeMapper_renderParameters  Parameters;        //host copy of the parameter block, uploaded before each render
+  CUDA_vtkCUDAVolumeMapper_renderParameters* DeviceParameters;  //the parameter block read by the kernels
+
+  //the slots of the frame cache, each with a texture object reading it, 8 and 16-bit data being kept at its native width,
+  //the volumes in them being shared with the other mappers of the same data through the volume cache
+  cudaArray*          SourceDataArray[CUDA_MAX_CACHED_FRAMES];
+  cudaTextureObject_t SourceDataTexture[CUDA_MAX_CACHED_FRAMES];
+  cudaEvent_t         SourceDataUploaded[CUDA_MAX_CACHED_FRAMES];   //the end of the upload of each slot, which may be on another stream
+  int                 SourceDataFormat;
+
+  //the volumes fused with the rendered one, always kept as floats, and their lookup tables as rows of 2D arrays
+  cudaArray*          FusedDataArray[CUDA_MAX_FUSED_VOLUMES];
+  cudaArray*          FusedColorArray;
+  cudaArray*          FusedGAlphaArray;
+  unsigned int        FusedTableSize;
+
+  //the bricks of a volume too large for the device, held in a pool whose page table sends each sample to its brick, the
+  //low resolution volume loaded as the frame standing in for the bricks that are missing
+  cudaArray*          BrickPoolArray;
+
+  //the page-locked buffers the bricks go through: the bricks packed for the pool, kept and only grown, with an event
+  //marking the end of their copies, the page table given to the rays once those copies are done, and the requests of the
+  //rays read back behind each render, to be taken after the next one
+  void*               BrickStaging;
+  size_t              BrickStagingBytes;
+  cudaEvent_t         BrickCopied;
+  int*                PageTableStaging;
+  cudaEvent_t         PageTableCopied;
+  unsigned char*      BrickRequestsStaging;
+  cudaEvent_t         BrickRequestsRead;
+
+  //the mip pyramid of the rendered volume, its levels lying side by side along x in one array of the packing of the volume
+  cudaArray*          PyramidArray;
+  cudaExtent          PyramidExtent;
+  int                 PyramidFormat;
+
+  //the ring of pinned slabs the volumes are streamed to the device through, allocated by the first upload and kept until
+  //the context is destroyed, each slab with an event marking the end of its last copy
+  void*               StagingSlabs[STAGING_RING_SIZE];
+  cudaEvent_t         StagingCopied[STAGING_RING_SIZE];
+  size_t              StagingSlabBytes;
+  int                 StagingSlot;        //the slab the next upload fills first, so that uploads follow each other round the ring
+};
 
 //channel for loading input data and transfer functions
 cudaChannelFormatDesc channelDesc = cudaCreateChannelDesc<float>();
 
+//create a texture object reading an array through clamped co-ordinates, voxels of 8 and 16-bit packings as normalized floats
+static cudaTextureObject_t CUDA_vtkCUDAVolumeMapper_renderAlgo_createTexture(vtkCUDARuntime* runtime, cudaArray* array,
+                                                                             int format, bool normalized,
+                                                                             cudaTextureFilterMode filterMode){
+  cudaResourceDesc resource;
+  memset(&resource, 0, sizeof(resource));
+  resource.resType = cudaResourceTypeArray;
+  resource.res.array.array = array;
+
+  cudaTextureDesc description;
+  memset(&description, 0, sizeof(description));
+  description.addressMode[0] = cudaAddressModeClamp;
+  description.addressMode[1] = cudaAddressModeClamp;
+  description.addressMode[2] = cudaAddressModeClamp;
+  description.filterMode = filterMode;
+  description.readMode = (format == CUDA_PACKED_FLOAT) ? cudaReadModeElementType : cudaReadModeNormalizedFloat;
+  description.normalizedCoords = normalized ? 1 : 0;
+
+  cudaTextureObject_t texture = 0;
+  if(runtime->CreateTextureObject(&texture, &resource, &description, 0) != cudaSuccess) return 0;
+  return texture;
+}
+
+static void CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(vtkCUDARuntime* runtime, cudaTextureObject_t& texture){
+  if(texture) runtime->DestroyTextureObject(texture);
+  texture = 0;
+}
+
 inline __host__ __device__ float dot(float3 a, float3 b)
 { 
     return a.x * b.x + a.y * b.y + a.z * b.z;
 }
 
-__device__ void CUDAkernel_ClipRayAgainstClippingPlanes(float3& rayStart, float3& rayEnd, float3& rayDir) {
+__device__ void CUDAkernel_ClipRayAgainstClippingPlanes(const CUDA_vtkCUDAVolumeMapper_renderParameters& params,
+                                                        float3& rayStart, float3& rayEnd, float3& rayDir) {
   
-  __syncthreads();
-  const int numPlanes = renInfo.NumberOfClippingPlanes;
-  __syncthreads();
+  const int numPlanes = params.renInfo.NumberOfClippingPlanes;
 
   // loop through all 6 clipping planes
   if(!numPlanes) return;
@@ -52,12 +145,10 @@ __device__ void CUDAkernel_ClipRayAgainstClippingPlanes(float3& rayStart, float3
     
     //collect all the information about the current clipping plane
     float4 clippingPlane;
-    __syncthreads();
-    clippingPlane.x  = renInfo.ClippingPlanes[4*i];
-    clippingPlane.y  = renInfo.ClippingPlanes[4*i+1];
-    clippingPlane.z  = renInfo.ClippingPlanes[4*i+2];
-    clippingPlane.w  = renInfo.ClippingPlanes[4*i+3];
-    __syncthreads();
+    clippingPlane.x  = params.renInfo.ClippingPlanes[4*i];
+    clippingPlane.y  = params.renInfo.ClippingPlanes[4*i+1];
+    clippingPlane.z  = params.renInfo.ClippingPlanes[4*i+2];
+    clippingPlane.w  = params.renInfo.ClippingPlanes[4*i+3];
     
     const float dp = clippingPlane.x*rayDir.x +
              clippingPlane.y*rayDir.y +
@@ -95,7 +186,8 @@ __device__ void CUDAkernel_ClipRayAgainstClippingPlanes(float3& rayStart, float3
 
 }
 
-__device__ void CUDAkernel_ClipRayAgainstVolume(float3& rayStart, float3& rayEnd, float3& rayDir) {
+__device__ void CUDAkernel_ClipRayAgainstVolume(const CUDA_vtkCUDAVolumeMapper_renderParameters& params,
+                                                float3& rayStart, float3& rayEnd, float3& rayDir) {
   
   //define the ray's length and direction to account for any changes in starting and ending position
   rayDir.x = rayEnd.x - rayStart.x;
@@ -103,14 +195,12 @@ __device__ void CUDAkernel_ClipRayAgainstVolume(float3& rayStart, float3& rayEnd
   rayDir.z = rayEnd.z - rayStart.z;
   
   //collect the information about the bounds of the volume in voxels from the volume information
-  __syncthreads();
-  const float bounds0 = volInfo.Bounds[0]+1.0f;
-  const float bounds1 = volInfo.Bounds[1]-1.0f;
-  const float bounds2 = volInfo.Bounds[2]+1.0f;
-  const float bounds3 = volInfo.Bounds[3]-1.0f;
-  const float bounds4 = volInfo.Bounds[4]+1.0f;
-  const float bounds5 = volInfo.Bounds[5]-1.0f;
-  __syncthreads();
+  const float bounds0 = params.volInfo.Bounds[0]+1.0f;
+  const float bounds1 = params.volInfo.Bounds[1]-1.0f;
+  const float bounds2 = params.volInfo.Bounds[2]+1.0f;
+  const float bounds3 = params.volInfo.Bounds[3]-1.0f;
+  const float bounds4 = params.volInfo.Bounds[4]+1.0f;
+  const float bounds5 = params.volInfo.Bounds[5]-1.0f;
     
   float diffS;
   float diffE;
@@ -208,126 +298,408 @@ __device__ void CUDAkernel_ClipRayAgainstVolume(float3& rayStart, float3& rayEnd
 
 }
 
-__device__ void CUDAkernel_SetRayEnds(const int2& index, float3& rayStart, float3& rayDir, const int& outIndex) {
+//set the ends of the ray of a pixel, specialized for whether it is clipped against the clipping planes (Clipped) and whether
+//it is projected in perspective (Perspective), a parallel projection leaving the last row of the matrix (0, 0, 0, 1)
+template< bool Clipped, bool Perspective >
+__device__ void CUDAkernel_SetRayEnds(const CUDA_vtkCUDAVolumeMapper_renderParameters& params,
+                                      const int2& index, float3& rayStart, float3& rayDir, const int& outIndex) {
   //set the original estimates of the starting and ending co-ordinates in the co-ordinates of the view (not voxels)
   //note: viewRayZ = 0 for start and viewRayZ = 1 for end
-  __syncthreads();
-  float viewRayX =  1.0f - ( ((float) index.x) / (float) outInfo.resolution.x );
-  float viewRayY =  ( ((float) index.y) / (float) outInfo.resolution.y );
-  __syncthreads();
-  float endDepth = tex2D(zbuffer_texture, 1.0f-viewRayX, viewRayY );
+  float viewRayX =  1.0f - ( ((float) index.x) / (float) params.outInfo.resolution.x );
+  float viewRayY =  ( ((float) index.y) / (float) params.outInfo.resolution.y );
+  float endDepth = tex2D<float>(params.renInfo.ZBufferTexture, 1.0f-viewRayX, viewRayY );
 
   //multiply the start co-ordinate in the view by the view to voxels matrix to get the co-ordinate in voxels (NOT YET NORMALIZED)
-  __syncthreads();
-  rayStart.x = viewRayX*renInfo.ViewToVoxelsMatrix[0] + viewRayY*renInfo.ViewToVoxelsMatrix[1] + renInfo.ViewToVoxelsMatrix[3];
-  rayStart.y = viewRayX*renInfo.ViewToVoxelsMatrix[4] + viewRayY*renInfo.ViewToVoxelsMatrix[5] + renInfo.ViewToVoxelsMatrix[7];
-  rayStart.z = viewRayX*renInfo.ViewToVoxelsMatrix[8] + viewRayY*renInfo.ViewToVoxelsMatrix[9] + renInfo.ViewToVoxelsMatrix[11];
-  float startNorm = viewRayX*renInfo.ViewToVoxelsMatrix[12] + viewRayY*renInfo.ViewToVoxelsMatrix[13] + renInfo.ViewToVoxelsMatrix[15];
+  rayStart.x = viewRayX*params.renInfo.ViewToVoxelsMatrix[0] + viewRayY*params.renInfo.ViewToVoxelsMatrix[1] + params.renInfo.ViewToVoxelsMatrix[3];
+  rayStart.y = viewRayX*params.renInfo.ViewToVoxelsMatrix[4] + viewRayY*params.renInfo.ViewToVoxelsMatrix[5] + params.renInfo.ViewToVoxelsMatrix[7];
+  rayStart.z = viewRayX*params.renInfo.ViewToVoxelsMatrix[8] + viewRayY*params.renInfo.ViewToVoxelsMatrix[9] + params.renInfo.ViewToVoxelsMatrix[11];
 
   //multiply the equivalent for the end ray, noting that much of the pre-normalized computation is the same as the start ray
-  __syncthreads();
   float3 rayEnd;
-  rayEnd.x = rayStart.x + endDepth*renInfo.ViewToVoxelsMatrix[2];
-  rayEnd.y = rayStart.y + endDepth*renInfo.ViewToVoxelsMatrix[6];
-  rayEnd.z = rayStart.z + endDepth*renInfo.ViewToVoxelsMatrix[10];
-  float endNorm = startNorm + endDepth*renInfo.ViewToVoxelsMatrix[14];
-  __syncthreads();
-  
-  //normalize (and ergo finish) the start ray's matrix multiplication
+  rayEnd.x = rayStart.x + endDepth*params.renInfo.ViewToVoxelsMatrix[2];
+  rayEnd.y = rayStart.y + endDepth*params.renInfo.ViewToVoxelsMatrix[6];
+  rayEnd.z = rayStart.z + endDepth*params.renInfo.ViewToVoxelsMatrix[10];
+
+  //normalize (and ergo finish) the matrix multiplications, which a parallel projection leaves normalized
+  if(Perspective){
+    float startNorm = viewRayX*params.renInfo.ViewToVoxelsMatrix[12] + viewRayY*params.renInfo.ViewToVoxelsMatrix[13] + params.renInfo.ViewToVoxelsMatrix[15];
+    float endNorm = startNorm + endDepth*params.renInfo.ViewToVoxelsMatrix[14];
+    rayStart.x /= startNorm;
+    rayStart.y /= startNorm;
+    rayStart.z /= startNorm;
+    rayEnd.x /= endNorm;
+    rayEnd.y /= endNorm;
+    rayEnd.z /= endNorm;
+  }
+
+  //refine the ray to only include areas that are both within the volume, and within the clipping planes of said volume
+  //note that ClipRayAgainstVolume calculate the ray's correct length and direction and returns it in rayInc
+  if(Clipped) CUDAkernel_ClipRayAgainstClippingPlanes(params, rayStart, rayEnd, rayDir);
+  CUDAkernel_ClipRayAgainstVolume(params, rayStart, rayEnd, rayDir);
+}
+
+template< bool Clipped, bool Perspective >
+__device__ void CUDAkernel_FormRay(const CUDA_vtkCUDAVolumeMapper_renderParameters& params,
+                                   const int2& index, float3& rayStart, float3& rayInc, float& numSteps) {
+
+  //index in the output image (1D)
+  int outindex = index.x + index.y * params.outInfo.resolution.x;
+
+  // Calculate the starting and ending points of the ray, as well as the direction vector
+  CUDAkernel_SetRayEnds<Clipped, Perspective>(params, index, rayStart, rayInc, outindex);
+
+  //determine the maximum number of steps the ray should sample and determine the length of each step
+  //(either one smallest spacing in world units, or one voxel along the ray in voxel units, scaled by the quality)
+  const int samplingMode = params.renInfo.SamplingMode;
+  const float sampleDistanceFactor = params.renInfo.SampleDistanceFactor;
+  if( samplingMode == CUDA_SAMPLE_VOXEL_FOOTPRINT )
+    numSteps = __fsqrt_rz( rayInc.x*rayInc.x + rayInc.y*rayInc.y + rayInc.z*rayInc.z );
+  else
+    numSteps = __fsqrt_rz(  rayInc.x*rayInc.x*params.volInfo.Spacing.x*params.volInfo.Spacing.x+
+                rayInc.y*rayInc.y*params.volInfo.Spacing.y*params.volInfo.Spacing.y+
+                rayInc.z*rayInc.z*params.volInfo.Spacing.z*params.volInfo.Spacing.z) / params.volInfo.MinSpacing;
+  numSteps /= sampleDistanceFactor;
+  rayInc.x /= numSteps;
+  rayInc.y /= numSteps;
+  rayInc.z /= numSteps;
+}
+
+//project the ray of a pixel into the voxels of a volume without clipping it, rayDir spanning the ray up to the opaque geometry
+__device__ void CUDAkernel_ProjectRay(float viewRayX, float viewRayY, float endDepth, const float* viewToVoxels,
+                                      float3& rayStart, float3& rayDir) {
+  float startNorm = viewRayX*viewToVoxels[12] + viewRayY*viewToVoxels[13] + viewToVoxels[15];
+  float endNorm = startNorm + endDepth*viewToVoxels[14];
+  rayStart.x = viewRayX*viewToVoxels[0] + viewRayY*viewToVoxels[1] + viewToVoxels[3];
+  rayStart.y = viewRayX*viewToVoxels[4] + viewRayY*viewToVoxels[5] + viewToVoxels[7];
+  rayStart.z = viewRayX*viewToVoxels[8] + viewRayY*viewToVoxels[9] + viewToVoxels[11];
+  rayDir.x = (rayStart.x + endDepth*viewToVoxels[2]) / endNorm - rayStart.x / startNorm;
+  rayDir.y = (rayStart.y + endDepth*viewToVoxels[6]) / endNorm - rayStart.y / startNorm;
+  rayDir.z = (rayStart.z + endDepth*viewToVoxels[10]) / endNorm - rayStart.z / startNorm;
   rayStart.x /= startNorm;
   rayStart.y /= startNorm;
   rayStart.z /= startNorm;
-  
-  //normalize (and ergo finish) the end ray's matrix multiplication
-  rayEnd.x /= endNorm;
-  rayEnd.y /= endNorm;
-  rayEnd.z /= endNorm;
+}
 
-  //refine the ray to only include areas that are both within the volume, and within the clipping planes of said volume
-  //note that ClipRayAgainstVolume calculate the ray's correct length and direction and returns it in rayInc
-  CUDAkernel_ClipRayAgainstClippingPlanes(rayStart, rayEnd, rayDir);
-  CUDAkernel_ClipRayAgainstVolume(rayStart, rayEnd, rayDir);
+//narrow the range (in fractions of rayDir from rayStart) of a projected ray to the inside of the clipping planes
+__device__ void CUDAkernel_ClipRangeAgainstClippingPlanes(const CUDA_vtkCUDAVolumeMapper_renderParameters& params,
+                                                          const float3& rayStart, const float3& rayDir, float2& range) {
+  const int numPlanes = params.renInfo.NumberOfClippingPlanes;
+  #pragma unroll 1
+  for ( int i = 0; i < numPlanes; i++ ){
+    const float dp = params.renInfo.ClippingPlanes[4*i]*rayDir.x +
+             params.renInfo.ClippingPlanes[4*i+1]*rayDir.y +
+             params.renInfo.ClippingPlanes[4*i+2]*rayDir.z;
+    const float distance = params.renInfo.ClippingPlanes[4*i]*rayStart.x +
+             params.renInfo.ClippingPlanes[4*i+1]*rayStart.y +
+             params.renInfo.ClippingPlanes[4*i+2]*rayStart.z +
+             params.renInfo.ClippingPlanes[4*i+3];
+    if(dp > 0.0f) range.x = fmaxf(range.x, -distance / dp);
+    else if(dp < 0.0f) range.y = fminf(range.y, -distance / dp);
+    else if(distance < 0.0f) range.y = range.x;
+  }
 }
 
-__global__ void CUDAkernel_renderAlgo_formRays( ) {
+//narrow the range (in fractions of rayDir from rayStart) of a projected ray to the inside of the bounds of a volume, kept one voxel clear of the faces
+__device__ void CUDAkernel_ClipRangeAgainstVolume(const float3& rayStart, const float3& rayDir, const float* bounds, float2& range) {
+  const float start[3] = { rayStart.x, rayStart.y, rayStart.z };
+  const float dir[3] = { rayDir.x, rayDir.y, rayDir.z };
+  #pragma unroll
+  for ( int i = 0; i < 3; i++ ){
+    const float low = bounds[2*i] + 1.0f;
+    const float high = bounds[2*i+1] - 1.0f;
+    if(dir[i] != 0.0f){
+      float t0 = (low - start[i]) / dir[i];
+      float t1 = (high - start[i]) / dir[i];
+      range.x = fmaxf(range.x, fminf(t0, t1));
+      range.y = fminf(range.y, fmaxf(t0, t1));
+    }else if(start[i] < low || start[i] > high){
+      range.y = range.x;
+    }
+  }
+}
 
-  //index in the output image (2D)
+//form the rays into the ray buffer, specialized as CUDAkernel_SetRayEnds
+template< bool Clipped, bool Perspective >
+__global__ void CUDAkernel_renderAlgo_formRays(const CUDA_vtkCUDAVolumeMapper_renderParameters* __restrict__ parameters) {
+  const CUDA_vtkCUDAVolumeMapper_renderParameters& params = *parameters;
+
+  //index in the output image (2D), the grid covering the tile
   int2 index;
   index.x = blockDim.x * blockIdx.x + threadIdx.x;
   index.y = blockDim.y * blockIdx.y + threadIdx.y;
+  if(index.x >= params.outInfo.tileSize.x || index.y >= params.outInfo.tileSize.y) return;
+  index.x += params.outInfo.tileOffset.x;
+  index.y += params.outInfo.tileOffset.y;
+  if(index.x >= params.outInfo.resolution.x || index.y >= params.outInfo.resolution.y) return;
 
   //index in the output image (1D)
-  int outindex = index.x + index.y * outInfo.resolution.x;
+  int outindex = index.x + index.y * params.outInfo.resolution.x;
   
   float3 rayStart; //ray starting point
   float3 rayInc; // ray sample increment
   float numSteps; //maximum number of samples along this ray
+  CUDAkernel_FormRay<Clipped, Perspective>(params, index, rayStart, rayInc, numSteps);
 
-  // Calculate the starting and ending points of the ray, as well as the direction vector
-  CUDAkernel_SetRayEnds(index, rayStart, rayInc, outindex);
+  //write out the packed ray, as two coalesced 16 byte stores
+  params.outInfo.rayBuffer[2*outindex] = make_float4(rayStart.x, rayStart.y, rayStart.z, numSteps);
+  params.outInfo.rayBuffer[2*outindex+1] = make_float4(rayInc.x, rayInc.y, rayInc.z, 0.0f);
+}
 
-  //determine the maximum number of steps the ray should sample and determine the length of each step
-  numSteps = __fsqrt_rz(  rayInc.x*rayInc.x*volInfo.Spacing.x*volInfo.Spacing.x+
-              rayInc.y*rayInc.y*volInfo.Spacing.y*volInfo.Spacing.y+
-              rayInc.z*rayInc.z*volInfo.Spacing.z*volInfo.Spacing.z) / volInfo.MinSpacing;
-  rayInc.x /= numSteps;
-  rayInc.y /= numSteps;
-  rayInc.z /= numSteps;
-  
-  //write out data
-  __syncthreads();
-  outInfo.rayStartX[outindex] = rayStart.x;
-  __syncthreads();
-  outInfo.rayStartY[outindex] = rayStart.y;
-  __syncthreads();
-  outInfo.rayStartZ[outindex] = rayStart.z;
-  __syncthreads();
-  outInfo.rayIncX[outindex] = rayInc.x;
-  __syncthreads();
-  outInfo.rayIncY[outindex] = rayInc.y;
-  __syncthreads();
-  outInfo.rayIncZ[outindex] = rayInc.z;
-  __syncthreads();
-  outInfo.numSteps[outindex] = numSteps;
-  __syncthreads();
+//launch the ray formation kernel specialized for the clipping and projection of a variant (see CUDA_containerKernelVariant.h)
+static void CUDA_vtkCUDAVolumeMapper_renderAlgo_formRays(CUDA_vtkCUDAVolumeMapper_renderContext* context, int variant,
+                                                         const dim3& grid, const dim3& threads, cudaStream_t* stream){
+  switch(variant & (CUDA_VARIANT_CLIPPED | CUDA_VARIANT_PERSPECTIVE)){
+  case 0:
+    CUDAkernel_renderAlgo_formRays<false, false> <<< grid, threads, 0, *stream >>>(context->DeviceParameters);
+    break;
+  case CUDA_VARIANT_CLIPPED:
+    CUDAkernel_renderAlgo_formRays<true, false> <<< grid, threads, 0, *stream >>>(context->DeviceParameters);
+    break;
+  case CUDA_VARIANT_PERSPECTIVE:
+    CUDAkernel_renderAlgo_formRays<false, true> <<< grid, threads, 0, *stream >>>(context->DeviceParameters);
+    break;
+  default:
+    CUDAkernel_renderAlgo_formRays<true, true> <<< grid, threads, 0, *stream >>>(context->DeviceParameters);
+    break;
+  }
+}
+
+__global__ void CUDAkernel_renderAlgo_accumulate(uchar4* image, float4* accumulation, uint2 resolution, int pass) {
+
+  //index in the output image
+  int x = blockDim.x * blockIdx.x + threadIdx.x;
+  int y = blockDim.y * blockIdx.y + threadIdx.y;
+  if(x >= resolution.x || y >= resolution.y) return;
+  int outindex = x + y * resolution.x;
+
+  //add the pass to the sum, which holds whole numbers so it is exact in any order
+  uchar4 colour = image[outindex];
+  float4 sum = pass ? accumulation[outindex] : make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+  sum.x += (float) colour.x;
+  sum.y += (float) colour.y;
+  sum.z += (float) colour.z;
+  sum.w += (float) colour.w;
+  accumulation[outindex] = sum;
+
+  //replace the pass by the rounded mean
+  const float count = (float) (pass + 1);
+  const float half = 0.5f * count;
+  colour.x = (unsigned char) ((sum.x + half) / count);
+  colour.y = (unsigned char) ((sum.y + half) / count);
+  colour.z = (unsigned char) ((sum.z + half) / count);
+  colour.w = (unsigned char) ((sum.w + half) / count);
+  image[outindex] = colour;
 }
 
-bool CUDA_vtkCUDAVolumeMapper_renderAlgo_loadZBuffer(const float* zBuffer, const int zBufferSizeX, const int zBufferSizeY, cudaStream_t* stream){
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_accumulateImage(vtkCUDARuntime* runtime, uchar4* image, float4* accumulation,
+                                                         const uint2& resolution, int pass, cudaStream_t* stream){
+  dim3 grid((resolution.x + BLOCK_DIM2D - 1) / BLOCK_DIM2D, (resolution.y + BLOCK_DIM2D - 1) / BLOCK_DIM2D, 1);
+  dim3 threads(BLOCK_DIM2D, BLOCK_DIM2D, 1);
+  CUDAkernel_renderAlgo_accumulate <<< grid, threads, 0, *stream >>> (image, accumulation, resolution, pass);
+  return (runtime->GetLastError() == cudaSuccess);
+}
 
-  if(ZBufferArray)
-    cudaFreeArray(ZBufferArray);
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_loadZBuffer(vtkCUDARuntime* runtime, cudaRendererInformation& rendererInfo,
+                                                     const float* zBuffer, const int zBufferSizeX, const int zBufferSizeY,
+                                                     cudaStream_t* stream){
+
+  //the array persists from frame to frame, and is only recreated (along with its texture) when the viewport is resized
+  if(!rendererInfo.ZBufferArray || rendererInfo.ZBufferSize.x != zBufferSizeX || rendererInfo.ZBufferSize.y != zBufferSizeY){
+    CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadZBuffer(runtime, rendererInfo, stream);
+    if(runtime->MallocArray(&(rendererInfo.ZBufferArray), &channelDesc, zBufferSizeX, zBufferSizeY) != cudaSuccess){
+      rendererInfo.ZBufferArray = 0;
+      return false;
+    }
+    rendererInfo.ZBufferSize = make_uint2(zBufferSizeX, zBufferSizeY);
+    rendererInfo.ZBufferTexture = CUDA_vtkCUDAVolumeMapper_renderAlgo_createTexture(runtime, rendererInfo.ZBufferArray,
+                                                                                    CUDA_PACKED_FLOAT, true, cudaFilterModePoint);
+  }
 
   //load the zBuffer from the host to the array
-  cudaMallocArray(&ZBufferArray, &channelDesc, zBufferSizeX, zBufferSizeY);
-  cudaMemcpyToArrayAsync(ZBufferArray, 0, 0, zBuffer, sizeof(float)*zBufferSizeX*zBufferSizeY, cudaMemcpyHostToDevice, *stream);
-
-  //define the texture parameters and bind the texture to the array
-  zbuffer_texture.normalized = true;
-  zbuffer_texture.filterMode = cudaFilterModePoint;
-  zbuffer_texture.addressMode[0] = cudaAddressModeClamp;
-  zbuffer_texture.addressMode[1] = cudaAddressModeClamp;
-  cudaBindTextureToArray(zbuffer_texture, ZBufferArray, channelDesc);
+  runtime->MemcpyToArrayAsync(rendererInfo.ZBufferArray, 0, 0, zBuffer, sizeof(float)*zBufferSizeX*zBufferSizeY,
+                              cudaMemcpyHostToDevice, *stream);
     
-  return (cudaGetLastError() == 0);
+  return (runtime->GetLastError() == cudaSuccess);
 
 }
 
-bool CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadZBuffer(cudaStream_t* stream){
-  if(ZBufferArray)
-    cudaFreeArray(ZBufferArray);
-  ZBufferArray = 0;
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadZBuffer(vtkCUDARuntime* runtime, cudaRendererInformation& rendererInfo,
+                                                       cudaStream_t* stream){
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(runtime, rendererInfo.ZBufferTexture);
+  if(rendererInfo.ZBufferArray)
+    runtime->FreeArray(rendererInfo.ZBufferArray);
+  rendererInfo.ZBufferArray = 0;
+  rendererInfo.ZBufferSize = make_uint2(0, 0);
+
+  return (runtime->GetLastError() == cudaSuccess);
+}
+
+CUDA_vtkCUDAVolumeMapper_renderContext* CUDA_vtkCUDAVolumeMapper_renderAlgo_createContext(vtkCUDARuntime* runtime,
+                                                                                         cudaStream_t* stream){
+  CUDA_vtkCUDAVolumeMapper_renderContext* context = new CUDA_vtkCUDAVolumeMapper_renderContext;
+  memset(context, 0, sizeof(CUDA_vtkCUDAVolumeMapper_renderContext));
+  context->Runtime = runtime;
+  context->SourceDataFormat = CUDA_PACKED_FLOAT;
+  context->PyramidFormat = CUDA_PACKED_FLOAT;
+
+  //the parameter block, and the ray offsets it points to, live on the device of the stream
+  if(runtime->Malloc( (void**) &(context->DeviceParameters), sizeof(CUDA_vtkCUDAVolumeMapper_renderParameters) ) != cudaSuccess ||
+     runtime->Malloc( (void**) &(context->Parameters.rayOffsets), BLOCK_DIM2D*BLOCK_DIM2D*sizeof(float) ) != cudaSuccess){
+    CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyContext(context, stream);
+    return 0;
+  }
+  cudaEvent_t* events[STAGING_RING_SIZE + 3] = { &(context->BrickCopied), &(context->PageTableCopied), &(context->BrickRequestsRead) };
+  for(int i = 0; i < STAGING_RING_SIZE; i++)
+    events[3 + i] = &(context->StagingCopied[i]);
+  for(int i = 0; i < STAGING_RING_SIZE + 3; i++){
+    if(runtime->EventCreate(events[i], cudaEventDisableTiming) != cudaSuccess){
+      *(events[i]) = 0;
+      CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyContext(context, stream);
+      return 0;
+    }
+  }
+  runtime->MemsetAsync(context->Parameters.rayOffsets, 0, BLOCK_DIM2D*BLOCK_DIM2D*sizeof(float), *stream);
+  return context;
+}
 
-  return (cudaGetLastError() == 0);
+void CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyContext(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaStream_t* stream){
+  if(!context) return;
+  vtkCUDARuntime* runtime = context->Runtime;
+
+  //nothing may be released while a kernel of the context could still read it
+  runtime->StreamSynchronize(*stream);
+  CUDA_vtkCUDAVolumeMapper_renderParameters& params = context->Parameters;
+  //the frames are not the context's own but shared through the volume cache, so they are left to the mapper to release
+  for(int i = 0; i < CUDA_MAX_FUSED_VOLUMES; i++){
+    CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(runtime, params.fusedTexture[i]);
+    if(context->FusedDataArray[i]) runtime->FreeArray(context->FusedDataArray[i]);
+  }
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(runtime, params.fusedColorTexture);
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(runtime, params.fusedGAlphaTexture);
+  if(context->FusedColorArray) runtime->FreeArray(context->FusedColorArray);
+  if(context->FusedGAlphaArray) runtime->FreeArray(context->FusedGAlphaArray);
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(runtime, params.brickPoolTexture);
+  if(context->BrickPoolArray) runtime->FreeArray(context->BrickPoolArray);
+  if(params.brickInfo.PageTable) runtime->Free(params.brickInfo.PageTable);
+  if(params.brickInfo.Requests) runtime->Free(params.brickInfo.Requests);
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(runtime, params.pyramidTexture);
+  if(context->PyramidArray) runtime->FreeArray(context->PyramidArray);
+  if(params.rayOffsets) runtime->Free(params.rayOffsets);
+  if(context->DeviceParameters) runtime->Free(context->DeviceParameters);
+
+  //the slabs and the bricks may still be copied on a stream other than this one
+  for(int i = 0; i < STAGING_RING_SIZE; i++){
+    if(!context->StagingCopied[i]) continue;
+    runtime->EventSynchronize(context->StagingCopied[i]);
+    if(context->StagingSlabs[i]) runtime->FreeHost(context->StagingSlabs[i]);
+    runtime->EventDestroy(context->StagingCopied[i]);
+  }
+  if(context->BrickCopied){
+    runtime->EventSynchronize(context->BrickCopied);
+    runtime->EventDestroy(context->BrickCopied);
+  }
+  if(context->PageTableCopied) runtime->EventDestroy(context->PageTableCopied);
+  if(context->BrickRequestsRead) runtime->EventDestroy(context->BrickRequestsRead);
+  if(context->BrickStaging) runtime->FreeHost(context->BrickStaging);
+  if(context->PageTableStaging) runtime->FreeHost(context->PageTableStaging);
+  if(context->BrickRequestsStaging) runtime->FreeHost(context->BrickRequestsStaging);
+  delete context;
 }
 
 //load in a random 16x16 noise array to deartefact the image in real time
-bool CUDA_vtkCUDAVolumeMapper_renderAlgo_loadrandomRayOffsets(const float* randomRayOffsets, cudaStream_t* stream){
-  cudaMemcpyToSymbolAsync(dRandomRayOffsets, randomRayOffsets, BLOCK_DIM2D*BLOCK_DIM2D*sizeof(float), 0, cudaMemcpyHostToDevice, *stream);
-  return (cudaGetLastError() == 0);
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_loadrandomRayOffsets(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                              const float* randomRayOffsets, cudaStream_t* stream){
+  if(!context) return false;
+  context->Runtime->MemcpyAsync(context->Parameters.rayOffsets, randomRayOffsets, BLOCK_DIM2D*BLOCK_DIM2D*sizeof(float),
+                                cudaMemcpyHostToDevice, *stream);
+  return (context->Runtime->GetLastError() == cudaSuccess);
+}
+
+//upload the parameter block of a context before its kernels are launched on the same stream
+static bool CUDA_vtkCUDAVolumeMapper_renderAlgo_loadParameters(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaStream_t* stream){
+  context->Runtime->MemcpyAsync(context->DeviceParameters, &(context->Parameters), sizeof(CUDA_vtkCUDAVolumeMapper_renderParameters),
+                                cudaMemcpyHostToDevice, *stream);
+  return (context->Runtime->GetLastError() == cudaSuccess);
+}
+
+void CUDA_vtkCUDAVolumeMapper_renderAlgo_freeVolume(vtkCUDARuntime* runtime, cudaDeviceVolume& volume){
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyTexture(runtime, volume.Texture);
+  if(volume.Array)
+    runtime->FreeArray(volume.Array);
+  if(volume.Uploaded)
+    runtime->EventDestroy(volume.Uploaded);
+  volume.Array = 0;
+  volume.Uploaded = 0;
 }
 
-bool CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadrandomRayOffsets(cudaStream_t* stream){
-  return (cudaGetLastError() == 0);
+//make the slabs of the staging ring of a context hold at least slabBytes, which only reallocates them for volumes whose
+//single slices are larger than STAGING_SLAB_BYTES
+static bool CUDA_vtkCUDAVolumeMapper_renderAlgo_reserveStaging(CUDA_vtkCUDAVolumeMapper_renderContext* context, size_t slabBytes){
+  if(slabBytes < STAGING_SLAB_BYTES) slabBytes = STAGING_SLAB_BYTES;
+  if(context->StagingSlabBytes >= slabBytes) return true;
+
+  //the slabs being replaced are released once their last copies are done
+  vtkCUDARuntime* runtime = context->Runtime;
+  for(int i = 0; i < STAGING_RING_SIZE; i++){
+    if(!context->StagingSlabs[i]) continue;
+    runtime->EventSynchronize(context->StagingCopied[i]);
+    runtime->FreeHost(context->StagingSlabs[i]);
+    context->StagingSlabs[i] = 0;
+  }
+  context->StagingSlabBytes = 0;
+  for(int i = 0; i < STAGING_RING_SIZE; i++){
+    if(runtime->HostAlloc(&(context->StagingSlabs[i]), slabBytes, cudaHostAllocWriteCombined) != cudaSuccess){
+      context->StagingSlabs[i] = 0;
+      for(int j = 0; j < i; j++){
+        runtime->FreeHost(context->StagingSlabs[j]);
+        context->StagingSlabs[j] = 0;
+      }
+      return false;
+    }
+  }
+  context->StagingSlabBytes = slabBytes;
+  return true;
+}
+
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_streamToArray(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaArray* dstArray,
+                                                       const uint3& volumeSize, size_t voxelSize,
+                                                       CUDA_vtkCUDAVolumeMapper_fillSlab fillSlab, void* userData,
+                                                       cudaStream_t* stream){
+  if(!context) return false;
+  vtkCUDARuntime* runtime = context->Runtime;
+
+  //size the slabs in whole slices
+  size_t sliceBytes = (size_t) volumeSize.x * (size_t) volumeSize.y * voxelSize;
+  int slicesPerSlab = (int) (STAGING_SLAB_BYTES / sliceBytes);
+  if(slicesPerSlab < 1) slicesPerSlab = 1;
+  if(slicesPerSlab > (int) volumeSize.z) slicesPerSlab = volumeSize.z;
+  if(!CUDA_vtkCUDAVolumeMapper_renderAlgo_reserveStaging(context, slicesPerSlab * sliceBytes)) return false;
+
+  //fill each slab on the host once its previous copy is done, while the slabs filled before it are copied
+  bool result = true;
+  int& slot = context->StagingSlot;
+  for(int firstSlice = 0; firstSlice < (int) volumeSize.z; firstSlice += slicesPerSlab){
+    int numberOfSlices = volumeSize.z - firstSlice;
+    if(numberOfSlices > slicesPerSlab) numberOfSlices = slicesPerSlab;
+
+    runtime->EventSynchronize(context->StagingCopied[slot]);
+    if(!fillSlab(context->StagingSlabs[slot], firstSlice, numberOfSlices, userData)){
+      result = false;
+      break;
+    }
+
+    cudaMemcpy3DParms copyParams = {0};
+    copyParams.srcPtr   = make_cudaPitchedPtr( context->StagingSlabs[slot], volumeSize.x*voxelSize, volumeSize.x, volumeSize.y);
+    copyParams.dstArray = dstArray;
+    copyParams.dstPos   = make_cudaPos(0, 0, firstSlice);
+    copyParams.extent   = make_cudaExtent(volumeSize.x, volumeSize.y, numberOfSlices);
+    copyParams.kind     = cudaMemcpyHostToDevice;
+    runtime->Memcpy3DAsync(&copyParams, *stream);
+    runtime->EventRecord(context->StagingCopied[slot], *stream);
+    slot = (slot + 1) % STAGING_RING_SIZE;
+  }
+
+  return result && (runtime->GetLastError() == cudaSuccess);
 }
 
 #include "CUDA_vtkCUDA1DVolumeMapper_renderAlgo.cuh"
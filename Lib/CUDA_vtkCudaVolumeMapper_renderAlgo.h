@@ -15,37 +15,106 @@
 #define __CUDA_vtkCUDAVolumeMapper_renderAlgo_h
 
 // CUDA Volume Rendering includes
+#include "CUDA_containerDeviceVolume.h"
+#include "CUDA_containerKernelVariant.h"
 #include "CUDA_containerOutputImageInformation.h"
 #include "CUDA_containerRendererInformation.h"
 #include "CUDA_containerVolumeInformation.h"
+class vtkCUDARuntime;
 
-/** @brief Loads the ZBuffer into a 2D texture for checking during the rendering process
+/** @brief The device state of one mapper: the parameter block its kernels read, the arrays of its frames, fused volumes,
+*          bricks and mip pyramid, and the texture objects reading them
 *
+*  @note Each mapper rendering with its own context, several mappers share a device without serializing their renders
+*/
+struct CUDA_vtkCUDAVolumeMapper_renderContext;
+
+/** @brief Creates the device state of a mapper on the device of the stream
+*
+*  @param runtime The runtime every call made for the context goes through, kept by the context
+*
+*  @return The context, or 0 if its device memory could not be allocated
+*/
+CUDA_vtkCUDAVolumeMapper_renderContext* CUDA_vtkCUDAVolumeMapper_renderAlgo_createContext(vtkCUDARuntime* runtime,
+                                                                                         cudaStream_t* stream);
+
+/** @brief Releases the device state of a mapper, once the work queued on the stream is done with it
+*
+*/
+void CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyContext(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaStream_t* stream);
+
+/** @brief Loads the ZBuffer into a 2D array read by the texture object of the renderer information
+*
+*  @param rendererInfo Receives the array, its size and the texture object reading it
 *  @param zBuffer A floating point buffer 
 *  @param zBufferSizeX The size of the z buffer in the x direction
 *  @param zBufferSizeY The size of the z buffer in the y direction
 *
 *  @pre The zBuffer consists only of numbers between 0.0f and 1.0f inclusive
 *
+*  @note The array is kept between calls and only reallocated when the size changes
+*
 */
-bool CUDA_vtkCUDAVolumeMapper_renderAlgo_loadZBuffer(const float* zBuffer, const int zBufferSizeX,
-                                                     const int zBufferSizeY, cudaStream_t* stream);
-bool CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadZBuffer(cudaStream_t* stream);
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_loadZBuffer(vtkCUDARuntime* runtime, cudaRendererInformation& rendererInfo,
+                                                     const float* zBuffer, const int zBufferSizeX, const int zBufferSizeY,
+                                                     cudaStream_t* stream);
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadZBuffer(vtkCUDARuntime* runtime, cudaRendererInformation& rendererInfo,
+                                                       cudaStream_t* stream);
 
-/** @brief Loads an random image into a 2D CUDA array for de-artifacting
+/** @brief Loads an random image into the device memory of a context for de-artifacting
 *
 *  @param randomRayOffsets A 16x16 array (in 1 dimension, so 256 elements) of random numbers
 *
 *  @pre Each number in randomRayOffsets is between 0.0f and 1.0f inclusive
 *
 */
-bool CUDA_vtkCUDAVolumeMapper_renderAlgo_loadrandomRayOffsets(const float* randomRayOffsets,
-                                                              cudaStream_t* stream);
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_loadrandomRayOffsets(CUDA_vtkCUDAVolumeMapper_renderContext* context,
+                                                              const float* randomRayOffsets, cudaStream_t* stream);
 
+/** @brief Adds the image just rendered to the running sum of the previous passes and replaces it with their mean
+*
+*  @param image The image just rendered on the device, which receives the mean of all the passes rendered so far
+*  @param accumulation The running sum of the passes on the device, in 0 to 255 units
+*  @param resolution The size of both images
+*  @param pass The number of passes already in the sum, 0 to restart it from this image
+*
+*/
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_accumulateImage(vtkCUDARuntime* runtime, uchar4* image, float4* accumulation,
+                                                         const uint2& resolution, int pass, cudaStream_t* stream);
+
+/** @brief Signature of the function filling a slab of a volume being streamed to the device
+*
+*  @param slab Receives numberOfSlices slices of the volume, packed and stored contiguously
+*  @param firstSlice The index along z of the first slice to fill
+*  @param numberOfSlices The number of slices to fill
+*  @param userData The pointer given to CUDA_vtkCUDAVolumeMapper_renderAlgo_streamToArray
+*
+*  @return false to abort the upload
+*/
+typedef bool (*CUDA_vtkCUDAVolumeMapper_fillSlab)(void* slab, int firstSlice, int numberOfSlices, void* userData);
 
-/** @brief Unloads the random image from the 2D CUDA array set before
+/** @brief Frees a volume resident on the device and the texture object reading it
+*
+*  @note Only to be called once no mapper holds the volume, as vtkCUDAVolumeCache::Release tells
+*/
+void CUDA_vtkCUDAVolumeMapper_renderAlgo_freeVolume(vtkCUDARuntime* runtime, cudaDeviceVolume& volume);
+
+/** @brief Copies a volume into a 3D CUDA array slab by slab through the ring of pinned staging buffers of a context
+*
+*  @param context The context owning the ring, whose slabs are allocated by the first upload and reused by the ones after it
+*  @param dstArray The array receiving the volume, of the size given by volumeSize
+*  @param volumeSize The size of the volume in voxels
+*  @param voxelSize The size in bytes of one voxel in the array
+*  @param fillSlab Called on the host to fill each staging slab, while the slabs before it are being copied
+*  @param userData Passed on to fillSlab
+*
+*  @note The host memory used is bounded by the size of the ring, and not by the size of the volume
+*  @note The copies may still be running on the stream when the function returns
 *
 */
-bool CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadrandomRayOffsets(cudaStream_t* stream);
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_streamToArray(CUDA_vtkCUDAVolumeMapper_renderContext* context, cudaArray* dstArray,
+                                                       const uint3& volumeSize, size_t voxelSize,
+                                                       CUDA_vtkCUDAVolumeMapper_fillSlab fillSlab, void* userData,
+                                                       cudaStream_t* stream);
 
 #endif
@@ -16,8 +16,13 @@
 #include "vtkColorTransferFunction.h"
 #include "vtkImageData.h"
 
+#include "CPU_vtkCUDA1DVolumeMapper_preIntegration.h"
+#include "CPU_vtkCUDAVolumeMapper_macroCells.h"
 #include "CUDA_vtkCUDA1DVolumeMapper_renderAlgo.h"
 
+// STD includes
+#include <limits>
+
 vtkStandardNewMacro(vtkCUDA1DTransferFunctionInformationHandler);
 
 vtkCUDA1DTransferFunctionInformationHandler
@@ -36,6 +41,39 @@ vtkCUDA1DTransferFunctionInformationHandler
   this->TransInfo.colorRTransferArray1D = 0;
   this->TransInfo.colorGTransferArray1D = 0;
   this->TransInfo.colorBTransferArray1D = 0;
+  this->TransInfo.alphaTexture1D = 0;
+  this->TransInfo.galphaTexture1D = 0;
+  this->TransInfo.colorRTexture1D = 0;
+  this->TransInfo.colorGTexture1D = 0;
+  this->TransInfo.colorBTexture1D = 0;
+
+  this->AlphaTransferFunction = new float[this->FunctionSize];
+  this->GAlphaTransferFunction = new float[this->FunctionSize];
+  this->ColorRedTransferFunction = new float[this->FunctionSize];
+  this->ColorGreenTransferFunction = new float[this->FunctionSize];
+  this->ColorBlueTransferFunction = new float[this->FunctionSize];
+  this->HostRendering = false;
+
+  this->TransInfo.preIntegratedSize = 0;
+  this->TransInfo.preIntegratedTransferArray2D = 0;
+  this->TransInfo.preIntegratedTexture2D = 0;
+  this->PreIntegration = false;
+  this->PreIntegratedTransferFunction = 0;
+  this->HostThreadPool = NULL;
+
+  this->TransInfo.macroCellSize = 0;
+  this->TransInfo.macroCellGridSize.x = 0;
+  this->TransInfo.macroCellGridSize.y = 0;
+  this->TransInfo.macroCellGridSize.z = 0;
+  this->TransInfo.macroCellOccupancy = 0;
+  this->MacroCellGrid = 0;
+  this->MacroCellOccupancy = 0;
+  this->MacroCellOccupancySize = 0;
+  this->MacroCellsModified = false;
+
+  this->VolumePacking.Format = CUDA_PACKED_FLOAT;
+  this->VolumePacking.Scale = 1.0f;
+  this->VolumePacking.Shift = 0.0f;
 
   this->InputData = NULL;
   this->Reinitialize();
@@ -46,13 +84,50 @@ vtkCUDA1DTransferFunctionInformationHandler
 {
   this->Deinitialize();
   this->SetInputData(NULL, 0);
+  delete[] this->AlphaTransferFunction;
+  delete[] this->GAlphaTransferFunction;
+  delete[] this->ColorRedTransferFunction;
+  delete[] this->ColorGreenTransferFunction;
+  delete[] this->ColorBlueTransferFunction;
+  delete[] this->MacroCellOccupancy;
+  delete[] this->PreIntegratedTransferFunction;
+}
+
+void vtkCUDA1DTransferFunctionInformationHandler
+::SetHostRendering(bool hostRendering)
+{
+  if( hostRendering == this->HostRendering )
+    {
+    return;
+    }
+  this->HostRendering = hostRendering;
+  if( hostRendering && this->TransInfo.macroCellOccupancy )
+    {
+    this->ReserveGPU();
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadMacroCells( this->GetRuntime(), this->TransInfo, this->GetStream() );
+    }
+  this->lastModifiedTime = 0;
+  this->Modified();
+}
+
+void vtkCUDA1DTransferFunctionInformationHandler
+::SetPreIntegration(bool preIntegration)
+{
+  if( preIntegration == this->PreIntegration )
+    {
+    return;
+    }
+  this->PreIntegration = preIntegration;
+  this->lastModifiedTime = 0;
+  this->Modified();
 }
 
 void vtkCUDA1DTransferFunctionInformationHandler
 ::Deinitialize(int vtkNotUsed(withData))
 {
   this->ReserveGPU();
-  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_UnloadTextures( this->TransInfo, this->GetStream() );
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_UnloadTextures( this->GetRuntime(), this->TransInfo, this->GetStream() );
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadMacroCells( this->GetRuntime(), this->TransInfo, this->GetStream() );
 }
 
 void vtkCUDA1DTransferFunctionInformationHandler
@@ -81,6 +156,25 @@ void vtkCUDA1DTransferFunctionInformationHandler
     }
 }
 
+void vtkCUDA1DTransferFunctionInformationHandler
+::SetVolumePacking(const cudaVolumePackingInformation& packing)
+{
+  if( packing.Scale != this->VolumePacking.Scale || packing.Shift != this->VolumePacking.Shift )
+    {
+    this->lastModifiedTime = 0;
+    this->Modified();
+    }
+  this->VolumePacking = packing;
+}
+
+void vtkCUDA1DTransferFunctionInformationHandler
+::SetMacroCellGrid(const cudaMacroCellGrid* grid)
+{
+  this->MacroCellGrid = grid;
+  this->MacroCellsModified = true;
+  this->Modified();
+}
+
 void vtkCUDA1DTransferFunctionInformationHandler
 ::SetColourTransferFunction(vtkColorTransferFunction* f)
 {
@@ -121,6 +215,11 @@ void vtkCUDA1DTransferFunctionInformationHandler::UpdateTransferFunction()
     (this->colourFunction->GetMTime() <= lastModifiedTime &&
     this->opacityFunction->GetMTime() <= lastModifiedTime) )
     {
+    //the tables still hold, but the grid of a new frame needs classifying against them
+    if( this->MacroCellsModified && lastModifiedTime != 0 )
+      {
+      this->UpdateMacroCells();
+      }
     return;
     }
   lastModifiedTime = (this->colourFunction->GetMTime() > this->opacityFunction->GetMTime()) ?
@@ -138,60 +237,123 @@ void vtkCUDA1DTransferFunctionInformationHandler::UpdateTransferFunction()
   double maxGradient;
   this->gradientopacityFunction->GetRange( minGradient, maxGradient );
 
-  //figure out the multipliers for applying the transfer function in GPU
-  this->TransInfo.intensityLow = minIntensity;
-  this->TransInfo.intensityMultiplier = 1.0 / ( maxIntensity - minIntensity );
-  this->TransInfo.gradientLow = minGradient;
-  this->TransInfo.gradientMultiplier = 1.0 / ( maxGradient - minGradient );
+  //figure out the multipliers for applying the transfer function in GPU, folding in the packing
+  //of the voxels (intensity = Scale * read value + Shift) so the value read can be used directly
+  const double scale = this->VolumePacking.Scale;
+  const double shift = this->VolumePacking.Shift;
+  this->TransInfo.intensityLow = ( minIntensity - shift ) / scale;
+  this->TransInfo.intensityMultiplier = scale / ( maxIntensity - minIntensity );
+  this->TransInfo.gradientLow = minGradient / scale;
+  this->TransInfo.gradientMultiplier = scale / ( maxGradient - minGradient );
 
-  //create local buffers to house the transfer function
-  float* LocalColorRedTransferFunction = new float[this->FunctionSize];
-  float* LocalColorGreenTransferFunction = new float[this->FunctionSize];
-  float* LocalColorBlueTransferFunction = new float[this->FunctionSize];
+  //create a local buffer to house the interleaved colour transfer function
   float* LocalColorWholeTransferFunction = new float[3*this->FunctionSize];
-  float* LocalAlphaTransferFunction = new float[this->FunctionSize];
-  float* LocalGAlphaTransferFunction = new float[this->FunctionSize];
 
-  memset( (void*) LocalColorRedTransferFunction, 0.0f, sizeof(float) * this->FunctionSize);
-  memset( (void*) LocalColorGreenTransferFunction, 0.0f, sizeof(float) * this->FunctionSize);
-  memset( (void*) LocalColorBlueTransferFunction, 0.0f, sizeof(float) * this->FunctionSize);
+  memset( (void*) this->ColorRedTransferFunction, 0.0f, sizeof(float) * this->FunctionSize);
+  memset( (void*) this->ColorGreenTransferFunction, 0.0f, sizeof(float) * this->FunctionSize);
+  memset( (void*) this->ColorBlueTransferFunction, 0.0f, sizeof(float) * this->FunctionSize);
   memset( (void*) LocalColorWholeTransferFunction, 0.0f, 3*sizeof(float) * this->FunctionSize);
-  memset( (void*) LocalAlphaTransferFunction, 1.0f, sizeof(float) * this->FunctionSize);
-  memset( (void*) LocalGAlphaTransferFunction, 1.0f, sizeof(float) * this->FunctionSize);
+  memset( (void*) this->AlphaTransferFunction, 1.0f, sizeof(float) * this->FunctionSize);
+  memset( (void*) this->GAlphaTransferFunction, 1.0f, sizeof(float) * this->FunctionSize);
 
   //populate the table
   this->opacityFunction->GetTable( minIntensity, maxIntensity, this->FunctionSize,
-    LocalAlphaTransferFunction );
+    this->AlphaTransferFunction );
   this->gradientopacityFunction->GetTable( minGradient, maxGradient, this->FunctionSize,
-    LocalGAlphaTransferFunction );
+    this->GAlphaTransferFunction );
+
+  //a gradient opacity of 1 throughout (such as the default one) leaves every opacity as it is, which the infinite multiplier
+  //of a function without a range tells the rays, so they need not look it up nor sample the gradient for it
+  bool unitGradientOpacity = true;
+  for( int i = 0; i < this->FunctionSize && unitGradientOpacity; i++ )
+    unitGradientOpacity = (this->GAlphaTransferFunction[i] == 1.0f);
+  if( unitGradientOpacity )
+    this->TransInfo.gradientMultiplier = std::numeric_limits<float>::infinity();
   this->colourFunction->GetTable( minIntensity, maxIntensity, this->FunctionSize,
     LocalColorWholeTransferFunction );
   for( int i = 0; i < this->FunctionSize; i++ )
     {
-    LocalColorRedTransferFunction[i] = LocalColorWholeTransferFunction[3*i];
-    LocalColorGreenTransferFunction[i] = LocalColorWholeTransferFunction[3*i+1];
-    LocalColorBlueTransferFunction[i] = LocalColorWholeTransferFunction[3*i+2];
+    this->ColorRedTransferFunction[i] = LocalColorWholeTransferFunction[3*i];
+    this->ColorGreenTransferFunction[i] = LocalColorWholeTransferFunction[3*i+1];
+    this->ColorBlueTransferFunction[i] = LocalColorWholeTransferFunction[3*i+2];
+    }
+
+  //clean up the garbage
+  delete LocalColorWholeTransferFunction;
+
+  //integrate the segments between every pair of intensities from the lookup tables
+  this->TransInfo.preIntegratedSize = 0;
+  if( this->PreIntegration )
+    {
+    if( !this->PreIntegratedTransferFunction )
+      {
+      this->PreIntegratedTransferFunction = new float[4 * CPU_PREINTEGRATED_TABLE_SIZE * CPU_PREINTEGRATED_TABLE_SIZE];
+      }
+    CPU_vtkCUDA1DVolumeMapper_preIntegrate( this->AlphaTransferFunction, this->ColorRedTransferFunction,
+      this->ColorGreenTransferFunction, this->ColorBlueTransferFunction, this->FunctionSize,
+      CPU_PREINTEGRATED_TABLE_SIZE, this->PreIntegratedTransferFunction, this->HostThreadPool );
+    this->TransInfo.preIntegratedSize = CPU_PREINTEGRATED_TABLE_SIZE;
     }
 
   //map the trasfer functions to textures for fast access
   this->TransInfo.functionSize = this->FunctionSize;
+  this->UpdateMacroCells();
+  if( this->HostRendering )
+    {
+    return;
+    }
 
   this->ReserveGPU();
-  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadTextures(this->TransInfo,
-    LocalColorRedTransferFunction,
-    LocalColorGreenTransferFunction,
-    LocalColorBlueTransferFunction,
-    LocalAlphaTransferFunction,
-    LocalGAlphaTransferFunction,
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadTextures(this->GetRuntime(), this->TransInfo,
+    this->ColorRedTransferFunction,
+    this->ColorGreenTransferFunction,
+    this->ColorBlueTransferFunction,
+    this->AlphaTransferFunction,
+    this->GAlphaTransferFunction,
+    this->GetStream() );
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadPreIntegratedTexture(this->GetRuntime(), this->TransInfo,
+    this->GetPreIntegratedTransferFunction(),
     this->GetStream() );
+}
 
-  //clean up the garbage
-  delete LocalColorRedTransferFunction;
-  delete LocalColorGreenTransferFunction;
-  delete LocalColorBlueTransferFunction;
-  delete LocalColorWholeTransferFunction;
-  delete LocalAlphaTransferFunction;
-  delete LocalGAlphaTransferFunction;
+void vtkCUDA1DTransferFunctionInformationHandler::UpdateMacroCells()
+{
+  this->MacroCellsModified = false;
+
+  //without a grid, every step is sampled
+  if( !this->MacroCellGrid || !this->MacroCellGrid->Minimum )
+    {
+    this->TransInfo.macroCellSize = 0;
+    if( !this->HostRendering && this->TransInfo.macroCellOccupancy )
+      {
+      this->ReserveGPU();
+      CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadMacroCells( this->GetRuntime(), this->TransInfo, this->GetStream() );
+      }
+    return;
+    }
+
+  //classify the cells against the opacity table, which already has the packing folded into its range
+  const cudaMacroCellGrid& grid = *(this->MacroCellGrid);
+  size_t numberOfCells = (size_t) grid.GridSize.x * (size_t) grid.GridSize.y * (size_t) grid.GridSize.z;
+  if( numberOfCells > this->MacroCellOccupancySize )
+    {
+    delete[] this->MacroCellOccupancy;
+    this->MacroCellOccupancy = new unsigned char[numberOfCells];
+    this->MacroCellOccupancySize = numberOfCells;
+    }
+  CPU_vtkCUDAVolumeMapper_classifyMacroCells( grid, this->AlphaTransferFunction, this->FunctionSize,
+    this->TransInfo.intensityLow, this->TransInfo.intensityMultiplier, this->MacroCellOccupancy );
+
+  if( this->HostRendering )
+    {
+    this->TransInfo.macroCellSize = grid.CellSize;
+    this->TransInfo.macroCellGridSize = grid.GridSize;
+    return;
+    }
+
+  this->ReserveGPU();
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadMacroCells( this->GetRuntime(), this->TransInfo, this->MacroCellOccupancy,
+    grid.GridSize, grid.CellSize, this->GetStream() );
 }
 
 void vtkCUDA1DTransferFunctionInformationHandler::UseGradientOpacity(int u)
@@ -12,11 +12,14 @@
 
 // CUDA Volume Rendering includes
 #include "CUDA_container1DTransferFunctionInformation.h"
+#include "CUDA_containerMacroCellGrid.h"
+#include "CUDA_containerVolumePackingInformation.h"
 #include "vtkCUDAObject.h"
 
 // VTK includes
 #include <vtkObject.h>
 class vtkColorTransferFunction;
+class vtkCUDAHostThreadPool;
 class vtkImageData;
 class vtkPiecewiseFunction;
 
@@ -86,11 +89,67 @@ public:
 
   void UseGradientOpacity( int u );
 
+  /** @brief Set how the voxels of the volume are stored, so that the scale and shift recovering their intensities are folded into the transfer function ranges
+  *
+  *  @param packing The packing chosen by CPU_vtkCUDAVolumeMapper_choosePacking for the input data
+  */
+  void SetVolumePacking(const cudaVolumePackingInformation& packing);
+
+  /** @brief Set the min/max macro cell grid of the frame being rendered, which is classified against the opacity table for empty space skipping
+  *
+  *  @param grid The grid built by CPU_vtkCUDAVolumeMapper_buildMacroCellGrid, or null to sample every step
+  *
+  *  @note The grid is not copied, and must remain valid until it is replaced
+  */
+  void SetMacroCellGrid(const cudaMacroCellGrid* grid);
+
+  /** @brief Gets the host copy of the classification of the macro cells (see GetTransferFunctionInfo().macroCellSize), null if there is none
+  *
+  */
+  const unsigned char* GetMacroCellOccupancy() const { return this->MacroCellGrid ? this->MacroCellOccupancy : 0; }
+
   /** @brief Triggers an update for the volume information, checking all subsidary information for modifications
   *
   */
   virtual void Update();
 
+  /** @brief Sets whether the rays are cast on the host, in which case the lookup tables are kept on the host only
+  *
+  *  @param hostRendering true when the CPU backend of the mapper reads the lookup tables
+  *
+  *  @note Switching back to the device forces the lookup tables to be reloaded into CUDA on the next update
+  */
+  void SetHostRendering(bool hostRendering);
+
+  /** @brief Gets the host copies of the lookup tables, which are GetTransferFunctionInfo().functionSize in size
+  *
+  */
+  const float* GetAlphaTransferFunction() const { return this->AlphaTransferFunction; }
+  const float* GetGAlphaTransferFunction() const { return this->GAlphaTransferFunction; }
+  const float* GetColorRedTransferFunction() const { return this->ColorRedTransferFunction; }
+  const float* GetColorGreenTransferFunction() const { return this->ColorGreenTransferFunction; }
+  const float* GetColorBlueTransferFunction() const { return this->ColorBlueTransferFunction; }
+
+  /** @brief Sets whether the rays classify segments between samples from a pre-integrated table rather than the samples themselves
+  *
+  *  @param preIntegration true to build the table (see CPU_vtkCUDA1DVolumeMapper_preIntegrate) each time the transfer function changes
+  *
+  *  @note This also resets the lastModifiedTime that the volume information handler has for the transfer function, forcing the table to be built on the next update
+  */
+  void SetPreIntegration(bool preIntegration);
+  bool GetPreIntegration() const { return this->PreIntegration; }
+
+  /** @brief Gets the host copy of the pre-integrated table, which is GetTransferFunctionInfo().preIntegratedSize square in RGBA, null if there is none
+  *
+  */
+  const float* GetPreIntegratedTransferFunction() const { return this->TransInfo.preIntegratedSize ? this->PreIntegratedTransferFunction : 0; }
+
+  /** @brief Sets the threads the pre-integrated table is built with, or null to build it on the calling thread
+  *
+  *  @param pool The threads of the mapper, which outlive the handler
+  */
+  void SetHostThreadPool(vtkCUDAHostThreadPool* pool) { this->HostThreadPool = pool; }
+
 protected:
 
   /** @brief Constructor which sets the pointers to the image and volume to null, as well as setting all the constants to safe initial values, and initializes the image holder on the GPU
@@ -108,6 +167,11 @@ protected:
   */
   void UpdateTransferFunction();
 
+  /** @brief Classify the macro cells of the current grid against the opacity lookup table, and load the result where the rays are cast
+  *
+  */
+  void UpdateMacroCells();
+
   void Deinitialize(int withData = 0);
   void Reinitialize(int withData = 0);
 
@@ -129,6 +193,23 @@ private:
   int            FunctionSize;  /**< The size of the transfer function which is square */
   double          HighGradient;  /**< The maximum gradient of the current image */
   double          LowGradient;  /**< The minimum gradient of the current image */
+  cudaVolumePackingInformation  VolumePacking;  /**< How the voxels the ray casters sample are stored */
+
+  float*          AlphaTransferFunction;      /**< Host copy of the opacity lookup table */
+  float*          GAlphaTransferFunction;      /**< Host copy of the gradient opacity lookup table */
+  float*          ColorRedTransferFunction;    /**< Host copy of the red lookup table */
+  float*          ColorGreenTransferFunction;  /**< Host copy of the green lookup table */
+  float*          ColorBlueTransferFunction;    /**< Host copy of the blue lookup table */
+  bool          HostRendering;          /**< Whether the lookup tables are only needed on the host */
+
+  bool            PreIntegration;                 /**< Whether the pre-integrated table is built */
+  float*          PreIntegratedTransferFunction;  /**< Host copy of the pre-integrated table, or null until it is first built */
+  vtkCUDAHostThreadPool* HostThreadPool;          /**< The threads the pre-integrated table is built with, not owned */
+
+  const cudaMacroCellGrid*  MacroCellGrid;  /**< The min/max grid of the frame being rendered, or null */
+  unsigned char*  MacroCellOccupancy;     /**< Host copy of the classification of the macro cells */
+  size_t          MacroCellOccupancySize; /**< The number of cells MacroCellOccupancy has room for */
+  bool            MacroCellsModified;     /**< Whether the grid changed since the last classification */
 
 };
 
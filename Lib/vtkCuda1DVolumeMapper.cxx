@@ -9,42 +9,109 @@
 
 // Type
 #include "vtkCUDA1DVolumeMapper.h"
+#include "vtkCUDAOutputImageInformationHandler.h"
+#include "vtkCUDARendererInformationHandler.h"
 #include "vtkCUDAVolumeInformationHandler.h"
 #include "vtkCUDA1DTransferFunctionInformationHandler.h"
+#include "vtkCUDABrickManager.h"
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAFrameCache.h"
+#include "vtkCUDARuntime.h"
+#include "vtkCUDAVolumeCache.h"
+#include "cuda_runtime_api.h"
+#include "vector_functions.h"
 
 // CUDA Volume Rendering includes
+#include "CPU_vtkCUDA1DVolumeMapper_renderAlgo.h"
+#include "CPU_vtkCUDAVolumeMapper_bricks.h"
+#include "CPU_vtkCUDAVolumeMapper_macroCells.h"
+#include "CPU_vtkCUDAVolumeMapper_packImage.h"
 #include "CUDA_vtkCUDA1DVolumeMapper_renderAlgo.h"
 
 // Volume
 #include <vtkVolume.h>
 #include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkTransform.h>
 
 // Rendering
 #include <vtkCamera.h>
 #include <vtkColorTransferFunction.h>
-#include <vtkMutexLock.h>
 #include <vtkObjectFactory.h>
 #include <vtkPiecewiseFunction.h>
 #include <vtkRenderer.h>
 #include <vtkVolume.h>
 #include <vtkVolumeProperty.h>
 
+// STD includes
+#include <cstring>
+
 vtkStandardNewMacro(vtkCUDA1DVolumeMapper);
 
-vtkMutexLock* vtkCUDA1DVolumeMapper::tfLock = 0;
 vtkCUDA1DVolumeMapper::vtkCUDA1DVolumeMapper()
   {
-  if( !vtkCUDA1DVolumeMapper::tfLock ) vtkCUDA1DVolumeMapper::tfLock = vtkMutexLock::New();
-  else tfLock->Register( this );
   this->transferFunctionInfoHandler = vtkCUDA1DTransferFunctionInformationHandler::New();
+  this->transferFunctionInfoHandler->SetHostRendering( this->RenderBackend == CPU_BACKEND );
+  this->transferFunctionInfoHandler->SetHostThreadPool( this->HostThreadPool );
+  this->currentFrame = 0;
+  this->volumePacking.Format = CUDA_PACKED_FLOAT;
+  this->volumePacking.Scale = 1.0f;
+  this->volumePacking.Shift = 0.0f;
+  this->fusedTransform = vtkTransform::New();
+  this->fusedViewToVoxels = vtkMatrix4x4::New();
+  this->fusedColorTables = 0;
+  this->fusedGAlphaTables = 0;
+  this->fusedTableSize = 0;
+  this->fusedTablesModified = 0;
+  this->frameCache = vtkCUDAFrameCache::New();
+  this->frameCacheFrameBytes = 0;
+  for( int i = 0; i < CUDA_MAX_CACHED_FRAMES; i++ )
+    {
+    this->frameVolumes[i].Array = 0;
+    this->frameVolumes[i].Texture = 0;
+    this->frameVolumes[i].Uploaded = 0;
+    }
+  this->copyStream = 0;
+  this->FrameCacheBudget = 0.0;
+  this->NumberOfPrefetchedFrames = 1;
+  this->brickManager = vtkCUDABrickManager::New();
+  this->bricked = false;
+  this->brickRequestsPending = false;
+  this->coarseImage = 0;
+  this->coarseFactor = 1;
+  this->BrickingMode = BRICKING_AUTO;
+  this->MaximumNumberOfBrickLoads = 64;
+  this->pyramidInfo.NumberOfLevels = 0;
+  this->pyramidFrame = -1;
+  this->UseSpecializedKernels = true;
+  this->kernelVariant = CUDA_VARIANT_GENERAL;
   this->Reinitialize();
   }
 
+void vtkCUDA1DVolumeMapper::SetRenderBackend(int backend)
+  {
+  this->vtkCUDAVolumeMapper::SetRenderBackend(backend);
+  this->transferFunctionInfoHandler->SetHostRendering( this->RenderBackend == CPU_BACKEND );
+  this->ChangeFrameInternal( this->currentFrame );
+
+  //the fused volumes move with the rays as well
+  for( int v = 0; v < (int) this->fusedInputs.size(); v++ )
+    this->LoadFusedInput(v);
+  this->fusedTablesModified = 0;
+  }
+
 void vtkCUDA1DVolumeMapper::Deinitialize(int withData)
   {
-  this->vtkCUDAVolumeMapper::Deinitialize(withData);
   this->ReserveGPU();
-  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(this->GetStream());
+  this->UnloadBricks();
+  this->ResetFrameCache(0);
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadPyramid(this->RenderContext, this->GetStream());
+  this->pyramidFrame = -1;
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearFusedImageArray(this->RenderContext, -1, this->GetStream());
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadFusedTextures(this->RenderContext, this->GetStream());
+  if( this->copyStream ) this->GetRuntime()->StreamDestroy( this->copyStream );
+  this->copyStream = 0;
+  this->vtkCUDAVolumeMapper::Deinitialize(withData);
   }
 
 void vtkCUDA1DVolumeMapper::Reinitialize(int withData)
@@ -52,119 +119,908 @@ void vtkCUDA1DVolumeMapper::Reinitialize(int withData)
   this->vtkCUDAVolumeMapper::Reinitialize(withData);
   this->transferFunctionInfoHandler->ReplicateObject(this, withData);
   this->ReserveGPU();
-  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_initImageArray(this->GetStream());
-  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(0, this->GetStream());
+  if( !this->copyStream ) this->GetRuntime()->StreamCreate( &(this->copyStream) );
+  if( this->frameCache->GetNumberOfFrames() == 0 )
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_initImageArray(this->RenderContext, this->GetStream());
+  int slot = this->frameCache->Find( this->currentFrame );
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(this->RenderContext, slot == -1 ? 0 : slot, this->GetStream());
+  if( withData ) this->LoadPyramid( this->currentFrame );
+  this->fusedTablesModified = 0;
+  if( withData )
+    for( int v = 0; v < (int) this->fusedInputs.size(); v++ )
+      this->LoadFusedInput(v);
   }
 
 vtkCUDA1DVolumeMapper::~vtkCUDA1DVolumeMapper()
   {
+  this->RemoveAllFusedInputs();
   this->Deinitialize();
-  int tfLockReferenceCount = tfLock->GetReferenceCount() - 1;
-  tfLock->UnRegister( this );
-  if (tfLockReferenceCount == 0)
-    {
-    tfLock = 0;
-    }
+  this->transferFunctionInfoHandler->SetMacroCellGrid( 0 );
   this->transferFunctionInfoHandler->UnRegister( this );
+  for( std::map<int,char*>::iterator it = this->hostImages.begin(); it != this->hostImages.end(); it++ )
+    delete[] it->second;
+  for( std::map<int,cudaMacroCellGrid>::iterator it = this->macroCellGrids.begin(); it != this->macroCellGrids.end(); it++ )
+    CPU_vtkCUDAVolumeMapper_freeMacroCellGrid( it->second );
+  this->fusedTransform->UnRegister( this );
+  this->fusedViewToVoxels->UnRegister( this );
+  this->frameCache->UnRegister( this );
+  this->brickManager->UnRegister( this );
+  delete[] this->fusedColorTables;
+  delete[] this->fusedGAlphaTables;
+  }
+
+/** @brief The input of a volume being streamed to the device
+*
+*/
+typedef struct
+{
+  const char* Input;                            /**< The first voxel of the input */
+  int ScalarType;                               /**< The VTK scalar type of the input */
+  size_t SliceVoxels;                           /**< The number of voxels in a slice */
+  size_t SliceBytes;                            /**< The size in bytes of an input slice */
+  const cudaVolumePackingInformation* Packing;  /**< The format the voxels are packed into */
+  vtkCUDAHostThreadPool* Pool;                  /**< The threads doing the packing */
+} vtkCUDA1DVolumeMapperSlabSource;
+
+static bool vtkCUDA1DVolumeMapperFillSlab(void* slab, int firstSlice, int numberOfSlices, void* userData)
+  {
+  vtkCUDA1DVolumeMapperSlabSource* source = (vtkCUDA1DVolumeMapperSlabSource*) userData;
+  return CPU_vtkCUDAVolumeMapper_packImageParallel( source->Input + firstSlice * source->SliceBytes, source->ScalarType,
+                                                    numberOfSlices * source->SliceVoxels, *(source->Packing), slab, source->Pool );
+  }
+
+//gives a reference on a volume of the frame cache back, freeing it if no other mapper of the device shares it
+static void vtkCUDA1DVolumeMapperReleaseVolume(cudaDeviceVolume& volume)
+  {
+  if( !volume.Array ) return;
+  vtkCUDADeviceManager* manager = vtkCUDADeviceManager::Singleton();
+  if( manager->GetVolumeCache()->Release(volume) )
+    CUDA_vtkCUDAVolumeMapper_renderAlgo_freeVolume(manager->GetRuntime(), volume);
+  volume.Array = 0;
+  volume.Texture = 0;
+  volume.Uploaded = 0;
   }
 
 void vtkCUDA1DVolumeMapper::SetInputInternal(vtkImageData * input, int index)
   {
 
-  //convert data to float
+  //find the narrowest format holding every frame exactly, keeping 8 and 16-bit data at its native width
   const cudaVolumeInformation& VolumeInfo = this->VolumeInfoHandler->GetVolumeInfo();
-  float* buffer = new float[VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z];
-  if(input->GetScalarType() == VTK_CHAR)
+  size_t numberOfVoxels = (size_t) VolumeInfo.VolumeSize.x * (size_t) VolumeInfo.VolumeSize.y * (size_t) VolumeInfo.VolumeSize.z;
+  double range[2] = { input->GetScalarRange()[0], input->GetScalarRange()[1] };
+  for( std::map<int,vtkImageData*>::iterator it = this->inputImages.begin(); it != this->inputImages.end(); it++ )
     {
-    char* tempPtr = (char*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    double* frameRange = it->second->GetScalarRange();
+    range[0] = frameRange[0] < range[0] ? frameRange[0] : range[0];
+    range[1] = frameRange[1] > range[1] ? frameRange[1] : range[1];
     }
-  else if(input->GetScalarType() == VTK_UNSIGNED_CHAR)
+  cudaVolumePackingInformation packing;
+  if( !CPU_vtkCUDAVolumeMapper_choosePacking(input->GetScalarType(), range, packing) )
     {
-    unsigned char* tempPtr = (unsigned char*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    vtkErrorMacro(<<"Input cannot be of that type.");
+    return;
     }
-  else if(input->GetScalarType() == VTK_SIGNED_CHAR)
+
+  //the frames packed another way are packed again when next needed
+  bool repacked = packing.Format != this->volumePacking.Format || packing.Scale != this->volumePacking.Scale ||
+                  packing.Shift != this->volumePacking.Shift;
+  this->transferFunctionInfoHandler->SetVolumePacking(packing);
+  this->volumePacking = packing;
+  if( repacked )
     {
-    signed char* tempPtr = (signed char*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    for( std::map<int,char*>::iterator it = this->hostImages.begin(); it != this->hostImages.end(); it++ )
+      delete[] it->second;
+    this->hostImages.clear();
+    this->frameCacheFrameBytes = 0;
+    this->pyramidFrame = -1;
     }
-  else if(input->GetScalarType() == VTK_INT)
+
+  //keep the mip pyramid the volume information handler built for the frame, to be packed when the frame is rendered
+  this->pyramids[index] = this->VolumeInfoHandler->GetPyramid();
+  this->pyramidInfo = this->VolumeInfoHandler->GetPyramidInfo();
+  if( index == this->pyramidFrame ) this->pyramidFrame = -1;
+
+  //summarize the frame into macro cells, so the empty ones can be leapt over once the transfer function is known
+  CPU_vtkCUDAVolumeMapper_buildMacroCellGrid(input->GetScalarPointer(), input->GetScalarType(), VolumeInfo.VolumeSize,
+                                             packing, CPU_MACRO_CELL_SIZE, this->macroCellGrids[index], this->HostThreadPool);
+  if( index == (int) this->currentFrame )
     {
-    int* tempPtr = (int*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    this->transferFunctionInfoHandler->SetMacroCellGrid( &(this->macroCellGrids[index]) );
     }
-  else if(input->GetScalarType() == VTK_UNSIGNED_INT)
+
+  //free the previous copies of the frame, if any
+  std::map<int,char*>::iterator hostImage = this->hostImages.find(index);
+  if( hostImage != this->hostImages.end() )
     {
-    unsigned int* tempPtr = (unsigned int*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    delete[] hostImage->second;
+    this->hostImages.erase(hostImage);
     }
-  else if(input->GetScalarType() == VTK_SHORT)
+  //the device copy is held on to until the frame is loaded again if the data did not change, so it is not uploaded again
+  cudaDeviceVolume staleVolume = { 0, 0, 0, 0 };
+  int staleSlot = this->frameCache->Remove(index);
+  if( staleSlot != -1 )
     {
-    short* tempPtr = (short*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    if( vtkCUDADeviceManager::Singleton()->GetVolumeCache()->IsCopyOf(this->frameVolumes[staleSlot], input, input->GetMTime()) )
+      {
+      this->ReserveGPU();
+      CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(this->RenderContext, staleSlot, this->GetStream());
+      staleVolume = this->frameVolumes[staleSlot];
+      this->frameVolumes[staleSlot].Array = 0;
+      this->frameVolumes[staleSlot].Texture = 0;
+      this->frameVolumes[staleSlot].Uploaded = 0;
+      }
+    else
+      {
+      this->ClearFrameSlot(staleSlot);
+      }
     }
-  else if(input->GetScalarType() == VTK_UNSIGNED_SHORT)
+
+  //keep the data on the CPU when that is where we render
+  if( this->RenderBackend == CPU_BACKEND )
     {
-    unsigned short* tempPtr = (unsigned short*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    vtkCUDA1DVolumeMapperReleaseVolume(staleVolume);
+    this->GetHostFrame(index);
+    this->transferFunctionInfoHandler->SetInputData(input,index);
+    return;
     }
-  else if(input->GetScalarType() == VTK_LONG)
+
+  //a single frame larger than the budget is cut into bricks streamed as the rays ask for them, a low resolution copy of
+  //it being loaded as the frame until they arrive (the frames of a sequence are always loaded whole)
+  size_t frameBytes = numberOfVoxels * CPU_vtkCUDAVolumeMapper_packedVoxelSize(packing);
+  if( this->bricked ) this->UnloadBricks();
+  if( this->inputImages.size() == 1 && this->BrickingMode != BRICKING_OFF && !this->erroredOut )
     {
-    long* tempPtr = (long*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    this->ResetFrameCache(0);
+    if( this->BrickingMode == BRICKING_ON || (double) frameBytes > this->GetDeviceBudget() )
+      {
+      if( this->LoadBrickedInput(input) )
+        {
+        frameBytes = this->GetFrameBytes();
+        }
+      else
+        {
+        vtkErrorMacro(<< "The input cannot be bricked.");
+        this->erroredOut = true;
+        }
+      }
     }
-  else if(input->GetScalarType() == VTK_UNSIGNED_LONG)
+
+  //load data onto the GPU while there is room for it, the other frames being loaded when changed to or prefetched
+  if( frameBytes != this->frameCacheFrameBytes ) this->ResetFrameCache(frameBytes);
+  if( !this->erroredOut && (index == (int) this->currentFrame ||
+      this->frameCache->GetNumberOfFrames() < this->frameCache->GetCapacity()) )
     {
-    unsigned long* tempPtr = (unsigned long*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    int slot = this->LoadFrame(index, this->GetStream());
+    if( slot == -1 )
+      {
+      vtkErrorMacro(<< "Frame " << index << " cannot be loaded onto the device.");
+      this->erroredOut = true;
+      }
+    else if( index == (int) this->currentFrame )
+      {
+      this->erroredOut = !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(this->RenderContext, slot, this->GetStream());
+      this->LoadPyramid(index);
+      }
     }
-  else if(input->GetScalarType() == VTK_FLOAT)
+  vtkCUDA1DVolumeMapperReleaseVolume(staleVolume);
+
+  //inform transfer function handler of the data
+  this->transferFunctionInfoHandler->SetInputData(input,index);
+  }
+
+char* vtkCUDA1DVolumeMapper::GetHostFrame(int frame)
+  {
+  std::map<int,char*>::iterator hostImage = this->hostImages.find(frame);
+  if( hostImage != this->hostImages.end() ) return hostImage->second;
+  std::map<int,vtkImageData*>::iterator input = this->inputImages.find(frame);
+  if( input == this->inputImages.end() ) return 0;
+
+  const int3& size = this->VolumeInfoHandler->GetVolumeInfo().VolumeSize;
+  size_t numberOfVoxels = (size_t) size.x * (size_t) size.y * (size_t) size.z;
+  char* buffer = new char[numberOfVoxels * CPU_vtkCUDAVolumeMapper_packedVoxelSize(this->volumePacking)];
+  CPU_vtkCUDAVolumeMapper_packImageParallel(input->second->GetScalarPointer(), input->second->GetScalarType(), numberOfVoxels,
+                                            this->volumePacking, buffer, this->HostThreadPool);
+  this->hostImages[frame] = buffer;
+  return buffer;
+  }
+
+int vtkCUDA1DVolumeMapper::LoadFrame(int frame, cudaStream_t* stream)
+  {
+  std::map<int,vtkImageData*>::iterator input = this->inputImages.find(frame);
+  if( input == this->inputImages.end() ) return -1;
+
+  //the evicted frame's array is the one the slot gives back
+  int evictedFrame = -1;
+  int slot = this->frameCache->Insert(frame, this->currentFrame, evictedFrame);
+  if( slot == -1 ) return -1;
+  if( evictedFrame != -1 ) vtkDebugMacro(<< "Frame " << evictedFrame << " evicted for frame " << frame);
+
+  //pack the data slab by slab while the previous slabs are copied
+  cudaVolumeInformation volumeInfo = this->VolumeInfoHandler->GetVolumeInfo();
+  vtkCUDA1DVolumeMapperSlabSource source;
+  source.Input = (const char*) input->second->GetScalarPointer();
+  source.ScalarType = input->second->GetScalarType();
+  source.Packing = &(this->volumePacking);
+  source.Pool = this->HostThreadPool;
+
+  //a bricked input loads its low resolution copy instead, which is already packed
+  cudaVolumePackingInformation packedAsIs = this->volumePacking;
+  if( this->bricked )
     {
-    delete buffer;
-    buffer = (float*) input->GetScalarPointer();
+    const int F = this->coarseFactor;
+    volumeInfo.VolumeSize.x = (volumeInfo.VolumeSize.x + F - 1) / F;
+    volumeInfo.VolumeSize.y = (volumeInfo.VolumeSize.y + F - 1) / F;
+    volumeInfo.VolumeSize.z = (volumeInfo.VolumeSize.z + F - 1) / F;
+    packedAsIs.Shift = 0.0f;
+    source.Input = this->coarseImage;
+    source.ScalarType = (packedAsIs.Format == CUDA_PACKED_UNSIGNED_CHAR) ? VTK_UNSIGNED_CHAR :
+                        (packedAsIs.Format == CUDA_PACKED_UNSIGNED_SHORT) ? VTK_UNSIGNED_SHORT : VTK_FLOAT;
+    source.Packing = &packedAsIs;
     }
-  else if(input->GetScalarType() == VTK_DOUBLE)
+  const int3& size = volumeInfo.VolumeSize;
+  source.SliceVoxels = (size_t) size.x * (size_t) size.y;
+  source.SliceBytes = source.SliceVoxels * CPU_vtkCUDAVolumeMapper_scalarSize(source.ScalarType);
+
+  //share the copy another mapper of the device holds, uploading the frame only when no mapper does
+  this->ClearFrameSlot(slot);
+  vtkCUDAVolumeCache* volumeCache = vtkCUDADeviceManager::Singleton()->GetVolumeCache();
+  vtkCUDAVolumeCache::Key key;
+  key.Image = input->second;
+  key.MTime = input->second->GetMTime();
+  key.Device = this->GetDevice();
+  key.Format = this->volumePacking.Format;
+  key.Scale = this->volumePacking.Scale;
+  key.Shift = this->volumePacking.Shift;
+  key.Size[0] = size.x;
+  key.Size[1] = size.y;
+  key.Size[2] = size.z;
+  cudaDeviceVolume volume;
+  if( !volumeCache->Acquire(key, volume) )
     {
-    double* tempPtr = (double*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    if( !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageInfo(this->RenderContext, volume, vtkCUDA1DVolumeMapperFillSlab,
+                                                              &source, this->volumePacking, volumeInfo, stream) )
+      {
+      this->frameCache->Remove(frame);
+      return -1;
+      }
+
+    //another mapper may have uploaded the same copy in the meantime, in which case this one is freed for it
+    cudaDeviceVolume uploaded = volume;
+    if( !volumeCache->Add(key, volume) ) CUDA_vtkCUDAVolumeMapper_renderAlgo_freeVolume(this->GetRuntime(), uploaded);
     }
-  else
+  this->frameVolumes[slot] = volume;
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_setImageArray(this->RenderContext, slot, volume);
+  return slot;
+  }
+
+void vtkCUDA1DVolumeMapper::PrefetchFrames()
+  {
+  if( this->RenderBackend != CUDA_BACKEND || this->erroredOut || this->inputImages.size() < 2 ) return;
+
+  //never prefetch so far ahead that the coming frames evict each other or the current one
+  int count = this->NumberOfPrefetchedFrames;
+  if( count > this->frameCache->GetCapacity() - 1 ) count = this->frameCache->GetCapacity() - 1;
+  if( count > (int) this->inputImages.size() - 1 ) count = (int) this->inputImages.size() - 1;
+
+  //the frames follow each other in increasing order, the playback looping back to the first, their copies running on the
+  //copy stream behind the render until the render stream waits on them when it changes to the frame
+  std::map<int,vtkImageData*>::iterator next = this->inputImages.upper_bound( this->currentFrame );
+  for( int i = 0; i < count; i++, next++ )
     {
-    vtkErrorMacro(<<"Input cannot be of that type.");
+    if( next == this->inputImages.end() ) next = this->inputImages.begin();
+    if( this->frameCache->Find(next->first) != -1 ) continue;
+    if( this->LoadFrame(next->first, &(this->copyStream)) == -1 ) break;
+    }
+  }
+
+void vtkCUDA1DVolumeMapper::ResetFrameCache(size_t frameBytes)
+  {
+  if( this->frameCache->GetNumberOfFrames() > 0 ) this->ClearFrameSlot(-1);
+  this->frameCacheFrameBytes = frameBytes;
+  if( frameBytes == 0 )
+    {
+    this->frameCache->Clear();
     return;
     }
 
-  //load data onto the GPU and clean up the CPU
-  if(!this->erroredOut)
+  this->frameCache->SetCapacity( (int) (this->GetDeviceBudget() / (double) frameBytes) );
+  vtkDebugMacro(<< "Frame cache holds " << this->frameCache->GetCapacity() << " frames of " << frameBytes << " bytes");
+  }
+
+void vtkCUDA1DVolumeMapper::ClearFrameSlot(int slot)
+  {
+  this->ReserveGPU();
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(this->RenderContext, slot, this->GetStream());
+  for( int i = 0; i < CUDA_MAX_CACHED_FRAMES; i++ )
+    if( slot < 0 || i == slot ) vtkCUDA1DVolumeMapperReleaseVolume(this->frameVolumes[i]);
+  }
+
+double vtkCUDA1DVolumeMapper::GetDeviceBudget()
+  {
+  //without a budget, take half of what the device has left once the frames are freed
+  double budget = this->FrameCacheBudget * 1048576.0;
+  if( budget <= 0.0 )
     {
+    size_t freeBytes = 0;
+    size_t totalBytes = 0;
     this->ReserveGPU();
-    this->erroredOut = !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageInfo( buffer, VolumeInfoHandler->GetVolumeInfo(), this->GetStream());
+    if( this->GetRuntime()->MemGetInfo(&freeBytes, &totalBytes) == cudaSuccess ) budget = 0.5 * (double) freeBytes;
     }
-  if(input->GetScalarType() != VTK_FLOAT) delete buffer;
+  return budget;
+  }
 
-  //inform transfer function handler of the data
-  this->transferFunctionInfoHandler->SetInputData(input,index);
+size_t vtkCUDA1DVolumeMapper::GetFrameBytes()
+  {
+  int3 size = this->VolumeInfoHandler->GetVolumeInfo().VolumeSize;
+  if( this->bricked )
+    {
+    size.x = (size.x + this->coarseFactor - 1) / this->coarseFactor;
+    size.y = (size.y + this->coarseFactor - 1) / this->coarseFactor;
+    size.z = (size.z + this->coarseFactor - 1) / this->coarseFactor;
+    }
+  return (size_t) size.x * (size_t) size.y * (size_t) size.z * CPU_vtkCUDAVolumeMapper_packedVoxelSize(this->volumePacking);
+  }
+
+bool vtkCUDA1DVolumeMapper::LoadBrickedInput(vtkImageData* input)
+  {
+  this->UnloadBricks();
+  const int3& size = this->VolumeInfoHandler->GetVolumeInfo().VolumeSize;
+  const size_t voxelSize = CPU_vtkCUDAVolumeMapper_packedVoxelSize(this->volumePacking);
+  const double budget = this->GetDeviceBudget();
+
+  //the low resolution copy takes at most an eighth of the budget, the pool of bricks the rest
+  int F = 2;
+  while( F < 1024 && (double) ((size.x + F - 1) / F) * (double) ((size.y + F - 1) / F) * (double) ((size.z + F - 1) / F) *
+         (double) voxelSize > budget / 8.0 )
+    F *= 2;
+  const int3 coarseSize = make_int3( (size.x + F - 1) / F, (size.y + F - 1) / F, (size.z + F - 1) / F );
+  const size_t coarseBytes = (size_t) coarseSize.x * (size_t) coarseSize.y * (size_t) coarseSize.z * voxelSize;
+  this->coarseImage = new char[coarseBytes];
+  if( !CPU_vtkCUDAVolumeMapper_downsampleImage(input->GetScalarPointer(), input->GetScalarType(), size, F, CUDA_PYRAMID_MEAN,
+                                               this->volumePacking, this->coarseImage, this->HostThreadPool) )
+    {
+    this->UnloadBricks();
+    return false;
+    }
+
+  //lay out the pool, every brick starting missing
+  const int slotSize = CUDA_BRICK_SIZE + 2 * CUDA_BRICK_APRON;
+  const double brickBytes = (double) slotSize * (double) slotSize * (double) slotSize * (double) voxelSize;
+  const int volumeSize[3] = { size.x, size.y, size.z };
+  this->brickManager->Initialize( volumeSize, CUDA_BRICK_SIZE, (int) ((budget - (double) coarseBytes) / brickBytes) );
+  this->brickManager->ResetStatistics();
+  int poolSize[3];
+  int gridSize[3];
+  this->brickManager->GetPoolSize(poolSize);
+  this->brickManager->GetGridSize(gridSize);
+  this->brickRequestsPending = false;
+
+  this->ReserveGPU();
+  if( !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadBrickPool(this->RenderContext, make_int3(poolSize[0], poolSize[1], poolSize[2]),
+                                                            make_int3(gridSize[0], gridSize[1], gridSize[2]),
+                                                            CUDA_BRICK_SIZE, 1.0f / (float) F, this->volumePacking,
+                                                            this->GetStream()) )
+    {
+    this->UnloadBricks();
+    return false;
+    }
+  this->coarseFactor = F;
+  this->bricked = true;
+  vtkDebugMacro(<< "Input bricked into " << this->brickManager->GetNumberOfBricks() << " bricks, "
+                << this->brickManager->GetNumberOfSlots() << " held at once over a copy reduced " << F << " times");
+  return true;
+  }
+
+void vtkCUDA1DVolumeMapper::UnloadBricks()
+  {
+  if( this->bricked || this->coarseImage )
+    {
+    this->ReserveGPU();
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadBrickPool(this->RenderContext, this->GetStream());
+    }
+  delete[] this->coarseImage;
+  this->coarseImage = 0;
+  this->coarseFactor = 1;
+  this->brickRequestsPending = false;
+  if( this->bricked )
+    {
+    //the low resolution copy is not the frame anymore
+    this->bricked = false;
+    this->ResetFrameCache(0);
+    }
+  }
+
+void vtkCUDA1DVolumeMapper::UpdateBricks()
+  {
+  if( !this->bricked || this->erroredOut ) return;
+
+  //the bricks the rays sampled during the render before this one, read back behind it, are those to hold for the next one,
+  //so the host never waits for the render just queued
+  std::vector<int> bricks;
+  std::vector<int> slots;
+  this->ReserveGPU();
+  const unsigned char* requests = this->brickRequestsPending ?
+                                  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_takeBrickRequests(this->RenderContext) : 0;
+  if( requests ) this->brickManager->Update( requests, this->MaximumNumberOfBrickLoads, bricks, slots );
+
+  //the requests of this render are read back in their place, once they have been taken
+  this->brickRequestsPending = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_readBrickRequests(this->RenderContext, this->GetStream());
+  if( bricks.empty() ) return;
+
+  //pack the bricks straight from the input, so a memory mapped input only pages in what the rays reach
+  vtkImageData* input = this->inputImages[0];
+  const int3& size = this->VolumeInfoHandler->GetVolumeInfo().VolumeSize;
+  const int slotSize = CUDA_BRICK_SIZE + 2 * CUDA_BRICK_APRON;
+  const size_t brickBytes = (size_t) slotSize * (size_t) slotSize * (size_t) slotSize *
+                            CPU_vtkCUDAVolumeMapper_packedVoxelSize(this->volumePacking);
+  char* staging = (char*) CUDA_vtkCUDA1DVolumeMapper_renderAlgo_reserveBrickStaging(this->RenderContext, (int) bricks.size());
+  if( !staging )
+    {
+    for( size_t i = 0; i < bricks.size(); i++ )
+      this->brickManager->Evict( bricks[i] );
+    vtkWarningMacro(<< bricks.size() << " bricks could not be staged for the device.");
+    return;
+    }
+  std::vector<int> origins( 3 * bricks.size() );
+  for( size_t i = 0; i < bricks.size(); i++ )
+    {
+    int index[3];
+    this->brickManager->GetBrickIndex( bricks[i], index );
+    this->brickManager->GetSlotOrigin( slots[i], &(origins[3*i]) );
+    CPU_vtkCUDAVolumeMapper_packBrick( input->GetScalarPointer(), input->GetScalarType(), size,
+                                       make_int3(index[0], index[1], index[2]), CUDA_BRICK_SIZE, this->volumePacking,
+                                       staging + i * brickBytes );
+    }
+
+  //the bricks are copied on the copy stream, the render stream taking the page table showing them once they are there
+  if( !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadBricks(this->RenderContext, (int) bricks.size(), &(origins[0]),
+                                                         &(this->copyStream) ) )
+    {
+    for( size_t i = 0; i < bricks.size(); i++ )
+      this->brickManager->Evict( bricks[i] );
+    vtkWarningMacro(<< bricks.size() << " bricks could not be streamed to the device.");
+    }
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadPageTable(this->RenderContext, this->brickManager->GetPageTable(), this->GetStream() );
+
+  //the image changes as the bricks arrive, so the progressive passes start over
+  this->Modified();
+  }
+
+void vtkCUDA1DVolumeMapper::SetBrickingMode(int mode)
+  {
+  mode = (mode < BRICKING_AUTO || mode > BRICKING_ON) ? BRICKING_AUTO : mode;
+  if( mode == this->BrickingMode ) return;
+  this->BrickingMode = mode;
+
+  //the input is loaded again, whole or bricked
+  std::map<int,vtkImageData*>::iterator input = this->inputImages.find(0);
+  if( input != this->inputImages.end() && this->RenderBackend == CUDA_BACKEND && !this->slabInputs )
+    {
+    this->SetInputInternal( input->second, 0 );
+    this->ChangeFrameInternal( this->currentFrame );
+    }
+  this->Modified();
+  }
+
+void vtkCUDA1DVolumeMapper::SetMaximumNumberOfBrickLoads(int bricks)
+  {
+  bricks = bricks < 1 ? 1 : bricks;
+  if( bricks == this->MaximumNumberOfBrickLoads ) return;
+  this->MaximumNumberOfBrickLoads = bricks;
+  this->Modified();
+  }
+
+void vtkCUDA1DVolumeMapper::LoadPyramid(int frame)
+  {
+  if( this->RenderBackend != CUDA_BACKEND || frame == this->pyramidFrame ) return;
+
+  //a bricked input samples its bricks, and a frame without levels its voxels only
+  std::map<int, std::vector<float> >::iterator levels = this->pyramids.find(frame);
+  this->ReserveGPU();
+  if( this->bricked || this->erroredOut || this->slabInputs || levels == this->pyramids.end() || levels->second.empty() ||
+      this->pyramidInfo.NumberOfLevels < 1 )
+    {
+    if( this->pyramidFrame != -1 ) CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadPyramid(this->RenderContext, this->GetStream());
+    this->pyramidFrame = -1;
+    return;
+    }
+
+  //pack the levels as the frames are packed, so they are read in the same units
+  const std::vector<float>& voxels = levels->second;
+  this->pyramidBuffer.resize( voxels.size() * CPU_vtkCUDAVolumeMapper_packedVoxelSize(this->volumePacking) );
+  CPU_vtkCUDAVolumeMapper_packImageParallel( &(voxels[0]), VTK_FLOAT, voxels.size(), this->volumePacking,
+                                             &(this->pyramidBuffer[0]), this->HostThreadPool );
+  if( !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadPyramid(this->RenderContext, this->pyramidInfo, &(this->pyramidBuffer[0]),
+                                                          this->volumePacking, this->GetStream() ) )
+    {
+    vtkWarningMacro(<< "The mip pyramid of frame " << frame << " cannot be loaded, the frame being sampled at full resolution.");
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadPyramid(this->RenderContext, this->GetStream());
+    this->pyramidFrame = -1;
+    return;
+    }
+  this->pyramidFrame = frame;
+  }
+
+void vtkCUDA1DVolumeMapper::UpdatePyramids()
+  {
+  //the handler only builds a pyramid when image data is set, the current frame being set last so it stays the handler's
+  this->pyramids.clear();
+  std::map<int,vtkImageData*>::iterator current = this->inputImages.find( this->currentFrame );
+  for( std::map<int,vtkImageData*>::iterator it = this->inputImages.begin(); it != this->inputImages.end(); it++ )
+    {
+    if( it == current ) continue;
+    this->VolumeInfoHandler->SetInputData( NULL, it->first );
+    this->VolumeInfoHandler->SetInputData( it->second, it->first );
+    this->pyramids[it->first] = this->VolumeInfoHandler->GetPyramid();
+    }
+  if( current != this->inputImages.end() )
+    {
+    this->VolumeInfoHandler->SetInputData( NULL, current->first );
+    this->VolumeInfoHandler->SetInputData( current->second, current->first );
+    this->pyramids[current->first] = this->VolumeInfoHandler->GetPyramid();
+    }
+  this->pyramidInfo = this->VolumeInfoHandler->GetPyramidInfo();
+
+  //the current frame's pyramid replaces the one loaded
+  if( this->pyramidFrame != -1 && this->RenderBackend == CUDA_BACKEND )
+    {
+    this->ReserveGPU();
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_unloadPyramid(this->RenderContext, this->GetStream());
+    }
+  this->pyramidFrame = -1;
+  this->LoadPyramid( this->currentFrame );
+  this->Modified();
+  }
+
+void vtkCUDA1DVolumeMapper::SetNumberOfPyramidLevels(int levels)
+  {
+  levels = (levels < 0) ? 0 : ((levels > CUDA_MAX_PYRAMID_LEVELS) ? CUDA_MAX_PYRAMID_LEVELS : levels);
+  if( levels == this->VolumeInfoHandler->GetNumberOfPyramidLevels() ) return;
+  this->VolumeInfoHandler->SetPyramid( levels, this->VolumeInfoHandler->GetPyramidReduction() );
+  this->UpdatePyramids();
+  }
+
+int vtkCUDA1DVolumeMapper::GetNumberOfPyramidLevels() const
+  {
+  return this->VolumeInfoHandler->GetNumberOfPyramidLevels();
+  }
+
+void vtkCUDA1DVolumeMapper::SetPyramidReduction(int reduction)
+  {
+  reduction = (reduction != MAX_REDUCTION && reduction != MIN_REDUCTION) ? MEAN_REDUCTION : reduction;
+  if( reduction == this->VolumeInfoHandler->GetPyramidReduction() ) return;
+  this->VolumeInfoHandler->SetPyramid( this->VolumeInfoHandler->GetNumberOfPyramidLevels(), reduction );
+  if( this->VolumeInfoHandler->GetNumberOfPyramidLevels() > 0 ) this->UpdatePyramids();
+  }
+
+int vtkCUDA1DVolumeMapper::GetPyramidReduction() const
+  {
+  return this->VolumeInfoHandler->GetPyramidReduction();
+  }
+
+bool vtkCUDA1DVolumeMapper::CanRenderTiles()
+  {
+  return !this->bricked && this->fusedInputs.empty();
+  }
+
+bool vtkCUDA1DVolumeMapper::CanRenderSlabs()
+  {
+  return this->fusedInputs.empty();
+  }
+
+void vtkCUDA1DVolumeMapper::CopyTileSettings(vtkCUDAVolumeMapper* tileMapper)
+  {
+  this->Superclass::CopyTileSettings(tileMapper);
+  vtkCUDA1DVolumeMapper* tile1DMapper = vtkCUDA1DVolumeMapper::SafeDownCast(tileMapper);
+  if( !tile1DMapper ) return;
+
+  //the bands replicate an input that is not bricked here, while the slabs are bricked as this mapper would brick the volume
+  tile1DMapper->SetBrickingMode( this->slabInputs ? this->BrickingMode : BRICKING_OFF );
+  tile1DMapper->SetFrameCacheBudget( this->FrameCacheBudget );
+  tile1DMapper->SetNumberOfPrefetchedFrames( this->NumberOfPrefetchedFrames );
+  tile1DMapper->SetPyramidReduction( this->GetPyramidReduction() );
+  tile1DMapper->SetNumberOfPyramidLevels( this->GetNumberOfPyramidLevels() );
+  tile1DMapper->SetUseSpecializedKernels( this->UseSpecializedKernels );
+  tile1DMapper->SetPreIntegration( this->GetPreIntegration() );
+  if( tile1DMapper->currentFrame != this->currentFrame ) tile1DMapper->ChangeFrame( this->currentFrame );
+  }
+
+unsigned long vtkCUDA1DVolumeMapper::GetRenderedDataMTime()
+  {
+  unsigned long modified = this->Superclass::GetRenderedDataMTime();
+  for( size_t v = 0; v < this->fusedInputs.size(); v++ )
+    {
+    const FusedInput& fused = this->fusedInputs[v];
+    if( fused.Image->GetMTime() > modified ) modified = fused.Image->GetMTime();
+    if( fused.Property->GetMTime() > modified ) modified = fused.Property->GetMTime();
+    if( fused.UserMatrix && fused.UserMatrix->GetMTime() > modified ) modified = fused.UserMatrix->GetMTime();
+    }
+  return modified;
+  }
+
+void vtkCUDA1DVolumeMapper::SetUseSpecializedKernels(bool specialized)
+  {
+  if( specialized == this->UseSpecializedKernels ) return;
+  this->UseSpecializedKernels = specialized;
+  this->Modified();
+  }
+
+void vtkCUDA1DVolumeMapper::SetPreIntegration(bool preIntegration)
+  {
+  if( preIntegration == this->transferFunctionInfoHandler->GetPreIntegration() ) return;
+  this->transferFunctionInfoHandler->SetPreIntegration( preIntegration );
+  this->Modified();
+  }
+
+bool vtkCUDA1DVolumeMapper::GetPreIntegration() const
+  {
+  return this->transferFunctionInfoHandler->GetPreIntegration();
+  }
+
+int vtkCUDA1DVolumeMapper::ChooseKernelVariant(const cudaRendererInformation& rendererInfo,
+                                               const cudaVolumeInformation& volumeInfo,
+                                               const cuda1DTransferFunctionInformation& transInfo)
+  {
+  //the fused volumes are composited by the general kernel alone, classifying points
+  if( !this->fusedInputs.empty() ) return CUDA_VARIANT_GENERAL;
+
+  //the segments are classified from the pre-integrated table whenever one was built, by the general kernels as well
+  int variant = (transInfo.preIntegratedSize > 0) ? CUDA_VARIANT_PREINTEGRATED : 0;
+  if( !this->UseSpecializedKernels ) return variant | CUDA_VARIANT_GENERAL;
+
+  //an unshaded volume keeps the neutral constants, which leave the colour looked up as it is
+  if( volumeInfo.Ambient != 1.0f || volumeInfo.Diffuse != 0.0f || volumeInfo.Specular.x != 0.0f )
+    variant |= CUDA_VARIANT_SHADED;
+
+  //the multiplier of a gradient opacity function that is 1 throughout, or has no range, is infinite
+  const float gradientMultiplier = transInfo.gradientMultiplier;
+  if( (gradientMultiplier - gradientMultiplier) == 0.0f )
+    variant |= CUDA_VARIANT_GRADIENT_OPACITY;
+
+  if( rendererInfo.NumberOfClippingPlanes > 0 )
+    variant |= CUDA_VARIANT_CLIPPED;
+
+  //a parallel projection leaves the last row of the view to voxels matrix exactly (0, 0, 0, 1), as the rays are formed
+  //the same with or without the perspective division only then
+  const float* m = rendererInfo.ViewToVoxelsMatrix;
+  if( m[12] != 0.0f || m[13] != 0.0f || m[14] != 0.0f || m[15] != 1.0f )
+    variant |= CUDA_VARIANT_PERSPECTIVE;
+  return variant;
+  }
+
+bool vtkCUDA1DVolumeMapper::IsRefining()
+  {
+  return this->vtkCUDAVolumeMapper::IsRefining() ||
+         (this->bricked && this->brickManager->GetNumberOfMissingBricks() > 0);
+  }
+
+void vtkCUDA1DVolumeMapper::SetFrameCacheBudget(double megabytes)
+  {
+  megabytes = megabytes < 0.0 ? 0.0 : megabytes;
+  if( megabytes == this->FrameCacheBudget ) return;
+  this->FrameCacheBudget = megabytes;
+
+  //the frames are loaded again into the new number of slots, starting with the current one
+  if( this->frameCacheFrameBytes > 0 && this->RenderBackend == CUDA_BACKEND )
+    {
+    this->ResetFrameCache( this->frameCacheFrameBytes );
+    this->ChangeFrameInternal( this->currentFrame );
+    }
+  this->Modified();
+  }
+
+void vtkCUDA1DVolumeMapper::SetNumberOfPrefetchedFrames(int frames)
+  {
+  frames = frames < 0 ? 0 : frames;
+  if( frames == this->NumberOfPrefetchedFrames ) return;
+  this->NumberOfPrefetchedFrames = frames;
+  this->Modified();
   }
 
 void vtkCUDA1DVolumeMapper::ChangeFrameInternal(unsigned int frame){
+  this->currentFrame = frame;
+  std::map<int,cudaMacroCellGrid>::iterator grid = this->macroCellGrids.find(frame);
+  this->transferFunctionInfoHandler->SetMacroCellGrid( grid != this->macroCellGrids.end() ? &(grid->second) : 0 );
+  if(!this->erroredOut && !this->slabInputs && this->RenderBackend == CUDA_BACKEND && this->inputImages.count(frame) == 1)
+    {
+    //a frame held on the device only needs its texture rebound, any other is loaded first (unless the slabs hold it)
+    if( this->frameCacheFrameBytes == 0 ) this->ResetFrameCache( this->GetFrameBytes() );
+    int slot = this->frameCache->Lookup(frame);
+    if( slot == -1 ) slot = this->LoadFrame(frame, this->GetStream());
+    if( slot == -1 )
+      {
+      vtkErrorMacro(<< "Frame " << frame << " cannot be loaded onto the device.");
+      this->erroredOut = true;
+      return;
+      }
+    this->ReserveGPU();
+    this->erroredOut = !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(this->RenderContext, slot, this->GetStream());
+    this->LoadPyramid(frame);
+    }
+  }
+
+int vtkCUDA1DVolumeMapper::AddFusedInput(vtkImageData* image, vtkVolumeProperty* property, vtkMatrix4x4* userMatrix)
+  {
+  if( !image || !property )
+    {
+    vtkErrorMacro(<< "A fused volume needs both image data and a volume property.");
+    return -1;
+    }
+  if( (int) this->fusedInputs.size() >= CUDA_MAX_FUSED_VOLUMES )
+    {
+    vtkErrorMacro(<< "Cannot fuse more than " << CUDA_MAX_FUSED_VOLUMES << " volumes with the input.");
+    return -1;
+    }
+
+  FusedInput fused;
+  fused.Image = image;
+  fused.Property = property;
+  fused.UserMatrix = userMatrix;
+  fused.HostImage = 0;
+  image->Register( this );
+  property->Register( this );
+  if( userMatrix ) userMatrix->Register( this );
+
+  //the lookup tables are built on the host, and loaded for all the fused volumes at once
+  fused.TransferFunctionInfoHandler = vtkCUDA1DTransferFunctionInformationHandler::New();
+  fused.TransferFunctionInfoHandler->ReplicateObject( this );
+  fused.TransferFunctionInfoHandler->SetHostRendering( true );
+  fused.TransferFunctionInfoHandler->SetInputData( image, 0 );
+
+  int volume = (int) this->fusedInputs.size();
+  this->fusedInputs.push_back( fused );
+  this->LoadFusedInput( volume );
+  this->fusedTablesModified = 0;
+  this->Modified();
+  return volume;
+  }
+
+void vtkCUDA1DVolumeMapper::RemoveAllFusedInputs()
+  {
+  if( this->fusedInputs.empty() ) return;
+  for( std::vector<FusedInput>::iterator it = this->fusedInputs.begin(); it != this->fusedInputs.end(); it++ )
+    {
+    it->Image->UnRegister( this );
+    it->Property->UnRegister( this );
+    if( it->UserMatrix ) it->UserMatrix->UnRegister( this );
+    it->TransferFunctionInfoHandler->UnRegister( this );
+    delete[] it->HostImage;
+    }
+  this->fusedInputs.clear();
+  this->VolumeInfoHandler->SetNumberOfFusedVolumes( 0 );
+
+  this->ReserveGPU();
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearFusedImageArray(this->RenderContext, -1, this->GetStream());
+  this->Modified();
+  }
+
+void vtkCUDA1DVolumeMapper::LoadFusedInput(int volume)
+  {
+  FusedInput& fused = this->fusedInputs[volume];
+  delete[] fused.HostImage;
+  fused.HostImage = 0;
+
+  //fused volumes are always stored as floats, so their values are read as they are
+  vtkImageData* input = fused.Image;
+  this->VolumeInfoHandler->SetFusedInputData( volume, input );
+  const int3& size = this->VolumeInfoHandler->GetVolumeInfo().FusedVolumeSize[volume];
+  size_t numberOfVoxels = (size_t) size.x * (size_t) size.y * (size_t) size.z;
+  cudaVolumePackingInformation packing;
+  packing.Format = CUDA_PACKED_FLOAT;
+  packing.Scale = 1.0f;
+  packing.Shift = 0.0f;
+
+  //keep the data on the CPU when that is where we render
+  if( this->RenderBackend == CPU_BACKEND )
+    {
+    fused.HostImage = new float[numberOfVoxels];
+    if( !CPU_vtkCUDAVolumeMapper_packImageParallel(input->GetScalarPointer(), input->GetScalarType(), numberOfVoxels,
+                                                   packing, fused.HostImage, this->HostThreadPool) )
+      vtkErrorMacro(<<"Fused input cannot be of that type.");
+    return;
+    }
+
+  //load data onto the GPU, packing it slab by slab while the previous slabs are copied
   if(!this->erroredOut)
     {
+    vtkCUDA1DVolumeMapperSlabSource source;
+    source.Input = (const char*) input->GetScalarPointer();
+    source.ScalarType = input->GetScalarType();
+    source.SliceVoxels = (size_t) size.x * (size_t) size.y;
+    source.SliceBytes = source.SliceVoxels * CPU_vtkCUDAVolumeMapper_scalarSize(source.ScalarType);
+    source.Packing = &packing;
+    source.Pool = this->HostThreadPool;
+
     this->ReserveGPU();
-    this->erroredOut = !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(frame, this->GetStream());
+    this->erroredOut = !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadFusedImageInfo(this->RenderContext, volume,
+                                                                                 vtkCUDA1DVolumeMapperFillSlab, &source,
+                                                                                 size, this->GetStream());
     }
   }
 
+void vtkCUDA1DVolumeMapper::UpdateFusedInputs(vtkVolume* vol, cuda1DTransferFunctionInformation& transInfo)
+  {
+  const int numberOfFused = (int) this->fusedInputs.size();
+  this->VolumeInfoHandler->SetNumberOfFusedVolumes( numberOfFused );
+  if( numberOfFused == 0 ) return;
+
+  unsigned long tablesModified = 1;
+  for( int v = 0; v < numberOfFused; v++ )
+    {
+    FusedInput& fused = this->fusedInputs[v];
+
+    //handle the transfer function changes, folding the ranges of the fused lookup tables into those of the input
+    vtkCUDA1DTransferFunctionInformationHandler* handler = fused.TransferFunctionInfoHandler;
+    handler->SetColourTransferFunction( fused.Property->GetRGBTransferFunction() );
+    handler->SetOpacityTransferFunction( fused.Property->GetScalarOpacity() );
+    handler->SetGradientOpacityTransferFunction( fused.Property->GetGradientOpacity() );
+    handler->UseGradientOpacity( !fused.Property->GetDisableGradientOpacity() );
+    handler->Update();
+    const cuda1DTransferFunctionInformation& fusedInfo = handler->GetTransferFunctionInfo();
+    transInfo.fusedIntensityLow[v] = fusedInfo.intensityLow;
+    transInfo.fusedIntensityMultiplier[v] = fusedInfo.intensityMultiplier;
+    transInfo.fusedGradientLow[v] = fusedInfo.gradientLow;
+    transInfo.fusedGradientMultiplier[v] = fusedInfo.gradientMultiplier;
+    if( fused.Property->GetMTime() > tablesModified ) tablesModified = fused.Property->GetMTime();
+
+    //the voxels of the fused volume map to the world through its own matrix, or the rendered volume's when co-registered
+    vtkImageData* img = fused.Image;
+    double inputOrigin[3];
+    double inputSpacing[3];
+    int inputExtent[6];
+    img->GetOrigin(inputOrigin);
+    img->GetSpacing(inputSpacing);
+    img->GetExtent(inputExtent);
+    vtkMatrix4x4* userMatrix = fused.UserMatrix ? fused.UserMatrix : vol->GetUserMatrix();
+    this->fusedTransform->Identity();
+    this->fusedTransform->PreMultiply();
+    this->fusedTransform->Concatenate( this->PerspectiveTransform->GetMatrix() );
+    if( userMatrix ) this->fusedTransform->Concatenate( userMatrix );
+    this->fusedTransform->Translate( inputOrigin[0] + inputExtent[0]*inputSpacing[0],
+                                     inputOrigin[1] + inputExtent[2]*inputSpacing[1],
+                                     inputOrigin[2] + inputExtent[4]*inputSpacing[2] );
+    this->fusedTransform->Scale( inputSpacing[0], inputSpacing[1], inputSpacing[2] );
+    this->fusedViewToVoxels->DeepCopy( this->fusedTransform->GetMatrix() );
+    this->fusedViewToVoxels->Invert();
+    this->RendererInfoHandler->SetFusedViewToVoxelsMatrix( v, this->fusedViewToVoxels );
+    }
+
+  //interleave the lookup tables into one row per slot, and load them only when a property changed
+  if( tablesModified == this->fusedTablesModified && this->fusedTableSize == transInfo.functionSize ) return;
+  this->fusedTablesModified = tablesModified;
+  const unsigned int size = transInfo.functionSize;
+  if( size != this->fusedTableSize )
+    {
+    delete[] this->fusedColorTables;
+    delete[] this->fusedGAlphaTables;
+    this->fusedColorTables = new float[4 * size * CUDA_MAX_FUSED_VOLUMES];
+    this->fusedGAlphaTables = new float[size * CUDA_MAX_FUSED_VOLUMES];
+    memset( this->fusedColorTables, 0, sizeof(float) * 4 * size * CUDA_MAX_FUSED_VOLUMES );
+    memset( this->fusedGAlphaTables, 0, sizeof(float) * size * CUDA_MAX_FUSED_VOLUMES );
+    this->fusedTableSize = size;
+    }
+
+  //every handler builds tables of the same size, so the rows line up with the input's
+  for( int v = 0; v < numberOfFused; v++ )
+    {
+    const vtkCUDA1DTransferFunctionInformationHandler* handler = this->fusedInputs[v].TransferFunctionInfoHandler;
+    float* colorRow = this->fusedColorTables + 4 * v * size;
+    float* galphaRow = this->fusedGAlphaTables + v * size;
+    for( unsigned int i = 0; i < size; i++ )
+      {
+      colorRow[4*i] = handler->GetColorRedTransferFunction()[i];
+      colorRow[4*i+1] = handler->GetColorGreenTransferFunction()[i];
+      colorRow[4*i+2] = handler->GetColorBlueTransferFunction()[i];
+      colorRow[4*i+3] = handler->GetAlphaTransferFunction()[i];
+      galphaRow[i] = handler->GetGAlphaTransferFunction()[i];
+      }
+    }
+  if( this->RenderBackend == CPU_BACKEND || this->erroredOut ) return;
+  this->ReserveGPU();
+  this->erroredOut = !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadFusedTextures(this->RenderContext, this->fusedColorTables,
+                                                                               this->fusedGAlphaTables, size, this->GetStream() );
+  }
+
 void vtkCUDA1DVolumeMapper::InternalRender (  vtkRenderer* vtkNotUsed(ren), vtkVolume* vol,
                                             const cudaRendererInformation& rendererInfo,
                                             const cudaVolumeInformation& volumeInfo,
@@ -177,18 +1033,74 @@ void vtkCUDA1DVolumeMapper::InternalRender (  vtkRenderer* vtkNotUsed(ren), vtkV
   this->transferFunctionInfoHandler->UseGradientOpacity( !vol->GetProperty()->GetDisableGradientOpacity() );
   this->transferFunctionInfoHandler->Update();
 
-  //perform the render
-  this->tfLock->Lock();
+  //composite the fused volumes along with the input, their matrices following the camera every frame
+  cuda1DTransferFunctionInformation transInfo = this->transferFunctionInfoHandler->GetTransferFunctionInfo();
+  this->UpdateFusedInputs(vol, transInfo);
+  this->kernelVariant = this->ChooseKernelVariant(rendererInfo, volumeInfo, transInfo);
+
+  //perform the render on the host threads if there is no device to use
+  if( this->RenderBackend == CPU_BACKEND )
+    {
+    char* hostImage = this->GetHostFrame(this->currentFrame);
+    if( !hostImage )
+      {
+      vtkErrorMacro(<< "No host copy of the current frame to render.");
+      return;
+      }
+
+    cpuRendererBuffers rendererBuffers;
+    rendererBuffers.ZBuffer = this->RendererInfoHandler->GetZBuffer();
+    rendererBuffers.ZBufferSize = rendererInfo.actualResolution;
+    rendererBuffers.RandomRayOffsets = this->RayOffsets;
+    rendererBuffers.OutputImage = this->OutputInfoHandler->GetHostOutputImage();
+
+    cpu1DVolumeBuffers volumeBuffers;
+    volumeBuffers.Volume = hostImage;
+    volumeBuffers.VolumeFormat = this->volumePacking.Format;
+    volumeBuffers.AlphaTransferFunction = this->transferFunctionInfoHandler->GetAlphaTransferFunction();
+    volumeBuffers.GAlphaTransferFunction = this->transferFunctionInfoHandler->GetGAlphaTransferFunction();
+    volumeBuffers.ColorRTransferFunction = this->transferFunctionInfoHandler->GetColorRedTransferFunction();
+    volumeBuffers.ColorGTransferFunction = this->transferFunctionInfoHandler->GetColorGreenTransferFunction();
+    volumeBuffers.ColorBTransferFunction = this->transferFunctionInfoHandler->GetColorBlueTransferFunction();
+    volumeBuffers.PreIntegratedTransferFunction = this->transferFunctionInfoHandler->GetPreIntegratedTransferFunction();
+    volumeBuffers.MacroCellOccupancy = this->transferFunctionInfoHandler->GetMacroCellOccupancy();
+    for( int v = 0; v < CUDA_MAX_FUSED_VOLUMES; v++ )
+      volumeBuffers.FusedVolumes[v] = (v < (int) this->fusedInputs.size()) ? this->fusedInputs[v].HostImage : 0;
+    volumeBuffers.FusedColorTransferFunctions = this->fusedColorTables;
+    volumeBuffers.FusedGAlphaTransferFunctions = this->fusedGAlphaTables;
+
+    this->erroredOut = !CPU_vtkCUDA1DVolumeMapper_renderAlgo_doRender(outputInfo, rendererInfo, volumeInfo,
+      transInfo, rendererBuffers, volumeBuffers, this->kernelVariant, this->HostThreadPool,
+      this->CollectStatistics ? &(this->RenderStatistics) : 0);
+    return;
+    }
+
+  //perform the render, the progressive passes after the first compositing the rays it formed again
+  bool reuseRays = this->ProgressiveRendering && outputInfo.rayBuffer && this->OutputInfoHandler->GetNumberOfAccumulatedPasses() > 0;
   this->ReserveGPU();
-  this->erroredOut = !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender(outputInfo, rendererInfo, volumeInfo,
-								     this->transferFunctionInfoHandler->GetTransferFunctionInfo(), this->GetStream());
-  this->tfLock->Unlock();
+  this->erroredOut = !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender(this->RenderContext, outputInfo, rendererInfo, volumeInfo,
+								     transInfo, reuseRays, this->kernelVariant,
+								     this->CollectStatistics ? &(this->RenderStatistics) : 0, this->GetStream());
+
+  //load the coming frames of a 4D sequence on the copy stream while the rays are cast, or the bricks they asked for
+  this->PrefetchFrames();
+  this->UpdateBricks();
 
 }
 
 void vtkCUDA1DVolumeMapper::ClearInputInternal()
   {
-  this->ReserveGPU();
+  for( std::map<int,char*>::iterator it = this->hostImages.begin(); it != this->hostImages.end(); it++ )
+    delete[] it->second;
+  this->hostImages.clear();
+  this->transferFunctionInfoHandler->SetMacroCellGrid( 0 );
+  for( std::map<int,cudaMacroCellGrid>::iterator it = this->macroCellGrids.begin(); it != this->macroCellGrids.end(); it++ )
+    CPU_vtkCUDAVolumeMapper_freeMacroCellGrid( it->second );
+  this->macroCellGrids.clear();
 
-  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(this->GetStream());
+  this->UnloadBricks();
+  this->ResetFrameCache(0);
+  this->pyramids.clear();
+  this->pyramidInfo.NumberOfLevels = 0;
+  this->LoadPyramid(-1);
   }
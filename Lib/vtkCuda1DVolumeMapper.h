@@ -11,10 +11,23 @@
 #define __vtkCUDA1DVolumeMapper_h
 
 #include "vtkCUDAVolumeMapper.h"
+#include "CUDA_container1DTransferFunctionInformation.h"
+#include "CUDA_containerDeviceVolume.h"
+#include "CUDA_containerMacroCellGrid.h"
+#include "CUDA_containerPyramidInformation.h"
+#include "CUDA_containerVolumePackingInformation.h"
 class vtkCUDA1DTransferFunctionInformationHandler;
+class vtkCUDABrickManager;
+class vtkCUDAFrameCache;
+
+// STD includes
+#include <map>
+#include <vector>
 
 // VTK includes
-class vtkMutexLock;
+class vtkMatrix4x4;
+class vtkTransform;
+class vtkVolumeProperty;
 
 /** @brief vtkCUDA1DVolumeMapper is a volume mapper, taking a set of 3D image data objects, volume and renderer as input and creates a 2D ray casted projection of the scene which is then displayed to screen
 *
@@ -39,6 +52,140 @@ public:
     const cudaVolumeInformation& volumeInfo,
     const cudaOutputImageInformation& outputInfo );
 
+  virtual void SetRenderBackend(int backend);
+
+  /** @brief Fuses another volume with the input, compositing it in the same ray pass so the volumes interleave in depth
+  *
+  *  @param image The image data of the fused volume, whose voxels are kept as floats wherever the rays are cast
+  *  @param property The transfer functions of the fused volume, the shading being that of the rendered volume
+  *  @param userMatrix The volume to world matrix of the fused volume, or null for it to follow the rendered volume (co-registered)
+  *
+  *  @return The index of the fused volume, or -1 if CUDA_MAX_FUSED_VOLUMES volumes are already fused
+  */
+  int AddFusedInput(vtkImageData* image, vtkVolumeProperty* property, vtkMatrix4x4* userMatrix = 0);
+
+  /** @brief Removes every fused volume, rendering the input alone
+  *
+  */
+  void RemoveAllFusedInputs();
+
+  /** @brief Gets the number of volumes fused with the input
+  *
+  */
+  int GetNumberOfFusedInputs() const { return (int) this->fusedInputs.size(); }
+
+  /** @brief Sets the device memory the frames of a 4D sequence may take, the least recently rendered frames being evicted past it
+  *
+  *  @param megabytes The budget, or 0 (the default) for half of the device memory free when the frames are first loaded
+  */
+  void SetFrameCacheBudget(double megabytes);
+  double GetFrameCacheBudget() const { return this->FrameCacheBudget; }
+
+  /** @brief Sets the number of frames after the current one loaded on a copy stream while the current one renders
+  *
+  *  @note The frames are taken in increasing order, looping back to the first, and never so many that they evict each other
+  */
+  void SetNumberOfPrefetchedFrames(int frames);
+  int GetNumberOfPrefetchedFrames() const { return this->NumberOfPrefetchedFrames; }
+
+  /** @brief Gets the cache of the frames held on the device, whose hit rate tells how often changing the frame only rebound a texture
+  *
+  */
+  vtkCUDAFrameCache* GetFrameCache() { return this->frameCache; }
+
+  /** @brief The ways the input can be held on the device */
+  enum BrickingModeType
+    {
+    BRICKING_AUTO = 0,  /**< Brick the input only when a frame is larger than the frame cache budget */
+    BRICKING_OFF = 1,   /**< Always load the frames whole */
+    BRICKING_ON = 2     /**< Always brick the input */
+    };
+
+  /** @brief Sets whether the input is cut into bricks streamed to the device as the rays ask for them, rather than loaded whole
+  *
+  *  @param mode One of BrickingModeType, BRICKING_AUTO by default
+  *
+  *  @note A bricked input shows a low resolution copy of itself wherever its bricks are still missing, refining over the
+  *        following renders (see IsRefining). Only the first frame of a sequence is bricked, and only on the device.
+  */
+  void SetBrickingMode(int mode);
+  int GetBrickingMode() const { return this->BrickingMode; }
+
+  /** @brief Sets the most bricks streamed to the device after a render, bounding how long a frame can take
+  *
+  *  @param bricks The number of bricks, at least 1 (64 by default)
+  */
+  void SetMaximumNumberOfBrickLoads(int bricks);
+  int GetMaximumNumberOfBrickLoads() const { return this->MaximumNumberOfBrickLoads; }
+
+  /** @brief Gets whether the input is currently bricked */
+  bool IsBricked() const { return this->bricked; }
+
+  /** @brief Gets the page table of the bricked input, whose statistics tell how many bricks were streamed and evicted
+  *
+  */
+  vtkCUDABrickManager* GetBrickManager() { return this->brickManager; }
+
+  /** @brief The ways the voxels of the levels of the mip pyramid are reduced */
+  enum PyramidReductionType
+    {
+    MEAN_REDUCTION = CUDA_PYRAMID_MEAN, /**< Average the voxels, so the image smooths out as the volume recedes */
+    MAX_REDUCTION = CUDA_PYRAMID_MAX,   /**< Keep the brightest voxel, so thin bright structures never vanish into empty space */
+    MIN_REDUCTION = CUDA_PYRAMID_MIN    /**< Keep the darkest voxel, so thin dark structures never vanish */
+    };
+
+  /** @brief Sets the number of levels of the mip pyramid the rays sample once a pixel covers several voxels
+  *
+  *  @param levels The number of levels coarser than the input, up to CUDA_MAX_PYRAMID_LEVELS, or 0 (the default) for none
+  *
+  *  @note Each step picks its level from the footprint of its pixel in voxels, derived from the view to voxels matrix, or
+  *        from the length of the step when it is longer. Bricked inputs, fused volumes and the CPU backend always sample
+  *        the input itself.
+  */
+  void SetNumberOfPyramidLevels(int levels);
+  int GetNumberOfPyramidLevels() const;
+
+  /** @brief Sets how the voxels of the levels of the mip pyramid are reduced
+  *
+  *  @param reduction One of PyramidReductionType, MEAN_REDUCTION by default
+  */
+  void SetPyramidReduction(int reduction);
+  int GetPyramidReduction() const;
+
+  /** @brief Sets whether the rays are cast by the kernels specialized for the features each frame uses
+  *
+  *  @param specialized true (the default) to leave out of the kernels the shading, gradient opacity, clipping planes and
+  *                     perspective division the frame does not use, false to always cast with every feature compiled in
+  *
+  *  @note Each specialized kernel renders the same image the general one does, only faster. The volume is shaded when the
+  *        property shades it with anything but its neutral constants, and its gradient opacity is used when the gradient
+  *        opacity function is not 1 throughout. Fused volumes are always composited by the general kernel.
+  */
+  void SetUseSpecializedKernels(bool specialized);
+  bool GetUseSpecializedKernels() const { return this->UseSpecializedKernels; }
+
+  /** @brief Sets whether the rays classify the segments between their samples from a pre-integrated table rather than the samples themselves
+  *
+  *  @param preIntegration true to integrate the transfer function over every pair of intensities at the front and back of a
+  *                        segment each time it changes, false (the default) to classify each sample as it is
+  *
+  *  @note The segments keep the thin features of the transfer function, such as a narrow opacity peak at an iso-surface,
+  *        from aliasing into rings as the steps lengthen, so the sample distance factors can typically be raised 2 to 4
+  *        times for the same image. Fused volumes are always classified at their samples.
+  */
+  void SetPreIntegration(bool preIntegration);
+  bool GetPreIntegration() const;
+
+  /** @brief Gets the features the kernels casting the last frame were specialized for, a combination of the flags of
+  *          CUDA_containerKernelVariant.h
+  */
+  int GetKernelVariant() const { return this->kernelVariant; }
+
+  /** @brief Gets whether the image is still refining, either over progressive passes or while missing bricks are streamed
+  *
+  */
+  virtual bool IsRefining();
+
 protected:
   /** @brief Constructor which initializes the number of frames, rendering type and other constants to safe initial values, and creates the required information handlers
   *
@@ -52,9 +199,134 @@ protected:
   virtual void Reinitialize(int withData = 0);
   virtual void Deinitialize(int withData = 0);
 
+  /** @brief Gets whether the input can be replicated on the other devices, which bricked inputs and fused volumes cannot */
+  virtual bool CanRenderTiles();
+
+  /** @brief Gets whether the input can be split into slabs, which the fused volumes cannot */
+  virtual bool CanRenderSlabs();
+
+  /** @brief Passes the frame cache, bricking, mip pyramid and pre-integration settings along with those of vtkCUDAVolumeMapper, the bands of
+  *          the image loading the frames whole */
+  virtual void CopyTileSettings(vtkCUDAVolumeMapper* tileMapper);
+
+  /** @brief Gets the latest modification time of the frames along with the images, properties and matrices of the fused volumes */
+  virtual unsigned long GetRenderedDataMTime();
+
+  /** @brief Picks the kernels casting a frame from the features it uses, the general ones if they are not to be specialized
+  *
+  *  @return A combination of the flags of CUDA_containerKernelVariant.h
+  */
+  int ChooseKernelVariant(const cudaRendererInformation& rendererInfo, const cudaVolumeInformation& volumeInfo,
+                          const cuda1DTransferFunctionInformation& transInfo);
+
+  bool UseSpecializedKernels;         /**< Whether the rays are cast by the kernels specialized for the frame */
+  int kernelVariant;                  /**< The features the kernels casting the last frame were specialized for */
+
   vtkCUDA1DTransferFunctionInformationHandler* transferFunctionInfoHandler;
 
-  static vtkMutexLock* tfLock;
+  std::map<int, char*> hostImages;    /**< Host packed copies of each frame, kept only when ray casting on the host */
+  cudaVolumePackingInformation volumePacking; /**< How the voxels of the frames are stored */
+  std::map<int, cudaMacroCellGrid> macroCellGrids; /**< Min/max macro cell grid of each frame, used to skip empty space */
+  unsigned int currentFrame;          /**< The frame currently being rendered */
+
+  /** @brief Gets the host packed copy of a frame, packing it first if need be */
+  char* GetHostFrame(int frame);
+
+  /** @brief Loads a frame into a slot of the frame cache, evicting the least recently used frame other than the current one
+  *
+  *  @param stream The stream the frame is copied on, the copy stream when prefetching
+  *
+  *  @return The slot holding the frame, or -1 if it could not be loaded
+  */
+  int LoadFrame(int frame, cudaStream_t* stream);
+
+  /** @brief Loads the frames following the current one that are not held yet, while the current one renders */
+  void PrefetchFrames();
+
+  /** @brief Empties the frame cache, sizing it for frames of the given size within the budget
+  *
+  *  @param frameBytes The size of a packed frame, or 0 to only empty the cache
+  */
+  void ResetFrameCache(size_t frameBytes);
+
+  /** @brief Empties a slot of the frame cache, its volume being freed once no other mapper of the device shares it
+  *
+  *  @param slot The slot, or -1 for every slot
+  */
+  void ClearFrameSlot(int slot);
+
+  vtkCUDAFrameCache* frameCache;      /**< Which frame each slot of the device holds */
+  cudaDeviceVolume frameVolumes[CUDA_MAX_CACHED_FRAMES]; /**< The volume in each slot, shared through the volume cache of the device manager */
+  size_t frameCacheFrameBytes;        /**< The size of the frames the cache was sized for, 0 if the slots are to be emptied before use */
+  cudaStream_t copyStream;            /**< The stream the frames are prefetched on */
+  double FrameCacheBudget;            /**< The device memory the frames may take in megabytes, or 0 for half of the free memory */
+  int NumberOfPrefetchedFrames;       /**< The number of frames after the current one loaded during a render */
+
+  /** @brief Gets the device memory the frames may take in bytes, taking half of the free memory without a budget */
+  double GetDeviceBudget();
+
+  /** @brief Gets the size of a packed frame as loaded on the device, the low resolution copy of a bricked input */
+  size_t GetFrameBytes();
+
+  /** @brief Cuts the input into bricks, keeping a low resolution copy of it to load as its frame
+  *
+  *  @return false if the pool of bricks could not be allocated, the input being left unbricked
+  */
+  bool LoadBrickedInput(vtkImageData* input);
+
+  /** @brief Frees the bricks and the low resolution copy of the input */
+  void UnloadBricks();
+
+  /** @brief Streams the bricks the rays asked for during the render before the last, whose requests have been read back
+  *          since, and updates the page table once they are copied, reading the requests of the last render back in turn
+  */
+  void UpdateBricks();
+
+  vtkCUDABrickManager* brickManager;  /**< Which brick each slot of the pool holds */
+  bool bricked;                       /**< Whether the input is bricked */
+  char* coarseImage;                  /**< The packed low resolution copy of the bricked input, loaded as its frame */
+  int coarseFactor;                   /**< The factor the low resolution copy is reduced by along each axis */
+  bool brickRequestsPending;          /**< Whether the requests of the last render are being read back, to be taken after this one */
+  int BrickingMode;                   /**< When the input is bricked, one of BrickingModeType */
+  int MaximumNumberOfBrickLoads;      /**< The most bricks streamed after a render */
+
+  /** @brief Loads the mip pyramid of a frame onto the device, unloading it when the frame has none or the input is bricked */
+  void LoadPyramid(int frame);
+
+  /** @brief Has the volume information handler build the mip pyramid of every frame again, after its settings changed */
+  void UpdatePyramids();
+
+  std::map<int, std::vector<float> > pyramids; /**< The levels of the mip pyramid of each frame, as floats */
+  cudaPyramidInformation pyramidInfo; /**< The layout of the mip pyramids, the same for every frame */
+  int pyramidFrame;                   /**< The frame whose mip pyramid is loaded on the device, or -1 */
+  std::vector<char> pyramidBuffer;    /**< The packed levels being loaded */
+
+  /** @brief A volume fused with the input */
+  struct FusedInput
+    {
+    vtkImageData*       Image;        /**< The image data of the fused volume */
+    vtkVolumeProperty*  Property;     /**< The transfer functions of the fused volume */
+    vtkMatrix4x4*       UserMatrix;   /**< The volume to world matrix of the fused volume, or null to follow the rendered volume */
+    vtkCUDA1DTransferFunctionInformationHandler* TransferFunctionInfoHandler; /**< Builds the lookup tables of the fused volume on the host */
+    float*              HostImage;    /**< Host copy of the voxels, kept only when ray casting on the host */
+    };
+
+  /** @brief Loads the voxels of a fused volume where the rays are cast */
+  void LoadFusedInput(int volume);
+
+  /** @brief Brings the matrices, volume information and lookup tables of the fused volumes up to date for the frame
+  *
+  *  @param transInfo Receives the ranges of the lookup tables of the fused volumes
+  */
+  void UpdateFusedInputs(vtkVolume* vol, cuda1DTransferFunctionInformation& transInfo);
+
+  std::vector<FusedInput> fusedInputs;  /**< The volumes fused with the input, in the order of their slots */
+  vtkTransform* fusedTransform;         /**< Temporary storage of the voxels to view transform of a fused volume */
+  vtkMatrix4x4* fusedViewToVoxels;      /**< Temporary storage of the view to voxels matrix of a fused volume */
+  float* fusedColorTables;              /**< Host RGBA lookup tables of the fused volumes, one row per slot */
+  float* fusedGAlphaTables;             /**< Host gradient opacity lookup tables of the fused volumes, one row per slot */
+  unsigned int fusedTableSize;          /**< The number of entries in each row of the fused lookup tables */
+  unsigned long fusedTablesModified;    /**< Latest modification time of the fused properties when their tables were loaded, 0 to force a load */
 
 private:
   vtkCUDA1DVolumeMapper operator=(const vtkCUDA1DVolumeMapper&); /**< not implemented */
@@ -0,0 +1,197 @@
+/** @file vtkCUDABlockShapeTuner.cxx
+*
+*  @brief The tuner choosing the shape of the thread blocks the CUDA ray casters are launched with
+*
+*/
+
+#include "vtkCUDABlockShapeTuner.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#define CUDA_BLOCK_SHAPE_TRIALS 2 //times each candidate is timed, the first frames also paying for the first launches
+
+//the shapes tried, the historic 16x16 first
+static const int CUDA_BLOCK_SHAPE_CANDIDATES[][2] = { {16, 16}, {8, 8}, {16, 8}, {8, 16}, {32, 4}, {32, 8} };
+
+vtkStandardNewMacro(vtkCUDABlockShapeTuner);
+
+vtkCUDABlockShapeTuner::vtkCUDABlockShapeTuner()
+  {
+  //a library has no business in the user's files, so the shapes are only kept on disk where the application says
+  this->CacheFileName = 0;
+  this->CacheLoaded = false;
+  }
+
+vtkCUDABlockShapeTuner::~vtkCUDABlockShapeTuner()
+  {
+  this->SetCacheFileName(0);
+  }
+
+void vtkCUDABlockShapeTuner::SetCacheFileName(const char* fileName)
+  {
+  if( fileName == this->CacheFileName || (fileName && this->CacheFileName && !strcmp(fileName, this->CacheFileName)) )
+    return;
+  delete [] this->CacheFileName;
+  this->CacheFileName = 0;
+  if( fileName )
+    {
+    this->CacheFileName = new char[strlen(fileName) + 1];
+    strcpy(this->CacheFileName, fileName);
+    }
+
+  //the shapes of the new file are read before the next one is chosen
+  this->CacheLoaded = false;
+  this->Modified();
+  }
+
+int vtkCUDABlockShapeTuner::GetNumberOfCandidates()
+  {
+  return (int) (sizeof(CUDA_BLOCK_SHAPE_CANDIDATES) / sizeof(CUDA_BLOCK_SHAPE_CANDIDATES[0]));
+  }
+
+void vtkCUDABlockShapeTuner::GetCandidate(int candidate, int shape[2])
+  {
+  candidate = (candidate < 0 || candidate >= GetNumberOfCandidates()) ? 0 : candidate;
+  shape[0] = CUDA_BLOCK_SHAPE_CANDIDATES[candidate][0];
+  shape[1] = CUDA_BLOCK_SHAPE_CANDIDATES[candidate][1];
+  }
+
+std::string vtkCUDABlockShapeTuner::MakeKey(const char* deviceName, int computeMajor, int computeMinor, const int volumeSize[3])
+  {
+  //the key is the first field of a line of the cache, so it is kept free of tabs and new lines
+  std::string name = deviceName ? deviceName : "";
+  for( size_t i = 0; i < name.size(); i++ )
+    if( name[i] == '\t' || name[i] == '\n' || name[i] == '\r' ) name[i] = ' ';
+
+  std::ostringstream key;
+  key << name << " (" << computeMajor << "." << computeMinor << ") "
+      << volumeSize[0] << "x" << volumeSize[1] << "x" << volumeSize[2];
+  return key.str();
+  }
+
+bool vtkCUDABlockShapeTuner::GetBlockShape(const std::string& key, int shape[2])
+  {
+  this->LoadCache();
+  std::map<std::string, Entry>::iterator it = this->Entries.find(key);
+  if( it == this->Entries.end() )
+    {
+    Entry entry;
+    GetCandidate(0, entry.Shape);
+    entry.Tuned = false;
+    entry.Trial = 0;
+    entry.Times.assign( GetNumberOfCandidates(), -1.0 );
+    it = this->Entries.insert( std::make_pair(key, entry) ).first;
+    }
+
+  const Entry& entry = it->second;
+  if( entry.Tuned )
+    {
+    shape[0] = entry.Shape[0];
+    shape[1] = entry.Shape[1];
+    return false;
+    }
+  GetCandidate( entry.Trial % GetNumberOfCandidates(), shape );
+  return true;
+  }
+
+void vtkCUDABlockShapeTuner::ReportTime(const std::string& key, double seconds)
+  {
+  std::map<std::string, Entry>::iterator it = this->Entries.find(key);
+  if( it == this->Entries.end() || it->second.Tuned ) return;
+  Entry& entry = it->second;
+
+  const int numberOfCandidates = GetNumberOfCandidates();
+  const int candidate = entry.Trial % numberOfCandidates;
+  if( seconds >= 0.0 && (entry.Times[candidate] < 0.0 || seconds < entry.Times[candidate]) )
+    entry.Times[candidate] = seconds;
+  entry.Trial++;
+  if( entry.Trial < CUDA_BLOCK_SHAPE_TRIALS * numberOfCandidates ) return;
+
+  //settle on the fastest candidate, and keep it for the next sessions
+  int best = 0;
+  for( int i = 1; i < numberOfCandidates; i++ )
+    if( entry.Times[i] >= 0.0 && (entry.Times[best] < 0.0 || entry.Times[i] < entry.Times[best]) )
+      best = i;
+  GetCandidate(best, entry.Shape);
+  entry.Tuned = true;
+  vtkDebugMacro(<< "Block shape for " << key << " tuned to " << entry.Shape[0] << "x" << entry.Shape[1]);
+  this->SaveCache();
+  }
+
+void vtkCUDABlockShapeTuner::ReadCache(std::map<std::string, Entry>& entries)
+  {
+  if( !this->CacheFileName ) return;
+
+  //each line holds a key, then the shape along x and y, separated by tabs
+  std::ifstream file( this->CacheFileName );
+  std::string line;
+  while( std::getline(file, line) )
+    {
+    size_t separator = line.find('\t');
+    if( separator == std::string::npos ) continue;
+    std::istringstream shapeStream( line.substr(separator + 1) );
+    Entry entry;
+    if( !(shapeStream >> entry.Shape[0] >> entry.Shape[1]) || entry.Shape[0] < 1 || entry.Shape[1] < 1 ||
+        entry.Shape[0] * entry.Shape[1] > 1024 )
+      continue;
+    entry.Tuned = true;
+    entry.Trial = 0;
+    entries[ line.substr(0, separator) ] = entry;
+    }
+  }
+
+void vtkCUDABlockShapeTuner::LoadCache()
+  {
+  if( this->CacheLoaded ) return;
+  this->CacheLoaded = true;
+
+  //the keys seen in this session keep their state, tuned or not
+  std::map<std::string, Entry> cached;
+  this->ReadCache(cached);
+  for( std::map<std::string, Entry>::const_iterator it = cached.begin(); it != cached.end(); it++ )
+    this->Entries.insert(*it);
+  }
+
+void vtkCUDABlockShapeTuner::SaveCache()
+  {
+  if( !this->CacheFileName ) return;
+
+  //the file is read again, so the shapes other tuners saved to it since it was loaded are kept, then replaced whole by
+  //renaming a temporary file over it, so a reader never sees it half written
+  std::map<std::string, Entry> merged;
+  this->ReadCache(merged);
+  for( std::map<std::string, Entry>::const_iterator it = this->Entries.begin(); it != this->Entries.end(); it++ )
+    if( it->second.Tuned ) merged[it->first] = it->second;
+
+  std::ostringstream temporaryName;
+  temporaryName << this->CacheFileName << "." << (const void*) this << ".tmp";
+  std::ofstream file( temporaryName.str().c_str() );
+  if( !file )
+    {
+    vtkWarningMacro(<< "Cannot write the block shape cache " << this->CacheFileName);
+    return;
+    }
+  for( std::map<std::string, Entry>::const_iterator it = merged.begin(); it != merged.end(); it++ )
+    file << it->first << "\t" << it->second.Shape[0] << "\t" << it->second.Shape[1] << "\n";
+  file.close();
+  bool written = !file.fail();
+
+  //rename does not replace an existing file on Windows, where it is removed first
+  if( written && std::rename( temporaryName.str().c_str(), this->CacheFileName ) != 0 )
+    {
+    std::remove( this->CacheFileName );
+    written = std::rename( temporaryName.str().c_str(), this->CacheFileName ) == 0;
+    }
+  if( !written )
+    {
+    std::remove( temporaryName.str().c_str() );
+    vtkWarningMacro(<< "Cannot write the block shape cache " << this->CacheFileName);
+    }
+  }
@@ -0,0 +1,114 @@
+/** @file vtkCUDABlockShapeTuner.h
+*
+*  @brief Header file defining the tuner choosing the shape of the thread blocks the CUDA ray casters are launched with
+*
+*  @note The tuning is done online: while a device and volume size have no known shape, each frame rendered for them tries
+*        the next candidate shape, and once every candidate has been timed the fastest one is used from then on and, if
+*        the application gave a cache file, written to it so later sessions start with it
+*
+*/
+
+#ifndef __vtkCUDABlockShapeTuner_h
+#define __vtkCUDABlockShapeTuner_h
+
+// CUDA Volume Rendering includes
+#include "CUDAVolumeRenderingLibExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <map>
+#include <string>
+#include <vector>
+
+/** @brief vtkCUDABlockShapeTuner times the candidate block shapes for each device and volume size, and remembers the fastest
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDABlockShapeTuner
+  : public vtkObject
+{
+public:
+
+  vtkTypeMacro (vtkCUDABlockShapeTuner,vtkObject);
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDABlockShapeTuner* New();
+
+  /** @brief Sets the file the fastest shapes are kept in between sessions, which is read again before the next shape is chosen
+  *
+  *  @param fileName The path of the cache, or null (the default) to keep the shapes in memory only
+  *
+  *  @note Tuners sharing a file merge their shapes with those already in it when they save, the last one saved winning
+  *        for a key tuned by several
+  */
+  void SetCacheFileName(const char* fileName);
+  vtkGetStringMacro(CacheFileName);
+
+  /** @brief Gets the number of block shapes tried when tuning
+  *
+  */
+  static int GetNumberOfCandidates();
+
+  /** @brief Gets one of the block shapes tried when tuning
+  *
+  *  @param candidate The index of the shape, between 0 and GetNumberOfCandidates() (exclusive)
+  *  @param shape Receives the number of threads of a block along x and y
+  */
+  static void GetCandidate(int candidate, int shape[2]);
+
+  /** @brief Chooses the block shape to render the next frame with
+  *
+  *  @param key Identifies the device and volume size being rendered (see MakeKey)
+  *  @param shape Receives the fastest shape known for the key, or else the next candidate to time
+  *
+  *  @return true if the shape is being timed, in which case the time of the frame is to be given to ReportTime
+  */
+  bool GetBlockShape(const std::string& key, int shape[2]);
+
+  /** @brief Records how long the ray casting took with the shape GetBlockShape returned for timing
+  *
+  *  @param key The key given to GetBlockShape
+  *  @param seconds The time spent ray casting the frame
+  */
+  void ReportTime(const std::string& key, double seconds);
+
+  /** @brief Builds the key of a device and volume size
+  *
+  */
+  static std::string MakeKey(const char* deviceName, int computeMajor, int computeMinor, const int volumeSize[3]);
+
+protected:
+  vtkCUDABlockShapeTuner();
+  ~vtkCUDABlockShapeTuner();
+
+  /** @brief Reads the cache file (once), keeping the entries of any key not tuned in this session */
+  void LoadCache();
+
+  /** @brief Writes every shape tuned in this session into the cache file, along with those already in it */
+  void SaveCache();
+
+private:
+  vtkCUDABlockShapeTuner& operator=(const vtkCUDABlockShapeTuner&); /**< not implemented */
+  vtkCUDABlockShapeTuner(const vtkCUDABlockShapeTuner&); /**< not implemented */
+
+  /** @brief The tuning state of one key */
+  struct Entry
+    {
+    int Shape[2];               /**< The fastest shape, once tuned */
+    bool Tuned;                 /**< Whether every candidate has been timed */
+    int Trial;                  /**< The number of frames timed so far */
+    std::vector<double> Times;  /**< The best time of each candidate so far */
+    };
+
+  /** @brief Reads the shapes of the cache file as tuned entries, none if it cannot be opened */
+  void ReadCache(std::map<std::string, Entry>& entries);
+
+  char* CacheFileName;                   /**< The path of the cache, or null */
+  bool CacheLoaded;                      /**< Whether the cache file has been read */
+  std::map<std::string, Entry> Entries;  /**< The state of every key seen or read from the cache */
+};
+
+#endif
@@ -0,0 +1,173 @@
+/** @file vtkCUDABrickManager.cxx
+*
+*  @brief The bookkeeping of the bricks of a volume held in a pool on the device
+*
+*/
+
+#include "vtkCUDABrickManager.h"
+#include "CUDA_containerBrickInformation.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#define CUDA_BRICK_POOL_MAX_SIZE 2048 //largest size of a 3D array along each axis, in voxels
+
+vtkStandardNewMacro(vtkCUDABrickManager);
+
+vtkCUDABrickManager::vtkCUDABrickManager()
+  {
+  this->BrickSize = CUDA_BRICK_SIZE;
+  this->GridSize[0] = this->GridSize[1] = this->GridSize[2] = 0;
+  this->PoolSlots[0] = this->PoolSlots[1] = this->PoolSlots[2] = 0;
+  this->Frame = 0;
+  this->MissingBricks = 0;
+  this->Loads = 0;
+  this->Evictions = 0;
+  }
+
+void vtkCUDABrickManager::Initialize(const int volumeSize[3], int brickSize, int numberOfSlots)
+  {
+  this->BrickSize = brickSize < 1 ? 1 : brickSize;
+  for( int i = 0; i < 3; i++ )
+    this->GridSize[i] = volumeSize[i] < 1 ? 0 : (volumeSize[i] + this->BrickSize - 1) / this->BrickSize;
+  const int numberOfBricks = this->GridSize[0] * this->GridSize[1] * this->GridSize[2];
+
+  //fill the pool along x, then y, then z, never holding more slots than there are bricks or than a 3D array can
+  const int slotsPerAxis = CUDA_BRICK_POOL_MAX_SIZE / (this->BrickSize + 2 * CUDA_BRICK_APRON);
+  int n = numberOfSlots < numberOfBricks ? numberOfSlots : numberOfBricks;
+  n = n < 1 ? 1 : n;
+  this->PoolSlots[0] = n < slotsPerAxis ? n : slotsPerAxis;
+  this->PoolSlots[1] = n / this->PoolSlots[0] < slotsPerAxis ? n / this->PoolSlots[0] : slotsPerAxis;
+  this->PoolSlots[2] = n / (this->PoolSlots[0] * this->PoolSlots[1]) < slotsPerAxis ? n / (this->PoolSlots[0] * this->PoolSlots[1]) : slotsPerAxis;
+  n = this->PoolSlots[0] * this->PoolSlots[1] * this->PoolSlots[2];
+
+  this->PageTable.assign( 4 * numberOfBricks, 0 );
+  this->BrickSlots.assign( numberOfBricks, -1 );
+  this->SlotBricks.assign( n, -1 );
+  this->SlotUses.assign( n, 0 );
+  this->Victims.clear();
+
+  //hand out the low slots first
+  this->FreeSlots.clear();
+  for( int slot = n - 1; slot >= 0; slot-- )
+    this->FreeSlots.push_back(slot);
+  this->Frame = 0;
+  this->MissingBricks = 0;
+  vtkDebugMacro(<< "Pool of " << n << " slots for " << numberOfBricks << " bricks of " << this->BrickSize << " voxels");
+  }
+
+void vtkCUDABrickManager::GetPoolSize(int size[3]) const
+  {
+  for( int i = 0; i < 3; i++ )
+    size[i] = this->PoolSlots[i] * (this->BrickSize + 2 * CUDA_BRICK_APRON);
+  }
+
+void vtkCUDABrickManager::GetSlotOrigin(int slot, int origin[3]) const
+  {
+  const int slotSize = this->BrickSize + 2 * CUDA_BRICK_APRON;
+  origin[0] = (slot % this->PoolSlots[0]) * slotSize;
+  origin[1] = ((slot / this->PoolSlots[0]) % this->PoolSlots[1]) * slotSize;
+  origin[2] = (slot / (this->PoolSlots[0] * this->PoolSlots[1])) * slotSize;
+  }
+
+void vtkCUDABrickManager::GetBrickIndex(int brick, int index[3]) const
+  {
+  index[0] = brick % this->GridSize[0];
+  index[1] = (brick / this->GridSize[0]) % this->GridSize[1];
+  index[2] = brick / (this->GridSize[0] * this->GridSize[1]);
+  }
+
+int vtkCUDABrickManager::GetNumberOfResidentBricks() const
+  {
+  return this->GetNumberOfSlots() - (int) this->FreeSlots.size();
+  }
+
+int vtkCUDABrickManager::Update(const unsigned char* requests, int maximumLoads, std::vector<int>& bricks, std::vector<int>& slots)
+  {
+  bricks.clear();
+  slots.clear();
+  this->Frame++;
+  const int numberOfBricks = this->GetNumberOfBricks();
+  if( !requests || numberOfBricks == 0 ) return this->MissingBricks = 0;
+
+  //the bricks held that were sampled are kept a frame longer, the others are asked for
+  std::vector<int> missing;
+  for( int brick = 0; brick < numberOfBricks; brick++ )
+    {
+    if( !requests[brick] ) continue;
+    const int slot = this->BrickSlots[brick];
+    if( slot == -1 ) missing.push_back(brick);
+    else this->SlotUses[slot] = this->Frame;
+    }
+
+  //once the free slots run out, the bricks not sampled this frame make room, those sampled longest ago first
+  this->Victims.clear();
+  if( missing.size() > this->FreeSlots.size() )
+    {
+    std::vector< std::pair<unsigned int, int> > candidates;
+    for( int slot = 0; slot < this->GetNumberOfSlots(); slot++ )
+      if( this->SlotBricks[slot] != -1 && this->SlotUses[slot] < this->Frame )
+        candidates.push_back( std::make_pair(this->SlotUses[slot], slot) );
+    std::sort( candidates.begin(), candidates.end(), std::greater< std::pair<unsigned int, int> >() );
+    for( size_t i = 0; i < candidates.size(); i++ )
+      this->Victims.push_back( candidates[i].second );
+    }
+
+  for( size_t i = 0; i < missing.size() && (int) bricks.size() < maximumLoads; i++ )
+    {
+    const int slot = this->TakeSlot();
+    if( slot == -1 ) break;
+    const int brick = missing[i];
+    this->BrickSlots[brick] = slot;
+    this->SlotBricks[slot] = brick;
+    this->SlotUses[slot] = this->Frame;
+    int origin[3];
+    this->GetSlotOrigin(slot, origin);
+    this->PageTable[4*brick] = origin[0];
+    this->PageTable[4*brick+1] = origin[1];
+    this->PageTable[4*brick+2] = origin[2];
+    this->PageTable[4*brick+3] = 1;
+    bricks.push_back(brick);
+    slots.push_back(slot);
+    this->Loads++;
+    }
+
+  this->MissingBricks = (int) (missing.size() - bricks.size());
+  return this->MissingBricks;
+  }
+
+int vtkCUDABrickManager::TakeSlot()
+  {
+  if( !this->FreeSlots.empty() )
+    {
+    const int slot = this->FreeSlots.back();
+    this->FreeSlots.pop_back();
+    return slot;
+    }
+  if( this->Victims.empty() ) return -1;
+  const int slot = this->Victims.back();
+  this->Victims.pop_back();
+  const int evicted = this->SlotBricks[slot];
+  this->BrickSlots[evicted] = -1;
+  this->SlotBricks[slot] = -1;
+  for( int i = 0; i < 4; i++ )
+    this->PageTable[4*evicted+i] = 0;
+  this->Evictions++;
+  return slot;
+  }
+
+void vtkCUDABrickManager::Evict(int brick)
+  {
+  const int slot = this->GetSlot(brick);
+  if( slot == -1 ) return;
+  this->BrickSlots[brick] = -1;
+  this->SlotBricks[slot] = -1;
+  for( int i = 0; i < 4; i++ )
+    this->PageTable[4*brick+i] = 0;
+  this->FreeSlots.push_back(slot);
+  }
@@ -0,0 +1,116 @@
+/** @file vtkCUDABrickManager.h
+*
+*  @brief Header file defining the bookkeeping of the bricks of a volume held in a pool on the device
+*
+*  @note The manager only decides which slot of the pool each brick goes into and which brick makes room for it, the owner
+*        packing and uploading the bricks, so it runs (and can be checked) without a device
+*
+*/
+
+#ifndef __vtkCUDABrickManager_h
+#define __vtkCUDABrickManager_h
+
+// CUDA Volume Rendering includes
+#include "CUDAVolumeRenderingLibExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+/** @brief vtkCUDABrickManager keeps the page table of a bricked volume, loading the bricks the rays asked for in place of the least recently used
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDABrickManager
+  : public vtkObject
+{
+public:
+
+  vtkTypeMacro (vtkCUDABrickManager,vtkObject);
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDABrickManager* New();
+
+  /** @brief Cuts a volume into bricks and lays out the pool holding them, every brick being missing
+  *
+  *  @param volumeSize The size of the volume in voxels
+  *  @param brickSize The size of a brick along each axis, without its apron
+  *  @param numberOfSlots The number of bricks the pool may hold, lowered so the pool fits a 3D array of the device
+  */
+  void Initialize(const int volumeSize[3], int brickSize, int numberOfSlots);
+
+  /** @brief Gets the layout of the bricks and of the pool */
+  int GetBrickSize() const { return this->BrickSize; }
+  void GetGridSize(int size[3]) const { size[0] = this->GridSize[0]; size[1] = this->GridSize[1]; size[2] = this->GridSize[2]; }
+  int GetNumberOfBricks() const { return (int) this->BrickSlots.size(); }
+  int GetNumberOfSlots() const { return (int) this->SlotBricks.size(); }
+
+  /** @brief Gets the size of the pool in voxels, each slot holding a brick and its apron */
+  void GetPoolSize(int size[3]) const;
+
+  /** @brief Gets the origin of a slot in the pool, in voxels */
+  void GetSlotOrigin(int slot, int origin[3]) const;
+
+  /** @brief Gets the index of a brick along each axis */
+  void GetBrickIndex(int brick, int index[3]) const;
+
+  /** @brief Gets the page table, 4 integers per brick: the origin of its slot in the pool and 1 if it is held, or 0s */
+  const int* GetPageTable() const { return this->PageTable.empty() ? 0 : &(this->PageTable[0]); }
+
+  /** @brief Gets the slot holding a brick, or -1 if it is missing */
+  int GetSlot(int brick) const { return (brick < 0 || brick >= this->GetNumberOfBricks()) ? -1 : this->BrickSlots[brick]; }
+
+  /** @brief Takes the bricks sampled by the rays of a frame, and picks the missing ones to load
+  *
+  *  @param requests Per brick, non-zero if a ray sampled it during the frame
+  *  @param maximumLoads The most bricks loaded for a frame, the others being asked for again by the following frames
+  *  @param bricks Receives the bricks to load, the page table already showing them as held
+  *  @param slots Receives the slot each brick is to be loaded into
+  *
+  *  @note The bricks evicted to make room are those sampled longest ago, never one sampled during the frame
+  *  @return The number of bricks sampled during the frame that are still missing
+  */
+  int Update(const unsigned char* requests, int maximumLoads, std::vector<int>& bricks, std::vector<int>& slots);
+
+  /** @brief Marks a brick as missing again, as when its load failed */
+  void Evict(int brick);
+
+  /** @brief Gets the number of bricks held, and of those sampled by the last frame but still missing */
+  int GetNumberOfResidentBricks() const;
+  int GetNumberOfMissingBricks() const { return this->MissingBricks; }
+
+  /** @brief Gets the statistics of Update since the last reset */
+  int GetNumberOfLoads() const { return this->Loads; }
+  int GetNumberOfEvictions() const { return this->Evictions; }
+  void ResetStatistics() { this->Loads = this->Evictions = 0; }
+
+protected:
+  vtkCUDABrickManager();
+  ~vtkCUDABrickManager() {}
+
+private:
+  vtkCUDABrickManager& operator=(const vtkCUDABrickManager&); /**< not implemented */
+  vtkCUDABrickManager(const vtkCUDABrickManager&); /**< not implemented */
+
+  /** @brief Takes a slot for a brick, free or held by the brick sampled longest ago, or -1 if every held brick was sampled this frame */
+  int TakeSlot();
+
+  int BrickSize;                      /**< The size of a brick along each axis, without its apron */
+  int GridSize[3];                    /**< The number of bricks along each axis */
+  int PoolSlots[3];                   /**< The number of slots along each axis of the pool */
+  std::vector<int> PageTable;         /**< 4 integers per brick, copied as is to the device */
+  std::vector<int> BrickSlots;        /**< The slot holding each brick, or -1 */
+  std::vector<int> SlotBricks;        /**< The brick held in each slot, or -1 */
+  std::vector<unsigned int> SlotUses; /**< The last frame each slot was sampled */
+  std::vector<int> FreeSlots;         /**< The slots holding no brick */
+  std::vector<int> Victims;           /**< The slots that may be evicted this frame, the least recently sampled last */
+  unsigned int Frame;                 /**< The number of frames taken by Update */
+  int MissingBricks;                  /**< The bricks sampled by the last frame that are still missing */
+  int Loads;                          /**< The bricks picked to be loaded */
+  int Evictions;                      /**< The bricks evicted to make room */
+};
+
+#endif
@@ -12,13 +12,68 @@
 // CUDA includes
 #include "vtkCUDADeviceManager.h"
 #include "vtkCUDAObject.h"
+#include "vtkCUDARuntime.h"
+#include "vtkCUDAVolumeCache.h"
 
 // VTK includes
-#include <vtkMutexLock.h>
 #include <vtkObjectFactory.h>
 
-// STD includes
-#include <set>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
+#define CUDA_STREAM_FREE 0      //the entry holds no stream
+#define CUDA_STREAM_CHANGING 1  //the stream of the entry is being created or destroyed
+#define CUDA_STREAM_LIVE 2      //the entry holds a stream that can be used
+
+//atomically replaces *value by desired if it is expected, returning what *value was
+static inline int vtkCUDADeviceManagerCompareAndSwap( volatile int* value, int expected, int desired ){
+#ifdef _WIN32
+  return (int) InterlockedCompareExchange( (volatile LONG*) value, (LONG) desired, (LONG) expected );
+#else
+  return __sync_val_compare_and_swap( value, expected, desired );
+#endif
+  }
+
+//reads a value written by another thread, seeing everything written before it
+static inline int vtkCUDADeviceManagerLoad( volatile int* value ){
+  int result = *value;
+#ifdef _WIN32
+  MemoryBarrier();
+#else
+  __sync_synchronize();
+#endif
+  return result;
+  }
+
+//writes a value for another thread, which sees everything written before it
+static inline void vtkCUDADeviceManagerStore( volatile int* value, int desired ){
+#ifdef _WIN32
+  MemoryBarrier();
+#else
+  __sync_synchronize();
+#endif
+  *value = desired;
+  }
+
+//adds to a counter unless it is at or below a floor, returning what the counter was (so at or below the floor if unchanged)
+static inline int vtkCUDADeviceManagerAddAbove( volatile int* value, int increment, int floor ){
+  for(;;){
+    int old = vtkCUDADeviceManagerLoad( value );
+    if( old <= floor ) return old;
+    if( vtkCUDADeviceManagerCompareAndSwap( value, old, old + increment ) == old ) return old;
+    }
+  }
+
+static inline void vtkCUDADeviceManagerYield(){
+#ifdef _WIN32
+  SwitchToThread();
+#else
+  sched_yield();
+#endif
+  }
 
 vtkCUDADeviceManager* vtkCUDADeviceManager::singletonManager = 0;
 
@@ -30,52 +85,90 @@ vtkCUDADeviceManager* vtkCUDADeviceManager::Singleton(){
 
 vtkCUDADeviceManager::vtkCUDADeviceManager(){
 
-  //create the locks
-  this->regularLock = 0;
-  // \tbd is something missing here ?
-  //int n = this->GetNumberOfDevices();
+  for( int i = 0; i < CUDA_MAX_STREAMS; i++ ){
+    this->Streams[i].Stream = 0;
+    this->Streams[i].State = CUDA_STREAM_FREE;
+    this->Streams[i].Device = -1;
+    this->Streams[i].Users = 0;
+    }
+  for( int d = 0; d < CUDA_MAX_DEVICES; d++ )
+    this->DeviceUsers[d] = 0;
+  this->NextStream = 0;
+  this->NumberOfDevices = -1;
+  this->Runtime = vtkCUDARuntime::New();
+  this->VolumeCache = vtkCUDAVolumeCache::New();
 
   }
 
 vtkCUDADeviceManager::~vtkCUDADeviceManager(){
 
-  //define a list to collect the used device ID's in
-  std::set<int> devicesInUse;
-  this->regularLock->Lock();
-
   //synchronize and end all streams
-  for( std::map<cudaStream_t*,int>::iterator it = this->StreamToDeviceMap.begin();
-    it != this->StreamToDeviceMap.end(); it++ ){
-      this->SynchronizeStream( (*it).first );
-      cudaStreamDestroy( *(it->first) );
-      devicesInUse.insert( it->second );
+  bool devicesInUse[CUDA_MAX_DEVICES] = { false };
+  for( int i = 0; i < CUDA_MAX_STREAMS; i++ ){
+    if( this->Streams[i].State != CUDA_STREAM_LIVE ) continue;
+    this->Runtime->SetDevice( this->Streams[i].Device );
+    this->Runtime->StreamSynchronize( this->Streams[i].Stream );
+    this->Runtime->StreamDestroy( this->Streams[i].Stream );
+    devicesInUse[this->Streams[i].Device] = true;
+    this->Streams[i].State = CUDA_STREAM_FREE;
     }
 
   //decommission the devices
-  for( std::set<int>::iterator it = devicesInUse.begin();
-    it != devicesInUse.end(); it++ ){
-      cudaSetDevice( *it );
-      cudaDeviceReset( );
+  for( int d = 0; d < CUDA_MAX_DEVICES; d++ ){
+    if( !devicesInUse[d] && this->DeviceUsers[d] == 0 ) continue;
+    this->Runtime->SetDevice( d );
+    this->Runtime->DeviceReset( );
     }
+  this->Runtime->Delete();
+  this->VolumeCache->Delete();
+
+  }
 
-  //clean up variables
-  this->StreamToDeviceMap.clear();
-  this->StreamToObjectMap.clear();
-  this->ObjectToDeviceMap.clear();
-  this->regularLock->Unlock();
-  this->regularLock->Delete();
+void vtkCUDADeviceManager::SetRuntime( vtkCUDARuntime* runtime ){
+
+  //a runtime is not to be changed under streams or devices it handed out
+  bool inUse = false;
+  for( int i = 0; i < CUDA_MAX_STREAMS; i++ )
+    inUse = inUse || this->Streams[i].State != CUDA_STREAM_FREE;
+  for( int d = 0; d < CUDA_MAX_DEVICES; d++ )
+    inUse = inUse || this->DeviceUsers[d] != 0;
+  if( inUse ){
+    vtkErrorMacro(<<"Cannot change the runtime while devices or streams are in use.");
+    return;
+    }
+  if( runtime == this->Runtime ) return;
+
+  vtkCUDARuntime* oldRuntime = this->Runtime;
+  if( runtime ){
+    runtime->Register(this);
+    this->Runtime = runtime;
+    }else{
+    this->Runtime = vtkCUDARuntime::New();
+    }
+  oldRuntime->UnRegister(this);
+  vtkCUDADeviceManagerStore( &(this->NumberOfDevices), -1 );
+  this->Modified();
 
   }
 
 int vtkCUDADeviceManager::GetNumberOfDevices(){
 
-  int numberOfDevices = 0;
-  cudaError_t result = cudaGetDeviceCount (&numberOfDevices);
+  //the devices do not change while running, so they are only counted once
+  int numberOfDevices = vtkCUDADeviceManagerLoad( &(this->NumberOfDevices) );
+  if( numberOfDevices >= 0 ) return numberOfDevices;
 
-  if( result != 0 ){
+  numberOfDevices = 0;
+  cudaError_t result = this->Runtime->GetDeviceCount(&numberOfDevices);
+
+  //a machine without a CUDA device (or driver) simply has none to offer
+  if( result == cudaErrorNoDevice || result == cudaErrorInsufficientDriver ){
+    numberOfDevices = 0;
+    }else if( result != 0 ){
     vtkErrorMacro(<<"Catostrophic CUDA error - cannot count number of devices.");
     return -1;
     }
+  numberOfDevices = (numberOfDevices < CUDA_MAX_DEVICES) ? numberOfDevices : CUDA_MAX_DEVICES;
+  vtkCUDADeviceManagerStore( &(this->NumberOfDevices), numberOfDevices );
   return numberOfDevices;
 
   }
@@ -86,67 +179,39 @@ bool vtkCUDADeviceManager::GetDevice(vtkCUDAObject* caller, int device){
     return true;
     }
 
-  //tell if we should allocate the lock
-  if( this->ObjectToDeviceMap.empty() )
-    regularLock = vtkMutexLock::New();
-
-  //remove that part of the mapping
-  this->regularLock->Lock();
-  this->ObjectToDeviceMap.insert( std::pair<vtkCUDAObject*,int>(caller, device) );
-  this->regularLock->Unlock();
+  //wait out a reset of the device by the last object to have returned it, then add the reference
+  while( vtkCUDADeviceManagerAddAbove( &(this->DeviceUsers[device]), 1, -1 ) < 0 )
+    vtkCUDADeviceManagerYield();
   return false;
   }
 
 bool vtkCUDADeviceManager::ReturnDevice(vtkCUDAObject* caller, int device){
-  this->regularLock->Lock();
-
-  //find if that is a valid mapping
-  bool found = false;
-  bool emptyDevice = true;
-  std::multimap<vtkCUDAObject*,int>::iterator it = this->ObjectToDeviceMap.begin();
-  std::multimap<vtkCUDAObject*,int>::iterator eraseIt = this->ObjectToDeviceMap.begin();
-  for( ; it != this->ObjectToDeviceMap.end(); it++ ){
-    if( it->first == caller && it->second == device ){
-      found = true;
-      eraseIt = it;
-      }else if(it->second == device){
-        emptyDevice = false;
-      }
-    }
-  if( !found ){
+  if( device < 0 || device >= CUDA_MAX_DEVICES ){
     vtkErrorMacro(<<"Could not locate supplied caller-device pair.");
-    this->regularLock->Unlock();
     return true;
     }
 
-  //also remove streams associated with this caller and this device
-  std::set<cudaStream_t*> streamsToReturn;
-  std::multimap<cudaStream_t*,vtkCUDAObject*>::iterator it2 = this->StreamToObjectMap.begin();
-  for( ; it2 != this->StreamToObjectMap.end(); it2++ ){
-    if( this->StreamToDeviceMap[(it2->first)] == device ){
-      // \tbd is something missing here ?
-      //cudaStream_t* tempStreamPointer = it2->first;
+  //the last reference marks the device as being reset so no one takes it meanwhile
+  volatile int* users = &(this->DeviceUsers[device]);
+  for(;;){
+    int old = vtkCUDADeviceManagerLoad( users );
+    if( old < 1 ){
+      vtkErrorMacro(<<"Could not locate supplied caller-device pair.");
+      return true;
       }
+    if( old > 1 ){
+      if( vtkCUDADeviceManagerCompareAndSwap( users, old, old - 1 ) == old ) return false;
+      continue;
+      }
+    if( vtkCUDADeviceManagerCompareAndSwap( users, 1, -1 ) == 1 ) break;
     }
-  for( std::set<cudaStream_t*>::iterator it = streamsToReturn.begin();
-    it != streamsToReturn.end(); it++ )
-    this->ReturnStream(caller, *it, device );
-
-  //remove that part of the mapping
-  this->ObjectToDeviceMap.erase(eraseIt);
-  if( emptyDevice ){
-    int oldDevice = 0;
-    cudaGetDevice( &oldDevice );
-    if( device != oldDevice ) cudaSetDevice( device );
-    cudaDeviceReset();
-    if( device != oldDevice ) cudaSetDevice( oldDevice );
-    }
-  this->regularLock->Unlock();
-
-  //tell if we should deallocate the lock
-  if( this->ObjectToDeviceMap.empty() )
-    regularLock->UnRegister(this);
 
+  int oldDevice = 0;
+  this->Runtime->GetDevice( &oldDevice );
+  if( device != oldDevice ) this->Runtime->SetDevice( device );
+  this->Runtime->DeviceReset();
+  if( device != oldDevice ) this->Runtime->SetDevice( oldDevice );
+  vtkCUDADeviceManagerStore( users, 0 );
   return false;
   }
 
@@ -158,147 +223,149 @@ bool vtkCUDADeviceManager::GetStream(vtkCUDAObject* caller, cudaStream_t** strea
     return true;
     }
 
-  //if stream is provided, check for stream-device consistancy
-  this->regularLock->Lock();
-  if( *stream && this->StreamToDeviceMap.count(*stream) == 1 && 
-    this->StreamToDeviceMap[(*stream)] != device ){
-      this->regularLock->Unlock();
+  //if stream is provided, check for stream-device consistancy and share it
+  if( *stream ){
+    int slot = this->GetStreamSlot( *stream );
+    if( slot == -1 ){
+      vtkErrorMacro(<<"Stream was not created by the device manager.");
+      return true;
+      }
+    if( this->Streams[slot].Device != device ){
       vtkErrorMacro(<<"Stream already assigned to particular device.");
       return true;
-    }
-
-  //find if this call is redundant
-  bool found = false;
-  std::multimap<cudaStream_t*,vtkCUDAObject*>::iterator it = this->StreamToObjectMap.begin();
-  for( ; it != this->StreamToObjectMap.end(); it++ )
-    if( it->first == *stream && it->second == caller )
-      found = true;
-  if( found ){
-    this->regularLock->Unlock();
+      }
+    if( vtkCUDADeviceManagerAddAbove( &(this->Streams[slot].Users), 1, 0 ) < 1 ){
+      vtkErrorMacro(<<"Stream is being destroyed.");
+      return true;
+      }
     return false;
     }
 
-  //create the new stream and mapping
-  cudaSetDevice(device);
-  if( *stream == 0 ){
-    cudaStream_t* temp = new cudaStream_t();
-    cudaStreamCreate( temp );
-    *stream = temp;
+  //claim a free entry of the table, starting after the last one claimed
+  int first = vtkCUDADeviceManagerLoad( &(this->NextStream) );
+  for( int i = 0; i < CUDA_MAX_STREAMS; i++ ){
+    int slot = (first + i) % CUDA_MAX_STREAMS;
+    StreamSlot& entry = this->Streams[slot];
+    if( entry.State != CUDA_STREAM_FREE ||
+        vtkCUDADeviceManagerCompareAndSwap( &(entry.State), CUDA_STREAM_FREE, CUDA_STREAM_CHANGING ) != CUDA_STREAM_FREE )
+      continue;
+
+    //create the new stream
+    this->Runtime->SetDevice(device);
+    if( this->Runtime->StreamCreate( &(entry.Stream) ) != cudaSuccess ){
+      vtkCUDADeviceManagerStore( &(entry.State), CUDA_STREAM_FREE );
+      vtkErrorMacro(<<"Cannot create a stream.");
+      return true;
+      }
+    entry.Device = device;
+    entry.Users = 1;
+    vtkCUDADeviceManagerStore( &(entry.State), CUDA_STREAM_LIVE );
+    vtkCUDADeviceManagerStore( &(this->NextStream), (slot + 1) % CUDA_MAX_STREAMS );
+    *stream = &(entry.Stream);
+    return false;
     }
-  this->StreamToDeviceMap.insert( std::pair<cudaStream_t*,int>(*stream,device) );
-  this->StreamToObjectMap.insert( std::pair<cudaStream_t*,vtkCUDAObject*>(*stream,caller) );
-  this->regularLock->Unlock();
 
-  return false;
+  vtkErrorMacro(<<"Too many streams are in use.");
+  return true;
 
   }
 
 bool vtkCUDADeviceManager::ReturnStream(vtkCUDAObject* caller, cudaStream_t* stream, int device){
-  this->regularLock->Lock();
-
-  //find if that is a valid three-tuple (stream, object, device)
-  bool found = false;
-  std::multimap<cudaStream_t*,vtkCUDAObject*>::iterator it = this->StreamToObjectMap.begin();
-  for( ; it != this->StreamToObjectMap.end(); it++ ){
-    if( it->first == stream && it->second == caller &&
-      this->StreamToDeviceMap[(it->first)] == device ){
-        found = true;
-        break;
-      }
+
+  //find if that is a valid pair (stream, device)
+  int slot = this->GetStreamSlot( stream );
+  if( slot == -1 || this->Streams[slot].Device != device ){
+    vtkErrorMacro(<<"Could not locate supplied stream-device pair.");
+    return true;
     }
-  if( !found ){
-    vtkErrorMacro(<<"Could not locate supplied caller-device pair.");
-    this->regularLock->Unlock();
+  StreamSlot& entry = this->Streams[slot];
+  int users = vtkCUDADeviceManagerAddAbove( &(entry.Users), -1, 0 );
+  if( users < 1 || (users == 1 &&
+      vtkCUDADeviceManagerCompareAndSwap( &(entry.State), CUDA_STREAM_LIVE, CUDA_STREAM_CHANGING ) != CUDA_STREAM_LIVE) ){
+    vtkErrorMacro(<<"Could not locate supplied stream-device pair.");
     return true;
     }
 
-  //remove that part of the mapping
-  this->StreamToObjectMap.erase(it);
-  if( this->StreamToObjectMap.count(stream) == 0 )
-    this->StreamToDeviceMap.erase( stream );
-  this->regularLock->Unlock();
+  //the last object sharing the stream destroys it and frees its entry
+  if( users == 1 ){
+    int oldDevice = 0;
+    this->Runtime->GetDevice( &oldDevice );
+    if( device != oldDevice ) this->Runtime->SetDevice( device );
+    this->Runtime->StreamSynchronize( entry.Stream );
+    this->Runtime->StreamDestroy( entry.Stream );
+    if( device != oldDevice ) this->Runtime->SetDevice( oldDevice );
+    entry.Stream = 0;
+    entry.Device = -1;
+    vtkCUDADeviceManagerStore( &(entry.State), CUDA_STREAM_FREE );
+    }
   return false;
 
   }
 
 bool vtkCUDADeviceManager::SynchronizeStream( cudaStream_t* stream ){
 
-  //find mapped result and device
-  this->regularLock->Lock();
-  if( this->StreamToDeviceMap.count(stream) != 1 ){
+  //find mapped device
+  int device = this->GetStreamDevice( stream );
+  if( device == -1 ){
     vtkErrorMacro(<<"Cannot synchronize unused stream.");
-    this->regularLock->Unlock();
     return true;
     }
-  int device = this->StreamToDeviceMap[(stream)];
-  this->regularLock->Unlock();
 
   //synchronize the stream and return the success value
   int oldDevice = -1;
-  cudaGetDevice( &oldDevice );
-  cudaSetDevice( device );
-  cudaStreamSynchronize( *stream );
-  cudaSetDevice( oldDevice );
-  return cudaGetLastError() != cudaSuccess;
+  this->Runtime->GetDevice( &oldDevice );
+  this->Runtime->SetDevice( device );
+  this->Runtime->StreamSynchronize( *stream );
+  this->Runtime->SetDevice( oldDevice );
+  return this->Runtime->GetLastError() != cudaSuccess;
 
   }
 
 bool vtkCUDADeviceManager::ReserveGPU( cudaStream_t* stream ){
 
-  //find mapped result and device
-  this->regularLock->Lock();
-  if( this->StreamToDeviceMap.count(stream) != 1 ){
+  //find mapped device
+  int device = this->GetStreamDevice( stream );
+  if( device == -1 ){
     vtkErrorMacro(<<"Cannot synchronize unused stream.");
-    this->regularLock->Unlock();
     return true;
     }
-  int device = this->StreamToDeviceMap[(stream)];
-  this->regularLock->Unlock();
 
   //synchronize the stream and return the success value
-  cudaSetDevice( device );
-  return cudaGetLastError() != cudaSuccess;
+  this->Runtime->SetDevice( device );
+  return this->Runtime->GetLastError() != cudaSuccess;
 
   }
 
 int vtkCUDADeviceManager::QueryDeviceForObject( vtkCUDAObject* object ){
-  this->regularLock->Lock();
-  int device = -1;
-  if( this->ObjectToDeviceMap.count(object) == 1 )
-    device = this->ObjectToDeviceMap.find(object)->second;
-  else
+  int device = object ? object->GetDevice() : -1;
+  if( device < 0 || device >= CUDA_MAX_DEVICES || vtkCUDADeviceManagerLoad( &(this->DeviceUsers[device]) ) < 1 ){
     vtkErrorMacro(<<"No unique mapping exists.");
-  this->regularLock->Unlock();
+    return -1;
+    }
   return device;
   }
 
 int vtkCUDADeviceManager::QueryDeviceForStream( cudaStream_t* stream ){
-  this->regularLock->Lock();
-  int device = -1;
-  if( this->StreamToDeviceMap.count(stream) == 1 )
-    device = this->StreamToDeviceMap[(stream)];
-  else
+  int device = this->GetStreamDevice( stream );
+  if( device == -1 )
     vtkErrorMacro(<<"No mapping exists.");
-  this->regularLock->Unlock();
   return device;
   }
 
-void vtkCUDADeviceManager::DestroyEmptyStream( cudaStream_t* stream ){
+int vtkCUDADeviceManager::GetStreamDevice( cudaStream_t* stream ){
+  int slot = this->GetStreamSlot( stream );
+  return (slot == -1) ? -1 : this->Streams[slot].Device;
+  }
 
-  this->SynchronizeStream( stream );
+int vtkCUDADeviceManager::GetStreamSlot( cudaStream_t* stream ){
 
-  bool found = false;
-  std::map<cudaStream_t*,int>::iterator it = this->StreamToDeviceMap.begin();
-  for( ; it != this->StreamToDeviceMap.end(); it++ ){
-    if( it->first == stream ){
-      found = true;
-      break;
-      }
-    }
-  if( !found ){
-    vtkErrorMacro(<<"Could not locate supplied caller-device pair.");
-    return;
-    }
-  this->StreamToDeviceMap.erase(it);
+  //a stream of the table is the first member of its entry, so its offset from the table is a whole number of entries
+  size_t offset = (size_t) stream - (size_t) this->Streams;
+  if( !stream || offset >= sizeof(this->Streams) || offset % sizeof(StreamSlot) != 0 )
+    return -1;
+  int slot = (int) (offset / sizeof(StreamSlot));
+  if( vtkCUDADeviceManagerLoad( &(this->Streams[slot].State) ) != CUDA_STREAM_LIVE )
+    return -1;
+  return slot;
 
   }
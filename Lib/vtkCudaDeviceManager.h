@@ -14,14 +14,21 @@
 #include "CUDAVolumeRenderingLibExport.h"
 #include "vector_types.h"
 class vtkCUDAObject;
+class vtkCUDARuntime;
+class vtkCUDAVolumeCache;
 
 // VTK includes
 #include "vtkObject.h"
-class vtkMutexLock;
 
-// STD includes
-#include <map>
+#define CUDA_MAX_DEVICES 16   //number of devices the manager hands out, any past it being ignored
+#define CUDA_MAX_STREAMS 256  //number of streams that can be alive at once over all the devices
 
+/** @brief vtkCUDADeviceManager hands the devices and their streams out to the vtkCUDAObjects
+*
+*  @note The streams live in a fixed table, the stream pointer given out being the address of its entry, so looking a
+*        stream up is a range check and reserving a device or synchronizing a stream takes no lock. Getting and returning
+*        devices and streams only changes counters with atomic operations, so no call of the manager ever blocks another.
+*/
 class CUDA_LIB_EXPORT vtkCUDADeviceManager
   : public vtkObject
 {
@@ -30,10 +37,43 @@ public:
 
   vtkTypeMacro (vtkCUDADeviceManager,vtkObject);
 
+  /** @brief Sets the runtime every CUDA call of the host code goes through, such as a vtkCUDAMockRuntime
+  *
+  *  @param runtime The runtime, or null for the CUDA runtime itself
+  *
+  *  @note Only to be called while no device or stream is held, which is before any vtkCUDAObject is created
+  */
+  void SetRuntime( vtkCUDARuntime* runtime );
+  vtkCUDARuntime* GetRuntime() { return this->Runtime; }
+
+  /** @brief Gets the volumes resident on the devices, which the mappers of the same images on the same device share
+  *
+  */
+  vtkCUDAVolumeCache* GetVolumeCache() { return this->VolumeCache; }
+
+  /** @brief Gets the number of devices, counted once, or -1 if they cannot be counted
+  *
+  */
   int GetNumberOfDevices();
+
+  /** @brief Takes a reference on a device, returning true on error as the other calls do
+  *
+  */
   bool GetDevice(vtkCUDAObject* caller, int device);
+
+  /** @brief Gives a reference on a device back, resetting the device once nothing holds it any more
+  *
+  */
   bool ReturnDevice(vtkCUDAObject* caller, int device);
+
+  /** @brief Creates a stream on a device if *stream is null, otherwise shares the stream *stream already is
+  *
+  */
   bool GetStream(vtkCUDAObject* caller, cudaStream_t** stream, int device);
+
+  /** @brief Gives a reference on a stream back, destroying the stream once nothing shares it any more
+  *
+  */
   bool ReturnStream(vtkCUDAObject* caller, cudaStream_t* stream, int device);
 
   bool SynchronizeStream( cudaStream_t* stream );
@@ -50,16 +90,36 @@ private:
   vtkCUDADeviceManager operator=(const vtkCUDADeviceManager&); /**< not implemented */
   vtkCUDADeviceManager(const vtkCUDADeviceManager&); /**< not implemented */
 
-  void DestroyEmptyStream( cudaStream_t* stream );
-
-  std::map<cudaStream_t*,int> StreamToDeviceMap;
-  std::multimap<vtkCUDAObject*,int> ObjectToDeviceMap;
-  std::multimap<cudaStream_t*, vtkCUDAObject*> StreamToObjectMap;
+  /** @brief Gets the device of a live stream of the table, or -1 if the pointer is not one
+  *
+  */
+  int GetStreamDevice( cudaStream_t* stream );
+
+  /** @brief Gets the entry of the table a stream pointer is the address of, or -1 if it is not one
+  *
+  */
+  int GetStreamSlot( cudaStream_t* stream );
+
+  /** @brief An entry of the stream table, its stream first so the address of the stream is that of the entry
+  *
+  */
+  struct StreamSlot
+    {
+    cudaStream_t Stream;              /**< The stream itself */
+    volatile int State;               /**< Whether the entry is free, being changed, or holds a live stream */
+    volatile int Device;              /**< The device the stream was created on */
+    volatile int Users;               /**< The number of objects sharing the stream */
+    };
+
+  StreamSlot Streams[CUDA_MAX_STREAMS];         /**< The table of streams */
+  volatile int DeviceUsers[CUDA_MAX_DEVICES];   /**< The number of references on each device, -1 while it is reset */
+  volatile int NextStream;                      /**< The entry of the table the next new stream is looked for from */
+  volatile int NumberOfDevices;                 /**< The number of devices, or -1 until they are counted */
+  vtkCUDARuntime* Runtime;                      /**< The runtime the calls go through */
+  vtkCUDAVolumeCache* VolumeCache;              /**< The volumes shared by the mappers */
 
   static vtkCUDADeviceManager* singletonManager;
 
-  vtkMutexLock* regularLock;
-
 };
 
 #endif
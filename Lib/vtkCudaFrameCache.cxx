@@ -0,0 +1,99 @@
+/** @file vtkCUDAFrameCache.cxx
+*
+*  @brief The bookkeeping of the frames of a 4D sequence held on the device
+*
+*/
+
+#include "vtkCUDAFrameCache.h"
+#include "CUDA_containerVolumeInformation.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+vtkStandardNewMacro(vtkCUDAFrameCache);
+
+vtkCUDAFrameCache::vtkCUDAFrameCache()
+  {
+  this->Hits = 0;
+  this->Misses = 0;
+  this->Capacity = 0;
+  this->SetCapacity(1);
+  }
+
+void vtkCUDAFrameCache::SetCapacity(int capacity)
+  {
+  capacity = (capacity < 1) ? 1 : (capacity > CUDA_MAX_CACHED_FRAMES ? CUDA_MAX_CACHED_FRAMES : capacity);
+  this->Capacity = capacity;
+  this->Clear();
+  }
+
+int vtkCUDAFrameCache::Lookup(int frame)
+  {
+  std::map<int, int>::const_iterator it = this->Slots.find(frame);
+  if( it == this->Slots.end() )
+    {
+    this->Misses++;
+    return -1;
+    }
+  this->Hits++;
+  this->Order.remove(frame);
+  this->Order.push_back(frame);
+  return it->second;
+  }
+
+int vtkCUDAFrameCache::Find(int frame) const
+  {
+  std::map<int, int>::const_iterator it = this->Slots.find(frame);
+  return (it == this->Slots.end()) ? -1 : it->second;
+  }
+
+int vtkCUDAFrameCache::Insert(int frame, int pinnedFrame, int& evictedFrame)
+  {
+  evictedFrame = -1;
+  int slot = this->Find(frame);
+  if( slot == -1 )
+    {
+    if( !this->FreeSlots.empty() )
+      {
+      slot = this->FreeSlots.back();
+      this->FreeSlots.pop_back();
+      }
+    else
+      {
+      //make room with the least recently used frame that is not being rendered
+      std::list<int>::iterator victim = this->Order.begin();
+      while( victim != this->Order.end() && *victim == pinnedFrame ) victim++;
+      if( victim == this->Order.end() ) return -1;
+      evictedFrame = *victim;
+      slot = this->Slots[evictedFrame];
+      this->Slots.erase(evictedFrame);
+      this->Order.erase(victim);
+      }
+    this->Slots[frame] = slot;
+    }
+  this->Order.remove(frame);
+  this->Order.push_back(frame);
+  return slot;
+  }
+
+int vtkCUDAFrameCache::Remove(int frame)
+  {
+  std::map<int, int>::iterator it = this->Slots.find(frame);
+  if( it == this->Slots.end() ) return -1;
+  int slot = it->second;
+  this->Slots.erase(it);
+  this->Order.remove(frame);
+  this->FreeSlots.push_back(slot);
+  return slot;
+  }
+
+void vtkCUDAFrameCache::Clear()
+  {
+  this->Slots.clear();
+  this->Order.clear();
+
+  //hand out the low slots first
+  this->FreeSlots.clear();
+  for( int slot = this->Capacity - 1; slot >= 0; slot-- )
+    this->FreeSlots.push_back(slot);
+  }
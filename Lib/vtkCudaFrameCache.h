@@ -0,0 +1,102 @@
+/** @file vtkCUDAFrameCache.h
+*
+*  @brief Header file defining the bookkeeping of the frames of a 4D sequence held on the device
+*
+*  @note The cache only decides which slot each frame goes into and which frame makes room for it, the owner doing the
+*        uploads and deallocations, so frames can be loaded on any stream
+*
+*/
+
+#ifndef __vtkCUDAFrameCache_h
+#define __vtkCUDAFrameCache_h
+
+// CUDA Volume Rendering includes
+#include "CUDAVolumeRenderingLibExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <list>
+#include <map>
+#include <vector>
+
+/** @brief vtkCUDAFrameCache maps the frames held on the device to the slots holding them, evicting the least recently used
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDAFrameCache
+  : public vtkObject
+{
+public:
+
+  vtkTypeMacro (vtkCUDAFrameCache,vtkObject);
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDAFrameCache* New();
+
+  /** @brief Sets the number of frames held at once, emptying the cache
+  *
+  *  @param capacity The number of slots, clamped between 1 and CUDA_MAX_CACHED_FRAMES
+  */
+  void SetCapacity(int capacity);
+  int GetCapacity() const { return this->Capacity; }
+
+  /** @brief Gets the number of frames held */
+  int GetNumberOfFrames() const { return (int) this->Slots.size(); }
+
+  /** @brief Finds the slot of a frame about to be rendered, counting a hit or a miss and making it the most recently used
+  *
+  *  @return The slot holding the frame, or -1 if it is to be loaded
+  */
+  int Lookup(int frame);
+
+  /** @brief Finds the slot of a frame without counting or reordering anything
+  *
+  *  @return The slot holding the frame, or -1
+  */
+  int Find(int frame) const;
+
+  /** @brief Assigns a slot to a frame about to be loaded, making it the most recently used
+  *
+  *  @param frame The frame to load, which is not held
+  *  @param pinnedFrame A frame never evicted, as it is being rendered
+  *  @param evictedFrame Receives the frame evicted to make room, whose slot is the one returned, or -1 if a slot was free
+  *
+  *  @return The slot to load the frame into, or -1 if the only frame held is pinned
+  */
+  int Insert(int frame, int pinnedFrame, int& evictedFrame);
+
+  /** @brief Forgets a frame, whose slot becomes free
+  *
+  *  @return The slot the frame was held in, or -1 if it was not held
+  */
+  int Remove(int frame);
+
+  /** @brief Forgets every frame */
+  void Clear();
+
+  /** @brief Gets the statistics of Lookup since the last reset */
+  int GetNumberOfHits() const { return this->Hits; }
+  int GetNumberOfMisses() const { return this->Misses; }
+  double GetHitRate() const { return (this->Hits + this->Misses > 0) ? (double) this->Hits / (double) (this->Hits + this->Misses) : 0.0; }
+  void ResetStatistics() { this->Hits = this->Misses = 0; }
+
+protected:
+  vtkCUDAFrameCache();
+  ~vtkCUDAFrameCache() {}
+
+private:
+  vtkCUDAFrameCache& operator=(const vtkCUDAFrameCache&); /**< not implemented */
+  vtkCUDAFrameCache(const vtkCUDAFrameCache&); /**< not implemented */
+
+  int Capacity;                   /**< The number of slots */
+  std::map<int, int> Slots;       /**< The slot of each frame held */
+  std::list<int> Order;           /**< The frames held, the least recently used first */
+  std::vector<int> FreeSlots;     /**< The slots holding no frame */
+  int Hits;                       /**< The lookups finding their frame held */
+  int Misses;                     /**< The lookups having to load their frame */
+};
+
+#endif
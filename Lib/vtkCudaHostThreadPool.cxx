@@ -0,0 +1,234 @@
+/** @file vtkCUDAHostThreadPool.cxx
+*
+*  @brief A pool of persistent host threads used by the CPU implementations of the ray casting pipeline
+*
+*/
+
+#include "vtkCUDAHostThreadPool.h"
+
+// VTK includes
+#include <vtkConditionVariable.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+
+vtkStandardNewMacro(vtkCUDAHostThreadPool);
+
+vtkCUDAHostThreadPool::vtkCUDAHostThreadPool()
+  {
+  this->Threader = vtkMultiThreader::New();
+  this->BatchLock = new vtkSimpleMutexLock();
+  this->StateLock = new vtkSimpleMutexLock();
+  this->WorkReady = vtkConditionVariable::New();
+  this->WorkDone = vtkConditionVariable::New();
+  for( int i = 0; i < VTK_MAX_THREADS; i++ )
+    {
+    this->Ranges[i].Lock = new vtkSimpleMutexLock();
+    this->Ranges[i].Begin = 0;
+    this->Ranges[i].End = 0;
+    this->Arguments[i].Pool = this;
+    this->Arguments[i].Thread = i;
+    this->WorkerIds[i] = -1;
+    }
+
+  this->Generation = 0;
+  this->Pending = 0;
+  this->Shutdown = false;
+  this->Task = 0;
+  this->UserData = 0;
+
+  this->NumberOfThreads = 1;
+  this->SetNumberOfThreads( vtkMultiThreader::GetGlobalDefaultNumberOfThreads() );
+  }
+
+vtkCUDAHostThreadPool::~vtkCUDAHostThreadPool()
+  {
+  this->StopWorkers();
+  for( int i = 0; i < VTK_MAX_THREADS; i++ )
+    delete this->Ranges[i].Lock;
+  delete this->BatchLock;
+  delete this->StateLock;
+  this->WorkReady->Delete();
+  this->WorkDone->Delete();
+  this->Threader->Delete();
+  }
+
+void vtkCUDAHostThreadPool::SetNumberOfThreads(int n)
+  {
+  n = (n < 1) ? 1 : n;
+  n = (n > VTK_MAX_THREADS) ? VTK_MAX_THREADS : n;
+  if( n == this->NumberOfThreads && (n == 1 || this->WorkerIds[1] != -1) )
+    return;
+
+  this->BatchLock->Lock();
+  this->StopWorkers();
+  this->NumberOfThreads = n;
+  this->StartWorkers();
+  this->BatchLock->Unlock();
+  this->Modified();
+  }
+
+void vtkCUDAHostThreadPool::StartWorkers()
+  {
+  this->Shutdown = false;
+  for( int i = 1; i < this->NumberOfThreads; i++ )
+    {
+    this->Arguments[i].Generation = this->Generation;
+    this->WorkerIds[i] = this->Threader->SpawnThread( vtkCUDAHostThreadPool::WorkerEntry, &(this->Arguments[i]) );
+    }
+  }
+
+void vtkCUDAHostThreadPool::StopWorkers()
+  {
+  this->StateLock->Lock();
+  this->Shutdown = true;
+  this->WorkReady->Broadcast();
+  this->StateLock->Unlock();
+
+  for( int i = 1; i < VTK_MAX_THREADS; i++ )
+    {
+    if( this->WorkerIds[i] != -1 )
+      this->Threader->TerminateThread( this->WorkerIds[i] );
+    this->WorkerIds[i] = -1;
+    }
+  }
+
+VTK_THREAD_RETURN_TYPE vtkCUDAHostThreadPool::WorkerEntry(void* arg)
+  {
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  WorkerArgument* worker = static_cast<WorkerArgument*>(info->UserData);
+  vtkCUDAHostThreadPool* self = worker->Pool;
+
+  unsigned int seenGeneration = worker->Generation;
+  self->StateLock->Lock();
+  while( true )
+    {
+    //sleep until a new batch is published or we are told to leave
+    while( !self->Shutdown && self->Generation == seenGeneration )
+      self->WorkReady->Wait( *(self->StateLock) );
+    if( self->Shutdown )
+      break;
+    seenGeneration = self->Generation;
+    self->StateLock->Unlock();
+
+    self->RunWorker(worker->Thread);
+
+    //tell the caller when the last worker is done with the batch
+    self->StateLock->Lock();
+    self->Pending--;
+    if( self->Pending == 0 )
+      self->WorkDone->Broadcast();
+    }
+  self->StateLock->Unlock();
+
+  return VTK_THREAD_RETURN_VALUE;
+  }
+
+bool vtkCUDAHostThreadPool::NextTask(int thread, int& task)
+  {
+  //take the next task from the front of our own range
+  TaskRange& own = this->Ranges[thread];
+  own.Lock->Lock();
+  if( own.Begin < own.End )
+    {
+    task = own.Begin++;
+    own.Lock->Unlock();
+    return true;
+    }
+  own.Lock->Unlock();
+
+  //our range is empty, so steal the back half of the fullest remaining range
+  while( true )
+    {
+    int victim = -1;
+    int victimSize = 0;
+    for( int i = 0; i < this->NumberOfThreads; i++ )
+      {
+      //the owner and the other thieves move the bounds of a range, so they are only read under its lock
+      if( i == thread ) continue;
+      TaskRange& range = this->Ranges[i];
+      range.Lock->Lock();
+      int size = range.End - range.Begin;
+      range.Lock->Unlock();
+      if( size > victimSize )
+        {
+        victim = i;
+        victimSize = size;
+        }
+      }
+    if( victim == -1 )
+      return false;
+
+    TaskRange& other = this->Ranges[victim];
+    other.Lock->Lock();
+    int remaining = other.End - other.Begin;
+    if( remaining <= 0 )
+      {
+      //someone beat us to it, look again
+      other.Lock->Unlock();
+      continue;
+      }
+    int stolen = (remaining + 1) / 2;
+    int stolenBegin = other.End - stolen;
+    other.End = stolenBegin;
+    other.Lock->Unlock();
+
+    //run the first stolen task now, keep the rest where others can steal them back
+    own.Lock->Lock();
+    own.Begin = stolenBegin + 1;
+    own.End = stolenBegin + stolen;
+    own.Lock->Unlock();
+    task = stolenBegin;
+    return true;
+    }
+  }
+
+void vtkCUDAHostThreadPool::RunWorker(int thread)
+  {
+  int task = 0;
+  while( this->NextTask(thread, task) )
+    this->Task(task, thread, this->UserData);
+  }
+
+void vtkCUDAHostThreadPool::ParallelFor(int numberOfTasks, vtkCUDAHostThreadPoolTask task, void* userData)
+  {
+  if( numberOfTasks <= 0 || !task )
+    return;
+
+  //small batches are not worth waking anybody up for
+  if( this->NumberOfThreads == 1 || numberOfTasks == 1 )
+    {
+    for( int i = 0; i < numberOfTasks; i++ )
+      task(i, 0, userData);
+    return;
+    }
+
+  this->BatchLock->Lock();
+
+  //deal out contiguous ranges of tasks
+  int n = this->NumberOfThreads;
+  for( int i = 0; i < n; i++ )
+    {
+    this->Ranges[i].Lock->Lock();
+    this->Ranges[i].Begin = (int) (((long long) numberOfTasks * i) / n);
+    this->Ranges[i].End = (int) (((long long) numberOfTasks * (i+1)) / n);
+    this->Ranges[i].Lock->Unlock();
+    }
+  this->Task = task;
+  this->UserData = userData;
+
+  //wake the workers and join in
+  this->StateLock->Lock();
+  this->Pending = n - 1;
+  this->Generation++;
+  this->WorkReady->Broadcast();
+  this->StateLock->Unlock();
+
+  this->RunWorker(0);
+
+  this->StateLock->Lock();
+  while( this->Pending > 0 )
+    this->WorkDone->Wait( *(this->StateLock) );
+  this->StateLock->Unlock();
+
+  this->BatchLock->Unlock();
+  }
@@ -0,0 +1,108 @@
+/** @file vtkCUDAHostThreadPool.h
+*
+*  @brief Header file defining a pool of persistent host threads used by the CPU implementations of the ray casting pipeline
+*
+*  @note Tasks are dealt out to the workers in contiguous ranges, and a worker that runs out of tasks steals half of the
+*        remaining range of the most loaded worker, so uneven tasks (such as 16x16 image tiles) stay balanced
+*
+*/
+
+#ifndef __vtkCUDAHostThreadPool_h
+#define __vtkCUDAHostThreadPool_h
+
+// CUDA Volume Rendering includes
+#include "CUDAVolumeRenderingLibExport.h"
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+class vtkConditionVariable;
+class vtkSimpleMutexLock;
+
+/** @brief Signature of a task run by the pool
+*
+*  @param task The index of the task, between 0 and the number of tasks (exclusive)
+*  @param thread The index of the worker running the task, between 0 and GetNumberOfThreads() (exclusive)
+*  @param userData The pointer given to ParallelFor
+*/
+typedef void (*vtkCUDAHostThreadPoolTask)(int task, int thread, void* userData);
+
+/** @brief vtkCUDAHostThreadPool runs batches of independent tasks on a set of persistent host threads
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDAHostThreadPool
+  : public vtkObject
+{
+public:
+
+  vtkTypeMacro (vtkCUDAHostThreadPool,vtkObject);
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDAHostThreadPool* New();
+
+  /** @brief Sets the number of threads (including the calling thread) used for each batch of tasks
+  *
+  *  @param n The number of threads, clamped between 1 and VTK_MAX_THREADS
+  */
+  void SetNumberOfThreads(int n);
+  int GetNumberOfThreads() { return this->NumberOfThreads; }
+
+  /** @brief Runs task(i, thread, userData) for every i in [0, numberOfTasks) and returns once all of them are complete
+  *
+  *  @note The calling thread takes part in the work. Calls from different threads are serialized.
+  */
+  void ParallelFor(int numberOfTasks, vtkCUDAHostThreadPoolTask task, void* userData);
+
+protected:
+  vtkCUDAHostThreadPool();
+  ~vtkCUDAHostThreadPool();
+
+  void StartWorkers();
+  void StopWorkers();
+  void RunWorker(int thread);
+  bool NextTask(int thread, int& task);
+
+  static VTK_THREAD_RETURN_TYPE WorkerEntry(void* arg);
+
+private:
+  vtkCUDAHostThreadPool& operator=(const vtkCUDAHostThreadPool&); /**< not implemented */
+  vtkCUDAHostThreadPool(const vtkCUDAHostThreadPool&); /**< not implemented */
+
+  /** @brief The part of the current batch still owned by one worker */
+  struct TaskRange
+    {
+    vtkSimpleMutexLock* Lock;
+    int Begin;
+    int End;
+    };
+
+  /** @brief Argument handed to a spawned worker */
+  struct WorkerArgument
+    {
+    vtkCUDAHostThreadPool* Pool;
+    int Thread;
+    unsigned int Generation; /**< The last batch the worker has seen */
+    };
+
+  int NumberOfThreads;              /**< Number of threads taking part in a batch, including the caller */
+  vtkMultiThreader* Threader;       /**< Spawns and joins the persistent workers */
+  int WorkerIds[VTK_MAX_THREADS];   /**< Thread identifiers of the spawned workers */
+  TaskRange Ranges[VTK_MAX_THREADS];/**< Per-thread task ranges of the current batch */
+  WorkerArgument Arguments[VTK_MAX_THREADS]; /**< Arguments of the spawned workers */
+
+  vtkSimpleMutexLock* BatchLock;    /**< Serializes calls to ParallelFor */
+  vtkSimpleMutexLock* StateLock;    /**< Protects the generation, pending and shutdown state */
+  vtkConditionVariable* WorkReady;  /**< Signalled when a new batch is published */
+  vtkConditionVariable* WorkDone;   /**< Signalled when the last worker leaves a batch */
+
+  unsigned int Generation;          /**< Counter identifying the current batch */
+  int Pending;                      /**< Number of spawned workers still inside the current batch */
+  bool Shutdown;                    /**< Set when the workers should exit */
+
+  vtkCUDAHostThreadPoolTask Task;   /**< Task of the current batch */
+  void* UserData;                   /**< User data of the current batch */
+};
+
+#endif
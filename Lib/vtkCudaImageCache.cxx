@@ -0,0 +1,89 @@
+/** @file vtkCUDAImageCache.cxx
+*
+*  @brief The cache of the images last rendered by a volume mapper, by the state they were rendered in
+*
+*/
+
+#include "vtkCUDAImageCache.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+vtkStandardNewMacro(vtkCUDAImageCache);
+
+bool vtkCUDAImageCache::Key::operator==(const Key& other) const
+  {
+  if( this->Volume != other.Volume || this->Renderer != other.Renderer ) return false;
+  if( this->Resolution[0] != other.Resolution[0] || this->Resolution[1] != other.Resolution[1] ) return false;
+  if( this->SampleDistanceFactor != other.SampleDistanceFactor ) return false;
+  if( this->SettingsMTime != other.SettingsMTime || this->PropertyMTime != other.PropertyMTime ||
+      this->DataMTime != other.DataMTime || this->ClippingMTime != other.ClippingMTime ||
+      this->GeometryMTime != other.GeometryMTime || this->NumberOfOpaqueProps != other.NumberOfOpaqueProps ) return false;
+  for( int i = 0; i < 16; i++ )
+    if( this->ViewToVoxels[i] != other.ViewToVoxels[i] ) return false;
+  return true;
+  }
+
+vtkCUDAImageCache::vtkCUDAImageCache()
+  {
+  this->Hits = 0;
+  this->Misses = 0;
+  this->Capacity = 4;
+  }
+
+void vtkCUDAImageCache::SetCapacity(int capacity)
+  {
+  this->Capacity = (capacity < 0) ? 0 : capacity;
+  this->Clear();
+  }
+
+const uchar4* vtkCUDAImageCache::Lookup(const Key& key)
+  {
+  for( std::list<Entry>::iterator it = this->Images.begin(); it != this->Images.end(); it++ )
+    {
+    if( it->State != key ) continue;
+    this->Hits++;
+    this->Images.splice(this->Images.begin(), this->Images, it);
+    return &(this->Images.front().Image[0]);
+    }
+  this->Misses++;
+  return 0;
+  }
+
+const uchar4* vtkCUDAImageCache::Find(const Key& key) const
+  {
+  for( std::list<Entry>::const_iterator it = this->Images.begin(); it != this->Images.end(); it++ )
+    if( it->State == key ) return &(it->Image[0]);
+  return 0;
+  }
+
+uchar4* vtkCUDAImageCache::Insert(const Key& key)
+  {
+  const size_t numberOfPixels = (size_t) key.Resolution[0] * (size_t) key.Resolution[1];
+  if( this->Capacity < 1 || numberOfPixels == 0 ) return 0;
+
+  //the least recently used image makes room, its memory being reused when the resolution has not changed
+  if( (int) this->Images.size() < this->Capacity )
+    this->Images.push_front(Entry());
+  else
+    this->Images.splice(this->Images.begin(), this->Images, --this->Images.end());
+  Entry& entry = this->Images.front();
+  entry.State = key;
+  entry.Image.resize(numberOfPixels);
+  return &(entry.Image[0]);
+  }
+
+void vtkCUDAImageCache::Remove(const Key& key)
+  {
+  for( std::list<Entry>::iterator it = this->Images.begin(); it != this->Images.end(); it++ )
+    {
+    if( it->State != key ) continue;
+    this->Images.erase(it);
+    return;
+    }
+  }
+
+void vtkCUDAImageCache::Clear()
+  {
+  this->Images.clear();
+  }
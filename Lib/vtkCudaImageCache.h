@@ -0,0 +1,125 @@
+/** @file vtkCUDAImageCache.h
+*
+*  @brief Header file defining the cache of the images last rendered by a volume mapper, by the state they were rendered in
+*
+*  @note The mapper keys each image on everything that changes what it renders (camera, volume, transfer functions,
+*        clipping, data and viewport), so an image whose state comes round again is displayed without being cast again
+*
+*/
+
+#ifndef __vtkCUDAImageCache_h
+#define __vtkCUDAImageCache_h
+
+// CUDA Volume Rendering includes
+#include "CUDAVolumeRenderingLibExport.h"
+#include "vector_types.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <list>
+#include <vector>
+
+/** @brief vtkCUDAImageCache holds host copies of the output images of recent states, evicting the least recently used
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDAImageCache
+  : public vtkObject
+{
+public:
+
+  vtkTypeMacro (vtkCUDAImageCache,vtkObject);
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDAImageCache* New();
+
+  /** @brief The state an image is rendered in, two images rendered in equal states being the same
+  *
+  *  @note The matrices and resolution are compared by value, so a camera brought back to a preset view finds its image,
+  *        while everything else is compared by its modification time
+  */
+  struct Key
+    {
+    const void* Volume;             /**< The volume rendered, by identity */
+    const void* Renderer;           /**< The renderer rendered into, by identity */
+    double ViewToVoxels[16];        /**< The view to voxels matrix, following the camera, the volume matrix and the image geometry */
+    unsigned int Resolution[2];     /**< The output image resolution, following the viewport */
+    float SampleDistanceFactor;     /**< The sample distance factor of the quality level in use */
+    unsigned long SettingsMTime;    /**< The last modification of the mapper by anything but the camera and volume matrices */
+    unsigned long PropertyMTime;    /**< The last modification of the volume property, transfer functions included */
+    unsigned long DataMTime;        /**< The last modification of the image data rendered, fused volumes included */
+    unsigned long ClippingMTime;    /**< The last modification of the clipping planes */
+    unsigned long GeometryMTime;    /**< The last modification of the opaque props the rays stop at */
+    int NumberOfOpaqueProps;        /**< The number of those opaque props */
+
+    bool operator==(const Key& other) const;
+    bool operator!=(const Key& other) const { return !(*this == other); }
+    };
+
+  /** @brief Sets the number of images held at once, emptying the cache
+  *
+  *  @param capacity The number of images, 0 holding none
+  */
+  void SetCapacity(int capacity);
+  int GetCapacity() const { return this->Capacity; }
+
+  /** @brief Gets the number of images held */
+  int GetNumberOfImages() const { return (int) this->Images.size(); }
+
+  /** @brief Finds the image of a state about to be rendered, counting a hit or a miss and making it the most recently used
+  *
+  *  @return The image, at the resolution of the key, or null if it is to be rendered
+  */
+  const uchar4* Lookup(const Key& key);
+
+  /** @brief Finds the image of a state without counting or reordering anything
+  *
+  *  @return The image, or null
+  */
+  const uchar4* Find(const Key& key) const;
+
+  /** @brief Makes room for the image of a state, the most recently used, evicting the least recently used if the cache is full
+  *
+  *  @param key The state, which is not held
+  *
+  *  @return The image to copy into, at the resolution of the key, or null if the cache holds no image
+  */
+  uchar4* Insert(const Key& key);
+
+  /** @brief Forgets the image of a state, such as one that could not be copied after all */
+  void Remove(const Key& key);
+
+  /** @brief Forgets every image, releasing their memory */
+  void Clear();
+
+  /** @brief Gets the statistics of Lookup since the last reset */
+  int GetNumberOfHits() const { return this->Hits; }
+  int GetNumberOfMisses() const { return this->Misses; }
+  double GetHitRate() const { return (this->Hits + this->Misses > 0) ? (double) this->Hits / (double) (this->Hits + this->Misses) : 0.0; }
+  void ResetStatistics() { this->Hits = this->Misses = 0; }
+
+protected:
+  vtkCUDAImageCache();
+  ~vtkCUDAImageCache() {}
+
+private:
+  vtkCUDAImageCache& operator=(const vtkCUDAImageCache&); /**< not implemented */
+  vtkCUDAImageCache(const vtkCUDAImageCache&); /**< not implemented */
+
+  /** @brief An image held, and the state it was rendered in */
+  struct Entry
+    {
+    Key State;
+    std::vector<uchar4> Image;
+    };
+
+  int Capacity;                   /**< The number of images held at most */
+  std::list<Entry> Images;        /**< The images held, the most recently used first */
+  int Hits;                       /**< The lookups finding their image held */
+  int Misses;                     /**< The lookups having to render their image */
+};
+
+#endif
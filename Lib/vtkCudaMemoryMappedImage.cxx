@@ -0,0 +1,136 @@
+/** @file vtkCUDAMemoryMappedImage.cxx
+*
+*  @brief An image data object whose voxels are a raw file mapped into memory
+*
+*/
+
+#include "vtkCUDAMemoryMappedImage.h"
+#include "CPU_vtkCUDAVolumeMapper_packImage.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+vtkStandardNewMacro(vtkCUDAMemoryMappedImage);
+
+class vtkCUDAMemoryMappedImage::vtkInternals
+{
+public:
+  vtkInternals()
+    {
+    this->Base = 0;
+    this->Bytes = 0;
+#ifdef _WIN32
+    this->File = INVALID_HANDLE_VALUE;
+    this->Mapping = 0;
+#endif
+    }
+
+  void* Base;           /**< The first byte of the file in memory */
+  size_t Bytes;         /**< The size of the mapping */
+#ifdef _WIN32
+  HANDLE File;          /**< The file mapped */
+  HANDLE Mapping;       /**< The mapping object of the file */
+#endif
+};
+
+vtkCUDAMemoryMappedImage::vtkCUDAMemoryMappedImage()
+  {
+  this->Internals = new vtkInternals;
+  this->Output = vtkImageData::New();
+  }
+
+vtkCUDAMemoryMappedImage::~vtkCUDAMemoryMappedImage()
+  {
+  this->Close();
+  this->Output->UnRegister( this );
+  delete this->Internals;
+  }
+
+bool vtkCUDAMemoryMappedImage::Open(const char* fileName, const int dimensions[3], int scalarType, unsigned long headerBytes)
+  {
+  this->Close();
+  const size_t scalarSize = CPU_vtkCUDAVolumeMapper_scalarSize(scalarType);
+  if( !fileName || scalarSize == 0 || dimensions[0] < 1 || dimensions[1] < 1 || dimensions[2] < 1 )
+    {
+    vtkErrorMacro(<< "Invalid raw volume description.");
+    return false;
+    }
+  const size_t numberOfVoxels = (size_t) dimensions[0] * (size_t) dimensions[1] * (size_t) dimensions[2];
+  const size_t bytes = (size_t) headerBytes + numberOfVoxels * scalarSize;
+
+  //map the whole file read only, leaving the paging to the operating system
+  vtkInternals* mapping = this->Internals;
+#ifdef _WIN32
+  mapping->File = CreateFileA( fileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, 0 );
+  LARGE_INTEGER fileSize;
+  if( mapping->File == INVALID_HANDLE_VALUE || !GetFileSizeEx(mapping->File, &fileSize) || (ULONGLONG) fileSize.QuadPart < bytes )
+    {
+    vtkErrorMacro(<< "Cannot map " << fileName << " as " << numberOfVoxels << " voxels.");
+    this->Close();
+    return false;
+    }
+  mapping->Mapping = CreateFileMappingA( mapping->File, 0, PAGE_READONLY, 0, 0, 0 );
+  mapping->Base = mapping->Mapping ? MapViewOfFile( mapping->Mapping, FILE_MAP_READ, 0, 0, bytes ) : 0;
+#else
+  int file = open( fileName, O_RDONLY );
+  struct stat status;
+  if( file == -1 || fstat(file, &status) != 0 || (size_t) status.st_size < bytes )
+    {
+    vtkErrorMacro(<< "Cannot map " << fileName << " as " << numberOfVoxels << " voxels.");
+    if( file != -1 ) close( file );
+    return false;
+    }
+  mapping->Base = mmap( 0, bytes, PROT_READ, MAP_SHARED, file, 0 );
+  if( mapping->Base == MAP_FAILED ) mapping->Base = 0;
+  close( file );
+#endif
+  if( !mapping->Base )
+    {
+    vtkErrorMacro(<< "Cannot map " << fileName << " into memory.");
+    this->Close();
+    return false;
+    }
+  mapping->Bytes = bytes;
+
+  //wrap the voxels without copying them, the array never freeing them
+  vtkDataArray* scalars = vtkDataArray::CreateDataArray( scalarType );
+  scalars->SetNumberOfComponents( 1 );
+  scalars->SetVoidArray( (char*) mapping->Base + headerBytes, (vtkIdType) numberOfVoxels, 1 );
+  this->Output->SetDimensions( dimensions[0], dimensions[1], dimensions[2] );
+  this->Output->SetWholeExtent( this->Output->GetExtent() );
+  this->Output->SetScalarType( scalarType );
+  this->Output->SetNumberOfScalarComponents( 1 );
+  this->Output->GetPointData()->SetScalars( scalars );
+  scalars->Delete();
+  this->Output->Modified();
+  return true;
+  }
+
+void vtkCUDAMemoryMappedImage::Close()
+  {
+  vtkInternals* mapping = this->Internals;
+  if( mapping->Base ) this->Output->Initialize();
+#ifdef _WIN32
+  if( mapping->Base ) UnmapViewOfFile( mapping->Base );
+  if( mapping->Mapping ) CloseHandle( mapping->Mapping );
+  if( mapping->File != INVALID_HANDLE_VALUE ) CloseHandle( mapping->File );
+  mapping->Mapping = 0;
+  mapping->File = INVALID_HANDLE_VALUE;
+#else
+  if( mapping->Base ) munmap( mapping->Base, mapping->Bytes );
+#endif
+  mapping->Base = 0;
+  mapping->Bytes = 0;
+  }
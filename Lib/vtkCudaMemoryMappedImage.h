@@ -0,0 +1,71 @@
+/** @file vtkCUDAMemoryMappedImage.h
+*
+*  @brief Header file defining an image data object whose voxels are a raw file mapped into memory
+*
+*  @note Nothing is read when the file is opened, the operating system paging the voxels in as they are touched, so a
+*        bricked mapper only brings in the bricks its rays reach (along with one pass over the volume when it is loaded)
+*
+*/
+
+#ifndef __vtkCUDAMemoryMappedImage_h
+#define __vtkCUDAMemoryMappedImage_h
+
+// CUDA Volume Rendering includes
+#include "CUDAVolumeRenderingLibExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+class vtkImageData;
+
+/** @brief vtkCUDAMemoryMappedImage maps a raw volume file into memory, and wraps it into image data without copying it
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDAMemoryMappedImage
+  : public vtkObject
+{
+public:
+
+  vtkTypeMacro (vtkCUDAMemoryMappedImage,vtkObject);
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDAMemoryMappedImage* New();
+
+  /** @brief Maps a raw file of single component voxels, x fastest, closing the file mapped before
+  *
+  *  @param fileName The file to map, read only
+  *  @param dimensions The number of voxels along each axis
+  *  @param scalarType The VTK scalar type of the voxels, in the byte order of the host
+  *  @param headerBytes The number of bytes before the first voxel
+  *
+  *  @return false if the file cannot be mapped or is too small for the voxels
+  */
+  bool Open(const char* fileName, const int dimensions[3], int scalarType, unsigned long headerBytes = 0);
+
+  /** @brief Unmaps the file, the output being emptied
+  *
+  *  @pre The output is not being rendered anymore
+  */
+  void Close();
+
+  /** @brief Gets the image data wrapping the voxels of the file, empty unless a file is open
+  *
+  *  @note The spacing and origin are those of the output, which can be set as for any image data
+  */
+  vtkImageData* GetOutput() { return this->Output; }
+
+protected:
+  vtkCUDAMemoryMappedImage();
+  ~vtkCUDAMemoryMappedImage();
+
+private:
+  vtkCUDAMemoryMappedImage& operator=(const vtkCUDAMemoryMappedImage&); /**< not implemented */
+  vtkCUDAMemoryMappedImage(const vtkCUDAMemoryMappedImage&); /**< not implemented */
+
+  class vtkInternals;
+  vtkInternals* Internals;        /**< The handles of the mapping, which depend on the platform */
+  vtkImageData* Output;           /**< The image data wrapping the mapped voxels */
+};
+
+#endif
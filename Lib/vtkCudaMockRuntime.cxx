@@ -0,0 +1,649 @@
+/** @file vtkCUDAMockRuntime.cxx
+*
+*  @brief A CUDA runtime that keeps the device memory in host memory and counts the calls made to it
+*
+*/
+
+#include "vtkCUDAMockRuntime.h"
+
+// VTK includes
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cstdlib>
+#include <cstring>
+
+vtkStandardNewMacro(vtkCUDAMockRuntime);
+
+vtkCUDAMockRuntime::vtkCUDAMockRuntime()
+  {
+  this->Lock = new vtkSimpleMutexLock();
+  this->NumberOfDevices = 1;
+  this->DeviceMemory = (size_t) 1 << 30;
+  this->LastError = cudaSuccess;
+  this->DeviceBytes = 0;
+  this->NextTexture = 1;
+  this->ResetCounters();
+  }
+
+vtkCUDAMockRuntime::~vtkCUDAMockRuntime()
+  {
+  //whatever is still alive was leaked by its owner, but is not leaked by the mock
+  for( std::map<void*,MemoryBlock>::iterator it = this->DeviceMemoryBlocks.begin(); it != this->DeviceMemoryBlocks.end(); it++ )
+    free( it->first );
+  for( std::map<void*,size_t>::iterator it = this->HostMemoryBlocks.begin(); it != this->HostMemoryBlocks.end(); it++ )
+    free( it->first );
+  for( std::map<cudaArray*,ArrayBlock>::iterator it = this->Arrays.begin(); it != this->Arrays.end(); it++ )
+    free( it->first );
+  for( std::map<cudaStream_t,int>::iterator it = this->Streams.begin(); it != this->Streams.end(); it++ )
+    delete reinterpret_cast<char*>( it->first );
+  for( std::map<cudaEvent_t,double>::iterator it = this->Events.begin(); it != this->Events.end(); it++ )
+    delete reinterpret_cast<char*>( it->first );
+  delete this->Lock;
+  }
+
+void vtkCUDAMockRuntime::SetNumberOfDevices( int devices )
+  {
+  devices = (devices > 0) ? devices : 0;
+  if( devices == this->NumberOfDevices ) return;
+  this->NumberOfDevices = devices;
+  this->Modified();
+  }
+
+void vtkCUDAMockRuntime::SetDeviceMemory( size_t bytes )
+  {
+  if( bytes == this->DeviceMemory ) return;
+  this->DeviceMemory = bytes;
+  this->Modified();
+  }
+
+void vtkCUDAMockRuntime::ResetCounters()
+  {
+  this->Lock->Lock();
+  this->Allocations = 0;
+  this->Frees = 0;
+  this->HostAllocations = 0;
+  this->StreamsCreated = 0;
+  this->EventsCreated = 0;
+  this->Synchronizations = 0;
+  this->EventWaits = 0;
+  this->DeviceResets = 0;
+  this->InvalidCalls = 0;
+  for( int i = 0; i < 4; i++ )
+    this->BytesCopied[i] = 0;
+  this->PeakDeviceBytes = this->DeviceBytes;
+  this->Lock->Unlock();
+  }
+
+int vtkCUDAMockRuntime::GetCurrentDevice()
+  {
+  std::map<vtkMultiThreaderIDType,int>::iterator it = this->CurrentDevices.find( vtkMultiThreader::GetCurrentThreadID() );
+  return (it == this->CurrentDevices.end()) ? 0 : it->second;
+  }
+
+size_t vtkCUDAMockRuntime::GetUsedBytes( int device )
+  {
+  size_t used = 0;
+  for( std::map<void*,MemoryBlock>::iterator it = this->DeviceMemoryBlocks.begin(); it != this->DeviceMemoryBlocks.end(); it++ )
+    if( it->second.Device == device ) used += it->second.Size;
+  for( std::map<cudaArray*,ArrayBlock>::iterator it = this->Arrays.begin(); it != this->Arrays.end(); it++ )
+    if( it->second.Device == device ) used += it->second.Size;
+  return used;
+  }
+
+bool vtkCUDAMockRuntime::IsDeviceRange( const void* pointer, size_t count )
+  {
+  //the block holding the pointer is the last one starting at or before it
+  std::map<void*,MemoryBlock>::iterator it = this->DeviceMemoryBlocks.upper_bound( const_cast<void*>(pointer) );
+  if( it == this->DeviceMemoryBlocks.begin() ) return false;
+  it--;
+  const size_t offset = (size_t) ((const char*) pointer - (const char*) it->first);
+  return offset + count <= it->second.Size;
+  }
+
+char* vtkCUDAMockRuntime::GetRowAddress( cudaArray* array, const cudaPitchedPtr& pointer, const cudaPos& position,
+                                         const cudaExtent& extent, size_t y, size_t z )
+  {
+  //arrays are addressed in elements, pitched pointers in bytes along x and in rows along y
+  if( !array )
+    return (char*) pointer.ptr + ((position.z + z) * pointer.ysize + position.y + y) * pointer.pitch + position.x;
+  const ArrayBlock& block = this->Arrays[array];
+  const size_t depth = extent.depth ? extent.depth : 1;
+  const size_t height = extent.height ? extent.height : 1;
+  if( position.x + extent.width > block.Width || position.y + height > block.Height || position.z + depth > block.Depth )
+    return 0;
+  return (char*) array + (((position.z + z) * block.Height + position.y + y) * block.Width + position.x) * block.ElementSize;
+  }
+
+cudaError_t vtkCUDAMockRuntime::Fail( cudaError_t error )
+  {
+  this->InvalidCalls++;
+  this->LastError = error;
+  return error;
+  }
+
+cudaError_t vtkCUDAMockRuntime::GetDeviceCount( int* count )
+  {
+  *count = this->NumberOfDevices;
+  return (this->NumberOfDevices > 0) ? cudaSuccess : cudaErrorNoDevice;
+  }
+
+cudaError_t vtkCUDAMockRuntime::SetDevice( int device )
+  {
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  if( device < 0 || device >= this->NumberOfDevices )
+    result = this->Fail( cudaErrorInvalidDevice );
+  else
+    this->CurrentDevices[vtkMultiThreader::GetCurrentThreadID()] = device;
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::GetDevice( int* device )
+  {
+  this->Lock->Lock();
+  *device = this->GetCurrentDevice();
+  this->Lock->Unlock();
+  return cudaSuccess;
+  }
+
+cudaError_t vtkCUDAMockRuntime::DeviceReset( )
+  {
+  //a reset frees everything allocated on the device and destroys its streams
+  this->Lock->Lock();
+  const int device = this->GetCurrentDevice();
+  for( std::map<void*,MemoryBlock>::iterator it = this->DeviceMemoryBlocks.begin(); it != this->DeviceMemoryBlocks.end(); )
+    {
+    std::map<void*,MemoryBlock>::iterator current = it++;
+    if( current->second.Device != device ) continue;
+    this->DeviceBytes -= current->second.Size;
+    free( current->first );
+    this->DeviceMemoryBlocks.erase( current );
+    }
+  for( std::map<cudaTextureObject_t,cudaArray*>::iterator it = this->Textures.begin(); it != this->Textures.end(); )
+    {
+    std::map<cudaTextureObject_t,cudaArray*>::iterator current = it++;
+    if( this->Arrays[current->second].Device == device ) this->Textures.erase( current );
+    }
+  for( std::map<cudaArray*,ArrayBlock>::iterator it = this->Arrays.begin(); it != this->Arrays.end(); )
+    {
+    std::map<cudaArray*,ArrayBlock>::iterator current = it++;
+    if( current->second.Device != device ) continue;
+    this->DeviceBytes -= current->second.Size;
+    free( current->first );
+    this->Arrays.erase( current );
+    }
+  for( std::map<cudaStream_t,int>::iterator it = this->Streams.begin(); it != this->Streams.end(); )
+    {
+    std::map<cudaStream_t,int>::iterator current = it++;
+    if( current->second != device ) continue;
+    delete reinterpret_cast<char*>( current->first );
+    this->Streams.erase( current );
+    }
+  this->DeviceResets++;
+  this->Lock->Unlock();
+  return cudaSuccess;
+  }
+
+cudaError_t vtkCUDAMockRuntime::GetDeviceProperties( cudaDeviceProp* properties, int device )
+  {
+  if( device < 0 || device >= this->NumberOfDevices )
+    {
+    this->Lock->Lock();
+    cudaError_t result = this->Fail( cudaErrorInvalidDevice );
+    this->Lock->Unlock();
+    return result;
+    }
+  memset( properties, 0, sizeof(cudaDeviceProp) );
+  strncpy( properties->name, "vtkCUDAMockRuntime device", sizeof(properties->name) - 1 );
+  properties->totalGlobalMem = this->DeviceMemory;
+  properties->major = 2;
+  properties->minor = 0;
+  properties->multiProcessorCount = 1;
+  properties->warpSize = 32;
+  properties->maxThreadsPerBlock = 1024;
+  return cudaSuccess;
+  }
+
+cudaError_t vtkCUDAMockRuntime::MemGetInfo( size_t* freeBytes, size_t* totalBytes )
+  {
+  this->Lock->Lock();
+  const size_t used = this->GetUsedBytes( this->GetCurrentDevice() );
+  *totalBytes = this->DeviceMemory;
+  *freeBytes = (used < this->DeviceMemory) ? this->DeviceMemory - used : 0;
+  this->Lock->Unlock();
+  return cudaSuccess;
+  }
+
+cudaError_t vtkCUDAMockRuntime::GetLastError( )
+  {
+  this->Lock->Lock();
+  cudaError_t result = this->LastError;
+  this->LastError = cudaSuccess;
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::Malloc( void** pointer, size_t size )
+  {
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  const size_t used = this->GetUsedBytes( this->GetCurrentDevice() );
+  *pointer = (used + size <= this->DeviceMemory) ? malloc( size ? size : 1 ) : 0;
+  if( !*pointer )
+    {
+    result = this->Fail( cudaErrorMemoryAllocation );
+    }
+  else
+    {
+    MemoryBlock block;
+    block.Size = size;
+    block.Device = this->GetCurrentDevice();
+    this->DeviceMemoryBlocks[*pointer] = block;
+    this->DeviceBytes += size;
+    this->PeakDeviceBytes = (this->DeviceBytes > this->PeakDeviceBytes) ? this->DeviceBytes : this->PeakDeviceBytes;
+    this->Allocations++;
+    }
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::Free( void* pointer )
+  {
+  if( !pointer ) return cudaSuccess;
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  std::map<void*,MemoryBlock>::iterator it = this->DeviceMemoryBlocks.find( pointer );
+  if( it == this->DeviceMemoryBlocks.end() )
+    {
+    result = this->Fail( cudaErrorInvalidDevicePointer );
+    }
+  else
+    {
+    this->DeviceBytes -= it->second.Size;
+    this->DeviceMemoryBlocks.erase( it );
+    free( pointer );
+    this->Frees++;
+    }
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::HostAlloc( void** pointer, size_t size, unsigned int flags )
+  {
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  *pointer = malloc( size ? size : 1 );
+  if( !*pointer )
+    {
+    result = this->Fail( cudaErrorMemoryAllocation );
+    }
+  else
+    {
+    this->HostMemoryBlocks[*pointer] = size;
+    this->HostAllocations++;
+    }
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::FreeHost( void* pointer )
+  {
+  if( !pointer ) return cudaSuccess;
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  std::map<void*,size_t>::iterator it = this->HostMemoryBlocks.find( pointer );
+  if( it == this->HostMemoryBlocks.end() )
+    {
+    result = this->Fail( cudaErrorInvalidHostPointer );
+    }
+  else
+    {
+    this->HostMemoryBlocks.erase( it );
+    free( pointer );
+    }
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::MemcpyAsync( void* destination, const void* source, size_t count, cudaMemcpyKind kind, cudaStream_t stream )
+  {
+  //every pretend memory is host memory, so the copy is done at once whatever its kind
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  if( (stream && this->Streams.count(stream) == 0) || (count && (!destination || !source)) )
+    {
+    result = this->Fail( cudaErrorInvalidValue );
+    }
+  else
+    {
+    memmove( destination, source, count );
+    this->BytesCopied[((int) kind >= 0 && (int) kind < 4) ? (int) kind : 0] += count;
+    }
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::MemsetAsync( void* pointer, int value, size_t count, cudaStream_t stream )
+  {
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  if( !this->IsStream(stream) || (count && !this->IsDeviceRange(pointer, count)) )
+    result = this->Fail( cudaErrorInvalidValue );
+  else
+    memset( pointer, value, count );
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::AllocateArray( cudaArray** array, const cudaChannelFormatDesc* description,
+                                               size_t width, size_t height, size_t depth )
+  {
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  ArrayBlock block;
+  block.Device = this->GetCurrentDevice();
+  block.ElementSize = (size_t) (description->x + description->y + description->z + description->w) / 8;
+  block.Width = width;
+  block.Height = height ? height : 1;
+  block.Depth = depth ? depth : 1;
+  block.Size = block.ElementSize * block.Width * block.Height * block.Depth;
+  const size_t used = this->GetUsedBytes( block.Device );
+  *array = 0;
+  if( !block.Size || used + block.Size > this->DeviceMemory )
+    {
+    result = this->Fail( block.Size ? cudaErrorMemoryAllocation : cudaErrorInvalidValue );
+    }
+  else if( !(*array = (cudaArray*) malloc(block.Size)) )
+    {
+    result = this->Fail( cudaErrorMemoryAllocation );
+    }
+  else
+    {
+    this->Arrays[*array] = block;
+    this->DeviceBytes += block.Size;
+    this->PeakDeviceBytes = (this->DeviceBytes > this->PeakDeviceBytes) ? this->DeviceBytes : this->PeakDeviceBytes;
+    this->Allocations++;
+    }
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::MallocArray( cudaArray** array, const cudaChannelFormatDesc* description, size_t width, size_t height )
+  {
+  return this->AllocateArray( array, description, width, height, 1 );
+  }
+
+cudaError_t vtkCUDAMockRuntime::Malloc3DArray( cudaArray** array, const cudaChannelFormatDesc* description, cudaExtent extent )
+  {
+  return this->AllocateArray( array, description, extent.width, extent.height, extent.depth );
+  }
+
+cudaError_t vtkCUDAMockRuntime::FreeArray( cudaArray* array )
+  {
+  if( !array ) return cudaSuccess;
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  std::map<cudaArray*,ArrayBlock>::iterator it = this->Arrays.find( array );
+  if( it == this->Arrays.end() )
+    {
+    result = this->Fail( cudaErrorInvalidValue );
+    }
+  else
+    {
+    this->DeviceBytes -= it->second.Size;
+    this->Arrays.erase( it );
+    free( array );
+    this->Frees++;
+    }
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::MemcpyToArrayAsync( cudaArray* destination, size_t widthOffset, size_t heightOffset, const void* source,
+                                                    size_t count, cudaMemcpyKind kind, cudaStream_t stream )
+  {
+  //the offset along x is in bytes, and the copy runs on from row to row
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  std::map<cudaArray*,ArrayBlock>::iterator it = this->Arrays.find( destination );
+  const size_t offset = (it == this->Arrays.end()) ? 0 : heightOffset * it->second.Width * it->second.ElementSize + widthOffset;
+  if( it == this->Arrays.end() || !this->IsStream(stream) || (count && !source) || offset + count > it->second.Size )
+    {
+    result = this->Fail( cudaErrorInvalidValue );
+    }
+  else
+    {
+    memmove( (char*) destination + offset, source, count );
+    this->BytesCopied[((int) kind >= 0 && (int) kind < 4) ? (int) kind : 0] += count;
+    }
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::Memcpy3DAsync( const cudaMemcpy3DParms* parameters, cudaStream_t stream )
+  {
+  this->Lock->Lock();
+  cudaArray* sourceArray = parameters->srcArray;
+  cudaArray* destinationArray = parameters->dstArray;
+  if( !this->IsStream(stream) ||
+      (sourceArray ? this->Arrays.count(sourceArray) == 0 : !parameters->srcPtr.ptr) ||
+      (destinationArray ? this->Arrays.count(destinationArray) == 0 : !parameters->dstPtr.ptr) )
+    {
+    cudaError_t result = this->Fail( cudaErrorInvalidValue );
+    this->Lock->Unlock();
+    return result;
+    }
+
+  //copy row by row, the width of the extent being in elements when an array takes part in the copy and in bytes otherwise
+  const cudaExtent& extent = parameters->extent;
+  const size_t elementSize = destinationArray ? this->Arrays[destinationArray].ElementSize :
+                                                (sourceArray ? this->Arrays[sourceArray].ElementSize : 1);
+  const size_t rowBytes = extent.width * elementSize;
+  const size_t height = extent.height ? extent.height : 1;
+  const size_t depth = extent.depth ? extent.depth : 1;
+  for( size_t z = 0; z < depth; z++ )
+    {
+    for( size_t y = 0; y < height; y++ )
+      {
+      char* from = this->GetRowAddress( sourceArray, parameters->srcPtr, parameters->srcPos, extent, y, z );
+      char* to = this->GetRowAddress( destinationArray, parameters->dstPtr, parameters->dstPos, extent, y, z );
+      if( !from || !to )
+        {
+        cudaError_t result = this->Fail( cudaErrorInvalidValue );
+        this->Lock->Unlock();
+        return result;
+        }
+      memmove( to, from, rowBytes );
+      }
+    }
+  this->BytesCopied[((int) parameters->kind >= 0 && (int) parameters->kind < 4) ? (int) parameters->kind : 0] += rowBytes * height * depth;
+  this->Lock->Unlock();
+  return cudaSuccess;
+  }
+
+cudaError_t vtkCUDAMockRuntime::CreateTextureObject( cudaTextureObject_t* texture, const cudaResourceDesc* resource,
+                                                     const cudaTextureDesc* description, const cudaResourceViewDesc* view )
+  {
+  //only textures reading arrays are made by the ray casters
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  *texture = 0;
+  if( resource->resType != cudaResourceTypeArray || this->Arrays.count(resource->res.array.array) == 0 )
+    {
+    result = this->Fail( cudaErrorInvalidValue );
+    }
+  else
+    {
+    *texture = this->NextTexture++;
+    this->Textures[*texture] = resource->res.array.array;
+    }
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::DestroyTextureObject( cudaTextureObject_t texture )
+  {
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  if( this->Textures.erase(texture) == 0 ) result = this->Fail( cudaErrorInvalidValue );
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::StreamCreate( cudaStream_t* stream )
+  {
+  this->Lock->Lock();
+  *stream = reinterpret_cast<cudaStream_t>( new char );
+  this->Streams[*stream] = this->GetCurrentDevice();
+  this->StreamsCreated++;
+  this->Lock->Unlock();
+  return cudaSuccess;
+  }
+
+cudaError_t vtkCUDAMockRuntime::StreamDestroy( cudaStream_t stream )
+  {
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  std::map<cudaStream_t,int>::iterator it = this->Streams.find( stream );
+  if( it == this->Streams.end() )
+    {
+    result = this->Fail( cudaErrorInvalidResourceHandle );
+    }
+  else
+    {
+    delete reinterpret_cast<char*>( stream );
+    this->Streams.erase( it );
+    }
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::StreamSynchronize( cudaStream_t stream )
+  {
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  if( stream && this->Streams.count(stream) == 0 )
+    result = this->Fail( cudaErrorInvalidResourceHandle );
+  else
+    this->Synchronizations++;
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::StreamWaitEvent( cudaStream_t stream, cudaEvent_t event, unsigned int flags )
+  {
+  //the copies being done at once, the event has always completed and the stream goes on
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  if( !this->IsStream(stream) || this->Events.count(event) == 0 )
+    result = this->Fail( cudaErrorInvalidResourceHandle );
+  else
+    this->EventWaits++;
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::EventCreate( cudaEvent_t* event, unsigned int flags )
+  {
+  this->Lock->Lock();
+  *event = reinterpret_cast<cudaEvent_t>( new char );
+  this->Events[*event] = vtkTimerLog::GetUniversalTime();
+  this->EventsCreated++;
+  this->Lock->Unlock();
+  return cudaSuccess;
+  }
+
+cudaError_t vtkCUDAMockRuntime::EventDestroy( cudaEvent_t event )
+  {
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  std::map<cudaEvent_t,double>::iterator it = this->Events.find( event );
+  if( it == this->Events.end() )
+    {
+    result = this->Fail( cudaErrorInvalidResourceHandle );
+    }
+  else
+    {
+    delete reinterpret_cast<char*>( event );
+    this->Events.erase( it );
+    }
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::EventRecord( cudaEvent_t event, cudaStream_t stream )
+  {
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  std::map<cudaEvent_t,double>::iterator it = this->Events.find( event );
+  if( it == this->Events.end() || (stream && this->Streams.count(stream) == 0) )
+    result = this->Fail( cudaErrorInvalidResourceHandle );
+  else
+    it->second = vtkTimerLog::GetUniversalTime();
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::EventSynchronize( cudaEvent_t event )
+  {
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  if( this->Events.count(event) == 0 )
+    result = this->Fail( cudaErrorInvalidResourceHandle );
+  else
+    this->Synchronizations++;
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::EventElapsedTime( float* milliseconds, cudaEvent_t start, cudaEvent_t end )
+  {
+  this->Lock->Lock();
+  cudaError_t result = cudaSuccess;
+  std::map<cudaEvent_t,double>::iterator first = this->Events.find( start );
+  std::map<cudaEvent_t,double>::iterator last = this->Events.find( end );
+  if( first == this->Events.end() || last == this->Events.end() )
+    result = this->Fail( cudaErrorInvalidResourceHandle );
+  else
+    *milliseconds = (float) (1000.0 * (last->second - first->second));
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::GraphicsGLRegisterBuffer( cudaGraphicsResource** resource, unsigned int buffer, unsigned int flags )
+  {
+  *resource = 0;
+  this->Lock->Lock();
+  this->LastError = cudaErrorUnknown;
+  this->Lock->Unlock();
+  return cudaErrorUnknown;
+  }
+
+cudaError_t vtkCUDAMockRuntime::GraphicsUnregisterResource( cudaGraphicsResource* resource )
+  {
+  this->Lock->Lock();
+  cudaError_t result = this->Fail( cudaErrorInvalidResourceHandle );
+  this->Lock->Unlock();
+  return result;
+  }
+
+cudaError_t vtkCUDAMockRuntime::GraphicsMapResources( int count, cudaGraphicsResource** resources, cudaStream_t stream )
+  {
+  return this->GraphicsUnregisterResource( 0 );
+  }
+
+cudaError_t vtkCUDAMockRuntime::GraphicsUnmapResources( int count, cudaGraphicsResource** resources, cudaStream_t stream )
+  {
+  return this->GraphicsUnregisterResource( 0 );
+  }
+
+cudaError_t vtkCUDAMockRuntime::GraphicsResourceGetMappedPointer( void** pointer, size_t* size, cudaGraphicsResource* resource )
+  {
+  *pointer = 0;
+  *size = 0;
+  return this->GraphicsUnregisterResource( 0 );
+  }
@@ -0,0 +1,216 @@
+/** @file vtkCUDAMockRuntime.h
+*
+*  @brief Header file defining a CUDA runtime that keeps the device memory in host memory and counts the calls made to it
+*
+*  @note Handed to vtkCUDADeviceManager::SetRuntime before any CUDA object is created, it lets the device management, the
+*        buffers of the information handlers, the uploads of the ray casters and the CPU backend be exercised on a machine
+*        without a device, and the allocations, copies and synchronizations of a frame be checked against what they should be.
+*        The kernels, which it cannot run, fail to launch and leave the device images as they were.
+*
+*/
+
+#ifndef __vtkCUDAMockRuntime_h
+#define __vtkCUDAMockRuntime_h
+
+// CUDA Volume Rendering includes
+#include "vtkCUDARuntime.h"
+
+// VTK includes
+#include <vtkMultiThreader.h>
+class vtkSimpleMutexLock;
+
+// STD includes
+#include <map>
+
+/** @brief vtkCUDAMockRuntime answers the runtime calls on the host, allocating device and page-locked memory with malloc,
+*          copying with memcpy (at once, whatever the stream), and handing out streams and events that do nothing
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDAMockRuntime
+  : public vtkCUDARuntime
+{
+public:
+
+  vtkTypeMacro (vtkCUDAMockRuntime,vtkCUDARuntime);
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDAMockRuntime* New();
+
+  /** @brief Sets the number of devices the runtime pretends to have, 1 by default
+  *
+  */
+  void SetNumberOfDevices( int devices );
+  int GetNumberOfDevices() { return this->NumberOfDevices; }
+
+  /** @brief Sets the memory each pretend device has, in bytes, 1GB by default, allocations past it failing
+  *
+  */
+  void SetDeviceMemory( size_t bytes );
+  size_t GetDeviceMemory() { return this->DeviceMemory; }
+
+  /** @brief Sets the counters below back to 0, leaving the memory, streams and events that are still alive
+  *
+  */
+  void ResetCounters();
+
+  int GetNumberOfAllocations() { return this->Allocations; }             /**< Device allocations made */
+  int GetNumberOfFrees() { return this->Frees; }                         /**< Device allocations freed */
+  int GetNumberOfHostAllocations() { return this->HostAllocations; }     /**< Page-locked host allocations made */
+  int GetNumberOfStreamsCreated() { return this->StreamsCreated; }       /**< Streams created */
+  int GetNumberOfEventsCreated() { return this->EventsCreated; }         /**< Events created */
+  int GetNumberOfSynchronizations() { return this->Synchronizations; }   /**< Stream and event synchronizations */
+  int GetNumberOfEventWaits() { return this->EventWaits; }               /**< Streams made to wait on an event, without the host waiting */
+  int GetNumberOfDeviceResets() { return this->DeviceResets; }           /**< Devices reset */
+  int GetNumberOfInvalidCalls() { return this->InvalidCalls; }           /**< Calls on a device, pointer, stream or event that does not exist */
+  size_t GetBytesCopiedToDevice() { return this->BytesCopied[cudaMemcpyHostToDevice]; }
+  size_t GetBytesCopiedToHost() { return this->BytesCopied[cudaMemcpyDeviceToHost]; }
+  size_t GetBytesCopiedOnDevice() { return this->BytesCopied[cudaMemcpyDeviceToDevice]; }
+  size_t GetPeakDeviceBytes() { return this->PeakDeviceBytes; }          /**< Most device memory allocated at once */
+
+  /** @brief Gets what is still alive, which the counters leave alone
+  *
+  */
+  size_t GetDeviceBytes() { return this->DeviceBytes; }
+  int GetNumberOfLiveAllocations() { return (int) (this->DeviceMemoryBlocks.size() + this->Arrays.size()); }
+  int GetNumberOfLiveArrays() { return (int) this->Arrays.size(); }
+  int GetNumberOfLiveTextures() { return (int) this->Textures.size(); }
+  int GetNumberOfLiveStreams() { return (int) this->Streams.size(); }
+  int GetNumberOfLiveEvents() { return (int) this->Events.size(); }
+
+  // Devices
+  virtual cudaError_t GetDeviceCount( int* count );
+  virtual cudaError_t SetDevice( int device );
+  virtual cudaError_t GetDevice( int* device );
+  virtual cudaError_t DeviceReset( );
+  virtual cudaError_t GetDeviceProperties( cudaDeviceProp* properties, int device );
+  virtual cudaError_t MemGetInfo( size_t* freeBytes, size_t* totalBytes );
+  virtual cudaError_t GetLastError( );
+
+  // Memory
+  virtual cudaError_t Malloc( void** pointer, size_t size );
+  virtual cudaError_t Free( void* pointer );
+  virtual cudaError_t HostAlloc( void** pointer, size_t size, unsigned int flags );
+  virtual cudaError_t FreeHost( void* pointer );
+  virtual cudaError_t MemcpyAsync( void* destination, const void* source, size_t count, cudaMemcpyKind kind, cudaStream_t stream );
+  virtual cudaError_t MemsetAsync( void* pointer, int value, size_t count, cudaStream_t stream );
+
+  // Arrays and the texture objects reading them
+  virtual cudaError_t MallocArray( cudaArray** array, const cudaChannelFormatDesc* description, size_t width, size_t height );
+  virtual cudaError_t Malloc3DArray( cudaArray** array, const cudaChannelFormatDesc* description, cudaExtent extent );
+  virtual cudaError_t FreeArray( cudaArray* array );
+  virtual cudaError_t MemcpyToArrayAsync( cudaArray* destination, size_t widthOffset, size_t heightOffset, const void* source,
+                                          size_t count, cudaMemcpyKind kind, cudaStream_t stream );
+  virtual cudaError_t Memcpy3DAsync( const cudaMemcpy3DParms* parameters, cudaStream_t stream );
+  virtual cudaError_t CreateTextureObject( cudaTextureObject_t* texture, const cudaResourceDesc* resource,
+                                           const cudaTextureDesc* description, const cudaResourceViewDesc* view );
+  virtual cudaError_t DestroyTextureObject( cudaTextureObject_t texture );
+
+  // Streams and events
+  virtual cudaError_t StreamCreate( cudaStream_t* stream );
+  virtual cudaError_t StreamDestroy( cudaStream_t stream );
+  virtual cudaError_t StreamSynchronize( cudaStream_t stream );
+  virtual cudaError_t StreamWaitEvent( cudaStream_t stream, cudaEvent_t event, unsigned int flags );
+  virtual cudaError_t EventCreate( cudaEvent_t* event, unsigned int flags );
+  virtual cudaError_t EventDestroy( cudaEvent_t event );
+  virtual cudaError_t EventRecord( cudaEvent_t event, cudaStream_t stream );
+  virtual cudaError_t EventSynchronize( cudaEvent_t event );
+  virtual cudaError_t EventElapsedTime( float* milliseconds, cudaEvent_t start, cudaEvent_t end );
+
+  // OpenGL interoperability, which the mock never offers so the image is copied back for display
+  virtual cudaError_t GraphicsGLRegisterBuffer( cudaGraphicsResource** resource, unsigned int buffer, unsigned int flags );
+  virtual cudaError_t GraphicsUnregisterResource( cudaGraphicsResource* resource );
+  virtual cudaError_t GraphicsMapResources( int count, cudaGraphicsResource** resources, cudaStream_t stream );
+  virtual cudaError_t GraphicsUnmapResources( int count, cudaGraphicsResource** resources, cudaStream_t stream );
+  virtual cudaError_t GraphicsResourceGetMappedPointer( void** pointer, size_t* size, cudaGraphicsResource* resource );
+
+protected:
+  vtkCUDAMockRuntime();
+  ~vtkCUDAMockRuntime();
+
+  /** @brief Gets the device current on the calling thread, 0 until it sets one
+  *
+  */
+  int GetCurrentDevice();
+
+  /** @brief Gets the memory allocated on a device
+  *
+  */
+  size_t GetUsedBytes( int device );
+
+  /** @brief Records an error to be given by GetLastError and returns it
+  *
+  */
+  cudaError_t Fail( cudaError_t error );
+
+  /** @brief Allocates an array of width x height x depth elements on the current device
+  *
+  */
+  cudaError_t AllocateArray( cudaArray** array, const cudaChannelFormatDesc* description, size_t width, size_t height, size_t depth );
+
+  /** @brief Checks a stream given to an asynchronous call, the default stream always being valid
+  *
+  */
+  bool IsStream( cudaStream_t stream ) { return !stream || this->Streams.count(stream) != 0; }
+
+  /** @brief Checks that count bytes from pointer lie within a single block of device memory
+  *
+  */
+  bool IsDeviceRange( const void* pointer, size_t count );
+
+private:
+  vtkCUDAMockRuntime& operator=(const vtkCUDAMockRuntime&); /**< not implemented */
+  vtkCUDAMockRuntime(const vtkCUDAMockRuntime&); /**< not implemented */
+
+  /** @brief A block of pretend device memory */
+  struct MemoryBlock
+    {
+    size_t Size;
+    int Device;
+    };
+
+  /** @brief A pretend array, its elements stored row after row and slice after slice */
+  struct ArrayBlock
+    {
+    size_t Size;
+    int Device;
+    size_t ElementSize;
+    size_t Width;
+    size_t Height;
+    size_t Depth;
+    };
+
+  /** @brief Gets the address of a row of a 3D copy in its array or pitched pointer, 0 if it falls outside the array */
+  char* GetRowAddress( cudaArray* array, const cudaPitchedPtr& pointer, const cudaPos& position, const cudaExtent& extent,
+                       size_t y, size_t z );
+
+  vtkSimpleMutexLock* Lock;                                   /**< Guards everything below, the runtime being called from any thread */
+  int NumberOfDevices;
+  size_t DeviceMemory;
+  cudaError_t LastError;
+
+  std::map<vtkMultiThreaderIDType,int> CurrentDevices;        /**< The device each thread set */
+  std::map<void*,MemoryBlock> DeviceMemoryBlocks;             /**< The device memory allocated */
+  std::map<void*,size_t> HostMemoryBlocks;                    /**< The page-locked host memory allocated */
+  std::map<cudaStream_t,int> Streams;                         /**< The streams alive and their device */
+  std::map<cudaEvent_t,double> Events;                        /**< The events alive and when they were last recorded */
+  std::map<cudaArray*,ArrayBlock> Arrays;                     /**< The arrays allocated */
+  std::map<cudaTextureObject_t,cudaArray*> Textures;          /**< The texture objects alive and the array each reads */
+  cudaTextureObject_t NextTexture;
+
+  int Allocations;
+  int Frees;
+  int HostAllocations;
+  int StreamsCreated;
+  int EventsCreated;
+  int Synchronizations;
+  int EventWaits;
+  int DeviceResets;
+  int InvalidCalls;
+  size_t BytesCopied[4];
+  size_t DeviceBytes;
+  size_t PeakDeviceBytes;
+};
+
+#endif
@@ -11,6 +11,7 @@
 #include "vtkCUDAObject.h"
 #include "cuda_runtime_api.h"
 #include "vtkCUDADeviceManager.h"
+#include "vtkCUDARuntime.h"
 
 // VTK includes
 #include <vtkObjectFactory.h>
@@ -34,6 +35,13 @@ vtkCUDAObject::vtkCUDAObject()
   this->DeviceManager = vtkCUDADeviceManager::Singleton();
   this->DeviceStream = 0;
   this->DeviceNumber = 0;
+
+  //without a device, leave the object unassigned so that it can fall back to the host
+  if( this->DeviceManager->GetNumberOfDevices() < 1 )
+    {
+    this->DeviceNumber = -1;
+    return;
+    }
   bool result = this->DeviceManager->GetDevice(this, this->DeviceNumber);
   if(result)
     {
@@ -54,7 +62,9 @@ vtkCUDAObject::vtkCUDAObject()
 vtkCUDAObject::~vtkCUDAObject()
   {
   //synchronize remainder of stream and return control of the device
+  if( this->DeviceNumber == -1 ) return;
   this->CallSyncThreads();
+  this->DeviceManager->ReturnStream( this, this->DeviceStream, this->DeviceNumber );
   this->DeviceManager->ReturnDevice( this, this->DeviceNumber );
   }
 
@@ -156,6 +166,11 @@ cudaStream_t* vtkCUDAObject::GetStream( )
   return this->DeviceStream;
   }
 
+vtkCUDARuntime* vtkCUDAObject::GetRuntime( )
+  {
+  return this->DeviceManager->GetRuntime();
+  }
+
 void vtkCUDAObject::ReplicateObject( vtkCUDAObject* object, int withData )
   {
   int oldDeviceNumber = this->DeviceNumber;
@@ -16,6 +16,7 @@
 #include "CUDAVolumeRenderingLibExport.h"
 #include "vector_types.h"
 class vtkCUDADeviceManager;
+class vtkCUDARuntime;
 
 class CUDA_LIB_EXPORT vtkCUDAObject
 {
@@ -37,6 +38,11 @@ protected:
   virtual void Reinitialize(int withData = 0) = 0;
   virtual void Deinitialize(int withData = 0) = 0;
 
+  /** @brief Gets the runtime the CUDA calls of the host code go through
+  *
+  */
+  vtkCUDARuntime* GetRuntime( );
+
 private:
 
   int DeviceNumber;
@@ -8,6 +8,9 @@
 */
 
 #include "vtkCUDAOutputImageInformationHandler.h"
+#include "CPU_vtkCUDAVolumeMapper_renderAlgo.h"
+#include "CUDA_vtkCUDAVolumeMapper_renderAlgo.h"
+#include "vtkCUDARuntime.h"
 
 #include "vector_functions.h"
 #include "vtkgl.h"
@@ -15,23 +18,60 @@
 
 // vtk base
 #include <vtkObjectFactory.h>
+#include <vtkOpenGL.h>
+#include <vtkOpenGLExtensionManager.h>
+#include <vtkOpenGLRenderWindow.h>
 #include <vtkRayCastImageDisplayHelper.h>
 #include <vtkRenderer.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cmath>
+#include <cstring>
+
+// CUDA includes (after OpenGL)
+#include <cuda_gl_interop.h>
 
 vtkStandardNewMacro(vtkCUDAOutputImageInformationHandler);
 
 vtkCUDAOutputImageInformationHandler::vtkCUDAOutputImageInformationHandler()
   {
   this->Renderer = 0;
+  this->OffScreenImageSize[0] = this->OffScreenImageSize[1] = 0;
   this->Displayer = vtkRayCastImageDisplayHelper::New();
   this->RenderOutputScaleFactor = 1.0f;
   this->OutputImageInfo.resolution.x = this->OutputImageInfo.resolution.y = 0;
+  this->OutputImageInfo.blockSize.x = this->OutputImageInfo.blockSize.y = 16;
+  this->OutputImageInfo.tileOffset.x = this->OutputImageInfo.tileOffset.y = 0;
+  this->OutputImageInfo.tileSize.x = this->OutputImageInfo.tileSize.y = 0;
   this->oldResolution.x = this->oldResolution.y = 0;
-  this->OutputImageInfo.rayIncX = this->OutputImageInfo.rayStartX = 0;
-  this->OutputImageInfo.rayIncY = this->OutputImageInfo.rayStartY = 0;
-  this->OutputImageInfo.rayIncZ = this->OutputImageInfo.rayStartZ = 0;
+  this->OutputImageInfo.rayBuffer = 0;
   this->hostOutputImage = 0;
-  this->deviceOutputImage = 0;
+  this->deviceOutputImages[0] = this->deviceOutputImages[1] = 0;
+  this->hostReadbackImages[0] = this->hostReadbackImages[1] = 0;
+  this->readbackEvents[0] = this->readbackEvents[1] = 0;
+  this->renderedEvents[0] = this->renderedEvents[1] = 0;
+  this->readbackStream = 0;
+  this->readbackIndex = 0;
+  this->previousReadbackValid = false;
+  this->OneFrameLatency = false;
+  this->lastImageValid = false;
+  this->HostRendering = false;
+  this->ProgressiveRendering = false;
+  this->NumberOfAccumulatedPasses = 0;
+  this->hostAccumulationImage = 0;
+  this->deviceAccumulationImage = 0;
+  this->InteropDisplay = true;
+  this->InteropFailed = false;
+  this->UsingInteropDisplay = false;
+  this->PixelBuffer = 0;
+  this->PixelBufferTexture = 0;
+  this->PixelBufferSize.x = this->PixelBufferSize.y = 0;
+  this->PixelBufferResource = 0;
+  this->TiledRendering = false;
+  this->hostTiledImage = 0;
+  this->tileEvents[0] = this->tileEvents[1] = 0;
+  this->tileStarted = false;
   this->oldRenderType = 1;
   this->Reinitialize();
   }
@@ -45,22 +85,25 @@ vtkCUDAOutputImageInformationHandler::~vtkCUDAOutputImageInformationHandler()
 
 void vtkCUDAOutputImageInformationHandler::Deinitialize(int withData)
   {  
-  if(this->OutputImageInfo.numSteps) cudaFree(this->OutputImageInfo.numSteps);
-  if(this->OutputImageInfo.rayIncX) cudaFree(this->OutputImageInfo.rayIncX);
-  if(this->OutputImageInfo.rayIncY) cudaFree(this->OutputImageInfo.rayIncY);
-  if(this->OutputImageInfo.rayIncZ) cudaFree(this->OutputImageInfo.rayIncZ);
-  if(this->OutputImageInfo.rayStartX) cudaFree(this->OutputImageInfo.rayStartX);
-  if(this->OutputImageInfo.rayStartY) cudaFree(this->OutputImageInfo.rayStartY);
-  if(this->OutputImageInfo.rayStartZ) cudaFree(this->OutputImageInfo.rayStartZ);
+  //the pixel buffer stays with the OpenGL context, and is registered again with the next device
+  if(this->PixelBufferResource) this->GetRuntime()->GraphicsUnregisterResource(this->PixelBufferResource);
+  this->PixelBufferResource = 0;
+  this->UsingInteropDisplay = false;
+  this->lastImageValid = false;
+  if(this->OutputImageInfo.rayBuffer) this->GetRuntime()->Free(this->OutputImageInfo.rayBuffer);
   if(this->hostOutputImage) delete this->hostOutputImage;
-  if(this->deviceOutputImage) cudaFree(this->deviceOutputImage);
+  this->FreeReadbackImages();
+  this->FreeTiles();
+  if(this->hostAccumulationImage) delete[] this->hostAccumulationImage;
+  if(this->deviceAccumulationImage) this->GetRuntime()->Free(this->deviceAccumulationImage);
   this->OutputImageInfo.resolution.x = this->OutputImageInfo.resolution.y = 0;
+  this->OutputImageInfo.tileSize.x = this->OutputImageInfo.tileSize.y = 0;
   this->oldResolution.x = this->oldResolution.y = 0;
-  this->OutputImageInfo.rayIncX = this->OutputImageInfo.rayStartX = 0;
-  this->OutputImageInfo.rayIncY = this->OutputImageInfo.rayStartY = 0;
-  this->OutputImageInfo.rayIncZ = this->OutputImageInfo.rayStartZ = 0;
+  this->OutputImageInfo.rayBuffer = 0;
   this->hostOutputImage = 0;
-  this->deviceOutputImage = 0;
+  this->hostAccumulationImage = 0;
+  this->deviceAccumulationImage = 0;
+  this->NumberOfAccumulatedPasses = 0;
   }
 
 void vtkCUDAOutputImageInformationHandler::Reinitialize(int withData)
@@ -78,34 +121,602 @@ vtkRenderer* vtkCUDAOutputImageInformationHandler::GetRenderer()
   return this->Renderer;
   }
 
+void vtkCUDAOutputImageInformationHandler::SetBlockShape(int x, int y)
+  {
+  if( x < 1 || y < 1 ) return;
+  this->OutputImageInfo.blockSize.x = x;
+  this->OutputImageInfo.blockSize.y = y;
+  }
+
+void vtkCUDAOutputImageInformationHandler::SetOffScreenImageSize(int width, int height)
+  {
+  this->OffScreenImageSize[0] = (width > 0 && height > 0) ? width : 0;
+  this->OffScreenImageSize[1] = (width > 0 && height > 0) ? height : 0;
+  this->Update();
+  }
+
 void vtkCUDAOutputImageInformationHandler::SetRenderer(vtkRenderer* renderer)
   {
   this->Renderer = renderer;
   this->Update();
   }
 
-void vtkCUDAOutputImageInformationHandler::Prepare()
+void vtkCUDAOutputImageInformationHandler::SetHostRendering(bool hostRendering)
+  {
+  if( this->HostRendering == hostRendering ) return;
+
+  //drop the buffers of the old backend and allocate those of the new one
+  this->Deinitialize();
+  this->HostRendering = hostRendering;
+  this->Update();
+  }
+
+void vtkCUDAOutputImageInformationHandler::SetOneFrameLatency(bool latency)
+  {
+  this->OneFrameLatency = latency;
+  this->previousReadbackValid = false;
+  }
+
+void vtkCUDAOutputImageInformationHandler::FreeReadbackImages()
+  {
+  //wait for copies still in flight before releasing their buffers
+  if(this->readbackStream)
+    {
+    this->GetRuntime()->StreamSynchronize(this->readbackStream);
+    this->GetRuntime()->StreamDestroy(this->readbackStream);
+    }
+  this->readbackStream = 0;
+  for( int i = 0; i < 2; i++ )
+    {
+    if(this->readbackEvents[i]) this->GetRuntime()->EventDestroy(this->readbackEvents[i]);
+    if(this->renderedEvents[i]) this->GetRuntime()->EventDestroy(this->renderedEvents[i]);
+    if(this->hostReadbackImages[i]) this->GetRuntime()->FreeHost(this->hostReadbackImages[i]);
+    if(this->deviceOutputImages[i]) this->GetRuntime()->Free(this->deviceOutputImages[i]);
+    this->readbackEvents[i] = 0;
+    this->renderedEvents[i] = 0;
+    this->hostReadbackImages[i] = 0;
+    this->deviceOutputImages[i] = 0;
+    }
+  this->readbackIndex = 0;
+  this->previousReadbackValid = false;
+  }
+
+void vtkCUDAOutputImageInformationHandler::FreeTiles()
+  {
+  //the events belong to the device of the handler, and the tiled image may still be copied into
+  for( int i = 0; i < 2; i++ )
+    {
+    if(this->tileEvents[i])
+      {
+      this->GetRuntime()->EventSynchronize(this->tileEvents[i]);
+      this->GetRuntime()->EventDestroy(this->tileEvents[i]);
+      }
+    this->tileEvents[i] = 0;
+    }
+  if(this->hostTiledImage) this->GetRuntime()->FreeHost(this->hostTiledImage);
+  this->hostTiledImage = 0;
+  this->tileStarted = false;
+  }
+
+void vtkCUDAOutputImageInformationHandler::SetTiledRendering(bool tiled)
+  {
+  if( this->TiledRendering == tiled ) return;
+  this->TiledRendering = tiled;
+  if( !tiled && (this->hostTiledImage || this->tileEvents[0]) )
+    {
+    this->ReserveGPU();
+    this->FreeTiles();
+    }
+  this->previousReadbackValid = false;
+  this->lastImageValid = false;
+  }
+
+void vtkCUDAOutputImageInformationHandler::SetTile(int firstRow, int numberOfRows)
+  {
+  const uint2 resolution = this->OutputImageInfo.resolution;
+  firstRow = (firstRow < 0) ? 0 : ((firstRow > (int) resolution.y) ? (int) resolution.y : firstRow);
+  numberOfRows = (numberOfRows < 0) ? 0 : numberOfRows;
+  numberOfRows = (firstRow + numberOfRows > (int) resolution.y) ? (int) resolution.y - firstRow : numberOfRows;
+  this->OutputImageInfo.tileOffset.x = 0;
+  this->OutputImageInfo.tileOffset.y = firstRow;
+  this->OutputImageInfo.tileSize.x = resolution.x;
+  this->OutputImageInfo.tileSize.y = numberOfRows;
+  }
+
+uchar4* vtkCUDAOutputImageInformationHandler::GetTiledImage()
   {
-  this->OutputImageInfo.deviceOutputImage = this->deviceOutputImage;
+  //portable, so every device can copy its tile straight into it
+  if( !this->hostTiledImage && this->OutputImageInfo.resolution.x > 0 && this->OutputImageInfo.resolution.y > 0 )
+    {
+    this->ReserveGPU();
+    if( this->GetRuntime()->HostAlloc( (void**) &(this->hostTiledImage), 4*sizeof(unsigned char)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y,
+                       cudaHostAllocPortable) != cudaSuccess )
+      {
+      this->GetRuntime()->GetLastError();
+      this->hostTiledImage = 0;
+      }
+    }
+  return this->hostTiledImage;
   }
 
-void vtkCUDAOutputImageInformationHandler::Display(vtkVolume* volume, vtkRenderer* renderer)
+void vtkCUDAOutputImageInformationHandler::StartTile()
   {
+  this->ReserveGPU();
+  for( int i = 0; i < 2; i++ )
+    if( !this->tileEvents[i] ) this->GetRuntime()->EventCreate( &(this->tileEvents[i]), cudaEventDefault );
+  this->GetRuntime()->EventRecord( this->tileEvents[0], *(this->GetStream()) );
+  this->tileStarted = true;
+  }
+
+void vtkCUDAOutputImageInformationHandler::ReadBackTile(uchar4* image)
+  {
+  const cudaOutputImageInformation& info = this->OutputImageInfo;
+  if( !image || !this->tileStarted || info.tileSize.y < 1 ) return;
 
+  //the tiles are bands of whole rows, so each one is a single contiguous copy
+  this->ReserveGPU();
+  const size_t offset = (size_t) info.tileOffset.y * (size_t) info.resolution.x;
+  this->GetRuntime()->MemcpyAsync( image + offset, info.deviceOutputImage + offset, 4*sizeof(unsigned char)*info.resolution.x*info.tileSize.y,
+                   cudaMemcpyDeviceToHost, *(this->GetStream()) );
+  this->GetRuntime()->EventRecord( this->tileEvents[1], *(this->GetStream()) );
+  }
+
+double vtkCUDAOutputImageInformationHandler::FinishTile()
+  {
+  if( !this->tileStarted ) return -1.0;
+  this->tileStarted = false;
   this->ReserveGPU();
-  cudaStreamSynchronize(*(this->GetStream()));
+  this->GetRuntime()->EventSynchronize( this->tileEvents[1] );
+  float milliseconds = 0.0f;
+  if( this->GetRuntime()->EventElapsedTime( &milliseconds, this->tileEvents[0], this->tileEvents[1] ) != cudaSuccess )
+    {
+    this->GetRuntime()->GetLastError();
+    return -1.0;
+    }
+  return 0.001 * (double) milliseconds;
+  }
 
-  //if desired, render using the fulling compatible displayer tool
-  cudaMemcpyAsync( this->hostOutputImage, this->deviceOutputImage, 4*sizeof(unsigned char)*this->OutputImageInfo.resolution.x*this->OutputImageInfo.resolution.y, cudaMemcpyDeviceToHost, *(this->GetStream()));
+void vtkCUDAOutputImageInformationHandler::DisplayTiledImage(vtkVolume* volume, vtkRenderer* renderer, cudaRenderStatistics* stats)
+  {
+  if( !this->hostTiledImage ) return;
   int imageMemorySize[2];
   imageMemorySize[0] = this->OutputImageInfo.resolution.x;
   imageMemorySize[1] = this->OutputImageInfo.resolution.y;
   int imageOrigin[2] = {0,0};
-  this->Displayer->RenderTexture(volume,renderer,imageMemorySize,imageMemorySize,imageMemorySize,imageOrigin,0.001,(unsigned char*) this->hostOutputImage);
+  double stageStart = vtkTimerLog::GetUniversalTime();
+  if( this->OffScreenImageSize[0] == 0 )
+    this->Displayer->RenderTexture(volume,renderer,imageMemorySize,imageMemorySize,imageMemorySize,imageOrigin,0.001,(unsigned char*) this->hostTiledImage);
+  if( stats )
+    {
+    stats->DisplayTime = vtkTimerLog::GetUniversalTime() - stageStart;
+    stats->InteropDisplay = 0.0;
+    stats->BytesReadBack = 4.0 * (double) this->OutputImageInfo.resolution.x * (double) this->OutputImageInfo.resolution.y;
+    }
+  }
+
+void vtkCUDAOutputImageInformationHandler::SetInteropDisplay(bool interop)
+  {
+  if( this->InteropDisplay == interop ) return;
+  this->InteropDisplay = interop;
+  this->InteropFailed = false;
+
+  //a converged image is only in the buffer of the old display path
+  this->NumberOfAccumulatedPasses = 0;
+  }
 
+void vtkCUDAOutputImageInformationHandler::ReleaseGraphicsResources()
+  {
+  if(this->PixelBufferResource)
+    {
+    this->ReserveGPU();
+    this->GetRuntime()->GraphicsUnregisterResource(this->PixelBufferResource);
+    }
+  this->PixelBufferResource = 0;
+  if(this->PixelBuffer) vtkgl::DeleteBuffers(1, &(this->PixelBuffer));
+  this->PixelBuffer = 0;
+  if(this->PixelBufferTexture) glDeleteTextures(1, &(this->PixelBufferTexture));
+  this->PixelBufferTexture = 0;
+  this->PixelBufferSize.x = this->PixelBufferSize.y = 0;
+  this->UsingInteropDisplay = false;
+  this->lastImageValid = false;
+
+  //a new context may well support sharing the buffer
+  this->InteropFailed = false;
+  this->NumberOfAccumulatedPasses = 0;
+  }
+
+bool vtkCUDAOutputImageInformationHandler::CreatePixelBuffer(vtkRenderWindow* window)
+  {
+  vtkOpenGLRenderWindow* glWindow = vtkOpenGLRenderWindow::SafeDownCast(window);
+  if( !glWindow ) return false;
+  vtkOpenGLExtensionManager* extensions = glWindow->GetExtensionManager();
+  if( !extensions->ExtensionSupported("GL_VERSION_1_5") ||
+      !extensions->ExtensionSupported("GL_ARB_pixel_buffer_object") ||
+      !extensions->ExtensionSupported("GL_ARB_texture_non_power_of_two") )
+    return false;
+  extensions->LoadExtension("GL_VERSION_1_5");
+  extensions->LoadExtension("GL_VERSION_1_2");
+
+  //drop the buffer of the previous resolution
+  this->ReleaseGraphicsResources();
+  const uint2 resolution = this->OutputImageInfo.resolution;
+
+  //the buffer the rays are cast into, and the texture it is uploaded to
+  vtkgl::GenBuffers(1, &(this->PixelBuffer));
+  vtkgl::BindBuffer(vtkgl::PIXEL_UNPACK_BUFFER_ARB, this->PixelBuffer);
+  vtkgl::BufferData(vtkgl::PIXEL_UNPACK_BUFFER_ARB, 4*sizeof(unsigned char)*resolution.x*resolution.y, 0, vtkgl::STREAM_DRAW);
+  vtkgl::BindBuffer(vtkgl::PIXEL_UNPACK_BUFFER_ARB, 0);
+  glGenTextures(1, &(this->PixelBufferTexture));
+  glBindTexture(GL_TEXTURE_2D, this->PixelBufferTexture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, vtkgl::CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, vtkgl::CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, resolution.x, resolution.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  if( glGetError() != GL_NO_ERROR )
+    {
+    this->ReleaseGraphicsResources();
+    return false;
+    }
+  this->PixelBufferSize = resolution;
+
+  //share the buffer with CUDA, keeping its contents between frames so a converged progressive image can be shown again
   this->ReserveGPU();
-  cudaStreamSynchronize(*(this->GetStream()));
+  if( this->GetRuntime()->GraphicsGLRegisterBuffer(&(this->PixelBufferResource), this->PixelBuffer, cudaGraphicsRegisterFlagsNone) != cudaSuccess )
+    {
+    this->GetRuntime()->GetLastError();
+    this->PixelBufferResource = 0;
+    this->ReleaseGraphicsResources();
+    return false;
+    }
+  return true;
+  }
 
+void vtkCUDAOutputImageInformationHandler::DisplayPixelBuffer()
+  {
+  glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_TEXTURE_BIT | GL_TRANSFORM_BIT | GL_PIXEL_MODE_BIT);
+
+  //upload the pixel buffer to the texture, which stays on the device
+  glBindTexture(GL_TEXTURE_2D, this->PixelBufferTexture);
+  vtkgl::BindBuffer(vtkgl::PIXEL_UNPACK_BUFFER_ARB, this->PixelBuffer);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, this->PixelBufferSize.x, this->PixelBufferSize.y, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  vtkgl::BindBuffer(vtkgl::PIXEL_UNPACK_BUFFER_ARB, 0);
+
+  //cover the renderer's viewport, as vtkRayCastImageDisplayHelper does with the host image
+  glDisable(GL_LIGHTING);
+  glDisable(GL_DEPTH_TEST);
+  glDepthMask(GL_FALSE);
+  glEnable(GL_TEXTURE_2D);
+  glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  glMatrixMode(GL_PROJECTION);
+  glPushMatrix();
+  glLoadIdentity();
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glLoadIdentity();
+  glBegin(GL_QUADS);
+  glTexCoord2f(0.0f, 0.0f); glVertex2f(-1.0f, -1.0f);
+  glTexCoord2f(1.0f, 0.0f); glVertex2f( 1.0f, -1.0f);
+  glTexCoord2f(1.0f, 1.0f); glVertex2f( 1.0f,  1.0f);
+  glTexCoord2f(0.0f, 1.0f); glVertex2f(-1.0f,  1.0f);
+  glEnd();
+  glPopMatrix();
+  glMatrixMode(GL_PROJECTION);
+  glPopMatrix();
+  glMatrixMode(GL_MODELVIEW);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glPopAttrib();
+  }
+
+void vtkCUDAOutputImageInformationHandler::SetProgressiveRendering(bool progressive)
+  {
+  if( this->ProgressiveRendering == progressive ) return;
+  this->ProgressiveRendering = progressive;
+  this->NumberOfAccumulatedPasses = 0;
+
+  //the accumulation images (and the rays the passes reuse) are allocated again on the first pass
+  if( !progressive )
+    {
+    if(this->hostAccumulationImage) delete[] this->hostAccumulationImage;
+    this->hostAccumulationImage = 0;
+    if(this->deviceAccumulationImage || this->OutputImageInfo.rayBuffer)
+      {
+      this->ReserveGPU();
+      if(this->deviceAccumulationImage) this->GetRuntime()->Free(this->deviceAccumulationImage);
+      if(this->OutputImageInfo.rayBuffer) this->GetRuntime()->Free(this->OutputImageInfo.rayBuffer);
+      }
+    this->deviceAccumulationImage = 0;
+    this->OutputImageInfo.rayBuffer = 0;
+    }
+  }
+
+void vtkCUDAOutputImageInformationHandler::Accumulate()
+  {
+  if( !this->ProgressiveRendering ) return;
+  const uint2 resolution = this->OutputImageInfo.resolution;
+  const size_t numberOfPixels = (size_t) resolution.x * (size_t) resolution.y;
+
+  if( this->HostRendering )
+    {
+    if( !this->hostAccumulationImage )
+      {
+      this->hostAccumulationImage = new float4[numberOfPixels];
+      this->NumberOfAccumulatedPasses = 0;
+      }
+    CPU_vtkCUDAVolumeMapper_renderAlgo_accumulateImage(this->hostOutputImage, this->hostAccumulationImage,
+                                                       resolution, this->NumberOfAccumulatedPasses);
+    }
+  else
+    {
+    this->ReserveGPU();
+    if( !this->deviceAccumulationImage )
+      {
+      this->GetRuntime()->Malloc( (void**) &this->deviceAccumulationImage, sizeof(float4)*numberOfPixels );
+      this->NumberOfAccumulatedPasses = 0;
+      }
+    CUDA_vtkCUDAVolumeMapper_renderAlgo_accumulateImage(this->GetRuntime(), this->OutputImageInfo.deviceOutputImage,
+                                                        this->deviceAccumulationImage, resolution,
+                                                        this->NumberOfAccumulatedPasses, this->GetStream());
+    }
+  this->NumberOfAccumulatedPasses++;
+  }
+
+void vtkCUDAOutputImageInformationHandler::Prepare()
+  {
+  //the image about to be rendered overwrites the last one
+  this->lastImageValid = false;
+
+  //the progressive passes composite the same rays again, so they are kept from the first pass in a ray buffer
+  if( this->ProgressiveRendering && !this->HostRendering && !this->OutputImageInfo.rayBuffer &&
+      this->OutputImageInfo.resolution.x > 0 && this->OutputImageInfo.resolution.y > 0 )
+    {
+    this->ReserveGPU();
+    this->GetRuntime()->Malloc( (void**) &this->OutputImageInfo.rayBuffer, 2*sizeof(float4)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
+    this->NumberOfAccumulatedPasses = 0;
+    }
+
+  //the frame is cast into the device image whose readback is not the one in flight, once the copy out of it two frames
+  //ago is done, which the stream waits for on the device
+  const int current = this->readbackIndex;
+  this->OutputImageInfo.deviceOutputImage = this->deviceOutputImages[current];
+  if( !this->HostRendering && this->readbackEvents[current] )
+    {
+    this->ReserveGPU();
+    this->GetRuntime()->StreamWaitEvent( *(this->GetStream()), this->readbackEvents[current], 0 );
+    }
+  this->UsingInteropDisplay = false;
+  if( !this->InteropDisplay || this->InteropFailed || this->HostRendering || this->TiledRendering || !this->Renderer ||
+      this->OffScreenImageSize[0] > 0 ) return;
+
+  //(re)create the pixel buffer at the output resolution, falling back on the host copy for good if it cannot be shared
+  const uint2 resolution = this->OutputImageInfo.resolution;
+  if( !this->PixelBufferResource || this->PixelBufferSize.x != resolution.x || this->PixelBufferSize.y != resolution.y )
+    {
+    if( !this->CreatePixelBuffer(this->Renderer->GetRenderWindow()) )
+      {
+      this->InteropFailed = true;
+      this->NumberOfAccumulatedPasses = 0;
+      vtkWarningMacro(<< "Cannot share a pixel buffer between CUDA and OpenGL - displaying through the host instead.");
+      return;
+      }
+    this->NumberOfAccumulatedPasses = 0;
+    }
+
+  //map the pixel buffer for the rays to be cast straight into it
+  this->ReserveGPU();
+  if( this->GetRuntime()->GraphicsMapResources(1, &(this->PixelBufferResource), *(this->GetStream())) != cudaSuccess )
+    {
+    this->GetRuntime()->GetLastError();
+    this->NumberOfAccumulatedPasses = 0;
+    return;
+    }
+  void* pixels = 0;
+  size_t size = 0;
+  if( this->GetRuntime()->GraphicsResourceGetMappedPointer(&pixels, &size, this->PixelBufferResource) != cudaSuccess ||
+      size < 4*sizeof(unsigned char)*resolution.x*resolution.y )
+    {
+    this->GetRuntime()->GetLastError();
+    this->GetRuntime()->GraphicsUnmapResources(1, &(this->PixelBufferResource), *(this->GetStream()));
+    this->NumberOfAccumulatedPasses = 0;
+    return;
+    }
+  this->OutputImageInfo.deviceOutputImage = (uchar4*) pixels;
+  this->UsingInteropDisplay = true;
+  }
+
+void vtkCUDAOutputImageInformationHandler::Display(vtkVolume* volume, vtkRenderer* renderer, cudaRenderStatistics* stats)
+  {
+
+  int imageMemorySize[2];
+  imageMemorySize[0] = this->OutputImageInfo.resolution.x;
+  imageMemorySize[1] = this->OutputImageInfo.resolution.y;
+  int imageOrigin[2] = {0,0};
+
+  //the host image is already complete when ray casting on the host, and is only textured to the window when not off screen
+  double stageStart = vtkTimerLog::GetUniversalTime();
+  if( this->HostRendering )
+    {
+    if( this->OffScreenImageSize[0] == 0 )
+      this->Displayer->RenderTexture(volume,renderer,imageMemorySize,imageMemorySize,imageMemorySize,imageOrigin,0.001,(unsigned char*) this->hostOutputImage);
+    this->lastImageValid = true;
+    if( stats )
+      {
+      stats->ReadbackTime = 0.0;
+      stats->DisplayTime = vtkTimerLog::GetUniversalTime() - stageStart;
+      stats->InteropDisplay = 0.0;
+      stats->BytesReadBack = 0.0;
+      }
+    return;
+    }
+
+  //the image rendered into the pixel buffer never leaves the device, unmapping it orders the ray casting before OpenGL
+  if( this->UsingInteropDisplay )
+    {
+    this->ReserveGPU();
+    if( stats )
+      {
+      this->GetRuntime()->StreamSynchronize(*(this->GetStream()));
+      stageStart = vtkTimerLog::GetUniversalTime();
+      }
+    this->GetRuntime()->GraphicsUnmapResources(1, &(this->PixelBufferResource), *(this->GetStream()));
+    this->previousReadbackValid = false;
+    if( stats )
+      {
+      double stageEnd = vtkTimerLog::GetUniversalTime();
+      stats->ReadbackTime = stageEnd - stageStart;
+      stageStart = stageEnd;
+      }
+    this->DisplayPixelBuffer();
+    this->lastImageValid = true;
+    if( stats )
+      {
+      glFinish();
+      stats->DisplayTime = vtkTimerLog::GetUniversalTime() - stageStart;
+      stats->InteropDisplay = 1.0;
+      stats->BytesReadBack = 0.0;
+      }
+    return;
+    }
+
+  this->ReserveGPU();
+  if( stats )
+    {
+    //wait for the ray casting so that it is not charged to the readback
+    this->GetRuntime()->StreamSynchronize(*(this->GetStream()));
+    stageStart = vtkTimerLog::GetUniversalTime();
+    }
+
+  //queue the copy on the readback stream behind the ray casting, so the next frame is cast into the other device image while
+  //this one is copied into its page-locked buffer
+  const int current = this->readbackIndex;
+  this->GetRuntime()->EventRecord( this->renderedEvents[current], *(this->GetStream()) );
+  this->GetRuntime()->StreamWaitEvent( this->readbackStream, this->renderedEvents[current], 0 );
+  this->GetRuntime()->MemcpyAsync( this->hostReadbackImages[current], this->deviceOutputImages[current], 4*sizeof(unsigned char)*this->OutputImageInfo.resolution.x*this->OutputImageInfo.resolution.y, cudaMemcpyDeviceToHost, this->readbackStream);
+  this->GetRuntime()->EventRecord( this->readbackEvents[current], this->readbackStream );
+  this->readbackIndex = 1 - current;
+
+  //with one frame of latency the previous frame is shown instead, whose copy has normally finished by now, and only the
+  //copy of the image shown is waited for
+  const int shown = (this->OneFrameLatency && this->previousReadbackValid) ? 1 - current : current;
+  this->previousReadbackValid = true;
+  this->GetRuntime()->EventSynchronize( this->readbackEvents[shown] );
+  if( stats )
+    {
+    double stageEnd = vtkTimerLog::GetUniversalTime();
+    stats->ReadbackTime = stageEnd - stageStart;
+    stageStart = stageEnd;
+    }
+
+  //render using the fully compatible displayer tool
+  if( this->OffScreenImageSize[0] == 0 )
+    this->Displayer->RenderTexture(volume,renderer,imageMemorySize,imageMemorySize,imageMemorySize,imageOrigin,0.001,(unsigned char*) this->hostReadbackImages[shown]);
+  this->lastImageValid = true;
+  if( stats )
+    {
+    stats->DisplayTime = vtkTimerLog::GetUniversalTime() - stageStart;
+    stats->InteropDisplay = 0.0;
+    stats->BytesReadBack = 4.0 * (double) this->OutputImageInfo.resolution.x * (double) this->OutputImageInfo.resolution.y;
+    }
+
+  }
+
+bool vtkCUDAOutputImageInformationHandler::DisplayAgain(vtkVolume* volume, vtkRenderer* renderer, cudaRenderStatistics* stats)
+  {
+  if( !this->lastImageValid ) return false;
+  double stageStart = vtkTimerLog::GetUniversalTime();
+
+  //the pixel buffer was unmapped by Display, so OpenGL can texture it again straight away
+  if( this->UsingInteropDisplay )
+    {
+    this->DisplayPixelBuffer();
+    if( stats ) glFinish();
+    }
+  else
+    {
+    int imageMemorySize[2];
+    imageMemorySize[0] = this->OutputImageInfo.resolution.x;
+    imageMemorySize[1] = this->OutputImageInfo.resolution.y;
+    int imageOrigin[2] = {0,0};
+    uchar4* image = this->hostOutputImage;
+    if( !this->HostRendering )
+      {
+      //the last readback queued, which is only shown by Display a frame later when latency is on
+      const int last = 1 - this->readbackIndex;
+      this->GetRuntime()->EventSynchronize( this->readbackEvents[last] );
+      image = this->hostReadbackImages[last];
+      }
+    if( this->OffScreenImageSize[0] == 0 )
+      this->Displayer->RenderTexture(volume,renderer,imageMemorySize,imageMemorySize,imageMemorySize,imageOrigin,0.001,(unsigned char*) image);
+    }
+
+  if( stats )
+    {
+    stats->ReadbackTime = 0.0;
+    stats->DisplayTime = vtkTimerLog::GetUniversalTime() - stageStart;
+    stats->InteropDisplay = this->UsingInteropDisplay ? 1.0 : 0.0;
+    stats->BytesReadBack = 0.0;
+    }
+  return true;
+  }
+
+bool vtkCUDAOutputImageInformationHandler::CopyLastImage(uchar4* image)
+  {
+  if( !this->lastImageValid ) return false;
+  const size_t imageSize = 4*sizeof(unsigned char)*this->OutputImageInfo.resolution.x*this->OutputImageInfo.resolution.y;
+
+  if( this->HostRendering )
+    {
+    memcpy( image, this->hostOutputImage, imageSize );
+    return true;
+    }
+
+  this->ReserveGPU();
+  if( !this->UsingInteropDisplay )
+    {
+    const int last = 1 - this->readbackIndex;
+    this->GetRuntime()->EventSynchronize( this->readbackEvents[last] );
+    memcpy( image, this->hostReadbackImages[last], imageSize );
+    return true;
+    }
+
+  //the image never left the device, so the pixel buffer is mapped again just to be read back
+  if( this->GetRuntime()->GraphicsMapResources(1, &(this->PixelBufferResource), *(this->GetStream())) != cudaSuccess )
+    {
+    this->GetRuntime()->GetLastError();
+    return false;
+    }
+  void* pixels = 0;
+  size_t size = 0;
+  bool copied = this->GetRuntime()->GraphicsResourceGetMappedPointer(&pixels, &size, this->PixelBufferResource) == cudaSuccess &&
+                size >= imageSize &&
+                this->GetRuntime()->MemcpyAsync( image, pixels, imageSize, cudaMemcpyDeviceToHost, *(this->GetStream()) ) == cudaSuccess;
+  this->GetRuntime()->GraphicsUnmapResources(1, &(this->PixelBufferResource), *(this->GetStream()));
+  this->GetRuntime()->StreamSynchronize(*(this->GetStream()));
+  return copied;
+  }
+
+void vtkCUDAOutputImageInformationHandler::DisplayImage(vtkVolume* volume, vtkRenderer* renderer, const uchar4* image, cudaRenderStatistics* stats)
+  {
+  int imageMemorySize[2];
+  imageMemorySize[0] = this->OutputImageInfo.resolution.x;
+  imageMemorySize[1] = this->OutputImageInfo.resolution.y;
+  int imageOrigin[2] = {0,0};
+
+  double stageStart = vtkTimerLog::GetUniversalTime();
+  if( this->OffScreenImageSize[0] == 0 )
+    this->Displayer->RenderTexture(volume,renderer,imageMemorySize,imageMemorySize,imageMemorySize,imageOrigin,0.001,(unsigned char*) image);
+  if( stats )
+    {
+    stats->ReadbackTime = 0.0;
+    stats->DisplayTime = vtkTimerLog::GetUniversalTime() - stageStart;
+    stats->InteropDisplay = 0.0;
+    stats->BytesReadBack = 0.0;
+    }
   }
 
 void vtkCUDAOutputImageInformationHandler::Update()
@@ -113,16 +724,17 @@ void vtkCUDAOutputImageInformationHandler::Update()
 
   if (this->Renderer == 0) return;
 
-  // Image size update.
-  int *size = this->Renderer->GetSize();
-  this->OutputImageInfo.resolution.x = size[0] / this->RenderOutputScaleFactor;
-  this->OutputImageInfo.resolution.y = size[1] / this->RenderOutputScaleFactor;
+  // Image size update, rounding up so the image never covers less than the viewport (the grids are bounds-checked, so
+  // any size is fine)
+  int *size = this->OffScreenImageSize[0] > 0 ? this->OffScreenImageSize : this->Renderer->GetSize();
+  this->OutputImageInfo.resolution.x = (unsigned int) ceil( size[0] / this->RenderOutputScaleFactor );
+  this->OutputImageInfo.resolution.y = (unsigned int) ceil( size[1] / this->RenderOutputScaleFactor );
+  if(this->OutputImageInfo.resolution.x < 1) this->OutputImageInfo.resolution.x = 1;
+  if(this->OutputImageInfo.resolution.y < 1) this->OutputImageInfo.resolution.y = 1;
 
-  //make it such that every thread fits within the solid for optimal access coalescing
-  this->OutputImageInfo.resolution.x += (this->OutputImageInfo.resolution.x % 16) ? 16-(this->OutputImageInfo.resolution.x % 16) : 0;
-  this->OutputImageInfo.resolution.y += (this->OutputImageInfo.resolution.y % 16) ?16-(this->OutputImageInfo.resolution.y % 16): 0;
-  if(this->OutputImageInfo.resolution.y < 256) this->OutputImageInfo.resolution.y = 256;
-  if(this->OutputImageInfo.resolution.x < 256) this->OutputImageInfo.resolution.x = 256;
+  //the rays cover the whole image unless a tile is set for the frame
+  this->OutputImageInfo.tileOffset.x = this->OutputImageInfo.tileOffset.y = 0;
+  this->OutputImageInfo.tileSize = this->OutputImageInfo.resolution;
 
   //if our image size hasn't changed, we don't have to reallocate any buffers, so we can just leave
   if(this->OutputImageInfo.resolution.x == this->oldResolution.x && this->OutputImageInfo.resolution.y == this->oldResolution.y)
@@ -130,29 +742,46 @@ void vtkCUDAOutputImageInformationHandler::Update()
 
   //reset the values for the old resolution to the current (for the next update)
   this->oldResolution = this->OutputImageInfo.resolution;
+  this->lastImageValid = false;
 
-  //allocate the buffers used for intermediate output results in rendering
-  this->ReserveGPU();
-  if(this->OutputImageInfo.numSteps) cudaFree(this->OutputImageInfo.numSteps);
-  cudaMalloc( (void**) &this->OutputImageInfo.numSteps, sizeof(float)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
-  if(this->OutputImageInfo.rayIncX) cudaFree(this->OutputImageInfo.rayIncX);
-  cudaMalloc( (void**) &this->OutputImageInfo.rayIncX, sizeof(float)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
-  if(this->OutputImageInfo.rayIncY) cudaFree(this->OutputImageInfo.rayIncY);
-  cudaMalloc( (void**) &this->OutputImageInfo.rayIncY, sizeof(float)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
-  if(this->OutputImageInfo.rayIncZ) cudaFree(this->OutputImageInfo.rayIncZ);
-  cudaMalloc( (void**) &this->OutputImageInfo.rayIncZ, sizeof(float)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
-  if(this->OutputImageInfo.rayStartX) cudaFree(this->OutputImageInfo.rayStartX);
-  cudaMalloc( (void**) &this->OutputImageInfo.rayStartX, sizeof(float)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
-  if(this->OutputImageInfo.rayStartY) cudaFree(this->OutputImageInfo.rayStartY);
-  cudaMalloc( (void**) &this->OutputImageInfo.rayStartY, sizeof(float)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
-  if(this->OutputImageInfo.rayStartZ) cudaFree(this->OutputImageInfo.rayStartZ);
-  cudaMalloc( (void**) &this->OutputImageInfo.rayStartZ, sizeof(float)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
-
-  //allocate the buffers
+  //the running sum no longer matches the image, so it is restarted at the new size
+  if(this->hostAccumulationImage) delete[] this->hostAccumulationImage;
+  this->hostAccumulationImage = 0;
+  if(this->deviceAccumulationImage)
+    {
+    this->ReserveGPU();
+    this->GetRuntime()->Free(this->deviceAccumulationImage);
+    }
+  this->deviceAccumulationImage = 0;
+  this->NumberOfAccumulatedPasses = 0;
+
+  //the tiled image is allocated again at the new size when next stitched in (every tile having been waited for)
+  if(this->hostTiledImage) this->GetRuntime()->FreeHost(this->hostTiledImage);
+  this->hostTiledImage = 0;
+
+  //the host backend forms its rays on the fly, so it only needs the image itself
+  if( this->HostRendering )
+    {
+    if(this->hostOutputImage) delete this->hostOutputImage;
+    this->hostOutputImage = new uchar4[this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y];
+    return;
+    }
+
+  //the rays are formed as they are composited, so the ray buffer is only allocated again by Prepare if it is reused
   this->ReserveGPU();
-  if(this->deviceOutputImage) cudaFree(this->deviceOutputImage);
-  cudaMalloc( (void**) &this->deviceOutputImage, 4*sizeof(unsigned char)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
-  if(this->hostOutputImage) delete this->hostOutputImage;
-  this->hostOutputImage = new uchar4[this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y];
+  if(this->OutputImageInfo.rayBuffer) this->GetRuntime()->Free(this->OutputImageInfo.rayBuffer);
+  this->OutputImageInfo.rayBuffer = 0;
+
+  //the frames are cast into a pair of device images, each read back on the readback stream into its own page-locked buffer,
+  //so a copy overlaps the ray casting of the next frame
+  this->FreeReadbackImages();
+  this->GetRuntime()->StreamCreate( &(this->readbackStream) );
+  for( int i = 0; i < 2; i++ )
+    {
+    this->GetRuntime()->Malloc( (void**) &(this->deviceOutputImages[i]), 4*sizeof(unsigned char)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
+    this->GetRuntime()->HostAlloc( (void**) &(this->hostReadbackImages[i]), 4*sizeof(unsigned char)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y, cudaHostAllocDefault);
+    this->GetRuntime()->EventCreate( &(this->readbackEvents[i]), cudaEventDisableTiming );
+    this->GetRuntime()->EventCreate( &(this->renderedEvents[i]), cudaEventDisableTiming );
+    }
 
   }
\ No newline at end of file
@@ -12,11 +12,14 @@
 
 // CUDA Volume Rendering includes
 #include "CUDA_containerOutputImageInformation.h"
+#include "CUDA_containerRenderStatistics.h"
 #include "vtkCUDAObject.h"
 
 // VTK includes
 #include <vtkObject.h>
+struct cudaGraphicsResource;
 class vtkRayCastImageDisplayHelper;
+class vtkRenderWindow;
 class vtkRenderer;
 class vtkVolume;
 
@@ -47,11 +50,31 @@ public:
   */
   void SetRenderer(vtkRenderer* renderer);
 
+  /** @brief Sets the size of the image rendered off screen, which is then left in host memory rather than displayed
+  *
+  *  @param width The width of the image in pixels, or 0 to render at the size of the renderer's viewport and display it
+  *  @param height The height of the image in pixels
+  *
+  *  @note Off screen there is no window to texture to, so the image is never displayed through the pixel buffer and
+  *        CopyLastImage or GetHostOutputImage give it back
+  */
+  void SetOffScreenImageSize(int width, int height);
+
   /** @brief Sets how the image is displayed
   *
   *  @param scaleFactor The factor by which the screen is undersampled in each direction (must be equal or greater than 1.0f, where 1.0f means full sampling)
   */
   void SetRenderOutputScaleFactor(float scaleFactor);
+  float GetRenderOutputScaleFactor() { return this->RenderOutputScaleFactor; }
+
+  /** @brief Sets the shape of the thread blocks the rays are cast in on the device
+  *
+  *  @param x The number of threads of a block along x
+  *  @param y The number of threads of a block along y
+  *
+  *  @pre x and y are positive, and x*y is no more than the number of threads the device allows in a block
+  */
+  void SetBlockShape(int x, int y);
 
   /** @brief Gets the CUDA compatible container for the output image buffer location needed during rendering, and the additional information needed after rendering for displaying
   *
@@ -60,19 +83,153 @@ public:
 
   /** @brief Prepares the buffers/textures/images before rendering
   *
+  *  @note When rendering progressively on the device, this also allocates the ray buffer the passes after the first reuse
   */
   void Prepare();
 
   /** @brief Displays the buffers/textures/images to the render window after the ray casting process
   *
+  *  @param stats If not null, receives the time spent reading the image back and texturing it to the window
+  */
+  void Display(vtkVolume* volume, vtkRenderer* renderer, cudaRenderStatistics* stats = 0);
+
+  /** @brief Displays the image last rendered again, from wherever Display displayed it, without casting or reading anything back
+  *
+  *  @note With one frame of latency this is the image of the last frame rendered, not the one Display showed
+  *
+  *  @return false if the buffers no longer hold the image, as after a resize or Prepare, in which case nothing is displayed
   */
-  void Display(vtkVolume* volume, vtkRenderer* renderer);
+  bool DisplayAgain(vtkVolume* volume, vtkRenderer* renderer, cudaRenderStatistics* stats = 0);
+
+  /** @brief Copies the image last rendered into host memory, waiting for its readback (or reading the pixel buffer back)
+  *
+  *  @param image An image at the output resolution
+  *
+  *  @return false if the buffers no longer hold the image
+  */
+  bool CopyLastImage(uchar4* image);
+
+  /** @brief Displays an image from host memory, such as one rendered earlier, leaving the image last rendered in the buffers
+  *
+  *  @param image An image at the output resolution
+  */
+  void DisplayImage(vtkVolume* volume, vtkRenderer* renderer, const uchar4* image, cudaRenderStatistics* stats = 0);
 
   /** @brief Updates the various available rendering parameters, reconstructing the buffers/textures/images if the render type or output image resolution has changed
   *
   */
   void Update();
 
+  /** @brief Sets whether the image is ray cast on the host, in which case only the host output image is allocated and displayed without involving the device
+  *
+  *  @param hostRendering true when the CPU backend of the mapper writes the image
+  */
+  void SetHostRendering(bool hostRendering);
+
+  /** @brief Gets the image in host memory, which the CPU backend renders into directly (the CUDA backend reads back into its own buffers)
+  *
+  */
+  uchar4* GetHostOutputImage() { return this->hostOutputImage; }
+
+  /** @brief Sets whether the image read back from the device is displayed a frame late, so the host never waits for the current copy
+  *
+  *  @param latency true to display the previous frame's image, for throughput-oriented batch rendering
+  */
+  void SetOneFrameLatency(bool latency);
+  bool GetOneFrameLatency() { return this->OneFrameLatency; }
+
+  /** @brief Sets whether the device image is displayed through a CUDA-GL pixel buffer instead of being copied through the host
+  *
+  *  @param interop true to ray cast straight into a pixel buffer textured by OpenGL, falling back on the host copy whenever the
+  *         render window or device cannot share the buffer
+  */
+  void SetInteropDisplay(bool interop);
+  bool GetInteropDisplay() { return this->InteropDisplay; }
+
+  /** @brief Gets whether the last image prepared is displayed through the pixel buffer
+  *
+  */
+  bool GetUsingInteropDisplay() { return this->UsingInteropDisplay; }
+
+  /** @brief Releases the pixel buffer and texture of the interop display, with the render window's context current
+  *
+  */
+  void ReleaseGraphicsResources();
+
+  /** @brief Sets whether successive renders are averaged into an accumulation image, whose buffers are released when turned off
+  *
+  *  @param progressive true to keep a running sum of the images rendered since the last ResetAccumulation
+  */
+  void SetProgressiveRendering(bool progressive);
+  bool GetProgressiveRendering() { return this->ProgressiveRendering; }
+
+  /** @brief Starts a new running sum with the next image accumulated
+  *
+  */
+  void ResetAccumulation() { this->NumberOfAccumulatedPasses = 0; }
+
+  /** @brief Gets the number of images in the running sum, which is reset whenever the output resolution changes
+  *
+  */
+  int GetNumberOfAccumulatedPasses() { return this->NumberOfAccumulatedPasses; }
+
+  /** @brief Adds the image just rendered to the running sum, and replaces it with the mean of all the passes so far
+  *
+  *  @pre Progressive rendering is on and the image has been rendered but not yet displayed
+  */
+  void Accumulate();
+
+  /** @brief Sets whether the image is split among devices, each ray casting a tile of it that is read back into the
+  *          tiled image to be stitched, in which case the pixel buffer is not used
+  *
+  *  @param tiled true while the mapper renders on several devices, the tiled image being released when turned off
+  */
+  void SetTiledRendering(bool tiled);
+  bool GetTiledRendering() { return this->TiledRendering; }
+
+  /** @brief Restricts the rays cast for the next frame to a band of rows of the image
+  *
+  *  @param firstRow The first row of the band
+  *  @param numberOfRows The number of rows of the band, the band being clipped to the image
+  *
+  *  @pre The resolution has been updated for the frame, which makes the tile the whole image again
+  */
+  void SetTile(int firstRow, int numberOfRows);
+
+  /** @brief Gets the page-locked host image the tiles of the devices are read back into, allocated at the output
+  *          resolution on first use and readable by every device
+  *
+  */
+  uchar4* GetTiledImage();
+
+  /** @brief Records the start of the ray casting of the tile on the stream of the handler, so it is timed on the device
+  *
+  */
+  void StartTile();
+
+  /** @brief Queues the copy of the tile just ray cast into the same rows of a host image, behind the ray casting
+  *
+  *  @param image A page-locked image at the output resolution, usually the tiled image of the mapper rendering the first tile
+  */
+  void ReadBackTile(uchar4* image);
+
+  /** @brief Forgets the start of the tile when it is not read back, so FinishTile neither waits for nor times it
+  *
+  */
+  void CancelTile() { this->tileStarted = false; }
+
+  /** @brief Waits for the copy of the tile to the host
+  *
+  *  @return The time in seconds from StartTile to the end of the copy, or a negative value if the tile was not timed
+  */
+  double FinishTile();
+
+  /** @brief Displays the tiled image to the render window, once every tile has been read back into it
+  *
+  *  @param stats If not null, receives the time spent texturing the image to the window
+  */
+  void DisplayTiledImage(vtkVolume* volume, vtkRenderer* renderer, cudaRenderStatistics* stats = 0);
+
 protected:
 
   /** @brief Constructor which initializes all the displyy parameters to safe values, and create a display helper and a CUDA memory texture to help with the display process
@@ -88,6 +245,27 @@ protected:
   void Deinitialize(int withData = 0);
   void Reinitialize(int withData = 0);
 
+  /** @brief Creates (or recreates at a new resolution) the pixel buffer and texture, and registers the buffer with CUDA
+  *
+  *  @return false if the render window or device cannot share the buffer, in which case the host copy is used
+  */
+  bool CreatePixelBuffer(vtkRenderWindow* window);
+
+  /** @brief Releases the device images, the page-locked readback buffers, their events and the readback stream, once any copy into them has finished
+  *
+  */
+  void FreeReadbackImages();
+
+  /** @brief Textures the pixel buffer to the renderer's viewport, blending the premultiplied colours of the ray casters
+  *
+  */
+  void DisplayPixelBuffer();
+
+  /** @brief Releases the tiled image and the events timing the tiles
+  *
+  */
+  void FreeTiles();
+
 private:
   vtkCUDAOutputImageInformationHandler& operator=(const vtkCUDAOutputImageInformationHandler&); /**< not implemented */
   vtkCUDAOutputImageInformationHandler(const vtkCUDAOutputImageInformationHandler&); /**< not implemented */
@@ -96,14 +274,42 @@ private:
   cudaOutputImageInformation    OutputImageInfo;      /**< CUDA compatible container for the output image display information */
   vtkRayCastImageDisplayHelper*  Displayer;          /**< A VTK class solely for helping ray casters render a 2D RGBA image to the appropriate section of the render window */
   vtkRenderer*          Renderer;          /**< The vtkRenderer which information is currently being extracted from */
+  int                   OffScreenImageSize[2];  /**< The size of the image rendered off screen, or 0 to use the viewport's */
 
   int                oldRenderType;        /**< The render type used previous to the current one, used to clean up information when switching display type */
   uint2              oldResolution;        /**< The previous window size (used to determine whether or not to recreate buffers) */
 
-  uchar4* hostOutputImage;                  /**< The image that will be textured to the screen stored on host memory */
-  uchar4* deviceOutputImage;                  /**< The image that will be textured to the screen stored on device memory */
+  uchar4* hostOutputImage;                  /**< The image that will be textured to the screen stored on host memory (CPU backend) */
+  uchar4* hostReadbackImages[2];            /**< The page-locked pair the device image is read back into, in turn */
+  cudaEvent_t readbackEvents[2];            /**< Recorded after the copy into each readback image */
+  cudaEvent_t renderedEvents[2];            /**< Recorded after the ray casting into each device image, which its copy waits for */
+  cudaStream_t readbackStream;              /**< The stream the device images are copied on, while the next frame is cast on the handler's */
+  int readbackIndex;                        /**< The device and readback images the next frame is rendered and copied into */
+  bool previousReadbackValid;               /**< Whether the other readback image holds the previous frame at the current resolution */
+  bool OneFrameLatency;                     /**< Whether the previous frame's readback is displayed rather than the current one's */
+  bool lastImageValid;                      /**< Whether the buffers still hold the image last rendered, so it can be displayed again */
+  uchar4* deviceOutputImages[2];            /**< The pair of device images the frames are ray cast into in turn, each read back into its readback image */
 
   float              RenderOutputScaleFactor;  /**< The approximate factor by which the screen is resized in order to speed up the rendering process*/
+  bool              HostRendering;          /**< Whether the image is ray cast on the host, so no device buffers are needed */
+
+  bool              ProgressiveRendering;       /**< Whether the rendered images are averaged into the accumulation image */
+  int               NumberOfAccumulatedPasses;  /**< The number of images in the running sum */
+  float4*           hostAccumulationImage;      /**< The running sum of the images rendered on the host, allocated on first use */
+  float4*           deviceAccumulationImage;    /**< The running sum of the images rendered on the device, allocated on first use */
+
+  bool                   InteropDisplay;        /**< Whether the device image is to be displayed through the pixel buffer */
+  bool                   InteropFailed;         /**< Whether the pixel buffer could not be created, so the host copy is used */
+  bool                   UsingInteropDisplay;   /**< Whether the image being rendered is in the mapped pixel buffer */
+  unsigned int           PixelBuffer;           /**< The OpenGL pixel unpack buffer the device image is rendered into */
+  unsigned int           PixelBufferTexture;    /**< The OpenGL texture the pixel buffer is uploaded to */
+  uint2                  PixelBufferSize;       /**< The resolution the pixel buffer and texture were created for */
+  cudaGraphicsResource*  PixelBufferResource;   /**< The CUDA registration of the pixel buffer */
+
+  bool                   TiledRendering;        /**< Whether the image is split among devices */
+  uchar4*                hostTiledImage;        /**< The page-locked image the tiles are stitched in, allocated on first use */
+  cudaEvent_t            tileEvents[2];         /**< Recorded before the ray casting of the tile and after its copy to the host */
+  bool                   tileStarted;           /**< Whether the start of the tile was recorded since the last FinishTile */
 
 };
 
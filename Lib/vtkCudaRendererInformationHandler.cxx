@@ -17,10 +17,15 @@
 #include <vtkMatrix4x4.h>
 #include <vtkPlane.h>
 #include <vtkPlaneCollection.h>
+#include <vtkProp.h>
+#include <vtkPropCollection.h>
 #include <vtkRenderer.h>
 #include <vtkRenderWindow.h>
+#include <vtkVolume.h>
 
 // STD includes
+#include <cmath>
+#include <cstring>
 #include <vector>
 
 vtkStandardNewMacro(vtkCUDARendererInformationHandler);
@@ -28,22 +33,51 @@ vtkStandardNewMacro(vtkCUDARendererInformationHandler);
 vtkCUDARendererInformationHandler::vtkCUDARendererInformationHandler()
   {
   this->Renderer = 0;
+  this->OffScreenImageSize[0] = this->OffScreenImageSize[1] = 0;
   this->RendererInfo.actualResolution.x = this->RendererInfo.actualResolution.y = 0;
   this->RendererInfo.NumberOfClippingPlanes = 0;
+  this->RendererInfo.VoxelFootprint = make_float4(0.0f, 0.0f, 0.0f, 1.0f);
+  this->RendererInfo.VoxelFootprintScale = make_float2(0.0f, 0.0f);
+  this->RendererInfo.ZBufferArray = 0;
+  this->RendererInfo.ZBufferSize = make_uint2(0, 0);
+  this->RendererInfo.ZBufferTexture = 0;
 
   SetGradientShadingConstants(0.605f);
+  SetSampling(CUDA_SAMPLE_MINIMUM_SPACING, 1.0f);
 
   this->ZBuffer = 0;
+  this->ZBufferSize.x = this->ZBufferSize.y = 0;
+  this->DeviceZBufferSize.x = this->DeviceZBufferSize.y = 0;
+  this->zBufferModified = 0;
+  this->ZBufferEmpty = false;
+  this->ZBufferValid = false;
+  this->ZBufferCollected = false;
+  this->NumberOfZBufferAllocations = 0;
 
   this->clipModified = 0;
+  this->HostRendering = false;
 
+  }
 
+vtkCUDARendererInformationHandler::~vtkCUDARendererInformationHandler()
+  {
+  this->Deinitialize();
+  delete[] this->ZBuffer;
   }
 
 void vtkCUDARendererInformationHandler::Deinitialize(int withData)
   {
   this->ReserveGPU();
-  CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadZBuffer(this->GetStream());
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadZBuffer(this->GetRuntime(), this->RendererInfo, this->GetStream());
+  this->DeviceZBufferSize.x = this->DeviceZBufferSize.y = 0;
+  this->ZBufferValid = false;
+  }
+
+void vtkCUDARendererInformationHandler::SetHostRendering(bool hostRendering)
+  {
+  //the device copy is not kept up to date while rendering on the host
+  if( this->HostRendering != hostRendering ) this->ZBufferValid = false;
+  this->HostRendering = hostRendering;
   }
 
 void vtkCUDARendererInformationHandler::Reinitialize(int withData)
@@ -62,6 +96,13 @@ void vtkCUDARendererInformationHandler::SetRenderer(vtkRenderer* renderer)
   this->Update();
   }
 
+void vtkCUDARendererInformationHandler::SetOffScreenImageSize(int width, int height)
+  {
+  this->OffScreenImageSize[0] = (width > 0 && height > 0) ? width : 0;
+  this->OffScreenImageSize[1] = (width > 0 && height > 0) ? height : 0;
+  this->Update();
+  }
+
 void vtkCUDARendererInformationHandler::SetGradientShadingConstants(float darkness)
   {
   if(darkness >= 0.0f && darkness <= 1.0f ){
@@ -70,42 +111,73 @@ void vtkCUDARendererInformationHandler::SetGradientShadingConstants(float darkne
     }
   }
 
+void vtkCUDARendererInformationHandler::SetSampling(int mode, float distanceFactor)
+  {
+  if( (mode == CUDA_SAMPLE_MINIMUM_SPACING || mode == CUDA_SAMPLE_VOXEL_FOOTPRINT) && distanceFactor > 0.0f ){
+    this->RendererInfo.SamplingMode = mode;
+    this->RendererInfo.SampleDistanceFactor = distanceFactor;
+    }
+  }
+
 void vtkCUDARendererInformationHandler::Update()
   {
   if (this->Renderer != 0)
     {
     // Renderplane Update.
-    int *size = this->Renderer->GetSize();
+    int *size = this->OffScreenImageSize[0] > 0 ? this->OffScreenImageSize : this->Renderer->GetSize();
     this->RendererInfo.actualResolution.x = size[0];
     this->RendererInfo.actualResolution.y = size[1];
     }
   }
 
-void vtkCUDARendererInformationHandler::SetViewToVoxelsMatrix(vtkMatrix4x4* matrix)
+//load a view to voxels matrix into the table of a container, folding in the pixel to view co-ordinate mapping
+static void vtkCUDARendererInformationHandler_LoadViewToVoxelsMatrix(vtkMatrix4x4* matrix, float* table)
   {
   //load the original table
   for(int i = 0; i < 4; i++){
     for(int j = 0; j < 4; j++){
-      this->RendererInfo.ViewToVoxelsMatrix[i*4+j] = matrix->GetElement(i,j);
+      table[i*4+j] = matrix->GetElement(i,j);
       }
     }
 
   //compute the obtimizations to measure the view via the x,y position of the pixel divided by the resolution
-  this->RendererInfo.ViewToVoxelsMatrix[3] += this->RendererInfo.ViewToVoxelsMatrix[0] - this->RendererInfo.ViewToVoxelsMatrix[1];
-  this->RendererInfo.ViewToVoxelsMatrix[7] += this->RendererInfo.ViewToVoxelsMatrix[4] - this->RendererInfo.ViewToVoxelsMatrix[5];
-  this->RendererInfo.ViewToVoxelsMatrix[11] += this->RendererInfo.ViewToVoxelsMatrix[8] - this->RendererInfo.ViewToVoxelsMatrix[9];
-  this->RendererInfo.ViewToVoxelsMatrix[15] += this->RendererInfo.ViewToVoxelsMatrix[12] - this->RendererInfo.ViewToVoxelsMatrix[13];
+  table[3] += table[0] - table[1];
+  table[7] += table[4] - table[5];
+  table[11] += table[8] - table[9];
+  table[15] += table[12] - table[13];
+
+  table[0] *= -2.0f;
+  table[4] *= -2.0f;
+  table[8] *= -2.0f;
+  table[12] *= -2.0f;
 
-  this->RendererInfo.ViewToVoxelsMatrix[0] *= -2.0f;
-  this->RendererInfo.ViewToVoxelsMatrix[4] *= -2.0f;
-  this->RendererInfo.ViewToVoxelsMatrix[8] *= -2.0f;
-  this->RendererInfo.ViewToVoxelsMatrix[12] *= -2.0f;
+  table[1] *= 2.0f;
+  table[5] *= 2.0f;
+  table[9] *= 2.0f;
+  table[13] *= 2.0f;
 
-  this->RendererInfo.ViewToVoxelsMatrix[1] *= 2.0f;
-  this->RendererInfo.ViewToVoxelsMatrix[5] *= 2.0f;
-  this->RendererInfo.ViewToVoxelsMatrix[9] *= 2.0f;
-  this->RendererInfo.ViewToVoxelsMatrix[13] *= 2.0f;
+  }
 
+void vtkCUDARendererInformationHandler::SetViewToVoxelsMatrix(vtkMatrix4x4* matrix)
+  {
+  float* table = this->RendererInfo.ViewToVoxelsMatrix;
+  vtkCUDARendererInformationHandler_LoadViewToVoxelsMatrix(matrix, table);
+
+  //a voxel p seen at view co-ordinate v satisfies table * v = (p, 1) / h(p), h being the last row of the inverse table, so
+  //moving across the screen moves p by a column of the table times h(p) (the camera looking through the centre of the screen)
+  double elements[16];
+  double inverse[16];
+  for( int i = 0; i < 16; i++ ) elements[i] = table[i];
+  vtkMatrix4x4::Invert( elements, inverse );
+  this->RendererInfo.VoxelFootprint = make_float4( inverse[12], inverse[13], inverse[14], inverse[15] );
+  this->RendererInfo.VoxelFootprintScale.x = sqrt( table[0]*table[0] + table[4]*table[4] + table[8]*table[8] );
+  this->RendererInfo.VoxelFootprintScale.y = sqrt( table[1]*table[1] + table[5]*table[5] + table[9]*table[9] );
+  }
+
+void vtkCUDARendererInformationHandler::SetFusedViewToVoxelsMatrix(int volume, vtkMatrix4x4* matrix)
+  {
+  if( volume < 0 || volume >= CUDA_MAX_FUSED_VOLUMES ) return;
+  vtkCUDARendererInformationHandler_LoadViewToVoxelsMatrix(matrix, this->RendererInfo.FusedViewToVoxelsMatrix + 16*volume);
   }
 
 void vtkCUDARendererInformationHandler::SetWorldToVoxelsMatrix(vtkMatrix4x4* matrix)
@@ -147,21 +219,114 @@ void vtkCUDARendererInformationHandler::SetClippingPlanes(vtkPlaneCollection* pl
 
 void vtkCUDARendererInformationHandler::LoadZBuffer()
   {
+  this->ZBufferCollected = false;
+  const int sizeX = this->RendererInfo.actualResolution.x;
+  const int sizeY = this->RendererInfo.actualResolution.y;
+  if( sizeX < 1 || sizeY < 1 ) return;
+
+  this->ReserveZBuffer(sizeX, sizeY);
+
+  //find when the depth buffer could last have changed, which is when the camera or an opaque prop was modified
+  int numberOfOpaqueProps = 0;
+  unsigned long modified = this->GetOpaquePropsMTime(numberOfOpaqueProps);
+  if( this->Renderer->GetMTime() > modified ) modified = this->Renderer->GetMTime();
+  vtkCamera* camera = this->Renderer->GetActiveCamera();
+  if( camera && camera->GetMTime() > modified ) modified = camera->GetMTime();
+
+  //without opaque props the depth buffer is cleared to the far plane, so it is filled once rather than read back, as it
+  //is off screen where there is no depth buffer at all
+  if( numberOfOpaqueProps == 0 || this->OffScreenImageSize[0] > 0 )
+    {
+    if( this->ZBufferValid && this->ZBufferEmpty ) return;
+    for( int i = 0; i < sizeX*sizeY; i++ )
+      this->ZBuffer[i] = 1.0f;
+    this->ZBufferEmpty = true;
+    }
+  else
+    {
+    if( this->ZBufferValid && !this->ZBufferEmpty && modified == this->zBufferModified ) return;
+
+    //read back into the existing buffer
+    int x1 = this->Renderer->GetOrigin()[0];
+    int y1 = this->Renderer->GetOrigin()[1];
+    int x2 = x1 + sizeX - 1;
+    int y2 = y1 + sizeY - 1;
+    this->Renderer->GetRenderWindow()->GetZbufferData(x1,y1,x2,y2,this->ZBuffer);
+    this->ZBufferEmpty = false;
+    this->zBufferModified = modified;
+    this->ZBufferCollected = true;
+    }
+  this->ZBufferValid = true;
+  this->UploadZBuffer(sizeX, sizeY);
+  }
 
-  //image origin in pixels
-  int x1 = this->Renderer->GetOrigin()[0];
-  int y1 = this->Renderer->GetOrigin()[1];
-  int x2 = x1 + this->RendererInfo.actualResolution.x - 1;
-  int y2 = y1 + this->RendererInfo.actualResolution.y - 1;
+void vtkCUDARendererInformationHandler::LoadZBuffer(vtkCUDARendererInformationHandler* source)
+  {
+  const int sizeX = this->RendererInfo.actualResolution.x;
+  const int sizeY = this->RendererInfo.actualResolution.y;
+  if( !source || !source->ZBufferValid || source->ZBufferSize.x != (unsigned int) sizeX ||
+      source->ZBufferSize.y != (unsigned int) sizeY )
+    {
+    this->LoadZBuffer();
+    return;
+    }
+  this->ZBufferCollected = false;
+
+  //the source stamps its buffer with when it was read back and whether it holds the far plane, so it is only copied again once either changes
+  this->ReserveZBuffer(sizeX, sizeY);
+  if( this->ZBufferValid && this->ZBufferEmpty == source->ZBufferEmpty && this->zBufferModified == source->zBufferModified ) return;
+  memcpy( this->ZBuffer, source->ZBuffer, sizeof(float) * sizeX * sizeY );
+  this->ZBufferEmpty = source->ZBufferEmpty;
+  this->zBufferModified = source->zBufferModified;
+  this->ZBufferValid = true;
+  this->UploadZBuffer(sizeX, sizeY);
+  }
+
+void vtkCUDARendererInformationHandler::ReserveZBuffer(int sizeX, int sizeY)
+  {
+  //the host buffer is only reallocated when the viewport is resized (the device array follows when loaded)
+  if( !this->ZBuffer || this->ZBufferSize.x != (unsigned int) sizeX || this->ZBufferSize.y != (unsigned int) sizeY )
+    {
+    delete[] this->ZBuffer;
+    this->ZBuffer = new float[sizeX*sizeY];
+    this->ZBufferSize = make_uint2(sizeX, sizeY);
+    this->ZBufferValid = false;
+    this->NumberOfZBufferAllocations++;
+    }
+  }
 
-  //remove old zBuffer and get a new one
-  if(this->ZBuffer) delete this->ZBuffer;
-  this->ZBuffer = this->Renderer->GetRenderWindow()->GetZbufferData(x1,y1,x2,y2);
+void vtkCUDARendererInformationHandler::UploadZBuffer(int sizeX, int sizeY)
+  {
+  if( this->HostRendering ) return;
   this->ReserveGPU();
-  CUDA_vtkCUDAVolumeMapper_renderAlgo_loadZBuffer(this->ZBuffer, this->RendererInfo.actualResolution.x, this->RendererInfo.actualResolution.y, this->GetStream() );
+  if( this->DeviceZBufferSize.x != (unsigned int) sizeX || this->DeviceZBufferSize.y != (unsigned int) sizeY )
+    {
+    this->DeviceZBufferSize = make_uint2(sizeX, sizeY);
+    this->NumberOfZBufferAllocations++;
+    }
+  if( !CUDA_vtkCUDAVolumeMapper_renderAlgo_loadZBuffer(this->GetRuntime(), this->RendererInfo, this->ZBuffer, sizeX, sizeY,
+                                                       this->GetStream() ) )
+    this->ZBufferValid = false;
 
   }
 
+unsigned long vtkCUDARendererInformationHandler::GetOpaquePropsMTime(int& numberOfOpaqueProps)
+  {
+  numberOfOpaqueProps = 0;
+  unsigned long modified = 0;
+  if( !this->Renderer ) return modified;
+  vtkPropCollection* props = this->Renderer->GetViewProps();
+  vtkCollectionSimpleIterator it;
+  props->InitTraversal(it);
+  while( vtkProp* prop = props->GetNextProp(it) )
+    {
+    if( !prop->GetVisibility() || vtkVolume::SafeDownCast(prop) ) continue;
+    numberOfOpaqueProps++;
+    if( prop->GetRedrawMTime() > modified ) modified = prop->GetRedrawMTime();
+    }
+  return modified;
+  }
+
 void vtkCUDARendererInformationHandler::FigurePlanes(vtkPlaneCollection* planes, float* planesArray, int* numberOfPlanes){
 
   //figure out the number of planes
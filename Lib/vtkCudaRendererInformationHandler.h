@@ -47,6 +47,15 @@ public:
   */
   void SetRenderer(vtkRenderer* renderer);
 
+  /** @brief Sets the size of the image rendered off screen, without the renderer's render window
+  *
+  *  @param width The width of the image in pixels, or 0 to use the size of the renderer's viewport
+  *  @param height The height of the image in pixels
+  *
+  *  @note Off screen there is no depth buffer to read back, so the Z buffer holds the far plane
+  */
+  void SetOffScreenImageSize(int width, int height);
+
   /** @brief Gets the CUDA compatible container for renderer/camera/shading/geometry related information needed during the rendering process
   *
   */
@@ -58,12 +67,26 @@ public:
   */
   void SetGradientShadingConstants(float darkness);
 
+  /** @brief Set how far apart the samples along each ray are taken
+  *
+  *  @param mode One of CUDA_SAMPLE_MINIMUM_SPACING or CUDA_SAMPLE_VOXEL_FOOTPRINT
+  *  @param distanceFactor Multiplier of the step the mode chooses, where 1.0f is full quality and larger values sample more coarsely
+  */
+  void SetSampling(int mode, float distanceFactor);
+
   /** @brief Sets the view to voxels matrix, which is used in rendering to convert rays in view space to rays in voxel space necessary for ray casting
   *
   *  @param m The 4x4 matrix representing the transformation from view space to voxel space
   */
   void SetViewToVoxelsMatrix(vtkMatrix4x4* m);
 
+  /** @brief Sets the view to voxels matrix of a volume fused with the rendered one, which maps the rays into its own voxel space
+  *
+  *  @param volume The slot of the fused volume, between 0 and CUDA_MAX_FUSED_VOLUMES (exclusive)
+  *  @param m The 4x4 matrix representing the transformation from view space to the voxel space of the fused volume
+  */
+  void SetFusedViewToVoxelsMatrix(int volume, vtkMatrix4x4* m);
+
   /** @brief Sets the voxels to world matrix, which is used to convert the clipping planes to voxel space, using them to clip the ray in the kernel
   *
   *  @param m The 4x4 matrix representing the transformation from world space to voxel space
@@ -82,9 +105,52 @@ public:
 
   /** @brief Gets the Z buffer from the render window, and loads it into a CUDA 2D texture for use during rendering
   *
+  *  @note The host and device buffers are kept between frames and only reallocated when the viewport is resized. The
+  *        read back and the upload are skipped when the depth buffer cannot have changed since the last frame (ie: the
+  *        renderer, camera and opaque props are unmodified), and when there are no opaque props at all, in which case
+  *        the buffer holds the far plane and is only filled once.
   */
   void LoadZBuffer();
 
+  /** @brief Loads the Z buffer another handler collected into a CUDA 2D texture, rather than reading the render window's
+  *          depth buffer back again, as when rendering a part of the image of that handler's mapper on another device
+  *
+  *  @param source The handler whose Z buffer is loaded, reading the render window's back instead if it holds none at
+  *         the resolution of this handler
+  *
+  *  @note The copy and the upload are skipped when the source has not collected its Z buffer again since the last call
+  */
+  void LoadZBuffer(vtkCUDARendererInformationHandler* source);
+
+  /** @brief Gets when the opaque props of the renderer, whose depth the rays stop at, were last modified
+  *
+  *  @param numberOfOpaqueProps Receives the number of visible props that are not volumes
+  *
+  *  @return The latest redraw time of those props, or 0 if there are none
+  */
+  unsigned long GetOpaquePropsMTime(int& numberOfOpaqueProps);
+
+  /** @brief Gets whether the last call to LoadZBuffer read the render window's depth buffer
+  *
+  */
+  bool GetZBufferCollected() { return this->ZBufferCollected; }
+
+  /** @brief Gets the number of buffers allocated for the Z buffer (on the host and the device) since the handler was made
+  *
+  */
+  unsigned int GetNumberOfZBufferAllocations() { return this->NumberOfZBufferAllocations; }
+
+  /** @brief Gets the Z buffer last collected by LoadZBuffer, which is actualResolution in size
+  *
+  */
+  const float* GetZBuffer() { return this->ZBuffer; }
+
+  /** @brief Sets whether the rays are cast on the host, in which case the Z buffer is collected but not loaded into CUDA
+  *
+  *  @param hostRendering true when the CPU backend of the mapper reads the Z buffer
+  */
+  void SetHostRendering(bool hostRendering);
+
   /** @brief Sets the user-defining clipping planes used to bound the volume during rendering (Can get the planes from the vtkBoxWidget)
   *
   *  @param planes A set of 6 planes acting as the clipping planes
@@ -113,6 +179,11 @@ protected:
   */
   vtkCUDARendererInformationHandler();
 
+  /** @brief Destructor that deallocates the Z buffer
+  *
+  */
+  ~vtkCUDARendererInformationHandler();
+
   void Deinitialize(int withData = 0);
   void Reinitialize(int withData = 0);
 
@@ -120,15 +191,30 @@ private:
   vtkCUDARendererInformationHandler& operator=(const vtkCUDARendererInformationHandler&); /**< not implemented */
   vtkCUDARendererInformationHandler(const vtkCUDARendererInformationHandler&); /**< not implemented */
 
+  /** @brief Reallocates the host Z buffer when the viewport was resized, invalidating it */
+  void ReserveZBuffer(int sizeX, int sizeY);
+
+  /** @brief Uploads the host Z buffer to the device, unless rendering on the host */
+  void UploadZBuffer(int sizeX, int sizeY);
+
 private:
   vtkRenderer*      Renderer;          /**< The vtkRenderer which information is currently being extracted from */
+  int               OffScreenImageSize[2];  /**< The size of the image rendered off screen, or 0 to use the viewport's */
 
   cudaRendererInformation  RendererInfo;        /**< CUDA compatible container for various renderer/shading/camera/geometry information */
 
   float          WorldToVoxelsMatrix[16];  /**< Array representing the world to voxels transformation as a matrix */
   float          VoxelsToWorldMatrix[16];  /**< Array representing the voxels to world transformation as a matrix */
   float*          ZBuffer;          /**< Address of the Z Buffer in CPU space */
+  uint2           ZBufferSize;        /**< Size of the Z Buffer allocated on the host */
+  uint2           DeviceZBufferSize;    /**< Size of the Z Buffer array allocated on the device, or 0 when none is */
+  unsigned long   zBufferModified;      /**< Latest modification time of the renderer, its camera and opaque props when the Z Buffer was read back */
+  bool            ZBufferEmpty;        /**< Whether the Z Buffer holds the far plane because there was no opaque prop to read back */
+  bool            ZBufferValid;        /**< Whether the Z Buffer on the host matches the render window (and the device, unless rendering on the host) */
+  bool            ZBufferCollected;      /**< Whether the last call to LoadZBuffer read the render window's depth buffer */
+  unsigned int    NumberOfZBufferAllocations; /**< Number of buffers allocated for the Z Buffer on the host and the device */
   unsigned int      clipModified;        /**< Determines whether the clipping plane set has been modified and needs reloading */
+  bool          HostRendering;        /**< Whether the Z buffer is only needed on the host */
 };
 
 #endif
@@ -0,0 +1,196 @@
+/** @file vtkCUDARuntime.cxx
+*
+*  @brief The interface through which the host code calls the CUDA runtime
+*
+*/
+
+#include "vtkCUDARuntime.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkOpenGL.h>
+
+// CUDA includes (after OpenGL)
+#include <cuda_gl_interop.h>
+
+vtkStandardNewMacro(vtkCUDARuntime);
+
+vtkCUDARuntime::vtkCUDARuntime()
+  {
+  }
+
+vtkCUDARuntime::~vtkCUDARuntime()
+  {
+  }
+
+cudaError_t vtkCUDARuntime::GetDeviceCount( int* count )
+  {
+  return cudaGetDeviceCount( count );
+  }
+
+cudaError_t vtkCUDARuntime::SetDevice( int device )
+  {
+  return cudaSetDevice( device );
+  }
+
+cudaError_t vtkCUDARuntime::GetDevice( int* device )
+  {
+  return cudaGetDevice( device );
+  }
+
+cudaError_t vtkCUDARuntime::DeviceReset( )
+  {
+  return cudaDeviceReset( );
+  }
+
+cudaError_t vtkCUDARuntime::GetDeviceProperties( cudaDeviceProp* properties, int device )
+  {
+  return cudaGetDeviceProperties( properties, device );
+  }
+
+cudaError_t vtkCUDARuntime::MemGetInfo( size_t* freeBytes, size_t* totalBytes )
+  {
+  return cudaMemGetInfo( freeBytes, totalBytes );
+  }
+
+cudaError_t vtkCUDARuntime::GetLastError( )
+  {
+  return cudaGetLastError( );
+  }
+
+cudaError_t vtkCUDARuntime::Malloc( void** pointer, size_t size )
+  {
+  return cudaMalloc( pointer, size );
+  }
+
+cudaError_t vtkCUDARuntime::Free( void* pointer )
+  {
+  return cudaFree( pointer );
+  }
+
+cudaError_t vtkCUDARuntime::HostAlloc( void** pointer, size_t size, unsigned int flags )
+  {
+  return cudaHostAlloc( pointer, size, flags );
+  }
+
+cudaError_t vtkCUDARuntime::FreeHost( void* pointer )
+  {
+  return cudaFreeHost( pointer );
+  }
+
+cudaError_t vtkCUDARuntime::MemcpyAsync( void* destination, const void* source, size_t count, cudaMemcpyKind kind, cudaStream_t stream )
+  {
+  return cudaMemcpyAsync( destination, source, count, kind, stream );
+  }
+
+cudaError_t vtkCUDARuntime::MemsetAsync( void* pointer, int value, size_t count, cudaStream_t stream )
+  {
+  return cudaMemsetAsync( pointer, value, count, stream );
+  }
+
+cudaError_t vtkCUDARuntime::MallocArray( cudaArray** array, const cudaChannelFormatDesc* description, size_t width, size_t height )
+  {
+  return cudaMallocArray( array, description, width, height );
+  }
+
+cudaError_t vtkCUDARuntime::Malloc3DArray( cudaArray** array, const cudaChannelFormatDesc* description, cudaExtent extent )
+  {
+  return cudaMalloc3DArray( array, description, extent );
+  }
+
+cudaError_t vtkCUDARuntime::FreeArray( cudaArray* array )
+  {
+  return cudaFreeArray( array );
+  }
+
+cudaError_t vtkCUDARuntime::MemcpyToArrayAsync( cudaArray* destination, size_t widthOffset, size_t heightOffset, const void* source,
+                                                size_t count, cudaMemcpyKind kind, cudaStream_t stream )
+  {
+  return cudaMemcpyToArrayAsync( destination, widthOffset, heightOffset, source, count, kind, stream );
+  }
+
+cudaError_t vtkCUDARuntime::Memcpy3DAsync( const cudaMemcpy3DParms* parameters, cudaStream_t stream )
+  {
+  return cudaMemcpy3DAsync( parameters, stream );
+  }
+
+cudaError_t vtkCUDARuntime::CreateTextureObject( cudaTextureObject_t* texture, const cudaResourceDesc* resource,
+                                                 const cudaTextureDesc* description, const cudaResourceViewDesc* view )
+  {
+  return cudaCreateTextureObject( texture, resource, description, view );
+  }
+
+cudaError_t vtkCUDARuntime::DestroyTextureObject( cudaTextureObject_t texture )
+  {
+  return cudaDestroyTextureObject( texture );
+  }
+
+cudaError_t vtkCUDARuntime::StreamCreate( cudaStream_t* stream )
+  {
+  return cudaStreamCreate( stream );
+  }
+
+cudaError_t vtkCUDARuntime::StreamDestroy( cudaStream_t stream )
+  {
+  return cudaStreamDestroy( stream );
+  }
+
+cudaError_t vtkCUDARuntime::StreamSynchronize( cudaStream_t stream )
+  {
+  return cudaStreamSynchronize( stream );
+  }
+
+cudaError_t vtkCUDARuntime::StreamWaitEvent( cudaStream_t stream, cudaEvent_t event, unsigned int flags )
+  {
+  return cudaStreamWaitEvent( stream, event, flags );
+  }
+
+cudaError_t vtkCUDARuntime::EventCreate( cudaEvent_t* event, unsigned int flags )
+  {
+  return cudaEventCreateWithFlags( event, flags );
+  }
+
+cudaError_t vtkCUDARuntime::EventDestroy( cudaEvent_t event )
+  {
+  return cudaEventDestroy( event );
+  }
+
+cudaError_t vtkCUDARuntime::EventRecord( cudaEvent_t event, cudaStream_t stream )
+  {
+  return cudaEventRecord( event, stream );
+  }
+
+cudaError_t vtkCUDARuntime::EventSynchronize( cudaEvent_t event )
+  {
+  return cudaEventSynchronize( event );
+  }
+
+cudaError_t vtkCUDARuntime::EventElapsedTime( float* milliseconds, cudaEvent_t start, cudaEvent_t end )
+  {
+  return cudaEventElapsedTime( milliseconds, start, end );
+  }
+
+cudaError_t vtkCUDARuntime::GraphicsGLRegisterBuffer( cudaGraphicsResource** resource, unsigned int buffer, unsigned int flags )
+  {
+  return cudaGraphicsGLRegisterBuffer( resource, (GLuint) buffer, flags );
+  }
+
+cudaError_t vtkCUDARuntime::GraphicsUnregisterResource( cudaGraphicsResource* resource )
+  {
+  return cudaGraphicsUnregisterResource( resource );
+  }
+
+cudaError_t vtkCUDARuntime::GraphicsMapResources( int count, cudaGraphicsResource** resources, cudaStream_t stream )
+  {
+  return cudaGraphicsMapResources( count, resources, stream );
+  }
+
+cudaError_t vtkCUDARuntime::GraphicsUnmapResources( int count, cudaGraphicsResource** resources, cudaStream_t stream )
+  {
+  return cudaGraphicsUnmapResources( count, resources, stream );
+  }
+
+cudaError_t vtkCUDARuntime::GraphicsResourceGetMappedPointer( void** pointer, size_t* size, cudaGraphicsResource* resource )
+  {
+  return cudaGraphicsResourceGetMappedPointer( pointer, size, resource );
+  }
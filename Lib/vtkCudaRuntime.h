@@ -0,0 +1,93 @@
+/** @file vtkCUDARuntime.h
+*
+*  @brief Header file defining the interface through which the host code calls the CUDA runtime
+*
+*  @note The device manager, the CUDA objects, the information handlers and the host functions of the .cu files make
+*        their runtime calls through the runtime held by vtkCUDADeviceManager, so a vtkCUDAMockRuntime can stand in for
+*        the devices on a machine without any and count every allocation, copy and synchronization of the pipeline.
+*        Only the kernel launches go to the device directly.
+*
+*/
+
+#ifndef __vtkCUDARuntime_h
+#define __vtkCUDARuntime_h
+
+// CUDA Volume Rendering includes
+#include "CUDAVolumeRenderingLibExport.h"
+#include "cuda_runtime_api.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+/** @brief vtkCUDARuntime forwards each call to the CUDA runtime function of the same name, with the same arguments
+*          and result, and is subclassed to record or fake the calls
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDARuntime
+  : public vtkObject
+{
+public:
+
+  vtkTypeMacro (vtkCUDARuntime,vtkObject);
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDARuntime* New();
+
+  // Devices
+  virtual cudaError_t GetDeviceCount( int* count );
+  virtual cudaError_t SetDevice( int device );
+  virtual cudaError_t GetDevice( int* device );
+  virtual cudaError_t DeviceReset( );
+  virtual cudaError_t GetDeviceProperties( cudaDeviceProp* properties, int device );
+  virtual cudaError_t MemGetInfo( size_t* freeBytes, size_t* totalBytes );
+  virtual cudaError_t GetLastError( );
+
+  // Memory
+  virtual cudaError_t Malloc( void** pointer, size_t size );
+  virtual cudaError_t Free( void* pointer );
+  virtual cudaError_t HostAlloc( void** pointer, size_t size, unsigned int flags );
+  virtual cudaError_t FreeHost( void* pointer );
+  virtual cudaError_t MemcpyAsync( void* destination, const void* source, size_t count, cudaMemcpyKind kind, cudaStream_t stream );
+  virtual cudaError_t MemsetAsync( void* pointer, int value, size_t count, cudaStream_t stream );
+
+  // Arrays and the texture objects reading them
+  virtual cudaError_t MallocArray( cudaArray** array, const cudaChannelFormatDesc* description, size_t width, size_t height );
+  virtual cudaError_t Malloc3DArray( cudaArray** array, const cudaChannelFormatDesc* description, cudaExtent extent );
+  virtual cudaError_t FreeArray( cudaArray* array );
+  virtual cudaError_t MemcpyToArrayAsync( cudaArray* destination, size_t widthOffset, size_t heightOffset, const void* source,
+                                          size_t count, cudaMemcpyKind kind, cudaStream_t stream );
+  virtual cudaError_t Memcpy3DAsync( const cudaMemcpy3DParms* parameters, cudaStream_t stream );
+  virtual cudaError_t CreateTextureObject( cudaTextureObject_t* texture, const cudaResourceDesc* resource,
+                                           const cudaTextureDesc* description, const cudaResourceViewDesc* view );
+  virtual cudaError_t DestroyTextureObject( cudaTextureObject_t texture );
+
+  // Streams and events
+  virtual cudaError_t StreamCreate( cudaStream_t* stream );
+  virtual cudaError_t StreamDestroy( cudaStream_t stream );
+  virtual cudaError_t StreamSynchronize( cudaStream_t stream );
+  virtual cudaError_t StreamWaitEvent( cudaStream_t stream, cudaEvent_t event, unsigned int flags );
+  virtual cudaError_t EventCreate( cudaEvent_t* event, unsigned int flags );
+  virtual cudaError_t EventDestroy( cudaEvent_t event );
+  virtual cudaError_t EventRecord( cudaEvent_t event, cudaStream_t stream );
+  virtual cudaError_t EventSynchronize( cudaEvent_t event );
+  virtual cudaError_t EventElapsedTime( float* milliseconds, cudaEvent_t start, cudaEvent_t end );
+
+  // OpenGL interoperability
+  virtual cudaError_t GraphicsGLRegisterBuffer( cudaGraphicsResource** resource, unsigned int buffer, unsigned int flags );
+  virtual cudaError_t GraphicsUnregisterResource( cudaGraphicsResource* resource );
+  virtual cudaError_t GraphicsMapResources( int count, cudaGraphicsResource** resources, cudaStream_t stream );
+  virtual cudaError_t GraphicsUnmapResources( int count, cudaGraphicsResource** resources, cudaStream_t stream );
+  virtual cudaError_t GraphicsResourceGetMappedPointer( void** pointer, size_t* size, cudaGraphicsResource* resource );
+
+protected:
+  vtkCUDARuntime();
+  ~vtkCUDARuntime();
+
+private:
+  vtkCUDARuntime& operator=(const vtkCUDARuntime&); /**< not implemented */
+  vtkCUDARuntime(const vtkCUDARuntime&); /**< not implemented */
+};
+
+#endif
@@ -0,0 +1,136 @@
+/** @file vtkCUDATileScheduler.cxx
+*
+*  @brief The scheduler splitting the image a mapper renders on several devices into tiles
+*
+*/
+
+#include "vtkCUDATileScheduler.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cmath>
+
+#define CUDA_MINIMUM_TILE_SHARE 0.01 //fraction of an equal share below which no device falls, so it keeps being timed
+
+vtkStandardNewMacro(vtkCUDATileScheduler);
+
+vtkCUDATileScheduler::vtkCUDATileScheduler()
+  {
+  this->Smoothing = 0.5;
+  this->Imbalance = 1.0;
+  this->SetNumberOfDevices(1);
+  }
+
+vtkCUDATileScheduler::~vtkCUDATileScheduler()
+  {
+  }
+
+void vtkCUDATileScheduler::SetNumberOfDevices(int devices)
+  {
+  devices = (devices > 1) ? devices : 1;
+  this->Shares.assign( devices, 1.0 / (double) devices );
+  this->Rows.assign( devices, 0 );
+  this->Times.assign( devices, -1.0 );
+  this->Imbalance = 1.0;
+  this->Modified();
+  }
+
+void vtkCUDATileScheduler::SetSmoothing(double smoothing)
+  {
+  smoothing = (smoothing < 0.0) ? 0.0 : ((smoothing > 1.0) ? 1.0 : smoothing);
+  if( smoothing == this->Smoothing ) return;
+  this->Smoothing = smoothing;
+  this->Modified();
+  }
+
+void vtkCUDATileScheduler::Reset()
+  {
+  this->SetNumberOfDevices( this->GetNumberOfDevices() );
+  }
+
+double vtkCUDATileScheduler::GetShare(int device) const
+  {
+  if( device < 0 || device >= this->GetNumberOfDevices() ) return 0.0;
+  return this->Shares[device];
+  }
+
+void vtkCUDATileScheduler::GetTile(int device, int numberOfRows, int tile[2])
+  {
+  tile[0] = tile[1] = 0;
+  const int devices = this->GetNumberOfDevices();
+  if( device < 0 || device >= devices || numberOfRows < 1 ) return;
+
+  //place the boundaries between the bands at the cumulative shares, leaving every device at least one row while there are enough
+  int first = 0;
+  int last = numberOfRows;
+  double cumulative = 0.0;
+  for( int d = 0; d < devices; d++ )
+    {
+    int boundary = numberOfRows;
+    if( d + 1 < devices )
+      {
+      cumulative += this->Shares[d];
+      boundary = (int) floor( cumulative * (double) numberOfRows + 0.5 );
+      if( numberOfRows >= devices )
+        {
+        boundary = (boundary > first + 1) ? boundary : first + 1;
+        boundary = (boundary < numberOfRows - (devices - d - 1)) ? boundary : numberOfRows - (devices - d - 1);
+        }
+      boundary = (boundary > first) ? boundary : first;
+      boundary = (boundary < numberOfRows) ? boundary : numberOfRows;
+      }
+    if( d == device )
+      {
+      last = boundary;
+      break;
+      }
+    first = boundary;
+    }
+
+  tile[0] = first;
+  tile[1] = last - first;
+  this->Rows[device] = tile[1];
+  this->Times[device] = -1.0;
+  }
+
+void vtkCUDATileScheduler::ReportTime(int device, double seconds)
+  {
+  if( device < 0 || device >= this->GetNumberOfDevices() ) return;
+  this->Times[device] = seconds;
+  }
+
+bool vtkCUDATileScheduler::Rebalance()
+  {
+  //wait for a frame where every device rendered rows and was timed
+  const int devices = this->GetNumberOfDevices();
+  double rate = 0.0;
+  double meanTime = 0.0;
+  double slowestTime = 0.0;
+  for( int d = 0; d < devices; d++ )
+    {
+    if( this->Rows[d] < 1 || !(this->Times[d] > 0.0) ) return false;
+    rate += (double) this->Rows[d] / this->Times[d];
+    meanTime += this->Times[d] / (double) devices;
+    slowestTime = (this->Times[d] > slowestTime) ? this->Times[d] : slowestTime;
+    }
+  this->Imbalance = slowestTime / meanTime;
+
+  //the shares that would have finished together are proportional to the rows rendered per second
+  double total = 0.0;
+  const double minimumShare = CUDA_MINIMUM_TILE_SHARE / (double) devices;
+  for( int d = 0; d < devices; d++ )
+    {
+    double measured = ((double) this->Rows[d] / this->Times[d]) / rate;
+    double share = (1.0 - this->Smoothing) * this->Shares[d] + this->Smoothing * measured;
+    this->Shares[d] = (share > minimumShare) ? share : minimumShare;
+    total += this->Shares[d];
+    }
+  for( int d = 0; d < devices; d++ )
+    {
+    this->Shares[d] /= total;
+    this->Times[d] = -1.0;
+    }
+  return true;
+  }
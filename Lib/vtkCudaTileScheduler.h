@@ -0,0 +1,106 @@
+/** @file vtkCUDATileScheduler.h
+*
+*  @brief Header file defining the scheduler splitting the image a mapper renders on several devices into tiles
+*
+*  @note The scheduler only ever sees numbers of rows and times, so any number of devices can be simulated on a machine
+*        without one by reporting made up times for the tiles it hands out
+*
+*/
+
+#ifndef __vtkCUDATileScheduler_h
+#define __vtkCUDATileScheduler_h
+
+// CUDA Volume Rendering includes
+#include "CUDAVolumeRenderingLibExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+/** @brief vtkCUDATileScheduler splits the rows of an image into one band per device, resizing the bands from frame to
+*          frame so that every device takes the same time to render its band
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDATileScheduler
+  : public vtkObject
+{
+public:
+
+  vtkTypeMacro (vtkCUDATileScheduler,vtkObject);
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDATileScheduler* New();
+
+  /** @brief Sets the number of devices the image is split among, which restarts them with equal shares
+  *
+  *  @param devices The number of devices, at least 1
+  */
+  void SetNumberOfDevices(int devices);
+  int GetNumberOfDevices() const { return (int) this->Shares.size(); }
+
+  /** @brief Sets how much of the way to the shares measured on the last frame the shares move on each rebalance
+  *
+  *  @param smoothing Between 0 (the shares never change) and 1 (the shares are those measured), 0.5 by default so a
+  *         single slow frame does not throw the bands around
+  */
+  void SetSmoothing(double smoothing);
+  double GetSmoothing() const { return this->Smoothing; }
+
+  /** @brief Gets the band of rows a device renders, the bands covering the image in the order of the devices
+  *
+  *  @param device The index of the device, from 0
+  *  @param numberOfRows The number of rows in the image
+  *  @param tile Receives the first row of the band and its number of rows, each device having at least one row while
+  *         the image has as many rows as there are devices
+  */
+  void GetTile(int device, int numberOfRows, int tile[2]);
+
+  /** @brief Records how long a device took to render the band GetTile last gave it
+  *
+  *  @param device The index of the device
+  *  @param seconds The time from the start of the ray casting to the end of the copy of the band to the host
+  */
+  void ReportTime(int device, double seconds);
+
+  /** @brief Moves the shares towards the rows each device rendered per second on the last frame, once every device has
+  *          reported its time since the last rebalance
+  *
+  *  @return true if the shares were moved
+  */
+  bool Rebalance();
+
+  /** @brief Gets the fraction of the rows of the image a device currently renders
+  *
+  */
+  double GetShare(int device) const;
+
+  /** @brief Gets the ratio of the slowest device's time to the mean time on the last frame reported, 1 when balanced
+  *
+  */
+  double GetImbalance() const { return this->Imbalance; }
+
+  /** @brief Gives every device an equal share again
+  *
+  */
+  void Reset();
+
+protected:
+  vtkCUDATileScheduler();
+  ~vtkCUDATileScheduler();
+
+private:
+  vtkCUDATileScheduler& operator=(const vtkCUDATileScheduler&); /**< not implemented */
+  vtkCUDATileScheduler(const vtkCUDATileScheduler&); /**< not implemented */
+
+  double Smoothing;                 /**< The weight of the last frame's measured shares on each rebalance */
+  double Imbalance;                 /**< The slowest time over the mean time of the last frame rebalanced */
+  std::vector<double> Shares;       /**< The fraction of the rows each device renders, summing to 1 */
+  std::vector<int> Rows;            /**< The number of rows each device was last given */
+  std::vector<double> Times;        /**< The time each device reported for its last band, or a negative value if none */
+};
+
+#endif
@@ -0,0 +1,125 @@
+/** @file vtkCUDAVolumeCache.cxx
+*
+*  @brief The bookkeeping of the volumes resident on the devices, shared by the mappers rendering them
+*
+*/
+
+#include "vtkCUDAVolumeCache.h"
+
+// VTK includes
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+
+vtkStandardNewMacro(vtkCUDAVolumeCache);
+
+bool vtkCUDAVolumeCache::Key::operator<(const Key& other) const
+  {
+  if( this->Image != other.Image ) return this->Image < other.Image;
+  if( this->MTime != other.MTime ) return this->MTime < other.MTime;
+  if( this->Device != other.Device ) return this->Device < other.Device;
+  if( this->Format != other.Format ) return this->Format < other.Format;
+  if( this->Scale != other.Scale ) return this->Scale < other.Scale;
+  if( this->Shift != other.Shift ) return this->Shift < other.Shift;
+  for( int i = 0; i < 3; i++ )
+    if( this->Size[i] != other.Size[i] ) return this->Size[i] < other.Size[i];
+  return false;
+  }
+
+vtkCUDAVolumeCache::vtkCUDAVolumeCache()
+  {
+  this->Lock = new vtkSimpleMutexLock();
+  this->Hits = 0;
+  this->Misses = 0;
+  }
+
+vtkCUDAVolumeCache::~vtkCUDAVolumeCache()
+  {
+  delete this->Lock;
+  }
+
+bool vtkCUDAVolumeCache::Acquire(const Key& key, cudaDeviceVolume& volume)
+  {
+  this->Lock->Lock();
+  std::map<Key, Entry>::iterator it = this->Volumes.find(key);
+  bool held = (it != this->Volumes.end());
+  if( held )
+    {
+    it->second.References++;
+    volume = it->second.Volume;
+    this->Hits++;
+    }
+  else
+    {
+    this->Misses++;
+    }
+  this->Lock->Unlock();
+  return held;
+  }
+
+bool vtkCUDAVolumeCache::Add(const Key& key, cudaDeviceVolume& volume)
+  {
+  this->Lock->Lock();
+  std::map<Key, Entry>::iterator it = this->Volumes.find(key);
+  bool added = (it == this->Volumes.end());
+  if( added )
+    {
+    Entry entry;
+    entry.Volume = volume;
+    entry.References = 1;
+    this->Volumes[key] = entry;
+    this->Copies[volume.Array] = key;
+    }
+  else
+    {
+    it->second.References++;
+    volume = it->second.Volume;
+    }
+  this->Lock->Unlock();
+  return added;
+  }
+
+bool vtkCUDAVolumeCache::Release(const cudaDeviceVolume& volume)
+  {
+  this->Lock->Lock();
+  bool last = true;
+  std::map<cudaArray*, Key>::iterator copy = this->Copies.find(volume.Array);
+  if( copy != this->Copies.end() )
+    {
+    std::map<Key, Entry>::iterator it = this->Volumes.find(copy->second);
+    last = (--(it->second.References) == 0);
+    if( last )
+      {
+      this->Volumes.erase(it);
+      this->Copies.erase(copy);
+      }
+    }
+  this->Lock->Unlock();
+  return last;
+  }
+
+bool vtkCUDAVolumeCache::IsCopyOf(const cudaDeviceVolume& volume, const void* image, unsigned long mtime)
+  {
+  this->Lock->Lock();
+  std::map<cudaArray*, Key>::const_iterator copy = this->Copies.find(volume.Array);
+  bool isCopy = (copy != this->Copies.end() && copy->second.Image == image && copy->second.MTime == mtime);
+  this->Lock->Unlock();
+  return isCopy;
+  }
+
+int vtkCUDAVolumeCache::GetNumberOfVolumes()
+  {
+  this->Lock->Lock();
+  int volumes = (int) this->Volumes.size();
+  this->Lock->Unlock();
+  return volumes;
+  }
+
+int vtkCUDAVolumeCache::GetNumberOfReferences()
+  {
+  this->Lock->Lock();
+  int references = 0;
+  for( std::map<Key, Entry>::const_iterator it = this->Volumes.begin(); it != this->Volumes.end(); it++ )
+    references += it->second.References;
+  this->Lock->Unlock();
+  return references;
+  }
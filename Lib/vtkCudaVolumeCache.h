@@ -0,0 +1,114 @@
+/** @file vtkCUDAVolumeCache.h
+*
+*  @brief Header file defining the bookkeeping of the volumes resident on the devices, shared by the mappers rendering them
+*
+*  @note The cache only counts the references on each volume and says which volume to use or free, the mappers doing the
+*        uploads and deallocations on their own streams, so several views of the same image hold one copy per device
+*
+*/
+
+#ifndef __vtkCUDAVolumeCache_h
+#define __vtkCUDAVolumeCache_h
+
+// CUDA Volume Rendering includes
+#include "CUDAVolumeRenderingLibExport.h"
+#include "CUDA_containerDeviceVolume.h"
+
+// VTK includes
+#include <vtkObject.h>
+class vtkSimpleMutexLock;
+
+// STD includes
+#include <map>
+
+/** @brief vtkCUDAVolumeCache maps each image, as last modified and as packed for a device, to the volume holding it on
+*          that device and the number of mappers using it
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDAVolumeCache
+  : public vtkObject
+{
+public:
+
+  vtkTypeMacro (vtkCUDAVolumeCache,vtkObject);
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDAVolumeCache* New();
+
+  /** @brief What a volume is a copy of: an image as of its modification time, packed in a format on a device
+  *
+  */
+  struct Key
+    {
+    const void* Image;        /**< The image data, by identity */
+    unsigned long MTime;      /**< The modification time of the image when it was copied */
+    int Device;               /**< The device holding the copy */
+    int Format;               /**< The cudaVolumePackingFormat of the copy */
+    float Scale;              /**< The scale of the packing */
+    float Shift;              /**< The shift of the packing */
+    int Size[3];              /**< The size of the copy in voxels, smaller than the image for a low resolution copy */
+
+    bool operator<(const Key& other) const;
+    };
+
+  /** @brief Takes a reference on the volume holding a copy, counting a hit or a miss
+  *
+  *  @param volume Receives the volume if it is held
+  *
+  *  @return true if the copy is held, false if the caller is to upload it and Add it
+  */
+  bool Acquire(const Key& key, cudaDeviceVolume& volume);
+
+  /** @brief Adds a volume the caller has just uploaded, the caller holding its one reference
+  *
+  *  @param volume The uploaded volume, replaced by the one held if another mapper added the same copy in the meantime
+  *
+  *  @return false if the copy was already held, in which case the caller frees its own volume and uses the one returned
+  */
+  bool Add(const Key& key, cudaDeviceVolume& volume);
+
+  /** @brief Gives a reference on a volume back
+  *
+  *  @return true if it was the last one (or the volume is not held), in which case the caller frees the volume
+  */
+  bool Release(const cudaDeviceVolume& volume);
+
+  /** @brief Gets whether a volume holds a copy of an image as of a modification time, whatever its packing
+  *
+  */
+  bool IsCopyOf(const cudaDeviceVolume& volume, const void* image, unsigned long mtime);
+
+  /** @brief Gets the number of volumes held and the references on them */
+  int GetNumberOfVolumes();
+  int GetNumberOfReferences();
+
+  /** @brief Gets the statistics of Acquire since the last reset */
+  int GetNumberOfHits() const { return this->Hits; }
+  int GetNumberOfMisses() const { return this->Misses; }
+  void ResetStatistics() { this->Hits = this->Misses = 0; }
+
+protected:
+  vtkCUDAVolumeCache();
+  ~vtkCUDAVolumeCache();
+
+private:
+  vtkCUDAVolumeCache& operator=(const vtkCUDAVolumeCache&); /**< not implemented */
+  vtkCUDAVolumeCache(const vtkCUDAVolumeCache&); /**< not implemented */
+
+  /** @brief A volume held, and the number of mappers using it */
+  struct Entry
+    {
+    cudaDeviceVolume Volume;
+    int References;
+    };
+
+  vtkSimpleMutexLock* Lock;                    /**< Guards everything below, the mappers loading their frames from any thread */
+  std::map<Key, Entry> Volumes;                /**< The volume holding each copy */
+  std::map<cudaArray*, Key> Copies;            /**< The copy each volume holds, by its array */
+  int Hits;                                    /**< The acquisitions finding their copy held */
+  int Misses;                                  /**< The acquisitions having to upload their copy */
+};
+
+#endif
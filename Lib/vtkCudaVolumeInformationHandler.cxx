@@ -8,6 +8,7 @@
 */
 
 #include "vtkCUDAVolumeInformationHandler.h"
+#include "CPU_vtkCUDAVolumeMapper_pyramid.h"
 
 // VTK includes
 #include <vtkImageData.h>
@@ -25,6 +26,13 @@ vtkCUDAVolumeInformationHandler::vtkCUDAVolumeInformationHandler()
   this->lastModifiedTime = 0;
   this->Volume = NULL;
   this->InputData = NULL;
+  this->VolumeInfo.NumberOfFusedVolumes = 0;
+  this->NumberOfPyramidLevels = 0;
+  this->PyramidReduction = CUDA_PYRAMID_MEAN;
+  this->PyramidInfo.NumberOfLevels = 0;
+  this->PyramidInfo.Reduction = CUDA_PYRAMID_MEAN;
+  this->HostThreadPool = NULL;
+  for( int i = 0; i < 6; i++ ) this->BoundsInset[i] = 0;
   }
 
 vtkCUDAVolumeInformationHandler::~vtkCUDAVolumeInformationHandler()
@@ -92,15 +100,100 @@ void vtkCUDAVolumeInformationHandler::UpdateImageData(int index)
   this->VolumeInfo.MinSpacing = (this->VolumeInfo.MinSpacing > spacing[2]) ? spacing[2] : this->VolumeInfo.MinSpacing;
 
   //calculate the bounds
-  this->VolumeInfo.Bounds[0] = 0.0f;
-  this->VolumeInfo.Bounds[1] = (float) dims[0] - 1.0f;
-  this->VolumeInfo.Bounds[2] = 0.0f;
-  this->VolumeInfo.Bounds[3] = (float) dims[1] - 1.0f;
-  this->VolumeInfo.Bounds[4] = 0.0f;
-  this->VolumeInfo.Bounds[5] = (float) dims[2] - 1.0f;
+  this->VolumeInfo.Bounds[0] = (float) this->BoundsInset[0];
+  this->VolumeInfo.Bounds[1] = (float) (dims[0] - 1 - this->BoundsInset[1]);
+  this->VolumeInfo.Bounds[2] = (float) this->BoundsInset[2];
+  this->VolumeInfo.Bounds[3] = (float) (dims[1] - 1 - this->BoundsInset[3]);
+  this->VolumeInfo.Bounds[4] = (float) this->BoundsInset[4];
+  this->VolumeInfo.Bounds[5] = (float) (dims[2] - 1 - this->BoundsInset[5]);
+
+  //reduce the image into a mip pyramid, whose levels the ray casters sample as the voxels shrink below a pixel
+  if( this->NumberOfPyramidLevels > 0 )
+    {
+    if( !CPU_vtkCUDAVolumeMapper_buildPyramid(this->InputData->GetScalarPointer(), this->InputData->GetScalarType(),
+                                              this->VolumeInfo.VolumeSize, this->NumberOfPyramidLevels, this->PyramidReduction,
+                                              this->PyramidInfo, this->Pyramid, this->HostThreadPool) )
+      vtkErrorMacro(<< "Cannot build the mip pyramid of an image of that type.");
+    }
+  else
+    {
+    this->PyramidInfo.NumberOfLevels = 0;
+    this->Pyramid.clear();
+    }
 
   }
 
+void vtkCUDAVolumeInformationHandler::SetPyramid(int numberOfLevels, int reduction)
+  {
+  numberOfLevels = (numberOfLevels < 0) ? 0 : ((numberOfLevels > CUDA_MAX_PYRAMID_LEVELS) ? CUDA_MAX_PYRAMID_LEVELS : numberOfLevels);
+  if( reduction != CUDA_PYRAMID_MAX && reduction != CUDA_PYRAMID_MIN ) reduction = CUDA_PYRAMID_MEAN;
+  if( numberOfLevels == this->NumberOfPyramidLevels && reduction == this->PyramidReduction ) return;
+  this->NumberOfPyramidLevels = numberOfLevels;
+  this->PyramidReduction = reduction;
+  this->Modified();
+  }
+
+void vtkCUDAVolumeInformationHandler::SetBoundsInset(const int inset[6])
+  {
+  bool changed = false;
+  for( int i = 0; i < 6; i++ )
+    {
+    changed = changed || (this->BoundsInset[i] != inset[i]);
+    this->BoundsInset[i] = inset[i];
+    }
+  if( !changed ) return;
+
+  //the bounds of the image data already set are moved at once
+  if( this->InputData )
+    {
+    int* dims = this->InputData->GetDimensions();
+    for( int a = 0; a < 3; a++ )
+      {
+      this->VolumeInfo.Bounds[2*a] = (float) this->BoundsInset[2*a];
+      this->VolumeInfo.Bounds[2*a+1] = (float) (dims[a] - 1 - this->BoundsInset[2*a+1]);
+      }
+    }
+  this->Modified();
+  }
+
+void vtkCUDAVolumeInformationHandler::SetFusedInputData(int volume, vtkImageData* inputData)
+  {
+  if( volume < 0 || volume >= CUDA_MAX_FUSED_VOLUMES || !inputData ) return;
+  inputData->Update();
+
+  int* dims = inputData->GetDimensions();
+  double* spacing = inputData->GetSpacing();
+
+  this->VolumeInfo.FusedVolumeSize[volume].x = dims[0];
+  this->VolumeInfo.FusedVolumeSize[volume].y = dims[1];
+  this->VolumeInfo.FusedVolumeSize[volume].z = dims[2];
+  this->VolumeInfo.FusedSpacing[volume].x = spacing[0];
+  this->VolumeInfo.FusedSpacing[volume].y = spacing[1];
+  this->VolumeInfo.FusedSpacing[volume].z = spacing[2];
+  double minSpacing = spacing[0];
+  minSpacing = (minSpacing > spacing[1]) ? spacing[1] : minSpacing;
+  minSpacing = (minSpacing > spacing[2]) ? spacing[2] : minSpacing;
+  this->VolumeInfo.FusedMinSpacing[volume] = minSpacing;
+
+  //calculate the bounds
+  float* bounds = this->VolumeInfo.FusedBounds + 6*volume;
+  bounds[0] = 0.0f;
+  bounds[1] = (float) dims[0] - 1.0f;
+  bounds[2] = 0.0f;
+  bounds[3] = (float) dims[1] - 1.0f;
+  bounds[4] = 0.0f;
+  bounds[5] = (float) dims[2] - 1.0f;
+  this->Modified();
+  }
+
+void vtkCUDAVolumeInformationHandler::SetNumberOfFusedVolumes(int numberOfVolumes)
+  {
+  numberOfVolumes = (numberOfVolumes < 0) ? 0 : ((numberOfVolumes > CUDA_MAX_FUSED_VOLUMES) ? CUDA_MAX_FUSED_VOLUMES : numberOfVolumes);
+  if( this->VolumeInfo.NumberOfFusedVolumes == numberOfVolumes ) return;
+  this->VolumeInfo.NumberOfFusedVolumes = numberOfVolumes;
+  this->Modified();
+  }
+
 void vtkCUDAVolumeInformationHandler::Update()
   {
 
@@ -132,4 +225,6 @@ void vtkCUDAVolumeInformationHandler::ClearInput()
   this->Modified();
   this->Volume = NULL;
   this->InputData = NULL;
+  this->PyramidInfo.NumberOfLevels = 0;
+  this->Pyramid.clear();
   }
@@ -11,14 +11,19 @@
 #define __vtkCUDAVolumeInformationHandler_h
 
 // CUDA Volume Rendering includes
+#include "CUDA_containerPyramidInformation.h"
 #include "CUDA_containerVolumeInformation.h"
 #include "vtkCUDAObject.h"
+class vtkCUDAHostThreadPool;
 
 // VTK includes
 #include <vtkObject.h>
 class vtkImageData;
 class vtkVolume;
 
+// STD includes
+#include <vector>
+
 /** @brief vtkCUDAVolumeInformationHandler handles all volume and transfer
 *   function related information on behalf of the CUDA volume mapper to
 *   facilitate the rendering process.
@@ -67,6 +72,19 @@ public:
   */
   vtkImageData* GetInputData() const { return InputData; }
 
+  /** @brief Sets the image data of a volume fused with the rendered one, filling in its size, spacing and bounds
+  *
+  *  @param volume The slot of the fused volume, between 0 and CUDA_MAX_FUSED_VOLUMES (exclusive)
+  *  @param inputData The image data of the fused volume
+  */
+  void SetFusedInputData(int volume, vtkImageData* inputData);
+
+  /** @brief Sets how many of the fused volume slots are composited along with the rendered volume
+  *
+  *  @param numberOfVolumes Between 0 (no fusion) and CUDA_MAX_FUSED_VOLUMES, the slots below it having been set by SetFusedInputData
+  */
+  void SetNumberOfFusedVolumes(int numberOfVolumes);
+
   /** @brief Gets the CUDA compatible container for volume/transfer function related information needed during the rendering process
   *
   */
@@ -83,6 +101,36 @@ public:
   */
   virtual void Update();
 
+  /** @brief Sets the mip pyramid built for each image data set, the levels being built when the next image data is set
+  *
+  *  @param numberOfLevels The number of levels coarser than the image, 0 (the default) for no pyramid
+  *  @param reduction How the voxels of a level are reduced, one of CUDA_PYRAMID_MEAN, CUDA_PYRAMID_MAX or CUDA_PYRAMID_MIN
+  */
+  void SetPyramid(int numberOfLevels, int reduction);
+  int GetNumberOfPyramidLevels() const { return this->NumberOfPyramidLevels; }
+  int GetPyramidReduction() const { return this->PyramidReduction; }
+
+  /** @brief Gets the layout of the mip pyramid of the image data last set, and its levels as floats, level 1 first
+  *
+  *  @see CPU_vtkCUDAVolumeMapper_buildPyramid
+  */
+  const cudaPyramidInformation& GetPyramidInfo() const { return this->PyramidInfo; }
+  const std::vector<float>& GetPyramid() const { return this->Pyramid; }
+
+  /** @brief Sets the threads the mip pyramid is built with, or null to build it on the calling thread
+  *
+  *  @param pool The threads of the mapper, which outlive the handler
+  */
+  void SetHostThreadPool(vtkCUDAHostThreadPool* pool) { this->HostThreadPool = pool; }
+
+  /** @brief Sets how many voxels inside each face of the image data the rays start and end, the voxels outside them only
+  *          being sampled by the interpolation and gradients of the voxels inside
+  *
+  *  @param inset The number of voxels cut from the low x, high x, low y, high y, low z and high z faces, 0 by default (the
+  *         slabs of a volume rendered sort-last hold a slice of their neighbours beyond the faces they share)
+  */
+  void SetBoundsInset(const int inset[6]);
+
 protected:
 
   /** @brief Constructor which sets the pointers to the image and volume to null, as well as setting all the constants to safe initial values, and initializes the image holder on the GPU
@@ -119,6 +167,13 @@ private:
 
   unsigned long lastModifiedTime;      /**< The last time the transfer function was modified, used to determine when to repopulate the transfer function lookup tables */
 
+  int NumberOfPyramidLevels;          /**< The number of levels of the mip pyramid built for each image data */
+  int PyramidReduction;               /**< How the voxels of the levels are reduced */
+  cudaPyramidInformation PyramidInfo; /**< The layout of the mip pyramid of the image data */
+  std::vector<float> Pyramid;         /**< The voxels of the levels of the mip pyramid */
+  vtkCUDAHostThreadPool* HostThreadPool; /**< The threads the pyramid is built with, not owned */
+  int BoundsInset[6];                 /**< The number of voxels cut from each face of the image data by the bounds */
+
 };
 
 #endif
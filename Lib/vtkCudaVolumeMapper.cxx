@@ -15,9 +15,16 @@
 #include "CUDA_containerRendererInformation.h"
 #include "CUDA_containerVolumeInformation.h"
 #include "CUDA_containerOutputImageInformation.h"
+#include "vtkCUDABlockShapeTuner.h"
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAHostThreadPool.h"
+#include "vtkCUDAImageCache.h"
 #include "vtkCUDAOutputImageInformationHandler.h"
 #include "vtkCUDARendererInformationHandler.h"
+#include "vtkCUDARuntime.h"
+#include "vtkCUDATileScheduler.h"
 #include "vtkCUDAVolumeInformationHandler.h"
+#include "cuda_runtime_api.h"
 
 // CUDA Volume Rendering includes
 #include "vtkCUDAVolumeMapper.h"
@@ -32,8 +39,50 @@
 #include <vtkPlanes.h>
 #include <vtkRenderer.h>
 #include <vtkRenderWindow.h>
+#include <vtkRenderWindowInteractor.h>
+#include <vtkTimerLog.h>
 #include <vtkTransform.h>
 #include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
+
+// STD includes
+#include <cmath>
+#include <cstring>
+
+//----------------------------------------------------------------------------
+// Pads the extent of a slab with a slice of its neighbours on the sides it shares with them, so the rays of the slab
+// interpolate and take gradients across its faces as they would in the whole volume
+static void vtkCUDAVolumeMapperPadSlab(const int wholeExtent[6], const int* slabExtent, int paddedExtent[6], int inset[6])
+{
+  for( int i = 0; i < 6; i += 2 )
+    {
+    paddedExtent[i] = (slabExtent[i] > wholeExtent[i]) ? slabExtent[i] - 1 : slabExtent[i];
+    paddedExtent[i+1] = (slabExtent[i+1] < wholeExtent[i+1]) ? slabExtent[i+1] + 1 : slabExtent[i+1];
+    inset[i] = slabExtent[i] - paddedExtent[i];
+    inset[i+1] = paddedExtent[i+1] - slabExtent[i+1];
+    }
+}
+
+//----------------------------------------------------------------------------
+// Copies an extent of an image into an image of its own, placed where it was in the original
+static vtkImageData* vtkCUDAVolumeMapperCropImage(vtkImageData* input, const int extent[6])
+{
+  vtkImageData* output = vtkImageData::New();
+  output->SetOrigin( input->GetOrigin() );
+  output->SetSpacing( input->GetSpacing() );
+  output->SetExtent( extent[0], extent[1], extent[2], extent[3], extent[4], extent[5] );
+  output->SetWholeExtent( extent[0], extent[1], extent[2], extent[3], extent[4], extent[5] );
+  output->SetScalarType( input->GetScalarType() );
+  output->SetNumberOfScalarComponents( input->GetNumberOfScalarComponents() );
+  output->AllocateScalars();
+
+  const size_t rowBytes = (size_t) (extent[1] - extent[0] + 1) * (size_t) input->GetNumberOfScalarComponents() *
+                          (size_t) input->GetScalarSize();
+  for( int z = extent[4]; z <= extent[5]; z++ )
+    for( int y = extent[2]; y <= extent[3]; y++ )
+      memcpy( output->GetScalarPointer(extent[0], y, z), input->GetScalarPointer(extent[0], y, z), rowBytes );
+  return output;
+}
 
 //----------------------------------------------------------------------------
 vtkCUDAVolumeMapper::vtkCUDAVolumeMapper()
@@ -56,6 +105,49 @@ vtkCUDAVolumeMapper::vtkCUDAVolumeMapper()
 
   this->renModified = 0;
   this->volModified = 0;
+  this->OffScreenImageSize[0] = this->OffScreenImageSize[1] = 0;
+
+  //fall back to ray casting on the host when there is no CUDA device to use
+  this->CollectStatistics = false;
+  memset( &(this->RenderStatistics), 0, sizeof(cudaRenderStatistics) );
+
+  this->SamplingMode = MINIMUM_SPACING_SAMPLING;
+  this->QualityLevel = FULL_QUALITY;
+  this->SampleDistanceFactor = 1.0f;
+  this->InteractiveSampleDistanceFactor = 4.0f;
+
+  this->ProgressiveRendering = false;
+  this->MaximumNumberOfProgressivePasses = 16;
+  this->progressiveModified = 0;
+  this->progressiveSampleDistanceFactor = 0.0f;
+  this->rayOffsetsPass = -1;
+
+  this->RenderOnDemand = true;
+  this->ImageCache = vtkCUDAImageCache::New();
+  this->renderedStateValid = false;
+  this->renderedStateCacheable = false;
+  this->settingsModified = 0;
+  this->matricesModified = 0;
+  this->tileSettingsModified = 0;
+
+  this->BlockShape[0] = this->BlockShape[1] = 16;
+  this->AutoTuneBlockShape = true;
+  this->BlockShapeTuner = vtkCUDABlockShapeTuner::New();
+  this->blockShapeDeviceCompute[0] = this->blockShapeDeviceCompute[1] = 0;
+
+  this->MultiDeviceRendering = false;
+  this->MultiDeviceMode = SORT_FIRST_RENDERING;
+  this->TileScheduler = vtkCUDATileScheduler::New();
+  this->CompositingMethod = DIRECT_SEND_COMPOSITING;
+  this->slabInputs = false;
+  this->SlabAxis = -1;
+
+  this->HostThreadPool = vtkCUDAHostThreadPool::New();
+  this->VolumeInfoHandler->SetHostThreadPool( this->HostThreadPool );
+  this->RenderContext = 0;
+  this->RenderBackend = (this->GetDevice() == -1) ? CPU_BACKEND : CUDA_BACKEND;
+  this->RendererInfoHandler->SetHostRendering( this->RenderBackend == CPU_BACKEND );
+  this->OutputInfoHandler->SetHostRendering( this->RenderBackend == CPU_BACKEND );
 
   this->Reinitialize();
 }
@@ -63,7 +155,12 @@ vtkCUDAVolumeMapper::vtkCUDAVolumeMapper()
 //----------------------------------------------------------------------------
 void vtkCUDAVolumeMapper::Deinitialize(int vtkNotUsed(withData))
 {
-  CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadrandomRayOffsets(this->GetStream());
+  if( this->RenderContext )
+    {
+    this->ReserveGPU();
+    CUDA_vtkCUDAVolumeMapper_renderAlgo_destroyContext(this->RenderContext, this->GetStream());
+    }
+  this->RenderContext = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -73,8 +170,14 @@ void vtkCUDAVolumeMapper::Reinitialize(int withData)
   this->RendererInfoHandler->ReplicateObject(this, withData);
   this->OutputInfoHandler->ReplicateObject(this, withData);
 
+  //the block shapes are tuned per device, which is queried again on the next frame
+  this->blockShapeDeviceName.clear();
+
+  //the buffers holding the image last rendered were those of the previous device
+  this->renderedStateValid = false;
+
   //initialize the random ray denoising buffer
-  float randomRayOffsets[256];
+  float* randomRayOffsets = this->RandomRayOffsets;
   randomRayOffsets[0] = 0.70554;  randomRayOffsets[1] = 0.53342;
   randomRayOffsets[2] = 0.57951;  randomRayOffsets[3] = 0.28956;
   randomRayOffsets[4] = 0.30194;  randomRayOffsets[5] = 0.77474;
@@ -203,10 +306,21 @@ void vtkCUDAVolumeMapper::Reinitialize(int withData)
   randomRayOffsets[250] = 0.39893;  randomRayOffsets[251] = 0.90309;
   randomRayOffsets[252] = 0.746;    randomRayOffsets[253] = 0.08855;
   randomRayOffsets[254] = 0.63457;  randomRayOffsets[255] = 0.71302;
-  CUDA_vtkCUDAVolumeMapper_renderAlgo_loadrandomRayOffsets(randomRayOffsets,this->GetStream());
+  if( this->GetDevice() != -1 )
+    {
+    //the device state of this mapper alone, so other mappers can render on the device at the same time
+    this->ReserveGPU();
+    if( !this->RenderContext )
+      this->RenderContext = CUDA_vtkCUDAVolumeMapper_renderAlgo_createContext(this->GetRuntime(), this->GetStream());
+    if( !this->RenderContext )
+      vtkErrorMacro(<< "Could not allocate the device state of the mapper.");
+    CUDA_vtkCUDAVolumeMapper_renderAlgo_loadrandomRayOffsets(this->RenderContext, randomRayOffsets, this->GetStream());
+    }
+  memcpy( this->RayOffsets, randomRayOffsets, sizeof(this->RayOffsets) );
+  this->rayOffsetsPass = 0;
 
-  //re-copy the image data if any
-  if( withData )
+  //re-copy the image data if any, unless the slabs of the devices hold it
+  if( withData && !this->slabInputs )
     for( std::map<int,vtkImageData*>::iterator it = this->inputImages.begin();
       it != this->inputImages.end(); it++ )
       this->SetInputInternal(it->second, it->first);
@@ -216,6 +330,9 @@ void vtkCUDAVolumeMapper::Reinitialize(int withData)
 //----------------------------------------------------------------------------
 vtkCUDAVolumeMapper::~vtkCUDAVolumeMapper()
 {
+  this->ClearTileMappers();
+  this->ClearSlabMappers();
+  this->TileScheduler->UnRegister(this);
   this->Deinitialize();
   this->VolumeInfoHandler->UnRegister(this);
   this->RendererInfoHandler->UnRegister(this);
@@ -227,11 +344,67 @@ vtkCUDAVolumeMapper::~vtkCUDAVolumeMapper()
   this->VoxelsTransform->UnRegister(this);
   this->VoxelsToViewTransform->UnRegister(this);
   this->NextVoxelsToViewTransform->UnRegister(this);
+  this->HostThreadPool->UnRegister(this);
+  this->BlockShapeTuner->UnRegister(this);
+  this->ImageCache->UnRegister(this);
+  for( std::map<int,vtkImageData*>::iterator it = this->inputImages.begin();
+    it != this->inputImages.end(); it++ )
+    it->second->UnRegister(this);
 }
 //----------------------------------------------------------------------------
 void vtkCUDAVolumeMapper::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os,indent);
+  os << indent << "RenderBackend: " << (this->RenderBackend == CPU_BACKEND ? "CPU" : "CUDA") << "\n";
+  os << indent << "SamplingMode: " << (this->SamplingMode == VOXEL_FOOTPRINT_SAMPLING ? "VoxelFootprint" : "MinimumSpacing") << "\n";
+  os << indent << "QualityLevel: " << this->QualityLevel << "\n";
+  os << indent << "SampleDistanceFactor: " << this->SampleDistanceFactor << "\n";
+  os << indent << "InteractiveSampleDistanceFactor: " << this->InteractiveSampleDistanceFactor << "\n";
+  os << indent << "InteropDisplay: " << this->OutputInfoHandler->GetInteropDisplay() << "\n";
+  os << indent << "OneFrameLatency: " << this->OutputInfoHandler->GetOneFrameLatency() << "\n";
+  os << indent << "OffScreenImageSize: " << this->OffScreenImageSize[0] << "x" << this->OffScreenImageSize[1] << "\n";
+  os << indent << "ProgressiveRendering: " << this->ProgressiveRendering << "\n";
+  os << indent << "MaximumNumberOfProgressivePasses: " << this->MaximumNumberOfProgressivePasses << "\n";
+  os << indent << "RenderOnDemand: " << this->RenderOnDemand << "\n";
+  os << indent << "ImageCacheCapacity: " << this->ImageCache->GetCapacity() << " (" << this->ImageCache->GetNumberOfImages() << " images cached)\n";
+  os << indent << "BlockShape: " << this->BlockShape[0] << "x" << this->BlockShape[1] << "\n";
+  os << indent << "AutoTuneBlockShape: " << this->AutoTuneBlockShape << "\n";
+  os << indent << "MultiDeviceRendering: " << this->MultiDeviceRendering << " (" << this->TileMappers.size() + 1 << " devices in use)\n";
+  os << indent << "MultiDeviceMode: " << (this->MultiDeviceMode == SORT_LAST_RENDERING ? "SortLast" : "SortFirst") << "\n";
+  os << indent << "CompositingMethod: " << (this->CompositingMethod == BINARY_SWAP_COMPOSITING ? "BinarySwap" : "DirectSend") << "\n";
+  os << indent << "SlabMappers: " << this->SlabMappers.size() << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetRenderBackend(int backend)
+{
+  if( backend != CUDA_BACKEND && backend != CPU_BACKEND )
+    {
+    vtkErrorMacro(<< "Unknown render backend.");
+    return;
+    }
+  if( backend == CUDA_BACKEND && this->GetDevice() == -1 )
+    {
+    vtkErrorMacro(<< "Cannot render with CUDA without a CUDA device.");
+    return;
+    }
+  if( backend == this->RenderBackend )
+    {
+    return;
+    }
+
+  this->RenderBackend = backend;
+  this->rayOffsetsPass = -1;
+  this->ClearSlabMappers();
+  this->slabInputs = false;
+  this->RendererInfoHandler->SetHostRendering( backend == CPU_BACKEND );
+  this->OutputInfoHandler->SetHostRendering( backend == CPU_BACKEND );
+
+  //re-copy the image data to wherever the new backend reads it from
+  for( std::map<int,vtkImageData*>::iterator it = this->inputImages.begin();
+    it != this->inputImages.end(); it++ )
+    this->SetInputInternal(it->second, it->first);
+  this->Modified();
 }
 
 //-----------------------------------------------------------------------------
@@ -246,31 +419,39 @@ int vtkCUDAVolumeMapper::IsRenderSupported(
 //----------------------------------------------------------------------------
 void vtkCUDAVolumeMapper::SetInput(vtkImageData * input)
 {
-
-  //set information at this level
-  this->vtkVolumeMapper::SetInput(input);
-  this->VolumeInfoHandler->SetInputData(input, 0);
-  this->inputImages.insert( std::pair<int,vtkImageData*>(0,input) );
-
-  //pass down to subclass
-  this->SetInputInternal( input, 0 );
-  this->ChangeFrame(0);
+  this->SetInput(input, 0);
 }
 
 //----------------------------------------------------------------------------
 void vtkCUDAVolumeMapper::SetInput(vtkImageData * input, int index)
 {
   //check for consistency
-  if( index != 0 ) return;
+  if( index < 0 || !input ) return;
 
-  //set information at this level
-  this->vtkVolumeMapper::SetInput(input);
+  //set information at this level, the first frame being the input of the pipeline
+  if( index == 0 ) this->vtkVolumeMapper::SetInput(input);
   this->VolumeInfoHandler->SetInputData(input, index);
-  this->inputImages.insert( std::pair<int,vtkImageData*>(index,input) );
+  input->Register(this);
+  std::map<int, vtkImageData*>::iterator it = this->inputImages.find(index);
+  if( it != this->inputImages.end() )
+    {
+    it->second->UnRegister(this);
+    it->second = input;
+    }
+  else
+    {
+    this->inputImages.insert( std::pair<int,vtkImageData*>(index,input) );
+    }
 
-  //pass down to subclass
-  this->SetInputInternal(input, index);
-  this->ChangeFrame(0);
+  //pass down to subclass (or to the mappers of the slabs holding the frames instead), and to the mappers of the other devices
+  if( this->slabInputs )
+    this->SetSlabInputs(input, index);
+  else
+    this->SetInputInternal(input, index);
+  for( size_t t = 0; t < this->TileMappers.size(); t++ )
+    this->TileMappers[t]->SetInput(input, index);
+  if( index == 0 ) this->ChangeFrame(0);
+  this->Modified();
 }
 
 //----------------------------------------------------------------------------
@@ -283,41 +464,471 @@ void vtkCUDAVolumeMapper::ClearInput()
     it->second->UnRegister(this);
   this->inputImages.clear();
 
-  //pass down to subclass
+  //pass down to subclass, and to the mappers of the other devices, the slabs being cut again from the next input
   this->ClearInputInternal();
+  for( size_t t = 0; t < this->TileMappers.size(); t++ )
+    this->TileMappers[t]->ClearInput();
+  this->ClearSlabMappers();
+  this->slabInputs = false;
+  this->Modified();
 }
 
 //----------------------------------------------------------------------------
 void vtkCUDAVolumeMapper::SetGradientShadingConstants(float darkness)
 {
   this->RendererInfoHandler->SetGradientShadingConstants(darkness);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetSamplingMode(int mode)
+{
+  if( mode != MINIMUM_SPACING_SAMPLING && mode != VOXEL_FOOTPRINT_SAMPLING )
+    {
+    vtkErrorMacro(<< "Unknown sampling mode.");
+    return;
+    }
+  if( mode == this->SamplingMode ) return;
+  this->SamplingMode = mode;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetQualityLevel(int level)
+{
+  if( level != FULL_QUALITY && level != INTERACTIVE_QUALITY && level != AUTOMATIC_QUALITY )
+    {
+    vtkErrorMacro(<< "Unknown quality level.");
+    return;
+    }
+  if( level == this->QualityLevel ) return;
+  this->QualityLevel = level;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetSampleDistanceFactor(float factor)
+{
+  if( !(factor > 0.0f) )
+    {
+    vtkErrorMacro(<< "The sample distance factor must be positive.");
+    return;
+    }
+  if( factor == this->SampleDistanceFactor ) return;
+  this->SampleDistanceFactor = factor;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetInteractiveSampleDistanceFactor(float factor)
+{
+  if( !(factor > 0.0f) )
+    {
+    vtkErrorMacro(<< "The sample distance factor must be positive.");
+    return;
+    }
+  if( factor == this->InteractiveSampleDistanceFactor ) return;
+  this->InteractiveSampleDistanceFactor = factor;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetInteropDisplay(bool interop)
+{
+  if( interop == this->OutputInfoHandler->GetInteropDisplay() ) return;
+  this->OutputInfoHandler->SetInteropDisplay(interop);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::GetInteropDisplay()
+{
+  return this->OutputInfoHandler->GetInteropDisplay();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetOneFrameLatency(bool latency)
+{
+  if( latency == this->OutputInfoHandler->GetOneFrameLatency() ) return;
+  this->OutputInfoHandler->SetOneFrameLatency(latency);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::GetOneFrameLatency()
+{
+  return this->OutputInfoHandler->GetOneFrameLatency();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::ReleaseGraphicsResources(vtkWindow* window)
+{
+  this->OutputInfoHandler->ReleaseGraphicsResources();
+  this->Superclass::ReleaseGraphicsResources(window);
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetProgressiveRendering(bool progressive)
+{
+  if( progressive == this->ProgressiveRendering ) return;
+  this->ProgressiveRendering = progressive;
+  this->OutputInfoHandler->SetProgressiveRendering(progressive);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetMaximumNumberOfProgressivePasses(int passes)
+{
+  this->MaximumNumberOfProgressivePasses = (passes > 1) ? passes : 1;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::IsRefining()
+{
+  return this->ProgressiveRendering &&
+    this->OutputInfoHandler->GetNumberOfAccumulatedPasses() < this->MaximumNumberOfProgressivePasses;
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetRenderOnDemand(bool onDemand)
+{
+  if( onDemand == this->RenderOnDemand ) return;
+  this->RenderOnDemand = onDemand;
+  this->renderedStateValid = false;
+  if( !onDemand ) this->ImageCache->Clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetImageCacheCapacity(int images)
+{
+  if( images == this->ImageCache->GetCapacity() ) return;
+  this->ImageCache->SetCapacity(images);
+}
+
+//----------------------------------------------------------------------------
+int vtkCUDAVolumeMapper::GetImageCacheCapacity()
+{
+  return this->ImageCache->GetCapacity();
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkCUDAVolumeMapper::GetRenderedDataMTime()
+{
+  unsigned long modified = 0;
+  for( std::map<int,vtkImageData*>::iterator it = this->inputImages.begin(); it != this->inputImages.end(); it++ )
+    if( it->second->GetMTime() > modified ) modified = it->second->GetMTime();
+  return modified;
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::ComputeRenderState(vtkRenderer* renderer, vtkVolume* volume, float sampleDistanceFactor,
+                                             vtkCUDAImageCache::Key& state)
+{
+  state.Volume = volume;
+  state.Renderer = renderer;
+  for( int i = 0; i < 4; i++ )
+    for( int j = 0; j < 4; j++ )
+      state.ViewToVoxels[4*i+j] = this->ViewToVoxelsMatrix->GetElement(i, j);
+  const cudaOutputImageInformation& outputInfo = this->OutputInfoHandler->GetOutputImageInfo();
+  state.Resolution[0] = outputInfo.resolution.x;
+  state.Resolution[1] = outputInfo.resolution.y;
+  state.SampleDistanceFactor = sampleDistanceFactor;
+  state.SettingsMTime = this->settingsModified;
+  state.PropertyMTime = volume->GetProperty() ? volume->GetProperty()->GetMTime() : 0;
+  state.DataMTime = this->GetRenderedDataMTime();
+
+  //the planes can be moved without the collection holding them being modified
+  state.ClippingMTime = 0;
+  if( this->ClippingPlanes )
+    {
+    state.ClippingMTime = this->ClippingPlanes->GetMTime();
+    vtkCollectionSimpleIterator it;
+    this->ClippingPlanes->InitTraversal(it);
+    while( vtkPlane* plane = this->ClippingPlanes->GetNextPlane(it) )
+      if( plane->GetMTime() > state.ClippingMTime ) state.ClippingMTime = plane->GetMTime();
+    }
+
+  //the camera is in the matrix, so only the opaque props themselves move the depth the rays stop at
+  state.GeometryMTime = this->RendererInfoHandler->GetOpaquePropsMTime( state.NumberOfOpaqueProps );
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::DisplayUnchangedImage(vtkRenderer* renderer, vtkVolume* volume, float sampleDistanceFactor,
+                                                cudaRenderStatistics* stats)
+{
+  //images still being refined, or rendered with an error, are always rendered again
+  if( !this->RenderOnDemand || this->ProgressiveRendering || this->erroredOut || this->IsRefining() )
+    {
+    this->renderedStateValid = false;
+    return false;
+    }
+
+  vtkCUDAImageCache::Key state;
+  this->ComputeRenderState(renderer, volume, sampleDistanceFactor, state);
+
+  //nothing changed since the image last rendered, which is still in the output buffers
+  if( this->renderedStateValid && state == this->renderedState &&
+      this->OutputInfoHandler->DisplayAgain(volume, renderer, stats) )
+    {
+    if( stats ) stats->ImageReused = 1.0;
+    return true;
+    }
+
+  //the state came back to a recent image, the image last rendered being cached in turn unless it would evict that one
+  const uchar4* image = this->ImageCache->Lookup(state);
+  if( !image || this->ImageCache->GetCapacity() > 1 ) this->CacheRenderedImage();
+  if( image )
+    {
+    this->OutputInfoHandler->DisplayImage(volume, renderer, image, stats);
+    if( stats ) stats->ImageReused = 2.0;
+    return true;
+    }
+
+  this->renderedState = state;
+  this->renderedStateValid = true;
+  this->renderedStateCacheable = (sampleDistanceFactor == this->SampleDistanceFactor);
+  return false;
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::CacheRenderedImage()
+{
+  //interactive images are replaced as soon as the interaction stops, so only the full quality ones are worth keeping
+  if( !this->renderedStateValid || !this->renderedStateCacheable || this->ImageCache->Find(this->renderedState) ) return;
+  uchar4* image = this->ImageCache->Insert(this->renderedState);
+  if( image && !this->OutputInfoHandler->CopyLastImage(image) )
+    this->ImageCache->Remove(this->renderedState);
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::PrepareProgressivePass(vtkVolume* volume, float sampleDistanceFactor)
+{
+  //the camera and volume changes tracked by ComputeMatrices, as well as any setting, modify the mapper
+  //(and a new depth buffer means opaque geometry moved, which shortens the rays the passes reuse)
+  unsigned long modified = this->GetMTime();
+  if( volume->GetProperty() && volume->GetProperty()->GetMTime() > modified )
+    modified = volume->GetProperty()->GetMTime();
+  if( modified != this->progressiveModified || sampleDistanceFactor != this->progressiveSampleDistanceFactor ||
+      this->RendererInfoHandler->GetZBufferCollected() )
+    {
+    this->progressiveModified = modified;
+    this->progressiveSampleDistanceFactor = sampleDistanceFactor;
+    this->OutputInfoHandler->ResetAccumulation();
+    }
+
+  int pass = this->OutputInfoHandler->GetNumberOfAccumulatedPasses();
+  if( pass >= this->MaximumNumberOfProgressivePasses ) return true;
+  this->SetRayOffsetsPass(pass);
+  return false;
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetRayOffsetsPass(int pass)
+{
+  if( pass == this->rayOffsetsPass ) return;
+  this->rayOffsetsPass = pass;
+
+  //each pass shifts every offset by the golden ratio (modulo one step), which spreads the passes evenly along the step
+  for( int i = 0; i < 256; i++ )
+    {
+    double offset = this->RandomRayOffsets[i] + 0.6180339887498949 * pass;
+    this->RayOffsets[i] = (float) (offset - floor(offset));
+    }
+  if( this->RenderBackend == CUDA_BACKEND )
+    {
+    this->ReserveGPU();
+    CUDA_vtkCUDAVolumeMapper_renderAlgo_loadrandomRayOffsets(this->RenderContext, this->RayOffsets, this->GetStream());
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetBlockShape(int x, int y)
+{
+  if( x < 1 || y < 1 || x * y > 1024 )
+    {
+    vtkErrorMacro(<< "Invalid block shape " << x << "x" << y << ".");
+    return;
+    }
+  if( x == this->BlockShape[0] && y == this->BlockShape[1] ) return;
+  this->BlockShape[0] = x;
+  this->BlockShape[1] = y;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetAutoTuneBlockShape(bool autoTune)
+{
+  if( autoTune == this->AutoTuneBlockShape ) return;
+  this->AutoTuneBlockShape = autoTune;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::UpdateBlockShape(std::string& tuningKey)
+{
+  tuningKey.clear();
+  int shape[2] = { this->BlockShape[0], this->BlockShape[1] };
+  if( this->AutoTuneBlockShape && this->RenderBackend == CUDA_BACKEND )
+    {
+    if( this->blockShapeDeviceName.empty() )
+      {
+      cudaDeviceProp properties;
+      if( this->GetRuntime()->GetDeviceProperties(&properties, this->GetDevice()) == cudaSuccess )
+        {
+        this->blockShapeDeviceName = properties.name;
+        this->blockShapeDeviceCompute[0] = properties.major;
+        this->blockShapeDeviceCompute[1] = properties.minor;
+        }
+      }
+    if( !this->blockShapeDeviceName.empty() )
+      {
+      const int3& size = this->VolumeInfoHandler->GetVolumeInfo().VolumeSize;
+      const int volumeSize[3] = { size.x, size.y, size.z };
+      std::string key = vtkCUDABlockShapeTuner::MakeKey( this->blockShapeDeviceName.c_str(),
+        this->blockShapeDeviceCompute[0], this->blockShapeDeviceCompute[1], volumeSize );
+      if( this->BlockShapeTuner->GetBlockShape(key, shape) ) tuningKey = key;
+      }
+    }
+  this->OutputInfoHandler->SetBlockShape( shape[0], shape[1] );
+}
+
+//----------------------------------------------------------------------------
+float vtkCUDAVolumeMapper::UpdateSampling(vtkRenderer* renderer)
+{
+  //the interactor raises the desired update rate above its still update rate while the mouse is moving
+  bool interactive = (this->QualityLevel == INTERACTIVE_QUALITY);
+  if( this->QualityLevel == AUTOMATIC_QUALITY && renderer && renderer->GetRenderWindow() )
+    {
+    vtkRenderWindow* window = renderer->GetRenderWindow();
+    vtkRenderWindowInteractor* interactor = window->GetInteractor();
+    interactive = interactor && window->GetDesiredUpdateRate() > interactor->GetStillUpdateRate();
+    }
+  float factor = interactive ? this->InteractiveSampleDistanceFactor : this->SampleDistanceFactor;
+  this->RendererInfoHandler->SetSampling( this->SamplingMode, factor );
+  return factor;
 }
 
 //----------------------------------------------------------------------------
 void vtkCUDAVolumeMapper::SetRenderOutputScaleFactor(float scaleFactor)
 {
+  if( scaleFactor == this->OutputInfoHandler->GetRenderOutputScaleFactor() ) return;
   this->OutputInfoHandler->SetRenderOutputScaleFactor(scaleFactor);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetOffScreenImageSize(int width, int height)
+{
+  if( width < 1 || height < 1 ) width = height = 0;
+  if( width == this->OffScreenImageSize[0] && height == this->OffScreenImageSize[1] ) return;
+  this->OffScreenImageSize[0] = width;
+  this->OffScreenImageSize[1] = height;
+  this->RendererInfoHandler->SetOffScreenImageSize(width, height);
+  this->OutputInfoHandler->SetOffScreenImageSize(width, height);
+
+  //the projection follows the aspect of the image rather than that of the viewport
+  this->renModified = 0;
+  this->Modified();
 }
 
 //----------------------------------------------------------------------------
 void vtkCUDAVolumeMapper::ChangeFrame(unsigned int frame)
 {
   this->ChangeFrameInternal(frame);
+  for( size_t t = 0; t < this->TileMappers.size(); t++ )
+    this->TileMappers[t]->ChangeFrame(frame);
+  for( size_t s = 0; s < this->SlabMappers.size(); s++ )
+    this->SlabMappers[s]->ChangeFrame(frame);
+  this->Modified();
 }
 
 //----------------------------------------------------------------------------
 void vtkCUDAVolumeMapper::Render(vtkRenderer *renderer, vtkVolume *volume)
 {
+  //split the volume, or the image, among the devices if there are several to render on
+  if( this->UpdateSlabMappers() )
+    {
+    this->RenderSlabs(renderer, volume);
+    return;
+    }
+  if( this->UpdateTileMappers() )
+    {
+    this->RenderTiles(renderer, volume);
+    return;
+    }
+
+  cudaRenderStatistics* stats = this->CollectStatistics ? &(this->RenderStatistics) : 0;
+  double frameStart = vtkTimerLog::GetUniversalTime();
+
   //prepare the 3 main information handlers
   if (volume != this->VolumeInfoHandler->GetVolume()) this->VolumeInfoHandler->SetVolume(volume);
   this->VolumeInfoHandler->Update();
   this->RendererInfoHandler->SetRenderer(renderer);
   this->OutputInfoHandler->SetRenderer(renderer);
-  this->ComputeMatrices();
+  float sampleDistanceFactor = this->UpdateSampling(renderer);
+  double stageStart = vtkTimerLog::GetUniversalTime();
+
+  this->UpdateMatrices();
+  double stageEnd = vtkTimerLog::GetUniversalTime();
+  if( stats ) stats->ComputeMatricesTime = stageEnd - stageStart;
+
+  //an unrelated redraw, or a view rendered recently, displays the image it already has
+  if( this->DisplayUnchangedImage(renderer, volume, sampleDistanceFactor, stats) )
+    {
+    if( stats )
+      {
+      stats->ZBufferTime = stats->ZBufferCollected = stats->ZBufferAllocations = 0.0;
+      stats->RayFormationTime = stats->CompositingTime = stats->SlabCompositingTime = 0.0;
+      stats->NumberOfRays = stats->NumberOfSamples = stats->NumberOfSkippedSamples = stats->RayBufferBytes = 0.0;
+      stats->FrameTime = vtkTimerLog::GetUniversalTime() - frameStart;
+      }
+    return;
+    }
+  if( stats ) stats->ImageReused = 0.0;
+
+  unsigned int zBufferAllocations = this->RendererInfoHandler->GetNumberOfZBufferAllocations();
   this->RendererInfoHandler->LoadZBuffer();
+  stageStart = stageEnd;
+  stageEnd = vtkTimerLog::GetUniversalTime();
+  if( stats )
+    {
+    stats->ZBufferTime = stageEnd - stageStart;
+    stats->ZBufferCollected = this->RendererInfoHandler->GetZBufferCollected() ? 1.0 : 0.0;
+    stats->ZBufferAllocations = (double) (this->RendererInfoHandler->GetNumberOfZBufferAllocations() - zBufferAllocations);
+    }
   this->RendererInfoHandler->SetClippingPlanes( this->ClippingPlanes );
+
+  //a converged progressive image is displayed again as it is: nothing is cast, so nothing is read back either, the
+  //readback buffers being left as they are rather than flipped to the one holding the pass before
+  bool converged = false;
+  if( this->ProgressiveRendering )
+    converged = this->PrepareProgressivePass(volume, sampleDistanceFactor);
+  else
+    this->SetRayOffsetsPass(0);
+  if( converged && !erroredOut && this->OutputInfoHandler->DisplayAgain(volume, renderer, stats) )
+    {
+    if( stats )
+      {
+      stats->ImageReused = 1.0;
+      stats->RayFormationTime = stats->CompositingTime = stats->SlabCompositingTime = 0.0;
+      stats->NumberOfRays = stats->NumberOfSamples = stats->NumberOfSkippedSamples = stats->RayBufferBytes = 0.0;
+      stats->FrameTime = vtkTimerLog::GetUniversalTime() - frameStart;
+      }
+    return;
+    }
+
+  std::string tuningKey;
+  this->UpdateBlockShape(tuningKey);
   this->OutputInfoHandler->Prepare();
 
+  //the passes start again when the converged image is no longer held, and from wherever preparing the output left them
+  if( this->ProgressiveRendering )
+    {
+    if( converged ) this->OutputInfoHandler->ResetAccumulation();
+    this->SetRayOffsetsPass( this->OutputInfoHandler->GetNumberOfAccumulatedPasses() );
+    }
+
   //pass the actual rendering process to the subclass
   if( erroredOut )
     {
@@ -327,10 +938,24 @@ void vtkCUDAVolumeMapper::Render(vtkRenderer *renderer, vtkVolume *volume)
     {
     try
       {
+      //a frame timed for the tuner waits for the device on either side of the ray casting
+      double castStart = 0.0;
+      if( !tuningKey.empty() )
+        {
+        this->CallSyncThreads();
+        castStart = vtkTimerLog::GetUniversalTime();
+        }
       this->InternalRender(renderer, volume, 
         this->RendererInfoHandler->GetRendererInfo(),
         this->VolumeInfoHandler->GetVolumeInfo(),
         this->OutputInfoHandler->GetOutputImageInfo() );
+      if( !tuningKey.empty() && !erroredOut )
+        {
+        this->CallSyncThreads();
+        this->BlockShapeTuner->ReportTime( tuningKey, vtkTimerLog::GetUniversalTime() - castStart );
+        }
+      if( this->ProgressiveRendering && !erroredOut )
+        this->OutputInfoHandler->Accumulate();
       }
     catch(...)
       {
@@ -340,11 +965,479 @@ void vtkCUDAVolumeMapper::Render(vtkRenderer *renderer, vtkVolume *volume)
     }
 
   //display the rendered results
-  this->OutputInfoHandler->Display(volume,renderer);
+  this->OutputInfoHandler->Display(volume,renderer,stats);
+  if( erroredOut ) this->renderedStateValid = false;
+
+  if( stats )
+    {
+    const cudaOutputImageInformation& outputInfo = this->OutputInfoHandler->GetOutputImageInfo();
+    stats->NumberOfRays = (double) outputInfo.resolution.x * (double) outputInfo.resolution.y;
+    stats->FrameTime = vtkTimerLog::GetUniversalTime() - frameStart;
+    }
 
   return;
 }
 
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetMultiDeviceRendering(bool multiDevice)
+{
+  if( multiDevice == this->MultiDeviceRendering ) return;
+  this->MultiDeviceRendering = multiDevice;
+  if( !multiDevice )
+    {
+    this->ClearTileMappers();
+    this->OutputInfoHandler->SetTiledRendering(false);
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetMultiDeviceMode(int mode)
+{
+  if( mode != SORT_FIRST_RENDERING && mode != SORT_LAST_RENDERING )
+    {
+    vtkErrorMacro(<< "Unknown multi-device mode.");
+    return;
+    }
+  if( mode == this->MultiDeviceMode ) return;
+
+  //the mappers of the slabs give this mapper its frames back on the next frame rendered
+  this->MultiDeviceMode = mode;
+  this->ClearTileMappers();
+  this->OutputInfoHandler->SetTiledRendering(false);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetCompositingMethod(int method)
+{
+  if( method != DIRECT_SEND_COMPOSITING && method != BINARY_SWAP_COMPOSITING )
+    {
+    vtkErrorMacro(<< "Unknown compositing method.");
+    return;
+    }
+  if( method == this->CompositingMethod ) return;
+  this->CompositingMethod = method;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::CopyTileSettings(vtkCUDAVolumeMapper* tileMapper)
+{
+  //the tile mappers only ever cast a band of the image, which this mapper displays
+  tileMapper->SetSamplingMode( this->SamplingMode );
+  tileMapper->SetQualityLevel( this->QualityLevel );
+  tileMapper->SetSampleDistanceFactor( this->SampleDistanceFactor );
+  tileMapper->SetInteractiveSampleDistanceFactor( this->InteractiveSampleDistanceFactor );
+  tileMapper->SetBlockShape( this->BlockShape[0], this->BlockShape[1] );
+  tileMapper->SetAutoTuneBlockShape( false );
+  tileMapper->SetRenderOutputScaleFactor( this->OutputInfoHandler->GetRenderOutputScaleFactor() );
+  tileMapper->SetOffScreenImageSize( this->OffScreenImageSize[0], this->OffScreenImageSize[1] );
+  tileMapper->SetGradientShadingConstants( this->RendererInfoHandler->GetRendererInfo().gradShadeScale );
+  tileMapper->SetClippingPlanes( this->ClippingPlanes );
+  tileMapper->SetInteropDisplay( false );
+  tileMapper->SetCollectStatistics( false );
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::CopyTileSettingsIfModified()
+{
+  //the planes can be moved without the collection holding them, or this mapper, being modified
+  unsigned long modified = this->settingsModified;
+  if( this->ClippingPlanes )
+    {
+    vtkCollectionSimpleIterator it;
+    this->ClippingPlanes->InitTraversal(it);
+    while( vtkPlane* plane = this->ClippingPlanes->GetNextPlane(it) )
+      if( plane->GetMTime() > modified ) modified = plane->GetMTime();
+    }
+  if( modified == this->tileSettingsModified ) return;
+  for( size_t t = 0; t < this->TileMappers.size(); t++ )
+    this->CopyTileSettings( this->TileMappers[t] );
+  for( size_t s = 0; s < this->SlabMappers.size(); s++ )
+    this->CopyTileSettings( this->SlabMappers[s] );
+  this->tileSettingsModified = modified;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::UpdateTileMappers()
+{
+  //every device other than the mapper's own casts a band, in the order the devices are numbered
+  std::vector<int> devices;
+  if( this->MultiDeviceRendering && this->MultiDeviceMode == SORT_FIRST_RENDERING && this->RenderBackend == CUDA_BACKEND &&
+      !this->ProgressiveRendering && this->GetDevice() != -1 && this->CanRenderTiles() )
+    {
+    int numberOfDevices = vtkCUDADeviceManager::Singleton()->GetNumberOfDevices();
+    for( int d = 0; d < numberOfDevices; d++ )
+      if( d != this->GetDevice() ) devices.push_back(d);
+    }
+  bool current = (devices.size() == this->TileMappers.size());
+  for( size_t t = 0; current && t < devices.size(); t++ )
+    current = (this->TileMappers[t]->GetDevice() == devices[t]);
+
+  //replicate the frames of the input on the devices, which is only redone when the devices change
+  if( !current )
+    {
+    this->ClearTileMappers();
+    for( size_t t = 0; t < devices.size(); t++ )
+      {
+      vtkCUDAVolumeMapper* tileMapper = this->NewInstance();
+      tileMapper->SetDevice( devices[t] );
+      if( tileMapper->GetDevice() != devices[t] || tileMapper->erroredOut )
+        {
+        vtkWarningMacro(<< "Cannot render on device " << devices[t] << " - leaving it out of the multi-device rendering.");
+        tileMapper->Delete();
+        continue;
+        }
+      this->CopyTileSettings(tileMapper);
+      for( std::map<int,vtkImageData*>::iterator it = this->inputImages.begin(); it != this->inputImages.end(); it++ )
+        tileMapper->SetInput(it->second, it->first);
+      this->TileMappers.push_back(tileMapper);
+      }
+    this->TileScheduler->SetNumberOfDevices( (int) this->TileMappers.size() + 1 );
+    }
+
+  this->OutputInfoHandler->SetTiledRendering( !this->TileMappers.empty() );
+  return !this->TileMappers.empty();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::ClearTileMappers()
+{
+  for( size_t t = 0; t < this->TileMappers.size(); t++ )
+    this->TileMappers[t]->Delete();
+  this->TileMappers.clear();
+  this->TileScheduler->SetNumberOfDevices(1);
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::PrepareTile(vtkRenderer* renderer, vtkVolume* volume, int firstRow, int numberOfRows,
+                                      vtkCUDARendererInformationHandler* zBufferSource)
+{
+  //prepare the 3 main information handlers as for a whole frame, the block shape being left as set
+  if (volume != this->VolumeInfoHandler->GetVolume()) this->VolumeInfoHandler->SetVolume(volume);
+  this->VolumeInfoHandler->Update();
+  this->RendererInfoHandler->SetRenderer(renderer);
+  this->OutputInfoHandler->SetRenderer(renderer);
+  this->UpdateSampling(renderer);
+  this->UpdateMatrices();
+  if( zBufferSource ) this->RendererInfoHandler->LoadZBuffer(zBufferSource);
+  else this->RendererInfoHandler->LoadZBuffer();
+  this->RendererInfoHandler->SetClippingPlanes( this->ClippingPlanes );
+  this->OutputInfoHandler->SetBlockShape( this->BlockShape[0], this->BlockShape[1] );
+  this->OutputInfoHandler->SetTile( firstRow, numberOfRows );
+  this->OutputInfoHandler->Prepare();
+  this->SetRayOffsetsPass(0);
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::CastTile(vtkRenderer* renderer, vtkVolume* volume)
+{
+  if( erroredOut || this->OutputInfoHandler->GetOutputImageInfo().tileSize.y < 1 ) return;
+
+  try
+    {
+    this->OutputInfoHandler->StartTile();
+    this->InternalRender(renderer, volume,
+      this->RendererInfoHandler->GetRendererInfo(),
+      this->VolumeInfoHandler->GetVolumeInfo(),
+      this->OutputInfoHandler->GetOutputImageInfo() );
+    }
+  catch(...)
+    {
+    erroredOut = true;
+    vtkErrorMacro(<< "Internal rendering error - cause unknown - MARKER 2");
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::RenderTiles(vtkRenderer* renderer, vtkVolume* volume)
+{
+  cudaRenderStatistics* stats = this->CollectStatistics ? &(this->RenderStatistics) : 0;
+  double frameStart = vtkTimerLog::GetUniversalTime();
+
+  //the bands split the rows of this mapper's image, which the tile mappers render at the same resolution
+  this->OutputInfoHandler->SetRenderer(renderer);
+  const uint2 resolution = this->OutputInfoHandler->GetOutputImageInfo().resolution;
+  uchar4* image = this->OutputInfoHandler->GetTiledImage();
+  if( !image )
+    {
+    vtkErrorMacro(<< "Cannot allocate the image the bands of the devices are stitched in.");
+    return;
+    }
+
+  //this mapper's band is prepared first, its Z buffer being the one read back from the render window and shared by the
+  //other devices, then their bands are queued, each copying its band back as soon as it is cast, so the devices work
+  //side by side while this mapper casts its own band last (which waits on its device when collecting statistics)
+  const int numberOfTiles = (int) this->TileMappers.size() + 1;
+  int tile[2];
+  this->TileScheduler->GetTile(0, (int) resolution.y, tile);
+  this->PrepareTile(renderer, volume, tile[0], tile[1]);
+  this->CopyTileSettingsIfModified();
+  bool failed = false;
+  for( int t = 1; t < numberOfTiles; t++ )
+    {
+    vtkCUDAVolumeMapper* tileMapper = this->TileMappers[t-1];
+    this->TileScheduler->GetTile(t, (int) resolution.y, tile);
+    tileMapper->PrepareTile(renderer, volume, tile[0], tile[1], this->RendererInfoHandler);
+    tileMapper->CastTile(renderer, volume);
+    const uint2 tileResolution = tileMapper->OutputInfoHandler->GetOutputImageInfo().resolution;
+    if( tileResolution.x == resolution.x && tileResolution.y == resolution.y )
+      {
+      tileMapper->OutputInfoHandler->ReadBackTile(image);
+      continue;
+      }
+
+    //a band cast at another resolution cannot be stitched, which would leave the rows of the last frame in its place
+    vtkErrorMacro(<< "Device " << tileMapper->GetDevice() << " cast its band at " << tileResolution.x << "x" << tileResolution.y
+                  << " instead of " << resolution.x << "x" << resolution.y << " - the band is left out of the image.");
+    tileMapper->OutputInfoHandler->CancelTile();
+    failed = true;
+    }
+  this->CastTile(renderer, volume);
+  if( erroredOut ) vtkErrorMacro(<< "Error propogation in rendering - cause error flag previously set - MARKER 3");
+  this->OutputInfoHandler->ReadBackTile(image);
+
+  //wait for every band, timing each device for the bands of the next frame
+  double stageStart = vtkTimerLog::GetUniversalTime();
+  this->TileScheduler->ReportTime(0, this->OutputInfoHandler->FinishTile());
+  for( int t = 1; t < numberOfTiles; t++ )
+    {
+    vtkCUDAVolumeMapper* tileMapper = this->TileMappers[t-1];
+    this->TileScheduler->ReportTime(t, tileMapper->OutputInfoHandler->FinishTile());
+    failed = failed || tileMapper->erroredOut;
+    }
+  this->TileScheduler->Rebalance();
+  if( stats ) stats->ReadbackTime = vtkTimerLog::GetUniversalTime() - stageStart;
+
+  //a device that failed leaves the multi-device rendering for good, the frame being rendered on this mapper's device
+  //alone rather than displayed with a band missing
+  if( failed )
+    {
+    vtkWarningMacro(<< "Rendering failed on another device - rendering on device " << this->GetDevice() << " only.");
+    this->SetMultiDeviceRendering(false);
+    this->Render(renderer, volume);
+    return;
+    }
+
+  //display the stitched image
+  this->OutputInfoHandler->DisplayTiledImage(volume, renderer, stats);
+  if( stats )
+    {
+    const cudaOutputImageInformation& outputInfo = this->OutputInfoHandler->GetOutputImageInfo();
+    stats->NumberOfRays = (double) outputInfo.tileSize.x * (double) outputInfo.tileSize.y;
+    stats->FrameTime = vtkTimerLog::GetUniversalTime() - frameStart;
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::UpdateSlabMappers()
+{
+  //every device renders a slab, this mapper's own included, the volume being split along its longest axis
+  int numberOfDevices = 0;
+  if( this->MultiDeviceRendering && this->MultiDeviceMode == SORT_LAST_RENDERING && this->RenderBackend == CUDA_BACKEND &&
+      !this->ProgressiveRendering && this->GetDevice() != -1 && this->CanRenderSlabs() && !this->inputImages.empty() )
+    numberOfDevices = vtkCUDADeviceManager::Singleton()->GetNumberOfDevices();
+  std::vector<int> slabExtents;
+  int axis = -1;
+  if( numberOfDevices > 1 )
+    axis = CPU_vtkCUDAVolumeMapper_splitSlabs( this->inputImages.begin()->second->GetExtent(), numberOfDevices, slabExtents );
+
+  //give this mapper its frames back once there is no longer more than one slab to render
+  const int numberOfSlabs = (int) slabExtents.size() / 6;
+  if( numberOfSlabs < 2 )
+    {
+    if( this->slabInputs )
+      {
+      this->ClearSlabMappers();
+      this->slabInputs = false;
+      this->OutputInfoHandler->SetTiledRendering(false);
+      for( std::map<int,vtkImageData*>::iterator it = this->inputImages.begin(); it != this->inputImages.end(); it++ )
+        this->SetInputInternal(it->second, it->first);
+      }
+    return false;
+    }
+
+  //cut the frames into slabs again only when the devices or the extent change
+  if( !this->slabInputs || (int) this->SlabMappers.size() != numberOfSlabs || slabExtents != this->SlabExtents )
+    {
+    //free the frames of this mapper first, so a device never holds more than its slab
+    this->ClearSlabMappers();
+    if( !this->slabInputs )
+      {
+      this->ClearInputInternal();
+      this->slabInputs = true;
+      }
+    this->SlabExtents = slabExtents;
+    this->SlabAxis = axis;
+
+    int* wholeExtent = this->inputImages.begin()->second->GetExtent();
+    for( int s = 0; s < numberOfSlabs; s++ )
+      {
+      vtkCUDAVolumeMapper* slabMapper = this->NewInstance();
+      slabMapper->SetDevice( s );
+      if( slabMapper->GetDevice() != s || slabMapper->erroredOut )
+        {
+        //without every slab there is no image, so the volume is rendered on this mapper's device alone
+        vtkWarningMacro(<< "Cannot render a slab on device " << s << " - rendering on device " << this->GetDevice() << " only.");
+        slabMapper->Delete();
+        this->SetMultiDeviceRendering(false);
+        return this->UpdateSlabMappers();
+        }
+      this->CopyTileSettings(slabMapper);
+      slabMapper->OutputInfoHandler->SetTiledRendering(true);
+      int paddedExtent[6];
+      int inset[6];
+      vtkCUDAVolumeMapperPadSlab( wholeExtent, &(this->SlabExtents[6*s]), paddedExtent, inset );
+      slabMapper->VolumeInfoHandler->SetBoundsInset(inset);
+      this->SlabMappers.push_back(slabMapper);
+      }
+    for( std::map<int,vtkImageData*>::iterator it = this->inputImages.begin(); it != this->inputImages.end(); it++ )
+      this->SetSlabInputs(it->second, it->first);
+    }
+
+  this->OutputInfoHandler->SetTiledRendering(true);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::ClearSlabMappers()
+{
+  for( size_t s = 0; s < this->SlabMappers.size(); s++ )
+    this->SlabMappers[s]->Delete();
+  this->SlabMappers.clear();
+  this->SlabExtents.clear();
+  this->SlabAxis = -1;
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetSlabInputs(vtkImageData* image, int frame)
+{
+  //a frame of another extent than the one split has the slabs cut again on the next frame rendered
+  int* extent = image->GetExtent();
+  const size_t lastSlab = this->SlabExtents.size() - 6;
+  for( int i = 0; i < 6 && !this->SlabExtents.empty(); i++ )
+    if( extent[i] != ((i % 2) ? this->SlabExtents[lastSlab + i] : this->SlabExtents[i]) )
+      {
+      this->ClearSlabMappers();
+      return;
+      }
+
+  for( size_t s = 0; s < this->SlabMappers.size(); s++ )
+    {
+    int paddedExtent[6];
+    int inset[6];
+    vtkCUDAVolumeMapperPadSlab( extent, &(this->SlabExtents[6*s]), paddedExtent, inset );
+    vtkImageData* slab = vtkCUDAVolumeMapperCropImage( image, paddedExtent );
+    this->SlabMappers[s]->SetInput( slab, frame );
+    slab->Delete();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::RenderSlabs(vtkRenderer* renderer, vtkVolume* volume)
+{
+  cudaRenderStatistics* stats = this->CollectStatistics ? &(this->RenderStatistics) : 0;
+  double frameStart = vtkTimerLog::GetUniversalTime();
+
+  //find the camera in the voxels of the whole volume, counted from the first voxel of its extent as the slabs are
+  if (volume != this->VolumeInfoHandler->GetVolume()) this->VolumeInfoHandler->SetVolume(volume);
+  this->RendererInfoHandler->SetRenderer(renderer);
+  this->OutputInfoHandler->SetRenderer(renderer);
+  this->UpdateMatrices();
+  vtkCamera* camera = renderer->GetActiveCamera();
+  double eye[4];
+  if( camera->GetParallelProjection() )
+    {
+    camera->GetDirectionOfProjection(eye);
+    eye[0] = -eye[0];
+    eye[1] = -eye[1];
+    eye[2] = -eye[2];
+    eye[3] = 0.0;
+    }
+  else
+    {
+    camera->GetPosition(eye);
+    eye[3] = 1.0;
+    }
+  this->WorldToVoxelsMatrix->MultiplyPoint(eye, eye);
+  int* extent = this->VolumeInfoHandler->GetInputData()->GetExtent();
+  for( int a = 0; a < 3; a++ )
+    eye[a] += eye[3] * (double) extent[2*a];
+  std::vector<int> order;
+  CPU_vtkCUDAVolumeMapper_orderSlabs( this->SlabExtents, this->SlabAxis, eye, order );
+
+  //queue the slab of every device over the whole image, each copying its image back as soon as it is cast
+  const uint2 resolution = this->OutputInfoHandler->GetOutputImageInfo().resolution;
+  uchar4* image = this->OutputInfoHandler->GetTiledImage();
+  if( !image )
+    {
+    vtkErrorMacro(<< "Cannot allocate the image the slabs of the devices are composited in.");
+    return;
+    }
+  this->CopyTileSettingsIfModified();
+  const int numberOfSlabs = (int) this->SlabMappers.size();
+  std::vector<const uchar4*> partials( numberOfSlabs, (const uchar4*) 0 );
+
+  //the first slab reads the Z buffer back from the render window, the others sharing it
+  for( int s = 0; s < numberOfSlabs; s++ )
+    {
+    vtkCUDAVolumeMapper* slabMapper = this->SlabMappers[s];
+    slabMapper->PrepareTile(renderer, volume, 0, (int) resolution.y, s > 0 ? this->SlabMappers[0]->RendererInfoHandler : 0);
+    slabMapper->CastTile(renderer, volume);
+    const uint2 slabResolution = slabMapper->OutputInfoHandler->GetOutputImageInfo().resolution;
+    uchar4* partial = slabMapper->OutputInfoHandler->GetTiledImage();
+    if( slabResolution.x != resolution.x || slabResolution.y != resolution.y || !partial )
+      {
+      slabMapper->OutputInfoHandler->CancelTile();
+      continue;
+      }
+    slabMapper->OutputInfoHandler->ReadBackTile(partial);
+    partials[s] = partial;
+    }
+
+  //wait for every slab, then composite them front to back
+  double stageStart = vtkTimerLog::GetUniversalTime();
+  bool failed = false;
+  for( int s = 0; s < numberOfSlabs; s++ )
+    {
+    this->SlabMappers[s]->OutputInfoHandler->FinishTile();
+    failed = failed || this->SlabMappers[s]->erroredOut || !partials[s];
+    }
+  double stageEnd = vtkTimerLog::GetUniversalTime();
+  if( stats ) stats->ReadbackTime = stageEnd - stageStart;
+  if( !failed )
+    failed = !CPU_vtkCUDAVolumeMapper_compositeSlabs( partials, order, resolution, this->CompositingMethod, image,
+                                                      this->SlabCompositingBuffer, this->HostThreadPool );
+  if( stats ) stats->SlabCompositingTime = vtkTimerLog::GetUniversalTime() - stageEnd;
+
+  //display the composited image
+  if( !failed ) this->OutputInfoHandler->DisplayTiledImage(volume, renderer, stats);
+  if( stats )
+    {
+    stats->NumberOfRays = (double) numberOfSlabs * (double) resolution.x * (double) resolution.y;
+    stats->BytesReadBack = 4.0 * stats->NumberOfRays;
+    stats->FrameTime = vtkTimerLog::GetUniversalTime() - frameStart;
+    }
+
+  //a slab that failed leaves the sort-last rendering for good, this mapper loading the frames again for the next frame
+  if( failed )
+    {
+    vtkWarningMacro(<< "Rendering a slab failed - rendering on device " << this->GetDevice() << " only.");
+    this->SetMultiDeviceRendering(false);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::UpdateMatrices()
+{
+  //tell the changes of settings from those of the matrices, which a camera going back to a preset view undoes
+  unsigned long modified = this->GetMTime();
+  if( modified != this->matricesModified ) this->settingsModified = modified;
+  this->ComputeMatrices();
+  if( this->GetMTime() != modified ) this->matricesModified = this->GetMTime();
+}
+
 //----------------------------------------------------------------------------
 void vtkCUDAVolumeMapper::ComputeMatrices()
 {
@@ -361,10 +1454,14 @@ void vtkCUDAVolumeMapper::ComputeMatrices()
     // Get the camera from the renderer
     vtkCamera *cam = ren->GetActiveCamera();
 
-    // Get the aspect ratio from the renderer. This is needed for the
-    // computation of the perspective matrix
-    ren->ComputeAspect();
-    double *aspect = ren->GetAspect();
+    // Get the aspect ratio from the renderer, or the image rendered off screen. This is
+    // needed for the computation of the perspective matrix
+    double aspect[2] = { (double) this->OffScreenImageSize[0], (double) this->OffScreenImageSize[1] };
+    if( this->OffScreenImageSize[0] == 0 )
+      {
+      ren->ComputeAspect();
+      ren->GetAspect(aspect);
+      }
 
     // Keep track of the projection matrix - we'll need it in a couple of places
     // Get the projection matrix. The method is called perspective, but
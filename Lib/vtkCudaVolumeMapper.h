@@ -12,13 +12,20 @@
 
 // CUDA Volume Rendering includes
 #include "vtkCUDAObject.h"
+#include "CPU_vtkCUDAVolumeMapper_composite.h"
 #include "CUDA_containerOutputImageInformation.h"
 #include "CUDA_containerRendererInformation.h"
 #include "CUDA_containerVolumeInformation.h"
 #include "CUDA_container1DTransferFunctionInformation.h"
+#include "CUDA_containerRenderStatistics.h"
+#include "vtkCUDAImageCache.h"
+class vtkCUDABlockShapeTuner;
+class vtkCUDAHostThreadPool;
 class vtkCUDAOutputImageInformationHandler;
 class vtkCUDARendererInformationHandler;
+class vtkCUDATileScheduler;
 class vtkCUDAVolumeInformationHandler;
+struct CUDA_vtkCUDAVolumeMapper_renderContext;
 
 // VTK includes
 #include <vtkVolumeMapper.h>
@@ -28,9 +35,12 @@ class vtkRenderWindow;
 class vtkTransform;
 class vtkVolume;
 class vtkVolumeProperty;
+class vtkWindow;
 
 // STD includes
 #include <map>
+#include <string>
+#include <vector>
 
 /** @brief vtkCUDAVolumeMapper is an abstract CUDA volume mapper
 *   Taking a set of 3D image data objects, volume and renderer as input and
@@ -59,10 +69,21 @@ public:
   *  @param frame The desired frame number when this data is rendered
   *
   *  @pre All dataset being rendered are the same size, anatomy, patient and modality
+  *  @note Frame 0 is the input of the pipeline, and setting it makes it the frame rendered
   */
   void SetInput( vtkImageData * image, int frame);
   virtual void SetInputInternal( vtkImageData * image, int frame) = 0;
 
+  /** @brief Changes the next frame to be rendered to the provided frame
+  *
+  *  @param frame The next frame to be rendered
+  *
+  *  @pre frame is a non-negative integer less than the total number of frames
+  *  @note Subclasses keeping several frames on the device make this a texture rebind for the frames held
+  */
+  void ChangeFrame(unsigned int frame);
+  virtual void ChangeFrameInternal(unsigned int frame) = 0;
+
   /** @brief Uses the provided renderer and volume to render the image data at the current frame
   *
   *  @note This is an internal method used primarily by the rendering pipeline
@@ -84,6 +105,17 @@ public:
   */
   void SetRenderOutputScaleFactor(float scaleFactor);
 
+  /** @brief Sets the size of the image rendered off screen, which is left in host memory (or read back into it) rather
+  *          than displayed, so the renderer given to Render needs no render window or OpenGL context
+  *
+  *  @param width The width of the image in pixels, or 0 to render at the size of the renderer's viewport and display it
+  *  @param height The height of the image in pixels
+  *
+  *  @note Off screen the rays run to the far plane, there being no depth buffer of opaque props to stop at
+  */
+  void SetOffScreenImageSize(int width, int height);
+  void GetOffScreenImageSize(int size[2]) { size[0] = this->OffScreenImageSize[0]; size[1] = this->OffScreenImageSize[1]; }
+
   /** @brief Set the strength of the photorealistic shading model which is given to the renderer information handler
   *
   *  @param darkness Floating point between 0.0f and 1.0f inclusive, where 0.0f means no shading, and 1.0f means maximal shading
@@ -96,6 +128,220 @@ public:
   */
   virtual int IsRenderSupported(vtkRenderWindow *vtkNotUsed(window), vtkVolumeProperty *vtkNotUsed(property));
 
+  /** @brief The places the rays can be cast
+  *
+  */
+  enum RenderBackendType
+    {
+    CUDA_BACKEND = 0, /**< Ray cast on the CUDA device */
+    CPU_BACKEND = 1   /**< Ray cast on the host threads, used by default when no CUDA device is available */
+    };
+
+  /** @brief Selects where the rays are cast, moving the image data to the new backend if required
+  *
+  *  @param backend One of CUDA_BACKEND or CPU_BACKEND
+  *
+  *  @pre A CUDA device is available if backend is CUDA_BACKEND
+  */
+  virtual void SetRenderBackend(int backend);
+  int GetRenderBackend() { return this->RenderBackend; }
+
+  /** @brief Gets the host threads used by the CPU backend, which can be resized through SetNumberOfThreads
+  *
+  */
+  vtkCUDAHostThreadPool* GetHostThreadPool() { return this->HostThreadPool; }
+
+  /** @brief How the step between the samples along a ray is chosen
+  *
+  */
+  enum SamplingModeType
+    {
+    MINIMUM_SPACING_SAMPLING = CUDA_SAMPLE_MINIMUM_SPACING, /**< Step by the smallest voxel spacing, whatever the direction of the ray */
+    VOXEL_FOOTPRINT_SAMPLING = CUDA_SAMPLE_VOXEL_FOOTPRINT  /**< Step by one voxel along the direction of the ray, so anisotropic volumes are not oversampled */
+    };
+
+  /** @brief Selects how the step between samples is chosen, the opacities being corrected so the image is consistent across steps
+  *
+  *  @param mode One of MINIMUM_SPACING_SAMPLING (the default) or VOXEL_FOOTPRINT_SAMPLING
+  */
+  void SetSamplingMode(int mode);
+  int GetSamplingMode() { return this->SamplingMode; }
+
+  /** @brief The sampling qualities the mapper can render at
+  *
+  */
+  enum QualityLevelType
+    {
+    FULL_QUALITY = 0,        /**< Always sample with the full quality sample distance factor */
+    INTERACTIVE_QUALITY = 1, /**< Always sample with the interactive sample distance factor */
+    AUTOMATIC_QUALITY = 2    /**< Sample with the interactive factor while the render window is interacted with, and at full quality when it is still */
+    };
+
+  /** @brief Selects the sampling quality, so interaction can be rendered with coarse sampling and refined once the mouse is still
+  *
+  *  @param level One of FULL_QUALITY (the default), INTERACTIVE_QUALITY or AUTOMATIC_QUALITY
+  */
+  void SetQualityLevel(int level);
+  int GetQualityLevel() { return this->QualityLevel; }
+
+  /** @brief Sets the multiplier of the step the sampling mode chooses when rendering at full quality
+  *
+  *  @param factor Positive multiplier, 1.0f by default, where values below 1.0f oversample
+  */
+  void SetSampleDistanceFactor(float factor);
+  float GetSampleDistanceFactor() { return this->SampleDistanceFactor; }
+
+  /** @brief Sets the multiplier of the step the sampling mode chooses when rendering at interactive quality
+  *
+  *  @param factor Positive multiplier, 4.0f by default
+  */
+  void SetInteractiveSampleDistanceFactor(float factor);
+  float GetInteractiveSampleDistanceFactor() { return this->InteractiveSampleDistanceFactor; }
+
+  /** @brief Sets whether the CUDA backend displays its image through a CUDA-GL pixel buffer rather than copying it through the host
+  *
+  *  @param interop true (the default) to keep the image on the device, falling back on the host copy whenever the render
+  *         window or device cannot share the buffer
+  */
+  void SetInteropDisplay(bool interop);
+  bool GetInteropDisplay();
+
+  /** @brief Sets whether the image read back through the host is displayed a frame late, so reading back one frame overlaps
+  *          preparing the next without the host waiting on the copy
+  *
+  *  @param latency true for throughput-oriented batch rendering, false (the default) to always display the frame just rendered
+  */
+  void SetOneFrameLatency(bool latency);
+  bool GetOneFrameLatency();
+
+  /** @brief Releases the OpenGL resources of the interop display
+  *
+  */
+  virtual void ReleaseGraphicsResources(vtkWindow* window);
+
+  /** @brief Sets whether the renders of an unchanged scene are averaged, each one starting its rays at new jittered offsets
+  *
+  *  @param progressive true to refine the image over successive renders, restarting whenever the camera, volume, transfer
+  *         functions or mapper settings change
+  */
+  void SetProgressiveRendering(bool progressive);
+  bool GetProgressiveRendering() { return this->ProgressiveRendering; }
+
+  /** @brief Sets the number of passes after which the image is considered converged and is displayed again without ray casting
+  *
+  *  @param passes Number of passes averaged, at least 1 (16 by default)
+  */
+  void SetMaximumNumberOfProgressivePasses(int passes);
+  int GetMaximumNumberOfProgressivePasses() { return this->MaximumNumberOfProgressivePasses; }
+
+  /** @brief Gets whether progressive rendering has not yet converged, in which case the scene should be rendered again while idle
+  *
+  */
+  virtual bool IsRefining();
+
+  /** @brief Sets whether a render of a state already rendered displays its image again instead of casting it again
+  *
+  *  @param onDemand true (the default) to key each image on the camera, volume, transfer functions, clipping, data and
+  *         viewport, redisplaying the image last rendered when the key is unchanged and one from the image cache when the
+  *         key comes back to one of the recent images. Progressive, multi-device and refining renders are always cast.
+  */
+  void SetRenderOnDemand(bool onDemand);
+  bool GetRenderOnDemand() { return this->RenderOnDemand; }
+
+  /** @brief Sets the number of recent full quality images kept on the host, so switching between preset views is instant
+  *
+  *  @param images Number of images, 0 to only ever redisplay the image last rendered (4 by default)
+  */
+  void SetImageCacheCapacity(int images);
+  int GetImageCacheCapacity();
+
+  /** @brief Gets the cache of recent images, for its statistics
+  *
+  */
+  vtkCUDAImageCache* GetImageCache() { return this->ImageCache; }
+
+  /** @brief Sets whether the ray formation, compositing and readback stages are timed separately, which synchronizes the device between them
+  *
+  *  @param collect true to fill GetRenderStatistics with each frame rendered
+  */
+  void SetCollectStatistics(bool collect) { this->CollectStatistics = collect; }
+  bool GetCollectStatistics() { return this->CollectStatistics; }
+
+  /** @brief Gets the per-stage timings and work counts of the last frame rendered while collecting statistics
+  *
+  */
+  const cudaRenderStatistics& GetRenderStatistics() { return this->RenderStatistics; }
+
+  /** @brief Sets the shape of the thread blocks the CUDA backend casts the rays in, used whenever the shape is not tuned
+  *
+  *  @param x Number of threads of a block along x (16 by default)
+  *  @param y Number of threads of a block along y (16 by default), the block holding at most the device's maximum number of threads
+  */
+  void SetBlockShape(int x, int y);
+  void GetBlockShape(int shape[2]) { shape[0] = this->BlockShape[0]; shape[1] = this->BlockShape[1]; }
+
+  /** @brief Sets whether the CUDA backend times the candidate block shapes over the first frames of each device and volume size, then keeps the fastest
+  *
+  *  @param autoTune true (the default) to tune the block shape, false to always use the one given to SetBlockShape
+  */
+  void SetAutoTuneBlockShape(bool autoTune);
+  bool GetAutoTuneBlockShape() { return this->AutoTuneBlockShape; }
+
+  /** @brief Gets the tuner of the block shapes, which keeps them in memory only unless given a cache file through SetCacheFileName
+  *
+  */
+  vtkCUDABlockShapeTuner* GetBlockShapeTuner() { return this->BlockShapeTuner; }
+
+  /** @brief Sets whether the rendering is split among every CUDA device, in the way chosen by SetMultiDeviceMode
+  *
+  *  @param multiDevice true to render on all the devices, false (the default) to render on the mapper's device only
+  *
+  *  @note Progressive rendering, the CPU backend and inputs the subclass cannot split (see CanRenderTiles and
+  *        CanRenderSlabs) stay on the mapper's device, and the block shape is not tuned while the rendering is split.
+  */
+  void SetMultiDeviceRendering(bool multiDevice);
+  bool GetMultiDeviceRendering() { return this->MultiDeviceRendering; }
+
+  /** @brief The ways the rendering can be split among the devices
+  *
+  */
+  enum MultiDeviceModeType
+    {
+    SORT_FIRST_RENDERING = 0, /**< Split the image into bands of rows, every device holding the whole volume and the band of each one being resized from frame to frame by the tile scheduler so they all finish together */
+    SORT_LAST_RENDERING = 1   /**< Split the volume into slabs, every device holding only its slab and ray casting it over the whole image, for volumes too large for any one device */
+    };
+
+  /** @brief Selects how the rendering is split among the devices when rendering on several of them
+  *
+  *  @param mode One of SORT_FIRST_RENDERING (the default) or SORT_LAST_RENDERING
+  *
+  *  @note Rendering sort-last, this mapper frees its own copy of the frames, and the images of the slabs are composited on
+  *        the host in the order the camera sees the slabs before being displayed
+  */
+  void SetMultiDeviceMode(int mode);
+  int GetMultiDeviceMode() { return this->MultiDeviceMode; }
+
+  /** @brief How the images of the slabs are composited when rendering sort-last
+  *
+  */
+  enum CompositingMethodType
+    {
+    DIRECT_SEND_COMPOSITING = CUDA_COMPOSITE_DIRECT_SEND, /**< Composite every slab at once over each region of the image */
+    BINARY_SWAP_COMPOSITING = CUDA_COMPOSITE_BINARY_SWAP  /**< Composite the slabs pairwise in rounds, halving the region each pair works on */
+    };
+
+  /** @brief Selects how the images of the slabs are composited when rendering sort-last
+  *
+  *  @param method One of DIRECT_SEND_COMPOSITING (the default) or BINARY_SWAP_COMPOSITING
+  */
+  void SetCompositingMethod(int method);
+  int GetCompositingMethod() { return this->CompositingMethod; }
+
+  /** @brief Gets the scheduler sizing the bands of the devices, whose smoothing can be changed through SetSmoothing
+  *
+  */
+  vtkCUDATileScheduler* GetTileScheduler() { return this->TileScheduler; }
+
 protected:
   /** @brief Constructor which initializes the number of frames, rendering type and other constants to safe initial values, and creates the required information handlers
   *
@@ -107,15 +353,6 @@ protected:
   */
   virtual ~vtkCUDAVolumeMapper();
 
-  /** @brief Changes the next frame to be rendered to the provided frame
-  *
-  *  @param frame The next frame to be rendered
-  *
-  *  @pre frame is a non-negative integer less than the total number of frames
-  */
-  void ChangeFrame(unsigned int frame);
-  virtual void ChangeFrameInternal(unsigned int frame) = 0;
-
   /** @brief Clears all the frames in the 4D sequence
   *
   */
@@ -147,7 +384,185 @@ protected:
   vtkTransform  *NextVoxelsToViewTransform;   /**< Temporary storage of the next voxels to view transformation used to speed the process of switching/recalculating matrices */
 
   bool erroredOut;                            /**< Boolean to describe whether it is safe to render */
-  std::map<int, vtkImageData*> inputImages;
+  std::map<int, vtkImageData*> inputImages;  /**< The 3D image data of each frame of the 4D sequence, registered by the mapper */
+
+  int RenderBackend;                          /**< Where the rays are cast, one of CUDA_BACKEND or CPU_BACKEND */
+  int OffScreenImageSize[2];                  /**< The size of the image rendered without a window, or 0 to render the viewport */
+  vtkCUDAHostThreadPool* HostThreadPool;      /**< The threads the image tiles of the CPU backend and the voxel conversion are shared among */
+  float RandomRayOffsets[256];                /**< The 16x16 random ray offsets used to de-artifact the image (kept for the CPU backend) */
+  CUDA_vtkCUDAVolumeMapper_renderContext* RenderContext; /**< The device state of this mapper, 0 without a CUDA device */
+
+  int SamplingMode;                           /**< How the step between samples is chosen, one of the SamplingModeType values */
+  int QualityLevel;                           /**< Which sample distance factor is used, one of the QualityLevelType values */
+  float SampleDistanceFactor;                 /**< Multiplier of the step when rendering at full quality */
+  float InteractiveSampleDistanceFactor;      /**< Multiplier of the step when rendering at interactive quality */
+
+  /** @brief Chooses the sample distance factor of the next frame from the quality level and the render window's desired update rate
+  *
+  *  @return The sample distance factor chosen
+  */
+  float UpdateSampling(vtkRenderer* renderer);
+
+  /** @brief Restarts the accumulation if anything changed since the last pass and loads the ray offsets of the next pass
+  *
+  *  @param volume The volume being rendered, whose property holds the transfer functions
+  *  @param sampleDistanceFactor The sample distance factor the pass is rendered with
+  *
+  *  @return true if the accumulated image has converged, so there is nothing left to ray cast
+  */
+  bool PrepareProgressivePass(vtkVolume* volume, float sampleDistanceFactor);
+
+  /** @brief Loads the ray offsets of a progressive pass, which are the random ray offsets for the first pass
+  *
+  */
+  void SetRayOffsetsPass(int pass);
+
+  bool ProgressiveRendering;                  /**< Whether successive renders of an unchanged scene are averaged */
+  int MaximumNumberOfProgressivePasses;       /**< The number of passes after which the accumulated image is left as it is */
+  unsigned long progressiveModified;          /**< The modified time of the mapper and volume property the accumulated image was rendered with */
+  float progressiveSampleDistanceFactor;      /**< The sample distance factor the accumulated image was rendered with */
+  int rayOffsetsPass;                         /**< The pass whose ray offsets are in RayOffsets and loaded on the device, or -1 if none */
+  float RayOffsets[256];                      /**< The 16x16 ray offsets of the pass being rendered */
+
+  /** @brief Passes the block shape of the next frame to the output image information handler
+  *
+  *  @param tuningKey Receives the key of the device and volume size if the frame is timed for the tuner, or else is cleared
+  */
+  void UpdateBlockShape(std::string& tuningKey);
+
+  int BlockShape[2];                          /**< The shape of the thread blocks used when not tuning */
+  bool AutoTuneBlockShape;                    /**< Whether the block shape is tuned for each device and volume size */
+  vtkCUDABlockShapeTuner* BlockShapeTuner;    /**< The tuner timing the candidate block shapes */
+  std::string blockShapeDeviceName;           /**< The name of the device in the tuner's keys, or empty if not yet queried */
+  int blockShapeDeviceCompute[2];             /**< The compute capability of the device in the tuner's keys */
+
+  /** @brief Gets the latest modification time of the image data rendered, which is every frame of the input by default
+  *
+  *  @note Subclasses rendering other data along with the input, such as fused volumes, add the modification times of
+  *        that data, its transfer functions and matrices
+  */
+  virtual unsigned long GetRenderedDataMTime();
+
+  /** @brief Fills in the key of the image about to be rendered
+  *
+  *  @pre ComputeMatrices has been called for the frame
+  */
+  void ComputeRenderState(vtkRenderer* renderer, vtkVolume* volume, float sampleDistanceFactor, vtkCUDAImageCache::Key& state);
+
+  /** @brief Displays the image of the frame without casting it if the state was rendered last or is cached
+  *
+  *  @return true if an image was displayed, false if the frame is to be rendered (its state being remembered)
+  */
+  bool DisplayUnchangedImage(vtkRenderer* renderer, vtkVolume* volume, float sampleDistanceFactor, cudaRenderStatistics* stats);
+
+  /** @brief Copies the image last rendered into the image cache, if it is at full quality and not held yet
+  *
+  */
+  void CacheRenderedImage();
+
+  bool RenderOnDemand;                        /**< Whether an unchanged state is displayed again rather than rendered */
+  vtkCUDAImageCache* ImageCache;              /**< The recent full quality images, by the state they were rendered in */
+  vtkCUDAImageCache::Key renderedState;       /**< The state of the image last rendered, held by the output image information handler */
+  bool renderedStateValid;                    /**< Whether renderedState is that of a complete image rendered without error */
+  bool renderedStateCacheable;                /**< Whether the image last rendered was at full quality, so worth caching */
+  /** @brief Calls ComputeMatrices, telling the changes of settings from those of the matrices, which a camera going back
+  *          to a preset view undoes
+  *
+  */
+  void UpdateMatrices();
+
+  unsigned long settingsModified;             /**< The modified time of the mapper as of its last change by anything but ComputeMatrices */
+  unsigned long matricesModified;             /**< The modified time ComputeMatrices last gave the mapper */
+
+  bool CollectStatistics;                     /**< Whether each frame is profiled stage by stage */
+  cudaRenderStatistics RenderStatistics;      /**< The profile of the last frame rendered while collecting statistics */
+
+  /** @brief Gets whether the current inputs and settings can be replicated on other devices, so the image can be split
+  *
+  */
+  virtual bool CanRenderTiles() { return true; }
+
+  /** @brief Passes the settings of the mapper to a mapper rendering a band of its image on another device
+  *
+  *  @note Called when a tile mapper is made, then before the frames rendered on several devices once the mapper was
+  *        modified (see CopyTileSettingsIfModified)
+  */
+  virtual void CopyTileSettings(vtkCUDAVolumeMapper* tileMapper);
+
+  /** @brief Passes the settings of the mapper to its tile and slab mappers, if they changed since they last were
+  *
+  *  @pre UpdateMatrices has been called for the frame
+  */
+  void CopyTileSettingsIfModified();
+
+  /** @brief Creates (or deletes) a mapper of the same class on every other device when rendering on several devices, giving it the frames of the input
+  *
+  *  @return true if the next frame is to be split among devices
+  */
+  bool UpdateTileMappers();
+
+  /** @brief Deletes the mappers of the other devices
+  *
+  */
+  void ClearTileMappers();
+
+  /** @brief Prepares the information handlers to cast the rays of a band of rows of the image
+  *
+  *  @param zBufferSource The handler of the mapper the band is rendered for, whose Z buffer is shared rather than read
+  *         back from the render window again, or 0 to read it back
+  */
+  void PrepareTile(vtkRenderer* renderer, vtkVolume* volume, int firstRow, int numberOfRows,
+                   vtkCUDARendererInformationHandler* zBufferSource = 0);
+
+  /** @brief Casts the rays of the band PrepareTile prepared, timed on the device, without displaying it
+  *
+  */
+  void CastTile(vtkRenderer* renderer, vtkVolume* volume);
+
+  /** @brief Casts the band of every device, stitches them through the host and displays the image
+  *
+  */
+  void RenderTiles(vtkRenderer* renderer, vtkVolume* volume);
+
+  bool MultiDeviceRendering;                  /**< Whether the rendering is split among every device */
+  int MultiDeviceMode;                        /**< How the rendering is split, one of the MultiDeviceModeType values */
+  vtkCUDATileScheduler* TileScheduler;        /**< The scheduler sizing the band of each device */
+  std::vector<vtkCUDAVolumeMapper*> TileMappers; /**< The mappers casting the bands of the other devices, in the order of the bands */
+  unsigned long tileSettingsModified;         /**< The time of the settings last passed to the tile or slab mappers */
+
+  /** @brief Gets whether the current inputs and settings can be split into slabs rendered on the devices
+  *
+  */
+  virtual bool CanRenderSlabs() { return true; }
+
+  /** @brief Creates (or deletes) a mapper of the same class on every device when rendering sort-last, giving each one its
+  *          slab of the frames of the input, or gives this mapper its frames back when no longer rendering sort-last
+  *
+  *  @return true if the next frame is to be rendered sort-last
+  */
+  bool UpdateSlabMappers();
+
+  /** @brief Deletes the mappers of the slabs, without giving this mapper its frames back
+  *
+  */
+  void ClearSlabMappers();
+
+  /** @brief Gives each mapper of the slabs its slab of a frame, along with a slice of its neighbours beyond the faces it shares
+  *
+  */
+  void SetSlabInputs(vtkImageData* image, int frame);
+
+  /** @brief Casts the slab of every device over the whole image, composites their images on the host front to back and displays the result
+  *
+  */
+  void RenderSlabs(vtkRenderer* renderer, vtkVolume* volume);
+
+  int CompositingMethod;                      /**< How the images of the slabs are composited, one of the CompositingMethodType values */
+  bool slabInputs;                            /**< Whether the frames are held by the mappers of the slabs rather than by this mapper */
+  std::vector<vtkCUDAVolumeMapper*> SlabMappers; /**< The mappers casting the slabs, one per device in the order of the devices */
+  std::vector<int> SlabExtents;               /**< The extent of each slab, 6 after 6, without the slices of its neighbours */
+  int SlabAxis;                               /**< The axis the volume is split along */
+  std::vector<float4> SlabCompositingBuffer;  /**< The scratch space of the binary swap compositing */
 
 private:
 
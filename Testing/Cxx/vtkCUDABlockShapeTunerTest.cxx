@@ -0,0 +1,117 @@
+/** @file vtkCUDABlockShapeTunerTest.cxx
+*
+*  @brief Test of the cache file of vtkCUDABlockShapeTuner
+*
+*  A tuner keeps the shapes in memory only unless given a cache file, and once given one writes each shape it settles on
+*  into it. Two tuners sharing the file, each tuning a key of its own after both read it, must not lose each other's
+*  shape, so a tuner created afterwards starts with both keys tuned. No CUDA device is needed.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDABlockShapeTuner.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace
+{
+
+/** @brief The cache file, in the directory the test is run from */
+const char* CacheFileName = "vtkCUDABlockShapeTunerTest.cache";
+
+//----------------------------------------------------------------------------
+// Checks that the key is tuned to the candidate
+bool CheckShape(vtkCUDABlockShapeTuner* tuner, const std::string& key, int expected, int line)
+{
+  int shape[2];
+  int candidate[2];
+  vtkCUDABlockShapeTuner::GetCandidate(expected, candidate);
+  if( tuner->GetBlockShape(key, shape) || shape[0] != candidate[0] || shape[1] != candidate[1] )
+    {
+    std::cerr << "Line " << line << " - " << key << " is not tuned to " << candidate[0] << "x" << candidate[1] << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Times every candidate for the key, the candidate given fastest being the one settled on
+bool Tune(vtkCUDABlockShapeTuner* tuner, const std::string& key, int fastest, int line)
+{
+  int shape[2];
+  for( int frame = 0; frame < 64 && tuner->GetBlockShape(key, shape); frame++ )
+    {
+    int candidate[2];
+    vtkCUDABlockShapeTuner::GetCandidate(fastest, candidate);
+    tuner->ReportTime(key, (shape[0] == candidate[0] && shape[1] == candidate[1]) ? 0.001 : 0.002);
+    }
+  return CheckShape(tuner, key, fastest, line);
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDABlockShapeTunerTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  const int volumeSize[3] = { 64, 64, 32 };
+  const std::string firstKey = vtkCUDABlockShapeTuner::MakeKey("First device", 3, 5, volumeSize);
+  const std::string secondKey = vtkCUDABlockShapeTuner::MakeKey("Second device", 8, 6, volumeSize);
+  std::remove(CacheFileName);
+
+  //no file is read or written unless one is given
+  vtkSmartPointer<vtkCUDABlockShapeTuner> inMemory = vtkSmartPointer<vtkCUDABlockShapeTuner>::New();
+  if( inMemory->GetCacheFileName() != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - the tuner defaults to the cache file " << inMemory->GetCacheFileName() << std::endl;
+    return EXIT_FAILURE;
+    }
+  if( !Tune(inMemory, firstKey, 2, __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //two tuners read the same file before either saves to it, then tune a key each
+  vtkSmartPointer<vtkCUDABlockShapeTuner> first = vtkSmartPointer<vtkCUDABlockShapeTuner>::New();
+  vtkSmartPointer<vtkCUDABlockShapeTuner> second = vtkSmartPointer<vtkCUDABlockShapeTuner>::New();
+  first->SetCacheFileName(CacheFileName);
+  second->SetCacheFileName(CacheFileName);
+  int shape[2];
+  first->GetBlockShape(firstKey, shape);
+  second->GetBlockShape(secondKey, shape);
+  if( !Tune(first, firstKey, 3, __LINE__) || !Tune(second, secondKey, 1, __LINE__) )
+    {
+    std::remove(CacheFileName);
+    return EXIT_FAILURE;
+    }
+
+  //the file holds both shapes, which a new tuner starts with
+  vtkSmartPointer<vtkCUDABlockShapeTuner> reader = vtkSmartPointer<vtkCUDABlockShapeTuner>::New();
+  reader->SetCacheFileName(CacheFileName);
+  const bool cached = CheckShape(reader, firstKey, 3, __LINE__) && CheckShape(reader, secondKey, 1, __LINE__);
+
+  //with a line per key
+  std::ifstream file(CacheFileName);
+  int lines = 0;
+  std::string line;
+  while( std::getline(file, line) ) lines++;
+  file.close();
+  std::remove(CacheFileName);
+  if( !cached )
+    {
+    return EXIT_FAILURE;
+    }
+  if( lines != 2 )
+    {
+    std::cerr << "Line " << __LINE__ << " - the cache file holds " << lines << " lines instead of 2" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,212 @@
+/** @file vtkCUDABrickManagerTest.cxx
+*
+*  @brief Test of the bookkeeping of bricked volumes: the layout of the pool and the page table kept by vtkCUDABrickManager
+*         as the rays of successive frames ask for bricks
+*
+*  A volume of eight bricks is given a pool of three slots. The bricks asked for must take the free slots first, at most the
+*  given number per frame, then the slots of the bricks sampled longest ago, never one sampled during the frame. The page
+*  table must show the origin of the slot of every held brick and zeros for the others, as the device reads it.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDABrickManager.h"
+#include "CUDA_containerBrickInformation.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+/** @brief Size of the bricks, the volume being cut into 4 x 2 x 1 of them */
+const int BrickSize = 8;
+const int NumberOfBricks = 8;
+
+/** @brief Number of slots of the pool, fewer than the bricks so they have to be evicted */
+const int NumberOfSlots = 3;
+
+//----------------------------------------------------------------------------
+// Takes the bricks of a frame, given as a list ended by -1
+int Request(vtkCUDABrickManager* manager, const int* sampled, int maximumLoads, std::vector<int>& bricks, std::vector<int>& slots)
+{
+  std::vector<unsigned char> requests(NumberOfBricks, 0);
+  for( int i = 0; sampled[i] != -1; i++ )
+    requests[sampled[i]] = 1;
+  return manager->Update(&(requests[0]), maximumLoads, bricks, slots);
+}
+
+//----------------------------------------------------------------------------
+// Checks a brick is held in a slot, the page table showing the origin of the slot, or missing with a zeroed entry
+bool CheckBrick(vtkCUDABrickManager* manager, int brick, int slot)
+{
+  const int* entry = manager->GetPageTable() + 4 * brick;
+  if( manager->GetSlot(brick) != slot )
+    {
+    std::cerr << "Line " << __LINE__ << " - brick " << brick << " is in slot " << manager->GetSlot(brick)
+              << " instead of " << slot << std::endl;
+    return false;
+    }
+  int origin[3] = { 0, 0, 0 };
+  if( slot != -1 ) manager->GetSlotOrigin(slot, origin);
+  if( entry[0] != origin[0] || entry[1] != origin[1] || entry[2] != origin[2] || entry[3] != (slot != -1 ? 1 : 0) )
+    {
+    std::cerr << "Line " << __LINE__ << " - the page table entry (" << entry[0] << ", " << entry[1] << ", " << entry[2]
+              << ", " << entry[3] << ") of brick " << brick << " does not match slot " << slot << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Checks the bricks picked for a frame and their slots
+bool CheckLoads(const std::vector<int>& bricks, const std::vector<int>& slots, int count, const int* expectedBricks,
+                const int* expectedSlots, int line)
+{
+  bool matching = (int) bricks.size() == count && (int) slots.size() == count;
+  for( int i = 0; matching && i < count; i++ )
+    matching = bricks[i] == expectedBricks[i] && slots[i] == expectedSlots[i];
+  if( !matching )
+    {
+    std::cerr << "Line " << line << " - " << bricks.size() << " bricks picked instead of " << count << ":";
+    for( size_t i = 0; i < bricks.size() && i < slots.size(); i++ )
+      std::cerr << " " << bricks[i] << " in slot " << slots[i];
+    std::cerr << std::endl;
+    }
+  return matching;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDABrickManagerTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkSmartPointer<vtkCUDABrickManager> manager = vtkSmartPointer<vtkCUDABrickManager>::New();
+
+  //a pool of more slots than there are bricks only holds the bricks, along x first
+  const int volumeSize[3] = { 4 * BrickSize, 2 * BrickSize - 3, BrickSize };
+  manager->Initialize(volumeSize, BrickSize, 2 * NumberOfBricks);
+  int gridSize[3];
+  manager->GetGridSize(gridSize);
+  if( gridSize[0] != 4 || gridSize[1] != 2 || gridSize[2] != 1 || manager->GetNumberOfBricks() != NumberOfBricks ||
+      manager->GetNumberOfSlots() != NumberOfBricks )
+    {
+    std::cerr << "Line " << __LINE__ << " - a grid of " << gridSize[0] << " x " << gridSize[1] << " x " << gridSize[2]
+              << " bricks held in " << manager->GetNumberOfSlots() << " slots" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //the pool of three slots lies along x, each slot holding a brick and its apron
+  const int slotSize = BrickSize + 2 * CUDA_BRICK_APRON;
+  manager->Initialize(volumeSize, BrickSize, NumberOfSlots);
+  int poolSize[3];
+  manager->GetPoolSize(poolSize);
+  int origin[3];
+  manager->GetSlotOrigin(2, origin);
+  if( manager->GetNumberOfSlots() != NumberOfSlots || poolSize[0] != NumberOfSlots * slotSize || poolSize[1] != slotSize ||
+      poolSize[2] != slotSize || origin[0] != 2 * slotSize || origin[1] != 0 || origin[2] != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - a pool of " << poolSize[0] << " x " << poolSize[1] << " x " << poolSize[2]
+              << " voxels, the last slot at " << origin[0] << ", " << origin[1] << ", " << origin[2] << std::endl;
+    return EXIT_FAILURE;
+    }
+  int index[3];
+  manager->GetBrickIndex(5, index);
+  if( index[0] != 1 || index[1] != 1 || index[2] != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - brick 5 is at " << index[0] << ", " << index[1] << ", " << index[2] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::vector<int> bricks;
+  std::vector<int> slots;
+  if( manager->Update(0, NumberOfSlots, bricks, slots) != 0 || !bricks.empty() )
+    {
+    std::cerr << "Line " << __LINE__ << " - bricks were picked without any request" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //at most two loads a frame, into the low free slots, the bricks left over being counted missing
+  const int frame1[] = { 0, 1, 2, 3, -1 };
+  const int loads1[] = { 0, 1 };
+  const int slots1[] = { 0, 1 };
+  if( Request(manager, frame1, 2, bricks, slots) != 2 || manager->GetNumberOfMissingBricks() != 2 ||
+      !CheckLoads(bricks, slots, 2, loads1, slots1, __LINE__) ||
+      !CheckBrick(manager, 0, 0) || !CheckBrick(manager, 1, 1) || !CheckBrick(manager, 2, -1) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //the last free slot goes first, then the first of the bricks not sampled this frame makes room
+  const int frame2[] = { 2, 3, -1 };
+  const int loads2[] = { 2, 3 };
+  const int slots2[] = { 2, 0 };
+  if( Request(manager, frame2, NumberOfBricks, bricks, slots) != 0 || !CheckLoads(bricks, slots, 2, loads2, slots2, __LINE__) ||
+      !CheckBrick(manager, 0, -1) || !CheckBrick(manager, 1, 1) || !CheckBrick(manager, 3, 0) ||
+      manager->GetNumberOfResidentBricks() != NumberOfSlots )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //sampling held bricks loads nothing, but keeps them longer than brick 3
+  const int frame3[] = { 1, 2, -1 };
+  if( Request(manager, frame3, NumberOfBricks, bricks, slots) != 0 || !bricks.empty() )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << bricks.size() << " bricks picked while all those sampled were held" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //the brick sampled longest ago is evicted first, and the brick sampled this frame is kept
+  const int frame4[] = { 1, 6, 7, -1 };
+  const int loads4[] = { 6, 7 };
+  const int slots4[] = { 0, 2 };
+  if( Request(manager, frame4, NumberOfBricks, bricks, slots) != 0 || !CheckLoads(bricks, slots, 2, loads4, slots4, __LINE__) ||
+      !CheckBrick(manager, 1, 1) || !CheckBrick(manager, 2, -1) || !CheckBrick(manager, 3, -1) ||
+      !CheckBrick(manager, 6, 0) || !CheckBrick(manager, 7, 2) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //once every held brick was sampled this frame, nothing is evicted and the brick stays missing
+  const int frame5[] = { 0, 1, 6, 7, -1 };
+  if( Request(manager, frame5, NumberOfBricks, bricks, slots) != 1 || !bricks.empty() || !CheckBrick(manager, 0, -1) ||
+      !CheckBrick(manager, 6, 0) )
+    {
+    std::cerr << "Line " << __LINE__ << " - a brick sampled this frame was evicted" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //an evicted brick, as when its load failed, gives its slot back to the next frame
+  manager->Evict(6);
+  if( !CheckBrick(manager, 6, -1) || manager->GetNumberOfResidentBricks() != NumberOfSlots - 1 )
+    {
+    return EXIT_FAILURE;
+    }
+  const int frame6[] = { 0, -1 };
+  const int loads6[] = { 0 };
+  const int slots6[] = { 0 };
+  if( Request(manager, frame6, NumberOfBricks, bricks, slots) != 0 || !CheckLoads(bricks, slots, 1, loads6, slots6, __LINE__) ||
+      !CheckBrick(manager, 0, 0) || !CheckBrick(manager, 7, 2) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  if( manager->GetNumberOfLoads() != 7 || manager->GetNumberOfEvictions() != 3 )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << manager->GetNumberOfLoads() << " loads and " << manager->GetNumberOfEvictions()
+              << " evictions counted instead of 7 and 3" << std::endl;
+    return EXIT_FAILURE;
+    }
+  manager->ResetStatistics();
+  if( manager->GetNumberOfLoads() != 0 || manager->GetNumberOfEvictions() != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - the statistics were not reset" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
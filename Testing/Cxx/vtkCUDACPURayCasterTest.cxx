@@ -0,0 +1,278 @@
+/** @file vtkCUDACPURayCasterTest.cxx
+*
+*  @brief Test of the host ray caster (CPU_vtkCUDA1DVolumeMapper_renderAlgo_doRender) against an image known in closed form
+*
+*  The volume is lit through a parallel projection along Z, and its intensity only varies along X, so each ray crosses a
+*  constant colour and opacity over a known length. The opacity of a ray is then 1 - (1 - a)^length whatever the step, and
+*  its colour the colour of its column times that opacity. The image is checked against it at the smallest spacing and at
+*  twice the spacing (where the opacity correction has to make up for the longer steps), rendered on the calling thread
+*  and on the host threads (which must agree exactly), and through the general variant (which must agree with the
+*  unshaded one, the shading constants being neutral). The host ray caster is the reference the CUDA ray caster is
+*  checked against, so it is itself checked against the closed form here.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "CPU_vtkCUDA1DVolumeMapper_renderAlgo.h"
+#include "vtkCUDAHostThreadPool.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace
+{
+
+/** @brief Number of voxels along each side of the volume */
+const int VolumeSide = 32;
+
+/** @brief Number of pixels along each side of the image */
+const int ImageSide = 64;
+
+/** @brief Number of entries in the lookup tables */
+const int FunctionSize = 256;
+
+/** @brief Opacity of a step of the smallest spacing, everywhere */
+const float Opacity = 0.02f;
+
+/** @brief Voxels the image extends beyond the volume on each side along X and Y */
+const float Margin = 4.0f;
+
+//----------------------------------------------------------------------------
+// The inputs of a frame, filled the way the information handlers fill them
+struct Frame
+{
+  cudaOutputImageInformation OutputInfo;
+  cudaRendererInformation RendererInfo;
+  cudaVolumeInformation VolumeInfo;
+  cuda1DTransferFunctionInformation TransInfo;
+  cpuRendererBuffers RendererBuffers;
+  cpu1DVolumeBuffers VolumeBuffers;
+
+  std::vector<float> Volume;
+  std::vector<float> Alpha;
+  std::vector<float> GAlpha;
+  std::vector<float> Red;
+  std::vector<float> Green;
+  std::vector<float> Blue;
+  std::vector<float> ZBuffer;
+  std::vector<float> RayOffsets;
+};
+
+//----------------------------------------------------------------------------
+void SetUpFrame(Frame& frame, float sampleDistanceFactor)
+{
+  memset( &frame.OutputInfo, 0, sizeof(frame.OutputInfo) );
+  memset( &frame.RendererInfo, 0, sizeof(frame.RendererInfo) );
+  memset( &frame.VolumeInfo, 0, sizeof(frame.VolumeInfo) );
+  memset( &frame.TransInfo, 0, sizeof(frame.TransInfo) );
+  memset( &frame.RendererBuffers, 0, sizeof(frame.RendererBuffers) );
+  memset( &frame.VolumeBuffers, 0, sizeof(frame.VolumeBuffers) );
+
+  //the intensity of voxel i along X is i / (side - 1), the same along Y and Z
+  const int side = VolumeSide;
+  frame.Volume.resize( side * side * side );
+  for( int k = 0; k < side; k++ )
+    for( int j = 0; j < side; j++ )
+      for( int i = 0; i < side; i++ )
+        frame.Volume[i + side * (j + side * k)] = (float) i / (float) (side - 1);
+
+  //lookup tables whose red and green read back the intensity itself, at a constant opacity
+  frame.Alpha.assign( FunctionSize, Opacity );
+  frame.GAlpha.assign( FunctionSize, 1.0f );
+  frame.Red.resize( FunctionSize );
+  frame.Green.resize( FunctionSize );
+  frame.Blue.assign( FunctionSize, 0.5f );
+  for( int i = 0; i < FunctionSize; i++ )
+    {
+    frame.Red[i] = ((float) i + 0.5f) / (float) FunctionSize;
+    frame.Green[i] = 1.0f - frame.Red[i];
+    }
+
+  frame.OutputInfo.resolution.x = ImageSide;
+  frame.OutputInfo.resolution.y = ImageSide;
+  frame.OutputInfo.tileSize = frame.OutputInfo.resolution;
+
+  //a parallel projection along Z, the view X running backwards
+  const float extent = (float) side + 2.0f * Margin;
+  float* m = frame.RendererInfo.ViewToVoxelsMatrix;
+  m[0] = -extent;
+  m[3] = extent - Margin;
+  m[5] = extent;
+  m[7] = -Margin;
+  m[10] = (float) side;
+  m[15] = 1.0f;
+  frame.RendererInfo.actualResolution = frame.OutputInfo.resolution;
+  frame.RendererInfo.SamplingMode = CUDA_SAMPLE_MINIMUM_SPACING;
+  frame.RendererInfo.SampleDistanceFactor = sampleDistanceFactor;
+
+  frame.VolumeInfo.VolumeSize.x = frame.VolumeInfo.VolumeSize.y = frame.VolumeInfo.VolumeSize.z = side;
+  frame.VolumeInfo.Bounds[0] = frame.VolumeInfo.Bounds[2] = frame.VolumeInfo.Bounds[4] = 0.0f;
+  frame.VolumeInfo.Bounds[1] = frame.VolumeInfo.Bounds[3] = frame.VolumeInfo.Bounds[5] = (float) (side - 1);
+  frame.VolumeInfo.Spacing.x = frame.VolumeInfo.Spacing.y = frame.VolumeInfo.Spacing.z = 1.0f;
+  frame.VolumeInfo.SpacingReciprocal = frame.VolumeInfo.Spacing;
+  frame.VolumeInfo.MinSpacing = 1.0f;
+  frame.VolumeInfo.Ambient = 1.0f;
+
+  //no gradient opacity, which the infinite multiplier tells the rays
+  frame.TransInfo.intensityLow = 0.0f;
+  frame.TransInfo.intensityMultiplier = 1.0f;
+  frame.TransInfo.gradientMultiplier = std::numeric_limits<float>::infinity();
+  frame.TransInfo.functionSize = FunctionSize;
+
+  //no opaque geometry, and no jitter so the steps land where the closed form expects them
+  frame.ZBuffer.assign( 1, 1.0f );
+  frame.RayOffsets.assign( CPU_BLOCK_DIM2D * CPU_BLOCK_DIM2D, 0.0f );
+  frame.RendererBuffers.ZBuffer = &frame.ZBuffer[0];
+  frame.RendererBuffers.ZBufferSize.x = frame.RendererBuffers.ZBufferSize.y = 1;
+  frame.RendererBuffers.RandomRayOffsets = &frame.RayOffsets[0];
+
+  frame.VolumeBuffers.Volume = &frame.Volume[0];
+  frame.VolumeBuffers.VolumeFormat = CUDA_PACKED_FLOAT;
+  frame.VolumeBuffers.AlphaTransferFunction = &frame.Alpha[0];
+  frame.VolumeBuffers.GAlphaTransferFunction = &frame.GAlpha[0];
+  frame.VolumeBuffers.ColorRTransferFunction = &frame.Red[0];
+  frame.VolumeBuffers.ColorGTransferFunction = &frame.Green[0];
+  frame.VolumeBuffers.ColorBTransferFunction = &frame.Blue[0];
+}
+
+//----------------------------------------------------------------------------
+bool Render(Frame& frame, int variant, vtkCUDAHostThreadPool* pool, std::vector<uchar4>& image)
+{
+  image.resize( ImageSide * ImageSide );
+  memset( &image[0], 0xff, image.size() * sizeof(uchar4) );
+  frame.RendererBuffers.OutputImage = &image[0];
+  return CPU_vtkCUDA1DVolumeMapper_renderAlgo_doRender(frame.OutputInfo, frame.RendererInfo, frame.VolumeInfo,
+    frame.TransInfo, frame.RendererBuffers, frame.VolumeBuffers, variant, pool, 0);
+}
+
+//----------------------------------------------------------------------------
+// Compares an image against the closed form, returning the number of pixels further than the tolerance from it
+int CompareToClosedForm(const std::vector<uchar4>& image, int tolerance, int& maximumDifference)
+{
+  //rays parallel to a face are kept over the whole volume, and clipped one voxel inside the faces they cross
+  const float low = 0.0f;
+  const float high = (float) VolumeSide - 1.0f;
+  const float length = high - low - 2.0f;
+  const float extent = (float) VolumeSide + 2.0f * Margin;
+  const float opacity = 1.0f - std::pow( 1.0f - Opacity, length );
+
+  int errors = 0;
+  maximumDifference = 0;
+  for( int y = 0; y < ImageSide; y++ )
+    {
+    const float voxelY = extent * (float) y / (float) ImageSide - Margin;
+    for( int x = 0; x < ImageSide; x++ )
+      {
+      const float voxelX = extent * (float) x / (float) ImageSide - Margin;
+
+      //the pixels whose rays graze the faces of the volume are left out, either answer being right for them
+      const bool inside = voxelX > low + 0.5f && voxelX < high - 0.5f && voxelY > low + 0.5f && voxelY < high - 0.5f;
+      const bool outside = voxelX < low - 0.5f || voxelX > high + 0.5f || voxelY < low - 0.5f || voxelY > high + 0.5f;
+      if( !inside && !outside ) continue;
+
+      //voxel i is read at i + 0.5, as a texture reads it
+      float intensity = (voxelX - 0.5f) / (float) (VolumeSide - 1);
+      intensity = intensity < 0.0f ? 0.0f : (intensity > 1.0f ? 1.0f : intensity);
+      int expected[4] = { 0, 0, 0, 0 };
+      if( inside )
+        {
+        expected[0] = (int) (255.0f * intensity * opacity);
+        expected[1] = (int) (255.0f * (1.0f - intensity) * opacity);
+        expected[2] = (int) (255.0f * 0.5f * opacity);
+        expected[3] = (int) (255.0f * opacity);
+        }
+
+      const uchar4& pixel = image[x + y * ImageSide];
+      const int actual[4] = { pixel.x, pixel.y, pixel.z, pixel.w };
+      int difference = 0;
+      for( int c = 0; c < 4; c++ )
+        {
+        int channel = std::abs( actual[c] - expected[c] );
+        difference = channel > difference ? channel : difference;
+        }
+      maximumDifference = difference > maximumDifference ? difference : maximumDifference;
+      errors += (difference > tolerance) ? 1 : 0;
+      }
+    }
+  return errors;
+}
+
+//----------------------------------------------------------------------------
+int CountDifferentPixels(const std::vector<uchar4>& a, const std::vector<uchar4>& b)
+{
+  int different = 0;
+  for( size_t i = 0; i < a.size(); i++ )
+    different += (a[i].x != b[i].x || a[i].y != b[i].y || a[i].z != b[i].z || a[i].w != b[i].w) ? 1 : 0;
+  return different;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDACPURayCasterTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkSmartPointer<vtkCUDAHostThreadPool> pool = vtkSmartPointer<vtkCUDAHostThreadPool>::New();
+
+  //at twice the spacing a ray may take one step less than the length over the step, whose opacity is a * (1 - a)^length
+  const float factors[2] = { 1.0f, 2.0f };
+  const int tolerances[2] = { 2, 4 };
+  for( int f = 0; f < 2; f++ )
+    {
+    Frame frame;
+    SetUpFrame(frame, factors[f]);
+
+    std::vector<uchar4> serial;
+    std::vector<uchar4> parallel;
+    std::vector<uchar4> general;
+    if( !Render(frame, 0, 0, serial) || !Render(frame, 0, pool, parallel) ||
+        !Render(frame, CUDA_VARIANT_GENERAL, pool, general) )
+      {
+      std::cerr << "Line " << __LINE__ << " - the ray caster refused a valid frame" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    int maximumDifference = 0;
+    int errors = CompareToClosedForm(parallel, tolerances[f], maximumDifference);
+    if( errors > 0 )
+      {
+      std::cerr << "Line " << __LINE__ << " - at " << factors[f] << " times the smallest spacing, " << errors
+                << " pixels differ from the closed form by up to " << maximumDifference << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    int different = CountDifferentPixels(serial, parallel);
+    if( different > 0 )
+      {
+      std::cerr << "Line " << __LINE__ << " - " << different << " pixels differ between the calling thread and the host threads" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    different = CountDifferentPixels(general, parallel);
+    if( different > 0 )
+      {
+      std::cerr << "Line " << __LINE__ << " - " << different << " pixels differ between the general and the unshaded variants" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  //a frame missing its lookup tables is refused rather than read
+  Frame frame;
+  SetUpFrame(frame, 1.0f);
+  frame.VolumeBuffers.AlphaTransferFunction = 0;
+  std::vector<uchar4> image;
+  if( Render(frame, 0, pool, image) )
+    {
+    std::cerr << "Line " << __LINE__ << " - the ray caster accepted a frame without an opacity lookup table" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,276 @@
+/** @file vtkCUDAConcurrentMappersTest.cxx
+*
+*  @brief Test of several vtkCUDA1DVolumeMapper rendering at once, each from a thread of its own, on the mock runtime
+*
+*  Four off-screen pipelines are built as in vtkCUDAConcurrentMappersBenchmark, each mapper rendering a volume of its
+*  own on the CPU backend. Each pipeline first renders a view on its own, giving the reference image of its mapper. The
+*  four are then rendered from four threads at once, every thread switching its camera between two views over several
+*  frames and ending on the first. Every mapper must end up with its own reference image exactly, and no image may
+*  match another mapper's reference, so a render reaching the buffers or the settings of another mapper shows up. The
+*  mock runtime must not have been called on memory, a stream or an event that does not exist, and nothing the mappers
+*  made on the device may be left once they are deleted. No CUDA device is needed.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDA1DVolumeMapper.h"
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAMockRuntime.h"
+#include "vtkCUDAOutputImageInformationHandler.h"
+
+// VTK includes
+#include <vtkCamera.h>
+#include <vtkColorTransferFunction.h>
+#include <vtkImageData.h>
+#include <vtkMultiThreader.h>
+#include <vtkObjectFactory.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkSmartPointer.h>
+#include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// Exposes the image the mapper last rendered
+class vtkCUDAConcurrentTestMapper : public vtkCUDA1DVolumeMapper
+{
+public:
+  vtkTypeMacro(vtkCUDAConcurrentTestMapper, vtkCUDA1DVolumeMapper);
+  static vtkCUDAConcurrentTestMapper* New();
+
+  bool CopyImage(std::vector<uchar4>& image)
+    {
+    const uint2 resolution = this->OutputInfoHandler->GetOutputImageInfo().resolution;
+    image.resize( (size_t) resolution.x * (size_t) resolution.y );
+    return !image.empty() && this->OutputInfoHandler->CopyLastImage( &(image[0]) );
+    }
+
+protected:
+  vtkCUDAConcurrentTestMapper() {}
+  ~vtkCUDAConcurrentTestMapper() {}
+
+private:
+  vtkCUDAConcurrentTestMapper(const vtkCUDAConcurrentTestMapper&); // Not implemented.
+  void operator=(const vtkCUDAConcurrentTestMapper&); // Not implemented.
+};
+
+vtkStandardNewMacro(vtkCUDAConcurrentTestMapper);
+
+namespace
+{
+
+/** @brief Number of mappers rendering at once, one per thread */
+const int NumberOfMappers = 4;
+
+/** @brief Size of the volumes along each axis, and of the render windows */
+const int VolumeSize = 32;
+const int WindowSize = 64;
+
+/** @brief Number of frames each thread renders at once with the others */
+const int NumberOfFrames = 8;
+
+//----------------------------------------------------------------------------
+struct Pipeline
+{
+  vtkSmartPointer<vtkImageData> Image;
+  vtkSmartPointer<vtkCUDAConcurrentTestMapper> Mapper;
+  vtkSmartPointer<vtkVolume> Volume;
+  vtkSmartPointer<vtkRenderer> Renderer;
+  vtkSmartPointer<vtkRenderWindow> Window;
+  double Views[2][9];               /**< The position, focal point and view up of the two views the camera switches between */
+  std::vector<uchar4> Reference;    /**< The image of the first view, rendered by the mapper on its own */
+};
+
+//----------------------------------------------------------------------------
+// A soft edged sphere, off centre by a different amount in each volume so no two mappers render the same image
+vtkImageData* CreateVolume(int index)
+{
+  vtkImageData* image = vtkImageData::New();
+  image->SetDimensions(VolumeSize, VolumeSize, VolumeSize);
+  image->SetSpacing(1.0, 1.0, 1.0);
+  image->SetOrigin(0.0, 0.0, 0.0);
+  image->SetScalarTypeToUnsignedShort();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+
+  unsigned short* voxels = static_cast<unsigned short*>( image->GetScalarPointer() );
+  const double scale = 2.0 / (double) (VolumeSize - 1);
+  const double shift = 0.15 * (double) index;
+  for( int k = 0; k < VolumeSize; k++ )
+    {
+    double z = k * scale - 1.0;
+    for( int j = 0; j < VolumeSize; j++ )
+      {
+      double y = j * scale - 1.0 - shift;
+      for( int i = 0; i < VolumeSize; i++, voxels++ )
+        {
+        double x = i * scale - 1.0 + shift;
+        double r = std::sqrt(x*x + y*y + z*z);
+        *voxels = (unsigned short) ( 2000.0 / (1.0 + std::exp( (r - 0.6) * 20.0 )) );
+        }
+      }
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+void SetView(Pipeline& pipeline, int view)
+{
+  vtkCamera* camera = pipeline.Renderer->GetActiveCamera();
+  camera->SetPosition( pipeline.Views[view] );
+  camera->SetFocalPoint( pipeline.Views[view] + 3 );
+  camera->SetViewUp( pipeline.Views[view] + 6 );
+  pipeline.Renderer->ResetCameraClippingRange();
+}
+
+//----------------------------------------------------------------------------
+// Switches between the two views, ending on the first
+VTK_THREAD_RETURN_TYPE RenderThread(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  std::vector<Pipeline>& pipelines = *static_cast< std::vector<Pipeline>* >(info->UserData);
+  Pipeline& pipeline = pipelines[info->ThreadID];
+  for( int f = 1; f <= NumberOfFrames; f++ )
+    {
+    SetView( pipeline, f % 2 );
+    pipeline.Window->Render();
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+bool SameImage(const std::vector<uchar4>& image, const std::vector<uchar4>& reference)
+{
+  return image.size() == reference.size() && !image.empty() &&
+         memcmp( &(image[0]), &(reference[0]), image.size() * sizeof(uchar4) ) == 0;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDAConcurrentMappersTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  //the mock runtime has to be in place before the first CUDA object takes a device, and runs no kernel
+  vtkSmartPointer<vtkCUDAMockRuntime> runtime = vtkSmartPointer<vtkCUDAMockRuntime>::New();
+  vtkCUDADeviceManager::Singleton()->SetRuntime(runtime);
+
+  vtkSmartPointer<vtkColorTransferFunction> colour = vtkSmartPointer<vtkColorTransferFunction>::New();
+  colour->AddRGBPoint(0.0, 0.0, 0.0, 0.0);
+  colour->AddRGBPoint(1000.0, 0.88, 0.60, 0.29);
+  colour->AddRGBPoint(2000.0, 1.0, 1.0, 1.0);
+  vtkSmartPointer<vtkPiecewiseFunction> opacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  opacity->AddPoint(0.0, 0.0);
+  opacity->AddPoint(500.0, 0.0);
+  opacity->AddPoint(2000.0, 0.3);
+  vtkSmartPointer<vtkVolumeProperty> property = vtkSmartPointer<vtkVolumeProperty>::New();
+  property->SetColor(colour);
+  property->SetScalarOpacity(opacity);
+  property->SetInterpolationTypeToLinear();
+
+  //every mapper renders each frame, rather than displaying the image of an unchanged view again, so they all keep working
+  std::vector<Pipeline> pipelines(NumberOfMappers);
+  for( int m = 0; m < NumberOfMappers; m++ )
+    {
+    Pipeline& pipeline = pipelines[m];
+    pipeline.Image.TakeReference( CreateVolume(m) );
+    pipeline.Mapper = vtkSmartPointer<vtkCUDAConcurrentTestMapper>::New();
+    pipeline.Mapper->SetRenderBackend(vtkCUDAVolumeMapper::CPU_BACKEND);
+    pipeline.Mapper->SetRenderOnDemand(false);
+    pipeline.Mapper->SetInput(pipeline.Image);
+    pipeline.Volume = vtkSmartPointer<vtkVolume>::New();
+    pipeline.Volume->SetMapper(pipeline.Mapper);
+    pipeline.Volume->SetProperty(property);
+    pipeline.Renderer = vtkSmartPointer<vtkRenderer>::New();
+    pipeline.Renderer->AddVolume(pipeline.Volume);
+    pipeline.Window = vtkSmartPointer<vtkRenderWindow>::New();
+    pipeline.Window->SetOffScreenRendering(1);
+    pipeline.Window->SetSize(WindowSize, WindowSize);
+    pipeline.Window->AddRenderer(pipeline.Renderer);
+    pipeline.Renderer->ResetCamera();
+
+    //the first view looks at the volume straight on, the second from the side
+    vtkCamera* camera = pipeline.Renderer->GetActiveCamera();
+    for( int view = 0; view < 2; view++ )
+      {
+      camera->GetPosition( pipeline.Views[view] );
+      camera->GetFocalPoint( pipeline.Views[view] + 3 );
+      camera->GetViewUp( pipeline.Views[view] + 6 );
+      camera->Azimuth(40.0);
+      }
+    }
+
+  //the reference images, each mapper rendering on its own
+  for( int m = 0; m < NumberOfMappers; m++ )
+    {
+    SetView( pipelines[m], 0 );
+    pipelines[m].Window->Render();
+    if( !pipelines[m].Mapper->CopyImage( pipelines[m].Reference ) )
+      {
+      std::cerr << "Line " << __LINE__ << " - mapper " << m << " rendered no image" << std::endl;
+      return EXIT_FAILURE;
+      }
+    for( int other = 0; other < m; other++ )
+      {
+      if( SameImage( pipelines[m].Reference, pipelines[other].Reference ) )
+        {
+        std::cerr << "Line " << __LINE__ << " - mappers " << other << " and " << m << " rendered the same image,"
+                  << " which would hide one rendering the volume of the other" << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+
+  //every mapper at once, each from a thread of its own
+  runtime->ResetCounters();
+  vtkSmartPointer<vtkMultiThreader> threader = vtkSmartPointer<vtkMultiThreader>::New();
+  threader->SetNumberOfThreads(NumberOfMappers);
+  threader->SetSingleMethod(RenderThread, &pipelines);
+  threader->SingleMethodExecute();
+
+  std::vector<uchar4> image;
+  for( int m = 0; m < NumberOfMappers; m++ )
+    {
+    if( !pipelines[m].Mapper->CopyImage( image ) || !SameImage( image, pipelines[m].Reference ) )
+      {
+      std::cerr << "Line " << __LINE__ << " - mapper " << m << " rendering alongside the others did not give its own image"
+                << std::endl;
+      return EXIT_FAILURE;
+      }
+    for( int other = 0; other < NumberOfMappers; other++ )
+      {
+      if( other != m && SameImage( image, pipelines[other].Reference ) )
+        {
+        std::cerr << "Line " << __LINE__ << " - mapper " << m << " gave the image of mapper " << other << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+  if( runtime->GetNumberOfInvalidCalls() != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << runtime->GetNumberOfInvalidCalls() << " device calls on memory, a stream"
+              << " or an event that does not exist" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //nothing the mappers made is left behind them
+  for( int m = 0; m < NumberOfMappers; m++ )
+    pipelines[m].Renderer->RemoveVolume(pipelines[m].Volume);
+  pipelines.clear();
+  if( runtime->GetNumberOfLiveAllocations() != 0 || runtime->GetNumberOfLiveStreams() != 0 ||
+      runtime->GetNumberOfLiveEvents() != 0 || runtime->GetNumberOfInvalidCalls() != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - the mappers left " << runtime->GetNumberOfLiveAllocations() << " allocations, "
+              << runtime->GetNumberOfLiveStreams() << " streams and " << runtime->GetNumberOfLiveEvents() << " events behind"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
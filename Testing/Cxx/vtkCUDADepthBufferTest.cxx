@@ -0,0 +1,154 @@
+/** @file vtkCUDADepthBufferTest.cxx
+*
+*  @brief Test of the reuse of the depth buffer between frames by vtkCUDARendererInformationHandler::LoadZBuffer
+*
+*  An off-screen window draws an opaque sphere, with the mock runtime in place of CUDA so no device is needed. The depth
+*  buffer must be read back on the first frame and not again while nothing changes, but read back again (and match the
+*  window's) once the camera moves, the sphere moves or the renderer is modified, without reallocating the buffer unless
+*  the viewport is resized. Without opaque props the buffer must hold the far plane and not be read back at all.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAMockRuntime.h"
+#include "vtkCUDARendererInformationHandler.h"
+
+// VTK includes
+#include <vtkActor.h>
+#include <vtkCamera.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+/** @brief Size of the render window, and the size it is resized to */
+const int WindowSize = 48;
+const int ResizedWindowSize = 56;
+
+//----------------------------------------------------------------------------
+// Draws the window again and loads its depth buffer, which must be read back or not as expected, in a buffer holding
+// the window's depth and allocated the expected number of times
+bool CheckLoad(vtkRenderWindow* window, vtkCUDARendererInformationHandler* handler, bool collected,
+               unsigned int allocations, int line)
+{
+  window->Render();
+  handler->Update();
+  handler->LoadZBuffer();
+  if( handler->GetZBufferCollected() != collected || handler->GetNumberOfZBufferAllocations() != allocations )
+    {
+    std::cerr << "Line " << line << " - the depth buffer was " << (handler->GetZBufferCollected() ? "" : "not ")
+              << "read back, allocated " << handler->GetNumberOfZBufferAllocations() << " times instead of "
+              << allocations << std::endl;
+    return false;
+    }
+
+  int* size = window->GetSize();
+  std::vector<float> depth( size[0] * size[1] );
+  window->GetZbufferData(0, 0, size[0] - 1, size[1] - 1, &depth[0]);
+  int numberOfOpaqueProps = 0;
+  handler->GetOpaquePropsMTime(numberOfOpaqueProps);
+  for( size_t i = 0; i < depth.size(); i++ )
+    {
+    const float expected = numberOfOpaqueProps ? depth[i] : 1.0f;
+    if( handler->GetZBuffer()[i] != expected )
+      {
+      std::cerr << "Line " << line << " - the depth buffer holds " << handler->GetZBuffer()[i] << " at pixel " << i
+                << " instead of " << expected << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDADepthBufferTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  //the mock runtime has to be in place before the first CUDA object takes a device
+  vtkSmartPointer<vtkCUDAMockRuntime> runtime = vtkSmartPointer<vtkCUDAMockRuntime>::New();
+  vtkCUDADeviceManager::Singleton()->SetRuntime(runtime);
+
+  vtkSmartPointer<vtkSphereSource> sphere = vtkSmartPointer<vtkSphereSource>::New();
+  vtkSmartPointer<vtkPolyDataMapper> sphereMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+  sphereMapper->SetInputConnection(sphere->GetOutputPort());
+  vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+  actor->SetMapper(sphereMapper);
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  renderer->AddActor(actor);
+  vtkSmartPointer<vtkRenderWindow> window = vtkSmartPointer<vtkRenderWindow>::New();
+  window->SetOffScreenRendering(1);
+  window->SetSize(WindowSize, WindowSize);
+  window->AddRenderer(renderer);
+  renderer->ResetCamera();
+  window->Render();
+
+  //the rays are cast on the host, so the buffer is not loaded into CUDA
+  vtkSmartPointer<vtkCUDARendererInformationHandler> handler = vtkSmartPointer<vtkCUDARendererInformationHandler>::New();
+  handler->SetHostRendering(true);
+  handler->SetRenderer(renderer);
+
+  //read back once, then kept while nothing changes
+  if( !CheckLoad(window, handler, true, 1, __LINE__) || !CheckLoad(window, handler, false, 1, __LINE__) ||
+      !CheckLoad(window, handler, false, 1, __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //moving the camera moves the sphere in the depth buffer, though neither the renderer nor the sphere is modified
+  renderer->GetActiveCamera()->Azimuth(30.0);
+  renderer->GetActiveCamera()->Dolly(1.5);
+  renderer->ResetCameraClippingRange();
+  if( !CheckLoad(window, handler, true, 1, __LINE__) || !CheckLoad(window, handler, false, 1, __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //as does moving the sphere itself, or modifying the renderer
+  actor->SetPosition(0.25, 0.0, 0.0);
+  if( !CheckLoad(window, handler, true, 1, __LINE__) || !CheckLoad(window, handler, false, 1, __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+  renderer->SetBackground(0.2, 0.2, 0.2);
+  if( !CheckLoad(window, handler, true, 1, __LINE__) || !CheckLoad(window, handler, false, 1, __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //a resized viewport needs a buffer of its own
+  window->SetSize(ResizedWindowSize, ResizedWindowSize);
+  if( !CheckLoad(window, handler, true, 2, __LINE__) || !CheckLoad(window, handler, false, 2, __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //without opaque props there is nothing to read back, whether the camera moves or not
+  actor->VisibilityOff();
+  if( !CheckLoad(window, handler, false, 2, __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+  renderer->GetActiveCamera()->Azimuth(30.0);
+  if( !CheckLoad(window, handler, false, 2, __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  if( runtime->GetNumberOfInvalidCalls() != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << runtime->GetNumberOfInvalidCalls() << " invalid device calls" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
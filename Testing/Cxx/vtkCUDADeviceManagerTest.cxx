@@ -0,0 +1,136 @@
+/** @file vtkCUDADeviceManagerTest.cxx
+*
+*  @brief Stress test of the device and stream registry of vtkCUDADeviceManager from many threads, on the mock runtime
+*
+*  As in vtkCUDADeviceManagerBenchmark, each thread stands for a mapper or information handler on a device of its own
+*  (the threads going round the devices): it gets its device and a stream, shares the stream as a replicated object
+*  would, reserves the device several times as a frame does, checking that the device made current and the one the
+*  stream is registered on are its own, and returns the stream and the device again, over and over. No thread may see an
+*  inconsistency, and once they are done every stream created must have been destroyed, the mock runtime never having
+*  been called on a device or stream that does not exist. No CUDA device is needed.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAMockRuntime.h"
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+/** @brief Number of devices the mock runtime pretends to have, fewer than the threads so the threads share them */
+const int NumberOfDevices = 3;
+
+/** @brief Number of times each thread registers its stream, and reserves its device for each registration */
+const int Rounds = 200;
+const int Reservations = 20;
+
+//----------------------------------------------------------------------------
+struct StressArguments
+{
+  int Errors[VTK_MAX_THREADS];
+};
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE StressThread(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  StressArguments& args = *static_cast<StressArguments*>(info->UserData);
+  const int thread = info->ThreadID;
+  const int device = thread % NumberOfDevices;
+  vtkCUDADeviceManager* manager = vtkCUDADeviceManager::Singleton();
+  vtkCUDARuntime* runtime = manager->GetRuntime();
+
+  int errors = 0;
+  for( int r = 0; r < Rounds; r++ )
+    {
+    if( manager->GetDevice(0, device) )
+      {
+      errors++;
+      continue;
+      }
+    cudaStream_t* stream = 0;
+    if( manager->GetStream(0, &stream, device) )
+      {
+      errors++;
+      manager->ReturnDevice(0, device);
+      continue;
+      }
+    cudaStream_t* shared = stream;
+    if( manager->GetStream(0, &shared, device) || shared != stream ) errors++;
+
+    for( int i = 0; i < Reservations; i++ )
+      {
+      int current = -1;
+      if( manager->ReserveGPU(stream) || runtime->GetDevice(&current) != cudaSuccess || current != device ) errors++;
+      if( manager->QueryDeviceForStream(stream) != device ) errors++;
+      }
+
+    if( shared == stream && manager->ReturnStream(0, shared, device) ) errors++;
+    if( manager->ReturnStream(0, stream, device) ) errors++;
+    if( manager->ReturnDevice(0, device) ) errors++;
+    }
+  args.Errors[thread] = errors;
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDADeviceManagerTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  //the mock runtime has to be in place before the devices are first counted
+  vtkSmartPointer<vtkCUDAMockRuntime> runtime = vtkSmartPointer<vtkCUDAMockRuntime>::New();
+  runtime->SetNumberOfDevices(NumberOfDevices);
+  vtkCUDADeviceManager::Singleton()->SetRuntime(runtime);
+  if( vtkCUDADeviceManager::Singleton()->GetNumberOfDevices() != NumberOfDevices )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << vtkCUDADeviceManager::Singleton()->GetNumberOfDevices()
+              << " devices counted instead of " << NumberOfDevices << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //a single thread, then as many threads as devices, then several threads on each device
+  const int threadCounts[] = { 1, NumberOfDevices, 4 * NumberOfDevices };
+  for( int t = 0; t < (int) (sizeof(threadCounts) / sizeof(threadCounts[0])); t++ )
+    {
+    const int threads = threadCounts[t];
+    StressArguments args;
+    for( int i = 0; i < VTK_MAX_THREADS; i++ )
+      args.Errors[i] = 0;
+
+    vtkSmartPointer<vtkMultiThreader> threader = vtkSmartPointer<vtkMultiThreader>::New();
+    threader->SetNumberOfThreads(threads);
+    threader->SetSingleMethod(StressThread, &args);
+    threader->SingleMethodExecute();
+
+    int errors = 0;
+    for( int i = 0; i < threads; i++ )
+      errors += args.Errors[i];
+    if( errors != 0 )
+      {
+      std::cerr << "Line " << __LINE__ << " - " << errors << " inconsistencies seen from " << threads << " threads" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    //each registration created a stream the second one shared, and every stream was destroyed with its last user
+    if( runtime->GetNumberOfStreamsCreated() != threads * Rounds || runtime->GetNumberOfLiveStreams() != 0 ||
+        runtime->GetNumberOfInvalidCalls() != 0 )
+      {
+      std::cerr << "Line " << __LINE__ << " - " << threads << " threads created " << runtime->GetNumberOfStreamsCreated()
+                << " streams instead of " << threads * Rounds << ", leaving " << runtime->GetNumberOfLiveStreams()
+                << " alive, with " << runtime->GetNumberOfInvalidCalls() << " invalid calls" << std::endl;
+      return EXIT_FAILURE;
+      }
+    runtime->ResetCounters();
+    }
+  return EXIT_SUCCESS;
+}
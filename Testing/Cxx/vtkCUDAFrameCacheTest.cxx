@@ -0,0 +1,217 @@
+/** @file vtkCUDAFrameCacheTest.cxx
+*
+*  @brief Test of the frame cache of 4D sequences: the slots and evictions of vtkCUDAFrameCache, and the prefetching of
+*         the coming frames by vtkCUDA1DVolumeMapper on its copy stream
+*
+*  The cache is filled past its capacity and must hand out the free slots first, then evict the least recently used frame
+*  that is not pinned. A mapper holding three frames of a sequence of four is then made to prefetch on the mock runtime:
+*  the frame after the current one must be loaded into the slot of the least recently used frame, through the staging ring
+*  the earlier uploads left in place (no page-locked allocation, and no host wait but the one for the ring slot it refills),
+*  and the render stream must wait on the device for that upload when the mapper changes to the frame.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDA1DVolumeMapper.h"
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAFrameCache.h"
+#include "vtkCUDAMockRuntime.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+/** @brief Size of the frames along each axis, their 8-bit voxels being kept at their native width */
+const int FrameSize = 16;
+
+/** @brief Number of frames of the sequence, and number of them the cache of the mapper holds */
+const int NumberOfFrames = 4;
+const int NumberOfSlots = 3;
+
+//----------------------------------------------------------------------------
+// Fills the cache past its capacity, checking the slots handed out and the frames evicted
+bool CheckFrameCache()
+{
+  vtkSmartPointer<vtkCUDAFrameCache> cache = vtkSmartPointer<vtkCUDAFrameCache>::New();
+  cache->SetCapacity(NumberOfSlots);
+
+  //the free slots are handed out first, the low ones first
+  int evicted = 0;
+  for( int frame = 0; frame < NumberOfSlots; frame++ )
+    {
+    if( cache->Insert(frame, 0, evicted) != frame || evicted != -1 )
+      {
+      std::cerr << "Line " << __LINE__ << " - frame " << frame << " was not given the free slot " << frame
+                << " (frame " << evicted << " evicted)" << std::endl;
+      return false;
+      }
+    }
+
+  //the least recently used frame is evicted, unless it is pinned, a lookup making a frame the most recently used
+  if( cache->Lookup(1) != 1 || cache->Lookup(NumberOfSlots) != -1 )
+    {
+    std::cerr << "Line " << __LINE__ << " - the lookups of a held and a missing frame failed" << std::endl;
+    return false;
+    }
+  int slot = cache->Insert(NumberOfSlots, 0, evicted);
+  if( evicted != 2 || slot != 2 || cache->Find(2) != -1 || cache->Find(0) != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - frame " << evicted << " in slot " << slot << " was evicted instead of frame 2,"
+              << " the least recently used frame that is not pinned" << std::endl;
+    return false;
+    }
+  if( cache->GetNumberOfHits() != 1 || cache->GetNumberOfMisses() != 1 || cache->GetNumberOfFrames() != NumberOfSlots )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << cache->GetNumberOfHits() << " hits and " << cache->GetNumberOfMisses()
+              << " misses counted for " << cache->GetNumberOfFrames() << " frames" << std::endl;
+    return false;
+    }
+
+  //a removed frame gives its slot back, and a cache holding only the pinned frame has no room
+  if( cache->Remove(1) != 1 || cache->Insert(7, 0, evicted) != 1 || evicted != -1 )
+    {
+    std::cerr << "Line " << __LINE__ << " - the slot of a removed frame was not handed out again" << std::endl;
+    return false;
+    }
+  cache->SetCapacity(1);
+  if( cache->Insert(0, 0, evicted) != 0 || cache->Insert(1, 0, evicted) != -1 || cache->Find(0) != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - the pinned frame was evicted from a cache of one slot" << std::endl;
+    return false;
+    }
+  cache->SetCapacity(CUDA_MAX_CACHED_FRAMES + 1);
+  if( cache->GetCapacity() != CUDA_MAX_CACHED_FRAMES || cache->GetNumberOfFrames() != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - a capacity of " << cache->GetCapacity() << " was kept past the slots of the device" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// A frame of 8-bit voxels, every frame covering the same range so the frames are all packed alike
+vtkImageData* CreateFrame(int index)
+{
+  vtkImageData* image = vtkImageData::New();
+  image->SetDimensions(FrameSize, FrameSize, FrameSize);
+  image->SetSpacing(1.0, 1.0, 1.0);
+  image->SetOrigin(0.0, 0.0, 0.0);
+  image->SetScalarTypeToUnsignedChar();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+
+  unsigned char* voxels = static_cast<unsigned char*>( image->GetScalarPointer() );
+  const int numberOfVoxels = FrameSize * FrameSize * FrameSize;
+  for( int i = 0; i < numberOfVoxels; i++ )
+    voxels[i] = (unsigned char) ((i * (index + 1)) % 256);
+  voxels[0] = 0;
+  voxels[numberOfVoxels - 1] = 255;
+  return image;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+// Exposes the prefetching of the mapper, which the render normally starts once the rays are cast
+class vtkCUDAFrameCacheTestMapper : public vtkCUDA1DVolumeMapper
+{
+public:
+  vtkTypeMacro(vtkCUDAFrameCacheTestMapper, vtkCUDA1DVolumeMapper);
+  static vtkCUDAFrameCacheTestMapper* New();
+
+  void Prefetch() { this->PrefetchFrames(); }
+
+protected:
+  vtkCUDAFrameCacheTestMapper() {}
+  ~vtkCUDAFrameCacheTestMapper() {}
+
+private:
+  vtkCUDAFrameCacheTestMapper(const vtkCUDAFrameCacheTestMapper&); // Not implemented.
+  void operator=(const vtkCUDAFrameCacheTestMapper&); // Not implemented.
+};
+
+vtkStandardNewMacro(vtkCUDAFrameCacheTestMapper);
+
+//----------------------------------------------------------------------------
+int vtkCUDAFrameCacheTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  if( !CheckFrameCache() )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //the mock runtime has to be in place before the first CUDA object takes a device
+  vtkSmartPointer<vtkCUDAMockRuntime> runtime = vtkSmartPointer<vtkCUDAMockRuntime>::New();
+  vtkCUDADeviceManager::Singleton()->SetRuntime(runtime);
+
+  //a budget of three frames, which the first three fill as they are set
+  const size_t frameBytes = FrameSize * FrameSize * FrameSize;
+  vtkSmartPointer<vtkCUDAFrameCacheTestMapper> mapper = vtkSmartPointer<vtkCUDAFrameCacheTestMapper>::New();
+  mapper->SetRenderBackend(vtkCUDAVolumeMapper::CUDA_BACKEND);
+  mapper->SetFrameCacheBudget( (double) (NumberOfSlots * frameBytes) / 1048576.0 );
+  mapper->SetNumberOfPrefetchedFrames(2);
+  for( int frame = 0; frame < NumberOfFrames; frame++ )
+    {
+    vtkImageData* image = CreateFrame(frame);
+    mapper->SetInput(image, frame);
+    image->Delete();
+    }
+  vtkCUDAFrameCache* cache = mapper->GetFrameCache();
+  if( cache->GetCapacity() != NumberOfSlots || cache->Find(0) == -1 || cache->Find(2) == -1 || cache->Find(3) != -1 )
+    {
+    std::cerr << "Line " << __LINE__ << " - the cache of " << cache->GetCapacity() << " slots does not hold the first "
+              << NumberOfSlots << " frames" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //rendering the second frame, the two after it are prefetched, the third being held already and the fourth taking the
+  //slot of the first, through the staging ring of the earlier uploads and without the host waiting for the copy
+  mapper->ChangeFrame(1);
+  runtime->ResetCounters();
+  mapper->Prefetch();
+  if( cache->Find(3) == -1 || cache->Find(0) != -1 || cache->Find(1) == -1 )
+    {
+    std::cerr << "Line " << __LINE__ << " - the fourth frame was not prefetched in place of the first" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if( runtime->GetBytesCopiedToDevice() != frameBytes || runtime->GetNumberOfHostAllocations() != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - the prefetch copied " << runtime->GetBytesCopiedToDevice() << " bytes instead of "
+              << frameBytes << " and made " << runtime->GetNumberOfHostAllocations() << " page-locked allocations" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if( runtime->GetNumberOfSynchronizations() > 1 || runtime->GetNumberOfEventWaits() != 0 ||
+      runtime->GetNumberOfEventsCreated() != 1 )
+    {
+    std::cerr << "Line " << __LINE__ << " - the prefetch waited " << runtime->GetNumberOfSynchronizations() << " times on the host"
+              << " and " << runtime->GetNumberOfEventWaits() << " times on the device, creating "
+              << runtime->GetNumberOfEventsCreated() << " events, instead of once at most for its ring slot, never and once"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //changing to the prefetched frame finds it in its slot, and the render stream waits for its upload on the device
+  const int hits = cache->GetNumberOfHits();
+  mapper->ChangeFrame(3);
+  if( cache->GetNumberOfHits() != hits + 1 || runtime->GetNumberOfEventWaits() < 1 )
+    {
+    std::cerr << "Line " << __LINE__ << " - the prefetched frame was loaded again, or rendered without waiting for its upload"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  if( runtime->GetNumberOfInvalidCalls() != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << runtime->GetNumberOfInvalidCalls() << " invalid device calls" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
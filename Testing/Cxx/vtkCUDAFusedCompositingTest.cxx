@@ -0,0 +1,275 @@
+/** @file vtkCUDAFusedCompositingTest.cxx
+*
+*  @brief Test of the volumes fused with the input of vtkCUDA1DVolumeMapper (AddFusedInput), composited in a single ray pass
+*
+*  An off-screen pipeline is rendered on the CPU backend, with the mock runtime in place of CUDA so no device is needed.
+*  Two co-registered volumes each fill one half of a box along z, the front half in one colour and the back half in
+*  another, both opaque. Fused in one pass they must interleave in depth: seen from either end, only the half nearer the
+*  camera may show. As the volumes are merged independently of their order, swapping the rendered volume and the fused
+*  one must cast the same image. A fused volume that is transparent throughout must leave the image of the input alone
+*  as it was.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDA1DVolumeMapper.h"
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAMockRuntime.h"
+#include "vtkCUDAOutputImageInformationHandler.h"
+
+// VTK includes
+#include <vtkCamera.h>
+#include <vtkColorTransferFunction.h>
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkSmartPointer.h>
+#include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// Exposes the image last rendered
+class vtkCUDAFusedCompositingTestMapper : public vtkCUDA1DVolumeMapper
+{
+public:
+  vtkTypeMacro(vtkCUDAFusedCompositingTestMapper, vtkCUDA1DVolumeMapper);
+  static vtkCUDAFusedCompositingTestMapper* New();
+
+  bool CopyImage(std::vector<uchar4>& image)
+    {
+    const uint2 resolution = this->OutputInfoHandler->GetOutputImageInfo().resolution;
+    image.resize( (size_t) resolution.x * (size_t) resolution.y );
+    return !image.empty() && this->OutputInfoHandler->CopyLastImage( &(image[0]) );
+    }
+
+protected:
+  vtkCUDAFusedCompositingTestMapper() {}
+  ~vtkCUDAFusedCompositingTestMapper() {}
+
+private:
+  vtkCUDAFusedCompositingTestMapper(const vtkCUDAFusedCompositingTestMapper&); // Not implemented.
+  void operator=(const vtkCUDAFusedCompositingTestMapper&); // Not implemented.
+};
+
+vtkStandardNewMacro(vtkCUDAFusedCompositingTestMapper);
+
+namespace
+{
+
+/** @brief Size of the volumes along each axis, and of the render window */
+const int VolumeSize = 32;
+const int WindowSize = 48;
+
+/** @brief Largest difference allowed in any channel between images that differ only by the rounding of the merge */
+const int MaximumDifference = 2;
+
+/** @brief Opacity of the pixels that are checked for the colour of the half in front */
+const int OpaquePixel = 128;
+
+//----------------------------------------------------------------------------
+// A box through the middle of the volume in x and y, filled in the front or back half of the volume along z
+vtkImageData* CreateHalfBox(bool front)
+{
+  vtkImageData* image = vtkImageData::New();
+  image->SetDimensions(VolumeSize, VolumeSize, VolumeSize);
+  image->SetSpacing(1.0, 1.0, 1.0);
+  image->SetOrigin(0.0, 0.0, 0.0);
+  image->SetScalarTypeToUnsignedShort();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+
+  unsigned short* voxels = static_cast<unsigned short*>( image->GetScalarPointer() );
+  for( int k = 0; k < VolumeSize; k++ )
+    for( int j = 0; j < VolumeSize; j++ )
+      for( int i = 0; i < VolumeSize; i++, voxels++ )
+        {
+        const bool inBox = i >= VolumeSize / 4 && i < 3 * VolumeSize / 4 && j >= VolumeSize / 4 && j < 3 * VolumeSize / 4;
+        const bool inHalf = front ? (k >= VolumeSize / 2) : (k < VolumeSize / 2);
+        *voxels = (inBox && inHalf) ? 1000 : 0;
+        }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+// An opaque, unshaded property of a single colour
+vtkVolumeProperty* CreateProperty(double red, double green, double blue, double opacity)
+{
+  vtkSmartPointer<vtkColorTransferFunction> colour = vtkSmartPointer<vtkColorTransferFunction>::New();
+  colour->AddRGBPoint(0.0, red, green, blue);
+  colour->AddRGBPoint(1000.0, red, green, blue);
+  vtkSmartPointer<vtkPiecewiseFunction> scalarOpacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  scalarOpacity->AddPoint(0.0, 0.0);
+  scalarOpacity->AddPoint(500.0, 0.0);
+  scalarOpacity->AddPoint(1000.0, opacity);
+  vtkVolumeProperty* property = vtkVolumeProperty::New();
+  property->SetColor(colour);
+  property->SetScalarOpacity(scalarOpacity);
+  property->SetInterpolationTypeToLinear();
+  property->SetShade(0);
+  return property;
+}
+
+//----------------------------------------------------------------------------
+// Renders the window and copies the image cast
+bool Render(vtkRenderWindow* window, vtkCUDAFusedCompositingTestMapper* mapper, int fusedInputs, std::vector<uchar4>& image,
+            int line)
+{
+  window->Render();
+  if( mapper->GetNumberOfFusedInputs() != fusedInputs || !mapper->CopyImage(image) )
+    {
+    std::cerr << "Line " << line << " - no image was cast with " << fusedInputs << " fused volumes" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Checks that the opaque pixels of the image all have the colour of the half in front, green or red
+bool CheckFront(const std::vector<uchar4>& image, bool greenInFront, const char* view, int line)
+{
+  int opaque = 0;
+  int wrong = 0;
+  for( size_t p = 0; p < image.size(); p++ )
+    {
+    if( image[p].w < OpaquePixel ) continue;
+    opaque++;
+    wrong += (greenInFront ? image[p].y <= image[p].x : image[p].x <= image[p].y) ? 1 : 0;
+    }
+  if( opaque == 0 || wrong != 0 )
+    {
+    std::cerr << "Line " << line << " - " << wrong << " of the " << opaque << " opaque pixels seen from the " << view
+              << " show the half behind" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Checks that two images differ by no more than the rounding of the merge, and are not empty
+bool CheckSame(const std::vector<uchar4>& first, const std::vector<uchar4>& second, const char* what, int line)
+{
+  if( first.size() != second.size() )
+    {
+    std::cerr << "Line " << line << " - the images " << what << " differ in size" << std::endl;
+    return false;
+    }
+  int differentPixels = 0;
+  bool visible = false;
+  for( size_t p = 0; p < first.size(); p++ )
+    {
+    const int difference[4] = { first[p].x - second[p].x, first[p].y - second[p].y, first[p].z - second[p].z,
+                                first[p].w - second[p].w };
+    bool different = false;
+    for( int c = 0; c < 4; c++ )
+      different = different || difference[c] > MaximumDifference || difference[c] < -MaximumDifference;
+    differentPixels += different ? 1 : 0;
+    visible = visible || first[p].w != 0;
+    }
+  if( differentPixels != 0 || !visible )
+    {
+    std::cerr << "Line " << line << " - " << differentPixels << " pixels of the images " << what << " differ"
+              << (visible ? "" : ", which are empty") << std::endl;
+    return false;
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDAFusedCompositingTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  //the mock runtime has to be in place before the first CUDA object takes a device
+  vtkSmartPointer<vtkCUDAMockRuntime> runtime = vtkSmartPointer<vtkCUDAMockRuntime>::New();
+  vtkCUDADeviceManager::Singleton()->SetRuntime(runtime);
+
+  vtkSmartPointer<vtkImageData> frontHalf;
+  frontHalf.TakeReference( CreateHalfBox(true) );
+  vtkSmartPointer<vtkImageData> backHalf;
+  backHalf.TakeReference( CreateHalfBox(false) );
+  vtkSmartPointer<vtkVolumeProperty> green;
+  green.TakeReference( CreateProperty(0.0, 1.0, 0.0, 1.0) );
+  vtkSmartPointer<vtkVolumeProperty> red;
+  red.TakeReference( CreateProperty(1.0, 0.0, 0.0, 1.0) );
+  vtkSmartPointer<vtkVolumeProperty> transparent;
+  transparent.TakeReference( CreateProperty(0.0, 0.0, 1.0, 0.0) );
+
+  vtkSmartPointer<vtkCUDAFusedCompositingTestMapper> mapper = vtkSmartPointer<vtkCUDAFusedCompositingTestMapper>::New();
+  mapper->SetRenderBackend(vtkCUDAVolumeMapper::CPU_BACKEND);
+  mapper->SetRenderOnDemand(false);
+  mapper->SetInput(frontHalf);
+  vtkSmartPointer<vtkVolume> volume = vtkSmartPointer<vtkVolume>::New();
+  volume->SetMapper(mapper);
+  volume->SetProperty(green);
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  renderer->AddVolume(volume);
+  vtkSmartPointer<vtkRenderWindow> window = vtkSmartPointer<vtkRenderWindow>::New();
+  window->SetOffScreenRendering(1);
+  window->SetSize(WindowSize, WindowSize);
+  window->AddRenderer(renderer);
+  renderer->ResetCamera();
+  vtkCamera* camera = renderer->GetActiveCamera();
+
+  //a transparent fused volume adds nothing to the image of the input alone
+  std::vector<uchar4> alone;
+  std::vector<uchar4> withTransparent;
+  if( !Render(window, mapper, 0, alone, __LINE__) ||
+      mapper->AddFusedInput(backHalf, transparent) != 0 ||
+      !Render(window, mapper, 1, withTransparent, __LINE__) ||
+      !CheckSame(alone, withTransparent, "with and without a transparent fused volume", __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //the two halves interleave in depth, the one nearer the camera hiding the other from either end
+  std::vector<uchar4> fromFront;
+  std::vector<uchar4> fromBack;
+  mapper->RemoveAllFusedInputs();
+  if( mapper->AddFusedInput(backHalf, red) != 0 ||
+      !Render(window, mapper, 1, fromFront, __LINE__) || !CheckFront(fromFront, true, "front", __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+  camera->Azimuth(180.0);
+  renderer->ResetCameraClippingRange();
+  if( !Render(window, mapper, 1, fromBack, __LINE__) || !CheckFront(fromBack, false, "back", __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //rendering the back half with the front half fused casts the same images
+  std::vector<uchar4> swappedFromBack;
+  std::vector<uchar4> swappedFromFront;
+  mapper->RemoveAllFusedInputs();
+  mapper->SetInput(backHalf);
+  volume->SetProperty(red);
+  if( mapper->AddFusedInput(frontHalf, green) != 0 ||
+      !Render(window, mapper, 1, swappedFromBack, __LINE__) ||
+      !CheckSame(fromBack, swappedFromBack, "seen from the back with the volumes swapped", __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+  camera->Azimuth(180.0);
+  renderer->ResetCameraClippingRange();
+  if( !Render(window, mapper, 1, swappedFromFront, __LINE__) ||
+      !CheckSame(fromFront, swappedFromFront, "seen from the front with the volumes swapped", __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+  mapper->RemoveAllFusedInputs();
+  renderer->RemoveVolume(volume);
+
+  if( runtime->GetNumberOfInvalidCalls() != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << runtime->GetNumberOfInvalidCalls() << " invalid device calls" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
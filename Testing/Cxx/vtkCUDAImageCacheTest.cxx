@@ -0,0 +1,352 @@
+/** @file vtkCUDAImageCacheTest.cxx
+*
+*  @brief Test of render-on-demand: the state keys and least recently used order of vtkCUDAImageCache, and the keys
+*         vtkCUDAVolumeMapper::ComputeRenderState gives the frames it renders
+*
+*  A key must only match an equal one, whatever field differs, and a full cache must evict the image used longest ago,
+*  a lookup making an image the most recently used. An off-screen pipeline is then rendered on the CPU backend, with the
+*  mock runtime in place of CUDA so no device is needed: the key of an unchanged frame must stay the same, a camera
+*  brought back to a view must give the key of that view again, and moving the camera, editing the transfer function,
+*  modifying the data, moving a clipping plane, changing a setting of the mapper or resizing the viewport must each
+*  change the key, only in the field tracking it.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDA1DVolumeMapper.h"
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAImageCache.h"
+#include "vtkCUDAMockRuntime.h"
+
+// VTK includes
+#include <vtkCamera.h>
+#include <vtkColorTransferFunction.h>
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkPlane.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkSmartPointer.h>
+#include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
+
+// STD includes
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// Exposes the key of the frame last rendered
+class vtkCUDAImageCacheTestMapper : public vtkCUDA1DVolumeMapper
+{
+public:
+  vtkTypeMacro(vtkCUDAImageCacheTestMapper, vtkCUDA1DVolumeMapper);
+  static vtkCUDAImageCacheTestMapper* New();
+
+  void GetRenderState(vtkRenderer* renderer, vtkVolume* volume, vtkCUDAImageCache::Key& state)
+    {
+    this->ComputeRenderState(renderer, volume, 1.0f, state);
+    }
+
+protected:
+  vtkCUDAImageCacheTestMapper() {}
+  ~vtkCUDAImageCacheTestMapper() {}
+
+private:
+  vtkCUDAImageCacheTestMapper(const vtkCUDAImageCacheTestMapper&); // Not implemented.
+  void operator=(const vtkCUDAImageCacheTestMapper&); // Not implemented.
+};
+
+vtkStandardNewMacro(vtkCUDAImageCacheTestMapper);
+
+namespace
+{
+
+/** @brief Size of the volume along each axis, and of the render window */
+const int VolumeSize = 16;
+const int WindowSize = 48;
+
+//----------------------------------------------------------------------------
+vtkCUDAImageCache::Key MakeKey(int view)
+{
+  vtkCUDAImageCache::Key key;
+  memset( &key, 0, sizeof(key) );
+  key.Resolution[0] = key.Resolution[1] = 4;
+  for( int i = 0; i < 16; i++ )
+    key.ViewToVoxels[i] = (i % 5 == 0) ? 1.0 : 0.0;
+  key.ViewToVoxels[3] = (double) view;
+  key.SampleDistanceFactor = 1.0f;
+  return key;
+}
+
+//----------------------------------------------------------------------------
+// Checks a key only matches one equal in every field
+bool CheckKeys()
+{
+  const vtkCUDAImageCache::Key key = MakeKey(0);
+  std::vector<vtkCUDAImageCache::Key> changed(12, key);
+  changed[0].Volume = &changed;
+  changed[1].Renderer = &changed;
+  changed[2].ViewToVoxels[15] = 2.0;
+  changed[3].Resolution[0] = 5;
+  changed[4].Resolution[1] = 5;
+  changed[5].SampleDistanceFactor = 4.0f;
+  changed[6].SettingsMTime = 1;
+  changed[7].PropertyMTime = 1;
+  changed[8].DataMTime = 1;
+  changed[9].ClippingMTime = 1;
+  changed[10].GeometryMTime = 1;
+  changed[11].NumberOfOpaqueProps = 1;
+  if( !(key == MakeKey(0)) || key != MakeKey(0) )
+    {
+    std::cerr << "Line " << __LINE__ << " - equal keys do not match" << std::endl;
+    return false;
+    }
+  for( size_t c = 0; c < changed.size(); c++ )
+    {
+    if( key == changed[c] || !(key != changed[c]) )
+      {
+      std::cerr << "Line " << __LINE__ << " - keys differing in field " << c << " match" << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Checks the least recently used image makes room, a lookup making an image the most recently used
+bool CheckEviction()
+{
+  vtkSmartPointer<vtkCUDAImageCache> cache = vtkSmartPointer<vtkCUDAImageCache>::New();
+  cache->SetCapacity(3);
+  for( int view = 0; view < 3; view++ )
+    {
+    uchar4* image = cache->Insert( MakeKey(view) );
+    if( !image )
+      {
+      std::cerr << "Line " << __LINE__ << " - no room for image " << view << " of 3" << std::endl;
+      return false;
+      }
+    for( int p = 0; p < 16; p++ )
+      image[p].x = image[p].y = image[p].z = image[p].w = (unsigned char) view;
+    }
+  const uchar4* found = cache->Lookup( MakeKey(0) );
+  if( !found || found[15].x != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - the first image inserted was not found" << std::endl;
+    return false;
+    }
+
+  //image 1 is now the least recently used, image 0 having been looked up since
+  cache->Insert( MakeKey(3) );
+  if( !cache->Find( MakeKey(0) ) || cache->Find( MakeKey(1) ) || !cache->Find( MakeKey(2) ) ||
+      cache->Find( MakeKey(2) )[0].x != 2 || !cache->Find( MakeKey(3) ) || cache->GetNumberOfImages() != 3 )
+    {
+    std::cerr << "Line " << __LINE__ << " - a full cache did not evict the image used longest ago" << std::endl;
+    return false;
+    }
+
+  //misses are counted, forgotten images are gone and an empty cache holds nothing
+  if( cache->Lookup( MakeKey(1) ) || cache->GetNumberOfHits() != 1 || cache->GetNumberOfMisses() != 1 )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << cache->GetNumberOfHits() << " hits and " << cache->GetNumberOfMisses()
+              << " misses counted instead of 1 and 1" << std::endl;
+    return false;
+    }
+  cache->Remove( MakeKey(0) );
+  if( cache->Find( MakeKey(0) ) || cache->GetNumberOfImages() != 2 )
+    {
+    std::cerr << "Line " << __LINE__ << " - a removed image is still held" << std::endl;
+    return false;
+    }
+  cache->SetCapacity(0);
+  if( cache->GetNumberOfImages() != 0 || cache->Insert( MakeKey(0) ) )
+    {
+    std::cerr << "Line " << __LINE__ << " - a cache without capacity holds an image" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+vtkImageData* CreateVolume()
+{
+  vtkImageData* image = vtkImageData::New();
+  image->SetDimensions(VolumeSize, VolumeSize, VolumeSize);
+  image->SetSpacing(1.0, 1.0, 1.0);
+  image->SetOrigin(0.0, 0.0, 0.0);
+  image->SetScalarTypeToUnsignedShort();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+  unsigned short* voxels = static_cast<unsigned short*>( image->GetScalarPointer() );
+  for( int i = 0; i < VolumeSize * VolumeSize * VolumeSize; i++ )
+    voxels[i] = (unsigned short) (i % 2000);
+  return image;
+}
+
+//----------------------------------------------------------------------------
+// Checks two keys of the pipeline differ in a field, and optionally match in the settings tracked apart from it
+bool CheckChanged(const vtkCUDAImageCache::Key& before, const vtkCUDAImageCache::Key& after, bool fieldChanged,
+                  bool sameSettings, const char* change, int line)
+{
+  if( before == after || !fieldChanged )
+    {
+    std::cerr << "Line " << line << " - " << change << " did not change the key of the frame" << std::endl;
+    return false;
+    }
+  if( sameSettings && before.SettingsMTime != after.SettingsMTime )
+    {
+    std::cerr << "Line " << line << " - " << change << " was taken for a change of the settings of the mapper" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Renders a pipeline through changes of each part of its state, checking the keys of the frames
+bool CheckRenderStates()
+{
+  vtkSmartPointer<vtkColorTransferFunction> colour = vtkSmartPointer<vtkColorTransferFunction>::New();
+  colour->AddRGBPoint(0.0, 0.0, 0.0, 0.0);
+  colour->AddRGBPoint(2000.0, 1.0, 1.0, 1.0);
+  vtkSmartPointer<vtkPiecewiseFunction> opacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  opacity->AddPoint(0.0, 0.0);
+  opacity->AddPoint(2000.0, 0.3);
+  vtkSmartPointer<vtkVolumeProperty> property = vtkSmartPointer<vtkVolumeProperty>::New();
+  property->SetColor(colour);
+  property->SetScalarOpacity(opacity);
+
+  vtkSmartPointer<vtkImageData> image;
+  image.TakeReference( CreateVolume() );
+  vtkSmartPointer<vtkCUDAImageCacheTestMapper> mapper = vtkSmartPointer<vtkCUDAImageCacheTestMapper>::New();
+  mapper->SetRenderBackend(vtkCUDAVolumeMapper::CPU_BACKEND);
+  mapper->SetInput(image);
+  vtkSmartPointer<vtkVolume> volume = vtkSmartPointer<vtkVolume>::New();
+  volume->SetMapper(mapper);
+  volume->SetProperty(property);
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  renderer->AddVolume(volume);
+  vtkSmartPointer<vtkRenderWindow> window = vtkSmartPointer<vtkRenderWindow>::New();
+  window->SetOffScreenRendering(1);
+  window->SetSize(WindowSize, WindowSize);
+  window->AddRenderer(renderer);
+  renderer->ResetCamera();
+  vtkSmartPointer<vtkCamera> view = vtkSmartPointer<vtkCamera>::New();
+  view->DeepCopy( renderer->GetActiveCamera() );
+
+  //an unchanged frame, as an overlay redraws, keeps its key
+  vtkCUDAImageCache::Key first;
+  vtkCUDAImageCache::Key state;
+  window->Render();
+  mapper->GetRenderState(renderer, volume, first);
+  window->Render();
+  mapper->GetRenderState(renderer, volume, state);
+  if( first != state || first.Volume != volume.GetPointer() || first.Renderer != renderer.GetPointer() )
+    {
+    std::cerr << "Line " << __LINE__ << " - the key of an unchanged frame changed" << std::endl;
+    return false;
+    }
+
+  //moving the camera only changes the matrix, and bringing it back to the view finds the key of the view again
+  renderer->GetActiveCamera()->Azimuth(40.0);
+  renderer->ResetCameraClippingRange();
+  window->Render();
+  mapper->GetRenderState(renderer, volume, state);
+  if( !CheckChanged(first, state, memcmp(first.ViewToVoxels, state.ViewToVoxels, sizeof(first.ViewToVoxels)) != 0, true,
+                    "moving the camera", __LINE__) )
+    {
+    return false;
+    }
+  renderer->GetActiveCamera()->DeepCopy( view );
+  window->Render();
+  mapper->GetRenderState(renderer, volume, state);
+  if( state != first )
+    {
+    std::cerr << "Line " << __LINE__ << " - the camera brought back to the view did not give the key of the view" << std::endl;
+    return false;
+    }
+
+  //the transfer functions, the data, the clipping planes, the mapper and the viewport are each tracked
+  vtkCUDAImageCache::Key before = state;
+  opacity->AddPoint(1000.0, 0.1);
+  window->Render();
+  mapper->GetRenderState(renderer, volume, state);
+  if( !CheckChanged(before, state, state.PropertyMTime > before.PropertyMTime, true, "editing the transfer function", __LINE__) )
+    {
+    return false;
+    }
+
+  before = state;
+  image->Modified();
+  window->Render();
+  mapper->GetRenderState(renderer, volume, state);
+  if( !CheckChanged(before, state, state.DataMTime > before.DataMTime, true, "modifying the data", __LINE__) )
+    {
+    return false;
+    }
+
+  vtkSmartPointer<vtkPlane> plane = vtkSmartPointer<vtkPlane>::New();
+  plane->SetOrigin(0.0, 0.0, 0.5 * VolumeSize);
+  plane->SetNormal(0.0, 0.0, 1.0);
+  mapper->AddClippingPlane(plane);
+  window->Render();
+  mapper->GetRenderState(renderer, volume, state);
+  before = state;
+  plane->SetOrigin(0.0, 0.0, 0.25 * VolumeSize);
+  window->Render();
+  mapper->GetRenderState(renderer, volume, state);
+  if( !CheckChanged(before, state, state.ClippingMTime > before.ClippingMTime, true, "moving a clipping plane", __LINE__) )
+    {
+    return false;
+    }
+
+  before = state;
+  mapper->Modified();
+  window->Render();
+  mapper->GetRenderState(renderer, volume, state);
+  if( !CheckChanged(before, state, state.SettingsMTime > before.SettingsMTime, false, "modifying the mapper", __LINE__) )
+    {
+    return false;
+    }
+
+  before = state;
+  window->SetSize(WindowSize / 2, WindowSize);
+  window->Render();
+  mapper->GetRenderState(renderer, volume, state);
+  if( !CheckChanged(before, state, state.Resolution[0] < before.Resolution[0] && state.Resolution[1] == before.Resolution[1],
+                    false, "resizing the viewport", __LINE__) )
+    {
+    return false;
+    }
+
+  renderer->RemoveVolume(volume);
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDAImageCacheTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  if( !CheckKeys() || !CheckEviction() )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //the mock runtime has to be in place before the first CUDA object takes a device, and runs no kernel
+  vtkSmartPointer<vtkCUDAMockRuntime> runtime = vtkSmartPointer<vtkCUDAMockRuntime>::New();
+  vtkCUDADeviceManager::Singleton()->SetRuntime(runtime);
+  if( !CheckRenderStates() )
+    {
+    return EXIT_FAILURE;
+    }
+  if( runtime->GetNumberOfInvalidCalls() != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << runtime->GetNumberOfInvalidCalls() << " device calls on memory, a stream"
+              << " or an event that does not exist" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,277 @@
+/** @file vtkCUDAKernelVariantsTest.cxx
+*
+*  @brief Test of the ray casters of vtkCUDA1DVolumeMapper specialized for the features of a frame
+*         (vtkCUDA1DVolumeMapper::ChooseKernelVariant) against the general one
+*
+*  An off-screen pipeline is rendered on the CPU backend, with the mock runtime in place of CUDA so no device is needed,
+*  in a number of scenes each using a different set of features (unshaded, shaded, with a gradient opacity function, with
+*  a clipping plane, through a parallel projection, and everything at once), from a few views: once with the general
+*  variant (CUDA_VARIANT_GENERAL) and once with the variant specialized for the scene. The specialized variant has to be
+*  the one the scene asks for, and has to cast exactly the image the general one does.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "CUDA_containerKernelVariant.h"
+#include "vtkCUDA1DVolumeMapper.h"
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAMockRuntime.h"
+#include "vtkCUDAOutputImageInformationHandler.h"
+
+// VTK includes
+#include <vtkCamera.h>
+#include <vtkColorTransferFunction.h>
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkPlane.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkSmartPointer.h>
+#include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// Exposes the image last rendered
+class vtkCUDAKernelVariantsTestMapper : public vtkCUDA1DVolumeMapper
+{
+public:
+  vtkTypeMacro(vtkCUDAKernelVariantsTestMapper, vtkCUDA1DVolumeMapper);
+  static vtkCUDAKernelVariantsTestMapper* New();
+
+  bool CopyImage(std::vector<uchar4>& image)
+    {
+    const uint2 resolution = this->OutputInfoHandler->GetOutputImageInfo().resolution;
+    image.resize( (size_t) resolution.x * (size_t) resolution.y );
+    return !image.empty() && this->OutputInfoHandler->CopyLastImage( &(image[0]) );
+    }
+
+protected:
+  vtkCUDAKernelVariantsTestMapper() {}
+  ~vtkCUDAKernelVariantsTestMapper() {}
+
+private:
+  vtkCUDAKernelVariantsTestMapper(const vtkCUDAKernelVariantsTestMapper&); // Not implemented.
+  void operator=(const vtkCUDAKernelVariantsTestMapper&); // Not implemented.
+};
+
+vtkStandardNewMacro(vtkCUDAKernelVariantsTestMapper);
+
+namespace
+{
+
+/** @brief Size of the volume along each axis, and of the render window */
+const int VolumeSize = 32;
+const int WindowSize = 48;
+
+/** @brief Number of views each scene is rendered from, going round the volume */
+const int NumberOfViews = 3;
+
+//----------------------------------------------------------------------------
+// A set of features to render with, and the variant it has to be rendered with
+struct Scene
+{
+  const char* Name;
+  bool Shaded;
+  bool GradientOpacity;
+  bool Clipped;
+  bool Parallel;
+  int Variant;
+};
+
+//----------------------------------------------------------------------------
+vtkImageData* CreateVolume(int size)
+{
+  vtkImageData* image = vtkImageData::New();
+  image->SetDimensions(size, size, size);
+  image->SetSpacing(1.0, 1.0, 1.0);
+  image->SetOrigin(0.0, 0.0, 0.0);
+  image->SetScalarTypeToUnsignedShort();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+
+  //a soft edged ellipsoid with a denser core, so there are both flat regions and edges to shade
+  unsigned short* voxels = static_cast<unsigned short*>( image->GetScalarPointer() );
+  const double scale = 2.0 / (double) (size - 1);
+  for( int k = 0; k < size; k++ )
+    {
+    double z = k * scale - 1.0;
+    for( int j = 0; j < size; j++ )
+      {
+      double y = j * scale - 1.0;
+      for( int i = 0; i < size; i++, voxels++ )
+        {
+        double x = i * scale - 1.0;
+        double r = std::sqrt(x*x + 4.0*y*y + 2.0*z*z);
+        double core = std::sqrt(4.0*x*x + y*y + z*z);
+        *voxels = (unsigned short) ( 1200.0 / (1.0 + std::exp( (r - 0.7) * 40.0 )) +
+                                     800.0 / (1.0 + std::exp( (core - 0.4) * 20.0 )) );
+        }
+      }
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+// Renders the views of a scene, which must use the expected variant, keeping the image of each
+bool RenderViews(vtkRenderer* renderer, vtkRenderWindow* window, vtkCUDAKernelVariantsTestMapper* mapper,
+                 vtkCamera* start, const Scene& scene, bool specialized, std::vector< std::vector<uchar4> >& images)
+{
+  const int expectedVariant = specialized ? scene.Variant : CUDA_VARIANT_GENERAL;
+  mapper->SetUseSpecializedKernels(specialized);
+  renderer->GetActiveCamera()->DeepCopy(start);
+  images.resize(NumberOfViews);
+  for( int v = 0; v < NumberOfViews; v++ )
+    {
+    renderer->GetActiveCamera()->Azimuth( 360.0 / NumberOfViews );
+    renderer->ResetCameraClippingRange();
+    window->Render();
+    if( mapper->GetKernelVariant() != expectedVariant || !mapper->CopyImage(images[v]) )
+      {
+      std::cerr << "Line " << __LINE__ << " - the " << scene.Name << " scene was rendered with the variant "
+                << mapper->GetKernelVariant() << " instead of " << expectedVariant << " in view " << v << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Renders a scene with the general and the specialized variants, which must cast the same images
+bool CheckScene(vtkRenderer* renderer, vtkRenderWindow* window, vtkCUDAKernelVariantsTestMapper* mapper,
+                const Scene& scene)
+{
+  vtkSmartPointer<vtkCamera> start = vtkSmartPointer<vtkCamera>::New();
+  start->DeepCopy( renderer->GetActiveCamera() );
+  start->SetParallelProjection(scene.Parallel ? 1 : 0);
+
+  std::vector< std::vector<uchar4> > generalImages;
+  std::vector< std::vector<uchar4> > specializedImages;
+  if( !RenderViews(renderer, window, mapper, start, scene, false, generalImages) ||
+      !RenderViews(renderer, window, mapper, start, scene, true, specializedImages) )
+    {
+    return false;
+    }
+
+  //the specialized variants leave out only what would not change the image, so not a single pixel may differ
+  for( int v = 0; v < NumberOfViews; v++ )
+    {
+    const std::vector<uchar4>& general = generalImages[v];
+    const std::vector<uchar4>& specialized = specializedImages[v];
+    if( general.size() != specialized.size() )
+      {
+      std::cerr << "Line " << __LINE__ << " - the images of the " << scene.Name << " scene differ in size" << std::endl;
+      return false;
+      }
+    int differentPixels = 0;
+    bool visible = false;
+    for( size_t p = 0; p < general.size(); p++ )
+      {
+      differentPixels += memcmp( &(general[p]), &(specialized[p]), sizeof(uchar4) ) != 0 ? 1 : 0;
+      visible = visible || general[p].w != 0;
+      }
+    if( differentPixels != 0 || !visible )
+      {
+      std::cerr << "Line " << __LINE__ << " - " << differentPixels << " pixels of view " << v << " of the " << scene.Name
+                << " scene differ between the variants" << (visible ? "" : ", which cast an empty image") << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDAKernelVariantsTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  //the mock runtime has to be in place before the first CUDA object takes a device
+  vtkSmartPointer<vtkCUDAMockRuntime> runtime = vtkSmartPointer<vtkCUDAMockRuntime>::New();
+  vtkCUDADeviceManager::Singleton()->SetRuntime(runtime);
+
+  vtkSmartPointer<vtkColorTransferFunction> colour = vtkSmartPointer<vtkColorTransferFunction>::New();
+  colour->AddRGBPoint(0.0, 0.0, 0.0, 0.0);
+  colour->AddRGBPoint(1000.0, 0.88, 0.60, 0.29);
+  colour->AddRGBPoint(2000.0, 1.0, 1.0, 1.0);
+  vtkSmartPointer<vtkPiecewiseFunction> opacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  opacity->AddPoint(0.0, 0.0);
+  opacity->AddPoint(500.0, 0.0);
+  opacity->AddPoint(2000.0, 0.3);
+  vtkSmartPointer<vtkPiecewiseFunction> unitGradientOpacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  unitGradientOpacity->AddPoint(0.0, 1.0);
+  unitGradientOpacity->AddPoint(255.0, 1.0);
+  vtkSmartPointer<vtkPiecewiseFunction> gradientOpacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  gradientOpacity->AddPoint(0.0, 0.1);
+  gradientOpacity->AddPoint(100.0, 1.0);
+  vtkSmartPointer<vtkVolumeProperty> property = vtkSmartPointer<vtkVolumeProperty>::New();
+  property->SetColor(colour);
+  property->SetScalarOpacity(opacity);
+  property->SetInterpolationTypeToLinear();
+  property->SetAmbient(0.3);
+  property->SetDiffuse(0.6);
+  property->SetSpecular(0.2);
+  property->SetSpecularPower(10.0);
+
+  vtkSmartPointer<vtkImageData> image;
+  image.TakeReference( CreateVolume(VolumeSize) );
+  vtkSmartPointer<vtkCUDAKernelVariantsTestMapper> mapper = vtkSmartPointer<vtkCUDAKernelVariantsTestMapper>::New();
+  mapper->SetRenderBackend(vtkCUDAVolumeMapper::CPU_BACKEND);
+  mapper->SetInput(image);
+  mapper->SetRenderOnDemand(false);
+  vtkSmartPointer<vtkVolume> volume = vtkSmartPointer<vtkVolume>::New();
+  volume->SetMapper(mapper);
+  volume->SetProperty(property);
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  renderer->AddVolume(volume);
+  vtkSmartPointer<vtkRenderWindow> window = vtkSmartPointer<vtkRenderWindow>::New();
+  window->SetOffScreenRendering(1);
+  window->SetSize(WindowSize, WindowSize);
+  window->AddRenderer(renderer);
+  renderer->ResetCamera();
+  renderer->GetActiveCamera()->Elevation(20.0);
+
+  //a plane through the middle of the volume, tilted so it cuts the rays at every depth
+  vtkSmartPointer<vtkPlane> plane = vtkSmartPointer<vtkPlane>::New();
+  const double centre = 0.5 * (VolumeSize - 1);
+  plane->SetOrigin(centre, centre, centre);
+  plane->SetNormal(1.0, 0.5, 0.25);
+
+  const int perspective = CUDA_VARIANT_PERSPECTIVE;
+  const Scene scenes[] = {
+    { "unshaded", false, false, false, false, perspective },
+    { "shaded", true, false, false, false, CUDA_VARIANT_SHADED | perspective },
+    { "gradient opacity", false, true, false, false, CUDA_VARIANT_GRADIENT_OPACITY | perspective },
+    { "clipped", false, false, true, false, CUDA_VARIANT_CLIPPED | perspective },
+    { "parallel", false, false, false, true, 0 },
+    { "general", true, true, true, false, CUDA_VARIANT_GENERAL } };
+  const int numberOfScenes = sizeof(scenes) / sizeof(scenes[0]);
+
+  for( int s = 0; s < numberOfScenes; s++ )
+    {
+    const Scene& scene = scenes[s];
+    property->SetShade(scene.Shaded ? 1 : 0);
+    property->SetGradientOpacity(scene.GradientOpacity ? gradientOpacity : unitGradientOpacity);
+    mapper->RemoveAllClippingPlanes();
+    if( scene.Clipped ) mapper->AddClippingPlane(plane);
+    if( !CheckScene(renderer, window, mapper, scene) )
+      {
+      return EXIT_FAILURE;
+      }
+    }
+  mapper->RemoveAllClippingPlanes();
+  renderer->RemoveVolume(volume);
+
+  if( runtime->GetNumberOfInvalidCalls() != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << runtime->GetNumberOfInvalidCalls() << " invalid device calls" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,289 @@
+/** @file vtkCUDAMacroCellGridTest.cxx
+*
+*  @brief Test of the macro cell grid used for empty space skipping (CPU_vtkCUDAVolumeMapper_buildMacroCellGrid and
+*         CPU_vtkCUDAVolumeMapper_classifyMacroCells) against a brute force evaluation
+*
+*  The range of every cell is compared against the minimum and maximum of all the voxels the cell reaches, one beyond
+*  each of its faces, for volumes whose sizes are not multiples of the cell size. The classification is checked to be
+*  safe, by sampling the opacity every value of a cell's range can interpolate, and to be tight, by scanning the table
+*  entries the cell can reach.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "CPU_vtkCUDAVolumeMapper_macroCells.h"
+#include "vtkCUDAHostThreadPool.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace
+{
+
+/** @brief Number of entries in the opacity lookup table */
+const unsigned int TableSize = 256;
+
+/** @brief Number of values sampled across the range of a cell when checking that an empty cell is truly transparent */
+const int RangeSamples = 512;
+
+//----------------------------------------------------------------------------
+// A sphere of bright voxels in dark noise, so that cells fall on either side of the transfer function's threshold
+template< class T >
+void CreateVolume(std::vector<T>& voxels, const int3& size, double background, double foreground, double noise)
+{
+  voxels.resize( (size_t) size.x * size.y * size.z );
+  unsigned int seed = 12345;
+  const double radius = 0.3 * size.x;
+  for( int z = 0; z < size.z; z++ )
+    for( int y = 0; y < size.y; y++ )
+      for( int x = 0; x < size.x; x++ )
+        {
+        seed = seed * 1103515245u + 12345u;
+        const double dx = x - 0.5 * size.x;
+        const double dy = y - 0.5 * size.y;
+        const double dz = z - 0.5 * size.z;
+        const double inside = (dx * dx + dy * dy + dz * dz < radius * radius) ? foreground : background;
+        voxels[x + size.x * (y + (size_t) size.y * z)] = (T) (inside + noise * (double) ((seed >> 16) % 1024) / 1023.0);
+        }
+}
+
+//----------------------------------------------------------------------------
+template< class T >
+bool CheckGrid(const char* name, const std::vector<T>& voxels, const int3& size,
+               const cudaVolumePackingInformation& packing, int cellSize, const cudaMacroCellGrid& grid)
+{
+  if( grid.CellSize != cellSize || grid.GridSize.x != (size.x + cellSize - 1) / cellSize ||
+      grid.GridSize.y != (size.y + cellSize - 1) / cellSize || grid.GridSize.z != (size.z + cellSize - 1) / cellSize )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << name << " cells of " << cellSize << " make a grid of " << grid.GridSize.x
+              << "x" << grid.GridSize.y << "x" << grid.GridSize.z << " cells of " << grid.CellSize << std::endl;
+    return false;
+    }
+
+  //each cell reaches the voxels [c * size - 1, (c + 1) * size] along each axis, clamped to the volume
+  for( int cz = 0; cz < grid.GridSize.z; cz++ )
+    for( int cy = 0; cy < grid.GridSize.y; cy++ )
+      for( int cx = 0; cx < grid.GridSize.x; cx++ )
+        {
+        double low = std::numeric_limits<double>::max();
+        double high = -std::numeric_limits<double>::max();
+        for( int z = cz * cellSize - 1; z <= (cz + 1) * cellSize; z++ )
+          for( int y = cy * cellSize - 1; y <= (cy + 1) * cellSize; y++ )
+            for( int x = cx * cellSize - 1; x <= (cx + 1) * cellSize; x++ )
+              {
+              if( x < 0 || y < 0 || z < 0 || x >= size.x || y >= size.y || z >= size.z ) continue;
+              const double v = (double) voxels[x + size.x * (y + (size_t) size.y * z)];
+              low = v < low ? v : low;
+              high = v > high ? v : high;
+              }
+
+        const size_t cell = cx + grid.GridSize.x * (cy + (size_t) grid.GridSize.y * cz);
+        const float minimum = (float) ((low - packing.Shift) / packing.Scale);
+        const float maximum = (float) ((high - packing.Shift) / packing.Scale);
+        if( grid.Minimum[cell] != minimum || grid.Maximum[cell] != maximum )
+          {
+          std::cerr << "Line " << __LINE__ << " - " << name << " cell (" << cx << ", " << cy << ", " << cz << ") of size "
+                    << cellSize << " has the range [" << grid.Minimum[cell] << ", " << grid.Maximum[cell]
+                    << "] instead of [" << minimum << ", " << maximum << "]" << std::endl;
+          return false;
+          }
+        }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// The opacity of a value read through the volume texture, as the ray casters look it up
+float LookUpOpacity(const std::vector<float>& alpha, float value, float intensityLow, float intensityMultiplier)
+{
+  const float u = intensityMultiplier * (value - intensityLow);
+  float t = u * (float) alpha.size() - 0.5f;
+  t = t < 0.0f ? 0.0f : (t > (float) alpha.size() - 1.0f ? (float) alpha.size() - 1.0f : t);
+  const int i = (int) std::floor( t );
+  const int j = (i + 1 < (int) alpha.size()) ? i + 1 : i;
+  const float w = t - (float) i;
+  return (1.0f - w) * alpha[i] + w * alpha[j];
+}
+
+//----------------------------------------------------------------------------
+bool CheckClassification(const char* name, const cudaMacroCellGrid& grid, const std::vector<float>& alpha,
+                         float intensityLow, float intensityMultiplier, int& numberOfEmptyCells)
+{
+  const size_t numberOfCells = (size_t) grid.GridSize.x * grid.GridSize.y * grid.GridSize.z;
+  std::vector<unsigned char> occupancy( numberOfCells, 2 );
+  CPU_vtkCUDAVolumeMapper_classifyMacroCells(grid, &alpha[0], (unsigned int) alpha.size(), intensityLow, intensityMultiplier,
+                                             &occupancy[0]);
+
+  numberOfEmptyCells = 0;
+  for( size_t cell = 0; cell < numberOfCells; cell++ )
+    {
+    if( occupancy[cell] > 1 )
+      {
+      std::cerr << "Line " << __LINE__ << " - " << name << " cell " << cell << " was not classified" << std::endl;
+      return false;
+      }
+
+    //safe: no value within the range of an empty cell may look up a visible opacity
+    const float low = grid.Minimum[cell];
+    const float high = grid.Maximum[cell];
+    if( occupancy[cell] == 0 )
+      {
+      numberOfEmptyCells++;
+      for( int s = 0; s <= RangeSamples; s++ )
+        {
+        const float value = low + (high - low) * (float) s / (float) RangeSamples;
+        if( LookUpOpacity(alpha, value, intensityLow, intensityMultiplier) > 0.0f )
+          {
+          std::cerr << "Line " << __LINE__ << " - " << name << " cell " << cell << " is skipped, but the value " << value
+                    << " of its range is visible" << std::endl;
+          return false;
+          }
+        }
+      continue;
+      }
+
+    //tight: a visible cell must reach a visible entry of the table, allowing the one entry margin either side
+    const double n = (double) alpha.size();
+    double first = std::floor( intensityMultiplier * (double) (low - intensityLow) * n - 0.5 ) - 1.0;
+    double last = std::floor( intensityMultiplier * (double) (high - intensityLow) * n - 0.5 ) + 2.0;
+    first = first < 0.0 ? 0.0 : (first > n - 1.0 ? n - 1.0 : first);
+    last = last < 0.0 ? 0.0 : (last > n - 1.0 ? n - 1.0 : last);
+    bool visible = false;
+    for( int i = (int) first; i <= (int) last; i++ )
+      visible = visible || alpha[i] > 0.0f;
+    if( !visible )
+      {
+      std::cerr << "Line " << __LINE__ << " - " << name << " cell " << cell << " is kept, but only reaches transparent entries "
+                << first << " to " << last << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+template< class T >
+bool CheckVolume(const char* name, int scalarType, const int3& size, double background, double foreground, double noise,
+                 const cudaVolumePackingInformation& packing, float intensityLow, float intensityMultiplier,
+                 vtkCUDAHostThreadPool* pool)
+{
+  std::vector<T> voxels;
+  CreateVolume(voxels, size, background, foreground, noise);
+
+  //transparent below half of the table, where the background falls, and visible above it
+  std::vector<float> alpha( TableSize, 0.0f );
+  for( unsigned int i = TableSize / 2; i < TableSize; i++ )
+    alpha[i] = 0.5f;
+
+  const int cellSizes[3] = { 1, CPU_MACRO_CELL_SIZE, 64 };
+  for( int c = 0; c < 3; c++ )
+    {
+    cudaMacroCellGrid serial;
+    cudaMacroCellGrid parallel;
+    memset( &serial, 0, sizeof(serial) );
+    memset( &parallel, 0, sizeof(parallel) );
+    if( !CPU_vtkCUDAVolumeMapper_buildMacroCellGrid(&voxels[0], scalarType, size, packing, cellSizes[c], serial, 0) ||
+        !CPU_vtkCUDAVolumeMapper_buildMacroCellGrid(&voxels[0], scalarType, size, packing, cellSizes[c], parallel, pool) )
+      {
+      std::cerr << "Line " << __LINE__ << " - " << name << " failed to build a grid of cells of " << cellSizes[c] << std::endl;
+      return false;
+      }
+
+    const size_t numberOfCells = (size_t) serial.GridSize.x * serial.GridSize.y * serial.GridSize.z;
+    bool ok = CheckGrid(name, voxels, size, packing, cellSizes[c], serial) &&
+              memcmp( serial.Minimum, parallel.Minimum, numberOfCells * sizeof(float) ) == 0 &&
+              memcmp( serial.Maximum, parallel.Maximum, numberOfCells * sizeof(float) ) == 0;
+    if( !ok )
+      {
+      std::cerr << "Line " << __LINE__ << " - " << name << " grid of cells of " << cellSizes[c]
+                << " is wrong, or differs between the calling thread and the host threads" << std::endl;
+      }
+
+    int numberOfEmptyCells = 0;
+    ok = ok && CheckClassification(name, serial, alpha, intensityLow, intensityMultiplier, numberOfEmptyCells);
+    if( ok && cellSizes[c] == CPU_MACRO_CELL_SIZE && numberOfEmptyCells == 0 )
+      {
+      std::cerr << "Line " << __LINE__ << " - " << name << " has no empty cell around its sphere" << std::endl;
+      ok = false;
+      }
+
+    CPU_vtkCUDAVolumeMapper_freeMacroCellGrid(serial);
+    CPU_vtkCUDAVolumeMapper_freeMacroCellGrid(parallel);
+    if( !ok ) return false;
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDAMacroCellGridTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkSmartPointer<vtkCUDAHostThreadPool> pool = vtkSmartPointer<vtkCUDAHostThreadPool>::New();
+  int3 size;
+  size.x = 37;
+  size.y = 29;
+  size.z = 19;
+
+  //signed shorts read back as (value + 32768) / 65535, the table covering [0, 2000]
+  cudaVolumePackingInformation packing;
+  packing.Format = CUDA_PACKED_UNSIGNED_SHORT;
+  packing.Scale = 65535.0f;
+  packing.Shift = -32768.0f;
+  if( !CheckVolume<short>("short", VTK_SHORT, size, 0.0, 1000.0, 50.0, packing,
+                          32768.0f / 65535.0f, 65535.0f / 2000.0f, pool) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //floats read back as is, the table covering [-1, 1]
+  packing.Format = CUDA_PACKED_FLOAT;
+  packing.Scale = 1.0f;
+  packing.Shift = 0.0f;
+  if( !CheckVolume<float>("float", VTK_FLOAT, size, -1.0, 1.0, 0.25, packing, -1.0f, 0.5f, pool) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //an unusable mapping to the table proves nothing empty
+  std::vector<float> voxels;
+  CreateVolume(voxels, size, -1.0, 1.0, 0.25);
+  cudaMacroCellGrid grid;
+  memset( &grid, 0, sizeof(grid) );
+  CPU_vtkCUDAVolumeMapper_buildMacroCellGrid(&voxels[0], VTK_FLOAT, size, packing, CPU_MACRO_CELL_SIZE, grid, pool);
+  const size_t numberOfCells = (size_t) grid.GridSize.x * grid.GridSize.y * grid.GridSize.z;
+  std::vector<float> transparent( TableSize, 0.0f );
+  std::vector<unsigned char> occupancy( numberOfCells, 0 );
+  CPU_vtkCUDAVolumeMapper_classifyMacroCells(grid, &transparent[0], TableSize, -1.0f,
+                                             std::numeric_limits<float>::infinity(), &occupancy[0]);
+  for( size_t cell = 0; cell < numberOfCells; cell++ )
+    {
+    if( occupancy[cell] != 1 )
+      {
+      std::cerr << "Line " << __LINE__ << " - cell " << cell << " is skipped without a finite mapping to the table" << std::endl;
+      CPU_vtkCUDAVolumeMapper_freeMacroCellGrid(grid);
+      return EXIT_FAILURE;
+      }
+    }
+
+  //unsupported types and invalid sizes leave the grid empty
+  const bool refused = !CPU_vtkCUDAVolumeMapper_buildMacroCellGrid(&voxels[0], VTK_BIT, size, packing, CPU_MACRO_CELL_SIZE, grid, pool) &&
+                       grid.Minimum == 0 && grid.GridSize.x == 0 &&
+                       !CPU_vtkCUDAVolumeMapper_buildMacroCellGrid(&voxels[0], VTK_FLOAT, size, packing, 0, grid, pool);
+  CPU_vtkCUDAVolumeMapper_freeMacroCellGrid(grid);
+  if( !refused )
+    {
+    std::cerr << "Line " << __LINE__ << " - a grid is built for an unsupported type or cell size" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,189 @@
+/** @file vtkCUDAPreIntegrationTest.cxx
+*
+*  @brief Test of the pre-integrated transfer function table of vtkCUDA1DVolumeMapper (CPU_vtkCUDA1DVolumeMapper_preIntegrate)
+*         against the segments integrated numerically
+*
+*  The table is built for the synthetic transfer functions of vtkCUDAPreIntegrationBenchmark (a peak one entry wide, a
+*  step and a ramp), on the calling thread and on host threads, which must give the same table. Every entry read is
+*  compared against the segment integrated in double precision in many small steps, its opacity and its premultiplied
+*  colour having to agree within the tolerance. No CUDA device is needed.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "CPU_vtkCUDA1DVolumeMapper_preIntegration.h"
+#include "vtkCUDAHostThreadPool.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+/** @brief Number of entries in the synthetic lookup tables */
+const int FunctionSize = 512;
+
+/** @brief Number of steps the reference integrates a segment in */
+const int ReferenceSteps = 4096;
+
+/** @brief Largest difference allowed between the table and the reference, in opacity and premultiplied colour */
+const double Tolerance = 2e-3;
+
+/** @brief Only every so many rows and columns of the table are checked, along with the whole diagonal */
+const int CheckStride = 5;
+
+/** @brief Number of host threads the table is also built on */
+const int NumberOfThreads = 3;
+
+//----------------------------------------------------------------------------
+// The 1D lookup tables of a synthetic transfer function
+struct LookupTables
+{
+  const char* Name;
+  std::vector<float> Alpha;
+  std::vector<float> Red;
+  std::vector<float> Green;
+  std::vector<float> Blue;
+};
+
+//----------------------------------------------------------------------------
+// A peak one entry wide, a hard step and a ramp, each in a colour varying with the intensity
+void CreateLookupTables(std::vector<LookupTables>& tables)
+{
+  const char* names[3] = { "peak", "step", "ramp" };
+  tables.resize(3);
+  for( int t = 0; t < 3; t++ )
+    {
+    LookupTables& table = tables[t];
+    table.Name = names[t];
+    table.Alpha.resize(FunctionSize);
+    table.Red.resize(FunctionSize);
+    table.Green.resize(FunctionSize);
+    table.Blue.resize(FunctionSize);
+    for( int i = 0; i < FunctionSize; i++ )
+      {
+      const double u = ((double) i + 0.5) / (double) FunctionSize;
+      if( t == 0 ) table.Alpha[i] = (i == FunctionSize / 3) ? 0.9f : 0.0f;
+      else if( t == 1 ) table.Alpha[i] = (i >= FunctionSize / 2) ? 0.6f : 0.02f;
+      else table.Alpha[i] = (float) (0.5 * u);
+      table.Red[i] = (float) u;
+      table.Green[i] = (float) (1.0 - u);
+      table.Blue[i] = (float) (0.5 + 0.5 * std::sin( 12.0 * u ));
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Reads a lookup table as a linearly filtered, clamped texture with normalized co-ordinates
+double LookUp(const std::vector<float>& table, double u)
+{
+  const int size = (int) table.size();
+  double x = u * (double) size - 0.5;
+  int i0 = (int) std::floor(x);
+  double a = x - (double) i0;
+  int i1 = i0 + 1;
+  i0 = i0 < 0 ? 0 : (i0 >= size ? size - 1 : i0);
+  i1 = i1 < 0 ? 0 : (i1 >= size ? size - 1 : i1);
+  return (1.0 - a) * table[i0] + a * table[i1];
+}
+
+//----------------------------------------------------------------------------
+// Composites the segment from intensity front to back in many small steps, each a point sample with its opacity
+// corrected to the length of the step, giving the opacity and premultiplied colour of the whole segment
+void IntegrateSegment(const LookupTables& tables, double front, double back, double* rgba)
+{
+  double remaining = 1.0;
+  rgba[0] = rgba[1] = rgba[2] = 0.0;
+  for( int k = 0; k < ReferenceSteps; k++ )
+    {
+    const double u = front + (back - front) * ((double) k + 0.5) / (double) ReferenceSteps;
+    const double alpha = 1.0 - std::pow( 1.0 - LookUp(tables.Alpha, u), 1.0 / (double) ReferenceSteps );
+    rgba[0] += remaining * alpha * LookUp(tables.Red, u);
+    rgba[1] += remaining * alpha * LookUp(tables.Green, u);
+    rgba[2] += remaining * alpha * LookUp(tables.Blue, u);
+    remaining *= 1.0 - alpha;
+    }
+  rgba[3] = 1.0 - remaining;
+}
+
+//----------------------------------------------------------------------------
+// Builds the table serially and on the threads, which must agree exactly, and compares it against the reference
+bool CheckTable(const LookupTables& tables, vtkCUDAHostThreadPool* pool)
+{
+  const int size = CPU_PREINTEGRATED_TABLE_SIZE;
+  std::vector<float> serial( 4 * size * size, -1.0f );
+  std::vector<float> parallel( 4 * size * size, -1.0f );
+  CPU_vtkCUDA1DVolumeMapper_preIntegrate(&tables.Alpha[0], &tables.Red[0], &tables.Green[0], &tables.Blue[0],
+                                         FunctionSize, size, &serial[0], 0);
+  CPU_vtkCUDA1DVolumeMapper_preIntegrate(&tables.Alpha[0], &tables.Red[0], &tables.Green[0], &tables.Blue[0],
+                                         FunctionSize, size, &parallel[0], pool);
+  for( size_t i = 0; i < serial.size(); i++ )
+    {
+    if( serial[i] != parallel[i] )
+      {
+      std::cerr << "Line " << __LINE__ << " - the " << tables.Name << " table built on " << pool->GetNumberOfThreads()
+                << " threads differs at value " << i << ": " << parallel[i] << " instead of " << serial[i] << std::endl;
+      return false;
+      }
+    }
+
+  double maximumAlphaError = 0.0;
+  double maximumColourError = 0.0;
+  int errors = 0;
+  for( int j = 0; j < size; j++ )
+    {
+    for( int i = 0; i < size; i++ )
+      {
+      if( i != j && (i % CheckStride != 0 || j % CheckStride != 0) ) continue;
+      const float* entry = &serial[ 4 * (j * size + i) ];
+      double reference[4];
+      IntegrateSegment(tables, ((double) i + 0.5) / (double) size, ((double) j + 0.5) / (double) size, reference);
+
+      //the table keeps the mean colour, which the opacity weighs as the rays composite it
+      double alphaError = std::fabs( (double) entry[3] - reference[3] );
+      double colourError = 0.0;
+      for( int c = 0; c < 3; c++ )
+        {
+        double error = std::fabs( (double) entry[c] * (double) entry[3] - reference[c] );
+        colourError = error > colourError ? error : colourError;
+        }
+      maximumAlphaError = alphaError > maximumAlphaError ? alphaError : maximumAlphaError;
+      maximumColourError = colourError > maximumColourError ? colourError : maximumColourError;
+      errors += (alphaError > Tolerance || colourError > Tolerance) ? 1 : 0;
+      }
+    }
+  if( errors != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << errors << " entries of the " << tables.Name << " table are off the"
+              << " integrated segments by up to " << maximumAlphaError << " in opacity and " << maximumColourError
+              << " in colour, more than " << Tolerance << std::endl;
+    return false;
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDAPreIntegrationTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkSmartPointer<vtkCUDAHostThreadPool> pool = vtkSmartPointer<vtkCUDAHostThreadPool>::New();
+  pool->SetNumberOfThreads(NumberOfThreads);
+
+  std::vector<LookupTables> tables;
+  CreateLookupTables(tables);
+  for( size_t t = 0; t < tables.size(); t++ )
+    {
+    if( !CheckTable(tables[t], pool) )
+      {
+      return EXIT_FAILURE;
+      }
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,402 @@
+/** @file vtkCUDAProgressiveRenderingTest.cxx
+*
+*  @brief Test of progressive rendering: the averaging of the passes (CPU_vtkCUDAVolumeMapper_renderAlgo_accumulateImage)
+*         and the restart of the accumulation when the scene changes (vtkCUDAVolumeMapper::PrepareProgressivePass)
+*
+*  The passes are averaged on random images and checked against the exact running sums and their rounded means,
+*  including a restart over a stale sum. The mapper is then driven through its passes on the CPU backend, with the mock
+*  runtime in place of CUDA so no device is needed: the passes must count up to the maximum and converge, load the ray
+*  offsets of their pass, and start again from the first pass when the mapper, the volume property or the sample distance
+*  changes, but not otherwise. Once converged, redraws of the pipeline must display the same image again without casting
+*  it, and on the copy path of the output image (which the mock runtime takes, having no OpenGL interop) displaying the
+*  image again must neither read back nor switch to the other readback buffer, which holds the pass before.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "CPU_vtkCUDAVolumeMapper_renderAlgo.h"
+#include "vtkCUDA1DVolumeMapper.h"
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAMockRuntime.h"
+#include "vtkCUDAOutputImageInformationHandler.h"
+
+// VTK includes
+#include <vtkColorTransferFunction.h>
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkSmartPointer.h>
+#include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+/** @brief Number of passes the mapper averages before its image is left as it is */
+const int MaximumNumberOfPasses = 5;
+
+/** @brief Size of the volume along each axis, and of the render window */
+const int VolumeSize = 16;
+const int WindowSize = 40;
+
+/** @brief Number of times a converged image is drawn again */
+const int NumberOfRedraws = 3;
+
+//----------------------------------------------------------------------------
+// Averages random passes into one image and checks the sums and the means after each
+bool CheckAccumulation()
+{
+  uint2 resolution;
+  resolution.x = 37;
+  resolution.y = 23;
+  const size_t numberOfPixels = (size_t) resolution.x * resolution.y;
+  std::vector<uchar4> image( numberOfPixels );
+  std::vector<float4> accumulation( numberOfPixels );
+  std::vector<double> sums( 4 * numberOfPixels );
+
+  //a stale sum from an earlier accumulation, which the first pass must not add to
+  for( size_t i = 0; i < numberOfPixels; i++ )
+    accumulation[i].x = accumulation[i].y = accumulation[i].z = accumulation[i].w = 1e6f;
+
+  unsigned int seed = 4321;
+  for( int pass = 0; pass < 64; pass++ )
+    {
+    for( size_t i = 0; i < numberOfPixels; i++ )
+      {
+      unsigned char* channels = &image[i].x;
+      for( int c = 0; c < 4; c++ )
+        {
+        seed = seed * 1103515245u + 12345u;
+        channels[c] = (unsigned char) (seed >> 24);
+        sums[4 * i + c] = (pass ? sums[4 * i + c] : 0.0) + channels[c];
+        }
+      }
+
+    CPU_vtkCUDAVolumeMapper_renderAlgo_accumulateImage(&image[0], &accumulation[0], resolution, pass);
+
+    for( size_t i = 0; i < numberOfPixels; i++ )
+      {
+      const unsigned char* channels = &image[i].x;
+      const float* sum = &accumulation[i].x;
+      for( int c = 0; c < 4; c++ )
+        {
+        const double expectedSum = sums[4 * i + c];
+        const int expectedMean = (int) std::floor( expectedSum / (pass + 1) + 0.5 );
+        if( (double) sum[c] != expectedSum || std::abs( (int) channels[c] - expectedMean ) > 0 )
+          {
+          std::cerr << "Line " << __LINE__ << " - after pass " << pass << ", channel " << c << " of pixel " << i
+                    << " sums to " << sum[c] << " with a mean of " << (int) channels[c] << " instead of " << expectedSum
+                    << " and " << expectedMean << std::endl;
+          return false;
+          }
+        }
+      }
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+// Exposes the progressive passes of the mapper, which the render normally drives
+class vtkCUDAProgressiveTestMapper : public vtkCUDA1DVolumeMapper
+{
+public:
+  vtkTypeMacro(vtkCUDAProgressiveTestMapper, vtkCUDA1DVolumeMapper);
+  static vtkCUDAProgressiveTestMapper* New();
+
+  bool PreparePass(vtkVolume* volume, float sampleDistanceFactor)
+    {
+    return this->PrepareProgressivePass(volume, sampleDistanceFactor);
+    }
+
+  //the CPU backend keeps the image on the host, and with no image rendered there is nothing to add but the pass itself
+  void FinishPass() { this->OutputInfoHandler->Accumulate(); }
+  int GetNumberOfAccumulatedPasses() { return this->OutputInfoHandler->GetNumberOfAccumulatedPasses(); }
+
+  //counts the images cast, as opposed to displayed again
+  virtual void InternalRender(vtkRenderer* ren, vtkVolume* vol, const cudaRendererInformation& rendererInfo,
+                              const cudaVolumeInformation& volumeInfo, const cudaOutputImageInformation& outputInfo)
+    {
+    this->NumberOfCasts++;
+    this->Superclass::InternalRender(ren, vol, rendererInfo, volumeInfo, outputInfo);
+    }
+  int NumberOfCasts;
+
+  bool CopyImage(std::vector<uchar4>& image)
+    {
+    const uint2 resolution = this->OutputInfoHandler->GetOutputImageInfo().resolution;
+    image.resize( (size_t) resolution.x * (size_t) resolution.y );
+    return !image.empty() && this->OutputInfoHandler->CopyLastImage( &(image[0]) );
+    }
+
+  //the offsets of a pass are those of the first pass moved by the golden ratio, modulo one step
+  bool HasRayOffsetsOfPass(int pass)
+    {
+    for( int i = 0; i < 256; i++ )
+      {
+      double offset = this->RandomRayOffsets[i] + 0.6180339887498949 * pass;
+      if( this->RayOffsets[i] != (float) (offset - floor(offset)) ) return false;
+      }
+    return true;
+    }
+
+protected:
+  vtkCUDAProgressiveTestMapper() { this->NumberOfCasts = 0; }
+  ~vtkCUDAProgressiveTestMapper() {}
+
+private:
+  vtkCUDAProgressiveTestMapper(const vtkCUDAProgressiveTestMapper&); // Not implemented.
+  void operator=(const vtkCUDAProgressiveTestMapper&); // Not implemented.
+};
+
+vtkStandardNewMacro(vtkCUDAProgressiveTestMapper);
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Renders passes until the accumulation converges, checking the pass each one is at
+bool RunPasses(vtkCUDAProgressiveTestMapper* mapper, vtkVolume* volume, float sampleDistanceFactor, int firstPass, int line)
+{
+  for( int pass = firstPass; pass < MaximumNumberOfPasses; pass++ )
+    {
+    if( mapper->PreparePass(volume, sampleDistanceFactor) )
+      {
+      std::cerr << "Line " << line << " - the accumulation converged after " << pass << " passes instead of "
+                << MaximumNumberOfPasses << std::endl;
+      return false;
+      }
+    if( mapper->GetNumberOfAccumulatedPasses() != pass || !mapper->HasRayOffsetsOfPass(pass) )
+      {
+      std::cerr << "Line " << line << " - pass " << pass << " starts with " << mapper->GetNumberOfAccumulatedPasses()
+                << " passes accumulated, or with the ray offsets of another pass" << std::endl;
+      return false;
+      }
+    mapper->FinishPass();
+    }
+
+  //the image has converged, so further renders cast nothing, and the passes are not restarted
+  if( !mapper->PreparePass(volume, sampleDistanceFactor) || !mapper->PreparePass(volume, sampleDistanceFactor) ||
+      mapper->GetNumberOfAccumulatedPasses() != MaximumNumberOfPasses )
+    {
+    std::cerr << "Line " << line << " - the accumulation did not converge after " << MaximumNumberOfPasses << " passes" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Renders a pipeline until its image converges, then draws it again, which must display the converged image as it is
+bool CheckConvergedRedraws(vtkVolumeProperty* property)
+{
+  vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+  image->SetDimensions(VolumeSize, VolumeSize, VolumeSize);
+  image->SetScalarTypeToUnsignedChar();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+  unsigned char* voxels = static_cast<unsigned char*>( image->GetScalarPointer() );
+  for( int i = 0; i < VolumeSize * VolumeSize * VolumeSize; i++ )
+    voxels[i] = (unsigned char) ((i * 37) % 256);
+
+  vtkSmartPointer<vtkCUDAProgressiveTestMapper> mapper = vtkSmartPointer<vtkCUDAProgressiveTestMapper>::New();
+  mapper->SetRenderBackend(vtkCUDAVolumeMapper::CPU_BACKEND);
+  mapper->SetProgressiveRendering(true);
+  mapper->SetMaximumNumberOfProgressivePasses(MaximumNumberOfPasses);
+  mapper->SetCollectStatistics(true);
+  mapper->SetInput(image);
+  vtkSmartPointer<vtkVolume> volume = vtkSmartPointer<vtkVolume>::New();
+  volume->SetMapper(mapper);
+  volume->SetProperty(property);
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  renderer->AddVolume(volume);
+  vtkSmartPointer<vtkRenderWindow> window = vtkSmartPointer<vtkRenderWindow>::New();
+  window->SetOffScreenRendering(1);
+  window->SetSize(WindowSize, WindowSize);
+  window->AddRenderer(renderer);
+  renderer->ResetCamera();
+
+  for( int pass = 0; pass < MaximumNumberOfPasses; pass++ )
+    window->Render();
+  std::vector<uchar4> converged;
+  if( mapper->NumberOfCasts != MaximumNumberOfPasses || !mapper->CopyImage(converged) )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << mapper->NumberOfCasts << " images cast for " << MaximumNumberOfPasses
+              << " passes" << std::endl;
+    return false;
+    }
+
+  std::vector<uchar4> redrawn;
+  for( int r = 0; r < NumberOfRedraws; r++ )
+    {
+    window->Render();
+    if( mapper->NumberOfCasts != MaximumNumberOfPasses || mapper->GetRenderStatistics().ImageReused != 1.0 ||
+        !mapper->CopyImage(redrawn) || redrawn.size() != converged.size() ||
+        memcmp( &(redrawn[0]), &(converged[0]), converged.size() * sizeof(uchar4) ) != 0 )
+      {
+      std::cerr << "Line " << __LINE__ << " - redraw " << r << " of the converged image cast it again or displayed"
+                << " another image" << std::endl;
+      return false;
+      }
+    }
+
+  //a change starts the passes again
+  mapper->Modified();
+  window->Render();
+  if( mapper->NumberOfCasts != MaximumNumberOfPasses + 1 || mapper->GetNumberOfAccumulatedPasses() != 1 )
+    {
+    std::cerr << "Line " << __LINE__ << " - a modified mapper did not cast its first pass again" << std::endl;
+    return false;
+    }
+  renderer->RemoveVolume(volume);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Displays two images through the readback buffers of the copy path, then the last one again, which must neither read it
+// back nor show the other buffer
+bool CheckCopyPathRedisplay(vtkCUDAMockRuntime* runtime, vtkVolumeProperty* property)
+{
+  vtkSmartPointer<vtkVolume> volume = vtkSmartPointer<vtkVolume>::New();
+  volume->SetProperty(property);
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  vtkSmartPointer<vtkRenderWindow> window = vtkSmartPointer<vtkRenderWindow>::New();
+  window->SetOffScreenRendering(1);
+  window->SetSize(WindowSize, WindowSize);
+  window->AddRenderer(renderer);
+  window->Render();
+  window->MakeCurrent();
+
+  vtkSmartPointer<vtkCUDAOutputImageInformationHandler> handler = vtkSmartPointer<vtkCUDAOutputImageInformationHandler>::New();
+  handler->SetInteropDisplay(false);
+  handler->SetHostRendering(false);
+  handler->SetRenderer(renderer);
+  const uint2 resolution = handler->GetOutputImageInfo().resolution;
+  const size_t numberOfPixels = (size_t) resolution.x * (size_t) resolution.y;
+
+  //each frame "casts" an image of its own value into the device image of the frame, as the kernels would
+  std::vector<uchar4> image( numberOfPixels );
+  for( int frame = 1; frame <= 2; frame++ )
+    {
+    handler->Prepare();
+    memset( &(image[0]), frame, numberOfPixels * sizeof(uchar4) );
+    runtime->MemcpyAsync( handler->GetOutputImageInfo().deviceOutputImage, &(image[0]), numberOfPixels * sizeof(uchar4),
+                          cudaMemcpyHostToDevice, *(handler->GetStream()) );
+    handler->Display(volume, renderer);
+    }
+
+  const size_t bytesReadBack = runtime->GetBytesCopiedToHost();
+  for( int r = 0; r < NumberOfRedraws; r++ )
+    {
+    if( !handler->DisplayAgain(volume, renderer) || !handler->CopyLastImage( &(image[0]) ) ||
+        image[0].x != 2 || image[numberOfPixels - 1].w != 2 || runtime->GetBytesCopiedToHost() != bytesReadBack )
+      {
+      std::cerr << "Line " << __LINE__ << " - displaying the image again showed the value " << (int) image[0].x
+                << " instead of 2, having read back " << runtime->GetBytesCopiedToHost() - bytesReadBack << " bytes" << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDAProgressiveRenderingTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  if( !CheckAccumulation() )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //the mock runtime has to be in place before the first CUDA object takes a device
+  vtkSmartPointer<vtkCUDAMockRuntime> runtime = vtkSmartPointer<vtkCUDAMockRuntime>::New();
+  vtkCUDADeviceManager::Singleton()->SetRuntime(runtime);
+
+  vtkSmartPointer<vtkColorTransferFunction> colour = vtkSmartPointer<vtkColorTransferFunction>::New();
+  colour->AddRGBPoint(0.0, 0.0, 0.0, 0.0);
+  colour->AddRGBPoint(255.0, 1.0, 1.0, 1.0);
+  vtkSmartPointer<vtkPiecewiseFunction> opacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  opacity->AddPoint(0.0, 0.0);
+  opacity->AddPoint(255.0, 0.5);
+  vtkSmartPointer<vtkVolumeProperty> property = vtkSmartPointer<vtkVolumeProperty>::New();
+  property->SetColor(colour);
+  property->SetScalarOpacity(opacity);
+
+  vtkSmartPointer<vtkCUDAProgressiveTestMapper> mapper = vtkSmartPointer<vtkCUDAProgressiveTestMapper>::New();
+  mapper->SetRenderBackend(vtkCUDAVolumeMapper::CPU_BACKEND);
+  mapper->SetProgressiveRendering(true);
+  mapper->SetMaximumNumberOfProgressivePasses(MaximumNumberOfPasses);
+  vtkSmartPointer<vtkVolume> volume = vtkSmartPointer<vtkVolume>::New();
+  volume->SetMapper(mapper);
+  volume->SetProperty(property);
+
+  //an unchanged scene accumulates up to the maximum
+  if( !RunPasses(mapper, volume, 1.0f, 0, __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //a change of the mapper, of the transfer functions or of the sample distance starts again from the first pass
+  mapper->Modified();
+  if( !RunPasses(mapper, volume, 1.0f, 0, __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+  opacity->AddPoint(128.0, 0.1);
+  if( !RunPasses(mapper, volume, 1.0f, 0, __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+  if( !RunPasses(mapper, volume, 2.0f, 0, __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //a change part way through the passes restarts them too
+  mapper->Modified();
+  if( mapper->PreparePass(volume, 2.0f) || mapper->GetNumberOfAccumulatedPasses() != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - a modified mapper kept its accumulated passes" << std::endl;
+    return EXIT_FAILURE;
+    }
+  mapper->FinishPass();
+  mapper->FinishPass();
+  property->Modified();
+  if( !RunPasses(mapper, volume, 2.0f, 0, __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //turning progressive rendering off and on again drops the accumulation
+  mapper->SetProgressiveRendering(false);
+  mapper->SetProgressiveRendering(true);
+  if( mapper->GetNumberOfAccumulatedPasses() != 0 || !RunPasses(mapper, volume, 2.0f, 0, __LINE__) )
+    {
+    std::cerr << "Line " << __LINE__ << " - turning progressive rendering back on kept the accumulated passes" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  volume->SetMapper(0);
+
+  //a converged image is displayed again as it is, whether it is on the host or read back from the device
+  if( !CheckConvergedRedraws(property) || !CheckCopyPathRedisplay(runtime, property) )
+    {
+    return EXIT_FAILURE;
+    }
+  if( runtime->GetNumberOfInvalidCalls() != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << runtime->GetNumberOfInvalidCalls() << " invalid device calls" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,221 @@
+/** @file vtkCUDARenderAllocationsTest.cxx
+*
+*  @brief Test of the device resources the frames of vtkCUDA1DVolumeMapper take on the mock runtime: nothing allocated
+*         after the first frame, and nothing copied to the device but the parameters of each frame unless the input changes
+*
+*  The CUDA backend renders an off-screen image on vtkCUDAMockRuntime, which answers the host calls and counts them while
+*  the kernels fail to launch, so no CUDA device is needed. The first frame allocates the device and readback images and
+*  the Z buffer. The frames after it, the camera going round the volume, must not allocate device or page-locked memory
+*  again, and must each copy the same few bytes to the device, fewer than the volume holds. Setting the unchanged input
+*  again must not upload it again either, while changing its voxels must upload it once, its old copy being freed.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDA1DVolumeMapper.h"
+#include "vtkCUDADeviceManager.h"
+#include "vtkCUDAMockRuntime.h"
+
+// VTK includes
+#include <vtkCamera.h>
+#include <vtkColorTransferFunction.h>
+#include <vtkImageData.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkRenderer.h>
+#include <vtkSmartPointer.h>
+#include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+/** @brief Size of the volume along each axis, its 8-bit voxels being kept at their native width on the device */
+const int VolumeSize = 32;
+
+/** @brief Size of the off-screen image */
+const int ImageSize = 48;
+
+/** @brief Number of frames rendered after the first, the camera turning between them */
+const int NumberOfFrames = 8;
+
+//----------------------------------------------------------------------------
+// The counters of the mock runtime after a frame
+struct FrameCounts
+{
+  int Allocations;
+  int HostAllocations;
+  int LiveAllocations;
+  size_t BytesToDevice;
+};
+
+//----------------------------------------------------------------------------
+// Fills the volume with a sphere whose density varies with the phase, every phase covering the full range of the
+// voxels so the volume is always packed alike
+void FillVolume(vtkImageData* image, int phase)
+{
+  unsigned char* voxels = static_cast<unsigned char*>( image->GetScalarPointer() );
+  const int centre = VolumeSize / 2;
+  for( int k = 0; k < VolumeSize; k++ )
+    {
+    for( int j = 0; j < VolumeSize; j++ )
+      {
+      for( int i = 0; i < VolumeSize; i++, voxels++ )
+        {
+        const int r2 = (i - centre) * (i - centre) + (j - centre) * (j - centre) + (k - centre) * (k - centre);
+        *voxels = (r2 < centre * centre) ? (unsigned char) (128 + (r2 * (phase + 1)) % 128) : 0;
+        }
+      }
+    }
+  voxels = static_cast<unsigned char*>( image->GetScalarPointer() );
+  voxels[VolumeSize * VolumeSize * VolumeSize - 1] = 255;
+  image->Modified();
+}
+
+//----------------------------------------------------------------------------
+// Renders a frame into the off-screen image and reads the counters of the runtime
+FrameCounts RenderFrame(vtkCUDA1DVolumeMapper* mapper, vtkRenderer* renderer, vtkVolume* volume, vtkCUDAMockRuntime* runtime)
+{
+  mapper->Render(renderer, volume);
+  FrameCounts counts;
+  counts.Allocations = runtime->GetNumberOfAllocations();
+  counts.HostAllocations = runtime->GetNumberOfHostAllocations();
+  counts.LiveAllocations = runtime->GetNumberOfLiveAllocations();
+  counts.BytesToDevice = runtime->GetBytesCopiedToDevice();
+  return counts;
+}
+
+//----------------------------------------------------------------------------
+// Checks that a frame allocated nothing since the one before it, and copied as many bytes to the device as a frame does
+bool CheckFrame(const FrameCounts& before, const FrameCounts& after, size_t frameBytes, const char* frame, int line)
+{
+  if( after.Allocations != before.Allocations || after.HostAllocations != before.HostAllocations )
+    {
+    std::cerr << "Line " << line << " - " << frame << " made " << after.Allocations - before.Allocations << " device and "
+              << after.HostAllocations - before.HostAllocations << " page-locked allocations" << std::endl;
+    return false;
+    }
+  if( after.BytesToDevice - before.BytesToDevice != frameBytes )
+    {
+    std::cerr << "Line " << line << " - " << frame << " copied " << after.BytesToDevice - before.BytesToDevice
+              << " bytes to the device instead of the " << frameBytes << " of every frame" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDARenderAllocationsTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  //the mock runtime has to be in place before the first CUDA object takes a device
+  vtkSmartPointer<vtkCUDAMockRuntime> runtime = vtkSmartPointer<vtkCUDAMockRuntime>::New();
+  vtkCUDADeviceManager::Singleton()->SetRuntime(runtime);
+
+  vtkSmartPointer<vtkColorTransferFunction> colour = vtkSmartPointer<vtkColorTransferFunction>::New();
+  colour->AddRGBPoint(0.0, 0.0, 0.0, 0.0);
+  colour->AddRGBPoint(255.0, 1.0, 0.9, 0.8);
+  vtkSmartPointer<vtkPiecewiseFunction> opacity = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  opacity->AddPoint(0.0, 0.0);
+  opacity->AddPoint(100.0, 0.0);
+  opacity->AddPoint(255.0, 0.5);
+  vtkSmartPointer<vtkVolumeProperty> property = vtkSmartPointer<vtkVolumeProperty>::New();
+  property->SetColor(colour);
+  property->SetScalarOpacity(opacity);
+  property->SetInterpolationTypeToLinear();
+
+  vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+  image->SetDimensions(VolumeSize, VolumeSize, VolumeSize);
+  image->SetScalarTypeToUnsignedChar();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+  FillVolume(image, 0);
+  const size_t volumeBytes = (size_t) VolumeSize * VolumeSize * VolumeSize;
+
+  //every frame is cast, none being displayed again from the image cache, with a fixed block shape so no frame is timed
+  vtkSmartPointer<vtkCUDA1DVolumeMapper> mapper = vtkSmartPointer<vtkCUDA1DVolumeMapper>::New();
+  mapper->SetRenderBackend(vtkCUDAVolumeMapper::CUDA_BACKEND);
+  mapper->SetRenderOnDemand(false);
+  mapper->SetAutoTuneBlockShape(false);
+  mapper->SetOffScreenImageSize(ImageSize, ImageSize);
+  mapper->SetInput(image);
+  vtkSmartPointer<vtkVolume> volume = vtkSmartPointer<vtkVolume>::New();
+  volume->SetMapper(mapper);
+  volume->SetProperty(property);
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  renderer->AddVolume(volume);
+  renderer->ResetCamera();
+  vtkCamera* camera = renderer->GetActiveCamera();
+
+  //the first frame allocates what every frame renders into, the next one giving the bytes a frame copies to the device
+  FrameCounts previous = RenderFrame(mapper, renderer, volume, runtime);
+  camera->Azimuth(360.0 / (NumberOfFrames + 1));
+  FrameCounts counts = RenderFrame(mapper, renderer, volume, runtime);
+  const size_t frameBytes = counts.BytesToDevice - previous.BytesToDevice;
+  if( !CheckFrame(previous, counts, frameBytes, "the second frame", __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+  if( frameBytes >= volumeBytes )
+    {
+    std::cerr << "Line " << __LINE__ << " - a frame copied " << frameBytes << " bytes to the device, as many as the "
+              << volumeBytes << " of the volume" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //the frames after it, from a camera going round the volume, only copy their parameters again
+  for( int f = 1; f < NumberOfFrames; f++ )
+    {
+    previous = counts;
+    camera->Azimuth(360.0 / (NumberOfFrames + 1));
+    counts = RenderFrame(mapper, renderer, volume, runtime);
+    if( !CheckFrame(previous, counts, frameBytes, "a frame with an unchanged input", __LINE__) )
+      {
+      return EXIT_FAILURE;
+      }
+    }
+
+  //the input set again unchanged is not uploaded again, the frame reclassifying the macro cells at most
+  previous = counts;
+  mapper->SetInput(image);
+  counts = RenderFrame(mapper, renderer, volume, runtime);
+  if( counts.Allocations != previous.Allocations || counts.HostAllocations != previous.HostAllocations ||
+      counts.BytesToDevice - previous.BytesToDevice >= volumeBytes )
+    {
+    std::cerr << "Line " << __LINE__ << " - the unchanged input was uploaded again, copying "
+              << counts.BytesToDevice - previous.BytesToDevice << " bytes to the device and making "
+              << counts.Allocations - previous.Allocations << " device allocations" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //changed voxels are uploaded once, in place of the copy of the old ones
+  previous = counts;
+  FillVolume(image, 1);
+  mapper->SetInput(image);
+  counts = RenderFrame(mapper, renderer, volume, runtime);
+  if( counts.BytesToDevice - previous.BytesToDevice < volumeBytes || counts.LiveAllocations != previous.LiveAllocations )
+    {
+    std::cerr << "Line " << __LINE__ << " - the changed input copied " << counts.BytesToDevice - previous.BytesToDevice
+              << " bytes to the device instead of its " << volumeBytes << " at least, leaving "
+              << counts.LiveAllocations - previous.LiveAllocations << " more allocations alive" << std::endl;
+    return EXIT_FAILURE;
+    }
+  previous = counts;
+  camera->Azimuth(360.0 / (NumberOfFrames + 1));
+  counts = RenderFrame(mapper, renderer, volume, runtime);
+  if( !CheckFrame(previous, counts, frameBytes, "the frame after the input changed", __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  if( runtime->GetNumberOfInvalidCalls() != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << runtime->GetNumberOfInvalidCalls() << " invalid device calls" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,285 @@
+/** @file vtkCUDASlabCompositingTest.cxx
+*
+*  @brief Test of the sort-last rendering on the host: the splitting of a volume into slabs, their ordering from the
+*         camera and the compositing of their partial images (CPU_vtkCUDAVolumeMapper_composite)
+*
+*  The slabs must cover the extent along its longest axis, meeting on a shared slice, and be ordered front to back for
+*  cameras inside, before and beyond them. Rays are then simulated through a volume split into slabs: each slab gives a
+*  rounded partial image of the samples it holds, and the partial images, composited by direct send and by binary swap
+*  (for powers of two and other numbers of slabs, with and without host threads), must match the image of a single slab
+*  holding every sample to within the rounding of the partial images. No CUDA device is needed.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "CPU_vtkCUDAVolumeMapper_composite.h"
+#include "vtkCUDAHostThreadPool.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+/** @brief Size of the image, spanning several compositing tasks none of which is full */
+const unsigned int ImageWidth = 211;
+const unsigned int ImageHeight = 167;
+
+/** @brief Number of samples along each ray, one between each pair of slices of the simulated volume */
+const int NumberOfSamples = 24;
+
+//----------------------------------------------------------------------------
+// Uniform value in [0, 1], the same on every run
+float Random(unsigned int& seed)
+{
+  seed = seed * 1664525u + 1013904223u;
+  return (float) ((seed >> 8) % 65536u) / 65535.0f;
+}
+
+//----------------------------------------------------------------------------
+unsigned char Round(float value)
+{
+  value = 255.0f * value + 0.5f;
+  return (unsigned char) (value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value));
+}
+
+//----------------------------------------------------------------------------
+// Composites the samples [first, last) of a ray front to back, the last sample being the front one
+uchar4 CompositeSamples(const std::vector<float4>& samples, size_t ray, int first, int last)
+{
+  float4 composited;
+  composited.x = composited.y = composited.z = composited.w = 0.0f;
+  for( int s = last - 1; s >= first; s-- )
+    {
+    const float4& sample = samples[ray * NumberOfSamples + s];
+    const float transmittance = 1.0f - composited.w;
+    composited.x += transmittance * sample.x;
+    composited.y += transmittance * sample.y;
+    composited.z += transmittance * sample.z;
+    composited.w += transmittance * sample.w;
+    }
+  uchar4 pixel;
+  pixel.x = Round(composited.x);
+  pixel.y = Round(composited.y);
+  pixel.z = Round(composited.z);
+  pixel.w = Round(composited.w);
+  return pixel;
+}
+
+//----------------------------------------------------------------------------
+int MaximumError(const std::vector<uchar4>& image, const std::vector<uchar4>& reference)
+{
+  int error = 0;
+  for( size_t i = 0; i < image.size(); i++ )
+    {
+    int channels[4] = { image[i].x - reference[i].x, image[i].y - reference[i].y,
+                        image[i].z - reference[i].z, image[i].w - reference[i].w };
+    for( int c = 0; c < 4; c++ )
+      error = (std::abs(channels[c]) > error) ? std::abs(channels[c]) : error;
+    }
+  return error;
+}
+
+//----------------------------------------------------------------------------
+bool CheckOrder(const std::vector<int>& slabExtents, const double eye[4], const int* expected, int line)
+{
+  std::vector<int> order;
+  CPU_vtkCUDAVolumeMapper_orderSlabs( slabExtents, 0, eye, order );
+  bool matching = (order.size() == slabExtents.size() / 6);
+  for( size_t i = 0; matching && i < order.size(); i++ )
+    matching = (order[i] == expected[i]);
+  if( !matching )
+    {
+    std::cerr << "Line " << line << " - the slabs were ordered";
+    for( size_t i = 0; i < order.size(); i++ )
+      std::cerr << " " << order[i];
+    std::cerr << " for a camera at " << eye[0] << ", " << eye[1] << ", " << eye[2] << ", " << eye[3] << std::endl;
+    }
+  return matching;
+}
+
+//----------------------------------------------------------------------------
+// Checks the slabs of an extent cover it along its longest axis, each meeting the next on a shared slice
+bool CheckSplit()
+{
+  const int extent[6] = { 0, 40, -5, 94, 10, 20 };
+  std::vector<int> slabExtents;
+  const int axis = CPU_vtkCUDAVolumeMapper_splitSlabs( extent, 3, slabExtents );
+  if( axis != 1 || slabExtents.size() != 18 || slabExtents[2] != extent[2] || slabExtents[6*2+3] != extent[3] )
+    {
+    std::cerr << "Line " << __LINE__ << " - the extent was split into " << slabExtents.size() / 6 << " slabs along axis "
+              << axis << " instead of 3 along its longest axis" << std::endl;
+    return false;
+    }
+  for( int s = 0; s < 3; s++ )
+    {
+    const int thickness = slabExtents[6*s+3] - slabExtents[6*s+2];
+    const bool meeting = (s == 0 || slabExtents[6*s+2] == slabExtents[6*(s-1)+3]);
+    const bool others = slabExtents[6*s] == extent[0] && slabExtents[6*s+1] == extent[1] &&
+                        slabExtents[6*s+4] == extent[4] && slabExtents[6*s+5] == extent[5];
+    if( thickness < 32 || thickness > 33 || !meeting || !others )
+      {
+      std::cerr << "Line " << __LINE__ << " - slab " << s << " runs from " << slabExtents[6*s+2] << " to " << slabExtents[6*s+3]
+                << " along the axis" << std::endl;
+      return false;
+      }
+    }
+
+  //no more slabs than gaps between the slices, a single slice making a single slab, and nothing from an empty extent
+  const int thin[6] = { 0, 3, 0, 1, 0, 2 };
+  const int flat[6] = { 4, 4, 7, 7, 0, 0 };
+  const int empty[6] = { 0, 10, 5, 4, 0, 10 };
+  if( CPU_vtkCUDAVolumeMapper_splitSlabs( thin, 8, slabExtents ) != 0 || slabExtents.size() != 18 ||
+      CPU_vtkCUDAVolumeMapper_splitSlabs( flat, 8, slabExtents ) != 0 || slabExtents.size() != 6 ||
+      CPU_vtkCUDAVolumeMapper_splitSlabs( empty, 8, slabExtents ) != -1 || !slabExtents.empty() )
+    {
+    std::cerr << "Line " << __LINE__ << " - the slabs of thin, flat or empty extents are wrong" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Checks the slabs are ordered front to back for cameras inside, before and beyond the slabs
+bool CheckOrders()
+{
+  const int extent[6] = { 0, 99, 0, 49, 0, 49 };
+  std::vector<int> slabExtents;
+  CPU_vtkCUDAVolumeMapper_splitSlabs( extent, 4, slabExtents );
+
+  //the slab holding the camera comes first, the others following by their distance, whatever the homogeneous scale
+  const double inside[4] = { 120.0, 50.0, -30.0, 2.0 };
+  const int insideOrder[4] = { 2, 1, 3, 0 };
+  const double before[4] = { -10.0, 0.0, 0.0, 1.0 };
+  const int beforeOrder[4] = { 0, 1, 2, 3 };
+  const double towardsLow[4] = { -1.0, 0.5, 0.0, 0.0 };
+  const double towardsHigh[4] = { 1.0, 0.5, 0.0, 0.0 };
+  const int beyondOrder[4] = { 3, 2, 1, 0 };
+  const double sideways[4] = { 0.0, 1.0, 0.0, 0.0 };
+  return CheckOrder( slabExtents, inside, insideOrder, __LINE__ ) &&
+         CheckOrder( slabExtents, before, beforeOrder, __LINE__ ) &&
+         CheckOrder( slabExtents, towardsLow, beforeOrder, __LINE__ ) &&
+         CheckOrder( slabExtents, towardsHigh, beyondOrder, __LINE__ ) &&
+         CheckOrder( slabExtents, sideways, beforeOrder, __LINE__ );
+}
+
+//----------------------------------------------------------------------------
+// Composites the partial images of the slabs of a simulated volume, by both methods, against a single slab
+bool CheckCompositing(const std::vector<float4>& samples, int numberOfSlabs, vtkCUDAHostThreadPool* pool,
+                      std::vector<float4>& working)
+{
+  uint2 resolution;
+  resolution.x = ImageWidth;
+  resolution.y = ImageHeight;
+  const size_t numberOfPixels = (size_t) ImageWidth * (size_t) ImageHeight;
+
+  //the slices of the volume are those between the samples, and the camera looks down from beyond the last one
+  const int extent[6] = { 0, NumberOfSamples, 0, 0, 0, 0 };
+  std::vector<int> slabExtents;
+  std::vector<int> order;
+  const double eye[4] = { 1.0, 0.0, 0.0, 0.0 };
+  CPU_vtkCUDAVolumeMapper_splitSlabs( extent, numberOfSlabs, slabExtents );
+  CPU_vtkCUDAVolumeMapper_orderSlabs( slabExtents, 0, eye, order );
+
+  std::vector< std::vector<uchar4> > images( numberOfSlabs, std::vector<uchar4>(numberOfPixels) );
+  std::vector<const uchar4*> partials( numberOfSlabs );
+  std::vector<uchar4> reference( numberOfPixels );
+  for( int s = 0; s < numberOfSlabs; s++ )
+    {
+    partials[s] = &(images[s][0]);
+    for( size_t p = 0; p < numberOfPixels; p++ )
+      images[s][p] = CompositeSamples( samples, p, slabExtents[6*s], slabExtents[6*s+1] );
+    }
+  for( size_t p = 0; p < numberOfPixels; p++ )
+    reference[p] = CompositeSamples( samples, p, 0, NumberOfSamples );
+
+  //each partial image is rounded once, by half a level at most, and the composite once more
+  const int tolerance = (numberOfSlabs + 2) / 2;
+  std::vector<uchar4> directSend( numberOfPixels );
+  std::vector<uchar4> binarySwap( numberOfPixels );
+  if( !CPU_vtkCUDAVolumeMapper_compositeSlabs( partials, order, resolution, CUDA_COMPOSITE_DIRECT_SEND, &directSend[0], working, pool ) ||
+      !CPU_vtkCUDAVolumeMapper_compositeSlabs( partials, order, resolution, CUDA_COMPOSITE_BINARY_SWAP, &binarySwap[0], working, pool ) )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << numberOfSlabs << " slabs could not be composited" << std::endl;
+    return false;
+    }
+  const int directSendError = MaximumError( directSend, reference );
+  const int binarySwapError = MaximumError( binarySwap, reference );
+  const int difference = MaximumError( directSend, binarySwap );
+  if( directSendError > tolerance || binarySwapError > tolerance || difference > 1 )
+    {
+    std::cerr << "Line " << __LINE__ << " - compositing " << numberOfSlabs << " slabs " << (pool ? "with" : "without")
+              << " host threads is off by " << directSendError << " levels by direct send and " << binarySwapError
+              << " by binary swap (" << tolerance << " allowed), the methods differing by " << difference << std::endl;
+    return false;
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDASlabCompositingTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  if( !CheckSplit() || !CheckOrders() )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //every sample of a ray has a premultiplied colour with an opacity low enough that the samples behind still show
+  const size_t numberOfPixels = (size_t) ImageWidth * (size_t) ImageHeight;
+  std::vector<float4> samples( numberOfPixels * NumberOfSamples );
+  unsigned int seed = 12345;
+  for( size_t i = 0; i < samples.size(); i++ )
+    {
+    samples[i].w = 0.2f * Random(seed);
+    samples[i].x = samples[i].w * Random(seed);
+    samples[i].y = samples[i].w * Random(seed);
+    samples[i].z = samples[i].w * Random(seed);
+    }
+
+  //powers of two and the numbers between them, which binary swap folds, on the calling thread and on the host threads
+  vtkSmartPointer<vtkCUDAHostThreadPool> pool = vtkSmartPointer<vtkCUDAHostThreadPool>::New();
+  pool->SetNumberOfThreads(3);
+  std::vector<float4> working;
+  const int slabCounts[] = { 1, 2, 3, 4, 5, 7, 8 };
+  for( int i = 0; i < (int) (sizeof(slabCounts) / sizeof(slabCounts[0])); i++ )
+    {
+    if( !CheckCompositing( samples, slabCounts[i], 0, working ) || !CheckCompositing( samples, slabCounts[i], pool, working ) )
+      {
+      return EXIT_FAILURE;
+      }
+    }
+
+  //a single slab is its own image, and an unknown method or missing partial image is refused
+  uint2 resolution;
+  resolution.x = ImageWidth;
+  resolution.y = ImageHeight;
+  std::vector<uchar4> image( numberOfPixels );
+  std::vector<uchar4> output( numberOfPixels );
+  for( size_t p = 0; p < numberOfPixels; p++ )
+    image[p] = CompositeSamples( samples, p, 0, NumberOfSamples );
+  std::vector<const uchar4*> partials( 1, &(image[0]) );
+  std::vector<int> order( 1, 0 );
+  if( !CPU_vtkCUDAVolumeMapper_compositeSlabs( partials, order, resolution, CUDA_COMPOSITE_BINARY_SWAP, &output[0], working, pool ) ||
+      MaximumError( output, image ) != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - a single slab did not composite to its own image" << std::endl;
+    return EXIT_FAILURE;
+    }
+  partials.push_back( 0 );
+  order.push_back( 1 );
+  if( CPU_vtkCUDAVolumeMapper_compositeSlabs( partials, order, resolution, CUDA_COMPOSITE_DIRECT_SEND, &output[0], working, pool ) ||
+      CPU_vtkCUDAVolumeMapper_compositeSlabs( std::vector<const uchar4*>( 1, &(image[0]) ), std::vector<int>( 1, 0 ), resolution,
+                                              CUDA_COMPOSITE_BINARY_SWAP + 1, &output[0], working, pool ) )
+    {
+    std::cerr << "Line " << __LINE__ << " - a missing partial image or an unknown method was not refused" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,169 @@
+/** @file vtkCUDATileSchedulerTest.cxx
+*
+*  @brief Test of the splitting of the image among devices by vtkCUDATileScheduler: the bands must cover every row
+*         exactly once, and converge to the speeds of the devices
+*
+*  Devices rendering a number of rows per millisecond each are simulated as in vtkCUDATileSchedulerBenchmark, without
+*  noise. Every frame the bands must follow one another from the first row to the last, each device keeping a row while
+*  there are enough of them, and after a few frames the devices must take about the same time, the shares matching
+*  their speeds. No CUDA device is needed.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "vtkCUDATileScheduler.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+/** @brief Number of frames after which the bands of devices of steady speeds must be balanced */
+const int ConvergenceFrames = 20;
+
+/** @brief Slowest time over mean time accepted once balanced, and largest gap between a share and the relative speed */
+const double ImbalanceTolerance = 1.02;
+const double ShareTolerance = 0.01;
+
+//----------------------------------------------------------------------------
+// Gets the bands of every device, checking they cover the rows in order, each exactly once
+bool CheckBands(vtkCUDATileScheduler* scheduler, int numberOfRows, int* rows, int line)
+{
+  const int devices = scheduler->GetNumberOfDevices();
+  int next = 0;
+  for( int d = 0; d < devices; d++ )
+    {
+    int tile[2];
+    scheduler->GetTile(d, numberOfRows, tile);
+    const bool starved = numberOfRows >= devices && tile[1] < 1;
+    if( tile[0] != next || tile[1] < 0 || starved )
+      {
+      std::cerr << "Line " << line << " - device " << d << " of " << devices << " was given rows " << tile[0] << " to "
+                << tile[0] + tile[1] << " of " << numberOfRows << ", the previous band ending at " << next << std::endl;
+      return false;
+      }
+    next += tile[1];
+    if( rows ) rows[d] = tile[1];
+    }
+  if( next != numberOfRows )
+    {
+    std::cerr << "Line " << line << " - the bands of " << devices << " devices cover " << next << " of " << numberOfRows
+              << " rows" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Renders frames on simulated devices of the given speeds, in rows per millisecond, checking the bands of every frame
+bool RenderFrames(vtkCUDATileScheduler* scheduler, const double* speeds, int numberOfRows, int frames)
+{
+  const int devices = scheduler->GetNumberOfDevices();
+  int rows[8];
+  for( int f = 0; f < frames; f++ )
+    {
+    if( !CheckBands(scheduler, numberOfRows, rows, __LINE__) ) return false;
+    for( int d = 0; d < devices; d++ )
+      scheduler->ReportTime(d, 0.001 * (double) rows[d] / speeds[d]);
+    if( !scheduler->Rebalance() )
+      {
+      std::cerr << "Line " << __LINE__ << " - frame " << f << " was not rebalanced once every device was timed" << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Checks the bands of devices of the given speeds converge to their relative speeds
+bool CheckConvergence(const double* speeds, int devices, int numberOfRows)
+{
+  vtkSmartPointer<vtkCUDATileScheduler> scheduler = vtkSmartPointer<vtkCUDATileScheduler>::New();
+  scheduler->SetNumberOfDevices(devices);
+  if( !RenderFrames(scheduler, speeds, numberOfRows, ConvergenceFrames) ) return false;
+
+  double total = 0.0;
+  for( int d = 0; d < devices; d++ )
+    total += speeds[d];
+  for( int d = 0; d < devices; d++ )
+    {
+    if( fabs(scheduler->GetShare(d) - speeds[d] / total) > ShareTolerance )
+      {
+      std::cerr << "Line " << __LINE__ << " - device " << d << " of " << devices << " renders " << scheduler->GetShare(d)
+                << " of the image after " << ConvergenceFrames << " frames instead of " << speeds[d] / total << std::endl;
+      return false;
+      }
+    }
+  if( scheduler->GetImbalance() > ImbalanceTolerance )
+    {
+    std::cerr << "Line " << __LINE__ << " - the imbalance of " << devices << " devices is " << scheduler->GetImbalance()
+              << " after " << ConvergenceFrames << " frames" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDATileSchedulerTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkSmartPointer<vtkCUDATileScheduler> scheduler = vtkSmartPointer<vtkCUDATileScheduler>::New();
+
+  //equal shares cover every row, down to images with fewer rows than there are devices
+  const int rowCounts[] = { 0, 1, 2, 3, 7, 1080 };
+  for( int devices = 1; devices <= 5; devices++ )
+    {
+    scheduler->SetNumberOfDevices(devices);
+    for( int r = 0; r < (int) (sizeof(rowCounts) / sizeof(rowCounts[0])); r++ )
+      if( !CheckBands(scheduler, rowCounts[r], 0, __LINE__) ) return EXIT_FAILURE;
+    }
+
+  //the shares only move once every device has reported the time of its band
+  scheduler->SetNumberOfDevices(3);
+  int tile[2];
+  for( int d = 0; d < 3; d++ )
+    scheduler->GetTile(d, 1080, tile);
+  scheduler->ReportTime(0, 0.001);
+  scheduler->ReportTime(2, 0.004);
+  if( scheduler->Rebalance() || fabs(scheduler->GetShare(1) - 1.0 / 3.0) > 1e-12 )
+    {
+    std::cerr << "Line " << __LINE__ << " - the shares moved before every device was timed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //devices of different speeds, including one so slow it keeps only the minimum share, still cover every row
+  const double threeDevices[] = { 1.0, 1.0, 0.5 };
+  const double fourDevices[] = { 2.0, 1.0, 1.0, 0.25 };
+  if( !CheckConvergence(threeDevices, 3, 1080) || !CheckConvergence(fourDevices, 4, 1081) )
+    {
+    return EXIT_FAILURE;
+    }
+  const double stalledDevices[] = { 1.0, 1e-6 };
+  scheduler->SetNumberOfDevices(2);
+  if( !RenderFrames(scheduler, stalledDevices, 64, ConvergenceFrames) || !CheckBands(scheduler, 3, 0, __LINE__) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //a reset gives every device an equal share again, which no longer moves without smoothing
+  scheduler->SetNumberOfDevices(3);
+  if( !RenderFrames(scheduler, threeDevices, 1080, 1) )
+    {
+    return EXIT_FAILURE;
+    }
+  scheduler->SetSmoothing(0.0);
+  scheduler->Reset();
+  if( !RenderFrames(scheduler, threeDevices, 1080, 3) || fabs(scheduler->GetShare(2) - 1.0 / 3.0) > 1e-12 )
+    {
+    std::cerr << "Line " << __LINE__ << " - the shares moved without smoothing" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+/** @file vtkCUDAVolumePackingTest.cxx
+*
+*  @brief Test of the conversion of VTK scalars into the voxel formats the ray casters sample (CPU_vtkCUDAVolumeMapper_packImage)
+*
+*  Every supported VTK scalar type is filled with values spanning its range (or a chosen range for the wider integers),
+*  packed on the calling thread and on the host threads, and read back through CPU_vtkCUDAVolumeMapper_unpackVoxel, which
+*  must recover every value. The number of voxels is odd and spans several tasks, so the vectorized conversions and their
+*  scalar tails are both exercised.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "CPU_vtkCUDAVolumeMapper_packImage.h"
+#include "vtkCUDAHostThreadPool.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace
+{
+
+/** @brief Number of voxels converted for each type, more than two tasks of the pool and not a multiple of any vector width */
+const size_t NumberOfVoxels = 150001;
+
+/** @brief Largest error allowed when recovering an integer stored in 8 or 16 bits, the integers being one apart */
+const double IntegerTolerance = 0.01;
+
+//----------------------------------------------------------------------------
+const char* FormatName(int format)
+{
+  return (format == CUDA_PACKED_UNSIGNED_CHAR) ? "unsigned char" :
+         (format == CUDA_PACKED_UNSIGNED_SHORT) ? "unsigned short" :
+         (format == CUDA_PACKED_FLOAT) ? "float" : "unknown";
+}
+
+//----------------------------------------------------------------------------
+// Fills the voxels with values from low to high, in an order that puts both ends of the range in every vector
+template< class T >
+void FillVoxels(std::vector<T>& voxels, double low, double high)
+{
+  voxels.resize( NumberOfVoxels );
+  const double span = high - low;
+  for( size_t i = 0; i < NumberOfVoxels; i++ )
+    {
+    double t = (double) ((i * 7919) % 1009) / 1008.0;
+    if( i % 5 == 0 ) t = 0.0;
+    if( i % 5 == 1 ) t = 1.0;
+    voxels[i] = (T) (low + std::floor( t * span + 0.5 ));
+    }
+}
+
+//----------------------------------------------------------------------------
+template< class T >
+bool CheckType(const char* name, int scalarType, double low, double high, int expectedFormat, bool expectedNative,
+               vtkCUDAHostThreadPool* pool)
+{
+  std::vector<T> voxels;
+  FillVoxels(voxels, low, high);
+
+  const double scalarRange[2] = { low, high };
+  cudaVolumePackingInformation packing;
+  if( !CPU_vtkCUDAVolumeMapper_choosePacking(scalarType, scalarRange, packing) )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << name << " is not supported" << std::endl;
+    return false;
+    }
+  if( packing.Format != expectedFormat )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << name << " in [" << low << ", " << high << "] is packed as "
+              << FormatName(packing.Format) << " instead of " << FormatName(expectedFormat) << std::endl;
+    return false;
+    }
+  if( CPU_vtkCUDAVolumeMapper_isNativePacking(scalarType, packing) != expectedNative )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << name << " is " << (expectedNative ? "not " : "")
+              << "loaded without conversion" << std::endl;
+    return false;
+    }
+  if( CPU_vtkCUDAVolumeMapper_scalarSize(scalarType) != sizeof(T) )
+    {
+    std::cerr << "Line " << __LINE__ << " - the size of " << name << " is " << CPU_vtkCUDAVolumeMapper_scalarSize(scalarType)
+              << " instead of " << sizeof(T) << std::endl;
+    return false;
+    }
+
+  const size_t packedSize = NumberOfVoxels * CPU_vtkCUDAVolumeMapper_packedVoxelSize(packing);
+  std::vector<char> serial( packedSize );
+  std::vector<char> parallel( packedSize );
+  if( !CPU_vtkCUDAVolumeMapper_packImage(&voxels[0], scalarType, NumberOfVoxels, packing, &serial[0]) ||
+      !CPU_vtkCUDAVolumeMapper_packImageParallel(&voxels[0], scalarType, NumberOfVoxels, packing, &parallel[0], pool) )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << name << " failed to pack" << std::endl;
+    return false;
+    }
+  if( memcmp( &serial[0], &parallel[0], packedSize ) != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - " << name << " packs differently on the calling thread and the host threads" << std::endl;
+    return false;
+    }
+
+  //8 and 16-bit formats recover the integers, and the float format the value rounded to a float
+  for( size_t i = 0; i < NumberOfVoxels; i++ )
+    {
+    const double unpacked = (double) CPU_vtkCUDAVolumeMapper_unpackVoxel(&serial[0], i, packing);
+    const double expected = (packing.Format == CUDA_PACKED_FLOAT) ? (double) (float) voxels[i] : (double) voxels[i];
+    const double tolerance = (packing.Format == CUDA_PACKED_FLOAT) ? 0.0 : IntegerTolerance;
+    if( std::fabs( unpacked - expected ) > tolerance )
+      {
+      std::cerr << "Line " << __LINE__ << " - " << name << " voxel " << i << " is " << (double) voxels[i]
+                << " but is read back as " << unpacked << " from " << FormatName(packing.Format) << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+template< class T >
+bool CheckFullRange(const char* name, int scalarType, int expectedFormat, bool expectedNative, vtkCUDAHostThreadPool* pool)
+{
+  return CheckType<T>(name, scalarType, (double) std::numeric_limits<T>::min(), (double) std::numeric_limits<T>::max(),
+                      expectedFormat, expectedNative, pool);
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDAVolumePackingTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkSmartPointer<vtkCUDAHostThreadPool> pool = vtkSmartPointer<vtkCUDAHostThreadPool>::New();
+
+  //8 and 16-bit types keep their width whatever their range
+  bool ok = true;
+  ok = ok && CheckFullRange<char>("char", VTK_CHAR, CUDA_PACKED_UNSIGNED_CHAR, std::numeric_limits<char>::min() == 0, pool);
+  ok = ok && CheckFullRange<signed char>("signed char", VTK_SIGNED_CHAR, CUDA_PACKED_UNSIGNED_CHAR, false, pool);
+  ok = ok && CheckFullRange<unsigned char>("unsigned char", VTK_UNSIGNED_CHAR, CUDA_PACKED_UNSIGNED_CHAR, true, pool);
+  ok = ok && CheckFullRange<short>("short", VTK_SHORT, CUDA_PACKED_UNSIGNED_SHORT, false, pool);
+  ok = ok && CheckFullRange<unsigned short>("unsigned short", VTK_UNSIGNED_SHORT, CUDA_PACKED_UNSIGNED_SHORT, true, pool);
+
+  //wider integers are narrowed to the smallest format their range fits in
+  ok = ok && CheckType<int>("int", VTK_INT, -1000.0, -745.0, CUDA_PACKED_UNSIGNED_CHAR, false, pool);
+  ok = ok && CheckType<int>("int", VTK_INT, -1024.0, 3071.0, CUDA_PACKED_UNSIGNED_SHORT, false, pool);
+  ok = ok && CheckType<int>("int", VTK_INT, -40000000.0, 40000000.0, CUDA_PACKED_FLOAT, false, pool);
+  ok = ok && CheckType<unsigned int>("unsigned int", VTK_UNSIGNED_INT, 70000.0, 70255.0, CUDA_PACKED_UNSIGNED_CHAR, false, pool);
+  ok = ok && CheckType<unsigned int>("unsigned int", VTK_UNSIGNED_INT, 0.0, 65535.0, CUDA_PACKED_UNSIGNED_SHORT, false, pool);
+  ok = ok && CheckFullRange<unsigned int>("unsigned int", VTK_UNSIGNED_INT, CUDA_PACKED_FLOAT, false, pool);
+  ok = ok && CheckType<long>("long", VTK_LONG, 5.0, 260.0, CUDA_PACKED_UNSIGNED_CHAR, false, pool);
+  ok = ok && CheckType<long>("long", VTK_LONG, -65535.0, 0.0, CUDA_PACKED_UNSIGNED_SHORT, false, pool);
+  ok = ok && CheckType<long>("long", VTK_LONG, -1e9, 1e9, CUDA_PACKED_FLOAT, false, pool);
+  ok = ok && CheckType<unsigned long>("unsigned long", VTK_UNSIGNED_LONG, 0.0, 255.0, CUDA_PACKED_UNSIGNED_CHAR, false, pool);
+  ok = ok && CheckType<unsigned long>("unsigned long", VTK_UNSIGNED_LONG, 1e6, 1e6 + 60000.0, CUDA_PACKED_UNSIGNED_SHORT, false, pool);
+  ok = ok && CheckType<unsigned long>("unsigned long", VTK_UNSIGNED_LONG, 0.0, 4e9, CUDA_PACKED_FLOAT, false, pool);
+
+  //floating point types are stored as floats, doubles losing their extra precision
+  ok = ok && CheckType<float>("float", VTK_FLOAT, -3.5e4, 1.25e5, CUDA_PACKED_FLOAT, true, pool);
+  ok = ok && CheckType<double>("double", VTK_DOUBLE, -1e12, 1e12, CUDA_PACKED_FLOAT, false, pool);
+  if( !ok )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //unsupported types are refused rather than misread
+  const double scalarRange[2] = { 0.0, 1.0 };
+  cudaVolumePackingInformation packing;
+  unsigned char bits[1] = { 0 };
+  unsigned char packed[8];
+  if( CPU_vtkCUDAVolumeMapper_choosePacking(VTK_BIT, scalarRange, packing) ||
+      CPU_vtkCUDAVolumeMapper_scalarSize(VTK_BIT) != 0 )
+    {
+    std::cerr << "Line " << __LINE__ << " - bit images are accepted" << std::endl;
+    return EXIT_FAILURE;
+    }
+  packing.Format = CUDA_PACKED_FLOAT;
+  packing.Scale = 1.0f;
+  packing.Shift = 0.0f;
+  if( CPU_vtkCUDAVolumeMapper_packImage(bits, VTK_BIT, 1, packing, packed) ||
+      CPU_vtkCUDAVolumeMapper_packImageParallel(bits, VTK_BIT, 1, packing, packed, pool) ||
+      CPU_vtkCUDAVolumeMapper_packImage(0, VTK_FLOAT, 1, packing, packed) )
+    {
+    std::cerr << "Line " << __LINE__ << " - an unsupported or missing image is packed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,229 @@
+/** @file vtkCUDAVolumePyramidTest.cxx
+*
+*  @brief Test of the mip pyramid the ray caster samples once a pixel covers several voxels (CPU_vtkCUDAVolumeMapper_buildPyramid)
+*
+*  The pyramid of a volume with odd sizes is built for each reduction, on the calling thread and on host threads, which
+*  must give the same levels. The layout of the levels must halve the volume (rounding up) until it is a single voxel,
+*  or the number of levels asked for is reached, with the levels side by side along x. Each level must be the
+*  reduction of the 2x2x2 blocks of the one before it, the blocks cut short at the odd edges, and a level of maxima or
+*  minima must also hold the maximum or minimum of the whole block of the volume it covers. No CUDA device is needed.
+*
+*/
+
+// CUDA Volume Rendering includes
+#include "CPU_vtkCUDAVolumeMapper_pyramid.h"
+#include "vector_functions.h"
+#include "vtkCUDAHostThreadPool.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+/** @brief Size of the volume, odd along x and z so every level has blocks cut short, halving to a voxel in 6 levels */
+const int VolumeSize[3] = { 37, 20, 9 };
+const int NumberOfLevels = 6;
+
+/** @brief Largest relative difference allowed between a level of means and the reference, the levels being floats */
+const double Tolerance = 1e-5;
+
+/** @brief Number of host threads the pyramid is also built on */
+const int NumberOfThreads = 3;
+
+//----------------------------------------------------------------------------
+const char* ReductionName(int reduction)
+{
+  return (reduction == CUDA_PYRAMID_MAX) ? "max" : (reduction == CUDA_PYRAMID_MIN) ? "min" : "mean";
+}
+
+//----------------------------------------------------------------------------
+// Reduces the 2x2x2 blocks of a level in double precision, the blocks cut short at the edges, rounding the means to
+// integers when the finer level is the integer volume, which is reduced in its own type
+void ReduceLevel(const std::vector<double>& finer, const int finerSize[3], int reduction, bool integers,
+                 std::vector<double>& level, int size[3])
+{
+  for( int a = 0; a < 3; a++ ) size[a] = (finerSize[a] + 1) / 2;
+  level.assign( (size_t) size[0] * size[1] * size[2], 0.0 );
+  for( int z = 0; z < size[2]; z++ )
+    for( int y = 0; y < size[1]; y++ )
+      for( int x = 0; x < size[0]; x++ )
+        {
+        double sum = 0.0;
+        double low = 0.0;
+        double high = 0.0;
+        int count = 0;
+        for( int k = 2 * z; k < 2 * z + 2 && k < finerSize[2]; k++ )
+          for( int j = 2 * y; j < 2 * y + 2 && j < finerSize[1]; j++ )
+            for( int i = 2 * x; i < 2 * x + 2 && i < finerSize[0]; i++ )
+              {
+              const double value = finer[ ((size_t) k * finerSize[1] + j) * finerSize[0] + i ];
+              low = (count == 0 || value < low) ? value : low;
+              high = (count == 0 || value > high) ? value : high;
+              sum += value;
+              count++;
+              }
+        const double mean = integers ? std::floor( sum / (double) count + 0.5 ) : sum / (double) count;
+        level[ ((size_t) z * size[1] + y) * size[0] + x ] =
+          (reduction == CUDA_PYRAMID_MAX) ? high : (reduction == CUDA_PYRAMID_MIN) ? low : mean;
+        }
+}
+
+//----------------------------------------------------------------------------
+// Checks the layout of the levels against the volume halved again and again
+bool CheckLayout(const cudaPyramidInformation& pyramid, const std::vector<float>& levels, int expectedLevels)
+{
+  if( pyramid.NumberOfLevels != expectedLevels )
+    {
+    std::cerr << "Line " << __LINE__ << " - the pyramid has " << pyramid.NumberOfLevels << " levels instead of "
+              << expectedLevels << std::endl;
+    return false;
+    }
+  int size[3] = { VolumeSize[0], VolumeSize[1], VolumeSize[2] };
+  int origin = 0;
+  for( int l = 0; l < pyramid.NumberOfLevels; l++ )
+    {
+    for( int a = 0; a < 3; a++ ) size[a] = (size[a] + 1) / 2;
+    const int3& levelSize = pyramid.LevelSize[l];
+    if( levelSize.x != size[0] || levelSize.y != size[1] || levelSize.z != size[2] || pyramid.LevelOrigin[l] != origin ||
+        pyramid.LevelScale[l] != (float) std::pow( 0.5, l + 1 ) )
+      {
+      std::cerr << "Line " << __LINE__ << " - level " << l + 1 << " is " << levelSize.x << "x" << levelSize.y << "x"
+                << levelSize.z << " at " << pyramid.LevelOrigin[l] << " scaled by " << pyramid.LevelScale[l]
+                << " instead of " << size[0] << "x" << size[1] << "x" << size[2] << " at " << origin << std::endl;
+      return false;
+      }
+    origin += size[0];
+    }
+  if( CPU_vtkCUDAVolumeMapper_pyramidLevelOffset(pyramid, pyramid.NumberOfLevels + 1) != levels.size() )
+    {
+    std::cerr << "Line " << __LINE__ << " - the levels hold " << levels.size() << " voxels instead of "
+              << CPU_vtkCUDAVolumeMapper_pyramidLevelOffset(pyramid, pyramid.NumberOfLevels + 1) << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Builds the pyramid serially and on the threads, which must agree exactly, and compares its levels against the reference
+bool CheckReduction(const std::vector<unsigned short>& input, int reduction, vtkCUDAHostThreadPool* pool)
+{
+  const int3 volumeSize = make_int3( VolumeSize[0], VolumeSize[1], VolumeSize[2] );
+  cudaPyramidInformation pyramid;
+  std::vector<float> levels;
+  cudaPyramidInformation pooledPyramid;
+  std::vector<float> pooledLevels;
+  if( !CPU_vtkCUDAVolumeMapper_buildPyramid(&input[0], VTK_UNSIGNED_SHORT, volumeSize, CUDA_MAX_PYRAMID_LEVELS, reduction,
+                                            pyramid, levels, 0) ||
+      !CPU_vtkCUDAVolumeMapper_buildPyramid(&input[0], VTK_UNSIGNED_SHORT, volumeSize, CUDA_MAX_PYRAMID_LEVELS, reduction,
+                                            pooledPyramid, pooledLevels, pool) )
+    {
+    std::cerr << "Line " << __LINE__ << " - the " << ReductionName(reduction) << " pyramid cannot be built" << std::endl;
+    return false;
+    }
+  if( !CheckLayout(pyramid, levels, NumberOfLevels) || pyramid.Reduction != reduction )
+    {
+    return false;
+    }
+  if( pooledLevels != levels )
+    {
+    std::cerr << "Line " << __LINE__ << " - the " << ReductionName(reduction) << " pyramid built on "
+              << pool->GetNumberOfThreads() << " threads differs from the one built serially" << std::endl;
+    return false;
+    }
+
+  std::vector<double> finer( input.begin(), input.end() );
+  int finerSize[3] = { VolumeSize[0], VolumeSize[1], VolumeSize[2] };
+  for( int l = 0; l < pyramid.NumberOfLevels; l++ )
+    {
+    std::vector<double> reference;
+    int size[3];
+    ReduceLevel(finer, finerSize, reduction, l == 0, reference, size);
+    const float* level = &levels[0] + CPU_vtkCUDAVolumeMapper_pyramidLevelOffset(pyramid, l + 1);
+    const int block = 2 << l;
+    for( int z = 0; z < size[2]; z++ )
+      for( int y = 0; y < size[1]; y++ )
+        for( int x = 0; x < size[0]; x++ )
+          {
+          const size_t voxel = ((size_t) z * size[1] + y) * size[0] + x;
+          const double value = (double) level[voxel];
+          if( std::fabs( value - reference[voxel] ) > Tolerance * (1.0 + std::fabs( reference[voxel] )) )
+            {
+            std::cerr << "Line " << __LINE__ << " - voxel (" << x << ", " << y << ", " << z << ") of " << ReductionName(reduction)
+                      << " level " << l + 1 << " is " << value << " instead of " << reference[voxel] << std::endl;
+            return false;
+            }
+          if( reduction == CUDA_PYRAMID_MEAN ) continue;
+
+          //the extreme of a whole block of the volume survives every level
+          double extreme = -1.0;
+          for( int k = z * block; k < (z + 1) * block && k < VolumeSize[2]; k++ )
+            for( int j = y * block; j < (y + 1) * block && j < VolumeSize[1]; j++ )
+              for( int i = x * block; i < (x + 1) * block && i < VolumeSize[0]; i++ )
+                {
+                const double v = input[ ((size_t) k * VolumeSize[1] + j) * VolumeSize[0] + i ];
+                extreme = (extreme < 0.0 || (reduction == CUDA_PYRAMID_MAX ? v > extreme : v < extreme)) ? v : extreme;
+                }
+          if( value != extreme )
+            {
+            std::cerr << "Line " << __LINE__ << " - voxel (" << x << ", " << y << ", " << z << ") of " << ReductionName(reduction)
+                      << " level " << l + 1 << " is " << value << " instead of the " << extreme << " of its block" << std::endl;
+            return false;
+            }
+          }
+    finer.swap(reference);
+    for( int a = 0; a < 3; a++ ) finerSize[a] = size[a];
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkCUDAVolumePyramidTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkSmartPointer<vtkCUDAHostThreadPool> pool = vtkSmartPointer<vtkCUDAHostThreadPool>::New();
+  pool->SetNumberOfThreads(NumberOfThreads);
+
+  //12-bit CT-like values
+  std::vector<unsigned short> input( (size_t) VolumeSize[0] * VolumeSize[1] * VolumeSize[2] );
+  unsigned int seed = 12345;
+  for( size_t i = 0; i < input.size(); i++ )
+    {
+    seed = seed * 1664525u + 1013904223u;
+    input[i] = (unsigned short) ((seed >> 8) % 4096u);
+    }
+
+  const int reductions[3] = { CUDA_PYRAMID_MEAN, CUDA_PYRAMID_MAX, CUDA_PYRAMID_MIN };
+  for( int r = 0; r < 3; r++ )
+    {
+    if( !CheckReduction(input, reductions[r], pool) )
+      {
+      return EXIT_FAILURE;
+      }
+    }
+
+  //fewer levels than the volume allows stop early, and a type that cannot be reduced leaves no levels
+  const int3 volumeSize = make_int3( VolumeSize[0], VolumeSize[1], VolumeSize[2] );
+  cudaPyramidInformation pyramid;
+  std::vector<float> levels;
+  if( !CPU_vtkCUDAVolumeMapper_buildPyramid(&input[0], VTK_UNSIGNED_SHORT, volumeSize, 2, CUDA_PYRAMID_MEAN, pyramid, levels, pool) ||
+      !CheckLayout(pyramid, levels, 2) )
+    {
+    return EXIT_FAILURE;
+    }
+  if( CPU_vtkCUDAVolumeMapper_buildPyramid(&input[0], VTK_BIT, volumeSize, 2, CUDA_PYRAMID_MEAN, pyramid, levels, pool) ||
+      pyramid.NumberOfLevels != 0 || !levels.empty() )
+    {
+    std::cerr << "Line " << __LINE__ << " - a pyramid of bits was built with " << pyramid.NumberOfLevels << " levels" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}